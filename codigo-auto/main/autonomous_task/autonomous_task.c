@@ -5,15 +5,168 @@
 
 #include "autonomous_task.h"
 #include "motor_control.h"
+#include "vision_engine.h"
+#include "hardware_config.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include <string.h>
 
 static const char *TAG = "[Control]";
 
+// ============================================================================
+// ACTUATION LATENCY HISTOGRAMS
+// ============================================================================
+// "How long from dashboard click to wheel torque change" was estimated
+// with a slow-motion phone camera. Every processed command now feeds
+// three fixed-bucket histograms (250us buckets, last is a catch-all):
+// socket receipt to dispatch, dispatch to completed PWM write, and the
+// full chain. Same window semantics as the vision latency histograms:
+// percentiles are bucket upper edges and a read resets the window.
+// Only the control task writes; a racing read can at worst miss the
+// command being recorded.
+
+#define CTRL_LAT_BUCKET_US 250
+#define CTRL_LAT_BUCKET_COUNT 64
+
+typedef struct
+{
+    uint32_t counts[CTRL_LAT_BUCKET_COUNT];
+    uint32_t total;
+    uint32_t max_us;
+} ctrl_lat_hist_t;
+
+static ctrl_lat_hist_t s_hist_queue; // Receipt to dispatch
+static ctrl_lat_hist_t s_hist_apply; // Dispatch to PWM written
+static ctrl_lat_hist_t s_hist_total; // Receipt to PWM written
+
+static void ctrl_lat_record(ctrl_lat_hist_t *hist, uint32_t us)
+{
+    uint32_t bucket = us / CTRL_LAT_BUCKET_US;
+    if (bucket >= CTRL_LAT_BUCKET_COUNT)
+    {
+        bucket = CTRL_LAT_BUCKET_COUNT - 1;
+    }
+
+    hist->counts[bucket]++;
+    hist->total++;
+    if (us > hist->max_us)
+    {
+        hist->max_us = us;
+    }
+}
+
+static uint32_t ctrl_lat_percentile(const ctrl_lat_hist_t *hist, int pct)
+{
+    if (hist->total == 0)
+    {
+        return 0;
+    }
+
+    uint32_t rank = (hist->total * (uint32_t)pct + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < CTRL_LAT_BUCKET_COUNT; i++)
+    {
+        seen += hist->counts[i];
+        if (seen >= rank)
+        {
+            return (uint32_t)(i + 1) * CTRL_LAT_BUCKET_US;
+        }
+    }
+
+    return CTRL_LAT_BUCKET_COUNT * CTRL_LAT_BUCKET_US;
+}
+
+static void ctrl_lat_report(ctrl_lat_hist_t *hist, control_latency_stats_t *out)
+{
+    out->p50_us = ctrl_lat_percentile(hist, 50);
+    out->p95_us = ctrl_lat_percentile(hist, 95);
+    out->p99_us = ctrl_lat_percentile(hist, 99);
+    out->max_us = hist->max_us;
+    out->sample_count = hist->total;
+
+    memset(hist, 0, sizeof(*hist)); // Start a fresh window
+}
+
+void autonomous_get_latency_stats(control_latency_stats_t *queue,
+                                  control_latency_stats_t *apply,
+                                  control_latency_stats_t *total)
+{
+    if (queue)
+    {
+        ctrl_lat_report(&s_hist_queue, queue);
+    }
+    if (apply)
+    {
+        ctrl_lat_report(&s_hist_apply, apply);
+    }
+    if (total)
+    {
+        ctrl_lat_report(&s_hist_total, total);
+    }
+}
+
+// ============================================================================
+// PREDICTIVE SLOWDOWN
+// ============================================================================
+// The binary veto fires at VETO_DISTANCE_THRESHOLD_CM and turns every
+// approach into a panic stop. Forward speed now scales down
+// proportionally once the (closing-speed projected) distance drops
+// under the slowdown band, so by the time the hard threshold is
+// reached the vehicle is already slow and the stop is gentle. The
+// projection also buys tolerance to a lower vision frame rate: we
+// brake for where the obstacle will be, not where it was last seen.
+
+#define SLOWDOWN_START_DISTANCE_CM 60.0f // Band above the veto threshold
+#define SLOWDOWN_MIN_SPEED 90            // Floor: stays above wheel stall
+#define SLOWDOWN_HORIZON_S 0.6f          // Closing-speed projection window
+
+/**
+ * @brief Forward speed after the proportional slowdown
+ *
+ * Recomputed on every applied forward command; the dead-man refresh
+ * cadence (< 750 ms while driving) bounds how stale the scale can get.
+ */
+static int forward_speed_with_slowdown(void)
+{
+    vision_result_t vision;
+    if (vision_engine_get_result(&vision) != ESP_OK || !vision.obstacle_detected)
+    {
+        return MANUAL_FORWARD_SPEED;
+    }
+
+    // Project the gap forward: negative closing speed means approaching
+    float effective_cm = vision.distance_cm;
+    if (vision.closing_speed_cm_s < 0)
+    {
+        effective_cm += vision.closing_speed_cm_s * SLOWDOWN_HORIZON_S;
+    }
+
+    if (effective_cm >= SLOWDOWN_START_DISTANCE_CM)
+    {
+        return MANUAL_FORWARD_SPEED;
+    }
+    if (effective_cm <= VETO_DISTANCE_THRESHOLD_CM)
+    {
+        return SLOWDOWN_MIN_SPEED;
+    }
+
+    float span = (effective_cm - VETO_DISTANCE_THRESHOLD_CM) /
+                 (SLOWDOWN_START_DISTANCE_CM - VETO_DISTANCE_THRESHOLD_CM);
+    int speed = SLOWDOWN_MIN_SPEED +
+                (int)(span * (float)(MANUAL_FORWARD_SPEED - SLOWDOWN_MIN_SPEED));
+
+    ESP_LOGD(TAG, "Slowdown: %.0f cm (proj %.0f), speed %d",
+             vision.distance_cm, effective_cm, speed);
+    return speed;
+}
+
 // Current control state
 static control_state_t s_current_state = STATE_IDLE;
 static SemaphoreHandle_t s_state_mutex = NULL;
+static StaticSemaphore_t s_state_mutex_buf; // Permanent mutex lives in BSS
 
 /**
  * @brief Set current state (thread-safe)
@@ -41,7 +194,8 @@ static void apply_stop(void)
 
 static void apply_forward(void)
 {
-    motor_set_speed(MANUAL_FORWARD_SPEED, MANUAL_FORWARD_SPEED);
+    int speed = forward_speed_with_slowdown();
+    motor_set_speed(speed, speed);
     set_state(STATE_FORWARD);
 }
 
@@ -73,12 +227,7 @@ esp_err_t autonomous_init(void)
 {
     ESP_LOGI(TAG, "Initializing autonomous control...");
 
-    s_state_mutex = xSemaphoreCreateMutex();
-    if (s_state_mutex == NULL)
-    {
-        ESP_LOGE(TAG, "Failed to create state mutex");
-        return ESP_FAIL;
-    }
+    s_state_mutex = xSemaphoreCreateMutexStatic(&s_state_mutex_buf);
 
     s_current_state = STATE_IDLE;
 
@@ -88,6 +237,8 @@ esp_err_t autonomous_init(void)
 
 esp_err_t autonomous_process_with_veto(const control_message_t *command, bool local_veto)
 {
+    int64_t dispatch_us = esp_timer_get_time();
+
     if (!command)
     {
         ESP_LOGW(TAG, "Null control command received");
@@ -122,6 +273,20 @@ esp_err_t autonomous_process_with_veto(const control_message_t *command, bool lo
         break;
     }
 
+    // Latency bookkeeping. The control task re-applies the active
+    // command on veto and link edges, so each received message is
+    // recorded once - re-applications only feed the apply histogram.
+    static int64_t s_last_recorded_recv_us = 0;
+    int64_t done_us = esp_timer_get_time();
+
+    ctrl_lat_record(&s_hist_apply, (uint32_t)(done_us - dispatch_us));
+    if (command->recv_us > 0 && command->recv_us != s_last_recorded_recv_us)
+    {
+        s_last_recorded_recv_us = command->recv_us;
+        ctrl_lat_record(&s_hist_queue, (uint32_t)(dispatch_us - command->recv_us));
+        ctrl_lat_record(&s_hist_total, (uint32_t)(done_us - command->recv_us));
+    }
+
     return ESP_OK;
 }
 
@@ -75,11 +75,40 @@ esp_err_t autonomous_emergency_stop(void);
 
 /**
  * @brief Get state as string for logging/reporting
- * 
+ *
  * @return String representation of current state
  */
 const char* autonomous_state_to_string(control_state_t state);
 
+/**
+ * @brief Actuation latency percentiles (microseconds)
+ */
+typedef struct {
+    uint32_t p50_us;        // Median
+    uint32_t p95_us;        // 95th percentile
+    uint32_t p99_us;        // 99th percentile
+    uint32_t max_us;        // Worst sample in the window
+    uint32_t sample_count;  // Commands recorded in the window
+} control_latency_stats_t;
+
+/**
+ * @brief Get actuation latency percentiles since the previous call
+ *
+ * Ground truth for "dashboard click to wheel torque change" on the
+ * vehicle side: queue covers socket receipt to dispatch into
+ * autonomous_process_with_veto(), apply covers dispatch to the
+ * completed PWM write, total covers the whole chain. Percentiles are
+ * bucket upper edges (250us buckets). Reading resets the window; any
+ * pointer may be NULL to skip that histogram.
+ *
+ * @param[out] queue Receipt-to-dispatch latency stats
+ * @param[out] apply Dispatch-to-PWM latency stats
+ * @param[out] total Receipt-to-PWM latency stats
+ */
+void autonomous_get_latency_stats(control_latency_stats_t *queue,
+                                  control_latency_stats_t *apply,
+                                  control_latency_stats_t *total);
+
 #ifdef __cplusplus
 }
 #endif
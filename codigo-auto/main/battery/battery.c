@@ -0,0 +1,183 @@
+/**
+ * @file battery.c
+ * @brief Battery monitoring implementation (ADC oneshot + calibration)
+ *
+ * The continuous/DMA ADC driver was considered and rejected: on the
+ * ESP32 it captures through I2S0, which the camera's DVP interface
+ * already owns. A 1 Hz oneshot burst costs microseconds on a low
+ * priority task and is more than enough for battery sag tracking.
+ */
+
+#include "battery.h"
+#include "hardware_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_log.h"
+#include <stdatomic.h>
+
+static const char *TAG = "[Battery]";
+
+#define BATTERY_TASK_STACK_SIZE 2560
+#define BATTERY_TASK_PRIORITY 2
+
+// GPIO36 = ADC1_CH0 (the only analog-capable pin the camera leaves us)
+#define BATTERY_ADC_UNIT ADC_UNIT_1
+#define BATTERY_ADC_CHANNEL_NUM ADC_CHANNEL_0
+
+static adc_oneshot_unit_handle_t s_adc = NULL;
+static adc_cali_handle_t s_cali = NULL;
+static battery_low_callback_t s_low_callback = NULL;
+
+// Last published pack voltage; atomic so readers never tear
+static atomic_int s_millivolts = 0;
+
+// Permanent task backing in BSS, not on the heap
+static StackType_t s_battery_stack[BATTERY_TASK_STACK_SIZE];
+static StaticTask_t s_battery_tcb;
+
+/**
+ * @brief Median of BATTERY_MEDIAN_SAMPLES raw readings
+ *
+ * A single sample jumps around with WiFi TX bursts on the shared rail;
+ * the median rejects those spikes without the lag of an average.
+ */
+static int battery_sample_median(void)
+{
+    int samples[BATTERY_MEDIAN_SAMPLES];
+    int count = 0;
+
+    for (int i = 0; i < BATTERY_MEDIAN_SAMPLES; i++)
+    {
+        int raw = 0;
+        if (adc_oneshot_read(s_adc, BATTERY_ADC_CHANNEL_NUM, &raw) == ESP_OK)
+        {
+            samples[count++] = raw;
+        }
+    }
+
+    if (count == 0)
+    {
+        return -1;
+    }
+
+    // Insertion sort: the array is tiny
+    for (int i = 1; i < count; i++)
+    {
+        int value = samples[i];
+        int j = i - 1;
+        while (j >= 0 && samples[j] > value)
+        {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = value;
+    }
+
+    return samples[count / 2];
+}
+
+static void battery_task(void *arg)
+{
+    (void)arg;
+    ESP_LOGI(TAG, "Battery task started on core %d", xPortGetCoreID());
+
+    bool low_armed = true;
+
+    while (1)
+    {
+        int raw = battery_sample_median();
+        if (raw >= 0)
+        {
+            int adc_mv = 0;
+            if (adc_cali_raw_to_voltage(s_cali, raw, &adc_mv) == ESP_OK)
+            {
+                int pack_mv = adc_mv * BATTERY_DIVIDER_NUM / BATTERY_DIVIDER_DEN;
+                atomic_store(&s_millivolts, pack_mv);
+
+                if (low_armed && pack_mv < BATTERY_LOW_MV)
+                {
+                    low_armed = false;
+                    ESP_LOGW(TAG, "Low battery: %d mV", pack_mv);
+                    if (s_low_callback)
+                    {
+                        s_low_callback(pack_mv);
+                    }
+                }
+                else if (!low_armed &&
+                         pack_mv > BATTERY_LOW_MV + BATTERY_LOW_HYSTERESIS_MV)
+                {
+                    low_armed = true;
+                }
+            }
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(BATTERY_SAMPLE_PERIOD_MS));
+    }
+}
+
+esp_err_t battery_init(battery_low_callback_t callback)
+{
+    if (s_adc != NULL)
+    {
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "Initializing battery monitor (ADC1_CH0)...");
+    s_low_callback = callback;
+
+    adc_oneshot_unit_init_cfg_t unit_cfg = {
+        .unit_id = BATTERY_ADC_UNIT,
+    };
+    esp_err_t err = adc_oneshot_new_unit(&unit_cfg, &s_adc);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC unit init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // 12 dB attenuation: full divider output (~2.1 V at a fresh cell)
+    // stays inside the measurable range
+    adc_oneshot_chan_cfg_t chan_cfg = {
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    err = adc_oneshot_config_channel(s_adc, BATTERY_ADC_CHANNEL_NUM, &chan_cfg);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC channel config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Factory eFuse Vref calibration (line fitting on the ESP32)
+    adc_cali_line_fitting_config_t cali_cfg = {
+        .unit_id = BATTERY_ADC_UNIT,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    err = adc_cali_create_scheme_line_fitting(&cali_cfg, &s_cali);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "ADC calibration unavailable: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(battery_task, "battery_task",
+                                                        BATTERY_TASK_STACK_SIZE, NULL,
+                                                        BATTERY_TASK_PRIORITY,
+                                                        s_battery_stack, &s_battery_tcb, 0);
+    if (handle == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create battery task");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+int battery_get_millivolts(void)
+{
+    return atomic_load(&s_millivolts);
+}
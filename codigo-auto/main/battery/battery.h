@@ -0,0 +1,63 @@
+/**
+ * @file battery.h
+ * @brief Battery voltage monitoring on the ADC divider input
+ *
+ * Samples the pack through the on-board 2:1 divider on GPIO36
+ * (ADC1_CH0), median-filters the raw readings and converts them with
+ * the factory ADC calibration. The sampler is a slow background task,
+ * so the control path never pays for it; consumers just read the last
+ * published millivolt value.
+ */
+
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Sampling cadence and filtering
+#define BATTERY_SAMPLE_PERIOD_MS 1000
+#define BATTERY_MEDIAN_SAMPLES 5
+
+// The divider halves the cell voltage into the ADC range
+#define BATTERY_DIVIDER_NUM 2
+#define BATTERY_DIVIDER_DEN 1
+
+// Low-voltage event threshold with re-arm hysteresis (1S pack)
+#define BATTERY_LOW_MV 3300
+#define BATTERY_LOW_HYSTERESIS_MV 100
+
+    /**
+     * @brief Callback invoked when the pack sags below BATTERY_LOW_MV
+     *
+     * Fires once per low-voltage episode (re-arms after the voltage
+     * recovers past the hysteresis band). Runs on the battery task.
+     */
+    typedef void (*battery_low_callback_t)(int millivolts);
+
+    /**
+     * @brief Configure the ADC channel and start the sampling task
+     *
+     * Not fatal for the vehicle: without calibration or ADC the status
+     * simply keeps reporting 0 (unknown).
+     *
+     * @param callback Low-voltage handler, or NULL
+     * @return ESP_OK on success
+     */
+    esp_err_t battery_init(battery_low_callback_t callback);
+
+    /**
+     * @brief Last published pack voltage in millivolts (0 = no sample yet)
+     */
+    int battery_get_millivolts(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BATTERY_H
@@ -0,0 +1,265 @@
+/**
+ * @file blackbox.c
+ * @brief PSRAM flight recorder (see blackbox.h)
+ */
+
+#include "blackbox.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+static const char *TAG = "[Blackbox]";
+
+// ~30 s of records at the observed steady rate (~15 vision + ~20
+// command/keepalive + veto/motor edges + 1 sys per second): 2048
+// records x 16 bytes = 32 KB of PSRAM
+#define BB_RING_RECORDS 2048
+// Internal-RAM fallback when PSRAM is absent: short but still useful
+#define BB_RING_RECORDS_FALLBACK 256
+
+#define BB_THUMB_MAX_BYTES 8192
+#define BB_THUMB_INTERVAL_MS 2000
+
+static bb_record_t *s_ring = NULL;
+static uint32_t s_ring_size = 0; // Power of 2
+static _Atomic uint32_t s_head = 0;
+static _Atomic bool s_frozen = false;
+
+typedef struct
+{
+    uint8_t *buf;
+    uint32_t len; // 0 = slot empty
+    uint32_t t_ms;
+} bb_thumb_t;
+
+static bb_thumb_t s_thumbs[BB_THUMB_SLOTS];
+
+// In-flight capture state; vision task only, so no locking
+static int s_thumb_capturing = -1; // Slot index, -1 = idle
+static uint32_t s_thumb_fill = 0;
+static bool s_thumb_overflow = false;
+static uint32_t s_thumb_last_ms = 0;
+static uint8_t s_thumb_next_slot = 0;
+
+static uint32_t bb_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/**
+ * @brief Print the tail of the ring while the chip is going down
+ *
+ * Registered as a shutdown handler: a panic-triggered restart passes
+ * through here, so the last seconds before a crash land on the UART
+ * even though PSRAM does not survive the reboot.
+ */
+static void bb_shutdown_dump(void)
+{
+    blackbox_dump_console(16);
+}
+
+esp_err_t blackbox_init(void)
+{
+    if (s_ring != NULL)
+    {
+        return ESP_OK;
+    }
+
+    s_ring_size = BB_RING_RECORDS;
+    s_ring = heap_caps_calloc(BB_RING_RECORDS, sizeof(bb_record_t),
+                              MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (s_ring == NULL)
+    {
+        s_ring_size = BB_RING_RECORDS_FALLBACK;
+        s_ring = heap_caps_calloc(BB_RING_RECORDS_FALLBACK, sizeof(bb_record_t),
+                                  MALLOC_CAP_8BIT);
+        if (s_ring == NULL)
+        {
+            ESP_LOGE(TAG, "No memory for the flight recorder ring");
+            return ESP_ERR_NO_MEM;
+        }
+        ESP_LOGW(TAG, "PSRAM unavailable - short ring (%lu records) in internal RAM",
+                 (unsigned long)s_ring_size);
+    }
+
+    // Thumbnails only make sense with PSRAM behind them
+    for (int i = 0; i < BB_THUMB_SLOTS; i++)
+    {
+        s_thumbs[i].buf = heap_caps_malloc(BB_THUMB_MAX_BYTES,
+                                           MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        s_thumbs[i].len = 0;
+    }
+
+    esp_register_shutdown_handler(bb_shutdown_dump);
+
+    ESP_LOGI(TAG, "Flight recorder armed: %lu records, %d thumbnail slots",
+             (unsigned long)s_ring_size,
+             s_thumbs[0].buf ? BB_THUMB_SLOTS : 0);
+    return ESP_OK;
+}
+
+void blackbox_record(bb_rec_type_t type, int16_t a, int32_t b, int32_t c)
+{
+    if (s_ring == NULL || atomic_load_explicit(&s_frozen, memory_order_relaxed))
+    {
+        return;
+    }
+
+    // Same relaxed slot grab as trace_log: concurrent pushers get
+    // distinct slots, a racing reader sees at worst one torn record
+    uint32_t pos = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    bb_record_t *slot = &s_ring[pos & (s_ring_size - 1)];
+
+    slot->t_ms = bb_now_ms();
+    slot->type = (uint16_t)type;
+    slot->a = a;
+    slot->b = b;
+    slot->c = c;
+}
+
+void blackbox_freeze(const char *reason)
+{
+    bool was = atomic_exchange_explicit(&s_frozen, true, memory_order_relaxed);
+    if (!was)
+    {
+        ESP_LOGW(TAG, "Recorder frozen: %s - dump with blackbox_dump, resume with blackbox_resume",
+                 reason ? reason : "unspecified");
+    }
+}
+
+void blackbox_resume(void)
+{
+    bool was = atomic_exchange_explicit(&s_frozen, false, memory_order_relaxed);
+    if (was)
+    {
+        ESP_LOGI(TAG, "Recorder resumed");
+    }
+}
+
+bool blackbox_is_frozen(void)
+{
+    return atomic_load_explicit(&s_frozen, memory_order_relaxed);
+}
+
+int blackbox_recent(bb_record_t *out, int max)
+{
+    if (out == NULL || max <= 0 || s_ring == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    uint32_t available = (head < s_ring_size) ? head : s_ring_size;
+    if (available > (uint32_t)max)
+    {
+        available = (uint32_t)max;
+    }
+
+    uint32_t start = head - available;
+    for (uint32_t i = 0; i < available; i++)
+    {
+        out[i] = s_ring[(start + i) & (s_ring_size - 1)];
+    }
+    return (int)available;
+}
+
+void blackbox_dump_console(int max_records)
+{
+    static const char *names[] = {"?", "VISION", "CMD", "VETO", "MOTOR", "SYS"};
+    // Static so the shutdown-handler path does not need stack for it
+    static bb_record_t recs[64];
+
+    if (max_records > (int)(sizeof(recs) / sizeof(recs[0])))
+    {
+        max_records = (int)(sizeof(recs) / sizeof(recs[0]));
+    }
+
+    int count = blackbox_recent(recs, max_records);
+    ESP_LOGI(TAG, "=== Flight recorder: last %d records%s ===", count,
+             blackbox_is_frozen() ? " (frozen)" : "");
+    for (int i = 0; i < count; i++)
+    {
+        const char *name = (recs[i].type < sizeof(names) / sizeof(names[0]))
+                               ? names[recs[i].type]
+                               : "?";
+        ESP_LOGI(TAG, "  %8lu ms %-6s a=%d b=%ld c=%ld",
+                 (unsigned long)recs[i].t_ms, name, (int)recs[i].a,
+                 (long)recs[i].b, (long)recs[i].c);
+    }
+}
+
+bool blackbox_thumb_begin(void)
+{
+    s_thumb_capturing = -1;
+
+    if (s_thumbs[0].buf == NULL ||
+        atomic_load_explicit(&s_frozen, memory_order_relaxed))
+    {
+        return false;
+    }
+
+    uint32_t now = bb_now_ms();
+    if (s_thumb_last_ms != 0 && now - s_thumb_last_ms < BB_THUMB_INTERVAL_MS)
+    {
+        return false;
+    }
+
+    s_thumb_capturing = s_thumb_next_slot;
+    s_thumb_fill = 0;
+    s_thumb_overflow = false;
+    return true;
+}
+
+void blackbox_thumb_append(const uint8_t *data, size_t len)
+{
+    if (s_thumb_capturing < 0 || s_thumb_overflow)
+    {
+        return;
+    }
+
+    if (s_thumb_fill + len > BB_THUMB_MAX_BYTES)
+    {
+        // Frame bigger than a "thumbnail": drop the capture, a smaller
+        // one will come along within the throttle window
+        s_thumb_overflow = true;
+        return;
+    }
+
+    memcpy(s_thumbs[s_thumb_capturing].buf + s_thumb_fill, data, len);
+    s_thumb_fill += len;
+}
+
+void blackbox_thumb_commit(void)
+{
+    if (s_thumb_capturing < 0 || s_thumb_overflow || s_thumb_fill == 0)
+    {
+        s_thumb_capturing = -1;
+        return;
+    }
+
+    bb_thumb_t *slot = &s_thumbs[s_thumb_capturing];
+    slot->len = s_thumb_fill;
+    slot->t_ms = bb_now_ms();
+
+    s_thumb_last_ms = slot->t_ms;
+    s_thumb_next_slot = (uint8_t)((s_thumb_next_slot + 1) % BB_THUMB_SLOTS);
+    s_thumb_capturing = -1;
+}
+
+bool blackbox_thumb_get(int idx, const uint8_t **jpeg, size_t *len,
+                        uint32_t *t_ms)
+{
+    if (idx < 0 || idx >= BB_THUMB_SLOTS || s_thumbs[idx].buf == NULL ||
+        s_thumbs[idx].len == 0)
+    {
+        return false;
+    }
+
+    *jpeg = s_thumbs[idx].buf;
+    *len = s_thumbs[idx].len;
+    *t_ms = s_thumbs[idx].t_ms;
+    return true;
+}
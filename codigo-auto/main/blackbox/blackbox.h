@@ -0,0 +1,125 @@
+/**
+ * @file blackbox.h
+ * @brief PSRAM flight recorder for post-incident analysis
+ *
+ * When a vehicle misbehaves in a run, the sparse UART log rarely
+ * explains why. This module keeps the last ~30 s of compact records in
+ * a PSRAM ring - vision results, commands, veto edges, motor
+ * setpoints, periodic heap/latency samples - plus a few rotating JPEG
+ * thumbnails of what the camera saw. Recording is cheap enough to be
+ * always on; an emergency stop freezes the ring so the evidence
+ * survives until someone pulls it, either over the WebSocket
+ * (blackbox_dump / blackbox_resume messages) or the console.
+ *
+ * Same concurrency contract as trace_log: pushes are a relaxed atomic
+ * slot grab safe from any task, readers tolerate the odd torn record
+ * because the output is a diagnostic dump. Thumbnails are written only
+ * from the vision task.
+ */
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Record types; the args are type-specific
+     */
+    typedef enum
+    {
+        BB_REC_VISION = 1, // a=detected 0/1, b=distance mm, c=processing ms
+        BB_REC_CMD,        // a=command enum, b=0, c=0
+        BB_REC_VETO,       // a=new state 0/1
+        BB_REC_MOTOR,      // a=0, b=left speed, c=right speed
+        BB_REC_SYS,        // a=veto 0/1, b=heap free KB, c=cmd p95 us
+    } bb_rec_type_t;
+
+    /**
+     * @brief One retained record, local clock (16 bytes)
+     */
+    typedef struct
+    {
+        uint32_t t_ms;
+        uint16_t type;
+        int16_t a;
+        int32_t b;
+        int32_t c;
+    } bb_record_t;
+
+    /**
+     * @brief Allocate the PSRAM ring and thumbnail slots
+     *
+     * Falls back to internal RAM with a smaller ring if PSRAM is not
+     * available. Also registers a shutdown handler that prints the tail
+     * of the ring on panic-triggered restarts.
+     */
+    esp_err_t blackbox_init(void);
+
+    /**
+     * @brief Record an event. Lock-free, safe from any task, no-op
+     * while frozen or before init.
+     */
+    void blackbox_record(bb_rec_type_t type, int16_t a, int32_t b, int32_t c);
+
+    /**
+     * @brief Freeze the recorder so the incident window is preserved
+     *
+     * Idempotent; only the first call logs the reason.
+     */
+    void blackbox_freeze(const char *reason);
+
+    /**
+     * @brief Resume recording after a dump (ring keeps accumulating)
+     */
+    void blackbox_resume(void);
+
+    bool blackbox_is_frozen(void);
+
+    /**
+     * @brief Copy the most recent records, oldest first
+     *
+     * @return Number of records copied
+     */
+    int blackbox_recent(bb_record_t *out, int max);
+
+    /**
+     * @brief Print the last max_records records to the console
+     */
+    void blackbox_dump_console(int max_records);
+
+    // ------------------------------------------------------------------
+    // Thumbnails: the stream path produces JPEG in chunks, so capture
+    // follows the same shape. begin() decides (throttle, freeze) whether
+    // this frame is kept; append() accumulates; commit() publishes the
+    // slot. An uncommitted capture is discarded by the next begin().
+    // Vision task only.
+    // ------------------------------------------------------------------
+
+    bool blackbox_thumb_begin(void);
+    void blackbox_thumb_append(const uint8_t *data, size_t len);
+    void blackbox_thumb_commit(void);
+
+    /**
+     * @brief Read one retained thumbnail slot
+     *
+     * @param idx Slot index, 0..BB_THUMB_SLOTS-1
+     * @return true if the slot holds a frame
+     */
+    bool blackbox_thumb_get(int idx, const uint8_t **jpeg, size_t *len,
+                            uint32_t *t_ms);
+
+#define BB_THUMB_SLOTS 4
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLACKBOX_H
@@ -0,0 +1,305 @@
+/**
+ * @file dataset_capture.c
+ * @brief Dataset capture to the dedicated flash partition (see header)
+ */
+
+#include "dataset_capture.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "hardware_config.h"
+
+static const char *TAG = "[Dataset]";
+
+// Staging sized for the largest frame the pipeline produces (QVGA
+// RGB565) plus its header; smaller profiles just use less of it
+#define DATASET_STAGING_BYTES (sizeof(dataset_rec_hdr_t) + FRAME_SIZE_RGB565)
+#define DATASET_STAGING_COUNT 2
+
+// Records are padded so every header lands 4-byte aligned on flash
+#define DATASET_REC_ALIGN 4
+
+#define DATASET_WRITER_STACK_SIZE 3072
+
+typedef enum
+{
+    STAGE_FREE = 0, // Available to submit()
+    STAGE_QUEUED,   // Filled, waiting for the writer
+} stage_state_t;
+
+typedef struct
+{
+    uint8_t *buf;
+    uint32_t len; // Header + frame bytes staged
+    _Atomic stage_state_t state;
+} dataset_stage_t;
+
+static const esp_partition_t *s_part = NULL;
+static dataset_stage_t s_stages[DATASET_STAGING_COUNT];
+
+// Writer task plumbing; the queue carries staging-buffer indices
+static TaskHandle_t s_writer_handle = NULL;
+static StackType_t s_writer_stack[DATASET_WRITER_STACK_SIZE];
+static StaticTask_t s_writer_tcb;
+static QueueHandle_t s_writer_queue = NULL;
+static StaticQueue_t s_writer_queue_buf;
+static uint8_t s_writer_queue_storage[DATASET_STAGING_COUNT * sizeof(int)];
+
+// Run state. s_armed gates submit(); the erase happens between
+// start() and s_armed flipping true, all on the writer task.
+static _Atomic bool s_armed = false;
+static _Atomic bool s_erase_pending = false;
+
+static uint32_t s_write_offset = 0; // Next free byte in the partition
+static uint32_t s_seq = 0;
+static _Atomic uint32_t s_records = 0;
+static _Atomic uint32_t s_bytes_used = 0;
+static _Atomic uint32_t s_dropped = 0;
+
+/**
+ * @brief Commit one staged record with a single sequential write
+ */
+static void writer_commit(dataset_stage_t *stage)
+{
+    uint32_t padded = (stage->len + DATASET_REC_ALIGN - 1) & ~(DATASET_REC_ALIGN - 1);
+
+    if (s_write_offset + padded > s_part->size)
+    {
+        ESP_LOGI(TAG, "Partition full after %lu records - capture stopped",
+                 (unsigned long)atomic_load_explicit(&s_records, memory_order_relaxed));
+        atomic_store_explicit(&s_armed, false, memory_order_relaxed);
+        return;
+    }
+
+    esp_err_t err = esp_partition_write(s_part, s_write_offset, stage->buf, padded);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Record write failed at 0x%lx: %s",
+                 (unsigned long)s_write_offset, esp_err_to_name(err));
+        atomic_store_explicit(&s_armed, false, memory_order_relaxed);
+        return;
+    }
+
+    s_write_offset += padded;
+    atomic_fetch_add_explicit(&s_records, 1, memory_order_relaxed);
+    atomic_store_explicit(&s_bytes_used, s_write_offset, memory_order_relaxed);
+}
+
+static void writer_task(void *pvParameters)
+{
+    (void)pvParameters;
+
+    int idx;
+    while (true)
+    {
+        if (atomic_exchange_explicit(&s_erase_pending, false, memory_order_relaxed))
+        {
+            // Whole-partition erase up front: every later write is then
+            // a pure sequential program with no erase stalls mid-run
+            ESP_LOGI(TAG, "Erasing dataset partition (%lu KB)...",
+                     (unsigned long)(s_part->size / 1024));
+            esp_err_t err = esp_partition_erase_range(s_part, 0, s_part->size);
+            if (err != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Partition erase failed: %s", esp_err_to_name(err));
+                continue;
+            }
+            s_write_offset = 0;
+            s_seq = 0;
+            atomic_store_explicit(&s_records, 0, memory_order_relaxed);
+            atomic_store_explicit(&s_bytes_used, 0, memory_order_relaxed);
+            atomic_store_explicit(&s_dropped, 0, memory_order_relaxed);
+            atomic_store_explicit(&s_armed, true, memory_order_relaxed);
+            ESP_LOGI(TAG, "Dataset capture armed");
+        }
+
+        if (xQueueReceive(s_writer_queue, &idx, pdMS_TO_TICKS(100)) == pdTRUE)
+        {
+            if (atomic_load_explicit(&s_armed, memory_order_relaxed))
+            {
+                writer_commit(&s_stages[idx]);
+            }
+            atomic_store_explicit(&s_stages[idx].state, STAGE_FREE,
+                                  memory_order_release);
+        }
+    }
+}
+
+esp_err_t dataset_capture_init(void)
+{
+    if (s_part != NULL)
+    {
+        return ESP_OK;
+    }
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                      ESP_PARTITION_SUBTYPE_ANY, "dataset");
+    if (s_part == NULL)
+    {
+        ESP_LOGW(TAG, "No 'dataset' partition - capture disabled");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    for (int i = 0; i < DATASET_STAGING_COUNT; i++)
+    {
+        s_stages[i].buf = heap_caps_malloc(DATASET_STAGING_BYTES,
+                                           MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (s_stages[i].buf == NULL)
+        {
+            ESP_LOGE(TAG, "No PSRAM for staging buffers");
+            s_part = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        atomic_store_explicit(&s_stages[i].state, STAGE_FREE, memory_order_relaxed);
+    }
+
+    s_writer_queue = xQueueCreateStatic(DATASET_STAGING_COUNT, sizeof(int),
+                                        s_writer_queue_storage,
+                                        &s_writer_queue_buf);
+
+    // Below the stream task: dataset I/O yields to everything the
+    // vehicle actually needs to drive
+    s_writer_handle = xTaskCreateStaticPinnedToCore(
+        writer_task,
+        "dataset_writer",
+        DATASET_WRITER_STACK_SIZE,
+        NULL,
+        2,
+        s_writer_stack,
+        &s_writer_tcb,
+        0 // Core 0 (Protocol CPU)
+    );
+
+    if (s_writer_handle == NULL)
+    {
+        ESP_LOGE(TAG, "Writer task creation failed");
+        s_part = NULL;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Dataset partition: %lu KB at 0x%lx",
+             (unsigned long)(s_part->size / 1024),
+             (unsigned long)s_part->address);
+    return ESP_OK;
+}
+
+esp_err_t dataset_capture_start(void)
+{
+    if (s_part == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (atomic_load_explicit(&s_armed, memory_order_relaxed))
+    {
+        return ESP_OK;
+    }
+
+    atomic_store_explicit(&s_erase_pending, true, memory_order_relaxed);
+    return ESP_OK;
+}
+
+void dataset_capture_stop(void)
+{
+    atomic_store_explicit(&s_armed, false, memory_order_relaxed);
+}
+
+bool dataset_capture_is_active(void)
+{
+    return atomic_load_explicit(&s_armed, memory_order_relaxed);
+}
+
+void dataset_capture_submit(const camera_fb_t *fb, const vision_result_t *result)
+{
+    if (!atomic_load_explicit(&s_armed, memory_order_relaxed))
+    {
+        return;
+    }
+
+    if (sizeof(dataset_rec_hdr_t) + fb->len > DATASET_STAGING_BYTES)
+    {
+        return; // Profile larger than staging; should not happen
+    }
+
+    // Grab a free staging buffer; both busy means flash is behind, and
+    // by design the frame is skipped rather than waited for
+    dataset_stage_t *stage = NULL;
+    int idx = -1;
+    for (int i = 0; i < DATASET_STAGING_COUNT; i++)
+    {
+        stage_state_t expected = STAGE_FREE;
+        if (atomic_compare_exchange_strong_explicit(&s_stages[i].state, &expected,
+                                                    STAGE_QUEUED,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed))
+        {
+            stage = &s_stages[i];
+            idx = i;
+            break;
+        }
+    }
+    if (stage == NULL)
+    {
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    dataset_rec_hdr_t hdr = {
+        .magic = DATASET_REC_MAGIC,
+        .seq = s_seq++,
+        .t_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .width = (uint16_t)fb->width,
+        .height = (uint16_t)fb->height,
+        .format = (uint16_t)fb->format,
+        .detected = result->obstacle_detected ? 1 : 0,
+        .distance_mm = (int32_t)(result->distance_cm * 10.0f),
+        .centroid_x = (int16_t)result->centroid_x,
+        .centroid_y = (int16_t)result->centroid_y,
+        .contour_area = result->contour_area,
+        .frame_len = (uint32_t)fb->len,
+    };
+
+    memcpy(stage->buf, &hdr, sizeof(hdr));
+    memcpy(stage->buf + sizeof(hdr), fb->buf, fb->len);
+    stage->len = sizeof(hdr) + (uint32_t)fb->len;
+
+    xQueueSend(s_writer_queue, &idx, 0);
+}
+
+void dataset_capture_get_info(uint32_t *bytes_used, uint32_t *records,
+                              uint32_t *dropped, uint32_t *capacity)
+{
+    *bytes_used = atomic_load_explicit(&s_bytes_used, memory_order_relaxed);
+    *records = atomic_load_explicit(&s_records, memory_order_relaxed);
+    *dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+    *capacity = (s_part != NULL) ? (uint32_t)s_part->size : 0;
+}
+
+int dataset_capture_read(uint32_t offset, uint8_t *out, size_t len)
+{
+    if (s_part == NULL)
+    {
+        return -1;
+    }
+
+    uint32_t used = atomic_load_explicit(&s_bytes_used, memory_order_relaxed);
+    if (offset >= used)
+    {
+        return 0;
+    }
+    if (offset + len > used)
+    {
+        len = used - offset;
+    }
+
+    if (esp_partition_read(s_part, offset, out, len) != ESP_OK)
+    {
+        return -1;
+    }
+    return (int)len;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file dataset_capture.h
+ * @brief Batched raw-frame capture to flash for offline detector tuning
+ *
+ * Tuning thresholds against screen-grabbed dashboard JPEGs loses the
+ * pixels the detector actually saw. This module records raw RGB565
+ * frames plus the detection result for each into the dedicated
+ * "dataset" flash partition, so a tuning run can replay exactly what
+ * the pipeline processed.
+ *
+ * The I/O path is built not to perturb the pipeline it measures:
+ * submit() copies the frame into one of two PSRAM staging buffers and
+ * returns; a low-priority writer task on Core 0 commits staged records
+ * to the partition as single large sequential writes. When both
+ * staging buffers are in flight the frame is simply skipped - flash
+ * write bandwidth, not the vision task, sets the effective capture
+ * rate. Capture stops on its own when the partition is full.
+ *
+ * Retrieval is pull-based over the WebSocket (dataset_info /
+ * dataset_fetch messages handled in ws_client); the stored layout is a
+ * sequence of dataset_rec_hdr_t records, each followed by its frame
+ * payload, padded to 4 bytes.
+ */
+
+#ifndef DATASET_CAPTURE_H
+#define DATASET_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "vision_engine.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define DATASET_REC_MAGIC 0x54455344 // "DSET" little-endian
+
+    /**
+     * @brief On-flash record header, immediately followed by the frame
+     */
+    typedef struct
+    {
+        uint32_t magic;       // DATASET_REC_MAGIC
+        uint32_t seq;         // Capture sequence number within this run
+        uint32_t t_ms;        // Local clock at submit
+        uint16_t width;       // Frame geometry
+        uint16_t height;
+        uint16_t format;      // pixformat_t of the payload
+        uint16_t detected;    // 0/1 from the detection result
+        int32_t distance_mm;  // Filtered distance (mm; 999900 = none)
+        int16_t centroid_x;   // Detection centroid (pixels)
+        int16_t centroid_y;
+        int32_t contour_area; // Largest contour area (pixels^2)
+        uint32_t frame_len;   // Payload bytes following this header
+    } dataset_rec_hdr_t;
+
+    /**
+     * @brief Locate the dataset partition and size the staging buffers
+     *
+     * Capture stays disabled if the partition is missing from the
+     * table; everything else still boots.
+     */
+    esp_err_t dataset_capture_init(void);
+
+    /**
+     * @brief Arm capture: erase the partition and start recording
+     *
+     * The erase runs on the writer task, so this returns immediately;
+     * frames are accepted once the erase completes.
+     */
+    esp_err_t dataset_capture_start(void);
+
+    void dataset_capture_stop(void);
+
+    bool dataset_capture_is_active(void);
+
+    /**
+     * @brief Offer the current frame and its result for recording
+     *
+     * Vision task only. No-op unless capture is armed; drops the frame
+     * without blocking when both staging buffers are in flight.
+     */
+    void dataset_capture_submit(const camera_fb_t *fb,
+                                const vision_result_t *result);
+
+    /**
+     * @brief Snapshot capture-run accounting for the info message
+     *
+     * @param[out] bytes_used Bytes committed to the partition
+     * @param[out] records    Records committed
+     * @param[out] dropped    Frames skipped while staging was busy
+     * @param[out] capacity   Partition size in bytes
+     */
+    void dataset_capture_get_info(uint32_t *bytes_used, uint32_t *records,
+                                  uint32_t *dropped, uint32_t *capacity);
+
+    /**
+     * @brief Read back committed bytes for the fetch message
+     *
+     * @return Bytes copied (clamped to the committed region), <0 on error
+     */
+    int dataset_capture_read(uint32_t offset, uint8_t *out, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DATASET_CAPTURE_H
@@ -0,0 +1,276 @@
+/**
+ * @file encoder.c
+ * @brief PCNT-based wheel encoders, fixed-point PI speed loop, odometry
+ */
+
+#include "encoder.h"
+#include "hardware_config.h"
+#include "motor_control/motor_control.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/pcnt.h"
+#include "esp_log.h"
+
+static const char *TAG = "[Encoder]";
+
+#define ENCODER_TASK_STACK_SIZE 3072
+#define ENCODER_TASK_PRIORITY 5
+
+// PCNT glitch filter in APB (80 MHz) cycles: ~12.8 us, well under the
+// narrowest real slot pulse and well over L298N switching noise
+#define ENCODER_FILTER_APB_CYCLES 1023
+
+// Cap on the PI correction so a stalled wheel saturates the duty
+// instead of winding the integrator into the next command
+#define ENCODER_PI_CORRECTION_MAX 96
+
+// Wheel travel per tick in micrometers (pi * diameter / slots)
+#define ENCODER_UM_PER_TICK \
+    ((int32_t)(3.14159f * ENCODER_WHEEL_DIAMETER_MM * 1000.0f) / ENCODER_SLOTS_PER_REV)
+
+static const pcnt_unit_t s_pcnt_unit[2] = {PCNT_UNIT_0, PCNT_UNIT_1};
+
+// PI state per wheel, Q8 fixed point throughout
+static volatile bool s_closed_loop = true;
+static int s_kp_q8 = ENCODER_PI_KP_Q8;
+static int s_ki_q8 = ENCODER_PI_KI_Q8;
+static int32_t s_integ_q8[2] = {0, 0};
+
+// Odometry accumulator, guarded by s_odo_mutex
+static SemaphoreHandle_t s_odo_mutex = NULL;
+
+// Permanent OS objects live in BSS, not on the heap
+static StaticSemaphore_t s_odo_mutex_buf;
+static StackType_t s_encoder_stack[ENCODER_TASK_STACK_SIZE];
+static StaticTask_t s_encoder_tcb;
+static odometry_t s_odometry = {0};
+
+static bool s_initialized = false;
+
+static esp_err_t encoder_configure_unit(pcnt_unit_t unit, int gpio)
+{
+    // Single-channel slotted disc: count rising edges only, no control
+    // pin - direction comes from the commanded motor sign at sample time
+    pcnt_config_t config = {
+        .pulse_gpio_num = gpio,
+        .ctrl_gpio_num = PCNT_PIN_NOT_USED,
+        .channel = PCNT_CHANNEL_0,
+        .unit = unit,
+        .pos_mode = PCNT_COUNT_INC,
+        .neg_mode = PCNT_COUNT_DIS,
+        .lctrl_mode = PCNT_MODE_KEEP,
+        .hctrl_mode = PCNT_MODE_KEEP,
+        .counter_h_lim = 32767,
+        .counter_l_lim = 0,
+    };
+
+    esp_err_t err = pcnt_unit_config(&config);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    pcnt_set_filter_value(unit, ENCODER_FILTER_APB_CYCLES);
+    pcnt_filter_enable(unit);
+
+    pcnt_counter_pause(unit);
+    pcnt_counter_clear(unit);
+    pcnt_counter_resume(unit);
+    return ESP_OK;
+}
+
+/**
+ * @brief One PI step for a single wheel
+ *
+ * All math in integers: error in ticks/s, gains in Q8, correction in
+ * duty counts. Returns the corrected duty magnitude (0-255) or -1 when
+ * the wheel is commanded stopped (integrator reset, nothing to apply).
+ */
+static int encoder_pi_step(int wheel, int commanded, int32_t measured_tps)
+{
+    if (commanded == 0)
+    {
+        s_integ_q8[wheel] = 0;
+        return -1;
+    }
+
+    int magnitude = (commanded < 0) ? -commanded : commanded;
+    int32_t target_tps = (int32_t)magnitude * ENCODER_MAX_TICKS_PER_S / 255;
+    int32_t error = target_tps - measured_tps;
+
+    s_integ_q8[wheel] += error * s_ki_q8;
+
+    int32_t correction = (error * s_kp_q8 + s_integ_q8[wheel]) >> 8;
+    if (correction > ENCODER_PI_CORRECTION_MAX)
+    {
+        correction = ENCODER_PI_CORRECTION_MAX;
+        // Anti-windup: hold the integrator at the value that saturates
+        s_integ_q8[wheel] -= error * s_ki_q8;
+    }
+    else if (correction < -ENCODER_PI_CORRECTION_MAX)
+    {
+        correction = -ENCODER_PI_CORRECTION_MAX;
+        s_integ_q8[wheel] -= error * s_ki_q8;
+    }
+
+    int duty = magnitude + (int)correction;
+    if (duty < 0)
+    {
+        duty = 0;
+    }
+    if (duty > 255)
+    {
+        duty = 255;
+    }
+    return duty;
+}
+
+static void encoder_task(void *arg)
+{
+    (void)arg;
+    ESP_LOGI(TAG, "Encoder task started on core %d", xPortGetCoreID());
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(ENCODER_SAMPLE_PERIOD_MS));
+
+        // Read-and-clear turns each sample into a plain delta; at 50 ms
+        // the 16-bit counter is nowhere near wrapping
+        int16_t raw[2] = {0, 0};
+        pcnt_get_counter_value(s_pcnt_unit[0], &raw[0]);
+        pcnt_get_counter_value(s_pcnt_unit[1], &raw[1]);
+        pcnt_counter_clear(s_pcnt_unit[0]);
+        pcnt_counter_clear(s_pcnt_unit[1]);
+
+        int commanded[2];
+        motor_get_speeds(&commanded[0], &commanded[1]);
+
+        int32_t tps[2];
+        int64_t signed_ticks[2];
+        for (int i = 0; i < 2; i++)
+        {
+            tps[i] = (int32_t)raw[i] * 1000 / ENCODER_SAMPLE_PERIOD_MS;
+            // The disc cannot sense direction: sign follows the command
+            signed_ticks[i] = (commanded[i] < 0) ? -(int64_t)raw[i]
+                                                 : (int64_t)raw[i];
+        }
+
+        if (s_odo_mutex && xSemaphoreTake(s_odo_mutex, pdMS_TO_TICKS(10)))
+        {
+            s_odometry.left_ticks += signed_ticks[0];
+            s_odometry.right_ticks += signed_ticks[1];
+            s_odometry.left_tps = tps[0];
+            s_odometry.right_tps = tps[1];
+            s_odometry.distance_mm =
+                (int32_t)((s_odometry.left_ticks + s_odometry.right_ticks) *
+                          ENCODER_UM_PER_TICK / 2000);
+            s_odometry.timestamp_ms = (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+            xSemaphoreGive(s_odo_mutex);
+        }
+
+        if (!s_closed_loop)
+        {
+            s_integ_q8[0] = 0;
+            s_integ_q8[1] = 0;
+            continue;
+        }
+
+        int left_duty = encoder_pi_step(0, commanded[0], tps[0]);
+        int right_duty = encoder_pi_step(1, commanded[1], tps[1]);
+
+        // -1 per side means "commanded stopped"; reuse the open-loop
+        // magnitude there so the call stays a no-op for that wheel
+        if (left_duty >= 0 || right_duty >= 0)
+        {
+            motor_apply_closed_loop_duty(
+                (left_duty >= 0) ? left_duty : 0,
+                (right_duty >= 0) ? right_duty : 0);
+        }
+    }
+}
+
+esp_err_t encoder_init(void)
+{
+    if (s_initialized)
+    {
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "Initializing wheel encoders (PCNT)...");
+
+    s_odo_mutex = xSemaphoreCreateMutexStatic(&s_odo_mutex_buf);
+
+    esp_err_t err = encoder_configure_unit(s_pcnt_unit[0], ENCODER_LEFT_GPIO);
+    if (err == ESP_OK)
+    {
+        err = encoder_configure_unit(s_pcnt_unit[1], ENCODER_RIGHT_GPIO);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "PCNT config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Core 1 next to the control task; the 50 ms loop is light
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(encoder_task, "encoder_task",
+                                                        ENCODER_TASK_STACK_SIZE, NULL,
+                                                        ENCODER_TASK_PRIORITY,
+                                                        s_encoder_stack, &s_encoder_tcb, 1);
+    if (handle == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create encoder task");
+        return ESP_FAIL;
+    }
+
+    s_initialized = true;
+    ESP_LOGI(TAG, "Encoders on GPIO%d/GPIO%d, %d slots, wheel %d mm",
+             ENCODER_LEFT_GPIO, ENCODER_RIGHT_GPIO,
+             ENCODER_SLOTS_PER_REV, ENCODER_WHEEL_DIAMETER_MM);
+    return ESP_OK;
+}
+
+void encoder_set_closed_loop(bool enable)
+{
+    s_closed_loop = enable;
+    ESP_LOGI(TAG, "Closed-loop speed control %s", enable ? "enabled" : "disabled");
+}
+
+esp_err_t encoder_set_pi_gains(int kp_q8, int ki_q8)
+{
+    if (kp_q8 < 0 || ki_q8 < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_kp_q8 = kp_q8;
+    s_ki_q8 = ki_q8;
+    s_integ_q8[0] = 0;
+    s_integ_q8[1] = 0;
+    ESP_LOGI(TAG, "PI gains set: kp=%d ki=%d (Q8)", kp_q8, ki_q8);
+    return ESP_OK;
+}
+
+void encoder_get_odometry(odometry_t *odometry)
+{
+    if (!odometry)
+    {
+        return;
+    }
+
+    memset(odometry, 0, sizeof(*odometry));
+    if (s_odo_mutex && xSemaphoreTake(s_odo_mutex, pdMS_TO_TICKS(10)))
+    {
+        *odometry = s_odometry;
+        xSemaphoreGive(s_odo_mutex);
+    }
+}
+
+void encoder_reset_odometry(void)
+{
+    if (s_odo_mutex && xSemaphoreTake(s_odo_mutex, pdMS_TO_TICKS(10)))
+    {
+        memset(&s_odometry, 0, sizeof(s_odometry));
+        xSemaphoreGive(s_odo_mutex);
+    }
+}
@@ -0,0 +1,97 @@
+/**
+ * @file encoder.h
+ * @brief Wheel encoder subsystem: PCNT pulse counting, PI speed loop
+ *        and odometry
+ *
+ * The slotted discs feed the ESP32 PCNT peripheral, so pulses are
+ * counted in hardware with no ISR-per-pulse overhead. A periodic task
+ * samples the counters, closes a fixed-point PI loop around each wheel
+ * (open-loop duty varies with battery sag) and accumulates odometry
+ * that autonomous_task.c can sanity-check against the vision distance
+ * estimator.
+ */
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Sampling and control cadence of the PI loop
+#define ENCODER_SAMPLE_PERIOD_MS 50
+
+// Ticks/s a wheel reaches at full duty with a charged battery; maps the
+// -255..255 command scale to a speed target. Calibrate per chassis.
+#define ENCODER_MAX_TICKS_PER_S 220
+
+// Default PI gains in Q8 fixed point (duty counts per tick/s of error)
+#define ENCODER_PI_KP_Q8 96 // 0.375
+#define ENCODER_PI_KI_Q8 24 // 0.094 (per sample)
+
+    /**
+     * @brief Accumulated odometry snapshot
+     *
+     * Distances are derived from ENCODER_SLOTS_PER_REV and
+     * ENCODER_WHEEL_DIAMETER_MM. Single-channel encoders cannot sense
+     * direction, so ticks advance distance with the sign of the
+     * commanded motor speed at sample time.
+     */
+    typedef struct
+    {
+        int64_t left_ticks;    // Signed accumulated ticks, left wheel
+        int64_t right_ticks;   // Signed accumulated ticks, right wheel
+        int32_t distance_mm;   // Mean signed travel of both wheels
+        int32_t left_tps;      // Last sampled speed, ticks per second
+        int32_t right_tps;     // Last sampled speed, ticks per second
+        uint32_t timestamp_ms; // Sample time of the snapshot
+    } odometry_t;
+
+    /**
+     * @brief Configure the PCNT units and start the sample/PI task
+     *
+     * Must be called after motor_control_init(). Failure is not fatal
+     * for the vehicle: without encoders motor control simply stays
+     * open-loop.
+     *
+     * @return ESP_OK on success
+     */
+    esp_err_t encoder_init(void);
+
+    /**
+     * @brief Enable or disable the closed-loop speed correction
+     *
+     * Disabled, the subsystem keeps counting (odometry stays valid) but
+     * leaves the duty alone. Enabled by default after encoder_init().
+     */
+    void encoder_set_closed_loop(bool enable);
+
+    /**
+     * @brief Retune the PI gains at runtime (Q8 fixed point)
+     *
+     * @param kp_q8 Proportional gain, >= 0
+     * @param ki_q8 Integral gain per sample, >= 0
+     * @return ESP_OK on success
+     */
+    esp_err_t encoder_set_pi_gains(int kp_q8, int ki_q8);
+
+    /**
+     * @brief Copy the current odometry snapshot (thread-safe)
+     */
+    void encoder_get_odometry(odometry_t *odometry);
+
+    /**
+     * @brief Reset the accumulated tick counts and distance
+     */
+    void encoder_reset_odometry(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENCODER_H
@@ -0,0 +1,102 @@
+/**
+ * @file espnow_link.c
+ * @brief ESP-NOW side channel for safety-critical commands
+ */
+
+#include "espnow_link.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "ESPNOW_LINK";
+
+// Command packet; must match espnow_link.c on the ESP32-S3
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];  // 'N','C'
+    uint8_t command;   // 0 = stop, 1 = veto override
+    uint8_t reserved;
+    uint32_t sequence; // Dedupe against retransmits and the WS path
+} espnow_cmd_packet_t;
+
+#define ESPNOW_CMD_STOP 0
+
+static control_callback_t s_callback = NULL;
+static uint32_t s_last_sequence = 0;
+
+static void espnow_recv_cb(const esp_now_recv_info_t *info,
+                           const uint8_t *data, int data_len)
+{
+    (void)info;
+
+    if (s_callback == NULL || data == NULL ||
+        data_len != (int)sizeof(espnow_cmd_packet_t))
+    {
+        return;
+    }
+
+    const espnow_cmd_packet_t *packet = (const espnow_cmd_packet_t *)data;
+    if (packet->magic[0] != 'N' || packet->magic[1] != 'C')
+    {
+        return;
+    }
+
+    // Drop stale or repeated broadcasts; signed compare handles wrap
+    if ((int32_t)(packet->sequence - s_last_sequence) <= 0)
+    {
+        return;
+    }
+    s_last_sequence = packet->sequence;
+
+    control_message_t message = {
+        .timestamp_ms = (uint64_t)(esp_timer_get_time() / 1000),
+        .recv_us = esp_timer_get_time(),
+    };
+
+    switch (packet->command)
+    {
+    case ESPNOW_CMD_STOP:
+        message.command = CONTROL_CMD_STOP;
+        strncpy(message.raw_command, "stop", sizeof(message.raw_command) - 1);
+        break;
+    default:
+        // Unknown critical command: stop is the safe interpretation
+        message.command = CONTROL_CMD_STOP;
+        strncpy(message.raw_command, "stop", sizeof(message.raw_command) - 1);
+        break;
+    }
+
+    // Same path as a WebSocket control frame: the callback just queues
+    s_callback(&message);
+}
+
+esp_err_t espnow_link_init(control_callback_t callback)
+{
+    if (callback == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_now_init falló: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_callback = callback;
+
+    err = esp_now_register_recv_cb(espnow_recv_cb);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No se pudo registrar el callback ESP-NOW: %s",
+                 esp_err_to_name(err));
+        s_callback = NULL;
+        esp_now_deinit();
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Canal lateral ESP-NOW escuchando comandos críticos");
+    return ESP_OK;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file espnow_link.h
+ * @brief ESP-NOW side channel for safety-critical commands
+ *
+ * The dashboard's stop command normally crosses TCP, httpd and the
+ * WebSocket client before it reaches the motors. The ESP32-S3 also
+ * broadcasts safety-critical commands (stop, veto override) over
+ * ESP-NOW, which delivers in single-digit milliseconds regardless of
+ * TCP state. This module listens for those broadcasts, deduplicates by
+ * sequence number, and feeds them into the same control callback the
+ * WebSocket path uses — receiving a command twice is harmless.
+ */
+
+#ifndef ESPNOW_LINK_H
+#define ESPNOW_LINK_H
+
+#include "esp_err.h"
+#include "ws_client/ws_client.h"
+
+/**
+ * @brief Start listening for ESP-NOW command broadcasts.
+ *
+ * Call after WiFi is connected. The callback runs in the WiFi task
+ * context and must only queue, exactly like the WebSocket control
+ * callback.
+ */
+esp_err_t espnow_link_init(control_callback_t callback);
+
+#endif // ESPNOW_LINK_H
@@ -55,6 +55,18 @@ extern "C"
 #define MOTOR_RIGHT_IN1 15 // GPIO 15 - IN3 Motor B
 #define MOTOR_RIGHT_IN2 13 // GPIO 13 - IN4 Motor B
 
+// ============================================================================
+// WHEEL ENCODER PINS - Slotted disc encoders (single channel, PCNT)
+// ============================================================================
+// The camera + motors leave almost nothing: the left encoder solders to
+// the red status LED pad (GPIO 33) and the right one takes U0RXD. Log
+// output on U0TXD keeps working; only console *input* is lost.
+#define ENCODER_LEFT_GPIO 33  // Red LED pad
+#define ENCODER_RIGHT_GPIO 3  // U0RXD
+
+#define ENCODER_SLOTS_PER_REV 20      // Slots in the encoder disc
+#define ENCODER_WHEEL_DIAMETER_MM 65  // Drive wheel diameter
+
 // LEDC PWM configuration
 #define MOTOR_LEDC_TIMER LEDC_TIMER_0
 #define MOTOR_LEDC_MODE LEDC_LOW_SPEED_MODE
@@ -102,9 +114,16 @@ extern "C"
 // Distance estimation (pinhole camera model)
 // Formula: distance = (real_width * focal_length) / pixel_width
 #define KNOWN_OBJECT_WIDTH_CM 10.0f      // Real width of obstacle in cm
+#define KNOWN_OBJECT_HEIGHT_CM 10.0f     // Real height of obstacle in cm
 #define CAMERA_FOCAL_LENGTH_PX 400.0f    // Calibrated focal length (adjust experimentally)
 #define VETO_DISTANCE_THRESHOLD_CM 25.0f // Stop if obstacle < 25cm
 
+// Worst-case execution budget for one detection pass. A pathological
+// frame (whole floor classifying green after a lighting failure) must
+// abort and publish a conservative partial result rather than starve
+// the veto loop; normal frames finish in a fraction of this.
+#define VISION_FRAME_BUDGET_MS 80
+
 // ============================================================================
 // MEMORY AND PERFORMANCE
 // ============================================================================
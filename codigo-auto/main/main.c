@@ -9,7 +9,7 @@
  * Components:
  * - WiFi Station: Connects to ESP32-S3 SoftAP
  * - WebSocket Client: Dashboard commands + video streaming
- * - Motor Control: MCPWM-based differential drive
+ * - Motor Control: LEDC-based differential drive (hardware fade ramps)
  * - Manual Control Task: Applies dashboard commands with local veto
  * - Vision Engine: Local obstacle detection (green objects)
  */
@@ -21,14 +21,28 @@
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_intr_alloc.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
 
 // Component headers
 #include "wifi_station/wifi_station.h"
 #include "ws_client/ws_client.h"
+#include "udp_stream/udp_stream.h"
+#include "espnow_link/espnow_link.h"
 #include "motor_control/motor_control.h"
+#include "encoder/encoder.h"
+#include "battery/battery.h"
 #include "autonomous_task/autonomous_task.h"
 #include "vision_engine/vision_engine.h"
+#include "vision_engine/mem_arena.h"
+#include "trace_log/trace_log.h"
+#include "blackbox/blackbox.h"
+#include "telemetry/telemetry.h"
+#include "dataset_capture/dataset_capture.h"
+#include "trace_points.h"
 
 static const char *TAG = "[Main]";
 
@@ -36,11 +50,64 @@ static const char *TAG = "[Main]";
 static QueueHandle_t command_queue = NULL;
 static EventGroupHandle_t system_events = NULL;
 
+// Static backing storage for the permanent OS objects. These live for
+// the whole uptime, so carving them out of the heap only exposed them
+// to the fragmentation the JPEG encoder causes; in BSS they cannot
+// fail at runtime and the heap stays reserved for frame-sized
+// transients.
+static StaticEventGroup_t s_system_events_buf;
+static StaticQueue_t s_command_queue_buf;
+static uint8_t s_command_queue_storage[1 * sizeof(control_message_t)];
+
+// Guaranteed-delivery path for stop: the mailbox below is latest-wins,
+// so a stop that races a burst of queued motion commands is latched
+// here and always reaches the control task
+static volatile bool stop_requested = false;
+
+// Actuation latency of the last monitor window, refreshed every 5 s by
+// monitor_task and copied into the outgoing status. Plain ints: a torn
+// read can only mix two consecutive telemetry windows.
+static control_latency_stats_t s_cmd_latency = {0};
+
+// Heap fragmentation snapshot, same producer/consumer pattern as the
+// latency stats above. The largest-free-block numbers are the early
+// warning for the frame2jpg-fails-after-days failure mode: total free
+// stays healthy while the blocks it is scattered across shrink.
+static int s_heap_free_kb = 0;
+static int s_heap_largest_kb = 0;
+static int s_psram_free_kb = 0;
+static int s_psram_largest_kb = 0;
+
 // Event bits
 #define WIFI_CONNECTED_BIT BIT0
 #define WEBSOCKET_CONNECTED_BIT BIT1
 #define EMERGENCY_STOP_BIT BIT2
 
+// Wake sources for the event-driven control task: every input sets its
+// bit so actuation happens one scheduler hop after the event instead of
+// at the next poll tick
+#define CONTROL_CMD_BIT BIT3  // Fresh command in the mailbox
+#define CONTROL_VETO_BIT BIT4 // Veto edge from the vision task
+#define CONTROL_LINK_BIT BIT5 // WebSocket link state changed
+#define CONTROL_WAKE_BITS (CONTROL_CMD_BIT | CONTROL_VETO_BIT | CONTROL_LINK_BIT)
+
+// Bring-up rendezvous: each init track raises its bit when done (pass
+// or fail - failures are recorded separately) so app_main can overlap
+// the slow camera SCCB configuration with WiFi association instead of
+// serializing them
+#define INIT_MOTOR_READY_BIT BIT6
+#define INIT_VISION_READY_BIT BIT7
+#define INIT_NETWORK_READY_BIT BIT8
+#define INIT_READY_BITS (INIT_MOTOR_READY_BIT | INIT_VISION_READY_BIT | INIT_NETWORK_READY_BIT)
+
+// Upper bound on the whole parallel bring-up; generous because WiFi
+// association against a congested AP can take several seconds
+#define INIT_JOIN_TIMEOUT_MS 15000
+
+// How long to wait for the first WebSocket connect before starting the
+// tasks anyway (the reconnect backoff keeps retrying in the background)
+#define WS_CONNECT_WAIT_MS 5000
+
 // Vehicle configuration
 #define VEHICLE_ID "ESP32CAM_01"
 
@@ -50,12 +117,23 @@ static EventGroupHandle_t system_events = NULL;
 #define STACK_SIZE_CONTROL 4096
 #define STACK_SIZE_MONITOR 2048
 
-// Battery monitoring (optional - using ADC)
-#define BATTERY_ADC_CHANNEL ADC_CHANNEL_0 // GPIO36 on ESP32
-#define BATTERY_VOLTAGE_DIVIDER 2.0f      // Adjust based on your circuit
+// Task stacks and control blocks in BSS (see the storage note above)
+static StackType_t s_control_stack[STACK_SIZE_CONTROL];
+static StaticTask_t s_control_tcb;
+static StackType_t s_status_tx_stack[STACK_SIZE_WS_TX];
+static StaticTask_t s_status_tx_tcb;
+static StackType_t s_monitor_stack[STACK_SIZE_MONITOR];
+static StaticTask_t s_monitor_tcb;
+
 
 /**
  * @brief Control callback - called when dashboard commands arrive
+ *
+ * For teleoperation only the newest command matters: the mailbox keeps
+ * exactly the latest intent and a TCP burst overwrites its own stale
+ * predecessors instead of queueing them up for replay. stop is also
+ * latched on a side flag so it can never be overwritten by the burst
+ * it arrived in.
  */
 static void control_command_callback(const control_message_t *message)
 {
@@ -64,15 +142,151 @@ static void control_command_callback(const control_message_t *message)
         return;
     }
 
-    if (xQueueSend(command_queue, message, 0) != pdTRUE)
+    if (message->command == CONTROL_CMD_STOP)
+    {
+        stop_requested = true;
+    }
+
+    xQueueOverwrite(command_queue, message);
+
+    if (system_events)
+    {
+        xEventGroupSetBits(system_events, CONTROL_CMD_BIT);
+    }
+}
+
+/**
+ * @brief Low battery callback - the pack sagged below BATTERY_LOW_MV
+ *
+ * Sag is the main source of open-loop speed variance; the closed-loop
+ * PI trims it while it can, this event marks the point where the
+ * operator should head back.
+ */
+static void battery_low_callback(int millivolts)
+{
+    ESP_LOGW(TAG, "Battery low (%d mV) - return to base", millivolts);
+}
+
+/**
+ * @brief Veto edge callback - fires from the vision task on transitions
+ *
+ * On assert during forward motion the stop is applied right here, in
+ * vision task context, without waiting for the control task to be
+ * scheduled. The wake bit is set either way so the control task
+ * re-derives the correct state (backward and turning stay allowed
+ * under veto) one hop later.
+ */
+static void vision_veto_edge_callback(bool active)
+{
+    trace_log_push(TRACE_EV_VETO_EDGE, active ? 1 : 0, 0);
+    blackbox_record(BB_REC_VETO, active ? 1 : 0, 0, 0);
+
+    if (active && autonomous_get_state() == STATE_FORWARD)
+    {
+        ESP_LOGW(TAG, "Veto asserted mid-forward - preemptive stop");
+        autonomous_emergency_stop();
+    }
+
+    if (system_events)
+    {
+        xEventGroupSetBits(system_events, CONTROL_VETO_BIT);
+    }
+
+    // Push the edge to the dashboards right away: waiting for the next
+    // 100 ms status snapshot leaves the operator re-issuing commands
+    // against a veto they can't see yet
+    vision_result_t result;
+    if (vision_engine_get_result(&result) == ESP_OK)
+    {
+        ws_client_send_veto_event(active, result.distance_cm,
+                                  result.centroid_x, result.centroid_y);
+    }
+    else
+    {
+        ws_client_send_veto_event(active, -1.0f, -1, -1);
+    }
+}
+
+/**
+ * @brief Connection callback - wakes the control task on WS link edges
+ */
+static void ws_connection_callback(bool connected)
+{
+    if (!system_events)
+    {
+        return;
+    }
+
+    if (connected)
+    {
+        xEventGroupSetBits(system_events, WEBSOCKET_CONNECTED_BIT);
+    }
+    else
+    {
+        xEventGroupClearBits(system_events, WEBSOCKET_CONNECTED_BIT);
+    }
+    xEventGroupSetBits(system_events, CONTROL_LINK_BIT);
+}
+
+/**
+ * @brief Capture config callback - dashboard retunes the camera at runtime
+ */
+static void capture_config_callback(const capture_config_t *config)
+{
+    if (!config)
+    {
+        return;
+    }
+
+    esp_err_t err = vision_engine_set_capture_tuning(config->fb_count,
+                                                     config->grab_latest,
+                                                     config->xclk_mhz);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Rejected capture config (fb=%d, grab=%d, xclk=%d)",
+                 config->fb_count, config->grab_latest, config->xclk_mhz);
+    }
+}
+
+/**
+ * @brief HSV config callback - dashboard retunes the detector thresholds
+ */
+static void hsv_config_callback(const hsv_config_t *config)
+{
+    if (!config)
+    {
+        return;
+    }
+
+    esp_err_t err;
+    if (config->calibrate)
+    {
+        err = vision_engine_start_calibration();
+    }
+    else
+    {
+        err = vision_engine_set_hsv_range(config->h_min, config->h_max,
+                                          config->s_min, config->s_max,
+                                          config->v_min, config->v_max);
+    }
+
+    if (err != ESP_OK)
     {
-        ESP_LOGW(TAG, "Control queue full, dropping command %s", message->raw_command);
+        ESP_LOGW(TAG, "Rejected HSV config (err 0x%x)", err);
     }
 }
 
 /**
  * @brief Task: Manual Control Loop with Local Veto
- * Applies latest dashboard command while allowing camera veto to block motion.
+ *
+ * Fully event-driven: blocks on the wake bits (command mailbox, veto
+ * edge, WS link edge) and only uses a timeout for the dead-man deadline
+ * while a motion command is active. The deadline follows the measured
+ * link RTT (ws_client_get_deadman_timeout_ms): a fixed 750 ms both
+ * false-stopped on congested links and reacted slowly on clean ones. The old 20 ms poll plus
+ * 50 ms queue wait stacked up to ~70 ms of actuation latency before the
+ * motors saw anything; now any input is acted on one scheduler hop
+ * after it fires.
  */
 static void control_task(void *pvParameters)
 {
@@ -85,20 +299,67 @@ static void control_task(void *pvParameters)
     };
 
     TickType_t last_command_tick = xTaskGetTickCount();
-    const TickType_t command_timeout = pdMS_TO_TICKS(750);
     bool last_ws_state = true;
 
     while (1)
     {
+        // Re-read the adaptive deadline each pass: it drifts with link
+        // quality, and a stale value only costs one extra wakeup
+        TickType_t command_timeout =
+            pdMS_TO_TICKS(ws_client_get_deadman_timeout_ms());
+
+        // While moving, sleep at most until the dead-man deadline;
+        // stopped, there is nothing to time out and every input wakes
+        // us through its bit
+        TickType_t wait = portMAX_DELAY;
+        if (active_command.command != CONTROL_CMD_STOP)
+        {
+            TickType_t elapsed = xTaskGetTickCount() - last_command_tick;
+            wait = (elapsed < command_timeout) ? command_timeout - elapsed : 0;
+        }
+
+        EventBits_t wake = xEventGroupWaitBits(system_events, CONTROL_WAKE_BITS,
+                                               pdTRUE, pdFALSE, wait);
+
+        TRACE_REGION_ENTER(TRACE_ID_CONTROL_CYCLE);
+
         control_message_t incoming;
-        if (command_queue &&
-            xQueueReceive(command_queue, &incoming, pdMS_TO_TICKS(50)) == pdTRUE)
+        if (stop_requested)
         {
-            active_command = incoming;
+            // Safety bias: a latched stop beats whatever else raced
+            // into the mailbox during the same burst
+            stop_requested = false;
+            if (command_queue)
+            {
+                xQueueReceive(command_queue, &incoming, 0);
+            }
+            active_command.command = CONTROL_CMD_STOP;
+            strncpy(active_command.raw_command, "stop", sizeof(active_command.raw_command) - 1);
+            active_command.raw_command[sizeof(active_command.raw_command) - 1] = '\0';
             last_command_tick = xTaskGetTickCount();
         }
-        else if ((xTaskGetTickCount() - last_command_tick) > command_timeout)
+        else if ((wake & CONTROL_CMD_BIT) && command_queue &&
+                 xQueueReceive(command_queue, &incoming, 0) == pdTRUE)
+        {
+            if (incoming.command == CONTROL_CMD_KEEPALIVE)
+            {
+                // Held-state keepalive from the dashboard: only pushes
+                // the dead-man deadline out, the active command keeps
+                // driving the motors
+                last_command_tick = xTaskGetTickCount();
+            }
+            else
+            {
+                active_command = incoming;
+                last_command_tick = xTaskGetTickCount();
+                trace_log_push(TRACE_EV_CMD_APPLY, (int32_t)incoming.command, 0);
+                blackbox_record(BB_REC_CMD, (int16_t)incoming.command, 0, 0);
+            }
+        }
+        else if (active_command.command != CONTROL_CMD_STOP &&
+                 (xTaskGetTickCount() - last_command_tick) >= command_timeout)
         {
+            ESP_LOGW(TAG, "Dead-man timeout - stopping");
             active_command.command = CONTROL_CMD_STOP;
             strncpy(active_command.raw_command, "stop", sizeof(active_command.raw_command) - 1);
             active_command.raw_command[sizeof(active_command.raw_command) - 1] = '\0';
@@ -116,6 +377,9 @@ static void control_task(void *pvParameters)
             if (last_ws_state)
             {
                 ESP_LOGE(TAG, "WebSocket disconnected - EMERGENCY STOP");
+                // Preserve the last ~30 s for the incident review; a
+                // blackbox_resume after the dump rearms recording
+                blackbox_freeze("emergency stop on WebSocket loss");
             }
             last_ws_state = false;
             autonomous_emergency_stop();
@@ -126,14 +390,64 @@ static void control_task(void *pvParameters)
             last_ws_state = true;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(20));
+        TRACE_REGION_EXIT(TRACE_ID_CONTROL_CYCLE);
+    }
+}
+
+// On-change status gating: a parked vehicle used to push an identical
+// frame 10x/s, and across a fleet that was the largest constant load on
+// the server's receive path. Noisy fields are quantized before the
+// comparison so they only count as a change when a human would care.
+#define STATUS_HEARTBEAT_MS 1000
+#define STATUS_BATTERY_DELTA_MV 50
+#define STATUS_VISION_AGE_BUCKET_MS 250
+
+/**
+ * @brief Did the vehicle state move enough to be worth a send?
+ *
+ * Exact comparison for real state (motors, status string, veto, the
+ * per-window latency/heap numbers, which are stable between monitor
+ * windows anyway); thresholded for battery drift and vision age, which
+ * otherwise tick on every pass and would defeat the gating.
+ */
+static bool status_changed(const vehicle_status_t *a, const vehicle_status_t *b)
+{
+    if (a->motor_left != b->motor_left ||
+        a->motor_right != b->motor_right ||
+        a->veto_active != b->veto_active ||
+        a->qos_shed != b->qos_shed ||
+        strcmp(a->status, b->status) != 0)
+    {
+        return true;
     }
+    if (abs(a->battery_mv - b->battery_mv) >= STATUS_BATTERY_DELTA_MV)
+    {
+        return true;
+    }
+    if ((a->vision_age_ms < 0) != (b->vision_age_ms < 0) ||
+        a->vision_age_ms / STATUS_VISION_AGE_BUCKET_MS !=
+            b->vision_age_ms / STATUS_VISION_AGE_BUCKET_MS)
+    {
+        return true;
+    }
+    return a->cmd_p50_us != b->cmd_p50_us ||
+           a->cmd_p95_us != b->cmd_p95_us ||
+           a->cmd_max_us != b->cmd_max_us ||
+           a->heap_free_kb != b->heap_free_kb ||
+           a->heap_largest_kb != b->heap_largest_kb ||
+           a->psram_free_kb != b->psram_free_kb ||
+           a->psram_largest_kb != b->psram_largest_kb;
 }
 
 /**
  * @brief Task: Status Transmission
  * Runs on Core 0 (Protocol CPU)
  * Priority: 4
+ *
+ * Samples at 100 ms but only transmits on change, with a 1 s heartbeat
+ * so the dashboard can still tell a quiet vehicle from a dead one.
+ * Deltas go out on the very next sample, so state actually propagates
+ * faster than the old fixed cadence ever guaranteed.
  */
 static void status_tx_task(void *pvParameters)
 {
@@ -143,6 +457,10 @@ static void status_tx_task(void *pvParameters)
     strncpy(status.vehicle_id, VEHICLE_ID, sizeof(status.vehicle_id) - 1);
     status.vehicle_id[sizeof(status.vehicle_id) - 1] = '\0';
 
+    vehicle_status_t last_sent;
+    bool have_sent = false;
+    TickType_t last_sent_tick = 0;
+
     while (1)
     {
         // Wait for WebSocket connection
@@ -156,32 +474,249 @@ static void status_tx_task(void *pvParameters)
             // Get current motor speeds using the correct API
             motor_get_speeds(&status.motor_left, &status.motor_right);
 
-            // Get battery voltage (simplified - using fixed value)
-            // In real implementation, read from ADC
-            status.battery_mv = 3700; // Placeholder
+            // Measured pack voltage (0 until the first ADC sample)
+            status.battery_mv = battery_get_millivolts();
 
             // Get control state as status string
             control_state_t state = autonomous_get_state();
             strncpy(status.status, autonomous_state_to_string(state), sizeof(status.status) - 1);
             status.status[sizeof(status.status) - 1] = '\0';
 
-            // Send status to server
-            esp_err_t err = ws_client_send_status(&status);
-            if (err != ESP_OK)
+            // How old is the frame behind the current veto decision?
+            vision_result_t vision;
+            if (vision_engine_get_result(&vision) == ESP_OK && vision.capture_time_us > 0)
+            {
+                status.vision_age_ms = (int)((esp_timer_get_time() - vision.capture_time_us) / 1000);
+            }
+            else
             {
-                ESP_LOGW(TAG, "Failed to send status");
+                status.vision_age_ms = -1;
             }
+            status.veto_active = vision_engine_is_veto_active();
+
+            // Actuation latency from the last monitor window
+            status.cmd_p50_us = (int)s_cmd_latency.p50_us;
+            status.cmd_p95_us = (int)s_cmd_latency.p95_us;
+            status.cmd_max_us = (int)s_cmd_latency.max_us;
+
+            // Heap snapshot from the last monitor window
+            status.heap_free_kb = s_heap_free_kb;
+            status.heap_largest_kb = s_heap_largest_kb;
+            status.psram_free_kb = s_psram_free_kb;
+            status.psram_largest_kb = s_psram_largest_kb;
+
+            // Shed state travels with the status so the dashboard can
+            // tell a governed degradation from a failing link
+            status.qos_shed = ws_client_get_qos_shed();
+
+            // Transmit only on change or heartbeat expiry; a failed
+            // send leaves last_sent untouched so the delta retries on
+            // the next pass
+            TickType_t now = xTaskGetTickCount();
+            bool due = !have_sent ||
+                       status_changed(&status, &last_sent) ||
+                       (now - last_sent_tick) >= pdMS_TO_TICKS(STATUS_HEARTBEAT_MS);
+            if (due)
+            {
+                esp_err_t err = ws_client_send_status(&status);
+                if (err == ESP_OK)
+                {
+                    last_sent = status;
+                    have_sent = true;
+                    last_sent_tick = now;
+                }
+                else
+                {
+                    ESP_LOGW(TAG, "Failed to send status");
+                }
+            }
+        }
+
+        // Sample every 100ms; the gate above decides whether it travels.
+        // At the last shed level the sampling itself is stretched - the
+        // heartbeat still proves liveness.
+        int sample_ms = (ws_client_get_qos_shed() >= QOS_SHED_STATUS) ? 500 : 100;
+        vTaskDelay(pdMS_TO_TICKS(sample_ms));
+    }
+}
+
+/**
+ * @brief Sample per-task CPU shares over the last monitor window
+ *
+ * uxTaskGetSystemState() exposes cumulative esp_timer-based run-time
+ * counters (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS); differencing two
+ * snapshots turns them into a per-window CPU share, which is what
+ * answers "who is starving whom on core 1 right now" - the cumulative
+ * numbers bury today's contention under days of history. FreeRTOS has
+ * no per-task context switch counter to export, so CPU share plus
+ * stack high-water mark is the pair that travels.
+ *
+ * @return Number of entries filled into out
+ */
+static int sample_task_stats(task_stats_entry_t *out, int max_entries)
+{
+    static uint32_t s_prev_counter[TASK_STATS_MAX];
+    static UBaseType_t s_prev_number[TASK_STATS_MAX];
+    static int s_prev_count = 0;
+    static uint32_t s_prev_total = 0;
+
+    TaskStatus_t snapshot[TASK_STATS_MAX];
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(snapshot, TASK_STATS_MAX, &total);
+    if (n == 0)
+    {
+        // Snapshot buffer too small - raise TASK_STATS_MAX
+        return 0;
+    }
+
+    uint32_t window = total - s_prev_total;
+
+    int count = 0;
+    for (UBaseType_t i = 0; i < n && count < max_entries; i++)
+    {
+        // First window for a task runs against a zero baseline, which
+        // degrades to its cumulative share - close enough at boot
+        uint32_t prev = 0;
+        for (int j = 0; j < s_prev_count; j++)
+        {
+            if (s_prev_number[j] == snapshot[i].xTaskNumber)
+            {
+                prev = s_prev_counter[j];
+                break;
+            }
+        }
+
+        task_stats_entry_t *entry = &out[count++];
+        strncpy(entry->name, snapshot[i].pcTaskName, sizeof(entry->name) - 1);
+        entry->name[sizeof(entry->name) - 1] = '\0';
+        uint32_t delta = snapshot[i].ulRunTimeCounter - prev;
+        entry->cpu_permille = (window > 0)
+                                  ? (int)(((uint64_t)delta * 1000) / window)
+                                  : 0;
+        entry->stack_hwm = (int)snapshot[i].usStackHighWaterMark;
+        entry->core = (snapshot[i].xCoreID == tskNO_AFFINITY)
+                          ? -1
+                          : (int)snapshot[i].xCoreID;
+        entry->priority = (int)snapshot[i].uxCurrentPriority;
+    }
+
+    // This snapshot becomes the next window's baseline
+    s_prev_count = (int)((n < TASK_STATS_MAX) ? n : TASK_STATS_MAX);
+    for (int i = 0; i < s_prev_count; i++)
+    {
+        s_prev_number[i] = snapshot[i].xTaskNumber;
+        s_prev_counter[i] = snapshot[i].ulRunTimeCounter;
+    }
+    s_prev_total = total;
+
+    return count;
+}
+
+// ============================================================
+// QOS LOAD-SHEDDING GOVERNOR
+// ============================================================
+// Under pressure the failure order used to be emergent: whatever
+// allocation or deadline broke first decided what degraded, and
+// sometimes the stream survived while veto latency suffered. The
+// governor makes the order explicit - stream quality, then stream
+// rate, then the stream itself, then the status cadence - and the
+// veto loop is never shed: the vision task keeps its CPU and frame
+// budget at every level.
+//
+// Escalation fires when any pressure signal trips; recovery needs
+// every signal healthy by a margin. One step per monitor window in
+// either direction keeps the ladder from flapping.
+
+// Internal-heap largest-free-block thresholds (bytes). frame2jpg needs
+// contiguous blocks, so the largest block - not total free - is the
+// number that predicts its failure.
+#define QOS_HEAP_LARGEST_SHED (40 * 1024)
+#define QOS_HEAP_LARGEST_RECOVER (56 * 1024)
+
+// Core 1 busy-share thresholds, permille of both cores: a saturated
+// core tops out at 500
+#define QOS_CORE1_BUSY_SHED 470
+#define QOS_CORE1_BUSY_RECOVER 420
+
+// Vision frame age thresholds (ms): several frame periods of staleness
+// means the vision task is being starved
+#define QOS_VISION_AGE_SHED_MS 400
+#define QOS_VISION_AGE_RECOVER_MS 250
+
+static int s_qos_level = QOS_SHED_NONE;
+
+/**
+ * @brief One governor step, evaluated per monitor window
+ *
+ * Inputs are the samples monitor_task already takes: the internal-heap
+ * largest free block, the per-window task CPU shares, and the age of
+ * the current vision result.
+ */
+static void qos_governor_step(size_t heap_largest,
+                              const task_stats_entry_t *stats, int task_count)
+{
+    // Core 1 busy share: everything pinned there except its idle task
+    int core1_busy = 0;
+    for (int i = 0; i < task_count; i++)
+    {
+        if (stats[i].core == 1 && strncmp(stats[i].name, "IDLE", 4) != 0)
+        {
+            core1_busy += stats[i].cpu_permille;
         }
+    }
 
-        // Send status every 100ms
-        vTaskDelay(pdMS_TO_TICKS(100));
+    int vision_age_ms = -1;
+    vision_result_t vision;
+    if (vision_engine_get_result(&vision) == ESP_OK && vision.capture_time_us > 0)
+    {
+        vision_age_ms = (int)((esp_timer_get_time() - vision.capture_time_us) / 1000);
+    }
+
+    bool pressure = heap_largest < QOS_HEAP_LARGEST_SHED ||
+                    core1_busy >= QOS_CORE1_BUSY_SHED ||
+                    vision_age_ms > QOS_VISION_AGE_SHED_MS;
+    bool healthy = heap_largest >= QOS_HEAP_LARGEST_RECOVER &&
+                   core1_busy < QOS_CORE1_BUSY_RECOVER &&
+                   vision_age_ms < QOS_VISION_AGE_RECOVER_MS;
+
+    if (pressure && s_qos_level < QOS_SHED_STATUS)
+    {
+        s_qos_level++;
+        ESP_LOGW(TAG, "QoS shed -> level %d (heap largest=%u, core1=%d.%d%%, vision age=%d ms)",
+                 s_qos_level, (unsigned)heap_largest,
+                 core1_busy / 10, core1_busy % 10, vision_age_ms);
+        ws_client_set_qos_shed(s_qos_level);
     }
+    else if (!pressure && healthy && s_qos_level > QOS_SHED_NONE)
+    {
+        s_qos_level--;
+        ESP_LOGI(TAG, "QoS recovered -> level %d", s_qos_level);
+        ws_client_set_qos_shed(s_qos_level);
+    }
+}
+
+/**
+ * @brief Saturate a latency/size sample into a wire-format field
+ */
+static uint16_t monitor_u16(uint32_t value)
+{
+    return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
 }
 
+// Batch staging for the telemetry shipper; monitor_task only, kept out
+// of its 2 KB stack
+static uint8_t s_telemetry_batch[4 + TELEMETRY_BATCH_MAX * sizeof(telemetry_record_t)];
+
 /**
- * @brief Task: Battery/System Monitor
+ * @brief Task: Telemetry Sampler / System Monitor
  * Runs on Core 1 (Application CPU)
  * Priority: 3 (Low)
+ *
+ * Samples the same window the old log lines covered, but the steady
+ * state writes one compact binary record to the telemetry ring instead
+ * of printf-formatting the UART. Records ship over the WebSocket on
+ * the idle TX class; the UART only speaks when something is anomalous
+ * (fragmentation lows, QoS transitions, link loss).
  */
 static void monitor_task(void *pvParameters)
 {
@@ -189,16 +724,162 @@ static void monitor_task(void *pvParameters)
 
     while (1)
     {
-        // Get motor speeds for logging
+        telemetry_record_t rec = {0};
+        rec.t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+        // Motor state and link picture of the window
         int left_speed, right_speed;
         motor_get_speeds(&left_speed, &right_speed);
+        rec.motor_left = (int16_t)left_speed;
+        rec.motor_right = (int16_t)right_speed;
+        rec.state = (uint8_t)autonomous_get_state();
+        rec.wifi_rssi = (int8_t)wifi_station_get_rssi();
+        rec.qos_shed = (uint8_t)ws_client_get_qos_shed();
+        if (vision_engine_is_veto_active())
+        {
+            rec.flags |= TELEMETRY_FLAG_VETO;
+        }
+        if (ws_client_is_connected())
+        {
+            rec.flags |= TELEMETRY_FLAG_WS;
+        }
+        if (wifi_station_is_connected())
+        {
+            rec.flags |= TELEMETRY_FLAG_WIFI;
+        }
+
+        // Tail latency since the last report - the veto budget lives here
+        vision_latency_stats_t process_lat, publish_lat;
+        vision_engine_get_latency_stats(&process_lat, &publish_lat);
+        rec.vis_proc_p95_ms = monitor_u16(process_lat.p95_ms);
+        rec.vis_pub_p95_ms = monitor_u16(publish_lat.p95_ms);
+
+        // Frames the driver overwrote because vision fell behind, plus
+        // how stale each frame already was when fb_get handed it over
+        vision_capture_stats_t cap;
+        vision_engine_get_capture_stats(&cap);
+        rec.cap_age_p95_ms = monitor_u16(cap.age.p95_ms);
+        rec.cap_overwritten = (uint16_t)cap.overwritten;
+
+        // Actuation latency: receipt -> dispatch -> PWM write. This is
+        // the ground truth the control-path reworks are judged against.
+        control_latency_stats_t lat_queue, lat_apply, lat_total;
+        autonomous_get_latency_stats(&lat_queue, &lat_apply, &lat_total);
+        if (lat_total.sample_count > 0)
+        {
+            rec.cmd_p95_us = monitor_u16(lat_total.p95_us);
+            s_cmd_latency = lat_total;
+        }
 
-        // Log system status periodically
-        ESP_LOGI(TAG, "Status: WiFi=%s, WebSocket=%s, State=%s, Motors=[L:%d, R:%d]",
-                 wifi_station_is_connected() ? "OK" : "DISCONNECTED",
-                 ws_client_is_connected() ? "OK" : "DISCONNECTED",
-                 autonomous_state_to_string(autonomous_get_state()),
-                 left_speed, right_speed);
+        // Scheduler picture of the window: per-task CPU share and stack
+        // headroom; the record keeps the busiest task per core, the
+        // full breakdown still goes out as the task_stats message
+        task_stats_entry_t task_stats[TASK_STATS_MAX];
+        int task_count = sample_task_stats(task_stats, TASK_STATS_MAX);
+        if (task_count > 0)
+        {
+            int top0 = -1, top1 = -1;
+            for (int i = 0; i < task_count; i++)
+            {
+                if (task_stats[i].core == 0 &&
+                    (top0 < 0 || task_stats[i].cpu_permille > task_stats[top0].cpu_permille))
+                {
+                    top0 = i;
+                }
+                if (task_stats[i].core == 1 &&
+                    (top1 < 0 || task_stats[i].cpu_permille > task_stats[top1].cpu_permille))
+                {
+                    top1 = i;
+                }
+            }
+            if (top0 >= 0)
+            {
+                rec.cpu0_permille = (uint16_t)task_stats[top0].cpu_permille;
+                strncpy(rec.cpu0_task, task_stats[top0].name, sizeof(rec.cpu0_task) - 1);
+            }
+            if (top1 >= 0)
+            {
+                rec.cpu1_permille = (uint16_t)task_stats[top1].cpu_permille;
+                strncpy(rec.cpu1_task, task_stats[top1].name, sizeof(rec.cpu1_task) - 1);
+            }
+
+            if (ws_client_is_connected())
+            {
+                ws_client_send_task_stats(task_stats, task_count);
+            }
+        }
+
+        // Heap fragmentation per capability. Fragmentation shows up as
+        // the largest free block shrinking while total free holds; a
+        // new all-time low of the largest block is the regression worth
+        // shouting about before frame2jpg starts failing.
+        multi_heap_info_t heap_int, heap_psram;
+        heap_caps_get_info(&heap_int, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        heap_caps_get_info(&heap_psram, MALLOC_CAP_SPIRAM);
+        rec.heap_free_kb = monitor_u16(heap_int.total_free_bytes / 1024);
+        rec.heap_largest_kb = monitor_u16(heap_int.largest_free_block / 1024);
+        rec.psram_free_kb = monitor_u16(heap_psram.total_free_bytes / 1024);
+        rec.psram_largest_kb = monitor_u16(heap_psram.largest_free_block / 1024);
+
+        // Vision scratch arena: a high-water mark near the region size
+        // means the next stage addition starts spilling to PSRAM
+        size_t arena_int_hwm = 0, arena_psram_hwm = 0;
+        mem_arena_high_water(&arena_int_hwm, &arena_psram_hwm);
+        rec.arena_int_hwm = (uint32_t)arena_int_hwm;
+        rec.arena_psram_hwm = (uint32_t)arena_psram_hwm;
+
+        static size_t largest_low_int = (size_t)-1;
+        static size_t largest_low_psram = (size_t)-1;
+        if (heap_int.largest_free_block < largest_low_int)
+        {
+            if (largest_low_int != (size_t)-1)
+            {
+                ESP_LOGW(TAG, "Internal heap fragmenting: largest block down to %u (free %u)",
+                         (unsigned)heap_int.largest_free_block,
+                         (unsigned)heap_int.total_free_bytes);
+            }
+            largest_low_int = heap_int.largest_free_block;
+        }
+        if (heap_psram.largest_free_block < largest_low_psram)
+        {
+            if (largest_low_psram != (size_t)-1)
+            {
+                ESP_LOGW(TAG, "PSRAM fragmenting: largest block down to %u (free %u)",
+                         (unsigned)heap_psram.largest_free_block,
+                         (unsigned)heap_psram.total_free_bytes);
+            }
+            largest_low_psram = heap_psram.largest_free_block;
+        }
+
+        s_heap_free_kb = (int)(heap_int.total_free_bytes / 1024);
+        s_heap_largest_kb = (int)(heap_int.largest_free_block / 1024);
+        s_psram_free_kb = (int)(heap_psram.total_free_bytes / 1024);
+        s_psram_largest_kb = (int)(heap_psram.largest_free_block / 1024);
+
+        // Feed the shed ladder from the window just sampled
+        qos_governor_step(heap_int.largest_free_block, task_stats, task_count);
+
+        // One health sample per monitor window for the flight recorder
+        blackbox_record(BB_REC_SYS, vision_engine_is_veto_active() ? 1 : 0,
+                        s_heap_free_kb, (int32_t)s_cmd_latency.p95_us);
+
+        // Retain the window and ship what the link can take. Two
+        // batches a window drains a disconnect backlog at 16 records
+        // per cycle without ever monopolizing the idle TX class.
+        telemetry_append(&rec);
+        if (ws_client_is_connected())
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                size_t batch_len = telemetry_build_batch(s_telemetry_batch,
+                                                         sizeof(s_telemetry_batch));
+                if (batch_len == 0 ||
+                    ws_client_send_telemetry(s_telemetry_batch, batch_len) != ESP_OK)
+                {
+                    break;
+                }
+            }
+        }
 
         // Check for emergency conditions
         if (!wifi_station_is_connected())
@@ -213,47 +894,73 @@ static void monitor_task(void *pvParameters)
     }
 }
 
+// Set by any init track that hits a non-recoverable failure; checked
+// once at the rendezvous so app_main keeps its fail-and-halt semantics
+static volatile bool s_init_fatal = false;
+
 /**
- * @brief Main application entry point
+ * @brief Bring-up track: drivetrain (motors, encoders, battery, state)
+ *
+ * The three init tracks run as short-lived tasks so the slow steps
+ * overlap: camera SCCB configuration, WiFi association and motor/ADC
+ * setup have no dependencies on each other. Deliberately allocated
+ * dynamically - they are exactly the kind of boot-time transient the
+ * heap is reserved for, and their stacks are returned on exit.
  */
-void app_main(void)
+static void motor_init_task(void *arg)
 {
-    ESP_LOGI(TAG, "====================================");
-    ESP_LOGI(TAG, "ESP32-CAM Autonomous Vehicle Client");
-    ESP_LOGI(TAG, "Vehicle ID: %s", VEHICLE_ID);
-    ESP_LOGI(TAG, "====================================");
+    (void)arg;
 
-    // Create event group
-    system_events = xEventGroupCreate();
-    if (system_events == NULL)
+    ESP_LOGI(TAG, "Initializing motor control...");
+    if (motor_control_init() != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to create event group");
-        return;
+        ESP_LOGE(TAG, "Failed to initialize motor control");
+        s_init_fatal = true;
+    }
+    // Wheel encoders: closed-loop speed and odometry. Not fatal -
+    // without them motor control simply stays open-loop.
+    else if (encoder_init() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Encoders unavailable, staying open-loop");
     }
 
-    // Create command queue
-    command_queue = xQueueCreate(10, sizeof(control_message_t));
-    if (command_queue == NULL)
+    // Battery monitor: real telemetry for the status message. Not
+    // fatal - without it the status reports 0 (unknown).
+    if (!s_init_fatal && battery_init(battery_low_callback) != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to create control queue");
-        return;
+        ESP_LOGW(TAG, "Battery monitor unavailable");
     }
 
-    // Initialize motor control
-    ESP_LOGI(TAG, "Initializing motor control...");
-    if (motor_control_init() != ESP_OK)
+    if (!s_init_fatal && autonomous_init() != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to initialize motor control");
-        return;
+        ESP_LOGE(TAG, "Failed to initialize autonomous control");
+        s_init_fatal = true;
     }
 
-    // Initialize vision engine (local camera-based obstacle detection)
+    xEventGroupSetBits(system_events, INIT_MOTOR_READY_BIT);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Bring-up track: camera and vision pipeline
+ *
+ * The longest track - init_camera() walks ~20 blocking SCCB register
+ * writes. Failure is not fatal: the vehicle operates without local
+ * vision, just without the veto. Running on core 1 also places the
+ * camera DMA interrupt there (allocation follows the calling core),
+ * next to the task that consumes its frames; the runtime reinit path
+ * (capture_tuning_apply) reallocates it from the vision task, which is
+ * pinned to the same core.
+ */
+static void vision_init_task(void *arg)
+{
+    (void)arg;
+
     ESP_LOGI(TAG, "Initializing vision engine...");
     if (vision_engine_init() != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to initialize vision engine");
         ESP_LOGW(TAG, "Continuing without local vision (veto disabled)");
-        // Don't return - can operate without local vision, just without veto
     }
     else
     {
@@ -268,41 +975,177 @@ void app_main(void)
         }
     }
 
-    // Initialize autonomous control
-    ESP_LOGI(TAG, "Initializing autonomous control...");
-    if (autonomous_init() != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to initialize autonomous control");
-        return;
-    }
+    xEventGroupSetBits(system_events, INIT_VISION_READY_BIT);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Bring-up track: WiFi association and message-plane setup
+ *
+ * Stops short of ws_client_connect(): the connect is issued by
+ * app_main after the rendezvous, so a fast server cannot invoke the
+ * capture/HSV config callbacks while the camera is still mid-init on
+ * the vision track.
+ */
+static void network_init_task(void *arg)
+{
+    (void)arg;
 
-    // Initialize WiFi Station
     ESP_LOGI(TAG, "Initializing WiFi Station...");
     if (wifi_station_init() != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to initialize WiFi");
-        return;
+        s_init_fatal = true;
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Connecting to WiFi...");
+        if (wifi_station_connect() != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to connect to WiFi");
+            s_init_fatal = true;
+        }
     }
 
-    // Connect to WiFi
-    ESP_LOGI(TAG, "Connecting to WiFi...");
-    if (wifi_station_connect() != ESP_OK)
+    if (!s_init_fatal)
     {
-        ESP_LOGE(TAG, "Failed to connect to WiFi");
-        autonomous_emergency_stop();
-        return;
+        xEventGroupSetBits(system_events, WIFI_CONNECTED_BIT);
+        ESP_LOGI(TAG, "WiFi connected successfully");
+
+        // ESP-NOW side channel: emergency stops bypass the TCP stack.
+        // Not fatal - the WebSocket still carries every command.
+        if (espnow_link_init(control_command_callback) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "ESP-NOW unavailable, stop commands stay on WebSocket");
+        }
+
+        ESP_LOGI(TAG, "Initializing WebSocket client...");
+        if (ws_client_init(VEHICLE_ID, control_command_callback) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to initialize WebSocket client");
+            s_init_fatal = true;
+        }
     }
 
-    xEventGroupSetBits(system_events, WIFI_CONNECTED_BIT);
-    ESP_LOGI(TAG, "WiFi connected successfully");
+    if (!s_init_fatal)
+    {
+#if UDP_STREAM_ENABLED
+        // Datagram channel for video only; registration, control and
+        // status keep the reliable WebSocket. Failure here just means
+        // all traffic stays on TCP.
+        if (udp_stream_init("192.168.4.1", UDP_STREAM_PORT) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "UDP video channel unavailable, staying on WebSocket");
+        }
+#endif
+
+        // Let the dashboard retune the camera capture profile at runtime
+        ws_client_set_capture_config_callback(capture_config_callback);
+
+        // And the HSV detector thresholds, when the course lighting changes
+        ws_client_set_hsv_config_callback(hsv_config_callback);
+
+        // Link edges wake the control task instead of being polled
+        ws_client_set_connection_callback(ws_connection_callback);
+    }
 
-    // Initialize WebSocket client
-    ESP_LOGI(TAG, "Initializing WebSocket client...");
-    if (ws_client_init(VEHICLE_ID, control_command_callback) != ESP_OK)
+    xEventGroupSetBits(system_events, INIT_NETWORK_READY_BIT);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Main application entry point
+ */
+void app_main(void)
+{
+    ESP_LOGI(TAG, "====================================");
+    ESP_LOGI(TAG, "ESP32-CAM Autonomous Vehicle Client");
+    ESP_LOGI(TAG, "Vehicle ID: %s", VEHICLE_ID);
+    ESP_LOGI(TAG, "====================================");
+
+    // DFS: 240 MHz whenever the vision/encode pipeline holds its CPU
+    // lock (see vision_engine.c), 80 MHz otherwise, with automatic
+    // light sleep once the pipeline also drops its wake lock while
+    // parked. The control task needs no special casing: stopped, it
+    // blocks on its event bits and tickless idle sleeps right through;
+    // moving, the pipeline's wake lock is held and the dead-man timer
+    // wakes it on schedule as before.
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = 240,
+        .min_freq_mhz = 80,
+        .light_sleep_enable = true,
+    };
+    esp_err_t pm_err = esp_pm_configure(&pm_config);
+    if (pm_err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to initialize WebSocket client");
+        // ESP_ERR_NOT_SUPPORTED = built without CONFIG_PM_ENABLE
+        ESP_LOGW(TAG, "Power management unavailable (0x%x) - fixed frequency", pm_err);
+    }
+
+    // Create event group (statically backed - cannot fail)
+    system_events = xEventGroupCreateStatic(&s_system_events_buf);
+
+    // Latest-wins command mailbox (see control_command_callback)
+    command_queue = xQueueCreateStatic(1, sizeof(control_message_t),
+                                       s_command_queue_storage,
+                                       &s_command_queue_buf);
+
+    // Flight recorder: armed before the bring-up tracks so the boot
+    // sequence itself is already on record. Not fatal without PSRAM.
+    blackbox_init();
+
+    // Telemetry ring for the monitor windows; same PSRAM budget rules
+    telemetry_init();
+
+    // Offline-tuning capture; a missing dataset partition just leaves
+    // it disabled
+    dataset_capture_init();
+
+    // Launch the three independent bring-up tracks concurrently. Vision
+    // (slow SCCB walk) goes to core 1 and networking next to the WiFi
+    // stack on core 0 - the tracks overlap their blocking waits instead
+    // of serializing them. The pinning doubles as ISR placement:
+    // esp_intr_alloc() allocates on the calling core, so the camera DMA
+    // interrupt lands on core 1 with the vision task that consumes its
+    // frames, while the WiFi MAC and LEDC fade interrupts stay on core
+    // 0, off the vision core. That is why the drivetrain track is
+    // pinned to core 0 even though nothing it starts runs there.
+    ESP_LOGI(TAG, "Starting parallel bring-up...");
+    BaseType_t spawn_ok = pdTRUE;
+    spawn_ok &= xTaskCreatePinnedToCore(motor_init_task, "init_motor",
+                                        3072, NULL, 5, NULL, 0);
+    spawn_ok &= xTaskCreatePinnedToCore(vision_init_task, "init_vision",
+                                        4096, NULL, 5, NULL, 1);
+    spawn_ok &= xTaskCreatePinnedToCore(network_init_task, "init_net",
+                                        STACK_SIZE_WIFI, NULL, 5, NULL, 0);
+    if (spawn_ok != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to spawn bring-up tasks");
+        return;
+    }
+
+    // Rendezvous: every track raises its bit pass or fail; fatal
+    // failures land in s_init_fatal and are handled once, here
+    EventBits_t ready = xEventGroupWaitBits(system_events, INIT_READY_BITS,
+                                            pdFALSE, pdTRUE,
+                                            pdMS_TO_TICKS(INIT_JOIN_TIMEOUT_MS));
+    if ((ready & INIT_READY_BITS) != INIT_READY_BITS)
+    {
+        ESP_LOGE(TAG, "Bring-up timed out (ready bits 0x%lx)",
+                 (unsigned long)(ready & INIT_READY_BITS));
         return;
     }
+    if (s_init_fatal)
+    {
+        ESP_LOGE(TAG, "Bring-up failed - halting");
+        autonomous_emergency_stop();
+        return;
+    }
+
+    // Veto edges cut forward motion from the vision task itself and
+    // wake the control task (see vision_veto_edge_callback). Wired
+    // after the rendezvous: both vision and autonomous state exist now.
+    vision_engine_set_veto_edge_callback(vision_veto_edge_callback);
 
     // Connect to WebSocket
     ESP_LOGI(TAG, "Connecting to WebSocket server...");
@@ -312,66 +1155,84 @@ void app_main(void)
         return;
     }
 
-    // Give WebSocket time to establish connection
-    vTaskDelay(pdMS_TO_TICKS(2000));
-
-    if (ws_client_is_connected())
+    // Wait for the link event instead of sleeping a fixed two seconds;
+    // ws_connection_callback raises the bit the moment the handshake
+    // lands. On timeout we start anyway - the reconnect backoff keeps
+    // retrying in the background.
+    EventBits_t link = xEventGroupWaitBits(system_events, WEBSOCKET_CONNECTED_BIT,
+                                           pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(WS_CONNECT_WAIT_MS));
+    if (link & WEBSOCKET_CONNECTED_BIT)
     {
-        xEventGroupSetBits(system_events, WEBSOCKET_CONNECTED_BIT);
         ESP_LOGI(TAG, "WebSocket connected successfully");
     }
+    else
+    {
+        ESP_LOGW(TAG, "WebSocket not up yet, continuing (reconnect pending)");
+    }
 
     // Create FreeRTOS tasks with core affinity
     ESP_LOGI(TAG, "Creating FreeRTOS tasks...");
 
-    // Control task on Core 1 (Application CPU)
-    BaseType_t ret = xTaskCreatePinnedToCore(
+    // Control task on Core 1 (Application CPU). Statically backed task
+    // creation only fails on bad arguments, not on heap pressure.
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(
         control_task,
         "control_task",
         STACK_SIZE_CONTROL,
         NULL,
         6, // High priority
-        NULL,
+        s_control_stack,
+        &s_control_tcb,
         1 // Core 1
     );
-    if (ret != pdPASS)
+    if (handle == NULL)
     {
         ESP_LOGE(TAG, "Failed to create control task");
         return;
     }
 
     // Status transmission task on Core 0 (Protocol CPU)
-    ret = xTaskCreatePinnedToCore(
+    handle = xTaskCreateStaticPinnedToCore(
         status_tx_task,
         "status_tx_task",
         STACK_SIZE_WS_TX,
         NULL,
         4, // Medium priority
-        NULL,
+        s_status_tx_stack,
+        &s_status_tx_tcb,
         0 // Core 0
     );
-    if (ret != pdPASS)
+    if (handle == NULL)
     {
         ESP_LOGE(TAG, "Failed to create status transmission task");
         return;
     }
 
     // Monitor task on Core 1
-    ret = xTaskCreatePinnedToCore(
+    handle = xTaskCreateStaticPinnedToCore(
         monitor_task,
         "monitor_task",
         STACK_SIZE_MONITOR,
         NULL,
         3, // Low priority
-        NULL,
+        s_monitor_stack,
+        &s_monitor_tcb,
         1 // Core 1
     );
-    if (ret != pdPASS)
+    if (handle == NULL)
     {
         ESP_LOGE(TAG, "Failed to create monitor task");
         return;
     }
 
+    // Audit the invisible half of the core-affinity strategy: every
+    // installed interrupt with its core, source and flags. Camera DMA
+    // must show on core 1 and WiFi/LEDC on core 0 - an ISR that moved
+    // (a driver init called from the wrong task) shows up here long
+    // before it shows up as vision jitter.
+    esp_intr_dump(NULL);
+
     ESP_LOGI(TAG, "System initialization complete - manual control ready");
     ESP_LOGI(TAG, "Waiting for dashboard commands to drive motors");
 }
\ No newline at end of file
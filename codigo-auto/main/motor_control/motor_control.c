@@ -5,14 +5,20 @@
  * L298N Control Logic:
  * - Forward:  IN1=HIGH, IN2=LOW,  ENA=PWM
  * - Reverse:  IN1=LOW,  IN2=HIGH, ENA=PWM
- * - Brake:    IN1=HIGH, IN2=HIGH, ENA=HIGH (or LOW)
- * - Coast:    IN1=LOW,  IN2=LOW,  ENA=any
+ * - Brake:    IN1=HIGH, IN2=HIGH, ENA=HIGH (slow decay)
+ * - Coast:    IN1=LOW,  IN2=LOW,  ENA=any  (fast decay)
+ *
+ * Commanded stops default to brake decay (shorter veto stopping
+ * distance); direction reversals pass through a short coast gap so the
+ * bridge is never slammed from one polarity into the other.
  */
 
 #include "motor_control.h"
+#include "blackbox/blackbox.h"
 #include "driver/ledc.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 
@@ -22,8 +28,21 @@ static const char *TAG = "[Motors]";
 static int s_left_speed = 0;
 static int s_right_speed = 0;
 
+// Acceleration ramp: duty changes towards a non-zero target run in the
+// LEDC fade engine over this window, so the wheels load up gradually
+// instead of slipping on an instant duty step. 0 disables ramping.
+static int s_ramp_time_ms = MOTOR_RAMP_TIME_MS;
+
+// Decay mode for commanded stops (emergency stop always brakes)
+static motor_stop_mode_t s_stop_mode = MOTOR_STOP_BRAKE;
+
+// Last commanded direction per LEDC channel (-1/0/+1), to detect
+// reversals that need the dead-time coast gap
+static int s_prev_sign[2] = {0, 0};
+
 // Mutex for thread-safe motor control
 static SemaphoreHandle_t s_motor_mutex = NULL;
+static StaticSemaphore_t s_motor_mutex_buf; // Permanent mutex lives in BSS
 
 /**
  * @brief Clamp speed to valid range [-255, 255]
@@ -37,61 +56,181 @@ static inline int clamp_speed(int speed)
     return speed;
 }
 
+// ============================================================================
+// SETPOINT PREPARE/COMMIT
+// ============================================================================
+// A differential setpoint used to be applied one wheel at a time, each
+// call doing its own GPIO direction writes plus duty update: a
+// preemption between the two calls left the vehicle driving a brief
+// unintended arc, and a turn-in-place paid the reversal dead time
+// twice. The setpoint is now prepared per channel without touching
+// hardware, then committed for both channels as one actuation event:
+// reversing channels coast through a single shared dead-time gap, all
+// direction pins flip inside one critical section, and the two duty
+// commits are issued back to back - both channels run off LEDC_TIMER_0,
+// so duty updates landing within one PWM period latch on the same
+// timer overflow. Worst case is one period of magnitude skew with the
+// polarities already consistent, instead of an arbitrary preemption
+// window with one wheel on the old command.
+
+typedef struct
+{
+    int in1_gpio;
+    int in2_gpio;
+    ledc_channel_t channel;
+    int in1_level;
+    int in2_level;
+    uint32_t duty; // 0-255
+    int sign;
+    bool use_fade;
+    bool needs_dead_time; // Polarity reversal: coast gap before commit
+} motor_plan_t;
+
+static portMUX_TYPE s_commit_mux = portMUX_INITIALIZER_UNLOCKED;
+
 /**
- * @brief Set L298N motor direction and speed
- *
- * @param in1_gpio First direction pin
- * @param in2_gpio Second direction pin
- * @param pwm_channel LEDC channel for PWM
- * @param speed Motor speed (-255 to 255)
+ * @brief Work out everything a channel commit needs, hardware untouched
  */
-static esp_err_t apply_motor_speed_l298n(int in1_gpio, int in2_gpio,
-                                         ledc_channel_t pwm_channel, int speed)
+static void motor_plan_prepare(motor_plan_t *plan, int in1_gpio, int in2_gpio,
+                               ledc_channel_t channel, int speed)
 {
     speed = clamp_speed(speed);
 
-    uint32_t duty = abs(speed); // 0-255
+    int channel_index = (channel == LEDC_CHANNEL_0) ? 0 : 1;
+    int sign = (speed > 0) - (speed < 0);
+
+    plan->in1_gpio = in1_gpio;
+    plan->in2_gpio = in2_gpio;
+    plan->channel = channel;
+    plan->sign = sign;
+    plan->duty = (uint32_t)abs(speed); // 0-255
+    plan->needs_dead_time = (sign != 0 && s_prev_sign[channel_index] == -sign);
+    // Non-zero targets ramp in the fade engine - zero CPU involvement
+    // after the commit. Stops keep the instant path (including the
+    // full brake duty): a commanded stop must bite now, not fade in.
+    plan->use_fade = (s_ramp_time_ms > 0 && sign != 0);
 
     if (speed > 0)
     {
         // Forward: IN1=HIGH, IN2=LOW
-        gpio_set_level(in1_gpio, 1);
-        gpio_set_level(in2_gpio, 0);
+        plan->in1_level = 1;
+        plan->in2_level = 0;
     }
     else if (speed < 0)
     {
         // Reverse: IN1=LOW, IN2=HIGH
-        gpio_set_level(in1_gpio, 0);
-        gpio_set_level(in2_gpio, 1);
+        plan->in1_level = 0;
+        plan->in2_level = 1;
+    }
+    else if (s_stop_mode == MOTOR_STOP_BRAKE)
+    {
+        // Stop (brake, slow decay): IN1=HIGH, IN2=HIGH shorts the
+        // winding and stops the wheel quickly
+        plan->in1_level = 1;
+        plan->in2_level = 1;
+        plan->duty = 255;
     }
     else
     {
-        // Stop (coast): IN1=LOW, IN2=LOW
-        gpio_set_level(in1_gpio, 0);
-        gpio_set_level(in2_gpio, 0);
-        duty = 0;
+        // Stop (coast, fast decay): IN1=LOW, IN2=LOW
+        plan->in1_level = 0;
+        plan->in2_level = 0;
+        plan->duty = 0;
     }
+}
 
-    // Set PWM duty cycle
-    esp_err_t err = ledc_set_duty(LEDC_LOW_SPEED_MODE, pwm_channel, duty);
-    if (err == ESP_OK)
+/**
+ * @brief Commit prepared channels as a single actuation event
+ */
+static esp_err_t motor_plan_commit(const motor_plan_t *plans, int count)
+{
+    // Dead time on reversal: the bridge never switches straight from
+    // one polarity into the other. Every reversing channel coasts
+    // first, then ONE shared gap covers them all - a turn-in-place no
+    // longer pays it per wheel.
+    bool any_dead_time = false;
+    for (int i = 0; i < count; i++)
+    {
+        if (plans[i].needs_dead_time)
+        {
+            gpio_set_level(plans[i].in1_gpio, 0);
+            gpio_set_level(plans[i].in2_gpio, 0);
+            ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, plans[i].channel, 0, 0);
+            any_dead_time = true;
+        }
+    }
+    if (any_dead_time)
     {
-        err = ledc_update_duty(LEDC_LOW_SPEED_MODE, pwm_channel);
+        esp_rom_delay_us(MOTOR_REVERSAL_DEAD_TIME_US);
     }
 
-    return err;
+    // Direction pins for all channels flip with preemption and
+    // interrupts off: polarity is never split across wheels
+    portENTER_CRITICAL(&s_commit_mux);
+    for (int i = 0; i < count; i++)
+    {
+        gpio_set_level(plans[i].in1_gpio, plans[i].in1_level);
+        gpio_set_level(plans[i].in2_gpio, plans[i].in2_level);
+    }
+    portEXIT_CRITICAL(&s_commit_mux);
+
+    // Duty commits back to back. The fade calls may take the fade
+    // service lock, so they cannot sit inside the critical section;
+    // issued adjacently they land within one PWM period and latch on
+    // the same LEDC_TIMER_0 overflow (and a fade spreads the change
+    // over the whole ramp window anyway).
+    esp_err_t result = ESP_OK;
+    for (int i = 0; i < count; i++)
+    {
+        esp_err_t err;
+        if (plans[i].use_fade)
+        {
+            err = ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, plans[i].channel,
+                                          plans[i].duty, s_ramp_time_ms);
+            if (err == ESP_OK)
+            {
+                err = ledc_fade_start(LEDC_LOW_SPEED_MODE, plans[i].channel,
+                                      LEDC_FADE_NO_WAIT);
+            }
+        }
+        else
+        {
+            // Cancels any fade in flight (the fade service serializes
+            // this against its own updates)
+            err = ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE,
+                                           plans[i].channel, plans[i].duty, 0);
+        }
+
+        s_prev_sign[(plans[i].channel == LEDC_CHANNEL_0) ? 0 : 1] = plans[i].sign;
+        if (err != ESP_OK)
+        {
+            result = err;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Set L298N motor direction and speed (single channel)
+ *
+ * @param in1_gpio First direction pin
+ * @param in2_gpio Second direction pin
+ * @param pwm_channel LEDC channel for PWM
+ * @param speed Motor speed (-255 to 255)
+ */
+static esp_err_t apply_motor_speed_l298n(int in1_gpio, int in2_gpio,
+                                         ledc_channel_t pwm_channel, int speed)
+{
+    motor_plan_t plan;
+    motor_plan_prepare(&plan, in1_gpio, in2_gpio, pwm_channel, speed);
+    return motor_plan_commit(&plan, 1);
 }
 
 esp_err_t motor_control_init(void)
 {
     ESP_LOGI(TAG, "Initializing L298N motor control...");
 
-    s_motor_mutex = xSemaphoreCreateMutex();
-    if (!s_motor_mutex)
-    {
-        ESP_LOGE(TAG, "Failed to create motor mutex");
-        return ESP_FAIL;
-    }
+    s_motor_mutex = xSemaphoreCreateMutexStatic(&s_motor_mutex_buf);
 
     // --- Configure Direction GPIOs (IN1, IN2, IN3, IN4) ---
     gpio_config_t io_conf = {
@@ -142,6 +281,12 @@ esp_err_t motor_control_init(void)
         .hpoint = 0};
     ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel_right));
 
+    // Fade service: runs the acceleration ramps in hardware. Its
+    // fade-end interrupt is allocated on the calling core - the
+    // drivetrain bring-up track is pinned to core 0 precisely so this
+    // ISR stays off the vision core.
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+
     ESP_LOGI(TAG, "Motor control initialized successfully");
     ESP_LOGI(TAG, "Left motor:  ENA=GPIO%d, IN1=GPIO%d, IN2=GPIO%d",
              MOTOR_LEFT_PWM_GPIO, MOTOR_LEFT_IN1_GPIO, MOTOR_LEFT_IN2_GPIO);
@@ -158,22 +303,31 @@ esp_err_t motor_set_speed(int left_speed, int right_speed)
 
     if (xSemaphoreTake(s_motor_mutex, pdMS_TO_TICKS(100)))
     {
-        esp_err_t err_left = apply_motor_speed_l298n(
-            MOTOR_LEFT_IN1_GPIO, MOTOR_LEFT_IN2_GPIO,
-            LEDC_CHANNEL_0, left_speed);
-
-        esp_err_t err_right = apply_motor_speed_l298n(
-            MOTOR_RIGHT_IN1_GPIO, MOTOR_RIGHT_IN2_GPIO,
-            LEDC_CHANNEL_1, right_speed);
+        // Both channels prepared first, then committed as one
+        // actuation event (see the prepare/commit section)
+        motor_plan_t plans[2];
+        motor_plan_prepare(&plans[0], MOTOR_LEFT_IN1_GPIO, MOTOR_LEFT_IN2_GPIO,
+                           LEDC_CHANNEL_0, left_speed);
+        motor_plan_prepare(&plans[1], MOTOR_RIGHT_IN1_GPIO, MOTOR_RIGHT_IN2_GPIO,
+                           LEDC_CHANNEL_1, right_speed);
+        esp_err_t err = motor_plan_commit(plans, 2);
 
-        if (err_left == ESP_OK && err_right == ESP_OK)
+        if (err == ESP_OK)
         {
+            // Setpoint edges only: the control loop re-commands the
+            // same speeds constantly and those repeats say nothing
+            if (clamp_speed(left_speed) != s_left_speed ||
+                clamp_speed(right_speed) != s_right_speed)
+            {
+                blackbox_record(BB_REC_MOTOR, 0, clamp_speed(left_speed),
+                                clamp_speed(right_speed));
+            }
             s_left_speed = clamp_speed(left_speed);
             s_right_speed = clamp_speed(right_speed);
         }
 
         xSemaphoreGive(s_motor_mutex);
-        return (err_left == ESP_OK && err_right == ESP_OK) ? ESP_OK : ESP_FAIL;
+        return (err == ESP_OK) ? ESP_OK : ESP_FAIL;
     }
     return ESP_FAIL;
 }
@@ -233,15 +387,14 @@ esp_err_t motor_emergency_stop(void)
         gpio_set_level(MOTOR_RIGHT_IN1_GPIO, 1);
         gpio_set_level(MOTOR_RIGHT_IN2_GPIO, 1);
 
-        // Set PWM to max for hard brake
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 255);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
-
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 255);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1);
+        // Set PWM to max for hard brake, cancelling any fade in flight
+        ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 255, 0);
+        ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 255, 0);
 
         s_left_speed = 0;
         s_right_speed = 0;
+        s_prev_sign[0] = 0;
+        s_prev_sign[1] = 0;
 
         xSemaphoreGive(s_motor_mutex);
         ESP_LOGW(TAG, "Emergency stop activated");
@@ -250,6 +403,84 @@ esp_err_t motor_emergency_stop(void)
     return ESP_FAIL;
 }
 
+esp_err_t motor_apply_closed_loop_duty(int left_duty, int right_duty)
+{
+    if (left_duty < 0 || left_duty > 255 || right_duty < 0 || right_duty > 255)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_motor_mutex)
+        return ESP_FAIL;
+
+    if (xSemaphoreTake(s_motor_mutex, pdMS_TO_TICKS(100)))
+    {
+        esp_err_t err_left = ESP_OK;
+        esp_err_t err_right = ESP_OK;
+
+        // Only trim sides that are commanded to move: a stop (or the
+        // emergency brake) must never be overridden by a correction
+        // computed before it landed
+        if (s_left_speed != 0)
+        {
+            err_left = ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE,
+                                                LEDC_CHANNEL_0,
+                                                (uint32_t)left_duty, 0);
+        }
+        if (s_right_speed != 0)
+        {
+            err_right = ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE,
+                                                 LEDC_CHANNEL_1,
+                                                 (uint32_t)right_duty, 0);
+        }
+
+        xSemaphoreGive(s_motor_mutex);
+        return (err_left == ESP_OK && err_right == ESP_OK) ? ESP_OK : ESP_FAIL;
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t motor_set_stop_mode(motor_stop_mode_t mode)
+{
+    if (mode != MOTOR_STOP_COAST && mode != MOTOR_STOP_BRAKE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_motor_mutex)
+        return ESP_FAIL;
+
+    if (xSemaphoreTake(s_motor_mutex, pdMS_TO_TICKS(100)))
+    {
+        s_stop_mode = mode;
+        xSemaphoreGive(s_motor_mutex);
+        ESP_LOGI(TAG, "Stop mode: %s",
+                 (mode == MOTOR_STOP_BRAKE) ? "brake" : "coast");
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t motor_set_ramp_time(int ramp_ms)
+{
+    if (ramp_ms < 0 || ramp_ms > MOTOR_RAMP_TIME_MAX_MS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_motor_mutex)
+        return ESP_FAIL;
+
+    if (xSemaphoreTake(s_motor_mutex, pdMS_TO_TICKS(100)))
+    {
+        s_ramp_time_ms = ramp_ms;
+        xSemaphoreGive(s_motor_mutex);
+        ESP_LOGI(TAG, "Ramp time set to %d ms", ramp_ms);
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
 void motor_get_speeds(int *left_speed, int *right_speed)
 {
     if (!s_motor_mutex)
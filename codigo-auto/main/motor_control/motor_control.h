@@ -47,6 +47,28 @@ extern "C"
 #define MOTOR_SPEED_MAX 255  // Full forward
 #define MOTOR_SPEED_STOP 0   // Stop
 
+// Speed ramping (LEDC hardware fade engine)
+#define MOTOR_RAMP_TIME_MS 150     // Default acceleration ramp, 0 = instant
+#define MOTOR_RAMP_TIME_MAX_MS 2000
+
+// Coast gap inserted when a motor reverses direction, so the L298N is
+// never driven hard from one bridge polarity into the other
+#define MOTOR_REVERSAL_DEAD_TIME_US 200
+
+    /**
+     * @brief Decay behavior for commanded stops
+     *
+     * Brake (slow decay: IN1=IN2=HIGH) shorts the winding and stops the
+     * wheel markedly faster than coast (fast decay: both inputs LOW),
+     * which matters for veto stopping distance. Emergency stop always
+     * brakes.
+     */
+    typedef enum
+    {
+        MOTOR_STOP_COAST = 0,
+        MOTOR_STOP_BRAKE,
+    } motor_stop_mode_t;
+
     /**
      * @brief Initialize motor control system
      *
@@ -60,6 +82,11 @@ extern "C"
     /**
      * @brief Set speed for both motors
      *
+     * Non-zero targets are reached through a hardware LEDC fade over the
+     * configured ramp time, so acceleration curves run entirely in the
+     * peripheral; callers just issue setpoints. Commanded stops and
+     * emergency stops apply instantly.
+     *
      * @param left_speed Speed for left motor (-255 to 255)
      *                   Negative = reverse, Positive = forward
      * @param right_speed Speed for right motor (-255 to 255)
@@ -67,6 +94,24 @@ extern "C"
      */
     esp_err_t motor_set_speed(int left_speed, int right_speed);
 
+    /**
+     * @brief Configure the acceleration ramp time
+     *
+     * @param ramp_ms Fade duration towards non-zero targets in ms
+     *                (0 = instant duty steps, clamped to
+     *                MOTOR_RAMP_TIME_MAX_MS)
+     * @return ESP_OK on success
+     */
+    esp_err_t motor_set_ramp_time(int ramp_ms);
+
+    /**
+     * @brief Select coast or brake decay for commanded stops
+     *
+     * @param mode MOTOR_STOP_BRAKE (default) or MOTOR_STOP_COAST
+     * @return ESP_OK on success
+     */
+    esp_err_t motor_set_stop_mode(motor_stop_mode_t mode);
+
     /**
      * @brief Set speed for left motor only
      *
@@ -90,6 +135,20 @@ extern "C"
      */
     esp_err_t motor_emergency_stop(void);
 
+    /**
+     * @brief Apply PI-corrected duty magnitudes (encoder speed loop)
+     *
+     * Writes the PWM duty directly, leaving direction pins, ramp state
+     * and the commanded setpoints untouched. A side whose commanded
+     * speed is zero is skipped, so a stop is never overridden by a
+     * stale correction.
+     *
+     * @param left_duty Corrected duty for the left motor (0-255)
+     * @param right_duty Corrected duty for the right motor (0-255)
+     * @return ESP_OK on success
+     */
+    esp_err_t motor_apply_closed_loop_duty(int left_duty, int right_duty);
+
     /**
      * @brief Get current motor speeds
      *
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""MTDP delta generation and fleet OTA push (see ota_update.h).
+
+diff: greedy block matcher against the old image - every 16-byte-
+aligned window of the new image that hashes to a block of the old one
+becomes a COPY op sourcing the vehicle's running slot, everything else
+an ADD literal. A routine iteration (same IDF, localized code changes)
+typically patches to well under a tenth of the image.
+
+push: connects to the camera's WebSocket as a dashboard client and
+drives the transfer: ota_begin, then 'O','T' binary chunks paced by
+the vehicle's ota_status acks (small window so the link stays
+responsive), then ota_end. Requires the websocket-client package.
+
+Usage:
+  ota_delta.py diff <old.bin> <new.bin> <out.mtdp>
+  ota_delta.py push <file> --url ws://192.168.4.1/ws [--raw]
+"""
+
+import argparse
+import hashlib
+import json
+import struct
+import sys
+import zlib
+
+BLOCK = 256          # Match granularity against the old image
+MIN_COPY = 64        # Shorter matches cost more as ops than as literals
+CHUNK = 960          # Wire chunk payload; must fit the vehicle's 1 KB RX scratch
+WINDOW = 32 * 1024   # Bytes in flight between ota_status acks
+
+
+def build_patch(old: bytes, new: bytes) -> bytes:
+    index = {}
+    for off in range(0, len(old) - BLOCK + 1, BLOCK):
+        index.setdefault(hashlib.sha1(old[off:off + BLOCK]).digest(), off)
+
+    ops = []
+    lit_start = 0
+    pos = 0
+    while pos + BLOCK <= len(new):
+        src = index.get(hashlib.sha1(new[pos:pos + BLOCK]).digest())
+        if src is None:
+            pos += 1
+            continue
+
+        # Extend the match in both directions byte-by-byte
+        start, s_src = pos, src
+        while start > lit_start and s_src > 0 and new[start - 1] == old[s_src - 1]:
+            start -= 1
+            s_src -= 1
+        end, e_src = pos + BLOCK, src + BLOCK
+        while end < len(new) and e_src < len(old) and new[end] == old[e_src]:
+            end += 1
+            e_src += 1
+
+        if end - start >= MIN_COPY:
+            if start > lit_start:
+                ops.append((b"\x01", new[lit_start:start]))
+            ops.append((b"\x00", (s_src, end - start)))
+            lit_start = pos = end
+        else:
+            pos += 1
+
+    if lit_start < len(new):
+        ops.append((b"\x01", new[lit_start:]))
+
+    out = [struct.pack("<III", 0x5044544D, len(new), zlib.crc32(new))]
+    for op, arg in ops:
+        out.append(op)
+        if op == b"\x00":
+            out.append(struct.pack("<II", *arg))
+        else:
+            out.append(struct.pack("<I", len(arg)))
+            out.append(arg)
+    return b"".join(out)
+
+
+def push(url: str, payload: bytes, target_crc: int, delta: bool) -> int:
+    import websocket  # pip install websocket-client
+
+    ws = websocket.create_connection(url, timeout=30)
+    ws.send(json.dumps({"type": "register", "role": "dashboard"}))
+    ws.send(json.dumps({"type": "ota_begin", "size": len(payload),
+                        "crc32": target_crc, "delta": 1 if delta else 0}))
+
+    sent = acked = 0
+    while sent < len(payload) or acked < len(payload):
+        while sent < len(payload) and sent - acked < WINDOW:
+            chunk = payload[sent:sent + CHUNK]
+            ws.send_binary(b"OT\x00\x00" + chunk)
+            sent += len(chunk)
+
+        msg = ws.recv()
+        if not isinstance(msg, str):
+            continue
+        status = json.loads(msg)
+        if status.get("type") != "ota_status":
+            continue
+        if status.get("state") == "failed":
+            print("vehicle reported failure", file=sys.stderr)
+            return 1
+        acked = status.get("received", acked)
+        print(f"\r{acked}/{len(payload)} bytes", end="", flush=True)
+
+    ws.send(json.dumps({"type": "ota_end"}))
+    while True:
+        status = json.loads(ws.recv())
+        if status.get("type") == "ota_status":
+            print(f"\nfinal state: {status.get('state')}")
+            return 0 if status.get("state") == "idle" else 1
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p_diff = sub.add_parser("diff")
+    p_diff.add_argument("old")
+    p_diff.add_argument("new")
+    p_diff.add_argument("out")
+
+    p_push = sub.add_parser("push")
+    p_push.add_argument("file", help=".mtdp patch, or app image with --raw")
+    p_push.add_argument("--url", default="ws://192.168.4.1/ws")
+    p_push.add_argument("--raw", action="store_true")
+
+    args = parser.parse_args()
+
+    if args.cmd == "diff":
+        old = open(args.old, "rb").read()
+        new = open(args.new, "rb").read()
+        patch = build_patch(old, new)
+        open(args.out, "wb").write(patch)
+        print(f"{len(new)} -> {len(patch)} bytes "
+              f"({100.0 * len(patch) / len(new):.1f}% of the image)")
+        return 0
+
+    payload = open(args.file, "rb").read()
+    if args.raw:
+        crc = zlib.crc32(payload)
+        return push(args.url, payload, crc, delta=False)
+    magic, _, crc = struct.unpack_from("<III", payload)
+    if magic != 0x5044544D:
+        print("not an MTDP patch (use --raw for full images)", file=sys.stderr)
+        return 2
+    return push(args.url, payload, crc, delta=True)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,393 @@
+/**
+ * @file ota_update.c
+ * @brief WebSocket OTA with streaming MTDP delta patches (see header)
+ */
+
+#include "ota_update.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "[OTA]";
+
+#define OTA_MTDP_MAGIC 0x5044544D // "MTDP" little-endian
+
+#define OTA_OP_COPY 0x00
+#define OTA_OP_ADD 0x01
+
+// COPY ops read the running slot through this much stack at a time
+#define OTA_COPY_CHUNK 1024
+
+// Streaming patch interpreter phases
+typedef enum
+{
+    PATCH_HDR = 0,  // Collecting the 12-byte file header
+    PATCH_OP,       // Waiting for an opcode byte
+    PATCH_COPY_ARG, // Collecting src_offset + len
+    PATCH_ADD_LEN,  // Collecting the literal length
+    PATCH_ADD_DATA, // Consuming literal bytes
+} patch_phase_t;
+
+static ota_state_t s_state = OTA_STATE_IDLE;
+static esp_ota_handle_t s_handle = 0;
+static const esp_partition_t *s_target = NULL;
+static const esp_partition_t *s_running = NULL;
+
+static bool s_delta = false;
+static uint32_t s_transfer_size = 0; // Expected wire bytes
+static uint32_t s_received = 0;      // Wire bytes consumed
+static uint32_t s_target_size = 0;   // Image bytes to produce
+static uint32_t s_written = 0;       // Image bytes produced
+static uint32_t s_expect_crc = 0;    // Announced image CRC32
+static uint32_t s_crc = 0;           // Running CRC of produced bytes
+
+// Patch interpreter state; s_hold collects op headers split across
+// wire chunks (never more than the 12-byte file header)
+static patch_phase_t s_phase = PATCH_HDR;
+static uint8_t s_hold[12];
+static uint32_t s_hold_len = 0;
+static uint32_t s_add_left = 0;
+
+static bool s_marked_valid = false;
+
+static uint32_t rd_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Append reconstructed image bytes to the passive slot
+ */
+static esp_err_t ota_emit(const uint8_t *data, size_t len)
+{
+    if (s_written + len > s_target_size)
+    {
+        ESP_LOGE(TAG, "Patch produces more than the announced %lu bytes",
+                 (unsigned long)s_target_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = esp_ota_write(s_handle, data, len);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_write: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_crc = esp_rom_crc32_le(s_crc, data, len);
+    s_written += (uint32_t)len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Execute one COPY op by streaming from the running slot
+ */
+static esp_err_t ota_copy_from_running(uint32_t src_off, uint32_t len)
+{
+    uint8_t buf[OTA_COPY_CHUNK];
+
+    if (src_off + len > s_running->size)
+    {
+        ESP_LOGE(TAG, "COPY beyond the running slot (0x%lx + %lu)",
+                 (unsigned long)src_off, (unsigned long)len);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (len > 0)
+    {
+        uint32_t n = (len > sizeof(buf)) ? sizeof(buf) : len;
+        esp_err_t err = esp_partition_read(s_running, src_off, buf, n);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        err = ota_emit(buf, n);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        src_off += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Run the streaming patch interpreter over one wire chunk
+ *
+ * Op headers that straddle a chunk boundary are held in s_hold; ADD
+ * literals and COPY execution never buffer more than OTA_COPY_CHUNK.
+ */
+static esp_err_t patch_consume(const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        switch (s_phase)
+        {
+        case PATCH_HDR:
+        {
+            uint32_t need = 12 - s_hold_len;
+            uint32_t take = (len < need) ? (uint32_t)len : need;
+            memcpy(s_hold + s_hold_len, data, take);
+            s_hold_len += take;
+            data += take;
+            len -= take;
+
+            if (s_hold_len == 12)
+            {
+                if (rd_u32(s_hold) != OTA_MTDP_MAGIC)
+                {
+                    ESP_LOGE(TAG, "Patch lacks the MTDP magic");
+                    return ESP_ERR_INVALID_ARG;
+                }
+                s_target_size = rd_u32(s_hold + 4);
+                uint32_t patch_crc = rd_u32(s_hold + 8);
+                if (patch_crc != s_expect_crc)
+                {
+                    ESP_LOGE(TAG, "Patch built for CRC %08lx, announced %08lx",
+                             (unsigned long)patch_crc,
+                             (unsigned long)s_expect_crc);
+                    return ESP_ERR_INVALID_ARG;
+                }
+                s_hold_len = 0;
+                s_phase = PATCH_OP;
+            }
+            break;
+        }
+
+        case PATCH_OP:
+            if (*data == OTA_OP_COPY)
+            {
+                s_phase = PATCH_COPY_ARG;
+            }
+            else if (*data == OTA_OP_ADD)
+            {
+                s_phase = PATCH_ADD_LEN;
+            }
+            else
+            {
+                ESP_LOGE(TAG, "Unknown patch op 0x%02x at wire byte %lu",
+                         *data, (unsigned long)s_received);
+                return ESP_ERR_INVALID_ARG;
+            }
+            data++;
+            len--;
+            break;
+
+        case PATCH_COPY_ARG:
+        {
+            uint32_t need = 8 - s_hold_len;
+            uint32_t take = (len < need) ? (uint32_t)len : need;
+            memcpy(s_hold + s_hold_len, data, take);
+            s_hold_len += take;
+            data += take;
+            len -= take;
+
+            if (s_hold_len == 8)
+            {
+                esp_err_t err = ota_copy_from_running(rd_u32(s_hold),
+                                                      rd_u32(s_hold + 4));
+                if (err != ESP_OK)
+                {
+                    return err;
+                }
+                s_hold_len = 0;
+                s_phase = PATCH_OP;
+            }
+            break;
+        }
+
+        case PATCH_ADD_LEN:
+        {
+            uint32_t need = 4 - s_hold_len;
+            uint32_t take = (len < need) ? (uint32_t)len : need;
+            memcpy(s_hold + s_hold_len, data, take);
+            s_hold_len += take;
+            data += take;
+            len -= take;
+
+            if (s_hold_len == 4)
+            {
+                s_add_left = rd_u32(s_hold);
+                s_hold_len = 0;
+                s_phase = (s_add_left > 0) ? PATCH_ADD_DATA : PATCH_OP;
+            }
+            break;
+        }
+
+        case PATCH_ADD_DATA:
+        {
+            uint32_t take = (len < s_add_left) ? (uint32_t)len : s_add_left;
+            esp_err_t err = ota_emit(data, take);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+            data += take;
+            len -= take;
+            s_add_left -= take;
+            if (s_add_left == 0)
+            {
+                s_phase = PATCH_OP;
+            }
+            break;
+        }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_update_begin(uint32_t transfer_size, uint32_t target_crc32,
+                           bool delta)
+{
+    if (s_state == OTA_STATE_RECEIVING)
+    {
+        // A fresh begin supersedes a stalled transfer
+        ota_update_abort("superseded by new ota_begin");
+    }
+
+    s_running = esp_ota_get_running_partition();
+    s_target = esp_ota_get_next_update_partition(NULL);
+    if (s_target == NULL || s_running == NULL)
+    {
+        ESP_LOGE(TAG, "No passive OTA slot - check the partition table");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = esp_ota_begin(s_target, OTA_SIZE_UNKNOWN, &s_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_begin: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_delta = delta;
+    s_transfer_size = transfer_size;
+    s_received = 0;
+    s_target_size = delta ? 0 : transfer_size;
+    s_written = 0;
+    s_expect_crc = target_crc32;
+    s_crc = 0;
+    s_phase = PATCH_HDR;
+    s_hold_len = 0;
+    s_add_left = 0;
+    s_state = OTA_STATE_RECEIVING;
+
+    ESP_LOGI(TAG, "Transfer armed: %lu bytes (%s) -> %s",
+             (unsigned long)transfer_size, delta ? "delta" : "raw",
+             s_target->label);
+    return ESP_OK;
+}
+
+esp_err_t ota_update_feed(const uint8_t *data, size_t len)
+{
+    if (s_state != OTA_STATE_RECEIVING)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_received + len > s_transfer_size)
+    {
+        ota_update_abort("more wire bytes than announced");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = s_delta ? patch_consume(data, len)
+                            : ota_emit(data, len);
+    if (err != ESP_OK)
+    {
+        ota_update_abort("chunk processing failed");
+        return err;
+    }
+
+    s_received += (uint32_t)len;
+    return ESP_OK;
+}
+
+esp_err_t ota_update_finish(void)
+{
+    if (s_state != OTA_STATE_RECEIVING)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_received != s_transfer_size || s_written != s_target_size ||
+        (s_delta && s_phase != PATCH_OP))
+    {
+        ota_update_abort("transfer ended incomplete");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_crc != s_expect_crc)
+    {
+        ESP_LOGE(TAG, "Image CRC %08lx, expected %08lx",
+                 (unsigned long)s_crc, (unsigned long)s_expect_crc);
+        ota_update_abort("image CRC mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    esp_err_t err = esp_ota_end(s_handle);
+    s_handle = 0;
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_end: %s", esp_err_to_name(err));
+        s_state = OTA_STATE_FAILED;
+        return err;
+    }
+
+    err = esp_ota_set_boot_partition(s_target);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_ota_set_boot_partition: %s", esp_err_to_name(err));
+        s_state = OTA_STATE_FAILED;
+        return err;
+    }
+
+    s_state = OTA_STATE_IDLE;
+    ESP_LOGI(TAG, "Image verified (%lu bytes) - %s boots next",
+             (unsigned long)s_written, s_target->label);
+    return ESP_OK;
+}
+
+void ota_update_abort(const char *reason)
+{
+    if (s_state != OTA_STATE_RECEIVING)
+    {
+        return;
+    }
+    ESP_LOGW(TAG, "Transfer aborted: %s", reason ? reason : "unspecified");
+    if (s_handle != 0)
+    {
+        esp_ota_abort(s_handle);
+        s_handle = 0;
+    }
+    s_state = OTA_STATE_FAILED;
+}
+
+ota_state_t ota_update_state(void)
+{
+    return s_state;
+}
+
+uint32_t ota_update_received(void)
+{
+    return s_received;
+}
+
+void ota_update_mark_valid(void)
+{
+    if (s_marked_valid)
+    {
+        return;
+    }
+    s_marked_valid = true;
+
+    // Only meaningful on the first link-up after an update boot; a
+    // no-op (harmless error) on images already confirmed
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Running image confirmed - rollback disarmed");
+    }
+}
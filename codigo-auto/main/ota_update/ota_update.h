@@ -0,0 +1,99 @@
+/**
+ * @file ota_update.h
+ * @brief Over-the-air updates with binary-delta patches over WebSocket
+ *
+ * Reflashing the fleet over serial costs an afternoon per iteration;
+ * this module turns an update into a background transfer over the
+ * link the vehicle already holds. The updater (ota_delta.py, run on
+ * the developer host as a dashboard client) announces the transfer
+ * with an ota_begin message, streams it as 'O','T' binary frames the
+ * server relays to the vehicle, and closes with ota_end; the vehicle
+ * paces the sender with periodic ota_status acks so the transfer
+ * never competes with control traffic.
+ *
+ * Transfers come in two flavors. Raw: the payload is the new app
+ * image, written straight to the passive slot. Delta: the payload is
+ * an MTDP patch - COPY ops that source byte ranges from the running
+ * slot and ADD ops that carry the bytes that changed - which
+ * reconstructs the new image on-device, typically an order of
+ * magnitude smaller on the wire than the full binary.
+ *
+ * Rollback is the bootloader's: the new image boots tentative and is
+ * confirmed with ota_update_mark_valid() once the WebSocket link
+ * comes back up, so an update that bricks networking reverts on its
+ * own at the next reset.
+ *
+ * MTDP patch layout (all fields little-endian):
+ *   uint32 magic 'M','T','D','P'; uint32 target_size; uint32 target_crc32
+ *   then ops until target_size bytes are produced:
+ *     0x00 COPY: uint32 src_offset, uint32 len  (from the running slot)
+ *     0x01 ADD:  uint32 len, len literal bytes
+ */
+
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        OTA_STATE_IDLE = 0,  // No transfer in progress
+        OTA_STATE_RECEIVING, // Accepting 'O','T' chunks
+        OTA_STATE_FAILED,    // Aborted; idle after the next ota_begin
+    } ota_state_t;
+
+    /**
+     * @brief Open the passive slot and arm a transfer
+     *
+     * @param transfer_size Bytes that will arrive on the wire
+     * @param target_crc32  CRC32 of the reconstructed app image
+     * @param delta         true for an MTDP patch, false for a raw image
+     */
+    esp_err_t ota_update_begin(uint32_t transfer_size, uint32_t target_crc32,
+                               bool delta);
+
+    /**
+     * @brief Feed the next sequential chunk of the transfer
+     *
+     * Raw bytes go straight to the slot; patch bytes run through the
+     * streaming MTDP interpreter. Any error aborts the transfer.
+     */
+    esp_err_t ota_update_feed(const uint8_t *data, size_t len);
+
+    /**
+     * @brief Verify the reconstructed image and set it as boot target
+     *
+     * The caller owns the restart; until then the vehicle keeps
+     * running the current image.
+     */
+    esp_err_t ota_update_finish(void);
+
+    void ota_update_abort(const char *reason);
+
+    ota_state_t ota_update_state(void);
+
+    /**
+     * @brief Wire bytes consumed so far (for pacing acks)
+     */
+    uint32_t ota_update_received(void);
+
+    /**
+     * @brief Confirm the running image so rollback stands down
+     *
+     * Called once the WebSocket link is up after boot; idempotent.
+     */
+    void ota_update_mark_valid(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_UPDATE_H
@@ -0,0 +1,560 @@
+/**
+ * @file sim_vehicle.c
+ * @brief Synthetic camera and kinematics for the simulator build
+ *
+ * See sim_vehicle.h for the picture. The esp_camera_* symbols below
+ * are linked in with --wrap, so every call vision_engine.c makes lands
+ * here; __real_* is never forwarded because the whole point is that no
+ * OV2640 is attached. The frame generator runs inside fb_get on the
+ * vision task, paced to the sensor period, so the consumer sees the
+ * same blocking behavior, timestamps and buffer-loan discipline as the
+ * real driver - including capture-age and overwritten-frame accounting.
+ */
+
+#include "sim_vehicle.h"
+#include "../hardware_config.h"
+#include "motor_control/motor_control.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "SimVehicle";
+
+// ============================================================================
+// TUNABLES
+// ============================================================================
+
+// OV2640 at QVGA delivers ~30 FPS; the generator paces to the same
+// period so frame-rate-derived numbers (overwrites, p95 ages) stay
+// comparable with hardware runs
+#define SIM_FRAME_PERIOD_US 33000
+
+// Differential-drive model. Full PWM (255) maps to roughly the bench
+// speed of the real chassis; the wheel base matches the L298N cart
+#define SIM_SPEED_FULL_MPS 0.8f
+#define SIM_WHEEL_BASE_M 0.14f
+
+// The beacon the vehicle chases orbits the arena origin slowly enough
+// for the control stack to keep up but fast enough that steering never
+// settles - a soak run should exercise the correction path constantly
+#define SIM_BEACON_RADIUS_M 1.5f
+#define SIM_BEACON_RATE_RAD_S 0.15f
+
+// Horizontal field of view used to project the beacon into the frame
+#define SIM_FOV_RAD 1.047f // ~60 degrees
+
+// Blob radius in pixels at 1 m distance, scaled by 1/distance and
+// clamped so it always clears MIN_CONTOUR_AREA when in view
+#define SIM_BLOB_RADIUS_AT_1M_PX 28
+#define SIM_BLOB_RADIUS_MIN_PX 10
+#define SIM_BLOB_RADIUS_MAX_PX 60
+
+#define SIM_MAX_FB 3
+
+// ============================================================================
+// FRAME BUFFER POOL
+// ============================================================================
+
+typedef struct
+{
+    camera_fb_t fb;
+    bool loaned;
+} sim_fb_slot_t;
+
+static sim_fb_slot_t s_slots[SIM_MAX_FB];
+static int s_fb_count = 0;
+static pixformat_t s_format = PIXFORMAT_RGB565;
+static int s_width = 0;  // Current output size (set_framesize can change it)
+static int s_height = 0;
+static int s_max_bytes = 0; // Allocation size: largest supported frame
+
+// Pre-rendered background: pseudo-noise dark enough to stay under
+// HSV_GREEN_V_MIN so the classifier never bites on it, but noisy
+// enough that the JPEG encoder does real work instead of compressing
+// a flat field in no time
+static uint8_t *s_background = NULL;
+
+static uint64_t s_next_frame_us = 0;
+
+// ============================================================================
+// KINEMATIC MODEL
+// ============================================================================
+
+static float s_pos_x = 0.0f;
+static float s_pos_y = -SIM_BEACON_RADIUS_M; // Start on the orbit circle
+static float s_heading = 0.0f;
+static float s_beacon_angle = 0.0f;
+static uint64_t s_last_step_us = 0;
+
+/**
+ * @brief Integrate pose from the speeds the control stack commanded
+ *
+ * Plain differential drive: the mean of both wheels moves the vehicle
+ * forward, the difference turns it. Called once per generated frame,
+ * so dt is the frame period plus whatever the consumer was late by -
+ * exactly the cadence the real chassis would see commands at.
+ */
+static void sim_kinematics_step(void)
+{
+    uint64_t now_us = (uint64_t)esp_timer_get_time();
+    if (s_last_step_us == 0)
+    {
+        s_last_step_us = now_us;
+        return;
+    }
+    float dt = (float)(now_us - s_last_step_us) / 1e6f;
+    s_last_step_us = now_us;
+    if (dt > 0.5f)
+    {
+        dt = 0.5f; // Debugger stalls should not teleport the vehicle
+    }
+
+    int left = 0;
+    int right = 0;
+    motor_get_speeds(&left, &right);
+
+    float v_left = (float)left / MOTOR_SPEED_MAX * SIM_SPEED_FULL_MPS;
+    float v_right = (float)right / MOTOR_SPEED_MAX * SIM_SPEED_FULL_MPS;
+    float v = (v_left + v_right) * 0.5f;
+    float w = (v_right - v_left) / SIM_WHEEL_BASE_M;
+
+    s_heading += w * dt;
+    s_pos_x += v * cosf(s_heading) * dt;
+    s_pos_y += v * sinf(s_heading) * dt;
+
+    s_beacon_angle += SIM_BEACON_RATE_RAD_S * dt;
+}
+
+void sim_vehicle_get_pose(float *x_m, float *y_m, float *heading_rad)
+{
+    if (x_m)
+    {
+        *x_m = s_pos_x;
+    }
+    if (y_m)
+    {
+        *y_m = s_pos_y;
+    }
+    if (heading_rad)
+    {
+        *heading_rad = s_heading;
+    }
+}
+
+// ============================================================================
+// FRAME SYNTHESIS
+// ============================================================================
+
+/**
+ * @brief Fill the background template once per init
+ *
+ * Deterministic LCG noise: every run renders the same texture, so two
+ * soak runs compress to comparable JPEG sizes. RGB565 gets dark gray
+ * speckle (V below the classifier gate); grayscale gets the same luma.
+ */
+static void sim_background_render(void)
+{
+    uint32_t seed = 0x2545F491u;
+    if (s_format == PIXFORMAT_GRAYSCALE)
+    {
+        for (int i = 0; i < s_max_bytes; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            s_background[i] = (uint8_t)(20 + ((seed >> 24) & 0x1F));
+        }
+    }
+    else
+    {
+        uint16_t *pixels = (uint16_t *)s_background;
+        for (int i = 0; i < s_max_bytes / 2; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t luma = 3 + ((seed >> 27) & 0x03); // 5-bit gray, dark
+            pixels[i] = (uint16_t)((luma << 11) | (luma << 6) | luma);
+        }
+    }
+}
+
+/**
+ * @brief Project the beacon into the frame and draw it
+ *
+ * Bearing error (beacon azimuth minus heading) maps linearly across
+ * the field of view; outside it nothing is drawn and the detection
+ * stack runs its lost-target behavior, which is also worth soaking.
+ */
+static void sim_frame_render(camera_fb_t *fb)
+{
+    memcpy(fb->buf, s_background, fb->len);
+
+    float bx = SIM_BEACON_RADIUS_M * cosf(s_beacon_angle);
+    float by = SIM_BEACON_RADIUS_M * sinf(s_beacon_angle);
+    float dx = bx - s_pos_x;
+    float dy = by - s_pos_y;
+    float dist = sqrtf(dx * dx + dy * dy);
+    float bearing = atan2f(dy, dx) - s_heading;
+    while (bearing > (float)M_PI)
+    {
+        bearing -= 2.0f * (float)M_PI;
+    }
+    while (bearing < -(float)M_PI)
+    {
+        bearing += 2.0f * (float)M_PI;
+    }
+
+    if (fabsf(bearing) > SIM_FOV_RAD / 2.0f)
+    {
+        return; // Beacon out of view: empty frame, search behavior
+    }
+
+    int cx = (int)((0.5f + bearing / SIM_FOV_RAD) * (float)s_width);
+    int cy = s_height / 2;
+    int radius = SIM_BLOB_RADIUS_AT_1M_PX;
+    if (dist > 0.1f)
+    {
+        radius = (int)((float)SIM_BLOB_RADIUS_AT_1M_PX / dist);
+    }
+    if (radius < SIM_BLOB_RADIUS_MIN_PX)
+    {
+        radius = SIM_BLOB_RADIUS_MIN_PX;
+    }
+    if (radius > SIM_BLOB_RADIUS_MAX_PX)
+    {
+        radius = SIM_BLOB_RADIUS_MAX_PX;
+    }
+
+    int y0 = cy - radius;
+    int y1 = cy + radius;
+    if (y0 < 0)
+    {
+        y0 = 0;
+    }
+    if (y1 >= s_height)
+    {
+        y1 = s_height - 1;
+    }
+    for (int y = y0; y <= y1; y++)
+    {
+        int dy_px = y - cy;
+        int half = (int)sqrtf((float)(radius * radius - dy_px * dy_px));
+        int x0 = cx - half;
+        int x1 = cx + half;
+        if (x0 < 0)
+        {
+            x0 = 0;
+        }
+        if (x1 >= s_width)
+        {
+            x1 = s_width - 1;
+        }
+        if (s_format == PIXFORMAT_GRAYSCALE)
+        {
+            memset(fb->buf + y * s_width + x0, 0xE8, (size_t)(x1 - x0 + 1));
+        }
+        else
+        {
+            uint16_t *row = (uint16_t *)fb->buf + y * s_width;
+            for (int x = x0; x <= x1; x++)
+            {
+                row[x] = 0x07E0; // Saturated green, hue dead-center
+            }
+        }
+    }
+}
+
+// ============================================================================
+// WRAPPED DRIVER ENTRY POINTS
+// ============================================================================
+
+static bool sim_frame_dims(framesize_t size, int *width, int *height)
+{
+    switch (size)
+    {
+    case FRAMESIZE_QVGA:
+        *width = 320;
+        *height = 240;
+        return true;
+    case FRAMESIZE_QQVGA:
+        *width = 160;
+        *height = 120;
+        return true;
+    default:
+        return false;
+    }
+}
+
+esp_err_t __wrap_esp_camera_init(const camera_config_t *config)
+{
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->pixel_format == PIXFORMAT_JPEG)
+    {
+        ESP_LOGE(TAG, "Native-JPEG profile not supported in simulator");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!sim_frame_dims(config->frame_size, &s_width, &s_height))
+    {
+        ESP_LOGE(TAG, "Unsupported frame size %d in simulator",
+                 (int)config->frame_size);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    s_format = config->pixel_format;
+    s_fb_count = (int)config->fb_count;
+    if (s_fb_count > SIM_MAX_FB)
+    {
+        s_fb_count = SIM_MAX_FB;
+    }
+
+    // Allocate for the largest supported size so a later set_framesize
+    // switch fits in place, same as the driver recycling its buffers
+    int bpp = (s_format == PIXFORMAT_GRAYSCALE) ? 1 : 2;
+    s_max_bytes = 320 * 240 * bpp;
+    uint32_t caps = (config->fb_location == CAMERA_FB_IN_PSRAM)
+                        ? MALLOC_CAP_SPIRAM
+                        : MALLOC_CAP_8BIT;
+
+    for (int i = 0; i < s_fb_count; i++)
+    {
+        s_slots[i].fb.buf = heap_caps_malloc((size_t)s_max_bytes, caps);
+        if (s_slots[i].fb.buf == NULL)
+        {
+            ESP_LOGE(TAG, "No memory for simulated frame buffer %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+        s_slots[i].loaned = false;
+    }
+
+    s_background = heap_caps_malloc((size_t)s_max_bytes, caps);
+    if (s_background == NULL)
+    {
+        ESP_LOGE(TAG, "No memory for simulated background");
+        return ESP_ERR_NO_MEM;
+    }
+    sim_background_render();
+
+    // Pose deliberately survives a capture-profile recycle: deinit and
+    // init between frames must not teleport the simulated vehicle
+    s_next_frame_us = 0;
+
+    ESP_LOGW(TAG, "SIMULATOR build: synthetic %dx%d %s frames, no camera",
+             s_width, s_height,
+             s_format == PIXFORMAT_GRAYSCALE ? "GRAY" : "RGB565");
+    return ESP_OK;
+}
+
+esp_err_t __wrap_esp_camera_deinit(void)
+{
+    for (int i = 0; i < SIM_MAX_FB; i++)
+    {
+        if (s_slots[i].fb.buf != NULL)
+        {
+            heap_caps_free(s_slots[i].fb.buf);
+            s_slots[i].fb.buf = NULL;
+        }
+        s_slots[i].loaned = false;
+    }
+    if (s_background != NULL)
+    {
+        heap_caps_free(s_background);
+        s_background = NULL;
+    }
+    s_fb_count = 0;
+    return ESP_OK;
+}
+
+camera_fb_t *__wrap_esp_camera_fb_get(void)
+{
+    if (s_fb_count == 0)
+    {
+        return NULL;
+    }
+
+    // Pace to the sensor period. A late consumer gets the next frame
+    // immediately (and the capture-age accounting sees the gap), a
+    // fast one blocks here like it would inside the real driver
+    uint64_t now_us = (uint64_t)esp_timer_get_time();
+    if (s_next_frame_us > now_us)
+    {
+        vTaskDelay(pdMS_TO_TICKS((s_next_frame_us - now_us) / 1000 + 1));
+    }
+    now_us = (uint64_t)esp_timer_get_time();
+    s_next_frame_us = now_us + SIM_FRAME_PERIOD_US;
+
+    // All buffers loaned means the streaming stage is sitting on them;
+    // wait like the driver does, bounded so a wedged consumer surfaces
+    // as capture failures instead of a silent hang
+    sim_fb_slot_t *slot = NULL;
+    for (int waited_ms = 0; waited_ms < 1000; waited_ms += 10)
+    {
+        for (int i = 0; i < s_fb_count; i++)
+        {
+            if (!s_slots[i].loaned)
+            {
+                slot = &s_slots[i];
+                break;
+            }
+        }
+        if (slot != NULL)
+        {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (slot == NULL)
+    {
+        return NULL;
+    }
+
+    sim_kinematics_step();
+
+    int bpp = (s_format == PIXFORMAT_GRAYSCALE) ? 1 : 2;
+    slot->fb.width = (size_t)s_width;
+    slot->fb.height = (size_t)s_height;
+    slot->fb.len = (size_t)(s_width * s_height * bpp);
+    slot->fb.format = s_format;
+    slot->fb.timestamp.tv_sec = (long)(now_us / 1000000ULL);
+    slot->fb.timestamp.tv_usec = (long)(now_us % 1000000ULL);
+    sim_frame_render(&slot->fb);
+
+    slot->loaned = true;
+    return &slot->fb;
+}
+
+void __wrap_esp_camera_fb_return(camera_fb_t *fb)
+{
+    if (fb == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < SIM_MAX_FB; i++)
+    {
+        if (&s_slots[i].fb == fb)
+        {
+            s_slots[i].loaned = false;
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// SENSOR STUB
+// ============================================================================
+// vision_engine walks ~20 setters during init and pokes registers for
+// windowing and AE/AWB freezing. There is no sensor, so everything
+// acknowledges and does nothing - except set_framesize, which actually
+// resizes the generated frames (small-frames mode depends on it).
+
+static int sim_set_int(sensor_t *s, int v)
+{
+    (void)s;
+    (void)v;
+    return 0;
+}
+
+static int sim_set_gainceiling(sensor_t *s, gainceiling_t v)
+{
+    (void)s;
+    (void)v;
+    return 0;
+}
+
+static int sim_set_pixformat(sensor_t *s, pixformat_t v)
+{
+    (void)s;
+    (void)v;
+    return 0;
+}
+
+static int sim_set_framesize(sensor_t *s, framesize_t v)
+{
+    int width;
+    int height;
+    if (!sim_frame_dims(v, &width, &height))
+    {
+        return -1;
+    }
+    s_width = width;
+    s_height = height;
+    s->status.framesize = v;
+    return 0;
+}
+
+static int sim_set_res_raw(sensor_t *s, int startX, int startY, int endX,
+                           int endY, int offsetX, int offsetY, int totalX,
+                           int totalY, int outputX, int outputY, bool scale,
+                           bool binning)
+{
+    (void)s;
+    (void)startX;
+    (void)startY;
+    (void)endX;
+    (void)endY;
+    (void)offsetX;
+    (void)offsetY;
+    (void)totalX;
+    (void)totalY;
+    (void)outputX;
+    (void)outputY;
+    (void)scale;
+    (void)binning;
+    return 0;
+}
+
+static int sim_get_reg(sensor_t *s, int reg, int mask)
+{
+    (void)s;
+    (void)reg;
+    (void)mask;
+    return 0;
+}
+
+static int sim_set_reg(sensor_t *s, int reg, int mask, int value)
+{
+    (void)s;
+    (void)reg;
+    (void)mask;
+    (void)value;
+    return 0;
+}
+
+static sensor_t s_sim_sensor = {
+    .set_brightness = sim_set_int,
+    .set_contrast = sim_set_int,
+    .set_saturation = sim_set_int,
+    .set_special_effect = sim_set_int,
+    .set_whitebal = sim_set_int,
+    .set_awb_gain = sim_set_int,
+    .set_wb_mode = sim_set_int,
+    .set_exposure_ctrl = sim_set_int,
+    .set_aec2 = sim_set_int,
+    .set_ae_level = sim_set_int,
+    .set_aec_value = sim_set_int,
+    .set_gain_ctrl = sim_set_int,
+    .set_agc_gain = sim_set_int,
+    .set_gainceiling = sim_set_gainceiling,
+    .set_bpc = sim_set_int,
+    .set_wpc = sim_set_int,
+    .set_raw_gma = sim_set_int,
+    .set_lenc = sim_set_int,
+    .set_hmirror = sim_set_int,
+    .set_vflip = sim_set_int,
+    .set_dcw = sim_set_int,
+    .set_colorbar = sim_set_int,
+    .set_framesize = sim_set_framesize,
+    .set_pixformat = sim_set_pixformat,
+    .set_res_raw = sim_set_res_raw,
+    .get_reg = sim_get_reg,
+    .set_reg = sim_set_reg,
+};
+
+sensor_t *__wrap_esp_camera_sensor_get(void)
+{
+    return &s_sim_sensor;
+}
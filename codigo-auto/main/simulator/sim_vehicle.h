@@ -0,0 +1,48 @@
+/**
+ * @file sim_vehicle.h
+ * @brief Synthetic vehicle build for full-system soak benchmarks
+ *
+ * Capacity and endurance testing used to require physical vehicles
+ * with charged batteries on the track. With CONFIG_VEHICLE_SIMULATOR
+ * enabled this module replaces the esp32-camera driver (via linker
+ * --wrap of the esp_camera_* entry points, see CMakeLists.txt) with
+ * generated frames: a pseudo-noise background plus a green blob whose
+ * position follows a kinematic model of the vehicle chasing a beacon
+ * that orbits the arena. The model integrates pose from the speeds the
+ * real control stack commands through motor_control, so detection,
+ * veto, streaming, ws_client and telemetry all run unmodified and the
+ * loop actually closes: steering moves the blob back toward center.
+ *
+ * Motors still drive their LEDC channels - on a bare devkit the pins
+ * are simply unconnected - and the kinematic model reads the commanded
+ * speeds back with motor_get_speeds(). Flash N devkits with this
+ * target and point them at a real S3 to soak the communication and
+ * vision pipelines overnight without hardware on the track.
+ *
+ * Supports the RGB565 and grayscale capture profiles at QVGA/QQVGA.
+ * The native-JPEG monitoring profile is rejected at init: synthesizing
+ * valid JPEG streams is not worth the complexity for a soak target.
+ */
+
+#ifndef SIM_VEHICLE_H
+#define SIM_VEHICLE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Current simulated pose, for debug logs or telemetry
+     *
+     * @param x_m World X in meters (may be NULL)
+     * @param y_m World Y in meters (may be NULL)
+     * @param heading_rad Heading in radians (may be NULL)
+     */
+    void sim_vehicle_get_pose(float *x_m, float *y_m, float *heading_rad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_VEHICLE_H
@@ -0,0 +1,113 @@
+/**
+ * @file telemetry.c
+ * @brief PSRAM-backed telemetry ring (see telemetry.h)
+ */
+
+#include "telemetry.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "[Telemetry]";
+
+// One record per 5 s monitor window: 1024 slots is ~85 minutes of
+// disconnected accumulation at ~58 KB of PSRAM
+#define TELEMETRY_RING_RECORDS 1024
+// Internal-RAM fallback keeps the last ~5 minutes
+#define TELEMETRY_RING_RECORDS_FALLBACK 64
+
+static telemetry_record_t *s_ring = NULL;
+static uint32_t s_ring_size = 0; // Power of 2
+static uint32_t s_head = 0;      // Next append slot
+static uint32_t s_tail = 0;      // Next drain slot
+
+esp_err_t telemetry_init(void)
+{
+    if (s_ring != NULL)
+    {
+        return ESP_OK;
+    }
+
+    s_ring_size = TELEMETRY_RING_RECORDS;
+    s_ring = heap_caps_malloc(s_ring_size * sizeof(telemetry_record_t),
+                              MALLOC_CAP_SPIRAM);
+    if (s_ring == NULL)
+    {
+        s_ring_size = TELEMETRY_RING_RECORDS_FALLBACK;
+        s_ring = heap_caps_malloc(s_ring_size * sizeof(telemetry_record_t),
+                                  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (s_ring == NULL)
+    {
+        s_ring_size = 0;
+        ESP_LOGW(TAG, "No memory for the telemetry ring - sampling disabled");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Ring ready: %u records (%u KB)",
+             (unsigned)s_ring_size,
+             (unsigned)(s_ring_size * sizeof(telemetry_record_t) / 1024));
+    return ESP_OK;
+}
+
+void telemetry_append(const telemetry_record_t *rec)
+{
+    if (s_ring == NULL)
+    {
+        return;
+    }
+
+    s_ring[s_head & (s_ring_size - 1)] = *rec;
+    s_head++;
+
+    // A full ring means the link has been down for the whole retention
+    // window; drop the oldest record rather than the newest
+    if (s_head - s_tail > s_ring_size)
+    {
+        s_tail = s_head - s_ring_size;
+    }
+}
+
+uint32_t telemetry_pending(void)
+{
+    return s_head - s_tail;
+}
+
+size_t telemetry_build_batch(uint8_t *buf, size_t buf_len)
+{
+    if (s_ring == NULL || s_head == s_tail || buf_len < 4)
+    {
+        return 0;
+    }
+
+    uint32_t count = s_head - s_tail;
+    uint32_t fit = (uint32_t)((buf_len - 4) / sizeof(telemetry_record_t));
+    if (count > TELEMETRY_BATCH_MAX)
+    {
+        count = TELEMETRY_BATCH_MAX;
+    }
+    if (count > fit)
+    {
+        count = fit;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    buf[0] = TELEMETRY_MAGIC_0;
+    buf[1] = TELEMETRY_MAGIC_1;
+    buf[2] = TELEMETRY_VERSION;
+    buf[3] = (uint8_t)count;
+
+    uint8_t *out = buf + 4;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(out, &s_ring[(s_tail + i) & (s_ring_size - 1)],
+               sizeof(telemetry_record_t));
+        out += sizeof(telemetry_record_t);
+    }
+    s_tail += count;
+
+    return 4 + count * sizeof(telemetry_record_t);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file telemetry.h
+ * @brief Long-horizon telemetry sampler backed by a PSRAM ring
+ *
+ * The 5 s monitor window used to be a handful of multi-field ESP_LOGI
+ * lines - expensive printf formatting on the UART, gone the moment the
+ * scrollback wrapped, and invisible from the dashboard. This module
+ * keeps the same samples as compact binary records in a PSRAM ring and
+ * ships them opportunistically over the WebSocket (lowest TX priority,
+ * batched) whenever the link is up. The ring absorbs disconnects: at
+ * one record per window it retains well over an hour, and the batcher
+ * catches up on reconnect. The UART stays reserved for anomalies.
+ *
+ * Single caller contract: monitor_task both appends and drains, so
+ * there is no locking anywhere in the module.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Wire format: 'V','T' + version + record count, then the records
+// back to back. Shares the binary channel with 'VS' status and JPEG
+// frames the same way status does - nothing else starts with 'VT'.
+#define TELEMETRY_MAGIC_0 0x56 // 'V'
+#define TELEMETRY_MAGIC_1 0x54 // 'T'
+#define TELEMETRY_VERSION 1
+
+// Most records packed into one WebSocket message
+#define TELEMETRY_BATCH_MAX 8
+
+    /**
+     * @brief One monitor-window sample (wire format, little-endian)
+     *
+     * Everything the old log lines carried, at a fraction of the
+     * bytes: link quality, heap/PSRAM fragmentation, vision and
+     * actuation tail latency, the busiest task per core and the motor
+     * state. Percentiles saturate at 65535 like the status message.
+     */
+    typedef struct __attribute__((packed))
+    {
+        uint32_t t_ms;             // Local clock at the sample
+        int8_t wifi_rssi;          // dBm, 0 = not associated
+        uint8_t flags;             // TELEMETRY_FLAG_* bits
+        uint8_t state;             // control_state_t of the window
+        uint8_t qos_shed;          // Shed ladder level (0 = full service)
+        int16_t motor_left;        // -255..255
+        int16_t motor_right;       // -255..255
+        uint16_t heap_free_kb;     // Internal heap free / largest block,
+        uint16_t heap_largest_kb;  // then the same pair for SPIRAM
+        uint16_t psram_free_kb;
+        uint16_t psram_largest_kb;
+        uint16_t vis_proc_p95_ms;  // Vision processing / publish p95
+        uint16_t vis_pub_p95_ms;
+        uint16_t cap_age_p95_ms;   // Frame age at fb_get, p95
+        uint16_t cap_overwritten;  // Cumulative overwritten frames (wraps)
+        uint16_t cmd_p95_us;       // Actuation latency p95, receipt->PWM
+        uint16_t cpu0_permille;    // CPU share of the busiest task on
+        uint16_t cpu1_permille;    // each core over the window, 0-1000
+        char cpu0_task[8];         // Names of those tasks (truncated,
+        char cpu1_task[8];         // NUL-padded)
+        uint32_t arena_int_hwm;    // Vision arena high water, bytes
+        uint32_t arena_psram_hwm;
+    } telemetry_record_t;
+
+#define TELEMETRY_FLAG_VETO 0x01 // Local vision veto active
+#define TELEMETRY_FLAG_WS 0x02   // WebSocket connected
+#define TELEMETRY_FLAG_WIFI 0x04 // WiFi associated
+
+    /**
+     * @brief Allocate the ring. Falls back to a short internal-RAM
+     * ring when PSRAM is absent; never fatal.
+     */
+    esp_err_t telemetry_init(void);
+
+    /**
+     * @brief Append one sample. No-op before init; when the consumer
+     * has fallen a full ring behind the oldest record is overwritten.
+     */
+    void telemetry_append(const telemetry_record_t *rec);
+
+    /**
+     * @brief Build one 'VT' batch from the oldest pending records
+     *
+     * Consumes up to TELEMETRY_BATCH_MAX records (fewer if buf is
+     * smaller). The records are considered shipped once built - a lost
+     * batch costs a gap in a diagnostic stream, same tolerance as the
+     * blackbox.
+     *
+     * @return Message length in bytes, 0 when nothing is pending
+     */
+    size_t telemetry_build_batch(uint8_t *buf, size_t buf_len);
+
+    /**
+     * @brief Records appended but not yet drained into a batch
+     */
+    uint32_t telemetry_pending(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
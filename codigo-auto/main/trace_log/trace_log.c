@@ -0,0 +1,51 @@
+/**
+ * @file trace_log.c
+ * @brief Overwrite-in-a-circle trace ring (see trace_log.h)
+ */
+
+#include "trace_log.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define TRACE_LOG_SIZE 128 // Power of 2
+
+static trace_record_t s_ring[TRACE_LOG_SIZE];
+static _Atomic uint32_t s_head = 0; // Total events ever pushed
+
+void trace_log_push(trace_ev_code_t code, int32_t arg1, int32_t arg2)
+{
+    // Relaxed slot grab: concurrent pushers get distinct slots, and a
+    // reader racing with a write sees at worst one torn record in a
+    // diagnostic dump. No CAS loop, no fences on the hot path.
+    uint32_t pos = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    trace_record_t *slot = &s_ring[pos & (TRACE_LOG_SIZE - 1)];
+
+    slot->t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    slot->code = (uint16_t)code;
+    slot->arg1 = arg1;
+    slot->arg2 = arg2;
+}
+
+int trace_log_recent(trace_record_t *out, int max)
+{
+    if (out == NULL || max <= 0)
+    {
+        return 0;
+    }
+
+    uint32_t head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    uint32_t available = (head < TRACE_LOG_SIZE) ? head : TRACE_LOG_SIZE;
+    if (available > (uint32_t)max)
+    {
+        available = (uint32_t)max;
+    }
+
+    // Oldest to newest within the requested window
+    uint32_t start = head - available;
+    for (uint32_t i = 0; i < available; i++)
+    {
+        out[i] = s_ring[(start + i) & (TRACE_LOG_SIZE - 1)];
+    }
+    return (int)available;
+}
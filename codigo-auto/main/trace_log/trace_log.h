@@ -0,0 +1,70 @@
+/**
+ * @file trace_log.h
+ * @brief Fixed-size trace-event ring for the unified timeline
+ *
+ * Diagnosing a late veto means correlating the vehicle's command and
+ * frame events with what the server saw. This ring keeps the last
+ * TRACE_LOG_SIZE events as fixed-size records (code + 32-bit local
+ * timestamp + two args) and hands them out on demand; the WS client
+ * converts the timestamps to server-clock milliseconds with the offset
+ * it already maintains from the time_ping handshake, so the dashboard
+ * can merge them with the server's own event window.
+ *
+ * Unlike the camera's event_log this ring has no drain task: nothing
+ * is formatted, records just overwrite in a circle until a trace_dump
+ * asks for them. Push is a relaxed atomic slot grab, cheap enough for
+ * the control path; readers tolerate torn records because the output
+ * is a diagnostic dump.
+ */
+
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Event codes known to the dashboard timeline
+     */
+    typedef enum
+    {
+        TRACE_EV_CMD_RX = 1,    // Control command off the socket (arg1=command enum)
+        TRACE_EV_CMD_APPLY,     // Command applied to the motors (arg1=command enum)
+        TRACE_EV_VETO_EDGE,     // Safety veto toggled (arg1=new state 0/1)
+        TRACE_EV_FRAME_DONE,    // Vision frame processed (arg1=detected 0/1, arg2=latency us)
+    } trace_ev_code_t;
+
+    /**
+     * @brief One retained event, local clock
+     */
+    typedef struct
+    {
+        uint32_t t_ms;
+        uint16_t code;
+        int32_t arg1;
+        int32_t arg2;
+    } trace_record_t;
+
+    /**
+     * @brief Record an event. Lock-free, safe from any task.
+     */
+    void trace_log_push(trace_ev_code_t code, int32_t arg1, int32_t arg2);
+
+    /**
+     * @brief Copy the most recent events, oldest first
+     *
+     * @param out Destination array
+     * @param max Capacity of out
+     * @return Number of records copied
+     */
+    int trace_log_recent(trace_record_t *out, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_LOG_H
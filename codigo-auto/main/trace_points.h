@@ -0,0 +1,38 @@
+/**
+ * @file trace_points.h
+ * @brief SystemView trace markers for the hot paths
+ *
+ * Log-based timing perturbs the loops it measures; these markers compile
+ * to nothing unless SystemView tracing is enabled in menuconfig
+ * (Application Level Tracing -> SEGGER SystemView). With it on, each
+ * region shows up as a user event in a JTAG apptrace capture, giving a
+ * microsecond task/ISR timeline from a running vehicle.
+ *
+ * Usage: bracket a region with TRACE_REGION_ENTER/EXIT using one of the
+ * IDs below. Keep regions coarse (one per loop body, not per call) so
+ * the trace stream stays well under the JTAG bandwidth.
+ */
+
+#ifndef TRACE_POINTS_H
+#define TRACE_POINTS_H
+
+#if CONFIG_APPTRACE_SV_ENABLE
+
+#include "SEGGER_SYSVIEW.h"
+
+#define TRACE_REGION_ENTER(id) SEGGER_SYSVIEW_OnUserStart(id)
+#define TRACE_REGION_EXIT(id) SEGGER_SYSVIEW_OnUserStop(id)
+
+#else
+
+#define TRACE_REGION_ENTER(id) ((void)0)
+#define TRACE_REGION_EXIT(id) ((void)0)
+
+#endif // CONFIG_APPTRACE_SV_ENABLE
+
+// Region IDs (user event numbers in the SystemView timeline)
+#define TRACE_ID_VISION_FRAME 1  // vision_task: process one frame to publish
+#define TRACE_ID_CONTROL_CYCLE 2 // control_task: one wake of the control loop
+#define TRACE_ID_WS_EVENT 3      // WS client: inbound data event handling
+
+#endif // TRACE_POINTS_H
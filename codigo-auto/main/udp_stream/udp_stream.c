@@ -0,0 +1,179 @@
+/**
+ * @file udp_stream.c
+ * @brief Optional UDP transport for outgoing video frames
+ */
+
+#include "udp_stream.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <string.h>
+
+static const char *TAG = "UDP_STREAM";
+
+// Fragment payload that fits one SoftAP MTU with headroom for the
+// IP/UDP headers plus our own; no IP-level fragmentation
+#define UDP_STREAM_FRAG_SIZE 1400
+
+#define UDP_STREAM_FLAG_LAST 0x01
+
+// RTP-like fragment header, little-endian, prepended to every datagram.
+// Must match udp_video.c on the ESP32-S3.
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];    // 'U','V'
+    uint8_t source;      // frame_source_t on the server side
+    uint8_t flags;       // UDP_STREAM_FLAG_LAST closes the frame
+    uint16_t sequence;   // Per-frame counter; gaps mean loss
+    uint16_t frag_index; // 0..N within the frame
+} udp_frag_header_t;
+
+static int s_socket = -1;
+static struct sockaddr_in s_dest;
+static uint16_t s_sequence = 0;
+static uint16_t s_frag_index = 0;
+static bool s_frame_poisoned = false;
+
+esp_err_t udp_stream_init(const char *host, uint16_t port)
+{
+    if (!host)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_socket >= 0)
+    {
+        return ESP_OK;
+    }
+
+    memset(&s_dest, 0, sizeof(s_dest));
+    s_dest.sin_family = AF_INET;
+    s_dest.sin_port = htons(port);
+    s_dest.sin_addr.s_addr = inet_addr(host);
+    if (s_dest.sin_addr.s_addr == INADDR_NONE)
+    {
+        ESP_LOGE(TAG, "Dirección inválida para video UDP: %s", host);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_socket < 0)
+    {
+        ESP_LOGE(TAG, "No se pudo crear el socket UDP (errno=%d)", errno);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Canal de video UDP listo hacia %s:%u", host, (unsigned)port);
+    return ESP_OK;
+}
+
+bool udp_stream_ready(void)
+{
+    return s_socket >= 0;
+}
+
+static esp_err_t udp_stream_send_fragment(const uint8_t *data, size_t len,
+                                          uint8_t flags)
+{
+    uint8_t datagram[sizeof(udp_frag_header_t) + UDP_STREAM_FRAG_SIZE];
+    udp_frag_header_t *header = (udp_frag_header_t *)datagram;
+
+    header->magic[0] = 'U';
+    header->magic[1] = 'V';
+    header->source = 1; // FRAME_SOURCE_ESP32CAM on the server
+    header->flags = flags;
+    header->sequence = s_sequence;
+    header->frag_index = s_frag_index++;
+
+    if (len > 0)
+    {
+        memcpy(datagram + sizeof(udp_frag_header_t), data, len);
+    }
+
+    int sent = sendto(s_socket, datagram, sizeof(udp_frag_header_t) + len, 0,
+                      (struct sockaddr *)&s_dest, sizeof(s_dest));
+    if (sent < 0)
+    {
+        // Fire and forget: the frame is now incomplete and the receiver
+        // will discard it; no retry, no blocking on the radio
+        ESP_LOGD(TAG, "sendto falló en fragmento %u (errno=%d)",
+                 (unsigned)(s_frag_index - 1), errno);
+        s_frame_poisoned = true;
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t udp_stream_send_chunk(const uint8_t *chunk, size_t len, bool first)
+{
+    if (!chunk || len == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_socket < 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (first)
+    {
+        s_sequence++;
+        s_frag_index = 0;
+        s_frame_poisoned = false;
+    }
+    else if (s_frame_poisoned)
+    {
+        // A fragment of this frame was already lost on send; don't
+        // spend airtime on the rest
+        return ESP_FAIL;
+    }
+
+    while (len > 0)
+    {
+        size_t piece = len > UDP_STREAM_FRAG_SIZE ? UDP_STREAM_FRAG_SIZE : len;
+        if (udp_stream_send_fragment(chunk, piece, 0) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+        chunk += piece;
+        len -= piece;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t udp_stream_send_finish(void)
+{
+    if (s_socket < 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_frame_poisoned)
+    {
+        return ESP_FAIL;
+    }
+
+    // Zero-payload datagram carrying only the LAST flag
+    return udp_stream_send_fragment(NULL, 0, UDP_STREAM_FLAG_LAST);
+}
+
+esp_err_t udp_stream_send_frame(const uint8_t *jpeg, size_t len)
+{
+    esp_err_t err = udp_stream_send_chunk(jpeg, len, true);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return udp_stream_send_finish();
+}
+
+void udp_stream_deinit(void)
+{
+    if (s_socket >= 0)
+    {
+        close(s_socket);
+        s_socket = -1;
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file udp_stream.h
+ * @brief Optional UDP transport for outgoing video frames
+ *
+ * Video over the TCP WebSocket suffers head-of-line blocking: one lost
+ * packet on the SoftAP stalls every later frame behind the retransmit.
+ * Frames are disposable, so this module offers a datagram path instead:
+ * each JPEG goes out as a burst of numbered fragments with a small
+ * RTP-like header, terminated by a LAST marker. A lost fragment costs
+ * that one frame, never the frames after it. Control and status stay
+ * on the reliable WebSocket.
+ *
+ * The API mirrors the chunked ws_client send path so the incremental
+ * JPEG encoder can feed either transport unchanged.
+ */
+
+#ifndef UDP_STREAM_H
+#define UDP_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Compile-time switch: set to 0 to keep all video on the WebSocket
+#define UDP_STREAM_ENABLED 1
+
+// Must match UDP_VIDEO_PORT on the ESP32-S3 receiver
+#define UDP_STREAM_PORT 5005
+
+/**
+ * @brief Open the UDP socket towards the video receiver.
+ *
+ * @param host Server IP in dotted-quad form (the SoftAP gateway)
+ * @param port UDP port the server listens on (UDP_STREAM_PORT)
+ * @return ESP_OK on success
+ */
+esp_err_t udp_stream_init(const char *host, uint16_t port);
+
+/**
+ * @brief True when the socket is open and frames can be sent.
+ */
+bool udp_stream_ready(void);
+
+/**
+ * @brief Send part of the current frame; first starts a new frame.
+ *
+ * Chunks of any size are accepted and re-split into MTU-sized
+ * fragments. Fire and forget: a rejected sendto() poisons the current
+ * frame (the receiver discards it) but never blocks or retries.
+ */
+esp_err_t udp_stream_send_chunk(const uint8_t *chunk, size_t len, bool first);
+
+/**
+ * @brief Terminate the current frame with the LAST marker.
+ */
+esp_err_t udp_stream_send_finish(void);
+
+/**
+ * @brief Convenience wrapper for a contiguous JPEG: chunk + finish.
+ */
+esp_err_t udp_stream_send_frame(const uint8_t *jpeg, size_t len);
+
+/**
+ * @brief Close the socket; udp_stream_ready() turns false.
+ */
+void udp_stream_deinit(void);
+
+#endif // UDP_STREAM_H
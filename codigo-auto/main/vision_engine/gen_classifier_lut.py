@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Build-time generator for the default classifier lookup table.
+
+Reads the HSV_GREEN_* thresholds from hardware_config.h and emits a C
+file with the 1-bit-per-RGB565-value classifier table as a const array,
+so default-configuration boots skip the ~65K-conversion runtime build.
+
+The integer math below mirrors vk_rgb565_to_hsv() / vk_hsv_in_range()
+in components/vision_kernels exactly, including C's
+truncate-toward-zero division and uint8_t wraparound, so the generated
+table is bit-identical to what classifier_lut_build() would produce for
+the same thresholds. If the kernels change, change this too.
+
+Usage: gen_classifier_lut.py <hardware_config.h> <output.c>
+"""
+
+import re
+import sys
+
+LUT_WORDS = 65536 // 32
+
+
+def c_div(n, d):
+    """Integer division with C semantics (truncate toward zero)."""
+    q = abs(n) // d
+    return q if n >= 0 else -q
+
+
+def parse_thresholds(header_path):
+    text = open(header_path, encoding="utf-8").read()
+    values = {}
+    for name in ("H_MIN", "H_MAX", "S_MIN", "S_MAX", "V_MIN", "V_MAX"):
+        match = re.search(r"#define\s+HSV_GREEN_%s\s+(\d+)" % name, text)
+        if not match:
+            sys.exit("HSV_GREEN_%s not found in %s" % (name, header_path))
+        values[name] = int(match.group(1))
+    return values
+
+
+def classify(pixel, t):
+    r = (pixel & 0xF800) >> 8
+    g = (pixel & 0x07E0) >> 3
+    b = (pixel & 0x001F) << 3
+
+    max_val = max(r, g, b)
+    delta = max_val - min(r, g, b)
+
+    v = max_val
+    if delta == 0:
+        h = 0
+        s = 0
+    else:
+        s = (delta * 255) // max_val
+        if r == max_val:
+            h = (255 if g < b else 0) + c_div(43 * (g - b), delta)
+        elif g == max_val:
+            h = 85 + c_div(43 * (b - r), delta)
+        else:
+            h = 171 + c_div(43 * (r - g), delta)
+        h &= 0xFF  # uint8_t assignment in C
+
+    if s < t["S_MIN"] or s > t["S_MAX"]:
+        return False
+    if v < t["V_MIN"] or v > t["V_MAX"]:
+        return False
+    if t["H_MIN"] <= t["H_MAX"]:
+        return t["H_MIN"] <= h <= t["H_MAX"]
+    return h >= t["H_MIN"] or h <= t["H_MAX"]
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    thresholds = parse_thresholds(sys.argv[1])
+
+    words = [0] * LUT_WORDS
+    for pixel in range(65536):
+        if classify(pixel, thresholds):
+            words[pixel >> 5] |= 1 << (pixel & 31)
+
+    lines = []
+    lines.append("// Generated by gen_classifier_lut.py - do not edit.")
+    lines.append("// Default green classifier table for HSV thresholds "
+                 "H [%d,%d] S [%d,%d] V [%d,%d]."
+                 % (thresholds["H_MIN"], thresholds["H_MAX"],
+                    thresholds["S_MIN"], thresholds["S_MAX"],
+                    thresholds["V_MIN"], thresholds["V_MAX"]))
+    lines.append("#include <stdint.h>")
+    lines.append("")
+    lines.append("const uint32_t g_classifier_lut_default[%d] = {" % LUT_WORDS)
+    for i in range(0, LUT_WORDS, 8):
+        row = ", ".join("0x%08x" % w for w in words[i:i + 8])
+        lines.append("    %s," % row)
+    lines.append("};")
+    lines.append("")
+
+    with open(sys.argv[2], "w", encoding="utf-8") as out:
+        out.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
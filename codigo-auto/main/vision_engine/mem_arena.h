@@ -0,0 +1,84 @@
+/**
+ * @file mem_arena.h
+ * @brief Per-frame bump allocator for vision scratch memory
+ *
+ * The vision stages need frame-lifetime scratch (packed masks, label
+ * tables, staging buffers) that must never come from the general heap:
+ * per-frame malloc/free at 20Hz is exactly the churn that fragmented
+ * the heap under the camera frame buffers. The arena grabs one internal
+ * block and one PSRAM block at init and hands out pointer-bump slices;
+ * mem_arena_reset() recycles both in O(1) at the start of each frame.
+ *
+ * Not thread-safe by design: allocate from the pipeline task that owns
+ * the frame, before dispatching work to the scan workers (same contract
+ * as the static scratch it replaces).
+ */
+
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Reserve the backing regions. Call once at startup.
+     *
+     * A missing PSRAM region is not fatal: large requests then compete
+     * for the internal block.
+     *
+     * @param internal_size Bytes of internal RAM for hot scratch
+     * @param psram_size Bytes of PSRAM for large/cold scratch (0 = none)
+     * @return ESP_OK, or ESP_ERR_NO_MEM if the internal block failed
+     */
+    esp_err_t mem_arena_init(size_t internal_size, size_t psram_size);
+
+    /**
+     * @brief Allocate frame-lifetime scratch, internal RAM first
+     *
+     * Falls back to the PSRAM region when the internal block is full.
+     *
+     * @return 8-byte-aligned pointer, or NULL if both regions are full
+     *         (callers degrade the stage, they never block on this)
+     */
+    void *mem_arena_alloc(size_t size);
+
+    /**
+     * @brief Allocate frame-lifetime scratch, PSRAM first
+     *
+     * For buffers too large or too cold to deserve internal RAM.
+     */
+    void *mem_arena_alloc_psram(size_t size);
+
+    /**
+     * @brief Recycle both regions in O(1). Call once per frame, before
+     *        the first stage allocates. No arena pointer survives it.
+     */
+    void mem_arena_reset(void);
+
+    /**
+     * @brief Reset counter, bumped by mem_arena_reset()
+     *
+     * Lets a stage that runs more than once per frame reuse its first
+     * allocation instead of taking a second slice.
+     */
+    uint32_t mem_arena_generation(void);
+
+    /**
+     * @brief Lifetime high-water mark of each region in bytes
+     *
+     * The sizing feedback for the monitor: a high-water mark near the
+     * region size means the next stage addition will start spilling.
+     */
+    void mem_arena_high_water(size_t *internal_hwm, size_t *psram_hwm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEM_ARENA_H
@@ -10,17 +10,33 @@
  */
 
 #include "vision_engine.h"
+#include "mem_arena.h"
 #include "../hardware_config.h"
 #include "../ws_client/ws_client.h"
+#include "../motor_control/motor_control.h"
+#include "../trace_points.h"
+#include "../trace_log/trace_log.h"
+#include "../blackbox/blackbox.h"
+#include "../dataset_capture/dataset_capture.h"
+#include "vision_kernels.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_pm.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
+#ifdef CONFIG_VISION_VERIFY_IRAM_PLACEMENT
+#include "esp_memory_utils.h"
+#endif
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "driver/gpio.h"
+#include "nvs.h"
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
+#include <stdatomic.h>
 
 // OpenCV includes - using C-style port for ESP32
 // NOTE: esp32-camera component must be added to dependencies
@@ -48,7 +64,10 @@ typedef struct
     bool wrap;
 } hsv_range_t;
 
-static const hsv_range_t kGreenRange = {
+// Active thresholds; HSV_GREEN_* provide the defaults and the runtime
+// API can retune them without a reflash (lighting changes through the
+// day on the course)
+static hsv_range_t s_green_range = {
     .h_min = HSV_GREEN_H_MIN,
     .h_max = HSV_GREEN_H_MAX,
     .s_min = HSV_GREEN_S_MIN,
@@ -57,421 +76,4280 @@ static const hsv_range_t kGreenRange = {
     .v_max = HSV_GREEN_V_MAX,
     .wrap = (HSV_GREEN_H_MIN > HSV_GREEN_H_MAX)};
 
-static inline void rgb565_to_hsv_fast(uint16_t pixel, uint8_t *h, uint8_t *s, uint8_t *v)
-{
-    uint8_t r = (pixel & 0xF800) >> 8;
-    uint8_t g = (pixel & 0x07E0) >> 3;
-    uint8_t b = (pixel & 0x001F) << 3;
-
-    uint8_t min_val = (r < g) ? (r < b ? r : b) : (g < b ? g : b);
-    uint8_t max_val = (r > g) ? (r > b ? r : b) : (g > b ? g : b);
-    uint8_t delta = max_val - min_val;
-
-    *v = max_val;
+// Compile-time defaults, kept around to recognize at boot whether a
+// stored calibration actually changed anything
+static const hsv_range_t s_green_range_defaults = {
+    .h_min = HSV_GREEN_H_MIN,
+    .h_max = HSV_GREEN_H_MAX,
+    .s_min = HSV_GREEN_S_MIN,
+    .s_max = HSV_GREEN_S_MAX,
+    .v_min = HSV_GREEN_V_MIN,
+    .v_max = HSV_GREEN_V_MAX,
+    .wrap = (HSV_GREEN_H_MIN > HSV_GREEN_H_MAX)};
 
-    if (delta == 0)
-    {
-        *h = 0;
-        *s = 0;
-        return;
-    }
+static inline bool hsv_range_equal(const hsv_range_t *a, const hsv_range_t *b)
+{
+    return a->h_min == b->h_min && a->h_max == b->h_max &&
+           a->s_min == b->s_min && a->s_max == b->s_max &&
+           a->v_min == b->v_min && a->v_max == b->v_max;
+}
 
-    *s = (uint16_t)(delta << 8) / max_val;
+// Conversion and range-check kernels come from the shared
+// vision_kernels component (also used by the external camera). These
+// wrappers keep the historical local names at the call sites. Note the
+// shared kernel scales saturation as (delta * 255) / max, fixing the
+// old (delta << 8) truncation that zeroed S for fully saturated pixels.
+static inline void rgb565_to_hsv_fast(uint16_t pixel, uint8_t *h, uint8_t *s, uint8_t *v)
+{
+    vk_rgb565_to_hsv(pixel, h, s, v);
+}
 
-    if (r == max_val)
-    {
-        *h = (g >= b) ? (43 * (g - b)) / delta : 255 + (43 * (g - b)) / delta;
-    }
-    else if (g == max_val)
-    {
-        *h = 85 + (43 * (b - r)) / delta;
-    }
-    else
-    {
-        *h = 171 + (43 * (r - g)) / delta;
-    }
+/**
+ * Hue-and-value-only variant: skips the saturation division, the
+ * costliest op in the conversion. Used by the hue-only classifier mode
+ * when the S bounds cannot reject anything the hue check accepts.
+ */
+static inline void rgb565_to_hue_value(uint16_t pixel, uint8_t *h, uint8_t *v)
+{
+    vk_rgb565_to_hue_value(pixel, h, v);
 }
 
 static inline bool hsv_in_range(uint8_t h, uint8_t s, uint8_t v, const hsv_range_t *range)
 {
-    if (s < range->s_min || s > range->s_max)
-    {
-        return false;
-    }
-
-    if (v < range->v_min || v > range->v_max)
-    {
-        return false;
-    }
-
-    if (!range->wrap)
-    {
-        return (h >= range->h_min) && (h <= range->h_max);
-    }
-
-    return (h >= range->h_min) || (h <= range->h_max);
+    // range->wrap is always derived from h_min > h_max, which is how
+    // the shared kernel encodes wraparound
+    return vk_hsv_in_range(h, s, v,
+                           range->h_min, range->h_max,
+                           range->s_min, range->s_max,
+                           range->v_min, range->v_max);
 }
 
 // ============================================================================
-// GLOBAL STATE
+// CLASSIFIER LOOKUP TABLE
 // ============================================================================
 
-static TaskHandle_t s_vision_task_handle = NULL;
-static SemaphoreHandle_t s_result_mutex = NULL;
-static vision_result_t s_last_result = {0};
-static bool s_veto_active = false;
-static bool s_debug_enabled = false;
-static bool s_task_running = false;
+/**
+ * RGB565 only has 65536 possible values, so the full HSV conversion +
+ * range check can be precomputed into a 1-bit-per-value table (8KB).
+ * The per-pixel cost in process_frame() drops from two integer divisions
+ * to a single table probe. Lives in internal RAM (.bss), not PSRAM.
+ *
+ * Double-buffered for runtime retuning: a threshold change builds into
+ * the inactive copy and publishes it with one atomic pointer store.
+ * process_frame() snapshots the pointer once per frame, so a frame that
+ * started on the old table finishes on it - no frame ever observes
+ * mixed thresholds.
+ *
+ * The default-threshold table is generated at build time
+ * (gen_classifier_lut.py, wired into the component CMakeLists) into
+ * flash-mapped rodata and published from the start, so boots that keep
+ * the compile-time thresholds never run the ~65K-conversion build at
+ * all. Runtime rebuilds go into the RAM copies as before.
+ */
+#define CLASSIFIER_LUT_WORDS (65536 / 32)
 
-// Statistics
-static uint32_t s_frame_counter = 0;
-static uint64_t s_total_process_time_us = 0;
+extern const uint32_t g_classifier_lut_default[CLASSIFIER_LUT_WORDS];
 
-#if defined(CAM_FLASH_LED_GPIO) && (CAM_FLASH_LED_GPIO >= 0)
-static void disable_camera_flash_led(void)
-{
-    gpio_config_t cfg = {
-        .pin_bit_mask = (1ULL << CAM_FLASH_LED_GPIO),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-    };
+static uint32_t s_lut_store[2][CLASSIFIER_LUT_WORDS];
+static const uint32_t *_Atomic s_lut_published = g_classifier_lut_default;
+static const uint32_t *s_lut_frame = g_classifier_lut_default; // Per-frame snapshot
+static int s_lut_build_slot = 0;                               // Next build target
+static atomic_flag s_lut_build_busy = ATOMIC_FLAG_INIT;
 
-    gpio_config(&cfg);
-    gpio_set_level(CAM_FLASH_LED_GPIO, 0);
-    ESP_LOGI(TAG, "Camera flash LED forced LOW (GPIO%d)", CAM_FLASH_LED_GPIO);
-}
-#else
-static inline void disable_camera_flash_led(void) {}
-#endif
+// Hue-only classifier mode: the LUT already removed the per-pixel
+// division, but rebuilds (65K conversions) still pay it. With S bounds
+// wide open the skip is bit-identical and engages automatically; the
+// runtime flag forces it for high-contrast arenas where S never rejects
+// what hue accepts.
+static bool s_hue_only_mode = false;
 
-static bool stream_frame_over_ws(camera_fb_t *fb)
+/**
+ * @brief Rebuild the 1bpp classifier table and publish it atomically
+ *
+ * Runs the exact rgb565_to_hsv_fast() + hsv_in_range() pipeline once per
+ * possible pixel value, so the table is bit-identical to the previous
+ * per-pixel path. Takes a few ms; never called per frame. Builds are
+ * serialized - a second caller mid-build gets ESP_ERR_INVALID_STATE.
+ */
+static esp_err_t classifier_lut_build(const hsv_range_t *range)
 {
-    if (!ws_client_is_connected() || !ws_client_stream_enabled())
+    if (atomic_flag_test_and_set(&s_lut_build_busy))
     {
-        return false;
+        return ESP_ERR_INVALID_STATE;
     }
 
-    int quality = STREAM_JPEG_QUALITY_DEFAULT;
+    uint64_t start = esp_timer_get_time();
+    uint32_t *lut = s_lut_store[s_lut_build_slot];
 
-    while (quality >= STREAM_JPEG_QUALITY_MIN)
-    {
-        uint8_t *jpeg_buf = NULL;
-        size_t jpeg_len = 0;
+    memset(lut, 0, CLASSIFIER_LUT_WORDS * sizeof(uint32_t));
 
-        if (!frame2jpg(fb, quality, &jpeg_buf, &jpeg_len))
+    // Skip the saturation division when nothing can reject on S
+    bool need_s = !s_hue_only_mode &&
+                  (range->s_min > 0 || range->s_max < 255);
+
+    for (uint32_t pixel = 0; pixel < 65536; pixel++)
+    {
+        uint8_t h, s, v;
+        bool in;
+        if (need_s)
         {
-            ESP_LOGE(TAG, "frame2jpg failed at quality %d", quality);
-            return false;
+            rgb565_to_hsv_fast((uint16_t)pixel, &h, &s, &v);
+            in = hsv_in_range(h, s, v, range);
         }
-
-        if (jpeg_len > (WS_MAX_PAYLOAD_SIZE - 128) && quality > STREAM_JPEG_QUALITY_MIN)
+        else
         {
-            ESP_LOGW(TAG, "JPEG %d bytes > limit %d @Q%d, retrying",
-                     (int)jpeg_len, WS_MAX_PAYLOAD_SIZE, quality);
-            free(jpeg_buf);
-            quality -= STREAM_JPEG_QUALITY_STEP;
-            continue;
+            rgb565_to_hue_value((uint16_t)pixel, &h, &v);
+            in = (v >= range->v_min && v <= range->v_max) &&
+                 (!range->wrap ? (h >= range->h_min && h <= range->h_max)
+                               : (h >= range->h_min || h <= range->h_max));
         }
-
-        esp_err_t err = ws_client_send_frame(jpeg_buf, jpeg_len);
-        free(jpeg_buf);
-
-        if (err != ESP_OK)
+        if (in)
         {
-            ESP_LOGW(TAG, "WebSocket send failed: %s", esp_err_to_name(err));
-            return false;
+            lut[pixel >> 5] |= (1UL << (pixel & 31));
         }
-
-        return true;
     }
 
-    ESP_LOGE(TAG, "Unable to compress frame under %d bytes", WS_MAX_PAYLOAD_SIZE);
-    return false;
+    atomic_store_explicit(&s_lut_published, lut, memory_order_release);
+    s_lut_build_slot ^= 1;
+
+    ESP_LOGI(TAG, "Classifier LUT built (%u bytes) in %lld us",
+             (unsigned)(CLASSIFIER_LUT_WORDS * sizeof(uint32_t)),
+             (long long)(esp_timer_get_time() - start));
+
+    atomic_flag_clear(&s_lut_build_busy);
+    return ESP_OK;
+}
+
+/**
+ * @brief Classify one RGB565 pixel against the frame's table snapshot
+ */
+static inline bool classifier_lut_probe(uint16_t pixel)
+{
+    return (s_lut_frame[pixel >> 5] >> (pixel & 31)) & 1u;
 }
 
 // ============================================================================
-// CAMERA INITIALIZATION
+// HSV AUTO-CALIBRATION
 // ============================================================================
 
 /**
- * @brief Configure camera with AI Thinker ESP32-CAM pinout
+ * Replaces trial-and-error threshold tuning over serial logs: with the
+ * reference green marker centered in view, the dashboard triggers a
+ * sweep and the vision task histograms H/S/V over the central window
+ * for CALIB_FRAMES frames. The tight range covering the central
+ * 2%-98% of each channel then becomes the new classifier range
+ * (atomic LUT rebuild) and is persisted to NVS, so it survives reboots.
+ * Tighter ranges shrink the false-positive pixel population that every
+ * scan pays for. Vision task context only.
  */
-static esp_err_t init_camera(void)
-{
-    ESP_LOGI(TAG, "Initializing OV2640 camera...");
 
-    camera_config_t config = {
-        .pin_pwdn = CAM_PIN_PWDN,
-        .pin_reset = CAM_PIN_RESET,
-        .pin_xclk = CAM_PIN_XCLK,
-        .pin_sccb_sda = CAM_PIN_SIOD,
-        .pin_sccb_scl = CAM_PIN_SIOC,
+#define CALIB_FRAMES 30        // Frames accumulated per sweep
+#define CALIB_TAIL_PERCENT 2   // Histogram tail trimmed on each side
+#define CALIB_WINDOW_DIV 3     // Sample the central 1/CALIB_WINDOW_DIV of the frame
 
-        .pin_d7 = CAM_PIN_Y9,
-        .pin_d6 = CAM_PIN_Y8,
-        .pin_d5 = CAM_PIN_Y7,
-        .pin_d4 = CAM_PIN_Y6,
-        .pin_d3 = CAM_PIN_Y5,
-        .pin_d2 = CAM_PIN_Y4,
-        .pin_d1 = CAM_PIN_Y3,
-        .pin_d0 = CAM_PIN_Y2,
-        .pin_vsync = CAM_PIN_VSYNC,
-        .pin_href = CAM_PIN_HREF,
-        .pin_pclk = CAM_PIN_PCLK,
+static const char *CALIB_NVS_NAMESPACE = "vision";
+static const char *const CALIB_NVS_KEYS[6] = {
+    "h_min", "h_max", "s_min", "s_max", "v_min", "v_max"};
 
-        // Camera settings
-        .xclk_freq_hz = 20000000, // 20MHz XCLK
-        .ledc_timer = LEDC_TIMER_1,
-        .ledc_channel = LEDC_CHANNEL_2,
+static volatile int s_calib_frames_left = 0; // >0 while a sweep runs
+static uint32_t s_calib_hist[3][256];        // H, S, V histograms
+static uint64_t s_calib_samples = 0;
 
-        .pixel_format = CAM_PIXEL_FORMAT, // RGB565 for processing
-        .frame_size = CAM_FRAME_SIZE,     // QVGA (320x240)
-        .jpeg_quality = CAM_JPEG_QUALITY, // Not used for RGB565
-        .fb_count = CAM_FB_COUNT,         // Double buffering
-        .fb_location = CAM_FB_LOCATION,   // PSRAM (critical!)
-        .grab_mode = CAMERA_GRAB_LATEST   // Always get latest frame
-    };
+/**
+ * @brief Find the value range covering the trimmed histogram mass
+ */
+static void calib_hist_range(const uint32_t *hist, uint64_t total,
+                             uint8_t *out_min, uint8_t *out_max)
+{
+    uint64_t tail = (total * CALIB_TAIL_PERCENT) / 100;
+    uint64_t acc = 0;
+    int lo = 0;
+    int hi = 255;
 
-    esp_err_t err = esp_camera_init(&config);
-    if (err != ESP_OK)
+    for (int i = 0; i < 256; i++)
     {
-        ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
-        return err;
+        acc += hist[i];
+        if (acc > tail)
+        {
+            lo = i;
+            break;
+        }
     }
 
-    disable_camera_flash_led();
-
-    // Camera sensor tuning
-    sensor_t *s = esp_camera_sensor_get();
-    if (s == NULL)
+    acc = 0;
+    for (int i = 255; i >= 0; i--)
     {
-        ESP_LOGE(TAG, "Failed to get camera sensor");
-        return ESP_FAIL;
+        acc += hist[i];
+        if (acc > tail)
+        {
+            hi = i;
+            break;
+        }
     }
 
-    // Optimize for vision processing (not aesthetics)
-    s->set_brightness(s, 0);                 // Default brightness
-    s->set_contrast(s, 0);                   // Default contrast
-    s->set_saturation(s, 0);                 // Default saturation
-    s->set_special_effect(s, 0);             // No special effects
-    s->set_whitebal(s, 1);                   // Auto white balance ON
-    s->set_awb_gain(s, 1);                   // Auto white balance gain ON
-    s->set_wb_mode(s, 0);                    // White balance mode auto
-    s->set_exposure_ctrl(s, 1);              // Auto exposure ON
-    s->set_aec2(s, 0);                       // AEC sensor ON
-    s->set_ae_level(s, 0);                   // Auto exposure level 0
-    s->set_aec_value(s, 300);                // Auto exposure value
-    s->set_gain_ctrl(s, 1);                  // Auto gain ON
-    s->set_agc_gain(s, 0);                   // Auto gain value
-    s->set_gainceiling(s, (gainceiling_t)0); // Gain ceiling
-    s->set_bpc(s, 0);                        // Black pixel correction OFF
-    s->set_wpc(s, 1);                        // White pixel correction ON
-    s->set_raw_gma(s, 1);                    // Gamma correction ON
-    s->set_lenc(s, 1);                       // Lens correction ON
-    s->set_hmirror(s, 0);                    // Horizontal mirror OFF
-    s->set_vflip(s, 0);                      // Vertical flip OFF
-    s->set_dcw(s, 1);                        // Downsize enable ON
-    s->set_colorbar(s, 0);                   // Color bar test pattern OFF
-
-    ESP_LOGI(TAG, "Camera initialized successfully");
-    ESP_LOGI(TAG, "Resolution: %dx%d, Format: RGB565, Buffers: %d (PSRAM)",
-             IMAGE_WIDTH, IMAGE_HEIGHT, CAM_FB_COUNT);
-
-    return ESP_OK;
+    *out_min = (uint8_t)lo;
+    *out_max = (uint8_t)(hi >= lo ? hi : lo);
 }
 
-// ============================================================================
-// IMAGE PROCESSING FUNCTIONS
-// ============================================================================
-
 /**
- * @brief Estimate distance using pinhole camera model
- *
- * Formula: distance = (real_width * focal_length) / pixel_width
- *
- * @param pixel_width Width of object in pixels
- * @return Estimated distance in centimeters
+ * @brief Persist a calibrated range to NVS
  */
-static inline float estimate_distance(int pixel_width)
+static void calib_persist(const hsv_range_t *range)
 {
-    if (pixel_width <= 0)
-        return 999.9f; // Invalid
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "NVS open failed (0x%x) - calibration not persisted", err);
+        return;
+    }
+
+    const uint8_t values[6] = {range->h_min, range->h_max, range->s_min,
+                               range->s_max, range->v_min, range->v_max};
+
+    for (int i = 0; i < 6; i++)
+    {
+        nvs_set_u8(handle, CALIB_NVS_KEYS[i], values[i]);
+    }
 
-    float distance = (KNOWN_OBJECT_WIDTH_CM * CAMERA_FOCAL_LENGTH_PX) / (float)pixel_width;
-    return distance;
+    nvs_commit(handle);
+    nvs_close(handle);
+    ESP_LOGI(TAG, "Calibrated HSV range persisted to NVS");
 }
 
 /**
- * @brief Process single frame for green obstacle detection
- *
- * Pipeline:
- * 1. Get RGB565 frame from camera (zero-copy)
- * 2. Convert RGB565 -> BGR888 -> HSV
- * 3. Threshold for green color
- * 4. Morphological filtering (noise removal)
- * 5. Find contours
- * 6. Calculate largest object bounding box
- * 7. Estimate distance
- *
- * @param[out] result Detection result structure
- * @return ESP_OK on success
+ * @brief Load a persisted range, if any, over the compile-time defaults
  */
-static esp_err_t process_frame(vision_result_t *result)
+static void calib_load(hsv_range_t *range)
 {
-    uint64_t start_time = esp_timer_get_time();
-
-    // 1. Capture frame
-    camera_fb_t *fb = esp_camera_fb_get();
-    if (!fb)
+    nvs_handle_t handle;
+    if (nvs_open(CALIB_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
     {
-        ESP_LOGW(TAG, "Camera capture failed");
-        return ESP_FAIL;
+        return; // First boot - keep the defaults
     }
 
-    ESP_LOGD(TAG, "Frame captured: %dx%d, %zu bytes, format=%d",
-             fb->width, fb->height, fb->len, fb->format);
-
-    // Initialize result
-    result->obstacle_detected = false;
-    result->distance_cm = 999.9f;
-    result->centroid_x = 0;
-    result->centroid_y = 0;
-    result->contour_area = 0;
-
-    const uint16_t *pixels = (const uint16_t *)fb->buf;
-    uint32_t sum_x = 0;
-    uint32_t sum_y = 0;
-    uint32_t hit_count = 0;
-    int min_x = fb->width;
-    int max_x = -1;
-    int min_y = fb->height;
-    int max_y = -1;
+    uint8_t values[6];
+    bool complete = true;
 
-    for (int y = 0; y < fb->height; y++)
+    for (int i = 0; i < 6; i++)
     {
-        const uint16_t *row = pixels + (y * fb->width);
-        for (int x = 0; x < fb->width; x++)
+        if (nvs_get_u8(handle, CALIB_NVS_KEYS[i], &values[i]) != ESP_OK)
         {
-            uint8_t h, s, v;
-            rgb565_to_hsv_fast(row[x], &h, &s, &v);
-
-            if (!hsv_in_range(h, s, v, &kGreenRange))
-            {
-                continue;
-            }
-
-            sum_x += x;
-            sum_y += y;
-            hit_count++;
-
-            if (x < min_x)
-                min_x = x;
-            if (x > max_x)
-                max_x = x;
-            if (y < min_y)
-                min_y = y;
-            if (y > max_y)
-                max_y = y;
+            complete = false;
+            break;
         }
     }
 
-    const int image_area = fb->width * fb->height;
-    const int max_allowed_area = (int)(image_area * MAX_CONTOUR_AREA_RATIO);
+    nvs_close(handle);
 
-    if (hit_count >= MIN_CONTOUR_AREA && hit_count < (uint32_t)max_allowed_area && max_x >= 0)
+    if (!complete)
     {
-        result->obstacle_detected = true;
-        result->centroid_x = sum_x / hit_count;
-        result->centroid_y = sum_y / hit_count;
-        result->contour_area = hit_count;
+        return;
+    }
 
-        int bbox_width = (max_x - min_x) + 1;
-        result->distance_cm = estimate_distance(bbox_width);
+    range->h_min = values[0];
+    range->h_max = values[1];
+    range->s_min = values[2];
+    range->s_max = values[3];
+    range->v_min = values[4];
+    range->v_max = values[5];
+    range->wrap = (range->h_min > range->h_max);
 
-        if (s_debug_enabled)
+    ESP_LOGI(TAG, "Loaded calibrated HSV range from NVS: H[%u-%u] S[%u-%u] V[%u-%u]",
+             range->h_min, range->h_max, range->s_min, range->s_max,
+             range->v_min, range->v_max);
+}
+
+/**
+ * @brief Accumulate one frame into the sweep; finish on the last one
+ */
+static void calib_accumulate(const uint16_t *pixels, int frame_width, int frame_height)
+{
+    const int x0 = frame_width * (CALIB_WINDOW_DIV - 1) / (2 * CALIB_WINDOW_DIV);
+    const int y0 = frame_height * (CALIB_WINDOW_DIV - 1) / (2 * CALIB_WINDOW_DIV);
+    const int x1 = x0 + frame_width / CALIB_WINDOW_DIV;
+    const int y1 = y0 + frame_height / CALIB_WINDOW_DIV;
+
+    for (int y = y0; y < y1; y++)
+    {
+        const uint16_t *row = pixels + (y * frame_width);
+        for (int x = x0; x < x1; x++)
         {
-            ESP_LOGI(TAG, "Obstáculo verde: %.1f cm @ (%d,%d) area=%d",
-                     result->distance_cm, result->centroid_x, result->centroid_y, result->contour_area);
+            uint8_t h, sat, v;
+            rgb565_to_hsv_fast(row[x], &h, &sat, &v);
+            s_calib_hist[0][h]++;
+            s_calib_hist[1][sat]++;
+            s_calib_hist[2][v]++;
+            s_calib_samples++;
         }
     }
-    else
+
+    if (--s_calib_frames_left > 0)
     {
-        result->obstacle_detected = false;
-        result->distance_cm = 999.9f;
+        return;
     }
 
-    uint32_t frame_index = ++s_frame_counter;
-    result->frame_count = frame_index;
+    // Sweep complete: trim the tails into a tight range
+    hsv_range_t range;
+    calib_hist_range(s_calib_hist[0], s_calib_samples, &range.h_min, &range.h_max);
+    calib_hist_range(s_calib_hist[1], s_calib_samples, &range.s_min, &range.s_max);
+    calib_hist_range(s_calib_hist[2], s_calib_samples, &range.v_min, &range.v_max);
+    range.wrap = false; // Trimmed percentiles are always an ordered span
+
+    ESP_LOGI(TAG, "Calibration done (%llu samples): H[%u-%u] S[%u-%u] V[%u-%u]",
+             (unsigned long long)s_calib_samples,
+             range.h_min, range.h_max, range.s_min, range.s_max,
+             range.v_min, range.v_max);
 
-    if ((frame_index % STREAM_FRAME_INTERVAL) == 0)
+    if (classifier_lut_build(&range) == ESP_OK)
     {
-        stream_frame_over_ws(fb);
+        s_green_range = range;
+        calib_persist(&range);
     }
-
-    // Return frame buffer to driver
-    esp_camera_fb_return(fb);
-
-    // Calculate processing time
-    uint64_t end_time = esp_timer_get_time();
-    result->processing_time_ms = (end_time - start_time) / 1000;
-    if (result->frame_count == 0)
+    else
     {
-        result->frame_count = ++s_frame_counter;
+        ESP_LOGW(TAG, "LUT rebuild busy - calibration result discarded");
     }
-
-    ESP_LOGD(TAG, "Frame processed in %u ms", result->processing_time_ms);
-
-    return ESP_OK;
 }
 
 // ============================================================================
-// VISION PROCESSING TASK
+// GLOBAL STATE
 // ============================================================================
 
-/**
- * @brief Main vision processing task (runs on Core 1)
- */
-static void vision_task(void *pvParameters)
-{
-    ESP_LOGI(TAG, "Vision task started on core %d", xPortGetCoreID());
+static TaskHandle_t s_vision_task_handle = NULL;
+
+// Stop/join handshake. vision_engine_stop() used to clear the run flag
+// and blindly sleep 200 ms hoping the tasks had exited - a fixed cost
+// plus a race on every mode switch. Each pipeline task now acknowledges
+// its exit on a semaphore, the stop wake semaphore cuts the governor's
+// idle throttle sleep short (up to a second when parked), and a NULL
+// sentinel wakes the encoder out of its queue wait, so a stop completes
+// as soon as the in-flight frame does: single-digit milliseconds
+// between frames, one frame time worst case inside fb_get.
+#define VISION_STOP_JOIN_TIMEOUT_MS 250
+
+static SemaphoreHandle_t s_vision_exit_sem = NULL;
+static StaticSemaphore_t s_vision_exit_sem_buf;
+static SemaphoreHandle_t s_stream_exit_sem = NULL;
+static StaticSemaphore_t s_stream_exit_sem_buf;
+static SemaphoreHandle_t s_vision_wake_sem = NULL;
+static StaticSemaphore_t s_vision_wake_sem_buf;
+static bool s_debug_enabled = false;
+static bool s_task_running = false;
+
+// The vision pipeline tasks run for the whole uptime, so their stacks
+// and control blocks live in BSS instead of being carved out of the
+// heap the JPEG encoder fragments (stop/start reuses the same buffers)
+#define VISION_TASK_STACK_SIZE 8192 // OpenCV needs substantial stack
+#define SCAN_WORKER_STACK_SIZE 3072
+#define STREAM_TASK_STACK_SIZE 4096 // frame2jpg works through sizeable stack buffers
 
+static StackType_t s_vision_task_stack[VISION_TASK_STACK_SIZE];
+static StaticTask_t s_vision_task_tcb;
+static StackType_t s_scan_worker_stack[SCAN_WORKER_STACK_SIZE];
+static StaticTask_t s_scan_worker_tcb;
+static StackType_t s_stream_task_stack[STREAM_TASK_STACK_SIZE];
+static StaticTask_t s_stream_task_tcb;
+
+// Detection result publication: single writer (vision task), any number
+// of readers, zero locks. Results go into a small ring of versioned
+// slots; the generation counter names the freshest completed slot, so a
+// reader can hold a const pointer into the ring and dereference it
+// without copying - the producer won't rewrite that slot for another
+// VISION_BUS_SLOTS-1 publications (seconds, at vision frame rates). A
+// reader that might hold the pointer longer checks the generation
+// afterwards (vision_engine_bus_stale) and falls back to the copying
+// snapshot. This replaced first a mutex, then a single-slot seqlock:
+// the seqlock forced every reader to copy, and each new consumer
+// (status task, flight recorder, QoS governor) multiplied the copies.
+#define VISION_BUS_SLOTS 4
+#define VISION_BUS_MAX_SUBSCRIBERS 4
+
+typedef struct
+{
     vision_result_t result;
-    TickType_t last_wake_time = xTaskGetTickCount();
-    const TickType_t frame_period = pdMS_TO_TICKS(100); // ~10 FPS target
+    bool veto;
+} vision_bus_slot_t;
 
-    while (s_task_running)
-    {
-        // Process frame
-        if (process_frame(&result) == ESP_OK)
-        {
-            // Update shared state (thread-safe)
-            if (xSemaphoreTake(s_result_mutex, pdMS_TO_TICKS(10)))
-            {
-                memcpy(&s_last_result, &result, sizeof(vision_result_t));
+static vision_bus_slot_t s_bus_slots[VISION_BUS_SLOTS];
+static atomic_uint_fast32_t s_bus_gen = 0;
+static bool s_veto_active = false; // Producer-private: previous veto for edges
 
-                // Update veto flag
-                s_veto_active = (result.obstacle_detected &&
-                                 result.distance_cm < VETO_DISTANCE_THRESHOLD_CM);
+// Subscribers notified on every publication. Registration is init-time
+// and single-threaded (same contract as the veto edge callback), so the
+// flat array needs no lock; the producer only ever reads it.
+static TaskHandle_t s_bus_subscribers[VISION_BUS_MAX_SUBSCRIBERS];
+static uint32_t s_bus_subscriber_bits[VISION_BUS_MAX_SUBSCRIBERS];
+static int s_bus_subscriber_count = 0;
 
-                if (s_veto_active && s_debug_enabled)
-                {
-                    ESP_LOGW(TAG, "VETO ACTIVE: Obstacle at %.1f cm (threshold %.1f cm)",
-                             result.distance_cm, VETO_DISTANCE_THRESHOLD_CM);
-                }
+// Veto edges additionally fire a callback (see header) so the control
+// task is woken the instant the state flips instead of discovering it
+// at its next snapshot
+static veto_edge_callback_t s_veto_edge_callback = NULL;
 
-                xSemaphoreGive(s_result_mutex);
-            }
+static void result_publish(const vision_result_t *result, bool veto)
+{
+    uint_fast32_t gen = atomic_load_explicit(&s_bus_gen, memory_order_relaxed);
+    vision_bus_slot_t *slot = &s_bus_slots[(gen + 1) % VISION_BUS_SLOTS];
+    bool previous_veto = s_veto_active;
 
-            // Update statistics
-            s_total_process_time_us += result.processing_time_ms * 1000;
-        }
+    memcpy(&slot->result, result, sizeof(vision_result_t));
+    slot->veto = veto;
+    s_veto_active = veto;
+    atomic_store_explicit(&s_bus_gen, gen + 1, memory_order_release);
 
-        // Rate limiting
-        vTaskDelayUntil(&last_wake_time, frame_period);
+    // After the slot is visible: a subscriber woken here already reads
+    // the new generation
+    for (int i = 0; i < s_bus_subscriber_count; i++)
+    {
+        xTaskNotify(s_bus_subscribers[i], s_bus_subscriber_bits[i], eSetBits);
+    }
+
+    if (s_veto_edge_callback && veto != previous_veto)
+    {
+        s_veto_edge_callback(veto);
+    }
+}
+
+const vision_result_t *vision_engine_bus_read(uint32_t *generation, bool *veto)
+{
+    uint_fast32_t gen = atomic_load_explicit(&s_bus_gen, memory_order_acquire);
+    const vision_bus_slot_t *slot = &s_bus_slots[gen % VISION_BUS_SLOTS];
+
+    if (generation)
+    {
+        *generation = (uint32_t)gen;
+    }
+    if (veto)
+    {
+        *veto = slot->veto;
+    }
+    return &slot->result;
+}
+
+bool vision_engine_bus_stale(uint32_t generation)
+{
+    uint_fast32_t gen = atomic_load_explicit(&s_bus_gen, memory_order_acquire);
+    // The slot named by `generation` is rewritten while the producer
+    // publishes generation + VISION_BUS_SLOTS; one short of that is
+    // the last point where a dereference is guaranteed untorn
+    return (uint32_t)gen - generation >= VISION_BUS_SLOTS - 1;
+}
+
+esp_err_t vision_engine_bus_subscribe(TaskHandle_t task, uint32_t notify_bit)
+{
+    if (task == NULL || s_bus_subscriber_count >= VISION_BUS_MAX_SUBSCRIBERS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_bus_subscribers[s_bus_subscriber_count] = task;
+    s_bus_subscriber_bits[s_bus_subscriber_count] = notify_bit;
+    s_bus_subscriber_count++;
+    return ESP_OK;
+}
+
+void vision_engine_set_veto_edge_callback(veto_edge_callback_t callback)
+{
+    s_veto_edge_callback = callback;
+}
+
+// Per-blob output of the labeler, published under its own seqlock so
+// multi-object consumers don't contend with the main result snapshot
+static atomic_uint_fast32_t s_blob_seq = 0;
+static vision_blob_t s_pub_blobs[VISION_MAX_BLOBS];
+static int s_pub_blob_count = 0;
+
+static void blobs_publish(const vision_blob_t *blobs, int count)
+{
+    uint_fast32_t seq = atomic_load_explicit(&s_blob_seq, memory_order_relaxed);
+
+    atomic_store_explicit(&s_blob_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (count > 0)
+    {
+        memcpy(s_pub_blobs, blobs, (size_t)count * sizeof(vision_blob_t));
+    }
+    s_pub_blob_count = (count > 0) ? count : 0;
+
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&s_blob_seq, seq + 2, memory_order_release);
+}
+
+static void result_snapshot(vision_result_t *result, bool *veto)
+{
+    uint_fast32_t gen1, gen2;
+    vision_result_t copy;
+    bool veto_copy;
+
+    do
+    {
+        gen1 = atomic_load_explicit(&s_bus_gen, memory_order_acquire);
+        const vision_bus_slot_t *slot = &s_bus_slots[gen1 % VISION_BUS_SLOTS];
+
+        memcpy(&copy, &slot->result, sizeof(vision_result_t));
+        veto_copy = slot->veto;
+
+        atomic_thread_fence(memory_order_acquire);
+        gen2 = atomic_load_explicit(&s_bus_gen, memory_order_relaxed);
+        // Retry only if the producer lapped far enough to have rewritten
+        // the slot we copied from - practically never at frame rates
+    } while (gen2 - gen1 >= VISION_BUS_SLOTS - 1);
+
+    if (result)
+    {
+        memcpy(result, &copy, sizeof(vision_result_t));
+    }
+    if (veto)
+    {
+        *veto = veto_copy;
+    }
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+/**
+ * Fleet dashboards consume these numbers, and unsynchronized reads used
+ * to produce garbage spikes: the 64-bit time accumulator tears on the
+ * 32-bit ESP32 and the frame counter raced its own average. The frame/
+ * time pair is now published under a seqlock (vision task is the only
+ * writer), and the independent event counters are 32-bit atomics that
+ * any task may bump; vision_engine_get_counters() snapshots them all.
+ */
+
+static _Atomic uint32_t s_frame_counter = 0;
+static uint64_t s_total_process_time_us = 0; // Stats seqlock only
+
+// Seqlock over the (frame_count, total_process_time) pair so averages
+// never mix a new count with an old sum
+static _Atomic uint32_t s_stats_seq = 0;
+
+// Independent event counters (single 32-bit words: no tearing)
+static _Atomic uint32_t s_capture_failures = 0;
+static _Atomic uint32_t s_motion_skips = 0;
+
+// ============================================================================
+// LATENCY HISTOGRAMS
+// ============================================================================
+
+/**
+ * Lifetime averages hide exactly the stalls that cause late vetoes, so
+ * per-frame processing time and capture-to-publish latency also feed
+ * fixed-bucket histograms (2ms buckets up to 126ms, last bucket is a
+ * catch-all). Percentiles and max are computed on read and the window
+ * resets, so each read reports the interval since the previous one.
+ * Only the vision task writes; a racing read can at worst miss the
+ * frame currently being recorded, which is fine for monitoring.
+ */
+
+#define LAT_BUCKET_MS 2
+#define LAT_BUCKET_COUNT 64
+
+typedef struct
+{
+    uint32_t counts[LAT_BUCKET_COUNT];
+    uint32_t total;
+    uint32_t max_ms;
+} lat_hist_t;
+
+static lat_hist_t s_hist_process; // process_frame() duration
+static lat_hist_t s_hist_publish; // Capture start to result_publish()
+
+// Capture moment of the frame being processed, for the publish histogram
+static uint64_t s_frame_capture_us = 0;
+
+static void lat_hist_record(lat_hist_t *hist, uint32_t ms)
+{
+    uint32_t bucket = ms / LAT_BUCKET_MS;
+    if (bucket >= LAT_BUCKET_COUNT)
+    {
+        bucket = LAT_BUCKET_COUNT - 1;
+    }
+
+    hist->counts[bucket]++;
+    hist->total++;
+    if (ms > hist->max_ms)
+    {
+        hist->max_ms = ms;
+    }
+}
+
+/**
+ * @brief Upper edge (ms) of the bucket holding the given percentile
+ */
+static uint32_t lat_hist_percentile(const lat_hist_t *hist, int pct)
+{
+    if (hist->total == 0)
+    {
+        return 0;
+    }
+
+    uint32_t rank = (hist->total * (uint32_t)pct + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < LAT_BUCKET_COUNT; i++)
+    {
+        seen += hist->counts[i];
+        if (seen >= rank)
+        {
+            return (uint32_t)(i + 1) * LAT_BUCKET_MS;
+        }
+    }
+
+    return LAT_BUCKET_COUNT * LAT_BUCKET_MS;
+}
+
+static void lat_hist_report(lat_hist_t *hist, vision_latency_stats_t *out)
+{
+    out->p50_ms = lat_hist_percentile(hist, 50);
+    out->p95_ms = lat_hist_percentile(hist, 95);
+    out->p99_ms = lat_hist_percentile(hist, 99);
+    out->max_ms = hist->max_ms;
+    out->sample_count = hist->total;
+
+    memset(hist, 0, sizeof(*hist)); // Start a fresh window
+}
+
+// ----------------------------------------------------------------------------
+// Capture-queue instrumentation
+//
+// With CAMERA_GRAB_LATEST and fb_count=2 the driver silently overwrites
+// the oldest frame whenever this task falls behind; neither the drop nor
+// the staleness shows up anywhere. cam_hal stamps every fb with
+// esp_timer_get_time(), the same clock used here, so the capture-to-
+// fb_get age is a direct subtraction, and overwrites are estimated by
+// rounding the gap between consecutive capture timestamps to the sensor
+// period (the shortest positive gap seen). The vision task is the sole
+// writer; counters are independent 32-bit atomics like the ones above.
+// ----------------------------------------------------------------------------
+
+static _Atomic uint32_t s_frames_consumed = 0;
+static _Atomic uint32_t s_frames_overwritten = 0;
+static lat_hist_t s_hist_capture_age; // Capture timestamp to fb_get return
+static uint64_t s_capture_prev_us = 0;
+static uint64_t s_capture_period_us = 0;
+
+static void capture_note_fb(const camera_fb_t *fb)
+{
+    uint64_t capture_us = (uint64_t)fb->timestamp.tv_sec * 1000000ULL +
+                          (uint64_t)fb->timestamp.tv_usec;
+    int64_t age_us = esp_timer_get_time() - (int64_t)capture_us;
+    if (age_us < 0)
+    {
+        age_us = 0;
+    }
+
+    atomic_fetch_add_explicit(&s_frames_consumed, 1, memory_order_relaxed);
+    lat_hist_record(&s_hist_capture_age, (uint32_t)(age_us / 1000));
+
+    if (s_capture_prev_us != 0 && capture_us > s_capture_prev_us)
+    {
+        uint64_t delta_us = capture_us - s_capture_prev_us;
+        if (s_capture_period_us == 0 || delta_us < s_capture_period_us)
+        {
+            s_capture_period_us = delta_us;
+        }
+
+        // A gap of N sensor periods means N-1 frames nobody fetched
+        uint32_t intervals = (uint32_t)((delta_us + s_capture_period_us / 2) /
+                                        s_capture_period_us);
+        if (intervals > 1)
+        {
+            atomic_fetch_add_explicit(&s_frames_overwritten, intervals - 1,
+                                      memory_order_relaxed);
+        }
+    }
+    s_capture_prev_us = capture_us;
+}
+
+// ROI tracking state (vision task only - no locking needed)
+static bool s_track_active = false;
+static int s_track_misses = 0;
+static int s_track_min_x = 0;
+static int s_track_max_x = 0;
+static int s_track_min_y = 0;
+static int s_track_max_y = 0;
+
+#if defined(CAM_FLASH_LED_GPIO) && (CAM_FLASH_LED_GPIO >= 0)
+static void disable_camera_flash_led(void)
+{
+    gpio_config_t cfg = {
+        .pin_bit_mask = (1ULL << CAM_FLASH_LED_GPIO),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+
+    gpio_config(&cfg);
+    gpio_set_level(CAM_FLASH_LED_GPIO, 0);
+    ESP_LOGI(TAG, "Camera flash LED forced LOW (GPIO%d)", CAM_FLASH_LED_GPIO);
+}
+#else
+static inline void disable_camera_flash_led(void) {}
+#endif
+
+// ============================================================================
+// CHUNKED JPEG ENCODE-AND-SEND
+// ============================================================================
+
+/**
+ * The encoder streams JPEG output straight into the WebSocket as it is
+ * produced: frame2jpg_cb() fills a small fixed chunk buffer, and every
+ * full chunk goes out as a continuation fragment of one binary message.
+ * No full-size intermediate buffer exists anywhere on the send path,
+ * and compression of the tail of a frame overlaps transmission of its
+ * head. Only the encoder stage task touches the chunk buffer, so no
+ * locking is needed.
+ */
+
+#define JPEG_CHUNK_SIZE 4096
+
+// Cap per frame: headroom under the server reassembly/payload limit
+// for the JSON metadata it wraps around a frame
+#define STREAM_MAX_FRAME_BYTES (WS_MAX_PAYLOAD_SIZE - 128)
+
+static uint8_t s_jpeg_chunk[JPEG_CHUNK_SIZE];
+
+/**
+ * Adaptive quality controller: scene complexity changes slowly, so the
+ * output size of the last few frames predicts the next one well. An
+ * exponential moving average of encoded size steers the starting
+ * quality between the min and default bounds, keeping it as high as
+ * fits while making the recompress path (4x encode cost at the worst
+ * possible moment) a rare event instead of the steady state on busy
+ * scenes.
+ */
+#define STREAM_SIZE_EMA_WEIGHT 8                            // New frame counts 1/8
+#define STREAM_SIZE_HIGH_WATER ((STREAM_MAX_FRAME_BYTES * 7) / 8) // Back off above this
+#define STREAM_SIZE_LOW_WATER (STREAM_MAX_FRAME_BYTES / 2)        // Recover below this
+
+static int s_jpeg_quality = STREAM_JPEG_QUALITY_DEFAULT;
+static int s_jpeg_size_ema = 0;
+
+/**
+ * @brief Feed one encode result back into the quality controller
+ */
+static void stream_quality_update(size_t encoded_len)
+{
+    if (s_jpeg_size_ema == 0)
+    {
+        s_jpeg_size_ema = (int)encoded_len;
+    }
+    else
+    {
+        s_jpeg_size_ema += ((int)encoded_len - s_jpeg_size_ema) / STREAM_SIZE_EMA_WEIGHT;
+    }
+
+    if (s_jpeg_size_ema > STREAM_SIZE_HIGH_WATER &&
+        s_jpeg_quality > STREAM_JPEG_QUALITY_MIN)
+    {
+        s_jpeg_quality -= STREAM_JPEG_QUALITY_STEP;
+        ESP_LOGD(TAG, "Stream quality down to Q%d (EMA %d bytes)",
+                 s_jpeg_quality, s_jpeg_size_ema);
+    }
+    else if (s_jpeg_size_ema < STREAM_SIZE_LOW_WATER &&
+             s_jpeg_quality < STREAM_JPEG_QUALITY_DEFAULT)
+    {
+        s_jpeg_quality += STREAM_JPEG_QUALITY_STEP;
+        ESP_LOGD(TAG, "Stream quality up to Q%d (EMA %d bytes)",
+                 s_jpeg_quality, s_jpeg_size_ema);
+    }
+}
+
+typedef struct
+{
+    size_t chunk_len; // Bytes pending in s_jpeg_chunk
+    size_t total;     // Bytes produced for the whole frame
+    bool opened;      // First fragment already on the wire
+    bool overflow;    // Frame exceeded STREAM_MAX_FRAME_BYTES
+    bool send_failed; // A fragment send returned an error
+} jpeg_stream_writer_t;
+
+/**
+ * @brief Push the pending chunk out as a WebSocket fragment
+ */
+static bool jpeg_stream_flush(jpeg_stream_writer_t *writer)
+{
+    if (writer->chunk_len == 0)
+    {
+        return true;
+    }
+
+    if (ws_client_send_frame_chunk(s_jpeg_chunk, writer->chunk_len,
+                                   !writer->opened) != ESP_OK)
+    {
+        writer->send_failed = true;
+        return false;
+    }
+
+    // The flight recorder shadows the outgoing stream: same chunks,
+    // internally throttled to one kept thumbnail every couple seconds
+    blackbox_thumb_append(s_jpeg_chunk, writer->chunk_len);
+
+    writer->opened = true;
+    writer->chunk_len = 0;
+    return true;
+}
+
+/**
+ * @brief frame2jpg_cb() sink feeding the chunked WebSocket send
+ *
+ * The vendored callback_stream ignores the return value and keeps
+ * encoding, so once the frame overflows the byte cap or a send fails
+ * the sink just goes inert and the rest of the encode is discarded.
+ */
+static size_t jpeg_stream_write(void *arg, size_t index, const void *data, size_t len)
+{
+    jpeg_stream_writer_t *writer = (jpeg_stream_writer_t *)arg;
+    const uint8_t *src = (const uint8_t *)data;
+
+    if (writer->overflow || writer->send_failed)
+    {
+        return 0;
+    }
+
+    if (writer->total + len > STREAM_MAX_FRAME_BYTES)
+    {
+        writer->overflow = true;
+        return 0;
+    }
+
+    while (len > 0)
+    {
+        size_t space = JPEG_CHUNK_SIZE - writer->chunk_len;
+        size_t take = (len < space) ? len : space;
+
+        memcpy(&s_jpeg_chunk[writer->chunk_len], src, take);
+        writer->chunk_len += take;
+        writer->total += take;
+        src += take;
+        len -= take;
+
+        if (writer->chunk_len == JPEG_CHUNK_SIZE && !jpeg_stream_flush(writer))
+        {
+            return 0;
+        }
+    }
+
+    (void)index; // Output is strictly sequential; the writer keeps its own counters
+    return len;
+}
+
+/**
+ * @brief Encode and send one full frame as a chunked JPEG message
+ */
+static bool stream_send_jpeg(camera_fb_t *fb)
+{
+    jpeg_stream_writer_t writer = {0};
+
+    // Flight recorder decides (throttle, freeze) whether it wants to
+    // keep this frame; the chunk sinks below feed it as a side effect
+    blackbox_thumb_begin();
+
+    // Frames the sensor already compressed skip frame2jpg entirely and
+    // are chunked straight from the driver buffer
+    if (fb->format == PIXFORMAT_JPEG)
+    {
+        size_t offset = 0;
+        while (offset < fb->len)
+        {
+            size_t chunk = fb->len - offset;
+            if (chunk > JPEG_CHUNK_SIZE)
+            {
+                chunk = JPEG_CHUNK_SIZE;
+            }
+
+            if (ws_client_send_frame_chunk(fb->buf + offset, chunk,
+                                           offset == 0) != ESP_OK)
+            {
+                break;
+            }
+            blackbox_thumb_append(fb->buf + offset, chunk);
+            writer.opened = true;
+            offset += chunk;
+        }
+
+        if (writer.opened)
+        {
+            ws_client_send_frame_finish();
+        }
+
+        if (offset == fb->len)
+        {
+            blackbox_thumb_commit();
+            return true;
+        }
+        return false;
+    }
+
+    // The server's negotiated ceiling caps the local adaptive quality;
+    // shared airtime carries smaller frames
+    int quality = s_jpeg_quality;
+    int quality_cap = ws_client_stream_jpeg_quality();
+    if (quality_cap > 0 && quality > quality_cap)
+    {
+        quality = quality_cap;
+    }
+
+    bool ok = frame2jpg_cb(fb, quality, jpeg_stream_write, &writer);
+
+    if (ok && !writer.overflow && !writer.send_failed)
+    {
+        ok = jpeg_stream_flush(&writer);
+    }
+
+    // A fragmented message must always be terminated, even after a
+    // failure mid-frame, so the connection stays usable. The dashboard
+    // discards the truncated JPEG on decode.
+    if (writer.opened)
+    {
+        ws_client_send_frame_finish();
+    }
+
+    if (writer.overflow)
+    {
+        // Fragments are already on the wire, so this frame can't be
+        // recompressed - drop it and start lower next time
+        if (s_jpeg_quality > STREAM_JPEG_QUALITY_MIN)
+        {
+            s_jpeg_quality -= STREAM_JPEG_QUALITY_STEP;
+        }
+        ESP_LOGW(TAG, "JPEG > %d byte cap @Q%d - frame dropped, quality lowered",
+                 STREAM_MAX_FRAME_BYTES, s_jpeg_quality + STREAM_JPEG_QUALITY_STEP);
+        return false;
+    }
+
+    if (!ok || writer.send_failed)
+    {
+        // !ok with no send failure is frame2jpg_cb dying on its working
+        // memory - attach the heap picture, this is the fragmentation
+        // failure mode the monitor exists for
+        if (!ok && !writer.send_failed)
+        {
+            ESP_LOGW(TAG, "frame2jpg failed @Q%d (free %u, largest block %u)",
+                     s_jpeg_quality,
+                     (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                     (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Chunked frame send failed at quality %d", s_jpeg_quality);
+        }
+        return false;
+    }
+
+    blackbox_thumb_commit();
+    stream_quality_update(writer.total);
+    return true;
+}
+
+// ============================================================================
+// CHANGED-TILE DELTA STREAMING
+// ============================================================================
+
+/**
+ * The scene behind a vehicle feed is mostly static background, yet the
+ * classic path re-encodes and resends every full frame over the shared
+ * SoftAP link. In delta mode each streamed frame is hashed per 16x16
+ * tile against the previous one and only changed tiles are sent as raw
+ * RGB565, with a full JPEG keyframe at a fixed interval (and whenever
+ * too many tiles changed for the delta to be worth it). The dashboard
+ * composites tiles onto its canvas on top of the last keyframe.
+ *
+ * Wire format of a tile packet: [0x44 'D'][tile_count] then per tile
+ * [tx][ty][512 bytes RGB565]. JPEG keyframes keep starting with 0xFF,
+ * so the dashboard tells them apart by the first byte.
+ */
+
+#define DELTA_TILE_SIZE 16
+#define DELTA_TILES_X (IMAGE_WIDTH / DELTA_TILE_SIZE)
+#define DELTA_TILES_Y (IMAGE_HEIGHT / DELTA_TILE_SIZE)
+#define DELTA_TILE_BYTES (DELTA_TILE_SIZE * DELTA_TILE_SIZE * 2)
+#define DELTA_KEYFRAME_INTERVAL 30 // Streamed frames between full refreshes
+#define DELTA_MAX_TILES 48         // Beyond this a keyframe is cheaper
+#define DELTA_PACKET_MAGIC 0x44    // 'D'
+
+static uint32_t s_tile_hash[DELTA_TILES_Y][DELTA_TILES_X];
+static bool s_tile_hash_valid = false;
+static int s_delta_frames_since_key = 0;
+static bool s_delta_enabled = true;
+
+/**
+ * @brief FNV-1a hash of one 16x16 tile
+ */
+static uint32_t tile_hash(const uint16_t *pixels, int frame_width, int tx, int ty)
+{
+    uint32_t h = 2166136261u;
+    const uint16_t *p = pixels + (ty * DELTA_TILE_SIZE * frame_width) + (tx * DELTA_TILE_SIZE);
+
+    for (int y = 0; y < DELTA_TILE_SIZE; y++)
+    {
+        for (int x = 0; x < DELTA_TILE_SIZE; x++)
+        {
+            h ^= p[x];
+            h *= 16777619u;
+        }
+        p += frame_width;
+    }
+
+    return h;
+}
+
+/**
+ * @brief Append bytes to the outgoing tile packet, flushing full chunks
+ */
+static bool delta_append(const void *data, size_t len, size_t *used, bool *opened)
+{
+    const uint8_t *src = (const uint8_t *)data;
+
+    while (len > 0)
+    {
+        size_t space = JPEG_CHUNK_SIZE - *used;
+        size_t take = (len < space) ? len : space;
+
+        memcpy(&s_jpeg_chunk[*used], src, take);
+        *used += take;
+        src += take;
+        len -= take;
+
+        if (*used == JPEG_CHUNK_SIZE)
+        {
+            if (ws_client_send_frame_chunk(s_jpeg_chunk, *used, !*opened) != ESP_OK)
+            {
+                return false;
+            }
+            *opened = true;
+            *used = 0;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Send the changed tiles of this frame as one binary message
+ *
+ * tile_list entries encode (ty << 8) | tx.
+ */
+static bool delta_send_tiles(const uint16_t *pixels, int frame_width,
+                             const uint16_t *tile_list, int tile_count)
+{
+    size_t used = 0;
+    bool opened = false;
+    uint8_t header[2] = {DELTA_PACKET_MAGIC, (uint8_t)tile_count};
+
+    if (!delta_append(header, sizeof(header), &used, &opened))
+    {
+        goto fail;
+    }
+
+    for (int i = 0; i < tile_count; i++)
+    {
+        uint8_t tx = (uint8_t)(tile_list[i] & 0xFF);
+        uint8_t ty = (uint8_t)(tile_list[i] >> 8);
+        uint8_t coords[2] = {tx, ty};
+
+        if (!delta_append(coords, sizeof(coords), &used, &opened))
+        {
+            goto fail;
+        }
+
+        const uint16_t *row = pixels +
+                              (ty * DELTA_TILE_SIZE * frame_width) +
+                              (tx * DELTA_TILE_SIZE);
+
+        for (int y = 0; y < DELTA_TILE_SIZE; y++)
+        {
+            if (!delta_append(row, DELTA_TILE_SIZE * sizeof(uint16_t), &used, &opened))
+            {
+                goto fail;
+            }
+            row += frame_width;
+        }
+    }
+
+    if (used > 0 &&
+        ws_client_send_frame_chunk(s_jpeg_chunk, used, !opened) != ESP_OK)
+    {
+        goto fail;
+    }
+    opened = true;
+
+    return ws_client_send_frame_finish() == ESP_OK;
+
+fail:
+    if (opened)
+    {
+        ws_client_send_frame_finish(); // Leave the connection usable
+    }
+    return false;
+}
+
+/**
+ * @brief Rehash every tile of the frame (after a keyframe)
+ */
+static void delta_rehash_all(const uint16_t *pixels, int frame_width)
+{
+    for (int ty = 0; ty < DELTA_TILES_Y; ty++)
+    {
+        for (int tx = 0; tx < DELTA_TILES_X; tx++)
+        {
+            s_tile_hash[ty][tx] = tile_hash(pixels, frame_width, tx, ty);
+        }
+    }
+    s_tile_hash_valid = true;
+    s_delta_frames_since_key = 0;
+}
+
+// ============================================================================
+// REGION-WEIGHTED ENCODE QUALITY
+// ============================================================================
+
+/**
+ * frame2jpg_cb() takes a single quality factor for the whole frame, so
+ * the region weighting happens upstream of the encoder: pixels outside
+ * the detection bounding box (plus the strip ahead of the wheels, which
+ * the operator always wants sharp) are 2x2 box-averaged in place before
+ * encoding. The DCT spends almost nothing on the flattened background
+ * while the box keeps the full negotiated quality, and the adaptive
+ * controller converts the saved bytes into a higher overall Q on the
+ * next frames.
+ */
+
+#define ROI_STREAM_MARGIN_PX 16     // Breathing room around the tracked bbox
+#define ROI_STREAM_FRONT_FRACTION 4 // Bottom 1/N of the frame stays sharp
+#define ROI_STREAM_MAX_AGE_MS 500   // Stale detections stop pinning quality
+
+static bool s_roi_quality_enabled = true;
+
+// Bounding box published by the vision task (Core 1) for the encoder
+// stage (Core 0): x0/y0/x1/y1 packed as uint16 quarters so one relaxed
+// load reads it tear-free. Zero = no current detection.
+static _Atomic uint64_t s_stream_roi = 0;
+static _Atomic uint32_t s_stream_roi_ms = 0;
+
+static void stream_roi_publish(int x0, int y0, int x1, int y1)
+{
+    uint64_t packed = ((uint64_t)(uint16_t)x0) |
+                      ((uint64_t)(uint16_t)y0 << 16) |
+                      ((uint64_t)(uint16_t)x1 << 32) |
+                      ((uint64_t)(uint16_t)y1 << 48);
+    atomic_store_explicit(&s_stream_roi, packed, memory_order_relaxed);
+    atomic_store_explicit(&s_stream_roi_ms,
+                          (uint32_t)(esp_timer_get_time() / 1000),
+                          memory_order_relaxed);
+}
+
+static void stream_roi_clear(void)
+{
+    atomic_store_explicit(&s_stream_roi, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Flatten everything outside the protected regions, in place
+ *
+ * @param shift Right-shift applied to the published bbox coordinates,
+ *              1 when smoothing the 2x-decimated preview buffer
+ */
+static void stream_roi_smooth(uint16_t *pixels, int width, int height, int shift)
+{
+    if (!s_roi_quality_enabled)
+    {
+        return;
+    }
+
+    int bx0 = -1, by0 = 0, bx1 = -1, by1 = 0;
+    uint64_t packed = atomic_load_explicit(&s_stream_roi, memory_order_relaxed);
+    uint32_t roi_ms = atomic_load_explicit(&s_stream_roi_ms, memory_order_relaxed);
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    if (packed != 0 && now_ms - roi_ms <= ROI_STREAM_MAX_AGE_MS)
+    {
+        int margin = ROI_STREAM_MARGIN_PX >> shift;
+        bx0 = (int)((packed) & 0xFFFF) / (1 << shift) - margin;
+        by0 = (int)((packed >> 16) & 0xFFFF) / (1 << shift) - margin;
+        bx1 = (int)((packed >> 32) & 0xFFFF) / (1 << shift) + margin;
+        by1 = (int)((packed >> 48) & 0xFFFF) / (1 << shift) + margin;
+    }
+
+    // Rows from front_y down stay untouched: that is the ground the
+    // vehicle is about to drive onto
+    int front_y = height - height / ROI_STREAM_FRONT_FRACTION;
+
+    for (int y = 0; y + 1 < front_y; y += 2)
+    {
+        uint16_t *row0 = &pixels[y * width];
+        uint16_t *row1 = &pixels[(y + 1) * width];
+        bool bbox_rows = (bx0 >= 0 && y + 1 >= by0 && y <= by1);
+
+        for (int x = 0; x + 1 < width; x += 2)
+        {
+            if (bbox_rows && x + 1 >= bx0 && x <= bx1)
+            {
+                continue; // Inside the protected box
+            }
+
+            uint32_t r = ((row0[x] >> 11) & 0x1F) + ((row0[x + 1] >> 11) & 0x1F) +
+                         ((row1[x] >> 11) & 0x1F) + ((row1[x + 1] >> 11) & 0x1F);
+            uint32_t g = ((row0[x] >> 5) & 0x3F) + ((row0[x + 1] >> 5) & 0x3F) +
+                         ((row1[x] >> 5) & 0x3F) + ((row1[x + 1] >> 5) & 0x3F);
+            uint32_t b = (row0[x] & 0x1F) + (row0[x + 1] & 0x1F) +
+                         (row1[x] & 0x1F) + (row1[x + 1] & 0x1F);
+            uint16_t avg = (uint16_t)(((r >> 2) << 11) | ((g >> 2) << 5) | (b >> 2));
+
+            row0[x] = avg;
+            row0[x + 1] = avg;
+            row1[x] = avg;
+            row1[x + 1] = avg;
+        }
+    }
+}
+
+// ============================================================================
+// LOW-RES PREVIEW MODE
+// ============================================================================
+
+/**
+ * Dashboard operators watching several vehicles at once don't need QVGA
+ * per feed. When the server requests preview mode (stream_status
+ * message, "preview" field), frames are decimated 2x2 to 160x120 before
+ * encoding - a quarter of the pixels cuts both encode CPU and airtime
+ * on the shared SoftAP roughly 4x. The decimation buffer is allocated
+ * once on first use and kept (37.5KB, so it must not sit in .bss).
+ */
+
+#define PREVIEW_WIDTH (IMAGE_WIDTH / 2)
+#define PREVIEW_HEIGHT (IMAGE_HEIGHT / 2)
+
+static uint16_t *s_preview_buf = NULL;
+
+/**
+ * @brief Decimate the frame 2x2 and send it as a chunked JPEG
+ */
+static bool stream_send_preview(camera_fb_t *fb)
+{
+    if (s_preview_buf == NULL)
+    {
+        s_preview_buf = malloc(PREVIEW_WIDTH * PREVIEW_HEIGHT * sizeof(uint16_t));
+        if (s_preview_buf == NULL)
+        {
+            ESP_LOGW(TAG, "No memory for preview buffer (largest block %u) - sending full frame",
+                     (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+            return stream_send_jpeg(fb);
+        }
+    }
+
+    const uint16_t *src = (const uint16_t *)fb->buf;
+    uint16_t *dst = s_preview_buf;
+
+    for (int y = 0; y < PREVIEW_HEIGHT; y++)
+    {
+        const uint16_t *row = src + (y * 2 * fb->width);
+        for (int x = 0; x < PREVIEW_WIDTH; x++)
+        {
+            *dst++ = row[x * 2];
+        }
+    }
+
+    // The decimated copy is private to this stage, so the background
+    // flattening never touches the detection frame
+    stream_roi_smooth(s_preview_buf, PREVIEW_WIDTH, PREVIEW_HEIGHT, 1);
+
+    camera_fb_t preview = {
+        .buf = (uint8_t *)s_preview_buf,
+        .len = PREVIEW_WIDTH * PREVIEW_HEIGHT * sizeof(uint16_t),
+        .width = PREVIEW_WIDTH,
+        .height = PREVIEW_HEIGHT,
+        .format = PIXFORMAT_RGB565,
+    };
+
+    return stream_send_jpeg(&preview);
+}
+
+static int64_t s_stream_last_sent_us = 0;
+
+static bool stream_frame_over_ws(camera_fb_t *fb)
+{
+    if (!ws_client_is_connected() || !ws_client_stream_enabled())
+    {
+        return false;
+    }
+
+    // Honor the per-vehicle rate from the server's quality ladder
+    // before encoding anything: when a second vehicle joins, both drop
+    // to their fair share instead of inflating everyone's TCP queues
+    int max_fps = ws_client_stream_max_fps();
+    if (max_fps > 0)
+    {
+        int64_t now_us = esp_timer_get_time();
+        if (now_us - s_stream_last_sent_us < 1000000 / max_fps)
+        {
+            return false; // Frame goes straight back to the driver
+        }
+        s_stream_last_sent_us = now_us;
+    }
+
+    // Preview mode bypasses delta tiles (they are full-res); force a
+    // keyframe when the feed returns to full resolution
+    if (ws_client_stream_preview() && fb->format == PIXFORMAT_RGB565 &&
+        (int)fb->width > PREVIEW_WIDTH)
+    {
+        s_tile_hash_valid = false;
+        return stream_send_preview(fb);
+    }
+
+    const bool tileable = (fb->format == PIXFORMAT_RGB565 &&
+                           (int)fb->width == IMAGE_WIDTH &&
+                           (int)fb->height == IMAGE_HEIGHT);
+    const uint16_t *pixels = (const uint16_t *)fb->buf;
+
+    if (s_delta_enabled && tileable && s_tile_hash_valid &&
+        s_delta_frames_since_key < DELTA_KEYFRAME_INTERVAL)
+    {
+        uint16_t changed[DELTA_MAX_TILES];
+        uint32_t new_hash[DELTA_MAX_TILES];
+        int changed_count = 0;
+        bool too_many = false;
+
+        for (int ty = 0; ty < DELTA_TILES_Y && !too_many; ty++)
+        {
+            for (int tx = 0; tx < DELTA_TILES_X; tx++)
+            {
+                uint32_t h = tile_hash(pixels, fb->width, tx, ty);
+                if (h == s_tile_hash[ty][tx])
+                {
+                    continue;
+                }
+
+                if (changed_count >= DELTA_MAX_TILES)
+                {
+                    too_many = true; // Scene change - keyframe is cheaper
+                    break;
+                }
+
+                changed[changed_count] = (uint16_t)((ty << 8) | tx);
+                new_hash[changed_count] = h;
+                changed_count++;
+            }
+        }
+
+        if (!too_many)
+        {
+            if (changed_count == 0)
+            {
+                s_delta_frames_since_key++;
+                return true; // Nothing changed - nothing to send
+            }
+
+            if (delta_send_tiles(pixels, fb->width, changed, changed_count))
+            {
+                for (int i = 0; i < changed_count; i++)
+                {
+                    int tx = changed[i] & 0xFF;
+                    int ty = changed[i] >> 8;
+                    s_tile_hash[ty][tx] = new_hash[i];
+                }
+                s_delta_frames_since_key++;
+                return true;
+            }
+
+            // Send failed mid-packet: dashboard state is unknown, force
+            // a keyframe to resynchronize
+            s_tile_hash_valid = false;
+            return false;
+        }
+    }
+
+    // Region-weighted encode on the keyframe path. The tile hashes are
+    // refreshed from the clean pixels BEFORE flattening, so the next
+    // frame's delta comparison sees the scene the way the camera will
+    // capture it again - hashing the blurred background would mark
+    // every background tile as changed and force a keyframe per frame.
+    bool smoothed = false;
+    if (s_roi_quality_enabled && fb->format == PIXFORMAT_RGB565)
+    {
+        if (s_delta_enabled && tileable)
+        {
+            delta_rehash_all(pixels, fb->width);
+        }
+        stream_roi_smooth((uint16_t *)fb->buf, fb->width, fb->height, 0);
+        smoothed = true;
+    }
+
+    bool ok = stream_send_jpeg(fb);
+
+    if (s_delta_enabled && tileable)
+    {
+        if (smoothed && !ok)
+        {
+            // The early rehash now describes a keyframe the dashboard
+            // never decoded: resynchronize with a fresh keyframe
+            s_tile_hash_valid = false;
+        }
+        else if (!smoothed && ok)
+        {
+            delta_rehash_all(pixels, fb->width);
+        }
+    }
+
+    return ok;
+}
+
+/**
+ * Third stage of the capture/detect/encode pipeline. The vision task
+ * (Core 1) captures and classifies; frames destined for the dashboard
+ * are handed off by pointer to this stage (Core 0), which JPEG-encodes,
+ * sends, and returns the buffer to the driver. With the camera's double
+ * buffering, detection of frame N+1 overlaps encoding of frame N
+ * instead of waiting behind it. The handoff never blocks: if the
+ * encoder is still busy, the frame simply isn't streamed.
+ */
+
+#define STREAM_QUEUE_DEPTH 1      // One frame in flight; second fb feeds detection
+#define STREAM_STATS_INTERVAL 100 // Streamed frames between stats log lines
+
+static QueueHandle_t s_stream_queue = NULL;
+static TaskHandle_t s_stream_task_handle = NULL;
+
+// Static queue backing; the depth-1 handoff holds a single fb pointer
+static StaticQueue_t s_stream_queue_buf;
+static uint8_t s_stream_queue_storage[STREAM_QUEUE_DEPTH * sizeof(camera_fb_t *)];
+
+// Handoff accounting: drops are normal under load (the encoder was
+// still busy), but a high ratio means the dashboard link is the
+// bottleneck and STREAM_FRAME_INTERVAL should be raised
+static _Atomic uint32_t s_stream_sent = 0;
+static _Atomic uint32_t s_stream_dropped = 0;
+
+// True while the encoder stage holds a driver buffer - the capture
+// reinit path must wait this out before esp_camera_deinit() frees them
+static volatile bool s_stream_busy = false;
+
+// DFS lock pinning 240 MHz while a frame is scanned or encoded; NULL
+// without CONFIG_PM_ENABLE (see DYNAMIC FREQUENCY SCALING below)
+static esp_pm_lock_handle_t s_pm_cpu_lock = NULL;
+
+// ----------------------------------------------------------------------------
+// Deferred detection log. Formatting floats over the UART inside
+// process_frame() costs more than the distance math it reports, so the
+// debug log writes fixed-size records into a tiny SPSC ring (vision
+// task is the only producer) and the Core 0 encoder task drains and
+// formats them between frames. Logging never paces the vision loop.
+// ----------------------------------------------------------------------------
+#define DEBUG_EVENT_RING_SIZE 16 // Power of 2
+
+typedef struct
+{
+    float distance_cm;
+    int16_t centroid_x;
+    int16_t centroid_y;
+    int32_t contour_area;
+} debug_event_t;
+
+static debug_event_t s_debug_ring[DEBUG_EVENT_RING_SIZE];
+static _Atomic uint32_t s_debug_head = 0; // Producer: vision task only
+static uint32_t s_debug_tail = 0;         // Consumer: stream task only
+
+static void debug_event_push(float distance_cm, int cx, int cy, int area)
+{
+    uint32_t head = atomic_load_explicit(&s_debug_head, memory_order_relaxed);
+
+    if (head - s_debug_tail >= DEBUG_EVENT_RING_SIZE)
+    {
+        return; // Ring full - a lost debug line never blocks detection
+    }
+
+    debug_event_t *slot = &s_debug_ring[head & (DEBUG_EVENT_RING_SIZE - 1)];
+    slot->distance_cm = distance_cm;
+    slot->centroid_x = (int16_t)cx;
+    slot->centroid_y = (int16_t)cy;
+    slot->contour_area = area;
+
+    atomic_store_explicit(&s_debug_head, head + 1, memory_order_release);
+}
+
+static void debug_event_drain(void)
+{
+    uint32_t head = atomic_load_explicit(&s_debug_head, memory_order_acquire);
+
+    while (s_debug_tail != head)
+    {
+        const debug_event_t *ev =
+            &s_debug_ring[s_debug_tail & (DEBUG_EVENT_RING_SIZE - 1)];
+
+        ESP_LOGI(TAG, "Obstáculo verde: %.1f cm @ (%d,%d) area=%ld",
+                 ev->distance_cm, ev->centroid_x, ev->centroid_y,
+                 (long)ev->contour_area);
+
+        s_debug_tail++;
+    }
+}
+
+/**
+ * @brief Return streaming working memory after an idle period
+ *
+ * The preview buffer is allocated on the first decimated frame and
+ * used only from this task, so it can be freed here without locking
+ * once CONFIG_STREAM_IDLE_RELEASE_S passes without a streamed frame.
+ * Headless endurance runs get those 37.5 KB back for detection; the
+ * next viewer pays one fresh malloc. The vision/veto path allocates
+ * nothing through this module.
+ */
+static void stream_idle_release(uint32_t *last_frame_ms)
+{
+#if CONFIG_STREAM_IDLE_RELEASE_S > 0
+    if (s_preview_buf == NULL || *last_frame_ms == 0)
+    {
+        return;
+    }
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (now_ms - *last_frame_ms < (uint32_t)CONFIG_STREAM_IDLE_RELEASE_S * 1000)
+    {
+        return;
+    }
+
+    free(s_preview_buf);
+    s_preview_buf = NULL;
+    *last_frame_ms = 0;
+    ESP_LOGI(TAG, "Preview buffer released after %d s of stream idle",
+             CONFIG_STREAM_IDLE_RELEASE_S);
+#else
+    (void)last_frame_ms;
+#endif
+}
+
+static void stream_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Stream encoder task started on core %d", xPortGetCoreID());
+
+    uint32_t last_frame_ms = 0;
+
+    while (s_task_running)
+    {
+        camera_fb_t *fb = NULL;
+
+        // Bounded wait so queued debug events still drain while the
+        // dashboard is idle; a NULL sentinel from vision_engine_stop()
+        // lands here too and just re-evaluates the run flag
+        if (xQueueReceive(s_stream_queue, &fb, pdMS_TO_TICKS(100)) != pdTRUE ||
+            fb == NULL)
+        {
+            debug_event_drain();
+            stream_idle_release(&last_frame_ms);
+            continue;
+        }
+        last_frame_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+        // Encode and send at full clock: frame2jpg is the single most
+        // cycle-hungry stage outside the scan itself
+        if (s_pm_cpu_lock)
+        {
+            esp_pm_lock_acquire(s_pm_cpu_lock);
+        }
+        s_stream_busy = true;
+        stream_frame_over_ws(fb);
+        esp_camera_fb_return(fb);
+        s_stream_busy = false;
+        if (s_pm_cpu_lock)
+        {
+            esp_pm_lock_release(s_pm_cpu_lock);
+        }
+
+        debug_event_drain();
+
+        uint32_t sent = atomic_fetch_add_explicit(&s_stream_sent, 1,
+                                                   memory_order_relaxed) + 1;
+        if ((sent % STREAM_STATS_INTERVAL) == 0)
+        {
+            ESP_LOGI(TAG, "Streaming: %u frames sent, %u dropped at handoff",
+                     (unsigned)sent, (unsigned)atomic_load_explicit(
+                                         &s_stream_dropped, memory_order_relaxed));
+        }
+    }
+
+    ESP_LOGI(TAG, "Stream encoder task stopped");
+    xSemaphoreGive(s_stream_exit_sem);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Hand a frame to the encoder stage without blocking
+ *
+ * The zero-timeout send is what keeps JPEG compression and the network
+ * out of the veto-critical path: whatever the encoder or the WebSocket
+ * link are doing, the vision task moves straight on to the next scan.
+ *
+ * @return true if buffer ownership was transferred (the encoder stage
+ *         will return it to the driver), false if the caller keeps it
+ */
+static bool stream_frame_enqueue(camera_fb_t *fb)
+{
+    if (s_stream_queue == NULL ||
+        !ws_client_is_connected() || !ws_client_stream_enabled())
+    {
+        return false;
+    }
+
+    if (xQueueSend(s_stream_queue, &fb, 0) != pdTRUE)
+    {
+        atomic_fetch_add_explicit(&s_stream_dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+// ============================================================================
+// CAMERA INITIALIZATION / CAPTURE TUNING
+// ============================================================================
+
+// Capture profile applied by init_camera(). Field experiments constantly
+// trade tearing vs latency vs PSRAM budget (double/triple buffering,
+// latest-vs-FIFO grab, 20/24MHz XCLK); these used to be frozen at build
+// time and every experiment cost a reflash. The dashboard can now change
+// them at runtime: the setter records the new profile and the vision
+// task recycles the driver between frames.
+static int s_cap_fb_count = CAM_FB_COUNT;
+static int s_cap_grab_latest = 1; // 1 = CAMERA_GRAB_LATEST, 0 = FIFO
+static int s_cap_xclk_mhz = 20;
+static volatile bool s_cap_reinit_pending = false;
+
+// Native-JPEG monitoring profile: the OV2640 compresses in hardware,
+// so streamed frames skip software frame2jpg entirely. The vendored
+// driver sizes DMA and frame buffers per format at init, so the format
+// cannot alternate frame by frame; this is a whole-capture switch via
+// the same between-frames driver recycle. JPEG frames cannot be
+// scanned: detection stops publishing and the staleness guard keeps
+// the veto asserted while the vehicle cannot see.
+static int s_cap_native_jpeg = 0;
+
+// Fast-detect profile: QQVGA frames (38.4KB RGB565) fit in internal
+// DRAM, so the veto-critical path skips QSPI PSRAM entirely - on the
+// plain ESP32 the single biggest scan-throughput win available. The
+// full-res PSRAM profile remains the default for streaming quality.
+static int s_cap_fast_detect = 0;
+
+// QQVGA selected through the SCCB-only fast resize (see the fast
+// frame-size reconfig section); never set while a non-default profile
+// owns the frame buffers
+static bool s_cap_small_frames = false;
+
+// Low-light grayscale profile: at dusk the hue signal collapses into
+// sensor noise while RGB565 capture still pays full PSRAM traffic.
+// PIXFORMAT_GRAYSCALE halves the bytes per frame and detection falls
+// back to a luminance-band pre-gate - crude, but it keeps the veto
+// responsive when color cannot be trusted anyway. Ambient light is
+// measured from the frames already captured (sparse sample into an
+// EMA); AUTO mode flips the capture format through the usual
+// between-frames driver recycle, with hysteresis and a dwell so a
+// passing shadow never thrashes the driver.
+static int s_cap_grayscale = 0; // Current capture format is grayscale
+static vision_low_light_mode_t s_low_light_mode = VISION_LOW_LIGHT_AUTO;
+static int s_ambient_luma = 128;   // EMA of the sparse frame sample
+static int s_low_light_streak = 0; // Consecutive frames past the threshold
+
+#define LOW_LIGHT_ENTER_LUMA 28   // Engage grayscale below this ambient level
+#define LOW_LIGHT_EXIT_LUMA 44    // Return to color above this (hysteresis)
+#define LOW_LIGHT_DWELL_FRAMES 90 // ~3s on either side before switching
+#define AMBIENT_SAMPLE_STEP 8     // Sparse grid pitch for the ambient sample
+
+// Blob noise floor, scaled to the active capture resolution (a QQVGA
+// pixel covers 4x the scene area of a QVGA pixel)
+static int s_min_contour_area = MIN_CONTOUR_AREA;
+
+/**
+ * @brief Fold a sparse luminance sample of the frame into the ambient EMA
+ *
+ * RGB565 frames use the green channel as the luminance proxy (it has 6
+ * bits and dominates perceived luma); grayscale frames average the
+ * bytes directly. Sampling every AMBIENT_SAMPLE_STEP-th pixel of every
+ * AMBIENT_SAMPLE_STEP-th row touches ~1.5% of the frame.
+ */
+static void ambient_luma_update(const camera_fb_t *fb)
+{
+    uint32_t sum = 0;
+    uint32_t samples = 0;
+
+    if (fb->format == PIXFORMAT_RGB565)
+    {
+        const uint16_t *pixels = (const uint16_t *)fb->buf;
+        for (int y = 0; y < (int)fb->height; y += AMBIENT_SAMPLE_STEP)
+        {
+            const uint16_t *row = pixels + (y * fb->width);
+            for (int x = 0; x < (int)fb->width; x += AMBIENT_SAMPLE_STEP)
+            {
+                sum += (row[x] & 0x07E0) >> 3; // Green channel, 8-bit scale
+                samples++;
+            }
+        }
+    }
+    else if (fb->format == PIXFORMAT_GRAYSCALE)
+    {
+        const uint8_t *pixels = fb->buf;
+        for (int y = 0; y < (int)fb->height; y += AMBIENT_SAMPLE_STEP)
+        {
+            const uint8_t *row = pixels + (y * fb->width);
+            for (int x = 0; x < (int)fb->width; x += AMBIENT_SAMPLE_STEP)
+            {
+                sum += row[x];
+                samples++;
+            }
+        }
+    }
+
+    if (samples == 0)
+    {
+        return;
+    }
+
+    s_ambient_luma = (s_ambient_luma * 7 + (int)(sum / samples)) / 8;
+}
+
+/**
+ * @brief Engage/release the grayscale profile from the ambient EMA
+ *
+ * Only acts in AUTO mode. The capture format follows the light level
+ * through the pending-reinit path, same as any other profile change.
+ */
+static void low_light_auto_evaluate(void)
+{
+    if (s_low_light_mode != VISION_LOW_LIGHT_AUTO || s_cap_native_jpeg)
+    {
+        return;
+    }
+
+    bool want_gray = s_cap_grayscale
+                         ? (s_ambient_luma < LOW_LIGHT_EXIT_LUMA)
+                         : (s_ambient_luma < LOW_LIGHT_ENTER_LUMA);
+
+    if ((want_gray ? 1 : 0) == s_cap_grayscale)
+    {
+        s_low_light_streak = 0;
+        return;
+    }
+
+    if (++s_low_light_streak < LOW_LIGHT_DWELL_FRAMES)
+    {
+        return;
+    }
+
+    s_low_light_streak = 0;
+    s_cap_grayscale = want_gray ? 1 : 0;
+    s_cap_reinit_pending = true;
+    ESP_LOGI(TAG, "Ambient luma %d - switching to %s capture",
+             s_ambient_luma, want_gray ? "grayscale low-light" : "RGB565 color");
+}
+
+// NVS key for the sensor tuning profile checksum (namespace shared
+// with the HSV calibration)
+static const char *SENSOR_PROFILE_NVS_KEY = "sensor_ck";
+
+/**
+ * @brief Walk the sensor tuning profile: checksum it, optionally apply it
+ *
+ * Single source of truth for the SCCB tuning walk. Entries marked
+ * reset-default ask for exactly the state the OV2640 driver leaves
+ * behind after its soft reset, so writing them is pure I2C overhead -
+ * the delta walk skips them and only touches the registers we actually
+ * move. Every entry, skipped or not, is folded into an FNV-1a
+ * checksum: any change to the compiled profile changes the hash,
+ * misses the NVS cache and forces one defensive full walk before the
+ * new profile is cached. The win applies to runtime capture reinits
+ * as much as to boots - both go through init_camera().
+ *
+ * @param s         Sensor handle, or NULL for a checksum-only dry run
+ * @param full_walk Issue every write, including the reset-defaults
+ * @param out_checksum Optional profile checksum output
+ * @return Number of SCCB setter calls issued
+ */
+static int sensor_tuning_walk(sensor_t *s, bool full_walk, uint32_t *out_checksum)
+{
+    uint32_t hash = 2166136261u; // FNV-1a offset basis
+    int writes = 0;
+
+#define TUNE(fn, value, reset_default)                               \
+    do                                                               \
+    {                                                                \
+        hash = (hash ^ (uint32_t)(uint16_t)(int16_t)(value)) * 16777619u; \
+        if (s != NULL && (full_walk || !(reset_default)))            \
+        {                                                            \
+            s->fn(s, value);                                         \
+            writes++;                                                \
+        }                                                            \
+    } while (0)
+
+    // Optimize for vision processing (not aesthetics)
+    TUNE(set_brightness, 0, true);      // Default brightness
+    TUNE(set_contrast, 0, true);        // Default contrast
+    TUNE(set_saturation, 0, true);      // Default saturation
+    TUNE(set_special_effect, 0, true);  // No special effects
+    TUNE(set_whitebal, 1, true);        // Auto white balance ON
+    TUNE(set_awb_gain, 1, true);        // Auto white balance gain ON
+    TUNE(set_wb_mode, 0, true);         // White balance mode auto
+    TUNE(set_exposure_ctrl, 1, true);   // Auto exposure ON
+    TUNE(set_aec2, 0, true);            // AEC sensor ON
+    TUNE(set_ae_level, 0, true);        // Auto exposure level 0
+    TUNE(set_aec_value, 300, false);    // Auto exposure value - not a reset default
+    TUNE(set_gain_ctrl, 1, true);       // Auto gain ON
+    TUNE(set_agc_gain, 0, true);        // Auto gain value
+    TUNE(set_gainceiling, 0, true);     // Gain ceiling
+    TUNE(set_bpc, 0, true);             // Black pixel correction OFF
+    TUNE(set_wpc, 1, true);             // White pixel correction ON
+    TUNE(set_raw_gma, 1, true);         // Gamma correction ON
+    TUNE(set_lenc, 1, true);            // Lens correction ON
+    TUNE(set_hmirror, 0, true);         // Horizontal mirror OFF
+    TUNE(set_vflip, 0, true);           // Vertical flip OFF
+    TUNE(set_dcw, 1, true);             // Downsize enable ON
+    TUNE(set_colorbar, 0, true);        // Color bar test pattern OFF
+
+#undef TUNE
+
+    if (out_checksum != NULL)
+    {
+        *out_checksum = hash;
+    }
+    return writes;
+}
+
+/**
+ * @brief True when the NVS-cached profile checksum matches
+ */
+static bool sensor_profile_cached(uint32_t checksum)
+{
+    nvs_handle_t handle;
+    if (nvs_open(CALIB_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false; // First boot - no cache yet
+    }
+
+    uint32_t cached = 0;
+    esp_err_t err = nvs_get_u32(handle, SENSOR_PROFILE_NVS_KEY, &cached);
+    nvs_close(handle);
+
+    return err == ESP_OK && cached == checksum;
+}
+
+/**
+ * @brief Persist the applied profile checksum for later boots
+ */
+static void sensor_profile_cache_store(uint32_t checksum)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "NVS open failed (0x%x) - sensor profile not cached", err);
+        return;
+    }
+
+    nvs_set_u32(handle, SENSOR_PROFILE_NVS_KEY, checksum);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * @brief Configure camera with AI Thinker ESP32-CAM pinout
+ */
+static esp_err_t init_camera(void)
+{
+    ESP_LOGI(TAG, "Initializing OV2640 camera...");
+
+    camera_config_t config = {
+        .pin_pwdn = CAM_PIN_PWDN,
+        .pin_reset = CAM_PIN_RESET,
+        .pin_xclk = CAM_PIN_XCLK,
+        .pin_sccb_sda = CAM_PIN_SIOD,
+        .pin_sccb_scl = CAM_PIN_SIOC,
+
+        .pin_d7 = CAM_PIN_Y9,
+        .pin_d6 = CAM_PIN_Y8,
+        .pin_d5 = CAM_PIN_Y7,
+        .pin_d4 = CAM_PIN_Y6,
+        .pin_d3 = CAM_PIN_Y5,
+        .pin_d2 = CAM_PIN_Y4,
+        .pin_d1 = CAM_PIN_Y3,
+        .pin_d0 = CAM_PIN_Y2,
+        .pin_vsync = CAM_PIN_VSYNC,
+        .pin_href = CAM_PIN_HREF,
+        .pin_pclk = CAM_PIN_PCLK,
+
+        // Camera settings (runtime-tunable part of the capture profile)
+        .xclk_freq_hz = s_cap_xclk_mhz * 1000000,
+        .ledc_timer = LEDC_TIMER_1,
+        .ledc_channel = LEDC_CHANNEL_2,
+
+        .pixel_format = s_cap_native_jpeg ? PIXFORMAT_JPEG
+                        : s_cap_grayscale ? PIXFORMAT_GRAYSCALE
+                                          : CAM_PIXEL_FORMAT,
+        .frame_size = s_cap_fast_detect ? FRAMESIZE_QQVGA : CAM_FRAME_SIZE,
+        .jpeg_quality = CAM_JPEG_QUALITY, // Not used for RGB565
+        .fb_count = (size_t)s_cap_fb_count,
+        .fb_location = s_cap_fast_detect ? CAMERA_FB_IN_DRAM : CAM_FB_LOCATION,
+        .grab_mode = s_cap_grab_latest ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY
+    };
+
+    esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
+        return err;
+    }
+
+    disable_camera_flash_led();
+
+    // Camera sensor tuning
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to get camera sensor");
+        return ESP_FAIL;
+    }
+
+    // Sensor tuning. When the compiled profile matches the NVS cache
+    // only the delta against the driver's post-reset state is written,
+    // collapsing ~20 blocking SCCB transactions to a handful.
+    uint32_t profile_ck = 0;
+    sensor_tuning_walk(NULL, false, &profile_ck);
+    bool profile_known = sensor_profile_cached(profile_ck);
+    int sccb_writes = sensor_tuning_walk(s, !profile_known, NULL);
+    if (!profile_known)
+    {
+        sensor_profile_cache_store(profile_ck);
+    }
+    ESP_LOGI(TAG, "Sensor tuning applied: %d SCCB writes (%s walk)",
+             sccb_writes, profile_known ? "delta" : "full");
+
+    // Keep the blob noise floor meaningful at the active resolution
+    s_min_contour_area = s_cap_fast_detect ? MIN_CONTOUR_AREA / 4 : MIN_CONTOUR_AREA;
+
+    ESP_LOGI(TAG, "Camera initialized successfully");
+    ESP_LOGI(TAG, "Resolution: %dx%d, Format: %s, Buffers: %d (%s), Grab: %s, XCLK: %dMHz",
+             s_cap_fast_detect ? IMAGE_WIDTH / 2 : IMAGE_WIDTH,
+             s_cap_fast_detect ? IMAGE_HEIGHT / 2 : IMAGE_HEIGHT,
+             s_cap_native_jpeg ? "JPEG" : s_cap_grayscale ? "GRAY" : "RGB565",
+             s_cap_fb_count, s_cap_fast_detect ? "DRAM" : "PSRAM",
+             s_cap_grab_latest ? "latest" : "FIFO", s_cap_xclk_mhz);
+
+    return ESP_OK;
+}
+
+// Sensor ROI window state (vision task only; see section below)
+static bool s_sensor_window_enabled = true; // API toggle
+static bool s_sensor_window_active = false; // Sensor currently windowed
+static int s_sensor_window_cx = 0;          // Window center, full-FOV frame coords
+static int s_sensor_window_cy = 0;
+static int s_track_stable_frames = 0;
+
+/**
+ * @brief Recycle the camera driver with the pending capture profile
+ *
+ * Called from the vision task between frames, so no capture is in
+ * flight on this core. The encoder stage on Core 0 may still hold a
+ * driver buffer though, and esp_camera_deinit() frees them all - wait
+ * for it to drain first (bounded; a wedged WebSocket send must not
+ * stall the veto loop forever, it just postpones the reinit).
+ */
+static void aeawb_reapply_after_reinit(void); // AEC/AWB lock section below
+
+static void capture_tuning_apply(void)
+{
+    for (int i = 0; i < 50; i++)
+    {
+        bool queue_empty = (s_stream_queue == NULL) ||
+                           (uxQueueMessagesWaiting(s_stream_queue) == 0);
+        if (queue_empty && !s_stream_busy)
+        {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    if (s_stream_busy)
+    {
+        ESP_LOGW(TAG, "Encoder stage still busy - postponing capture reinit");
+        return;
+    }
+
+    esp_camera_deinit();
+
+    if (init_camera() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Capture reinit failed - camera offline until next attempt");
+        return;
+    }
+
+    // New driver buffers: previous-frame state no longer matches them
+    s_tile_hash_valid = false;
+    s_cap_reinit_pending = false;
+    s_sensor_window_active = false; // Reinit resets the sensor window too
+    s_cap_small_frames = false;     // init_camera set the profile's own size
+
+    // The sensor reset also unfroze the autos - pin them again
+    aeawb_reapply_after_reinit();
+}
+
+// ============================================================================
+// FAST FRAME-SIZE RECONFIG (ADAPTIVE RESOLUTION)
+// ============================================================================
+
+/**
+ * The full driver recycle above costs hundreds of milliseconds of
+ * blackout - fine for profile experiments, useless mid-run, which is
+ * why resolution never changed while driving. But the driver sizes its
+ * DMA descriptors and frame buffers once, at esp_camera_init(), for
+ * the configured frame size: any smaller frame fits them as-is, so
+ * stepping QVGA->QQVGA and back needs nothing beyond the sensor's own
+ * DSP output registers - one set_framesize() SCCB burst between
+ * frames, single-digit milliseconds, the veto never goes blind.
+ * Detection already scales its pinhole math by fb->width, so the only
+ * bookkeeping is the blob noise floor and the per-frame caches.
+ *
+ * The adaptive policy rides on it: QQVGA while the scene has been
+ * clear for a while (a quarter of the pixels to scan while cruising),
+ * back to full QVGA the moment anything is detected. Only armed on
+ * the default capture profile - fast-detect, native-JPEG and
+ * grayscale move the frame buffers themselves and keep the recycle.
+ */
+
+#define ADAPTIVE_RES_CLEAR_FRAMES 30 // Clear frames before dropping to QQVGA
+
+static bool s_adaptive_res_enabled = false;
+static volatile bool s_cap_resize_pending = false; // Applied between frames
+static int s_adaptive_clear_frames = 0;
+
+static bool capture_profile_is_default(void)
+{
+    return !s_cap_fast_detect && !s_cap_native_jpeg && !s_cap_grayscale;
+}
+
+/**
+ * @brief Apply a pending frame-size switch (vision task, between frames)
+ */
+static void capture_fast_resize(void)
+{
+    s_cap_resize_pending = false;
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL || s->set_framesize == NULL)
+    {
+        return;
+    }
+
+    if (s->set_framesize(s, s_cap_small_frames ? FRAMESIZE_QQVGA
+                                               : CAM_FRAME_SIZE) != 0)
+    {
+        ESP_LOGW(TAG, "Fast resize rejected by sensor");
+        return;
+    }
+
+    // Same invalidations as the full recycle, minus the recycle
+    s_tile_hash_valid = false;
+    s_sensor_window_active = false; // set_framesize rewrote the readout window
+    s_min_contour_area = s_cap_small_frames ? MIN_CONTOUR_AREA / 4
+                                            : MIN_CONTOUR_AREA;
+    aeawb_reapply_after_reinit();
+
+    ESP_LOGI(TAG, "Fast resize: %s (SCCB only, no driver recycle)",
+             s_cap_small_frames ? "QQVGA" : "QVGA");
+}
+
+/**
+ * @brief Per-result policy: small frames cruising, full frames on approach
+ */
+static void adaptive_res_update(const vision_result_t *result)
+{
+    if (!s_adaptive_res_enabled || !capture_profile_is_default() ||
+        s_cap_reinit_pending)
+    {
+        return;
+    }
+
+    if (result->obstacle_detected)
+    {
+        s_adaptive_clear_frames = 0;
+        if (s_cap_small_frames)
+        {
+            // Upswitch immediately: range and zones are judged on full
+            // resolution while something is closing in
+            s_cap_small_frames = false;
+            s_cap_resize_pending = true;
+        }
+        return;
+    }
+
+    if (!s_cap_small_frames &&
+        ++s_adaptive_clear_frames >= ADAPTIVE_RES_CLEAR_FRAMES)
+    {
+        s_cap_small_frames = true;
+        s_cap_resize_pending = true;
+    }
+}
+
+// ============================================================================
+// SENSOR ROI WINDOWING
+// ============================================================================
+
+/**
+ * Cropping at the sensor is cheaper than cropping in software: once an
+ * obstacle has been tracked stably, the OV2640's readout window (via
+ * set_res_raw) is narrowed to half the field of view centered on it.
+ * The DSP output stays QVGA - the esp32-camera driver sizes its DMA and
+ * frame buffers at init time, so shrinking the output would need a full
+ * driver re-init per ROI move - which makes this a 2x sensor-crop zoom:
+ * fewer array lines read per frame and double the pixel resolution on
+ * the target, at an unchanged transfer size. Distances measured while
+ * windowed are corrected by the zoom factor (the effective focal length
+ * doubles). The window recenters when the target drifts and is restored
+ * to full FOV the moment tracking is lost, so the rescan sees the whole
+ * scene.
+ */
+
+#define SENSOR_WINDOW_ZOOM 2         // Magnification vs full field of view
+#define SENSOR_WINDOW_LOCK_FRAMES 10 // Stable tracked frames before windowing
+#define SENSOR_WINDOW_RECENTER_PX 40 // Centroid drift from frame center that recenters
+
+// ov2640_sensor_mode_t OV2640_MODE_SVGA (driver-private header); the
+// SVGA array mode is 800x600 at 2x binning = the full FOV
+#define OV2640_WINDOW_MODE_SVGA 1
+#define SENSOR_ARRAY_SVGA_WIDTH 800
+#define SENSOR_ARRAY_SVGA_HEIGHT 600
+
+/**
+ * @brief Window the sensor readout around a full-FOV frame coordinate
+ */
+static void sensor_window_apply(int cx, int cy)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL || s->set_res_raw == NULL)
+    {
+        return;
+    }
+
+    const int win_w = SENSOR_ARRAY_SVGA_WIDTH / SENSOR_WINDOW_ZOOM;
+    const int win_h = SENSOR_ARRAY_SVGA_HEIGHT / SENSOR_WINDOW_ZOOM;
+
+    int off_x = (cx * SENSOR_ARRAY_SVGA_WIDTH) / IMAGE_WIDTH - win_w / 2;
+    int off_y = (cy * SENSOR_ARRAY_SVGA_HEIGHT) / IMAGE_HEIGHT - win_h / 2;
+
+    if (off_x < 0)
+        off_x = 0;
+    if (off_x > SENSOR_ARRAY_SVGA_WIDTH - win_w)
+        off_x = SENSOR_ARRAY_SVGA_WIDTH - win_w;
+    if (off_y < 0)
+        off_y = 0;
+    if (off_y > SENSOR_ARRAY_SVGA_HEIGHT - win_h)
+        off_y = SENSOR_ARRAY_SVGA_HEIGHT - win_h;
+
+    if (s->set_res_raw(s, OV2640_WINDOW_MODE_SVGA, 0, 0, 0,
+                       off_x, off_y, win_w, win_h,
+                       IMAGE_WIDTH, IMAGE_HEIGHT, true, false) != 0)
+    {
+        ESP_LOGW(TAG, "Sensor window apply failed - staying at full FOV");
+        return;
+    }
+
+    s_sensor_window_active = true;
+    s_sensor_window_cx = cx;
+    s_sensor_window_cy = cy;
+    s_tile_hash_valid = false; // Frame content jumps - force a keyframe
+
+    ESP_LOGD(TAG, "Sensor windowed around (%d,%d)", cx, cy);
+}
+
+/**
+ * @brief Restore the stock full-FOV QVGA readout
+ */
+static void sensor_window_restore(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL || s->set_framesize == NULL)
+    {
+        return;
+    }
+
+    s->set_framesize(s, CAM_FRAME_SIZE);
+    s_sensor_window_active = false;
+    s_tile_hash_valid = false;
+
+    ESP_LOGD(TAG, "Sensor window restored to full FOV");
+}
+
+// ============================================================================
+// AEC/AWB LOCK
+// ============================================================================
+
+/**
+ * The stock tuning profile leaves auto-exposure and auto-white-balance
+ * hunting, so the same green object drifts through HSV space with every
+ * lighting adjustment and the classifier ranges have to stay wide to
+ * absorb it. Locking freezes the sensor at its converged operating
+ * point: AEC/AGC are disabled and their raw register values captured,
+ * so the exposure survives driver recycles and reboots (persisted in
+ * the calibration NVS namespace). The OV2640 driver exposes no way to
+ * read the converged AWB channel gains, so after a reinit AWB is left
+ * hunting for a short settle window and then frozen again.
+ *
+ * All SCCB traffic runs on the vision task between frames, same rule
+ * as the sensor ROI window.
+ */
+
+// Raw register access for values the sensor API cannot read back.
+// get_reg/set_reg encode the OV2640 bank in bit 8 (1 = sensor bank).
+#define OV2640_SENSOR_REG(addr) (0x100 | (addr))
+#define OV2640_REG_GAIN 0x00  // AGC gain, raw
+#define OV2640_REG_REG04 0x04 // Bits 1:0 = AEC[1:0]
+#define OV2640_REG_AEC 0x10   // AEC[9:2]
+#define OV2640_REG_REG45 0x45 // Bits 5:0 = AEC[15:10]
+
+#define AEAWB_NVS_KEY "aeawb" // u32: bit31 lock, 23:16 AGC raw, 15:0 AEC raw
+#define AWB_SETTLE_FRAMES 30  // Frames AWB re-converges after a reinit
+
+static bool s_aeawb_lock = false;             // Lock requested/active
+static volatile bool s_aeawb_pending = false; // Vision task applies between frames
+static bool s_aeawb_have_values = false;      // Captured or loaded from NVS
+static uint16_t s_aeawb_aec_raw = 0;          // Exposure, raw register value
+static uint8_t s_aeawb_agc_raw = 0;           // Gain, raw register value
+static int s_awb_settle_frames = 0;           // Countdown to re-freezing AWB
+
+/**
+ * @brief Read the converged AEC/AGC values out of the sensor registers
+ */
+static bool aeawb_capture(sensor_t *s)
+{
+    if (s->get_reg == NULL)
+    {
+        return false;
+    }
+
+    int gain = s->get_reg(s, OV2640_SENSOR_REG(OV2640_REG_GAIN), 0xFF);
+    int aec_l = s->get_reg(s, OV2640_SENSOR_REG(OV2640_REG_REG04), 0x03);
+    int aec_m = s->get_reg(s, OV2640_SENSOR_REG(OV2640_REG_AEC), 0xFF);
+    int aec_h = s->get_reg(s, OV2640_SENSOR_REG(OV2640_REG_REG45), 0x3F);
+
+    if (gain < 0 || aec_l < 0 || aec_m < 0 || aec_h < 0)
+    {
+        return false;
+    }
+
+    s_aeawb_aec_raw = (uint16_t)((aec_h << 10) | (aec_m << 2) | aec_l);
+    s_aeawb_agc_raw = (uint8_t)gain;
+    s_aeawb_have_values = true;
+    return true;
+}
+
+/**
+ * @brief Write the stored AEC/AGC values back into the sensor
+ */
+static void aeawb_apply_values(sensor_t *s)
+{
+    s->set_reg(s, OV2640_SENSOR_REG(OV2640_REG_REG45), 0x3F, (s_aeawb_aec_raw >> 10) & 0x3F);
+    s->set_reg(s, OV2640_SENSOR_REG(OV2640_REG_AEC), 0xFF, (s_aeawb_aec_raw >> 2) & 0xFF);
+    s->set_reg(s, OV2640_SENSOR_REG(OV2640_REG_REG04), 0x03, s_aeawb_aec_raw & 0x03);
+    s->set_reg(s, OV2640_SENSOR_REG(OV2640_REG_GAIN), 0xFF, s_aeawb_agc_raw);
+}
+
+/**
+ * @brief Persist lock state and frozen values next to the HSV calibration
+ */
+static void aeawb_nvs_store(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "NVS open failed - AEC/AWB lock not persisted");
+        return;
+    }
+
+    uint32_t packed = (s_aeawb_lock ? (1u << 31) : 0) |
+                      ((uint32_t)s_aeawb_agc_raw << 16) |
+                      s_aeawb_aec_raw;
+    nvs_set_u32(handle, AEAWB_NVS_KEY, packed);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * @brief Restore lock state from NVS (boot path)
+ */
+static void aeawb_nvs_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(CALIB_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return;
+    }
+
+    uint32_t packed = 0;
+    esp_err_t err = nvs_get_u32(handle, AEAWB_NVS_KEY, &packed);
+    nvs_close(handle);
+
+    if (err != ESP_OK || (packed & (1u << 31)) == 0)
+    {
+        return;
+    }
+
+    s_aeawb_lock = true;
+    s_aeawb_have_values = true;
+    s_aeawb_aec_raw = (uint16_t)(packed & 0xFFFF);
+    s_aeawb_agc_raw = (uint8_t)((packed >> 16) & 0xFF);
+}
+
+/**
+ * @brief Re-freeze the sensor after init_camera() reset it
+ *
+ * AEC/AGC come back pinned at the persisted values; AWB has no
+ * readable gains, so it re-converges for AWB_SETTLE_FRAMES and the
+ * frame hook freezes it again.
+ */
+static void aeawb_reapply_after_reinit(void)
+{
+    if (!s_aeawb_lock || !s_aeawb_have_values)
+    {
+        return;
+    }
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL)
+    {
+        return;
+    }
+
+    s->set_exposure_ctrl(s, 0);
+    s->set_gain_ctrl(s, 0);
+    aeawb_apply_values(s);
+    s_awb_settle_frames = AWB_SETTLE_FRAMES;
+
+    ESP_LOGI(TAG, "AEC/AGC re-locked (AEC=%u, gain=%u) - AWB settling %d frames",
+             s_aeawb_aec_raw, s_aeawb_agc_raw, AWB_SETTLE_FRAMES);
+}
+
+/**
+ * @brief Between-frames hook: apply pending lock changes, end AWB settle
+ */
+static void aeawb_frame_hook(void)
+{
+    if (s_awb_settle_frames > 0 && --s_awb_settle_frames == 0)
+    {
+        sensor_t *s = esp_camera_sensor_get();
+        if (s != NULL)
+        {
+            s->set_whitebal(s, 0);
+            ESP_LOGI(TAG, "AWB frozen after settle window");
+        }
+    }
+
+    if (!s_aeawb_pending)
+    {
+        return;
+    }
+    s_aeawb_pending = false;
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL)
+    {
+        return;
+    }
+
+    if (s_aeawb_lock)
+    {
+        if (!aeawb_capture(s))
+        {
+            ESP_LOGW(TAG, "Sensor register read failed - AEC/AWB lock aborted");
+            s_aeawb_lock = false;
+            return;
+        }
+
+        s->set_exposure_ctrl(s, 0);
+        s->set_gain_ctrl(s, 0);
+        s->set_whitebal(s, 0);
+        aeawb_apply_values(s);
+        aeawb_nvs_store();
+
+        ESP_LOGI(TAG, "AEC/AWB locked (AEC=%u, gain=%u)",
+                 s_aeawb_aec_raw, s_aeawb_agc_raw);
+    }
+    else
+    {
+        s->set_exposure_ctrl(s, 1);
+        s->set_gain_ctrl(s, 1);
+        s->set_whitebal(s, 1);
+        s_awb_settle_frames = 0;
+        aeawb_nvs_store();
+
+        ESP_LOGI(TAG, "AEC/AWB unlocked - autos hunting again");
+    }
+}
+
+// ============================================================================
+// IMAGE PROCESSING FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Estimate distance using pinhole camera model
+ *
+ * Formula: distance = (real_width * focal_length) / pixel_width
+ *
+ * @param pixel_width Width of object in pixels
+ * @return Estimated distance in centimeters
+ */
+/**
+ * @brief Pinhole distance from a bounding box, fusing width and height
+ *
+ * A box clipped at a frame edge under-measures that dimension and the
+ * width-only estimate jumps upward, so each axis is used only when its
+ * extent lies fully inside the frame. With both valid the two estimates
+ * are averaged; with both clipped the larger extent (less truncated)
+ * wins as a last resort.
+ */
+static float estimate_distance_fused(const vision_blob_t *blob,
+                                     int frame_width, int frame_height)
+{
+    int pix_w = (blob->max_x - blob->min_x) + 1;
+    int pix_h = (blob->max_y - blob->min_y) + 1;
+
+    bool w_clipped = (blob->min_x <= 0) || (blob->max_x >= frame_width - 1);
+    bool h_clipped = (blob->min_y <= 0) || (blob->max_y >= frame_height - 1);
+
+    float d_w = (pix_w > 0)
+                    ? (KNOWN_OBJECT_WIDTH_CM * CAMERA_FOCAL_LENGTH_PX) / (float)pix_w
+                    : 999.9f;
+    float d_h = (pix_h > 0)
+                    ? (KNOWN_OBJECT_HEIGHT_CM * CAMERA_FOCAL_LENGTH_PX) / (float)pix_h
+                    : 999.9f;
+
+    if (w_clipped == h_clipped)
+    {
+        if (!w_clipped)
+        {
+            return (d_w + d_h) * 0.5f;
+        }
+        return (pix_w >= pix_h) ? d_w : d_h;
+    }
+
+    return w_clipped ? d_h : d_w;
+}
+
+// ============================================================================
+// DISTANCE FILTER (CONSTANT VELOCITY)
+// ============================================================================
+
+/**
+ * Alpha-beta filter over the per-frame distance estimates. Smooths the
+ * jumps a noisy bounding box causes and tracks closing speed, so the
+ * veto can fire on where the obstacle will be shortly rather than where
+ * it was one frame ago - reaction latency bought without more CPU or a
+ * higher frame rate. Vision task context only.
+ */
+
+#define DIST_FILTER_ALPHA 0.5f        // Position innovation gain
+#define DIST_FILTER_BETA 0.3f         // Velocity innovation gain
+#define DIST_FILTER_RESET_US (500000) // Gap that restarts the filter
+
+static bool s_dist_filter_valid = false;
+static float s_dist_filt_cm = 0.0f;
+static float s_dist_vel_cm_s = 0.0f; // Negative = closing
+static int64_t s_dist_last_us = 0;
+
+/**
+ * @brief Fold one measurement in and return the filtered distance
+ */
+static float distance_filter_update(float meas_cm, int64_t now_us)
+{
+    if (!s_dist_filter_valid || (now_us - s_dist_last_us) > DIST_FILTER_RESET_US)
+    {
+        s_dist_filter_valid = true;
+        s_dist_filt_cm = meas_cm;
+        s_dist_vel_cm_s = 0.0f;
+        s_dist_last_us = now_us;
+        return meas_cm;
+    }
+
+    float dt = (float)(now_us - s_dist_last_us) / 1000000.0f;
+    if (dt < 0.001f)
+    {
+        dt = 0.001f;
+    }
+
+    float predicted = s_dist_filt_cm + s_dist_vel_cm_s * dt;
+    float innovation = meas_cm - predicted;
+
+    s_dist_filt_cm = predicted + DIST_FILTER_ALPHA * innovation;
+    s_dist_vel_cm_s += (DIST_FILTER_BETA * innovation) / dt;
+    s_dist_last_us = now_us;
+
+    return s_dist_filt_cm;
+}
+
+// Coarse-to-fine pyramid scan: a strided first pass finds candidate
+// regions, then a dense pass rescans only inside the candidate box.
+// Most frames have no green obstacle, so the coarse pass alone (1/16th
+// of the pixels) decides the common case.
+#define SCAN_COARSE_STEP 4
+#define SCAN_REFINE_MARGIN (SCAN_COARSE_STEP * 2)
+
+// ROI tracking: once locked onto an obstacle, the next frame almost
+// always finds it within a few dozen pixels of the previous bounding
+// box. Scanning only that window makes veto latency independent of
+// image size exactly when it matters - while actively avoiding.
+#define TRACK_WINDOW_MARGIN 32 // Pixels added around the last bbox
+#define TRACK_MAX_MISSES 3     // Empty windows before full-frame rescan
+
+typedef struct
+{
+    uint32_t sum_x;
+    uint32_t sum_y;
+    uint32_t hit_count;
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+} scan_accum_t;
+
+static void scan_accum_reset(scan_accum_t *acc, int width, int height)
+{
+    acc->sum_x = 0;
+    acc->sum_y = 0;
+    acc->hit_count = 0;
+    acc->min_x = width;
+    acc->max_x = -1;
+    acc->min_y = height;
+    acc->max_y = -1;
+}
+
+static void scan_accum_merge(scan_accum_t *acc, const scan_accum_t *other)
+{
+    acc->sum_x += other->sum_x;
+    acc->sum_y += other->sum_y;
+    acc->hit_count += other->hit_count;
+
+    if (other->min_x < acc->min_x)
+        acc->min_x = other->min_x;
+    if (other->max_x > acc->max_x)
+        acc->max_x = other->max_x;
+    if (other->min_y < acc->min_y)
+        acc->min_y = other->min_y;
+    if (other->max_y > acc->max_y)
+        acc->max_y = other->max_y;
+}
+
+// Scanline staging: frame buffers live in PSRAM, so per-pixel reads pay
+// QSPI latency. Dense scans burst each row into internal SRAM first and
+// classify from there, turning scattered PSRAM reads into one sequential
+// copy per row. The plain ESP32 has no memcpy DMA engine, so the burst
+// is a synchronous memcpy; one buffer per core for the split scan.
+static uint16_t s_row_stage[2][IMAGE_WIDTH];
+
+// ============================================================================
+// FRAME BUDGET ENFORCEMENT
+// ============================================================================
+// A pathological frame - the whole arena floor classifying green after
+// a lighting failure - makes the dense passes run arbitrarily long,
+// and the veto contract needs bounded worst-case latency, not just a
+// good average. process_frame() arms a deadline per frame; every
+// scanning loop below checks it once per row block and aborts its pass
+// on overrun, after which the frame publishes a conservative partial
+// result (veto-asserted if anything qualifying was seen) instead of a
+// late complete one. The flag is a plain volatile shared with the
+// Core 0 scan worker: both halves of a split scan stop on the same
+// deadline, and a torn read only delays the abort by one row block.
+
+#define BUDGET_ROW_BLOCK 16 // Rows scanned between deadline checks
+
+static volatile int64_t s_frame_deadline_us = 0;
+static volatile bool s_frame_over_budget = false;
+static _Atomic uint32_t s_budget_overruns = 0;
+
+static inline bool frame_budget_exceeded(void)
+{
+    if (s_frame_over_budget)
+    {
+        return true;
+    }
+    if (esp_timer_get_time() > s_frame_deadline_us)
+    {
+        s_frame_over_budget = true;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Fold one classifier hit into the accumulator
+ */
+static inline void scan_accum_hit(scan_accum_t *acc, int x, int y)
+{
+    acc->sum_x += x;
+    acc->sum_y += y;
+    acc->hit_count++;
+
+    if (x < acc->min_x)
+        acc->min_x = x;
+    if (x > acc->max_x)
+        acc->max_x = x;
+    if (y < acc->min_y)
+        acc->min_y = y;
+    if (y > acc->max_y)
+        acc->max_y = y;
+}
+
+// ============================================================================
+// DRIVE-CORRIDOR ROI
+// ============================================================================
+// The veto only cares about obstacles in the vehicle's path, yet the
+// coarse pass scanned the full frame including sky and far periphery.
+// The corridor is a trapezoid of per-row column bounds: wide at the
+// bumper, narrowing toward a horizon row above which nothing is
+// scanned, with the far end shifted sideways by the current steering
+// (taken from the commanded motor differential - STATE_TURNING alone
+// carries no direction). In practice it covers ~40% of the frame, and
+// off-path objects can no longer raise a veto at all.
+//
+// Only the full-frame coarse scan is clamped: the refine and tracking
+// passes label candidate boxes that already came from corridor hits.
+
+#define CORRIDOR_HORIZON_PCT 40   // Rows above this fraction are skipped
+#define CORRIDOR_BOTTOM_PCT 90    // Corridor width at the bottom row (% of frame)
+#define CORRIDOR_TOP_PCT 30       // Corridor width at the horizon row
+#define CORRIDOR_SHIFT_MAX_PCT 25 // Far-end lateral shift at full steering lock
+
+static bool s_corridor_enabled = false;
+static bool s_corridor_frame_active = false; // Bounds valid for this frame
+static int16_t s_corridor_x0[IMAGE_HEIGHT];
+static int16_t s_corridor_x1[IMAGE_HEIGHT]; // Exclusive
+static int s_corridor_y_top = 0;
+
+/**
+ * @brief Recompute the per-row corridor bounds for this frame
+ *
+ * Cheap enough to run per frame (one multiply-divide pair per row), so
+ * the trapezoid follows steering changes with no staleness.
+ */
+static bool corridor_prepare(int frame_width, int frame_height)
+{
+    if (!s_corridor_enabled || frame_height > IMAGE_HEIGHT)
+    {
+        return false;
+    }
+
+    int left_speed = 0;
+    int right_speed = 0;
+    motor_get_speeds(&left_speed, &right_speed);
+
+    // Differential in [-510, 510]: positive = curving right, and the
+    // far end of the projected path moves the same way
+    int diff = left_speed - right_speed;
+    int shift_max = frame_width * CORRIDOR_SHIFT_MAX_PCT / 100;
+    int shift_far = diff * shift_max / 510;
+
+    int y_top = frame_height * CORRIDOR_HORIZON_PCT / 100;
+    int span = frame_height - 1 - y_top;
+    if (span <= 0)
+    {
+        return false;
+    }
+    s_corridor_y_top = y_top;
+
+    for (int y = y_top; y < frame_height; y++)
+    {
+        // t: 0 at the horizon row, 256 at the bottom row
+        int t = (y - y_top) * 256 / span;
+        int width_pct = CORRIDOR_TOP_PCT +
+                        (CORRIDOR_BOTTOM_PCT - CORRIDOR_TOP_PCT) * t / 256;
+        int half = frame_width * width_pct / 200;
+        int center = frame_width / 2 + shift_far * (256 - t) / 256;
+
+        int cx0 = center - half;
+        int cx1 = center + half;
+        if (cx0 < 0)
+            cx0 = 0;
+        if (cx1 > frame_width)
+            cx1 = frame_width;
+
+        s_corridor_x0[y] = (int16_t)cx0;
+        s_corridor_x1[y] = (int16_t)((cx1 > cx0) ? cx1 : cx0);
+    }
+
+    return true;
+}
+
+void vision_engine_set_corridor_roi(bool enable)
+{
+    s_corridor_enabled = enable;
+    ESP_LOGI(TAG, "Drive-corridor ROI %s", enable ? "ENABLED" : "DISABLED");
+}
+
+/**
+ * @brief Scan a rectangular window of the frame with a given pixel stride
+ *
+ * Accumulates centroid sums and bounding box of classifier hits. A step
+ * of 1 is a dense scan; larger steps sample every Nth row/column.
+ * Dense rows are staged through internal SRAM; strided rows are read
+ * in place since copying the full row would cost more than it saves.
+ *
+ * Placed in IRAM: executing from flash cache made frame time depend on
+ * what the WiFi stack evicted mid-frame, and the veto loop cares about
+ * worst-case jitter as much as the average. The dense path is unrolled
+ * 4x with the probes folded into one hit mask, so the common background
+ * run costs one branch per four pixels instead of one per pixel.
+ */
+static void IRAM_ATTR scan_region(const uint16_t *pixels, int frame_width,
+                                  int x0, int y0, int x1, int y1,
+                                  int step, scan_accum_t *acc)
+{
+    uint16_t *stage = s_row_stage[xPortGetCoreID()];
+    const bool use_stage = (step == 1) && ((x1 - x0) <= IMAGE_WIDTH);
+    int rows_to_check = BUDGET_ROW_BLOCK;
+
+    for (int y = y0; y < y1; y += step)
+    {
+        if (--rows_to_check <= 0)
+        {
+            if (frame_budget_exceeded())
+            {
+                return; // Partial accumulator; the caller fails safe
+            }
+            rows_to_check = BUDGET_ROW_BLOCK;
+        }
+
+        const uint16_t *row = pixels + (y * frame_width);
+
+        // Per-row corridor clamp; rows above the horizon scan nothing
+        int rx0 = x0;
+        int rx1 = x1;
+        if (s_corridor_frame_active)
+        {
+            if (y < s_corridor_y_top)
+            {
+                continue;
+            }
+            if (s_corridor_x0[y] > rx0)
+                rx0 = s_corridor_x0[y];
+            if (s_corridor_x1[y] < rx1)
+                rx1 = s_corridor_x1[y];
+            if (rx0 >= rx1)
+            {
+                continue;
+            }
+        }
+
+        if (use_stage)
+        {
+            memcpy(stage, row + rx0, (size_t)(rx1 - rx0) * sizeof(uint16_t));
+
+            const uint16_t *p = stage;
+            int x = rx0;
+            const int x_end4 = rx0 + ((rx1 - rx0) & ~3);
+
+            for (; x < x_end4; x += 4, p += 4)
+            {
+                uint32_t hits = (uint32_t)classifier_lut_probe(p[0]) |
+                                ((uint32_t)classifier_lut_probe(p[1]) << 1) |
+                                ((uint32_t)classifier_lut_probe(p[2]) << 2) |
+                                ((uint32_t)classifier_lut_probe(p[3]) << 3);
+
+                while (hits)
+                {
+                    int bit = __builtin_ctz(hits);
+                    hits &= hits - 1;
+                    scan_accum_hit(acc, x + bit, y);
+                }
+            }
+
+            for (; x < rx1; x++, p++)
+            {
+                if (classifier_lut_probe(*p))
+                {
+                    scan_accum_hit(acc, x, y);
+                }
+            }
+
+            continue;
+        }
+
+        for (int x = rx0; x < rx1; x += step)
+        {
+            if (classifier_lut_probe(row[x]))
+            {
+                scan_accum_hit(acc, x, y);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// PACKED BINARY MASK + WORD-PARALLEL MORPHOLOGY
+// ============================================================================
+
+/**
+ * Dense passes first binarize the window into a packed 1bpp mask
+ * (9.6KB for full QVGA, internal RAM). A morphological opening
+ * (erode then dilate) then runs directly on the 32-bit mask words -
+ * shifts and ANDs process 32 pixels per operation - so single-pixel
+ * sensor noise is suppressed before it can reach MIN_CONTOUR_AREA,
+ * at a tiny fraction of the cost of a per-pixel 3x3 pass.
+ */
+
+#define MASK_WORDS_PER_ROW ((IMAGE_WIDTH + 31) / 32)
+
+// The word-parallel kernels below hardcode a 3x3 neighborhood
+_Static_assert(MORPH_KERNEL_SIZE == 3, "mask morphology implements a 3x3 kernel");
+
+// Frame-lifetime scratch from the arena (9.6KB for full QVGA, internal
+// RAM): bound once per frame, both label_region() calls of a track-miss
+// frame reuse the same slice
+static uint32_t (*s_mask)[MASK_WORDS_PER_ROW];
+static uint32_t s_mask_generation;
+
+/**
+ * @brief Classify a window into the packed mask
+ *
+ * Rows are staged through internal SRAM like the accumulator scan.
+ * Words touching the window are cleared first, so bits outside
+ * [x0,x1) stay zero and act as background for the morphology pass.
+ *
+ * @return One past the last row built - y1, or less after a budget
+ *         overrun; rows beyond it hold stale bits and must not be read
+ */
+static int IRAM_ATTR mask_build_region(const uint16_t *pixels, int frame_width,
+                                       int x0, int y0, int x1, int y1)
+{
+    uint16_t *stage = s_row_stage[xPortGetCoreID()];
+    const int w0 = x0 >> 5;
+    const int w1 = (x1 + 31) >> 5;
+    int rows_to_check = BUDGET_ROW_BLOCK;
+
+    for (int y = y0; y < y1; y++)
+    {
+        if (--rows_to_check <= 0)
+        {
+            if (frame_budget_exceeded())
+            {
+                return y;
+            }
+            rows_to_check = BUDGET_ROW_BLOCK;
+        }
+
+        const uint16_t *row = pixels + (y * frame_width);
+        if ((x1 - x0) <= IMAGE_WIDTH)
+        {
+            memcpy(stage, row + x0, (size_t)(x1 - x0) * sizeof(uint16_t));
+            row = stage - x0;
+        }
+
+        memset(&s_mask[y][w0], 0, (size_t)(w1 - w0) * sizeof(uint32_t));
+
+        // Branch-free: the probe result is shifted straight into place,
+        // so this loop runs at a fixed cost regardless of scene content
+        for (int x = x0; x < x1; x++)
+        {
+            s_mask[y][x >> 5] |= (uint32_t)classifier_lut_probe(row[x]) << (x & 31);
+        }
+    }
+    return y1;
+}
+
+/**
+ * @brief Horizontal 1x3 erosion/dilation of one mask row, word-parallel
+ *
+ * Bit b of word i is pixel x = i*32+b, so a left shift brings in the
+ * left neighbor and a right shift the right neighbor, with the carry
+ * bit taken from the adjacent word.
+ */
+static inline void mask_row_hmorph(uint32_t *dst, const uint32_t *src,
+                                   int w0, int w1, bool erode)
+{
+    for (int i = w0; i < w1; i++)
+    {
+        uint32_t w = src[i];
+        uint32_t left = (w << 1) | ((i > w0) ? (src[i - 1] >> 31) : 0);
+        uint32_t right = (w >> 1) | ((i + 1 < w1) ? (src[i + 1] << 31) : 0);
+
+        dst[i] = erode ? (w & left & right) : (w | left | right);
+    }
+}
+
+/**
+ * @brief One 3x3 erode or dilate pass over a mask window, in place
+ *
+ * Keeps only a rolling 3-row buffer of horizontally-processed rows, so
+ * no second full-size mask is needed. Pixels outside the window count
+ * as background, which erodes the border row/column - harmless for a
+ * noise filter.
+ */
+static void mask_morph_pass(int x0, int y0, int x1, int y1, bool erode)
+{
+    static uint32_t hz[3][MASK_WORDS_PER_ROW];
+
+    const int w0 = x0 >> 5;
+    const int w1 = (x1 + 31) >> 5;
+    const size_t span = (size_t)(w1 - w0) * sizeof(uint32_t);
+
+    // Prime the rolling buffer: row y0-1 is background, row y0 is real
+    memset(&hz[0][w0], 0, span);
+    mask_row_hmorph(hz[1], s_mask[y0], w0, w1, erode);
+
+    for (int y = y0; y < y1; y++)
+    {
+        const int above = (y - y0) % 3;
+        const int center = (y - y0 + 1) % 3;
+        const int below = (y - y0 + 2) % 3;
+
+        if (y + 1 < y1)
+        {
+            mask_row_hmorph(hz[below], s_mask[y + 1], w0, w1, erode);
+        }
+        else
+        {
+            memset(&hz[below][w0], 0, span);
+        }
+
+        for (int i = w0; i < w1; i++)
+        {
+            s_mask[y][i] = erode ? (hz[above][i] & hz[center][i] & hz[below][i])
+                                 : (hz[above][i] | hz[center][i] | hz[below][i]);
+        }
+    }
+}
+
+/**
+ * @brief Morphological opening (erode + dilate) on a mask window
+ *
+ * Removes specks smaller than the 3x3 kernel while restoring the
+ * silhouette of real objects, fulfilling the "morphological filtering"
+ * stage the process_frame() pipeline always documented.
+ */
+static void mask_morph_open(int x0, int y0, int x1, int y1)
+{
+    mask_morph_pass(x0, y0, x1, y1, true);
+    mask_morph_pass(x0, y0, x1, y1, false);
+}
+
+// ============================================================================
+// RUN-LENGTH CONNECTED-COMPONENT LABELING
+// ============================================================================
+
+/**
+ * Single-pass RLE labeler: each row of the denoised mask is reduced to
+ * runs of set bits, runs are linked to overlapping runs of the previous
+ * row, and label collisions are resolved with a small union-find.
+ * Touches each pixel once, so it costs little more than the plain
+ * accumulator scan while separating multiple objects instead of merging
+ * them into one phantom centroid.
+ */
+
+#define CCL_MAX_LABELS 16
+#define CCL_MAX_RUNS_PER_ROW 32
+
+// ----------------------------------------------------------------------------
+// Zone accumulators (left/center/right thirds)
+//
+// One centroid per frame collapses everything into "stop"; knowing
+// which third of the frame the hits fall in lets the control layer
+// prefer a steering nudge over a full stop-and-wait. The counts are
+// folded in while the labeler walks its runs - a run is split across
+// the thirds it spans, a few compares per run rather than per pixel -
+// and the per-zone distance comes from the fused estimate of the blobs
+// touching each third. Vision task context only.
+// ----------------------------------------------------------------------------
+
+static uint32_t s_zone_hits[VISION_ZONE_COUNT];
+static int s_zone_x1 = 0; // First column of the center third
+static int s_zone_x2 = 0; // First column of the right third
+
+static void zone_accum_reset(int frame_width)
+{
+    memset(s_zone_hits, 0, sizeof(s_zone_hits));
+    s_zone_x1 = frame_width / 3;
+    s_zone_x2 = (frame_width * 2) / 3;
+}
+
+/**
+ * @brief Credit one run of classified pixels to the thirds it spans
+ */
+static inline void zone_accum_run(int x_start, int x_end)
+{
+    if (x_start < s_zone_x1)
+    {
+        int end = (x_end < s_zone_x1) ? x_end : s_zone_x1 - 1;
+        s_zone_hits[VISION_ZONE_LEFT] += (uint32_t)(end - x_start + 1);
+    }
+    if (x_end >= s_zone_x1 && x_start < s_zone_x2)
+    {
+        int start = (x_start > s_zone_x1) ? x_start : s_zone_x1;
+        int end = (x_end < s_zone_x2) ? x_end : s_zone_x2 - 1;
+        s_zone_hits[VISION_ZONE_CENTER] += (uint32_t)(end - start + 1);
+    }
+    if (x_end >= s_zone_x2)
+    {
+        int start = (x_start > s_zone_x2) ? x_start : s_zone_x2;
+        s_zone_hits[VISION_ZONE_RIGHT] += (uint32_t)(x_end - start + 1);
+    }
+}
+
+typedef struct
+{
+    uint32_t area;
+    uint32_t sum_x;
+    uint32_t sum_y;
+    int min_x, max_x;
+    int min_y, max_y;
+    int parent;
+} ccl_label_t;
+
+typedef struct
+{
+    int x_start;
+    int x_end; // Inclusive
+    int label;
+} ccl_run_t;
+
+static int ccl_find(ccl_label_t *labels, int i)
+{
+    while (labels[i].parent != i)
+    {
+        labels[i].parent = labels[labels[i].parent].parent; // Path halving
+        i = labels[i].parent;
+    }
+    return i;
+}
+
+static void ccl_union(ccl_label_t *labels, int a, int b)
+{
+    a = ccl_find(labels, a);
+    b = ccl_find(labels, b);
+    if (a != b)
+    {
+        labels[b].parent = a;
+    }
+}
+
+/**
+ * @brief Find the next set mask bit in a row, or x1 if none
+ *
+ * Skips clear 32-pixel words whole; within a word a single CTZ jumps
+ * straight to the bit. Pass invert=true to search for the next clear
+ * bit (end of a run) instead.
+ */
+static inline int mask_row_next(const uint32_t *mask_row, int x, int x1, bool invert)
+{
+    while (x < x1)
+    {
+        uint32_t w = mask_row[x >> 5];
+        if (invert)
+        {
+            w = ~w;
+        }
+        w >>= (x & 31);
+
+        if (w == 0)
+        {
+            x = (x & ~31) + 32;
+            continue;
+        }
+
+        x += __builtin_ctz(w);
+        return (x < x1) ? x : x1;
+    }
+    return x1;
+}
+
+/**
+ * @brief Label connected components inside a frame window
+ *
+ * Binarizes the window into the packed mask, runs the morphological
+ * opening, then labels runs of the cleaned mask. Emits per-blob area,
+ * centroid and bounding box, sorted largest first. Blobs below
+ * MIN_CONTOUR_AREA are dropped. Vision task context only (static
+ * scratch state).
+ *
+ * @return Number of blobs written to out[]
+ */
+static int label_region(const uint16_t *pixels, int frame_width,
+                        int x0, int y0, int x1, int y1,
+                        vision_blob_t *out, int max_out)
+{
+    static ccl_label_t labels[CCL_MAX_LABELS];
+    static ccl_run_t run_rows[2][CCL_MAX_RUNS_PER_ROW];
+
+    if (s_mask == NULL || s_mask_generation != mem_arena_generation())
+    {
+        s_mask = mem_arena_alloc(IMAGE_HEIGHT * sizeof(*s_mask));
+        s_mask_generation = mem_arena_generation();
+        if (s_mask == NULL)
+        {
+            // Arena exhausted: skip the dense pass, the caller treats
+            // it as an empty window
+            return 0;
+        }
+    }
+
+    // A budget overrun cuts the mask short; label only what was built.
+    // The partial window still yields blobs for the fail-safe result.
+    int y_built = mask_build_region(pixels, frame_width, x0, y0, x1, y1);
+    if (y_built < y1)
+    {
+        y1 = y_built;
+    }
+    if (y1 <= y0)
+    {
+        return 0;
+    }
+    mask_morph_open(x0, y0, x1, y1);
+
+    // The last labeling call of the frame is the authoritative one (a
+    // track-miss relabels the full candidate box after the empty window)
+    zone_accum_reset(frame_width);
+
+    int label_count = 0;
+    int prev_count = 0;
+    int cur_bank = 0;
+    int rows_to_check = BUDGET_ROW_BLOCK;
+
+    for (int y = y0; y < y1; y++)
+    {
+        if (--rows_to_check <= 0)
+        {
+            if (frame_budget_exceeded())
+            {
+                break; // Labels found so far still produce blobs
+            }
+            rows_to_check = BUDGET_ROW_BLOCK;
+        }
+
+        const uint32_t *mask_row = s_mask[y];
+
+        ccl_run_t *cur = run_rows[cur_bank];
+        ccl_run_t *prev = run_rows[cur_bank ^ 1];
+        int cur_count = 0;
+
+        // Extract runs of set mask bits via word scanning
+        for (int x = x0; x < x1;)
+        {
+            int run_start = mask_row_next(mask_row, x, x1, false);
+            if (run_start >= x1)
+            {
+                break;
+            }
+
+            x = mask_row_next(mask_row, run_start + 1, x1, true);
+
+            if (cur_count >= CCL_MAX_RUNS_PER_ROW)
+            {
+                break; // Degenerate noise row - ignore the rest
+            }
+
+            cur[cur_count].x_start = run_start;
+            cur[cur_count].x_end = x - 1;
+            cur[cur_count].label = -1;
+            cur_count++;
+        }
+
+        // Link each run to overlapping runs of the previous row (4-conn)
+        for (int r = 0; r < cur_count; r++)
+        {
+            for (int p = 0; p < prev_count; p++)
+            {
+                if (prev[p].label < 0 ||
+                    prev[p].x_start > cur[r].x_end ||
+                    prev[p].x_end < cur[r].x_start)
+                {
+                    continue;
+                }
+
+                if (cur[r].label < 0)
+                {
+                    cur[r].label = prev[p].label;
+                }
+                else
+                {
+                    ccl_union(labels, cur[r].label, prev[p].label);
+                }
+            }
+
+            if (cur[r].label < 0)
+            {
+                if (label_count >= CCL_MAX_LABELS)
+                {
+                    continue; // Label pool exhausted - drop the run
+                }
+
+                ccl_label_t *l = &labels[label_count];
+                l->area = 0;
+                l->sum_x = 0;
+                l->sum_y = 0;
+                l->min_x = frame_width;
+                l->max_x = -1;
+                l->min_y = y1;
+                l->max_y = -1;
+                l->parent = label_count;
+                cur[r].label = label_count++;
+            }
+
+            // Accumulate run stats; (x_start+x_end)*len is always even
+            zone_accum_run(cur[r].x_start, cur[r].x_end);
+            ccl_label_t *l = &labels[cur[r].label];
+            int len = cur[r].x_end - cur[r].x_start + 1;
+            l->area += len;
+            l->sum_x += (uint32_t)(cur[r].x_start + cur[r].x_end) * len / 2;
+            l->sum_y += (uint32_t)y * len;
+
+            if (cur[r].x_start < l->min_x)
+                l->min_x = cur[r].x_start;
+            if (cur[r].x_end > l->max_x)
+                l->max_x = cur[r].x_end;
+            if (y < l->min_y)
+                l->min_y = y;
+            if (y > l->max_y)
+                l->max_y = y;
+        }
+
+        prev_count = cur_count;
+        cur_bank ^= 1;
+    }
+
+    // Fold child labels into their union-find roots
+    for (int i = 0; i < label_count; i++)
+    {
+        int root = ccl_find(labels, i);
+        if (root == i)
+        {
+            continue;
+        }
+
+        ccl_label_t *l = &labels[i];
+        ccl_label_t *r = &labels[root];
+        r->area += l->area;
+        r->sum_x += l->sum_x;
+        r->sum_y += l->sum_y;
+        if (l->min_x < r->min_x)
+            r->min_x = l->min_x;
+        if (l->max_x > r->max_x)
+            r->max_x = l->max_x;
+        if (l->min_y < r->min_y)
+            r->min_y = l->min_y;
+        if (l->max_y > r->max_y)
+            r->max_y = l->max_y;
+        l->area = 0;
+    }
+
+    // Emit roots above the noise floor, insertion-sorted largest first
+    int out_count = 0;
+    for (int i = 0; i < label_count; i++)
+    {
+        if (labels[i].parent != i || labels[i].area < s_min_contour_area)
+        {
+            continue;
+        }
+
+        vision_blob_t blob = {
+            .area = (int)labels[i].area,
+            .centroid_x = (int)(labels[i].sum_x / labels[i].area),
+            .centroid_y = (int)(labels[i].sum_y / labels[i].area),
+            .min_x = labels[i].min_x,
+            .min_y = labels[i].min_y,
+            .max_x = labels[i].max_x,
+            .max_y = labels[i].max_y,
+        };
+
+        int pos = out_count;
+        while (pos > 0 && out[pos - 1].area < blob.area)
+        {
+            if (pos < max_out)
+            {
+                out[pos] = out[pos - 1];
+            }
+            pos--;
+        }
+
+        if (pos < max_out)
+        {
+            out[pos] = blob;
+            if (out_count < max_out)
+            {
+                out_count++;
+            }
+        }
+    }
+
+    return out_count;
+}
+
+// ============================================================================
+// DUAL-CORE SPLIT SCAN
+// ============================================================================
+
+/**
+ * Core 0 mostly idles between WebSocket events while the vision task
+ * saturates Core 1. A small worker pinned to Core 0 scans the top half
+ * of each region while the vision task scans the bottom half; the
+ * per-half accumulators are merged afterwards. Handshake is a pair of
+ * direct task notifications (no queue, no allocation).
+ */
+
+typedef struct
+{
+    const uint16_t *pixels;
+    int frame_width;
+    int x0, y0, x1, y1;
+    int step;
+    scan_accum_t acc;
+} scan_job_t;
+
+static TaskHandle_t s_scan_worker_handle = NULL;
+static TaskHandle_t s_scan_requester = NULL;
+static scan_job_t s_scan_job;
+
+// Regions shorter than this aren't worth the notification round trip
+#define SCAN_PARALLEL_MIN_ROWS 32
+
+static void scan_worker_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Scan worker started on core %d", xPortGetCoreID());
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        scan_region(s_scan_job.pixels, s_scan_job.frame_width,
+                    s_scan_job.x0, s_scan_job.y0,
+                    s_scan_job.x1, s_scan_job.y1,
+                    s_scan_job.step, &s_scan_job.acc);
+
+        xTaskNotifyGive(s_scan_requester);
+    }
+}
+
+/**
+ * @brief scan_region() split across both cores by row range
+ *
+ * Falls back to a single-core scan when the worker is unavailable or
+ * the region is too small to amortize the handshake.
+ */
+static void scan_region_parallel(const uint16_t *pixels, int frame_width,
+                                 int x0, int y0, int x1, int y1,
+                                 int step, scan_accum_t *acc)
+{
+    int rows = y1 - y0;
+
+    if (s_scan_worker_handle == NULL || rows < SCAN_PARALLEL_MIN_ROWS)
+    {
+        scan_region(pixels, frame_width, x0, y0, x1, y1, step, acc);
+        return;
+    }
+
+    // Split on a stride boundary so both halves keep the sampling phase
+    int y_mid = y0 + ((rows / 2) / step) * step;
+
+    s_scan_job.pixels = pixels;
+    s_scan_job.frame_width = frame_width;
+    s_scan_job.x0 = x0;
+    s_scan_job.y0 = y0;
+    s_scan_job.x1 = x1;
+    s_scan_job.y1 = y_mid;
+    s_scan_job.step = step;
+    scan_accum_reset(&s_scan_job.acc, frame_width, y1);
+
+    s_scan_requester = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(s_scan_worker_handle);
+
+    // Scan the bottom half on this core while the worker takes the top
+    scan_region(pixels, frame_width, x0, y_mid, x1, y1, step, acc);
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    scan_accum_merge(acc, &s_scan_job.acc);
+}
+
+// ============================================================================
+// MOTION GATE
+// ============================================================================
+
+/**
+ * A parked vehicle stares at a static scene, yet every frame used to pay
+ * for a full classification pass. The gate probes a sparse 16x16 grid
+ * (256 pixels) against the same probes of the last scanned frame and
+ * skips the detection stage when nothing moved; the previous result is
+ * simply re-published. The reference probes are only refreshed on real
+ * scans, so slow lighting drift accumulates until it trips the gate
+ * instead of being silently tracked. A forced scan every
+ * MOTION_FORCE_SCAN_INTERVAL frames bounds the worst case, and the gate
+ * is bypassed entirely while an obstacle is being tracked - veto
+ * reaction time never depends on it.
+ */
+
+#define MOTION_GRID_DIM 16            // 16x16 = 256 probe pixels per frame
+#define MOTION_PIXEL_DELTA_MIN 12     // Weighted |dR|+|dG|+|dB| per probe (6-bit scale)
+#define MOTION_MIN_CHANGED_PROBES 4   // Probes over threshold = motion
+#define MOTION_FORCE_SCAN_INTERVAL 10 // Full scan at least every N frames
+
+static uint16_t s_motion_ref[MOTION_GRID_DIM * MOTION_GRID_DIM];
+static bool s_motion_ref_valid = false;
+static int s_motion_frames_skipped = 0;
+
+/**
+ * @brief Weighted channel distance between two RGB565 pixels
+ *
+ * 5-bit channels are doubled so all three weigh roughly the same.
+ */
+static inline int rgb565_delta(uint16_t a, uint16_t b)
+{
+    int dr = (int)((a >> 11) & 0x1F) - (int)((b >> 11) & 0x1F);
+    int dg = (int)((a >> 5) & 0x3F) - (int)((b >> 5) & 0x3F);
+    int db = (int)(a & 0x1F) - (int)(b & 0x1F);
+
+    if (dr < 0)
+        dr = -dr;
+    if (dg < 0)
+        dg = -dg;
+    if (db < 0)
+        db = -db;
+
+    return (dr << 1) + dg + (db << 1);
+}
+
+/**
+ * @brief Decide whether the detection stage can be skipped this frame
+ *
+ * Returns true for a static scene. When it returns false the sampled
+ * probes become the new reference, so the comparison always runs
+ * against the last frame that was actually scanned.
+ */
+static bool motion_gate_should_skip(const uint16_t *pixels, int width, int height)
+{
+    uint16_t probes[MOTION_GRID_DIM * MOTION_GRID_DIM];
+    int changed = 0;
+
+    // Probe cell centers so the grid never touches the frame border
+    for (int gy = 0; gy < MOTION_GRID_DIM; gy++)
+    {
+        int y = (height * (2 * gy + 1)) / (2 * MOTION_GRID_DIM);
+        const uint16_t *row = pixels + (y * width);
+
+        for (int gx = 0; gx < MOTION_GRID_DIM; gx++)
+        {
+            int x = (width * (2 * gx + 1)) / (2 * MOTION_GRID_DIM);
+            probes[gy * MOTION_GRID_DIM + gx] = row[x];
+        }
+    }
+
+    if (s_motion_ref_valid && s_motion_frames_skipped < MOTION_FORCE_SCAN_INTERVAL)
+    {
+        for (int i = 0; i < MOTION_GRID_DIM * MOTION_GRID_DIM; i++)
+        {
+            if (rgb565_delta(probes[i], s_motion_ref[i]) >= MOTION_PIXEL_DELTA_MIN)
+            {
+                changed++;
+            }
+        }
+
+        if (changed < MOTION_MIN_CHANGED_PROBES)
+        {
+            s_motion_frames_skipped++;
+            atomic_fetch_add_explicit(&s_motion_skips, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+
+    memcpy(s_motion_ref, probes, sizeof(probes));
+    s_motion_ref_valid = true;
+    s_motion_frames_skipped = 0;
+    return false;
+}
+
+/**
+ * @brief Low-light detection on a grayscale frame
+ *
+ * No hue to classify: a strided luminance-band scan promotes anything
+ * bright enough to sit inside the V band of the green range to a
+ * candidate, and the whole strided cloud becomes one coarse blob.
+ * Deliberately cruder than the color pipeline (no labeling, no shape
+ * filters, no tracking) - its job is to keep the veto responsive on
+ * half-size frames while the color signal is worthless; precision
+ * returns with daylight.
+ */
+static esp_err_t process_frame_gray(camera_fb_t *fb, vision_result_t *result,
+                                    uint64_t start_time)
+{
+    ambient_luma_update(fb);
+    low_light_auto_evaluate();
+
+    result->obstacle_detected = false;
+    result->distance_cm = 999.9f;
+    result->closing_speed_cm_s = 0.0f;
+    result->centroid_x = 0;
+    result->centroid_y = 0;
+    result->contour_area = 0;
+    result->capture_time_us = (int64_t)start_time;
+
+    // No labeling pass here, so the zones stay empty
+    memset(result->zones, 0, sizeof(result->zones));
+    for (int z = 0; z < VISION_ZONE_COUNT; z++)
+    {
+        result->zones[z].min_distance_cm = 999.9f;
+    }
+
+    const uint8_t *pixels = fb->buf;
+    const uint8_t v_min = s_green_range.v_min;
+    const uint8_t v_max = s_green_range.v_max;
+
+    scan_accum_t acc;
+    scan_accum_reset(&acc, fb->width, fb->height);
+
+    for (int y = 0; y < (int)fb->height; y += SCAN_COARSE_STEP)
+    {
+        const uint8_t *row = pixels + (y * fb->width);
+        for (int x = 0; x < (int)fb->width; x += SCAN_COARSE_STEP)
+        {
+            uint8_t p = row[x];
+            if (p >= v_min && p <= v_max)
+            {
+                scan_accum_hit(&acc, x, y);
+            }
+        }
+    }
+
+    // Each strided hit stands for a step-by-step patch of the frame
+    int area = (int)acc.hit_count * SCAN_COARSE_STEP * SCAN_COARSE_STEP;
+    int max_allowed_area = (int)(fb->width * fb->height * MAX_CONTOUR_AREA_RATIO);
+
+    if (acc.hit_count > 0 && area >= s_min_contour_area && area < max_allowed_area)
+    {
+        vision_blob_t blob = {
+            .area = area,
+            .centroid_x = (int)(acc.sum_x / acc.hit_count),
+            .centroid_y = (int)(acc.sum_y / acc.hit_count),
+            .min_x = acc.min_x,
+            .min_y = acc.min_y,
+            .max_x = acc.max_x,
+            .max_y = acc.max_y};
+
+        result->obstacle_detected = true;
+        result->centroid_x = blob.centroid_x;
+        result->centroid_y = blob.centroid_y;
+        result->contour_area = area;
+
+        float measured_cm = estimate_distance_fused(&blob, fb->width, fb->height);
+        if ((int)fb->width != IMAGE_WIDTH)
+        {
+            measured_cm *= (float)fb->width / (float)IMAGE_WIDTH;
+        }
+        result->distance_cm = distance_filter_update(measured_cm,
+                                                     result->capture_time_us);
+        result->closing_speed_cm_s = s_dist_vel_cm_s;
+
+        blobs_publish(&blob, 1);
+    }
+    else
+    {
+        blobs_publish(NULL, 0);
+    }
+
+    uint32_t frame_index =
+        atomic_fetch_add_explicit(&s_frame_counter, 1, memory_order_relaxed) + 1;
+    result->frame_count = frame_index;
+
+    // frame2jpg handles PIXFORMAT_GRAYSCALE, so streaming stays alive
+    if ((frame_index % STREAM_FRAME_INTERVAL) != 0 || !stream_frame_enqueue(fb))
+    {
+        esp_camera_fb_return(fb);
+    }
+
+    result->processing_time_ms = (esp_timer_get_time() - start_time) / 1000;
+    lat_hist_record(&s_hist_process, result->processing_time_ms);
+    return ESP_OK;
+}
+
+/**
+ * @brief Process single frame for green obstacle detection
+ *
+ * Pipeline:
+ * 1. Get RGB565 frame from camera (zero-copy)
+ * 2. Convert RGB565 -> BGR888 -> HSV
+ * 3. Threshold for green color
+ * 4. Morphological filtering (noise removal)
+ * 5. Find contours
+ * 6. Calculate largest object bounding box
+ * 7. Estimate distance
+ *
+ * @param[out] result Detection result structure
+ * @return ESP_OK on success
+ */
+static esp_err_t process_frame(vision_result_t *result)
+{
+    uint64_t start_time = esp_timer_get_time();
+    s_frame_capture_us = start_time;
+
+    // Arm the frame budget before any scanning stage can run
+    s_frame_over_budget = false;
+    s_frame_deadline_us = (int64_t)start_time + VISION_FRAME_BUDGET_MS * 1000;
+
+    // All per-frame scratch below comes from the arena; recycle it
+    // before the first stage runs
+    mem_arena_reset();
+
+    // 1. Capture frame
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb)
+    {
+        ESP_LOGW(TAG, "Camera capture failed");
+        atomic_fetch_add_explicit(&s_capture_failures, 1, memory_order_relaxed);
+        return ESP_FAIL;
+    }
+
+    capture_note_fb(fb);
+
+    ESP_LOGD(TAG, "Frame captured: %dx%d, %zu bytes, format=%d",
+             fb->width, fb->height, fb->len, fb->format);
+
+    // Native-JPEG monitoring profile: nothing to scan. Stream at full
+    // rate (no detection competes for the buffers) and deliberately
+    // publish no result - vision_engine_is_veto_active() falls back to
+    // fail-safe veto once the last real detection goes stale.
+    if (fb->format == PIXFORMAT_JPEG)
+    {
+        atomic_fetch_add_explicit(&s_frame_counter, 1, memory_order_relaxed);
+        if (!stream_frame_enqueue(fb))
+        {
+            esp_camera_fb_return(fb);
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Low-light profile: luminance pre-gate instead of the color pipeline
+    if (fb->format == PIXFORMAT_GRAYSCALE)
+    {
+        return process_frame_gray(fb, result, start_time);
+    }
+
+    // Pin the classifier table for this frame. A runtime threshold
+    // change publishes a new table mid-flight; every probe in this
+    // frame (both cores) keeps using the snapshot taken here.
+    s_lut_frame = atomic_load_explicit(&s_lut_published, memory_order_acquire);
+
+    // Feed a running calibration sweep before detection touches the frame
+    if (s_calib_frames_left > 0)
+    {
+        calib_accumulate((const uint16_t *)fb->buf, fb->width, fb->height);
+    }
+
+    // Initialize result
+    result->obstacle_detected = false;
+    result->distance_cm = 999.9f;
+    result->closing_speed_cm_s = 0.0f;
+    result->centroid_x = 0;
+    result->centroid_y = 0;
+    result->contour_area = 0;
+    result->capture_time_us = (int64_t)start_time;
+
+    const uint16_t *pixels = (const uint16_t *)fb->buf;
+    scan_accum_t acc;
+    // Cleared up front: the budget-overrun evidence check below reads
+    // hit_count even on paths that never run the strided pass
+    scan_accum_reset(&acc, fb->width, fb->height);
+    vision_blob_t blobs[VISION_MAX_BLOBS];
+    int blob_count = -1; // <0: no window labeled yet this frame
+
+    // Ambient light bookkeeping for the low-light AUTO profile
+    ambient_luma_update(fb);
+    low_light_auto_evaluate();
+
+    // Motion gate: only consulted while not tracking an obstacle, so a
+    // static scene never delays veto updates - just idle rescans
+    if (!s_track_active && motion_gate_should_skip(pixels, fb->width, fb->height))
+    {
+        result_snapshot(result, NULL); // Re-publish the previous detection
+
+        // The motion probes just re-validated the old detection against
+        // this frame, so the decision is as fresh as this capture
+        result->capture_time_us = (int64_t)start_time;
+
+        uint32_t frame_index =
+            atomic_fetch_add_explicit(&s_frame_counter, 1, memory_order_relaxed) + 1;
+        result->frame_count = frame_index;
+
+        if ((frame_index % STREAM_FRAME_INTERVAL) != 0 || !stream_frame_enqueue(fb))
+        {
+            esp_camera_fb_return(fb);
+        }
+
+        result->processing_time_ms = (esp_timer_get_time() - start_time) / 1000;
+        lat_hist_record(&s_hist_process, result->processing_time_ms);
+        return ESP_OK;
+    }
+
+    // Zones start empty each frame; a labeling pass below overwrites
+    // them, a frame with no hits publishes the zeros
+    zone_accum_reset(fb->width);
+
+    if (s_track_active)
+    {
+        // Tracking mode: label only the window around the last bbox
+        int x0 = s_track_min_x - TRACK_WINDOW_MARGIN;
+        int y0 = s_track_min_y - TRACK_WINDOW_MARGIN;
+        int x1 = s_track_max_x + TRACK_WINDOW_MARGIN + 1;
+        int y1 = s_track_max_y + TRACK_WINDOW_MARGIN + 1;
+
+        if (x0 < 0)
+            x0 = 0;
+        if (y0 < 0)
+            y0 = 0;
+        if (x1 > fb->width)
+            x1 = fb->width;
+        if (y1 > fb->height)
+            y1 = fb->height;
+
+        blob_count = label_region(pixels, fb->width, x0, y0, x1, y1,
+                                  blobs, VISION_MAX_BLOBS);
+
+        if (blob_count > 0)
+        {
+            s_track_misses = 0;
+        }
+        else if (++s_track_misses >= TRACK_MAX_MISSES)
+        {
+            ESP_LOGD(TAG, "Track lost after %d misses - full-frame rescan", s_track_misses);
+            s_track_active = false;
+            blob_count = -1;
+        }
+        // else: keep the empty window for a few frames before giving up
+    }
+
+    if (blob_count < 0)
+    {
+        // Pass 1: strided scan of the whole frame to locate candidate
+        // regions, clamped to the drive corridor when enabled. The flag
+        // only stays up for this pass: refine and tracking label boxes
+        // seeded by corridor hits anyway.
+        s_corridor_frame_active = corridor_prepare(fb->width, fb->height);
+        scan_accum_reset(&acc, fb->width, fb->height);
+        scan_region_parallel(pixels, fb->width, 0, 0, fb->width, fb->height,
+                             SCAN_COARSE_STEP, &acc);
+        s_corridor_frame_active = false;
+
+        blob_count = 0;
+
+        if (acc.hit_count > 0)
+        {
+            // Pass 2: label only inside the (expanded) candidate box.
+            // The margin covers pixels the strided pass stepped over.
+            int x0 = acc.min_x - SCAN_REFINE_MARGIN;
+            int y0 = acc.min_y - SCAN_REFINE_MARGIN;
+            int x1 = acc.max_x + SCAN_REFINE_MARGIN + 1;
+            int y1 = acc.max_y + SCAN_REFINE_MARGIN + 1;
+
+            if (x0 < 0)
+                x0 = 0;
+            if (y0 < 0)
+                y0 = 0;
+            if (x1 > fb->width)
+                x1 = fb->width;
+            if (y1 > fb->height)
+                y1 = fb->height;
+
+            blob_count = label_region(pixels, fb->width, x0, y0, x1, y1,
+                                      blobs, VISION_MAX_BLOBS);
+        }
+    }
+
+    blobs_publish(blobs, blob_count);
+
+    // Pinhole corrections shared by the best-blob distance and the
+    // per-zone figures below
+    float dist_scale = 1.0f;
+    if ((int)fb->width != IMAGE_WIDTH)
+    {
+        // Focal length is calibrated in QVGA pixels; a QQVGA pixel
+        // width is half as many pixels for the same object
+        dist_scale *= (float)fb->width / (float)IMAGE_WIDTH;
+    }
+    if (s_sensor_window_active)
+    {
+        // Windowing doubles the effective focal length, so the
+        // pinhole estimate reads half the true distance
+        dist_scale *= SENSOR_WINDOW_ZOOM;
+    }
+
+    // Publish the zone accumulators from the labeling pass; each third
+    // carries the distance of the closest blob whose box touches it
+    for (int z = 0; z < VISION_ZONE_COUNT; z++)
+    {
+        result->zones[z].hit_count = s_zone_hits[z];
+        result->zones[z].min_distance_cm = 999.9f;
+    }
+    for (int i = 0; i < blob_count; i++)
+    {
+        float blob_cm = estimate_distance_fused(&blobs[i], fb->width, fb->height) *
+                        dist_scale;
+
+        if (blobs[i].min_x < s_zone_x1 &&
+            blob_cm < result->zones[VISION_ZONE_LEFT].min_distance_cm)
+        {
+            result->zones[VISION_ZONE_LEFT].min_distance_cm = blob_cm;
+        }
+        if (blobs[i].max_x >= s_zone_x1 && blobs[i].min_x < s_zone_x2 &&
+            blob_cm < result->zones[VISION_ZONE_CENTER].min_distance_cm)
+        {
+            result->zones[VISION_ZONE_CENTER].min_distance_cm = blob_cm;
+        }
+        if (blobs[i].max_x >= s_zone_x2 &&
+            blob_cm < result->zones[VISION_ZONE_RIGHT].min_distance_cm)
+        {
+            result->zones[VISION_ZONE_RIGHT].min_distance_cm = blob_cm;
+        }
+    }
+
+    const int image_area = fb->width * fb->height;
+    // A zoomed-in obstacle filling the window is expected at close
+    // range, so the flood-guard cap relaxes while the sensor is windowed
+    const float max_area_ratio = s_sensor_window_active ? 0.9f : MAX_CONTOUR_AREA_RATIO;
+    const int max_allowed_area = (int)(image_area * max_area_ratio);
+    const vision_blob_t *best = (blob_count > 0) ? &blobs[0] : NULL;
+
+    if (best && best->area >= s_min_contour_area && best->area < max_allowed_area)
+    {
+        result->obstacle_detected = true;
+        result->centroid_x = best->centroid_x;
+        result->centroid_y = best->centroid_y;
+        result->contour_area = best->area;
+
+        float measured_cm = estimate_distance_fused(best, fb->width, fb->height) *
+                            dist_scale;
+
+        result->distance_cm = distance_filter_update(measured_cm,
+                                                     result->capture_time_us);
+        result->closing_speed_cm_s = s_dist_vel_cm_s;
+
+        // Lock the tracking window onto the fresh bounding box
+        s_track_active = true;
+        s_track_misses = 0;
+        s_track_min_x = best->min_x;
+        s_track_max_x = best->max_x;
+        s_track_min_y = best->min_y;
+        s_track_max_y = best->max_y;
+
+        // Same box drives the region-weighted encoder stage on Core 0
+        stream_roi_publish(best->min_x, best->min_y, best->max_x, best->max_y);
+
+        // Sensor-level ROI: window onto a stably tracked obstacle,
+        // recenter once it drifts from the middle of the zoomed frame
+        s_track_stable_frames++;
+        if (s_sensor_window_enabled && !s_cap_fast_detect && !s_sensor_window_active &&
+            s_track_stable_frames >= SENSOR_WINDOW_LOCK_FRAMES)
+        {
+            sensor_window_apply(best->centroid_x, best->centroid_y);
+        }
+        else if (s_sensor_window_active)
+        {
+            int drift_x = best->centroid_x - IMAGE_WIDTH / 2;
+            int drift_y = best->centroid_y - IMAGE_HEIGHT / 2;
+
+            if (abs(drift_x) > SENSOR_WINDOW_RECENTER_PX ||
+                abs(drift_y) > SENSOR_WINDOW_RECENTER_PX)
+            {
+                // Map the drift back to full-FOV coordinates
+                sensor_window_apply(s_sensor_window_cx + drift_x / SENSOR_WINDOW_ZOOM,
+                                    s_sensor_window_cy + drift_y / SENSOR_WINDOW_ZOOM);
+            }
+        }
+
+        if (!s_sensor_window_enabled && s_sensor_window_active)
+        {
+            sensor_window_restore(); // Disabled at runtime via the API
+        }
+
+        if (s_debug_enabled)
+        {
+            debug_event_push(result->distance_cm,
+                             result->centroid_x, result->centroid_y,
+                             result->contour_area);
+        }
+    }
+    else
+    {
+        result->obstacle_detected = false;
+        result->distance_cm = 999.9f;
+        stream_roi_clear();
+
+        // Back to the full scene before the next rescan
+        s_track_stable_frames = 0;
+        if (s_sensor_window_active)
+        {
+            sensor_window_restore();
+        }
+    }
+
+    // Budget overrun: the passes above were cut short, so everything
+    // computed from them is partial. Fail toward the veto - qualifying
+    // evidence seen before the deadline publishes as an obstacle at
+    // zero distance, asserting the veto until a complete frame clears
+    // it. Pure background that somehow overran publishes empty, same
+    // as a complete empty frame.
+    if (s_frame_over_budget)
+    {
+        atomic_fetch_add_explicit(&s_budget_overruns, 1, memory_order_relaxed);
+
+        if (acc.hit_count > 0 || blob_count > 0)
+        {
+            result->obstacle_detected = true;
+            result->distance_cm = 0.0f;
+            result->closing_speed_cm_s = 0.0f;
+            if (result->contour_area == 0 && blob_count > 0)
+            {
+                result->centroid_x = blobs[0].centroid_x;
+                result->centroid_y = blobs[0].centroid_y;
+                result->contour_area = blobs[0].area;
+            }
+        }
+
+        static int64_t s_last_overrun_log_us = 0;
+        if ((int64_t)start_time - s_last_overrun_log_us > 5 * 1000000)
+        {
+            s_last_overrun_log_us = (int64_t)start_time;
+            ESP_LOGW(TAG, "Frame budget overrun (%d ms) - partial result, %s",
+                     VISION_FRAME_BUDGET_MS,
+                     result->obstacle_detected ? "veto asserted" : "no evidence");
+        }
+    }
+
+    uint32_t frame_index =
+        atomic_fetch_add_explicit(&s_frame_counter, 1, memory_order_relaxed) + 1;
+    result->frame_count = frame_index;
+
+    // Offline-tuning capture: copies into PSRAM staging and returns,
+    // or skips the frame when the flash writer is behind
+    dataset_capture_submit(fb, result);
+
+    // Hand the frame to the Core 0 encoder stage, or return it directly
+    if ((frame_index % STREAM_FRAME_INTERVAL) != 0 || !stream_frame_enqueue(fb))
+    {
+        esp_camera_fb_return(fb);
+    }
+
+    // Calculate processing time
+    uint64_t end_time = esp_timer_get_time();
+    result->processing_time_ms = (end_time - start_time) / 1000;
+    lat_hist_record(&s_hist_process, result->processing_time_ms);
+    if (result->frame_count == 0)
+    {
+        result->frame_count =
+            atomic_fetch_add_explicit(&s_frame_counter, 1, memory_order_relaxed) + 1;
+    }
+
+    ESP_LOGD(TAG, "Frame processed in %u ms", result->processing_time_ms);
+
+    return ESP_OK;
+}
+
+// ============================================================================
+// DYNAMIC FREQUENCY SCALING
+// ============================================================================
+
+// The pipeline is what decides how fast the chip needs to be, so the PM
+// locks live here. The CPU lock pins 240 MHz while a frame is being
+// scanned or encoded and is dropped for the sleeps in between, letting
+// DFS fall back to 80 MHz (APB stays at 80 either way, so XCLK and the
+// capture DMA never notice). The wake lock blocks automatic light sleep
+// while the pipeline is active; the FPS governor drops it when it
+// enters its parked-quiet state, and from then on the chip sleeps
+// through the idle gaps. A light-sleep entry can tear the frame the
+// free-running sensor was mid-way through - the driver discards it on
+// verify and at the parked rate the loss is irrelevant.
+// (s_pm_cpu_lock is declared next to the stream stage that shares it.)
+static esp_pm_lock_handle_t s_pm_wake_lock = NULL;
+static bool s_pm_wake_held = false;
+
+/**
+ * @brief Create the PM locks; without CONFIG_PM_ENABLE this is a no-op
+ */
+static void pm_locks_init(void)
+{
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "vision_cpu",
+                           &s_pm_cpu_lock) != ESP_OK)
+    {
+        s_pm_cpu_lock = NULL;
+        return;
+    }
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "vision_awake",
+                           &s_pm_wake_lock) != ESP_OK)
+    {
+        s_pm_wake_lock = NULL;
+        return;
+    }
+
+    // Born active: the pipeline starts hot and the governor decides
+    // when the vehicle has actually parked
+    esp_pm_lock_acquire(s_pm_wake_lock);
+    s_pm_wake_held = true;
+}
+
+/**
+ * @brief Track the governor's parked state with the wake lock
+ *
+ * Runs on the vision task only, so the held flag needs no locking.
+ */
+static void pm_parked_update(bool parked)
+{
+    if (s_pm_wake_lock == NULL)
+    {
+        return;
+    }
+
+    if (parked && s_pm_wake_held)
+    {
+        esp_pm_lock_release(s_pm_wake_lock);
+        s_pm_wake_held = false;
+    }
+    else if (!parked && !s_pm_wake_held)
+    {
+        esp_pm_lock_acquire(s_pm_wake_lock);
+        s_pm_wake_held = true;
+    }
+}
+
+// ============================================================================
+// ADAPTIVE FPS GOVERNOR
+// ============================================================================
+
+/**
+ * The old fixed 100ms frame period wasted power and PSRAM bandwidth
+ * while parked and capped approach maneuvers at 10 FPS even when a
+ * frame took 30ms. The governor picks the next period per frame: while
+ * the vehicle is moving, an obstacle is in view or veto is active, it
+ * tracks measured processing time plus a small margin (clamped to the
+ * configured floor); once everything has been quiet for a couple of
+ * seconds it falls back to the ceiling period. Floor and ceiling are
+ * runtime-adjustable through vision_engine_set_fps_range().
+ */
+
+#define GOVERNOR_PERIOD_FLOOR_MS_DEFAULT 40 // Fast bound (25 FPS)
+#define GOVERNOR_PERIOD_CEIL_MS_DEFAULT 250 // Parked idle bound (4 FPS)
+#define GOVERNOR_BUSY_MARGIN_MS 5           // Headroom over measured frame cost
+#define GOVERNOR_IDLE_FRAMES 20             // Quiet frames before slowing down
+
+static uint32_t s_gov_period_floor_ms = GOVERNOR_PERIOD_FLOOR_MS_DEFAULT;
+static uint32_t s_gov_period_ceil_ms = GOVERNOR_PERIOD_CEIL_MS_DEFAULT;
+static int s_gov_idle_frames = 0;
+
+/**
+ * @brief Pick the delay until the next frame capture
+ */
+static TickType_t governor_next_period(const vision_result_t *result, bool veto)
+{
+    int left_speed = 0;
+    int right_speed = 0;
+    motor_get_speeds(&left_speed, &right_speed);
+
+    bool active = veto || result->obstacle_detected ||
+                  left_speed != 0 || right_speed != 0;
+
+    if (active)
+    {
+        s_gov_idle_frames = 0;
+    }
+    else if (s_gov_idle_frames < GOVERNOR_IDLE_FRAMES)
+    {
+        s_gov_idle_frames++;
+    }
+
+    // Parked-and-quiet doubles as the light-sleep gate (see the DFS
+    // section above)
+    bool parked = s_gov_idle_frames >= GOVERNOR_IDLE_FRAMES;
+    pm_parked_update(parked);
+
+    if (parked)
+    {
+        return pdMS_TO_TICKS(s_gov_period_ceil_ms); // Parked and quiet
+    }
+
+    uint32_t period_ms = result->processing_time_ms + GOVERNOR_BUSY_MARGIN_MS;
+    if (period_ms < s_gov_period_floor_ms)
+    {
+        period_ms = s_gov_period_floor_ms;
+    }
+    if (period_ms > s_gov_period_ceil_ms)
+    {
+        period_ms = s_gov_period_ceil_ms;
+    }
+
+    return pdMS_TO_TICKS(period_ms);
+}
+
+// ============================================================================
+// VETO HYSTERESIS
+// ============================================================================
+// A single noisy frame used to flip s_veto_active: one false positive
+// stutter-stopped the vehicle, one missed frame released the veto right
+// next to the obstacle. Per-frame raw decisions now feed a small ring
+// buffer and the published veto only asserts after N consecutive hits
+// and only releases after M consecutive misses.
+
+#define VETO_PREDICT_HORIZON_S 0.2f    // Lookahead for the predictive veto
+#define VETO_HISTORY_SIZE 8            // Ring capacity (>= max threshold)
+#define VETO_ASSERT_FRAMES_DEFAULT 2   // Consecutive hits to assert
+#define VETO_RELEASE_FRAMES_DEFAULT 4  // Consecutive misses to release
+
+static bool s_veto_history[VETO_HISTORY_SIZE];
+static int s_veto_history_head = 0;   // Next write slot
+static int s_veto_history_count = 0;  // Valid samples in the ring
+static bool s_veto_smoothed = false;  // Hysteresis output state
+static int s_veto_assert_frames = VETO_ASSERT_FRAMES_DEFAULT;
+static int s_veto_release_frames = VETO_RELEASE_FRAMES_DEFAULT;
+
+static void veto_hysteresis_reset(void)
+{
+    s_veto_history_head = 0;
+    s_veto_history_count = 0;
+    s_veto_smoothed = false;
+}
+
+/**
+ * @brief Push one raw per-frame veto decision and return the smoothed state
+ *
+ * Asymmetric on purpose: asserting is fast (safety) while releasing is
+ * slow (stability). Only called from the vision task, so no locking.
+ */
+static bool veto_hysteresis_update(bool raw_hit)
+{
+    s_veto_history[s_veto_history_head] = raw_hit;
+    s_veto_history_head = (s_veto_history_head + 1) % VETO_HISTORY_SIZE;
+    if (s_veto_history_count < VETO_HISTORY_SIZE)
+    {
+        s_veto_history_count++;
+    }
+
+    // Count the run of identical samples ending at the newest one
+    int run = 0;
+    for (int i = 0; i < s_veto_history_count; i++)
+    {
+        int idx = (s_veto_history_head - 1 - i + VETO_HISTORY_SIZE) % VETO_HISTORY_SIZE;
+        if (s_veto_history[idx] != raw_hit)
+        {
+            break;
+        }
+        run++;
+    }
+
+    if (raw_hit && !s_veto_smoothed && run >= s_veto_assert_frames)
+    {
+        s_veto_smoothed = true;
+    }
+    else if (!raw_hit && s_veto_smoothed && run >= s_veto_release_frames)
+    {
+        s_veto_smoothed = false;
+    }
+
+    return s_veto_smoothed;
+}
+
+// ============================================================================
+// VISION PROCESSING TASK
+// ============================================================================
+
+/**
+ * @brief Main vision processing task (runs on Core 1)
+ */
+static void vision_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Vision task started on core %d", xPortGetCoreID());
+
+    vision_result_t result;
+    TickType_t frame_period = pdMS_TO_TICKS(s_gov_period_floor_ms);
+
+    while (s_task_running)
+    {
+        // Apply a dashboard-requested capture profile between frames
+        if (s_cap_reinit_pending)
+        {
+            capture_tuning_apply();
+        }
+        else if (s_cap_resize_pending)
+        {
+            capture_fast_resize(); // SCCB-only, no driver recycle
+        }
+
+        // AEC/AWB lock changes and the AWB settle window also run
+        // between frames - SCCB traffic mid-capture is not safe
+        aeawb_frame_hook();
+
+        // Process frame at full clock; the lock also covers the
+        // blocking fb_get inside, which at the floor rate is what paces
+        // the loop
+        if (s_pm_cpu_lock)
+        {
+            esp_pm_lock_acquire(s_pm_cpu_lock);
+        }
+        TRACE_REGION_ENTER(TRACE_ID_VISION_FRAME);
+        if (process_frame(&result) == ESP_OK)
+        {
+            // Veto on where the obstacle will be shortly, not only on
+            // where it was: at closing speed v the distance one horizon
+            // ahead is d + v*h (v negative while approaching), which
+            // brakes earlier from the same 10 FPS input
+            float predicted_cm = result.distance_cm +
+                                 result.closing_speed_cm_s * VETO_PREDICT_HORIZON_S;
+            bool raw_veto = (result.obstacle_detected &&
+                             (result.distance_cm < VETO_DISTANCE_THRESHOLD_CM ||
+                              predicted_cm < VETO_DISTANCE_THRESHOLD_CM));
+            bool veto = veto_hysteresis_update(raw_veto);
+
+            // Publish shared state (lock-free, never blocks)
+            result_publish(&result, veto);
+
+            // Veto budget is judged on capture-to-publish tail latency
+            lat_hist_record(&s_hist_publish,
+                            (uint32_t)((esp_timer_get_time() - s_frame_capture_us) / 1000));
+
+            // Timeline breadcrumb for trace_dump correlation
+            trace_log_push(TRACE_EV_FRAME_DONE,
+                           result.obstacle_detected ? 1 : 0,
+                           (int32_t)result.processing_time_ms);
+            blackbox_record(BB_REC_VISION, result.obstacle_detected ? 1 : 0,
+                            (int32_t)(result.distance_cm * 10.0f),
+                            (int32_t)result.processing_time_ms);
+
+            if (veto && s_debug_enabled)
+            {
+                ESP_LOGW(TAG, "VETO ACTIVE: Obstacle at %.1f cm (threshold %.1f cm)",
+                         result.distance_cm, VETO_DISTANCE_THRESHOLD_CM);
+            }
+
+            // Update statistics (odd seq = accumulator mid-update)
+            atomic_fetch_add_explicit(&s_stats_seq, 1, memory_order_release);
+            s_total_process_time_us += result.processing_time_ms * 1000;
+            atomic_fetch_add_explicit(&s_stats_seq, 1, memory_order_release);
+
+            // Adapt capture rate to load and vehicle state
+            frame_period = governor_next_period(&result, veto);
+
+            // And capture resolution to what the scene contains
+            adaptive_res_update(&result);
+        }
+        TRACE_REGION_EXIT(TRACE_ID_VISION_FRAME);
+        if (s_pm_cpu_lock)
+        {
+            esp_pm_lock_release(s_pm_cpu_lock);
+        }
+
+        // Pacing: at full rate the camera itself clocks the loop -
+        // esp_camera_fb_get() blocks on the driver's frame queue and
+        // wakes this task exactly when a buffer completes, so there is
+        // no software timer beating against the sensor's frame clock
+        // (the old vTaskDelayUntil added up to a frame period of
+        // sampling skew). Only the governor's idle throttle beyond the
+        // floor rate is slept here; GRAB_LATEST guarantees the frame
+        // after the sleep is still the newest one.
+        TickType_t floor_ticks = pdMS_TO_TICKS(s_gov_period_floor_ms);
+        if (frame_period > floor_ticks)
+        {
+            // The wake semaphore lets a stop request cut this short
+            xSemaphoreTake(s_vision_wake_sem, frame_period - floor_ticks);
+        }
     }
 
     ESP_LOGI(TAG, "Vision task stopped");
+    xSemaphoreGive(s_vision_exit_sem);
     vTaskDelete(NULL);
 }
 
@@ -483,13 +4361,43 @@ esp_err_t vision_engine_init(void)
 {
     ESP_LOGI(TAG, "Initializing vision engine...");
 
-    // Create mutex for thread-safe access
-    s_result_mutex = xSemaphoreCreateMutex();
-    if (s_result_mutex == NULL)
+    // A past calibration sweep overrides the compile-time defaults
+    calib_load(&s_green_range);
+
+    // The default-threshold table was generated at build time into
+    // rodata and is already published; only a calibrated override pays
+    // the runtime build before the task starts scanning
+    if (!hsv_range_equal(&s_green_range, &s_green_range_defaults))
+    {
+        classifier_lut_build(&s_green_range);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Classifier LUT: build-time table active (default thresholds)");
+    }
+
+    // Per-frame scratch arena: sized for the packed mask plus headroom
+    // for the stages still to come; detection cannot run without it
+    esp_err_t arena_ret = mem_arena_init(12 * 1024, 16 * 1024);
+    if (arena_ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to create result mutex");
+        return arena_ret;
+    }
+
+#ifdef CONFIG_VISION_VERIFY_IRAM_PLACEMENT
+    // The IRAM_ATTR kernels silently fall back to flash if the IRAM
+    // budget overflows; catch that at boot instead of in frame timings
+    if (!esp_ptr_in_iram((const void *)&scan_region) ||
+        !esp_ptr_in_iram((const void *)&mask_build_region))
+    {
+        ESP_LOGE(TAG, "Scan kernels not placed in IRAM - check IRAM budget");
         return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "IRAM placement of scan kernels verified");
+#endif
+
+    // DFS locks for the pipeline; a no-op build without CONFIG_PM_ENABLE
+    pm_locks_init();
 
     // Initialize camera
     esp_err_t ret = init_camera();
@@ -498,6 +4406,10 @@ esp_err_t vision_engine_init(void)
         return ret;
     }
 
+    // A persisted AEC/AWB lock re-freezes the sensor init just reset
+    aeawb_nvs_load();
+    aeawb_reapply_after_reinit();
+
     ESP_LOGI(TAG, "Vision engine initialized successfully");
     return ESP_OK;
 }
@@ -510,23 +4422,87 @@ esp_err_t vision_engine_start(void)
         return ESP_OK;
     }
 
+    // Stop/join plumbing, created once; drain a stale give left by a
+    // previous cycle so the next join cannot complete early
+    if (s_vision_exit_sem == NULL)
+    {
+        s_vision_exit_sem = xSemaphoreCreateBinaryStatic(&s_vision_exit_sem_buf);
+        s_stream_exit_sem = xSemaphoreCreateBinaryStatic(&s_stream_exit_sem_buf);
+        s_vision_wake_sem = xSemaphoreCreateBinaryStatic(&s_vision_wake_sem_buf);
+    }
+    xSemaphoreTake(s_vision_exit_sem, 0);
+    xSemaphoreTake(s_stream_exit_sem, 0);
+    xSemaphoreTake(s_vision_wake_sem, 0);
+
     s_task_running = true;
+    veto_hysteresis_reset();
+
+    // Scan worker on Core 0 takes half of each frame scan. Priority sits
+    // below the WiFi/LwIP tasks so networking is never starved.
+    s_scan_worker_handle = xTaskCreateStaticPinnedToCore(
+        scan_worker_task,
+        "scan_worker",
+        SCAN_WORKER_STACK_SIZE,
+        NULL,
+        5,
+        s_scan_worker_stack,
+        &s_scan_worker_tcb,
+        0 // Core 0 (Protocol CPU)
+    );
+
+    if (s_scan_worker_handle == NULL)
+    {
+        ESP_LOGW(TAG, "Scan worker creation failed - falling back to single-core scan");
+    }
+
+    // Encoder/sender stage on Core 0. Lower priority than the scan
+    // worker: JPEG compression must never delay a half-frame scan.
+    s_stream_queue = xQueueCreateStatic(STREAM_QUEUE_DEPTH, sizeof(camera_fb_t *),
+                                        s_stream_queue_storage,
+                                        &s_stream_queue_buf);
+
+    if (s_stream_queue != NULL)
+    {
+        s_stream_task_handle = xTaskCreateStaticPinnedToCore(
+            stream_task,
+            "stream_task",
+            STREAM_TASK_STACK_SIZE,
+            NULL,
+            4,
+            s_stream_task_stack,
+            &s_stream_task_tcb,
+            0 // Core 0 (Protocol CPU)
+        );
+
+        if (s_stream_task_handle == NULL)
+        {
+            ESP_LOGW(TAG, "Stream task creation failed - streaming disabled");
+            vQueueDelete(s_stream_queue);
+            s_stream_queue = NULL;
+        }
+    }
 
     // Create vision processing task on Core 1 (Application CPU)
-    BaseType_t ret = xTaskCreatePinnedToCore(
+    s_vision_task_handle = xTaskCreateStaticPinnedToCore(
         vision_task,
         "vision_task",
-        8192, // Stack size (8KB - OpenCV needs substantial stack)
+        VISION_TASK_STACK_SIZE,
         NULL,
         6, // High priority (same as control task)
-        &s_vision_task_handle,
+        s_vision_task_stack,
+        &s_vision_task_tcb,
         1 // Core 1 (Application CPU)
     );
 
-    if (ret != pdPASS)
+    if (s_vision_task_handle == NULL)
     {
         ESP_LOGE(TAG, "Failed to create vision task");
         s_task_running = false;
+        if (s_scan_worker_handle)
+        {
+            vTaskDelete(s_scan_worker_handle);
+            s_scan_worker_handle = NULL;
+        }
         return ESP_FAIL;
     }
 
@@ -536,20 +4512,71 @@ esp_err_t vision_engine_start(void)
 
 esp_err_t vision_engine_stop(void)
 {
-    if (!s_task_running)
+    // Handle still set with the flag clear means a previous stop timed
+    // out waiting for the join; retry it instead of declaring success
+    if (!s_task_running && s_vision_task_handle == NULL)
     {
         return ESP_OK;
     }
 
     s_task_running = false;
 
-    // Wait for task to terminate
+    // Bounded join: the wake semaphore cuts a governor throttle sleep
+    // short, then the task acknowledges its exit. The timeout covers a
+    // couple of frame periods inside fb_get at the floor rate.
     if (s_vision_task_handle)
     {
-        vTaskDelay(pdMS_TO_TICKS(200)); // Give task time to exit
+        xSemaphoreGive(s_vision_wake_sem);
+        if (xSemaphoreTake(s_vision_exit_sem,
+                           pdMS_TO_TICKS(VISION_STOP_JOIN_TIMEOUT_MS)) != pdTRUE)
+        {
+            // Stuck inside the driver: deleting it there would leak the
+            // frame buffer, so leave it to exit on its own and let the
+            // caller retry
+            ESP_LOGE(TAG, "Vision task did not acknowledge stop in %d ms",
+                     VISION_STOP_JOIN_TIMEOUT_MS);
+            return ESP_ERR_TIMEOUT;
+        }
         s_vision_task_handle = NULL;
     }
 
+    // Worker is only ever woken by the vision task, so it is idle by now
+    if (s_scan_worker_handle)
+    {
+        vTaskDelete(s_scan_worker_handle);
+        s_scan_worker_handle = NULL;
+    }
+
+    // Join the encoder stage: a NULL sentinel wakes it out of its queue
+    // wait immediately, the ack covers an in-flight encode. Only after
+    // the timeout (WS send wedged) is it deleted the old way.
+    if (s_stream_task_handle)
+    {
+        camera_fb_t *sentinel = NULL;
+        xQueueSend(s_stream_queue, &sentinel, 0);
+        if (xSemaphoreTake(s_stream_exit_sem,
+                           pdMS_TO_TICKS(VISION_STOP_JOIN_TIMEOUT_MS)) != pdTRUE)
+        {
+            ESP_LOGW(TAG, "Stream task did not acknowledge stop, deleting it");
+            vTaskDelete(s_stream_task_handle);
+        }
+        s_stream_task_handle = NULL;
+    }
+
+    if (s_stream_queue)
+    {
+        camera_fb_t *fb = NULL;
+        while (xQueueReceive(s_stream_queue, &fb, 0) == pdTRUE)
+        {
+            if (fb)
+            {
+                esp_camera_fb_return(fb);
+            }
+        }
+        vQueueDelete(s_stream_queue);
+        s_stream_queue = NULL;
+    }
+
     ESP_LOGI(TAG, "Vision processing stopped");
     return ESP_OK;
 }
@@ -561,29 +4588,75 @@ esp_err_t vision_engine_get_result(vision_result_t *result)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xSemaphoreTake(s_result_mutex, pdMS_TO_TICKS(100)))
-    {
-        memcpy(result, &s_last_result, sizeof(vision_result_t));
-        xSemaphoreGive(s_result_mutex);
-        return ESP_OK;
-    }
-
-    return ESP_ERR_TIMEOUT;
+    result_snapshot(result, NULL);
+    return ESP_OK;
 }
 
+// A result older than this means the vision pipeline stopped
+// publishing (4x the governor ceiling period)
+#define VISION_RESULT_STALE_US (1000 * 1000)
+
 bool vision_engine_is_veto_active(void)
 {
+    vision_result_t result;
     bool veto = false;
 
-    if (xSemaphoreTake(s_result_mutex, pdMS_TO_TICKS(10)))
+    result_snapshot(&result, &veto);
+
+    if (result.capture_time_us > 0 &&
+        (esp_timer_get_time() - result.capture_time_us) > VISION_RESULT_STALE_US)
     {
-        veto = s_veto_active;
-        xSemaphoreGive(s_result_mutex);
+        // Fail safe: a dead vision pipeline must not silently release
+        // the veto. Rate-limit the warning to once per second.
+        static int64_t s_last_stale_log_us = 0;
+        int64_t now = esp_timer_get_time();
+        if (now - s_last_stale_log_us > 1000 * 1000)
+        {
+            s_last_stale_log_us = now;
+            ESP_LOGW(TAG, "Vision result stale (%lld ms old) - forcing veto",
+                     (long long)((now - result.capture_time_us) / 1000));
+        }
+        return true;
     }
 
     return veto;
 }
 
+int vision_engine_get_blobs(vision_blob_t *blobs, int max_blobs)
+{
+    if (blobs == NULL || max_blobs <= 0)
+    {
+        return 0;
+    }
+
+    uint_fast32_t seq1, seq2;
+    vision_blob_t copy[VISION_MAX_BLOBS];
+    int count;
+
+    do
+    {
+        seq1 = atomic_load_explicit(&s_blob_seq, memory_order_acquire);
+        if (seq1 & 1)
+        {
+            continue;
+        }
+
+        count = s_pub_blob_count;
+        memcpy(copy, s_pub_blobs, sizeof(copy));
+
+        atomic_thread_fence(memory_order_acquire);
+        seq2 = atomic_load_explicit(&s_blob_seq, memory_order_relaxed);
+    } while (seq1 != seq2);
+
+    if (count > max_blobs)
+    {
+        count = max_blobs;
+    }
+
+    memcpy(blobs, copy, (size_t)count * sizeof(vision_blob_t));
+    return count;
+}
+
 camera_fb_t *vision_engine_get_frame(void)
 {
     return esp_camera_fb_get();
@@ -591,15 +4664,379 @@ camera_fb_t *vision_engine_get_frame(void)
 
 void vision_engine_get_stats(float *avg_fps, float *avg_process_time_ms)
 {
+    uint32_t frames;
+    uint64_t total_us;
+    uint32_t seq1, seq2;
+
+    // Seqlock read: retry if the vision task updated the accumulator
+    // mid-copy, so the (frames, total) pair is always consistent
+    do
+    {
+        seq1 = atomic_load_explicit(&s_stats_seq, memory_order_acquire);
+        frames = atomic_load_explicit(&s_frame_counter, memory_order_relaxed);
+        total_us = s_total_process_time_us;
+        atomic_thread_fence(memory_order_acquire);
+        seq2 = atomic_load_explicit(&s_stats_seq, memory_order_relaxed);
+    } while (seq1 != seq2 || (seq1 & 1));
+
     if (avg_fps)
     {
-        *avg_fps = (s_frame_counter > 0) ? (s_frame_counter / (esp_timer_get_time() / 1000000.0f)) : 0.0f;
+        *avg_fps = (frames > 0) ? (frames / (esp_timer_get_time() / 1000000.0f)) : 0.0f;
     }
 
     if (avg_process_time_ms)
     {
-        *avg_process_time_ms = (s_frame_counter > 0) ? (s_total_process_time_us / (float)s_frame_counter / 1000.0f) : 0.0f;
+        *avg_process_time_ms = (frames > 0) ? (total_us / (float)frames / 1000.0f) : 0.0f;
+    }
+}
+
+void vision_engine_get_counters(vision_counters_t *counters)
+{
+    if (!counters)
+    {
+        return;
+    }
+
+    counters->frames_processed =
+        atomic_load_explicit(&s_frame_counter, memory_order_relaxed);
+    counters->capture_failures =
+        atomic_load_explicit(&s_capture_failures, memory_order_relaxed);
+    counters->motion_skips =
+        atomic_load_explicit(&s_motion_skips, memory_order_relaxed);
+    counters->stream_sent =
+        atomic_load_explicit(&s_stream_sent, memory_order_relaxed);
+    counters->stream_dropped =
+        atomic_load_explicit(&s_stream_dropped, memory_order_relaxed);
+    counters->budget_overruns =
+        atomic_load_explicit(&s_budget_overruns, memory_order_relaxed);
+}
+
+void vision_engine_set_delta_stream(bool enable)
+{
+    s_delta_enabled = enable;
+    s_tile_hash_valid = false; // Next streamed frame goes out as a keyframe
+    ESP_LOGI(TAG, "Delta streaming %s", enable ? "ENABLED" : "DISABLED");
+}
+
+void vision_engine_set_roi_quality(bool enable)
+{
+    s_roi_quality_enabled = enable;
+    ESP_LOGI(TAG, "Region-weighted stream quality %s",
+             enable ? "ENABLED" : "DISABLED");
+}
+
+esp_err_t vision_engine_start_calibration(void)
+{
+    if (s_calib_frames_left > 0)
+    {
+        return ESP_ERR_INVALID_STATE; // Sweep already running
+    }
+
+    if (!s_task_running)
+    {
+        return ESP_ERR_INVALID_STATE; // Nobody to feed it frames
+    }
+
+    memset(s_calib_hist, 0, sizeof(s_calib_hist));
+    s_calib_samples = 0;
+    s_calib_frames_left = CALIB_FRAMES; // Last: arms the sweep
+
+    ESP_LOGI(TAG, "HSV calibration started - keep the reference marker centered");
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_hsv_range(int h_min, int h_max, int s_min,
+                                      int s_max, int v_min, int v_max)
+{
+    // Negative = keep the current value for that threshold
+    hsv_range_t range = s_green_range;
+
+    if (h_min >= 0)
+        range.h_min = (uint8_t)h_min;
+    if (h_max >= 0)
+        range.h_max = (uint8_t)h_max;
+    if (s_min >= 0)
+        range.s_min = (uint8_t)s_min;
+    if (s_max >= 0)
+        range.s_max = (uint8_t)s_max;
+    if (v_min >= 0)
+        range.v_min = (uint8_t)v_min;
+    if (v_max >= 0)
+        range.v_max = (uint8_t)v_max;
+
+    if (h_min > 255 || h_max > 255 || s_min > 255 || s_max > 255 ||
+        v_min > 255 || v_max > 255 ||
+        range.s_min > range.s_max || range.v_min > range.v_max)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Hue legitimately wraps (red straddles 0), min > max encodes that
+    range.wrap = (range.h_min > range.h_max);
+
+    esp_err_t err = classifier_lut_build(&range);
+    if (err != ESP_OK)
+    {
+        return err; // Another build in flight - caller retries
+    }
+
+    s_green_range = range;
+
+    ESP_LOGI(TAG, "HSV range set: H[%u-%u]%s S[%u-%u] V[%u-%u]",
+             range.h_min, range.h_max, range.wrap ? " (wrap)" : "",
+             range.s_min, range.s_max, range.v_min, range.v_max);
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_hue_only_classifier(bool enable)
+{
+    if (enable == s_hue_only_mode)
+    {
+        return ESP_OK;
+    }
+
+    s_hue_only_mode = enable;
+
+    // Rebuild so the mode takes effect now, not on the next retune
+    esp_err_t err = classifier_lut_build(&s_green_range);
+    if (err != ESP_OK)
+    {
+        s_hue_only_mode = !enable;
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Classifier mode: %s", enable ? "hue-only" : "full HSV");
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_native_jpeg_stream(bool enable)
+{
+    int requested = enable ? 1 : 0;
+
+    if (requested == s_cap_native_jpeg)
+    {
+        return ESP_OK;
+    }
+
+    s_cap_native_jpeg = requested;
+
+    ESP_LOGI(TAG, "Native JPEG streaming %s%s",
+             enable ? "ENABLED" : "DISABLED",
+             enable ? " - detection suspended, veto fail-safe" : "");
+
+    if (s_task_running)
+    {
+        s_cap_reinit_pending = true; // Vision task recycles between frames
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_fast_detect(bool enable)
+{
+    int requested = enable ? 1 : 0;
+
+    if (requested == s_cap_fast_detect)
+    {
+        return ESP_OK;
+    }
+
+    s_cap_fast_detect = requested;
+
+    ESP_LOGI(TAG, "Fast-detect profile %s",
+             enable ? "ENABLED (QQVGA in DRAM)" : "DISABLED (QVGA in PSRAM)");
+
+    if (s_task_running)
+    {
+        s_cap_reinit_pending = true; // Vision task recycles between frames
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_adaptive_res(bool enable)
+{
+    if (enable == s_adaptive_res_enabled)
+    {
+        return ESP_OK;
+    }
+
+    s_adaptive_res_enabled = enable;
+    s_adaptive_clear_frames = 0;
+
+    // Disabling must not strand the sensor at QQVGA
+    if (!enable && s_cap_small_frames)
+    {
+        s_cap_small_frames = false;
+        if (s_task_running)
+        {
+            s_cap_resize_pending = true; // Vision task applies between frames
+        }
+    }
+
+    ESP_LOGI(TAG, "Adaptive resolution %s",
+             enable ? "ENABLED (QQVGA cruising, QVGA on approach)" : "DISABLED");
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_low_light_mode(vision_low_light_mode_t mode)
+{
+    if (mode != VISION_LOW_LIGHT_COLOR && mode != VISION_LOW_LIGHT_GRAY &&
+        mode != VISION_LOW_LIGHT_AUTO)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_low_light_mode = mode;
+    s_low_light_streak = 0;
+
+    // Forced modes switch the capture format right away; AUTO keeps the
+    // current format and lets the ambient tracker take over
+    int want_gray = (mode == VISION_LOW_LIGHT_GRAY)    ? 1
+                    : (mode == VISION_LOW_LIGHT_COLOR) ? 0
+                                                       : s_cap_grayscale;
+    if (want_gray != s_cap_grayscale)
+    {
+        s_cap_grayscale = want_gray;
+        if (s_task_running)
+        {
+            s_cap_reinit_pending = true; // Vision task recycles between frames
+        }
+    }
+
+    ESP_LOGI(TAG, "Low-light profile: %s (ambient luma %d)",
+             mode == VISION_LOW_LIGHT_AUTO ? "auto"
+             : want_gray                   ? "grayscale forced"
+                                           : "color forced",
+             s_ambient_luma);
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_aeawb_lock(bool lock)
+{
+    if (lock == s_aeawb_lock)
+    {
+        return ESP_OK;
+    }
+
+    if (!s_task_running)
+    {
+        return ESP_ERR_INVALID_STATE; // Nothing converged to freeze yet
+    }
+
+    s_aeawb_lock = lock;
+    s_aeawb_pending = true; // Vision task applies between frames
+
+    ESP_LOGI(TAG, "AEC/AWB lock %s", lock ? "requested" : "release requested");
+    return ESP_OK;
+}
+
+void vision_engine_set_sensor_window(bool enable)
+{
+    // The vision task applies/restores between frames; sensor I2C
+    // traffic from another core mid-capture is not safe
+    s_sensor_window_enabled = enable;
+    ESP_LOGI(TAG, "Sensor ROI windowing %s", enable ? "ENABLED" : "DISABLED");
+}
+
+esp_err_t vision_engine_set_capture_tuning(int fb_count, int grab_latest, int xclk_mhz)
+{
+    // Negative = keep current setting (lets the dashboard change one knob)
+    int new_fb = (fb_count < 0) ? s_cap_fb_count : fb_count;
+    int new_grab = (grab_latest < 0) ? s_cap_grab_latest : (grab_latest ? 1 : 0);
+    int new_xclk = (xclk_mhz < 0) ? s_cap_xclk_mhz : xclk_mhz;
+
+    if ((new_fb != 2 && new_fb != 3) || (new_xclk != 20 && new_xclk != 24))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (new_fb == s_cap_fb_count && new_grab == s_cap_grab_latest &&
+        new_xclk == s_cap_xclk_mhz)
+    {
+        return ESP_OK; // Nothing changed - skip the reinit glitch
+    }
+
+    s_cap_fb_count = new_fb;
+    s_cap_grab_latest = new_grab;
+    s_cap_xclk_mhz = new_xclk;
+
+    ESP_LOGI(TAG, "Capture profile requested: fb_count=%d, grab=%s, xclk=%dMHz",
+             new_fb, new_grab ? "latest" : "FIFO", new_xclk);
+
+    if (s_task_running)
+    {
+        s_cap_reinit_pending = true; // Vision task recycles between frames
+    }
+    // Not running yet: the profile simply applies at the next init
+
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_veto_hysteresis(int assert_frames, int release_frames)
+{
+    if (assert_frames < 1 || release_frames < 1 ||
+        assert_frames > VETO_HISTORY_SIZE || release_frames > VETO_HISTORY_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_veto_assert_frames = assert_frames;
+    s_veto_release_frames = release_frames;
+
+    ESP_LOGI(TAG, "Veto hysteresis set: assert after %d hits, release after %d misses",
+             assert_frames, release_frames);
+    return ESP_OK;
+}
+
+esp_err_t vision_engine_set_fps_range(float min_fps, float max_fps)
+{
+    if (min_fps <= 0.0f || max_fps < min_fps)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_gov_period_ceil_ms = (uint32_t)(1000.0f / min_fps);
+    s_gov_period_floor_ms = (uint32_t)(1000.0f / max_fps);
+
+    if (s_gov_period_floor_ms < 1)
+    {
+        s_gov_period_floor_ms = 1;
+    }
+
+    ESP_LOGI(TAG, "FPS range set: %.1f-%.1f (period %u-%u ms)",
+             min_fps, max_fps, (unsigned)s_gov_period_floor_ms, (unsigned)s_gov_period_ceil_ms);
+    return ESP_OK;
+}
+
+void vision_engine_get_latency_stats(vision_latency_stats_t *process,
+                                     vision_latency_stats_t *publish)
+{
+    if (process)
+    {
+        lat_hist_report(&s_hist_process, process);
+    }
+
+    if (publish)
+    {
+        lat_hist_report(&s_hist_publish, publish);
+    }
+}
+
+void vision_engine_get_capture_stats(vision_capture_stats_t *out)
+{
+    if (!out)
+    {
+        return;
     }
+
+    out->consumed =
+        atomic_load_explicit(&s_frames_consumed, memory_order_relaxed);
+    out->failures =
+        atomic_load_explicit(&s_capture_failures, memory_order_relaxed);
+    out->overwritten =
+        atomic_load_explicit(&s_frames_overwritten, memory_order_relaxed);
+    lat_hist_report(&s_hist_capture_age, &out->age);
 }
 
 void vision_engine_set_debug(bool enable)
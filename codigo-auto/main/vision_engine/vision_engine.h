@@ -19,23 +19,60 @@
 
 #include "esp_err.h"
 #include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Horizontal thirds of the frame for the zone accumulators
+typedef enum {
+    VISION_ZONE_LEFT = 0,
+    VISION_ZONE_CENTER,
+    VISION_ZONE_RIGHT,
+    VISION_ZONE_COUNT,
+} vision_zone_id_t;
+
+// Per-zone obstacle summary, maintained while the labeler walks the
+// runs of the same pass that produces the blobs (no extra scan). A
+// one-centroid result can only say "stop"; knowing which third the
+// obstacle occupies lets the control layer prefer a steering nudge.
+typedef struct {
+    uint32_t hit_count;    // Classified pixels whose runs fell in this third
+    float min_distance_cm; // Closest blob touching this third (999.9 = none)
+} vision_zone_t;
+
 // Vision detection result structure
 typedef struct {
     bool obstacle_detected;      // True if green obstacle found
-    float distance_cm;           // Estimated distance in centimeters
+    float distance_cm;           // Filtered distance in centimeters
+    float closing_speed_cm_s;    // Rate of change (negative = approaching)
     int centroid_x;              // Object center X coordinate (pixels)
     int centroid_y;              // Object center Y coordinate (pixels)
     int contour_area;            // Largest contour area (pixels²)
     uint32_t frame_count;        // Processed frames counter
     uint32_t processing_time_ms; // Last frame processing time
+    int64_t capture_time_us;     // Frame capture moment (esp_timer epoch)
+    vision_zone_t zones[VISION_ZONE_COUNT]; // Left/center/right thirds
 } vision_result_t;
 
+// Maximum distinct objects reported per frame
+#define VISION_MAX_BLOBS 8
+
+// Per-object output of the connected-component labeler
+typedef struct {
+    int area;       // Pixel count of the blob
+    int centroid_x; // Blob center X coordinate (pixels)
+    int centroid_y; // Blob center Y coordinate (pixels)
+    int min_x;      // Bounding box left edge
+    int min_y;      // Bounding box top edge
+    int max_x;      // Bounding box right edge
+    int max_y;      // Bounding box bottom edge
+} vision_blob_t;
+
 /**
  * @brief Initialize vision engine and camera
  * 
@@ -64,8 +101,14 @@ esp_err_t vision_engine_start(void);
 
 /**
  * @brief Stop vision processing task
- * 
- * @return ESP_OK on success
+ *
+ * Bounded join: the pipeline tasks acknowledge their exit, so a stop
+ * between frames completes in single-digit milliseconds and never
+ * races the restart. Returns ESP_ERR_TIMEOUT if the vision task was
+ * wedged inside the camera driver; the stop stays pending and the
+ * call can simply be retried.
+ *
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the join timed out
  */
 esp_err_t vision_engine_stop(void);
 
@@ -80,6 +123,45 @@ esp_err_t vision_engine_stop(void);
  */
 esp_err_t vision_engine_get_result(vision_result_t *result);
 
+/**
+ * @brief Zero-copy read of the freshest published result
+ *
+ * Returns a const pointer into the publication ring plus the generation
+ * that names it. The producer will not rewrite that slot for another
+ * VISION_BUS_SLOTS-1 publications, so a reader that dereferences
+ * promptly needs no copy and no lock. A reader that might hold the
+ * pointer across a blocking call re-checks with
+ * vision_engine_bus_stale() and falls back to
+ * vision_engine_get_result() on the (practically never) lapped case.
+ *
+ * @param[out] generation Generation of the returned slot (may be NULL)
+ * @param[out] veto Veto state published with the result (may be NULL)
+ * @return Pointer to the result slot; never NULL
+ */
+const vision_result_t *vision_engine_bus_read(uint32_t *generation, bool *veto);
+
+/**
+ * @brief Check whether a slot from vision_engine_bus_read may be torn
+ *
+ * @param generation Value returned by vision_engine_bus_read
+ * @return true if the producer may have rewritten that slot
+ */
+bool vision_engine_bus_stale(uint32_t generation);
+
+/**
+ * @brief Subscribe a task to result publications
+ *
+ * The vision task sets notify_bit on the task (xTaskNotify, eSetBits)
+ * after every publication, so consumers can block on their notification
+ * value instead of polling. Init-time, single-threaded registration,
+ * same contract as the veto edge callback; there is no unsubscribe.
+ *
+ * @param task Task to notify
+ * @param notify_bit Bit to set in its notification value
+ * @return ESP_OK, or ESP_ERR_NO_MEM when the subscriber table is full
+ */
+esp_err_t vision_engine_bus_subscribe(TaskHandle_t task, uint32_t notify_bit);
+
 /**
  * @brief Check if local veto is active (thread-safe)
  * 
@@ -91,6 +173,34 @@ esp_err_t vision_engine_get_result(vision_result_t *result);
  */
 bool vision_engine_is_veto_active(void);
 
+/**
+ * @brief Callback invoked on every published veto transition
+ *
+ * Fires from the vision task right after the new state is visible to
+ * readers, with true on assert and false on release. Intended to wake
+ * the control task so a veto edge reaches the motors one scheduler hop
+ * after detection instead of at the next poll. Keep it short.
+ */
+typedef void (*veto_edge_callback_t)(bool active);
+
+/**
+ * @brief Register the veto edge callback (may be NULL)
+ */
+void vision_engine_set_veto_edge_callback(veto_edge_callback_t callback);
+
+/**
+ * @brief Get the per-object detections of the last frame (thread-safe)
+ *
+ * Copies the blobs found by the connected-component labeler, largest
+ * first. Only blobs above MIN_CONTOUR_AREA are reported, so two distinct
+ * obstacles no longer merge into one phantom centroid between them.
+ *
+ * @param[out] blobs Caller array to fill
+ * @param max_blobs Capacity of the array (VISION_MAX_BLOBS is enough)
+ * @return Number of blobs copied
+ */
+int vision_engine_get_blobs(vision_blob_t *blobs, int max_blobs);
+
 /**
  * @brief Get last captured frame buffer for streaming
  * 
@@ -103,12 +213,315 @@ camera_fb_t* vision_engine_get_frame(void);
 
 /**
  * @brief Get vision engine statistics
- * 
+ *
+ * Reads the frame/time pair under a seqlock, so the average never mixes
+ * a new frame count with an old time sum.
+ *
  * @param[out] avg_fps Average frames per second
  * @param[out] avg_process_time_ms Average processing time in ms
  */
 void vision_engine_get_stats(float *avg_fps, float *avg_process_time_ms);
 
+// Monotonic event counters for fleet dashboards
+typedef struct {
+    uint32_t frames_processed; // Frames through process_frame()
+    uint32_t capture_failures; // esp_camera_fb_get() returned NULL
+    uint32_t motion_skips;     // Frames the motion gate skipped
+    uint32_t stream_sent;      // Frames handed to the encoder stage
+    uint32_t stream_dropped;   // Frames dropped at the stream handoff
+    uint32_t budget_overruns;  // Scans aborted at VISION_FRAME_BUDGET_MS
+} vision_counters_t;
+
+/**
+ * @brief Snapshot the event counters (thread-safe, tear-free)
+ *
+ * Each counter is an independent 32-bit atomic; values are monotonic
+ * since boot so dashboards can difference consecutive snapshots.
+ *
+ * @param[out] counters Struct to fill
+ */
+void vision_engine_get_counters(vision_counters_t *counters);
+
+// Percentile summary of a latency histogram window
+typedef struct {
+    uint32_t p50_ms;        // Median
+    uint32_t p95_ms;        // 95th percentile
+    uint32_t p99_ms;        // 99th percentile
+    uint32_t max_ms;        // Worst sample in the window
+    uint32_t sample_count;  // Frames recorded in the window
+} vision_latency_stats_t;
+
+/**
+ * @brief Get tail-latency percentiles since the previous call
+ *
+ * Averages hide the stalls that cause late vetoes; these histograms
+ * don't. Percentiles are bucket upper edges (2ms buckets). Reading a
+ * histogram resets its window, so each call reports the interval since
+ * the last one. Either pointer may be NULL to skip that histogram.
+ *
+ * @param[out] process Per-frame process_frame() duration stats
+ * @param[out] publish Capture-to-publish latency stats (veto budget)
+ */
+void vision_engine_get_latency_stats(vision_latency_stats_t *process,
+                                     vision_latency_stats_t *publish);
+
+// Capture-path visibility: driver overwrites and frame age at fb_get
+typedef struct {
+    uint32_t consumed;    // Frames fetched by the vision task (monotonic)
+    uint32_t failures;    // esp_camera_fb_get() returned NULL (monotonic)
+    uint32_t overwritten; // Frames the driver discarded, estimated from
+                          // capture-timestamp gaps (monotonic)
+    vision_latency_stats_t age; // Capture-to-fb_get age, windowed
+} vision_capture_stats_t;
+
+/**
+ * @brief Snapshot the capture-queue counters and frame-age percentiles
+ *
+ * With CAMERA_GRAB_LATEST the driver overwrites frames silently when
+ * the vision task falls behind; this surfaces both the estimated drop
+ * count and how stale each frame already was when fb_get returned it.
+ * The age histogram window resets on read, like the latency histograms.
+ *
+ * @param[out] out Struct to fill
+ */
+void vision_engine_get_capture_stats(vision_capture_stats_t *out);
+
+/**
+ * @brief Enable/disable changed-tile delta streaming (default on)
+ *
+ * In delta mode only 16x16 tiles that changed since the previous frame
+ * are sent (as raw RGB565), with a periodic full JPEG keyframe; the
+ * dashboard composites them onto its canvas. Cuts radio time several-
+ * fold on mostly-static scenes. Disabling reverts to full JPEG frames.
+ *
+ * @param enable true to stream tile deltas, false for full frames only
+ */
+void vision_engine_set_delta_stream(bool enable);
+
+/**
+ * @brief Enable/disable region-weighted stream quality (default on)
+ *
+ * Streamed frames keep full JPEG quality inside the detection bounding
+ * box and in the strip ahead of the vehicle; the rest of the frame is
+ * flattened before encoding so the encoder spends almost no bytes on
+ * it. Roughly halves frame size at the same negotiated quality.
+ *
+ * @param enable true to weight quality by region, false for uniform
+ */
+void vision_engine_set_roi_quality(bool enable);
+
+/**
+ * @brief Retune the green HSV thresholds at runtime
+ *
+ * Rebuilds the classifier lookup table from the new range and swaps it
+ * in atomically - the frame being scanned finishes on the old table, so
+ * no frame observes mixed thresholds. Lighting on the course changes
+ * through the day; this replaces the reflash that retuning used to
+ * cost. Pass a negative value to keep the current setting for that
+ * threshold. Values are 0-255 (hue on the 0-255 scale of the fast
+ * converter); h_min > h_max encodes a hue range that wraps through 0.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad range,
+ *         ESP_ERR_INVALID_STATE if another rebuild is in flight
+ */
+esp_err_t vision_engine_set_hsv_range(int h_min, int h_max, int s_min,
+                                      int s_max, int v_min, int v_max);
+
+/**
+ * @brief Select the hue-only classifier mode
+ *
+ * Skips the saturation division (the costliest op in the HSV
+ * conversion) when rebuilding the classifier table. In a well-lit
+ * arena the S bounds almost never reject a pixel the hue check
+ * accepts; with them wide open (0-255) the skip is bit-identical and
+ * engages automatically, this flag forces it regardless. Triggers a
+ * rebuild so the change takes effect immediately.
+ *
+ * @param enable true to classify on hue and value only
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if a rebuild is in flight
+ */
+esp_err_t vision_engine_set_hue_only_classifier(bool enable);
+
+/**
+ * @brief Enable the trapezoidal drive-corridor ROI (default off)
+ *
+ * Clamps the coarse obstacle scan to the vehicle's projected path: a
+ * trapezoid of per-row column bounds, wide at the bumper and narrowing
+ * to a horizon row above which nothing is scanned, with the far end
+ * shifted by the current steering. Covers roughly 40% of the frame, so
+ * the full-frame pass gets ~2.5x cheaper and off-path objects stop
+ * raising false vetoes. Refine and tracking passes are unaffected -
+ * they only label boxes seeded by corridor hits.
+ *
+ * @param enable true to scan only the drive corridor
+ */
+void vision_engine_set_corridor_roi(bool enable);
+
+/**
+ * @brief Start an HSV auto-calibration sweep (reference marker centered)
+ *
+ * The vision task histograms H/S/V over the central window for ~30
+ * frames, trims the 2% tails of each channel into a tight range, swaps
+ * it in as the new classifier range and persists it to NVS. Triggered
+ * from the dashboard; progress and the resulting range appear in the
+ * log. Tighter ranges shrink the false-positive pixel population every
+ * scan pays for.
+ *
+ * @return ESP_OK if the sweep started, ESP_ERR_INVALID_STATE if one is
+ *         already running or the vision task is stopped
+ */
+esp_err_t vision_engine_start_calibration(void);
+
+/**
+ * @brief Switch streaming to the sensor's hardware JPEG output
+ *
+ * The OV2640 compresses in hardware, so this profile eliminates the
+ * software frame2jpg cost on every streamed frame and streams at full
+ * capture rate. The camera driver sizes its buffers per format at init,
+ * so the format cannot alternate frame by frame: this is a
+ * whole-capture monitoring profile. JPEG frames cannot be scanned -
+ * detection stops publishing while active and the staleness guard
+ * keeps the veto asserted, so the vehicle will not move. Intended for
+ * parked/inspection use; disable to resume detection.
+ *
+ * @param enable true for native JPEG streaming, false for RGB565 detection
+ * @return ESP_OK (the switch is applied asynchronously)
+ */
+esp_err_t vision_engine_set_native_jpeg_stream(bool enable);
+
+/**
+ * @brief Enable/disable the internal-SRAM fast-detect profile
+ *
+ * Captures QQVGA (160x120) RGB565 frames into internal DRAM instead of
+ * QVGA into QSPI PSRAM: a quarter of the pixels and no external-RAM
+ * latency on the veto-critical path. Distance estimates and blob area
+ * thresholds are rescaled automatically; streamed video drops to
+ * 160x120 while active. The vision task recycles the camera driver
+ * between frames, same as a capture-profile change. Sensor ROI
+ * windowing stays off in this mode.
+ *
+ * @param enable true for QQVGA/DRAM detection, false for QVGA/PSRAM
+ * @return ESP_OK (the switch is applied asynchronously)
+ */
+esp_err_t vision_engine_set_fast_detect(bool enable);
+
+/**
+ * @brief Enable/disable resolution-adaptive detection
+ *
+ * Drops the sensor to QQVGA after a stretch of clear frames and snaps
+ * back to full QVGA the moment anything is detected. Unlike the
+ * profile switches above this never recycles the driver: the frame
+ * buffers sized at init fit the smaller frames, so the switch is a
+ * single SCCB burst between frames - single-digit milliseconds, no
+ * detection blackout. Only armed on the default capture profile;
+ * fast-detect, native-JPEG and grayscale take precedence.
+ *
+ * @param enable true to adapt resolution to scene content
+ * @return ESP_OK (switches are applied asynchronously)
+ */
+esp_err_t vision_engine_set_adaptive_res(bool enable);
+
+// Low-light capture profile selection
+typedef enum {
+    VISION_LOW_LIGHT_COLOR = 0, // Force RGB565 color capture
+    VISION_LOW_LIGHT_GRAY = 1,  // Force grayscale capture
+    VISION_LOW_LIGHT_AUTO = 2   // Follow the measured ambient light (default)
+} vision_low_light_mode_t;
+
+/**
+ * @brief Select the low-light grayscale capture profile
+ *
+ * At dusk the hue signal degrades into sensor noise while RGB565
+ * capture still pays full PSRAM traffic. The grayscale profile captures
+ * PIXFORMAT_GRAYSCALE frames (half the bytes) and replaces the color
+ * classifier with a strided luminance-band pre-gate, keeping the veto
+ * responsive when color is worthless. In AUTO mode the engine samples
+ * ambient light from the frames it already captures and switches
+ * formats itself, with hysteresis and a multi-second dwell; the format
+ * change goes through the usual between-frames driver recycle.
+ *
+ * @param mode COLOR / GRAY forced, or AUTO (the default)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG on an unknown mode
+ */
+esp_err_t vision_engine_set_low_light_mode(vision_low_light_mode_t mode);
+
+/**
+ * @brief Freeze/release auto-exposure and auto-white-balance
+ *
+ * With the autos hunting, the same green object drifts through HSV
+ * space and the classifier ranges must stay wide to absorb it. Locking
+ * freezes the sensor at its converged operating point so the ranges
+ * can be tightened: AEC/AGC raw values are captured and persisted with
+ * the NVS calibration data, surviving driver recycles and reboots.
+ * The OV2640 exposes no way to read converged AWB gains, so after a
+ * capture reinit AWB re-converges briefly and is frozen again. Lock
+ * after calibrating under representative arena lighting.
+ *
+ * @param lock true to freeze, false to let the autos hunt again
+ * @return ESP_OK; ESP_ERR_INVALID_STATE if the vision task is stopped
+ *         (nothing has converged yet)
+ */
+esp_err_t vision_engine_set_aeawb_lock(bool lock);
+
+/**
+ * @brief Enable/disable sensor-level ROI windowing (default on)
+ *
+ * Once an obstacle has been tracked stably, the OV2640 readout window
+ * is narrowed to half the field of view around it (output stays QVGA,
+ * so this is a 2x sensor-crop zoom): fewer array lines per frame and
+ * double the resolution on the target. Distances are corrected for the
+ * zoom and the full FOV is restored as soon as tracking is lost. The
+ * streamed video zooms along with it - disable when the dashboard
+ * needs a constant full-scene view.
+ *
+ * @param enable true to allow windowing while tracking
+ */
+void vision_engine_set_sensor_window(bool enable);
+
+/**
+ * @brief Change the capture profile at runtime (no reboot)
+ *
+ * Switches frame-buffer count (2/3), grab mode (latest vs FIFO) and
+ * XCLK frequency (20/24 MHz). The vision task recycles the camera
+ * driver between frames, so a brief capture gap replaces the reflash
+ * every field experiment used to cost. Pass a negative value to keep
+ * the current setting for that knob.
+ *
+ * @param fb_count 2 (double) or 3 (triple buffering), -1 to keep
+ * @param grab_latest 1 for CAMERA_GRAB_LATEST, 0 for FIFO, -1 to keep
+ * @param xclk_mhz 20 or 24, -1 to keep
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad profile
+ */
+esp_err_t vision_engine_set_capture_tuning(int fb_count, int grab_latest, int xclk_mhz);
+
+/**
+ * @brief Configure the veto hysteresis thresholds
+ *
+ * The published veto no longer flips on a single frame: raw per-frame
+ * decisions feed a ring buffer and the veto asserts only after
+ * assert_frames consecutive detections, releasing after release_frames
+ * consecutive clear frames. Defaults: assert 2, release 4.
+ *
+ * @param assert_frames Consecutive hits needed to assert (>= 1)
+ * @param release_frames Consecutive misses needed to release (>= 1)
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad threshold
+ */
+esp_err_t vision_engine_set_veto_hysteresis(int assert_frames, int release_frames);
+
+/**
+ * @brief Set the frame-rate range for the adaptive FPS governor
+ *
+ * The vision task adapts its capture period to measured processing time
+ * and vehicle state: up to max_fps while moving or while an obstacle /
+ * veto is in play, down to min_fps once the vehicle has been parked and
+ * the scene quiet for a while.
+ *
+ * @param min_fps Idle floor rate (must be > 0)
+ * @param max_fps Active ceiling rate (must be >= min_fps)
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad range
+ */
+esp_err_t vision_engine_set_fps_range(float min_fps, float max_fps);
+
 /**
  * @brief Enable/disable debug visualization
  * 
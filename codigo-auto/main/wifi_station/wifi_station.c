@@ -13,20 +13,128 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_netif.h"
+#include "esp_mac.h"
+#include "lwip/ip_addr.h"
 
 static const char *TAG = "[WiFi]";
 
 // Event group for WiFi events
 static EventGroupHandle_t s_wifi_event_group;
+static StaticEventGroup_t s_wifi_event_group_buf; // Permanent - lives in BSS
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT BIT1
 
+// Fast-reconnect cache: a full all-channel scan takes seconds, and
+// monitor_task holds the vehicle in emergency stop for all of them.
+// We remember the AP's BSSID and channel in NVS and attempt a directed
+// association first; only after WIFI_FAST_RETRY_LIMIT failures (AP
+// changed channel or was replaced) do we drop the cache and fall back
+// to the full scan.
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
+#define WIFI_CACHE_KEY_BSSID "bssid"
+#define WIFI_CACHE_KEY_CHANNEL "channel"
+#define WIFI_FAST_RETRY_LIMIT 3
+
+// Beacon intervals between wakeups if power save is ever enabled; with
+// WIFI_PS_NONE the radio listens continuously and this is just a floor
+// for command latency should the policy change
+#define WIFI_LISTEN_INTERVAL 1
+
 static int s_retry_num = 0;
 static bool s_is_connected = false;
+static bool s_using_cached_ap = false;
+static uint8_t s_connected_bssid[6] = {0};
+static uint8_t s_connected_channel = 0;
 static esp_event_handler_instance_t s_wifi_any_id_instance = NULL;
 static esp_event_handler_instance_t s_ip_got_ip_instance = NULL;
 
+/**
+ * @brief Load the cached AP BSSID/channel from NVS
+ *
+ * @return true if a complete cache entry was found
+ */
+static bool wifi_cache_load(uint8_t bssid[6], uint8_t *channel)
+{
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    size_t len = 6;
+    bool ok = (nvs_get_blob(handle, WIFI_CACHE_KEY_BSSID, bssid, &len) == ESP_OK &&
+               len == 6 &&
+               nvs_get_u8(handle, WIFI_CACHE_KEY_CHANNEL, channel) == ESP_OK);
+    nvs_close(handle);
+
+    if (ok)
+    {
+        // An erased entry is stored as all zeros (see wifi_cache_erase)
+        uint8_t acc = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            acc |= bssid[i];
+        }
+        ok = (acc != 0) && (*channel != 0);
+    }
+    return ok;
+}
+
+/**
+ * @brief Persist the AP we just associated with for the next boot
+ */
+static void wifi_cache_store(const uint8_t bssid[6], uint8_t channel)
+{
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not open NVS to store AP cache");
+        return;
+    }
+
+    // NVS skips identical rewrites internally, so storing on every
+    // successful connection costs nothing in flash wear
+    if (nvs_set_blob(handle, WIFI_CACHE_KEY_BSSID, bssid, 6) == ESP_OK &&
+        nvs_set_u8(handle, WIFI_CACHE_KEY_CHANNEL, channel) == ESP_OK)
+    {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+/**
+ * @brief Drop a cache entry that no longer matches reality
+ */
+static void wifi_cache_erase(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK)
+    {
+        uint8_t zero[6] = {0};
+        nvs_set_blob(handle, WIFI_CACHE_KEY_BSSID, zero, 6);
+        nvs_set_u8(handle, WIFI_CACHE_KEY_CHANNEL, 0);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+
+/**
+ * @brief Build the base station config (credentials, PMF, listen interval)
+ */
+static void wifi_build_sta_config(wifi_config_t *wifi_config)
+{
+    memset(wifi_config, 0, sizeof(*wifi_config));
+    strlcpy((char *)wifi_config->sta.ssid, WIFI_SSID, sizeof(wifi_config->sta.ssid));
+    strlcpy((char *)wifi_config->sta.password, WIFI_PASSWORD, sizeof(wifi_config->sta.password));
+    wifi_config->sta.threshold.authmode = WIFI_AUTH_WPA_WPA2_PSK;
+    wifi_config->sta.pmf_cfg.capable = true;
+    wifi_config->sta.pmf_cfg.required = false;
+    wifi_config->sta.listen_interval = WIFI_LISTEN_INTERVAL;
+    wifi_config->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+}
+
 /**
  * @brief WiFi event handler
  */
@@ -38,9 +146,30 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "WiFi station started, attempting connection...");
         esp_wifi_connect();
     }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        memcpy(s_connected_bssid, event->bssid, 6);
+        s_connected_channel = event->channel;
+    }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
         s_is_connected = false;
+
+        // If the directed attempt keeps failing, the cached AP moved
+        // channel or was replaced: drop the cache and retry with the
+        // full scan instead of burning the remaining attempts blind
+        if (s_using_cached_ap && s_retry_num >= WIFI_FAST_RETRY_LIMIT)
+        {
+            ESP_LOGW(TAG, "Cached AP not answering, falling back to full scan");
+            s_using_cached_ap = false;
+            wifi_cache_erase();
+
+            wifi_config_t wifi_config;
+            wifi_build_sta_config(&wifi_config);
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        }
+
         if (s_retry_num < WIFI_MAX_RETRY)
         {
             esp_wifi_connect();
@@ -59,6 +188,13 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "Got IP address: " IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
         s_is_connected = true;
+
+        // Remember this AP so the next boot or drop skips the scan
+        if (s_connected_channel != 0)
+        {
+            wifi_cache_store(s_connected_bssid, s_connected_channel);
+        }
+
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
@@ -83,11 +219,35 @@ esp_err_t wifi_station_init(void)
     // Create default event loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    // Create event group
-    s_wifi_event_group = xEventGroupCreate();
+    // Create event group (statically backed - cannot fail)
+    s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buf);
 
     // Create default WiFi station netif
-    esp_netif_create_default_wifi_sta();
+    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
+
+#if WIFI_USE_STATIC_IP
+    // The DHCP exchange costs hundreds of milliseconds on every
+    // reconnect, all of them spent with the dead-man holding the
+    // vehicle stopped. With the client stopped and a static lease set
+    // here, IP_EVENT_STA_GOT_IP fires as soon as the interface comes
+    // up after association, so reconnect time is the handshake alone.
+    esp_netif_dhcpc_stop(sta_netif);
+
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    uint32_t host = WIFI_STATIC_IP_BASE + (mac[5] % WIFI_STATIC_IP_SPAN);
+
+    esp_netif_ip_info_t ip_info;
+    memset(&ip_info, 0, sizeof(esp_netif_ip_info_t));
+    // ipaddr_addr returns network byte order: the host octet is the
+    // high byte on this little-endian target
+    ip_info.ip.addr = ipaddr_addr(WIFI_SERVER_IP) & 0x00FFFFFF;
+    ip_info.ip.addr |= host << 24;
+    ip_info.gw.addr = ipaddr_addr(WIFI_SERVER_IP);
+    ip_info.netmask.addr = ipaddr_addr(WIFI_STATIC_NETMASK_ADDR);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(sta_netif, &ip_info));
+    ESP_LOGI(TAG, "Static lease " IPSTR " (DHCP bypassed)", IP2STR(&ip_info.ip));
+#endif
 
     // Initialize WiFi with default config
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -114,14 +274,26 @@ esp_err_t wifi_station_connect(void)
     ESP_LOGI(TAG, "Connecting to AP: %s", WIFI_SSID);
 
     // Configure WiFi as station
-    wifi_config_t wifi_config = {0};
-    strlcpy((char *)wifi_config.sta.ssid, WIFI_SSID, sizeof(wifi_config.sta.ssid));
-    strlcpy((char *)wifi_config.sta.password, WIFI_PASSWORD, sizeof(wifi_config.sta.password));
-    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA_WPA2_PSK;
-    wifi_config.sta.pmf_cfg.capable = true;
-    wifi_config.sta.pmf_cfg.required = false;
-    wifi_config.sta.listen_interval = 0;
-    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    wifi_config_t wifi_config;
+    wifi_build_sta_config(&wifi_config);
+
+    // Directed fast reconnect: with a cached BSSID and channel the
+    // driver associates without scanning, cutting seconds of emergency
+    // stop down to the association handshake itself
+    uint8_t cached_bssid[6];
+    uint8_t cached_channel = 0;
+    s_using_cached_ap = wifi_cache_load(cached_bssid, &cached_channel);
+    if (s_using_cached_ap)
+    {
+        memcpy(wifi_config.sta.bssid, cached_bssid, 6);
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = cached_channel;
+        wifi_config.sta.scan_method = WIFI_SCAN_METHOD_FAST;
+        ESP_LOGI(TAG, "Using cached AP %02x:%02x:%02x:%02x:%02x:%02x on channel %d",
+                 cached_bssid[0], cached_bssid[1], cached_bssid[2],
+                 cached_bssid[3], cached_bssid[4], cached_bssid[5],
+                 cached_channel);
+    }
 
     s_retry_num = 0;
     s_is_connected = false;
@@ -167,6 +339,16 @@ bool wifi_station_is_connected(void)
     return s_is_connected;
 }
 
+int wifi_station_get_rssi(void)
+{
+    wifi_ap_record_t ap_info;
+    if (!s_is_connected || esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+    {
+        return 0;
+    }
+    return ap_info.rssi;
+}
+
 esp_err_t wifi_station_disconnect(void)
 {
     ESP_LOGI(TAG, "Disconnecting from AP...");
@@ -27,6 +27,18 @@ extern "C"
 #define WIFI_MAX_RETRY 10
 #define WIFI_RETRY_DELAY_MS 5000
 
+// Static-lease fast association: the SoftAP subnet is fixed
+// (192.168.4.0/24, server always at .1), so the vehicle does not need
+// the DHCP exchange at all. The lease is derived from the station MAC
+// inside [BASE, BASE+SPAN), well above the pool the S3's DHCP server
+// hands out from .2 upward, so fleet vehicles get distinct addresses
+// without per-unit provisioning and a phone joining the AP can never
+// collide with them.
+#define WIFI_USE_STATIC_IP 1
+#define WIFI_STATIC_IP_BASE 200
+#define WIFI_STATIC_IP_SPAN 40
+#define WIFI_STATIC_NETMASK_ADDR "255.255.255.0"
+
     /**
      * @brief Initialize WiFi Station mode
      *
@@ -54,6 +66,13 @@ extern "C"
      */
     bool wifi_station_is_connected(void);
 
+    /**
+     * @brief Signal strength of the current association
+     *
+     * @return RSSI in dBm, 0 when not associated
+     */
+    int wifi_station_get_rssi(void);
+
     /**
      * @brief Disconnect from AP and deinitialize WiFi
      *
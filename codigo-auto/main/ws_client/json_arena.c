@@ -0,0 +1,132 @@
+/**
+ * @file json_arena.c
+ * @brief Per-task bump allocator backing cJSON
+ */
+
+#include "json_arena.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Per-task block size: the largest status message is well under 1KB of
+// nodes plus the print buffer
+#define JSON_ARENA_SIZE 2048
+
+// Tasks that touch cJSON concurrently (websocket event task, vision)
+#define JSON_ARENA_MAX_TASKS 4
+
+typedef struct
+{
+    size_t used;
+    uint8_t buf[JSON_ARENA_SIZE];
+} json_arena_t;
+
+// Task -> arena map. Entries are claimed once via CAS; afterwards each
+// task only ever reads its own slot.
+typedef struct
+{
+    _Atomic(void *) task;
+    json_arena_t *arena;
+} json_arena_slot_t;
+
+static json_arena_slot_t s_slots[JSON_ARENA_MAX_TASKS];
+
+static json_arena_t *arena_for_current_task(bool create)
+{
+    void *task = (void *)xTaskGetCurrentTaskHandle();
+
+    for (int i = 0; i < JSON_ARENA_MAX_TASKS; i++)
+    {
+        if (atomic_load_explicit(&s_slots[i].task, memory_order_acquire) == task)
+        {
+            return s_slots[i].arena;
+        }
+    }
+
+    if (!create)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < JSON_ARENA_MAX_TASKS; i++)
+    {
+        void *expected = NULL;
+        if (atomic_compare_exchange_strong_explicit(&s_slots[i].task, &expected, task,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed))
+        {
+            json_arena_t *arena = malloc(sizeof(json_arena_t));
+            if (arena != NULL)
+            {
+                arena->used = 0;
+            }
+            s_slots[i].arena = arena;
+            // Publish the arena before other readers can match the task
+            atomic_store_explicit(&s_slots[i].task, task, memory_order_release);
+            return arena;
+        }
+    }
+
+    return NULL; // Out of slots: this task falls back to the heap
+}
+
+static void *arena_malloc_hook(size_t size)
+{
+    json_arena_t *arena = arena_for_current_task(true);
+    if (arena != NULL)
+    {
+        size_t aligned = (size + 3) & ~(size_t)3;
+        if (arena->used + aligned <= JSON_ARENA_SIZE)
+        {
+            void *ptr = arena->buf + arena->used;
+            arena->used += aligned;
+            return ptr;
+        }
+    }
+
+    return malloc(size);
+}
+
+static void arena_free_hook(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    // Arena pointers are released in bulk by the reset; only spilled
+    // allocations go back to the heap
+    for (int i = 0; i < JSON_ARENA_MAX_TASKS; i++)
+    {
+        json_arena_t *arena = s_slots[i].arena;
+        if (arena != NULL &&
+            (uint8_t *)ptr >= arena->buf &&
+            (uint8_t *)ptr < arena->buf + JSON_ARENA_SIZE)
+        {
+            return;
+        }
+    }
+
+    free(ptr);
+}
+
+void json_arena_register_hooks(void)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = arena_malloc_hook,
+        .free_fn = arena_free_hook,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+void json_arena_reset(void)
+{
+    json_arena_t *arena = arena_for_current_task(false);
+    if (arena != NULL)
+    {
+        arena->used = 0;
+    }
+}
@@ -0,0 +1,31 @@
+/**
+ * @file json_arena.h
+ * @brief Per-task bump allocator backing cJSON
+ *
+ * Status messages and parsed control frames build cJSON trees from
+ * dozens of tiny mallocs at 10Hz, fragmenting a heap that is shared
+ * with the camera frame buffers. With these hooks installed, cJSON
+ * allocates from a fixed per-task block with a pointer bump, and
+ * json_arena_reset() recycles the whole block in O(1) once the message
+ * is done. Trees that outgrow the block spill to the regular heap
+ * transparently.
+ */
+
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+/**
+ * @brief Install the cJSON allocation hooks. Call once at startup,
+ *        before the first cJSON use.
+ */
+void json_arena_register_hooks(void);
+
+/**
+ * @brief Recycle the calling task's arena in O(1).
+ *
+ * Call after the message tree has been released (cJSON_Delete /
+ * cJSON_free); no cJSON pointer from this task may outlive the reset.
+ */
+void json_arena_reset(void);
+
+#endif // JSON_ARENA_H
@@ -4,11 +4,26 @@
  */
 
 #include "ws_client.h"
+#include "json_arena.h"
+#include "trace_points.h"
+#include "trace_log/trace_log.h"
+#include "blackbox/blackbox.h"
+#include "dataset_capture/dataset_capture.h"
+#include "ota_update/ota_update.h"
+#include "udp_stream/udp_stream.h"
+#include "../motor_control/motor_control.h"
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_websocket_client.h"
 #include "esp_log.h"
+#include "nvs.h"
+#include "mdns.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "cJSON.h"
 #include <inttypes.h>
 #include <stdlib.h>
@@ -25,6 +40,250 @@ static char s_vehicle_id[32] = {0};
 // Connection state
 static bool s_is_connected = false;
 static volatile bool s_stream_enabled = false;
+static volatile bool s_stream_preview = false;
+// Quality ladder negotiated by the server (stream_status message);
+// 0 means no limit / no cap
+static volatile int s_stream_max_fps = 0;
+static volatile int s_stream_jpeg_q = 0;
+// QoS shed level from the governor in main.c; folded into the stream
+// getters below so the ladder and the local governor compose (the
+// stricter of the two always wins)
+static volatile int s_qos_shed = QOS_SHED_NONE;
+static capture_config_callback_t s_capture_config_callback = NULL;
+static hsv_config_callback_t s_hsv_config_callback = NULL;
+static connection_callback_t s_connection_callback = NULL;
+
+// ============================================================================
+// RECONNECT BACKOFF AND STREAM RESUME
+// ============================================================================
+// The library's fixed reconnect interval was wrong in both directions:
+// 5 s of dead video after a one-packet blip, yet hammering the radio
+// every 5 s during a real outage. The TX task now drives reconnects
+// itself with jittered exponential backoff, and the stream state that
+// was active at disconnect time is restored the moment the socket comes
+// back - the register reply (stream_status) then corrects it if viewer
+// demand changed while we were away.
+
+static volatile bool s_reconnect_pending = false;
+static uint32_t s_reconnect_at_ms = 0;
+static uint32_t s_reconnect_backoff_ms = 0;
+
+// Stream state captured at disconnect time, restored on reconnect
+static bool s_resume_stream_enabled = false;
+static bool s_resume_stream_preview = false;
+static bool s_resume_valid = false;
+
+// ============================================================================
+// SERVER DISCOVERY (mDNS + NVS CACHE)
+// ============================================================================
+// The server URI used to be hardcoded to the SoftAP address, which broke
+// the moment the camera moved onto LAN infrastructure. The camera now
+// advertises _minitesla._tcp over mDNS and the vehicle resolves it -
+// but never on the boot path: the last working URI is cached in NVS
+// (same pattern as the BSSID cache in wifi_station) so a normal boot
+// connects immediately, and a full browse only runs after several
+// consecutive connect failures suggest the cached address went stale.
+
+#define WS_DISCO_NVS_NAMESPACE "ws_disco"
+#define WS_DISCO_NVS_KEY_URI "server_uri"
+#define WS_DISCO_SERVICE "_minitesla"
+#define WS_DISCO_PROTO "_tcp"
+#define WS_DISCO_FAIL_THRESHOLD 3
+#define WS_DISCO_QUERY_TIMEOUT_MS 3000
+#define WS_DISCO_MAX_RESULTS 4
+
+static char s_server_uri[64] = WS_SERVER_URI;
+static bool s_mdns_ready = false;
+static uint32_t s_connect_failures = 0;
+
+/**
+ * @brief Load the cached server URI from NVS
+ *
+ * @return true if a plausible ws:// URI was found
+ */
+static bool ws_disco_cache_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(WS_DISCO_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    char uri[sizeof(s_server_uri)];
+    size_t len = sizeof(uri);
+    bool ok = (nvs_get_str(handle, WS_DISCO_NVS_KEY_URI, uri, &len) == ESP_OK);
+    nvs_close(handle);
+
+    if (ok && strncmp(uri, "ws://", 5) == 0)
+    {
+        strncpy(s_server_uri, uri, sizeof(s_server_uri) - 1);
+        s_server_uri[sizeof(s_server_uri) - 1] = '\0';
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Persist the URI we just connected through for the next boot
+ */
+static void ws_disco_cache_store(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(WS_DISCO_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return;
+    }
+
+    // NVS skips identical rewrites internally, so storing on every
+    // successful connection costs nothing in flash wear
+    if (nvs_set_str(handle, WS_DISCO_NVS_KEY_URI, s_server_uri) == ESP_OK)
+    {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+/**
+ * @brief Browse for the server over mDNS and rewrite s_server_uri
+ *
+ * Blocks up to WS_DISCO_QUERY_TIMEOUT_MS; only ever called from the TX
+ * task while the client is stopped, where the time is lost anyway.
+ *
+ * @return true if a service instance with an IPv4 address was found
+ */
+static bool ws_disco_browse(void)
+{
+    if (!s_mdns_ready)
+    {
+        return false;
+    }
+
+    mdns_result_t *results = NULL;
+    esp_err_t err = mdns_query_ptr(WS_DISCO_SERVICE, WS_DISCO_PROTO,
+                                   WS_DISCO_QUERY_TIMEOUT_MS,
+                                   WS_DISCO_MAX_RESULTS, &results);
+    if (err != ESP_OK || results == NULL)
+    {
+        ESP_LOGW(TAG, "Búsqueda mDNS sin resultados (%s)", esp_err_to_name(err));
+        return false;
+    }
+
+    bool found = false;
+    for (mdns_result_t *r = results; r != NULL && !found; r = r->next)
+    {
+        for (mdns_ip_addr_t *a = r->addr; a != NULL; a = a->next)
+        {
+            snprintf(s_server_uri, sizeof(s_server_uri),
+                     "ws://" IPSTR ":%u/ws", IP2STR(&a->addr.ip4), r->port);
+            ESP_LOGI(TAG, "Servidor descubierto por mDNS: %s", s_server_uri);
+            found = true;
+            break;
+        }
+    }
+    mdns_query_results_free(results);
+    return found;
+}
+
+/**
+ * @brief Start mDNS and pick the boot URI (cache first, default second)
+ */
+static void ws_disco_init(void)
+{
+    s_mdns_ready = (mdns_init() == ESP_OK);
+    if (!s_mdns_ready)
+    {
+        ESP_LOGW(TAG, "mDNS no disponible; solo caché NVS y URI por defecto");
+    }
+
+    if (ws_disco_cache_load())
+    {
+        ESP_LOGI(TAG, "URI del servidor desde caché NVS: %s", s_server_uri);
+    }
+}
+
+// ============================================================================
+// CLOCK SYNC AND COMMAND AGE GATE
+// ============================================================================
+// The server stamps every forwarded control command with its own
+// relay_ms clock. A lightweight ping/pong handshake estimates the
+// offset between that clock and ours (half-RTT assumption, keeping the
+// estimate from the lowest-RTT samples), so a forward that sat queued
+// for 700 ms behind a TCP stall can be recognized and discarded instead
+// of moving the vehicle long after the operator released the button.
+// stop always passes: it only gets safer with age.
+
+#define WS_CMD_MAX_AGE_MS 300
+#define WS_CLOCK_SYNC_INTERVAL_MS 10000
+#define WS_CLOCK_RTT_SLACK_MS 50
+
+static int64_t s_clock_offset_ms = 0; // server_ms ~= local_ms + offset
+static uint32_t s_clock_best_rtt_ms = UINT32_MAX;
+static bool s_clock_synced = false;
+
+// Sliding window of recent RTT samples feeding the adaptive dead-man.
+// The windowed maximum stands in for a high percentile: 16 samples at
+// the ping interval cover the last few minutes of link behaviour.
+#define WS_RTT_WINDOW 16
+static uint32_t s_rtt_window_ms[WS_RTT_WINDOW];
+static uint8_t s_rtt_count = 0;
+static uint8_t s_rtt_next = 0;
+
+static uint32_t local_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void handle_time_pong_message(const cJSON *root)
+{
+    const cJSON *t0_item = cJSON_GetObjectItem(root, "t0");
+    const cJSON *server_item = cJSON_GetObjectItem(root, "server_ms");
+    if (!t0_item || !cJSON_IsNumber(t0_item) ||
+        !server_item || !cJSON_IsNumber(server_item))
+    {
+        return;
+    }
+
+    uint32_t now = local_ms();
+    uint32_t t0 = (uint32_t)t0_item->valuedouble;
+    uint32_t rtt = now - t0;
+
+    // Every sample feeds the dead-man window, including the queued-up
+    // ones the offset estimate rejects - a congested link is exactly
+    // what the adaptive timeout needs to see
+    s_rtt_window_ms[s_rtt_next] = rtt;
+    s_rtt_next = (uint8_t)((s_rtt_next + 1) % WS_RTT_WINDOW);
+    if (s_rtt_count < WS_RTT_WINDOW)
+    {
+        s_rtt_count++;
+    }
+
+    // The half-RTT assumption is only as good as the symmetry of the
+    // link: keep the offset from the best samples and ignore the ones
+    // that clearly sat behind queued traffic
+    if (!s_clock_synced || rtt <= s_clock_best_rtt_ms + WS_CLOCK_RTT_SLACK_MS)
+    {
+        s_clock_offset_ms = (int64_t)(uint32_t)server_item->valuedouble +
+                            rtt / 2 - (int64_t)now;
+        if (rtt < s_clock_best_rtt_ms)
+        {
+            s_clock_best_rtt_ms = rtt;
+        }
+        s_clock_synced = true;
+        ESP_LOGD(TAG, "Reloj sincronizado: offset=%lld ms, rtt=%lu ms",
+                 (long long)s_clock_offset_ms, (unsigned long)rtt);
+    }
+}
+
+static void handle_latency_probe(const cJSON *root);
+static void ws_send_cmd_ack(uint32_t seq);
+static void handle_trace_dump(void);
+static void handle_blackbox_dump(void);
+static void handle_dataset_capture_message(const cJSON *root);
+static void ws_send_dataset_info(void);
+static void handle_dataset_fetch_message(const cJSON *root);
+static void handle_ota_begin_message(const cJSON *root);
+static void handle_ota_end_message(void);
+static void ws_send_ota_status(void);
 
 static control_command_t control_command_from_string(const char *command)
 {
@@ -49,6 +308,10 @@ static control_command_t control_command_from_string(const char *command)
     {
         return CONTROL_CMD_RIGHT;
     }
+    if (strcmp(command, "ka") == 0)
+    {
+        return CONTROL_CMD_KEEPALIVE;
+    }
 
     return CONTROL_CMD_STOP;
 }
@@ -60,6 +323,7 @@ static void handle_stream_status_message(const cJSON *root)
 
     const cJSON *enable_item = cJSON_GetObjectItem(root, "enable");
     const cJSON *viewer_item = cJSON_GetObjectItem(root, "viewer_count");
+    const cJSON *preview_item = cJSON_GetObjectItem(root, "preview");
 
     if (enable_item)
     {
@@ -78,6 +342,43 @@ static void handle_stream_status_message(const cJSON *root)
         viewer_count = viewer_item->valueint;
     }
 
+    // Modo preview opcional: el dashboard puede pedir 160x120 cuando
+    // monitorea varios vehículos a la vez
+    if (preview_item && cJSON_IsBool(preview_item))
+    {
+        bool preview = cJSON_IsTrue(preview_item);
+        if (preview != s_stream_preview)
+        {
+            s_stream_preview = preview;
+            ESP_LOGI(TAG, "Stream preview %s", preview ? "activado" : "desactivado");
+        }
+    }
+
+    // Escalera de calidad: el servidor reparte el presupuesto de aire
+    // entre los vehículos que transmiten y manda el ritmo y la calidad
+    // JPEG que le tocan a éste
+    const cJSON *fps_item = cJSON_GetObjectItem(root, "max_fps");
+    if (fps_item && cJSON_IsNumber(fps_item))
+    {
+        int max_fps = fps_item->valueint;
+        if (max_fps >= 0 && max_fps != s_stream_max_fps)
+        {
+            s_stream_max_fps = max_fps;
+            ESP_LOGI(TAG, "Ritmo de stream negociado: %d fps", max_fps);
+        }
+    }
+
+    const cJSON *quality_item = cJSON_GetObjectItem(root, "jpeg_q");
+    if (quality_item && cJSON_IsNumber(quality_item))
+    {
+        int jpeg_q = quality_item->valueint;
+        if (jpeg_q >= 0 && jpeg_q != s_stream_jpeg_q)
+        {
+            s_stream_jpeg_q = jpeg_q;
+            ESP_LOGI(TAG, "Tope de calidad JPEG negociado: %d", jpeg_q);
+        }
+    }
+
     bool previous = s_stream_enabled;
     s_stream_enabled = enable;
 
@@ -87,6 +388,102 @@ static void handle_stream_status_message(const cJSON *root)
     }
 }
 
+static void handle_capture_config_message(const cJSON *root)
+{
+    if (!s_capture_config_callback)
+    {
+        ESP_LOGD(TAG, "capture_config sin callback registrado - ignorado");
+        return;
+    }
+
+    // Campos ausentes quedan en -1: el motor de visión conserva el valor
+    // actual de ese parámetro
+    capture_config_t config = {
+        .fb_count = -1,
+        .grab_latest = -1,
+        .xclk_mhz = -1,
+    };
+
+    const cJSON *fb_item = cJSON_GetObjectItem(root, "fb_count");
+    if (fb_item && cJSON_IsNumber(fb_item))
+    {
+        config.fb_count = fb_item->valueint;
+    }
+
+    const cJSON *grab_item = cJSON_GetObjectItem(root, "grab_mode");
+    if (grab_item && cJSON_IsString(grab_item))
+    {
+        if (strcmp(grab_item->valuestring, "latest") == 0)
+        {
+            config.grab_latest = 1;
+        }
+        else if (strcmp(grab_item->valuestring, "fifo") == 0)
+        {
+            config.grab_latest = 0;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "grab_mode desconocido: %s", grab_item->valuestring);
+        }
+    }
+
+    const cJSON *xclk_item = cJSON_GetObjectItem(root, "xclk_mhz");
+    if (xclk_item && cJSON_IsNumber(xclk_item))
+    {
+        config.xclk_mhz = xclk_item->valueint;
+    }
+
+    ESP_LOGI(TAG, "Capture config recibida: fb_count=%d, grab=%d, xclk=%dMHz",
+             config.fb_count, config.grab_latest, config.xclk_mhz);
+
+    s_capture_config_callback(&config);
+}
+
+static void handle_hsv_config_message(const cJSON *root)
+{
+    if (!s_hsv_config_callback)
+    {
+        ESP_LOGD(TAG, "hsv_config sin callback registrado - ignorado");
+        return;
+    }
+
+    // Campos ausentes quedan en -1: el motor de visión conserva ese umbral
+    hsv_config_t config = {-1, -1, -1, -1, -1, -1, false};
+
+    // {"type":"hsv_config","calibrate":true} dispara el barrido de
+    // auto-calibración con el marcador de referencia centrado
+    const cJSON *calib_item = cJSON_GetObjectItem(root, "calibrate");
+    if (calib_item && cJSON_IsBool(calib_item))
+    {
+        config.calibrate = cJSON_IsTrue(calib_item);
+    }
+
+    const struct
+    {
+        const char *key;
+        int *value;
+    } fields[] = {
+        {"h_min", &config.h_min}, {"h_max", &config.h_max},
+        {"s_min", &config.s_min}, {"s_max", &config.s_max},
+        {"v_min", &config.v_min}, {"v_max", &config.v_max},
+    };
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        const cJSON *item = cJSON_GetObjectItem(root, fields[i].key);
+        if (item && cJSON_IsNumber(item))
+        {
+            *fields[i].value = item->valueint;
+        }
+    }
+
+    ESP_LOGI(TAG, "HSV config recibida: H[%d-%d] S[%d-%d] V[%d-%d]",
+             config.h_min, config.h_max, config.s_min, config.s_max,
+             config.v_min, config.v_max);
+
+    s_hsv_config_callback(&config);
+}
+
 static void handle_control_message(const cJSON *root)
 {
     if (!root)
@@ -104,16 +501,39 @@ static void handle_control_message(const cJSON *root)
     const cJSON *vehicle_item = cJSON_GetObjectItem(root, "vehicle_id");
     const char *vehicle = (vehicle_item && cJSON_IsString(vehicle_item)) ? vehicle_item->valuestring : NULL;
 
-    if (vehicle && vehicle[0] != '\0' && s_vehicle_id[0] != '\0' &&
+    // "*" es el comodín de flota del servidor: un stop multicast va
+    // dirigido a todos y no debe filtrarse por id propio
+    if (vehicle && vehicle[0] != '\0' && strcmp(vehicle, "*") != 0 &&
+        s_vehicle_id[0] != '\0' &&
         strncmp(vehicle, s_vehicle_id, sizeof(s_vehicle_id)) != 0)
     {
         ESP_LOGD(TAG, "Comando para otro vehículo (%s) - ignorado", vehicle);
         return;
     }
 
+    // Delivery accounting: echo the dashboard's sequence number so the
+    // server can close its per-hop loss books (cmd_ack handling in
+    // ws_server.c). Acked at receipt, before the age gate drops
+    // anything - "delivered late" and "lost" are different failures.
+    const cJSON *seq_item = cJSON_GetObjectItem(root, "seq");
+    if (seq_item && cJSON_IsNumber(seq_item))
+    {
+        ws_send_cmd_ack((uint32_t)seq_item->valuedouble);
+    }
+
+    // Latency probes travel the control path but never touch motors:
+    // they bounce back as latency_report with our local timestamps
+    if (strcmp(command_item->valuestring, "latency_probe") == 0)
+    {
+        handle_latency_probe(root);
+        return;
+    }
+
     control_message_t message = {
         .command = control_command_from_string(command_item->valuestring),
         .timestamp_ms = 0,
+        // Actuation latency baseline: stamped here, at socket receipt
+        .recv_us = esp_timer_get_time(),
     };
 
     strncpy(message.raw_command, command_item->valuestring, sizeof(message.raw_command) - 1);
@@ -125,54 +545,852 @@ static void handle_control_message(const cJSON *root)
         message.timestamp_ms = (uint64_t)timestamp_item->valuedouble;
     }
 
+    // Age gate over the server's relay stamp (see the clock sync block)
+    const cJSON *relay_item = cJSON_GetObjectItem(root, "relay_ms");
+    if (s_clock_synced && relay_item && cJSON_IsNumber(relay_item) &&
+        message.command != CONTROL_CMD_STOP)
+    {
+        int64_t server_now = (int64_t)local_ms() + s_clock_offset_ms;
+        int64_t age_ms = server_now - (int64_t)(uint32_t)relay_item->valuedouble;
+        if (age_ms > WS_CMD_MAX_AGE_MS)
+        {
+            ESP_LOGW(TAG, "Comando %s descartado por viejo (%lld ms)",
+                     message.raw_command, (long long)age_ms);
+            return;
+        }
+    }
+
     ESP_LOGD(TAG, "Control recibido: %s (%" PRIu64 " ms)",
              message.raw_command,
              message.timestamp_ms);
 
+    trace_log_push(TRACE_EV_CMD_RX, (int32_t)message.command, 0);
+
     if (s_control_callback)
     {
         s_control_callback(&message);
     }
 }
 
-static void handle_text_frame(const char *json_str)
+static void handle_text_frame(const char *json_str)
+{
+    if (!json_str)
+    {
+        return;
+    }
+
+    cJSON *root = cJSON_Parse(json_str);
+    if (!root)
+    {
+        ESP_LOGW(TAG, "JSON inválido: %s", json_str);
+        json_arena_reset();
+        return;
+    }
+
+    const cJSON *type_item = cJSON_GetObjectItem(root, "type");
+    const char *type = (type_item && cJSON_IsString(type_item)) ? type_item->valuestring : NULL;
+
+    if (!type)
+    {
+        ESP_LOGD(TAG, "Frame sin tipo - ignorado");
+        cJSON_Delete(root);
+        json_arena_reset();
+        return;
+    }
+
+    if (strcmp(type, "stream_status") == 0)
+    {
+        handle_stream_status_message(root);
+    }
+    else if (strcmp(type, "control") == 0)
+    {
+        handle_control_message(root);
+    }
+    else if (strcmp(type, "capture_config") == 0)
+    {
+        handle_capture_config_message(root);
+    }
+    else if (strcmp(type, "hsv_config") == 0)
+    {
+        handle_hsv_config_message(root);
+    }
+    else if (strcmp(type, "time_pong") == 0)
+    {
+        handle_time_pong_message(root);
+    }
+    else if (strcmp(type, "trace_dump") == 0)
+    {
+        handle_trace_dump();
+    }
+    else if (strcmp(type, "blackbox_dump") == 0)
+    {
+        handle_blackbox_dump();
+    }
+    else if (strcmp(type, "blackbox_resume") == 0)
+    {
+        blackbox_resume();
+    }
+    else if (strcmp(type, "dataset_capture") == 0)
+    {
+        handle_dataset_capture_message(root);
+    }
+    else if (strcmp(type, "dataset_info") == 0)
+    {
+        ws_send_dataset_info();
+    }
+    else if (strcmp(type, "dataset_fetch") == 0)
+    {
+        handle_dataset_fetch_message(root);
+    }
+    else if (strcmp(type, "ota_begin") == 0)
+    {
+        handle_ota_begin_message(root);
+    }
+    else if (strcmp(type, "ota_end") == 0)
+    {
+        handle_ota_end_message();
+    }
+    else if (strcmp(type, "ota_abort") == 0)
+    {
+        ota_update_abort("aborted by updater");
+        ws_send_ota_status();
+    }
+    else
+    {
+        ESP_LOGD(TAG, "Mensaje %s sin handler", type);
+    }
+
+    cJSON_Delete(root);
+    json_arena_reset();
+}
+
+// ============================================================================
+// ASYNC TX QUEUE
+// ============================================================================
+// esp_websocket_client_send_*() blocks the caller on the TCP window:
+// when the AP was congested, status_tx_task wedged behind portMAX_DELAY
+// and its 100 ms cadence collapsed. Producers now hand a heap copy to a
+// bounded queue per priority class and a dedicated TX task performs the
+// blocking sends. A full queue evicts the oldest entry - for status
+// only the latest snapshot matters, and a dropped video frame just
+// lowers the visible frame rate for a moment.
+
+#define WS_TXQ_MSG_DEPTH 8
+#define WS_TXQ_VIDEO_DEPTH 2
+#define WS_TXQ_TELEM_DEPTH 2
+#define WS_TX_TASK_STACK_SIZE 4096
+#define WS_TX_TASK_PRIORITY 5
+#define WS_TX_SEND_TIMEOUT_MS 1000
+
+typedef enum
+{
+    WS_TXQ_MSG = 0, // Register and status: small, latest-wins
+    WS_TXQ_VIDEO,   // JPEG frames: disposable
+    WS_TXQ_TELEM,   // Telemetry batches: only drained when the link is idle
+    WS_TXQ_COUNT,
+} ws_txq_class_t;
+
+typedef struct
+{
+    uint8_t *data; // Heap copy owned by the queue
+    size_t len;
+    bool binary;
+} ws_tx_item_t;
+
+static QueueHandle_t s_txq[WS_TXQ_COUNT] = {NULL, NULL, NULL};
+
+// Static backing for the TX queues and task: these outlive every
+// connection, so they sit in BSS instead of competing with frame
+// buffers for heap
+static StaticQueue_t s_txq_buf[WS_TXQ_COUNT];
+static uint8_t s_txq_msg_storage[WS_TXQ_MSG_DEPTH * sizeof(ws_tx_item_t)];
+static uint8_t s_txq_video_storage[WS_TXQ_VIDEO_DEPTH * sizeof(ws_tx_item_t)];
+static uint8_t s_txq_telem_storage[WS_TXQ_TELEM_DEPTH * sizeof(ws_tx_item_t)];
+static StackType_t s_ws_tx_stack[WS_TX_TASK_STACK_SIZE];
+static StaticTask_t s_ws_tx_tcb;
+static tx_done_callback_t s_tx_done_callback = NULL;
+
+// Staging buffer for the incremental encoder's chunked frames (only
+// touched from the stream task, no locking needed)
+static uint8_t *s_chunk_buf = NULL;
+static size_t s_chunk_len = 0;
+static bool s_chunk_poisoned = false;
+
+static void ws_tx_report(esp_err_t result, size_t len)
+{
+    if (s_tx_done_callback)
+    {
+        s_tx_done_callback(result, len);
+    }
+}
+
+/**
+ * @brief Queue a heap buffer for transmission (takes ownership)
+ *
+ * Never blocks: when the class queue is full the oldest entry is
+ * evicted, freed and reported as ESP_ERR_TIMEOUT.
+ */
+static esp_err_t ws_txq_enqueue(ws_txq_class_t cls, uint8_t *owned,
+                                size_t len, bool binary)
+{
+    ws_tx_item_t item = {.data = owned, .len = len, .binary = binary};
+
+    if (s_txq[cls] == NULL)
+    {
+        free(owned);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    while (xQueueSend(s_txq[cls], &item, 0) != pdTRUE)
+    {
+        ws_tx_item_t old;
+        if (xQueueReceive(s_txq[cls], &old, 0) == pdTRUE)
+        {
+            free(old.data);
+            ws_tx_report(ESP_ERR_TIMEOUT, old.len);
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Log an out-of-memory failure with the heap picture attached
+ *
+ * Free vs largest-block at the moment of the failure is what separates
+ * true exhaustion from fragmentation; the 5 s monitor window can miss
+ * the transient that actually killed the allocation.
+ */
+static void ws_log_no_mem(const char *site, size_t bytes)
+{
+    ESP_LOGE(TAG, "%s: sin memoria para %u bytes (libre %u, mayor bloque %u)",
+             site, (unsigned)bytes,
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+/**
+ * @brief Copy a buffer and queue it for transmission
+ */
+static esp_err_t ws_txq_enqueue_copy(ws_txq_class_t cls, const void *data,
+                                     size_t len, bool binary)
+{
+    uint8_t *copy = malloc(len);
+    if (copy == NULL)
+    {
+        ws_log_no_mem(cls == WS_TXQ_VIDEO ? "tx video" : "tx mensaje", len);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, data, len);
+    return ws_txq_enqueue(cls, copy, len, binary);
+}
+
+// Peak payload sizes actually seen on each side of the link, for
+// checking the asymmetric buffer split against reality (the RX side
+// used to carry a 32 KB buffer for ~200-byte JSON)
+static uint32_t s_tx_highwater = 0;
+static uint32_t s_rx_highwater = 0;
+
+static void ws_tx_send_item(ws_tx_item_t *item)
+{
+    esp_err_t result;
+
+    if ((uint32_t)item->len > s_tx_highwater)
+    {
+        s_tx_highwater = (uint32_t)item->len;
+    }
+
+    if (!ws_client_is_connected())
+    {
+        result = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        int sent;
+        if (item->binary)
+        {
+            // Queue items own their heap copy and are freed right after
+            // the send, so the in-place path can mask the payload where
+            // it sits: no staging copy through the client's tx_buffer,
+            // and fragments sized to fit one TCP segment each
+            sent = esp_websocket_client_send_bin_inplace(s_client, (char *)item->data,
+                                                         item->len, WS_TX_FRAGMENT_SIZE,
+                                                         pdMS_TO_TICKS(WS_TX_SEND_TIMEOUT_MS));
+        }
+        else
+        {
+            sent = esp_websocket_client_send_text(s_client, (const char *)item->data,
+                                                  item->len,
+                                                  pdMS_TO_TICKS(WS_TX_SEND_TIMEOUT_MS));
+        }
+        result = (sent < 0) ? ESP_FAIL : ESP_OK;
+    }
+
+    if (result != ESP_OK)
+    {
+        ESP_LOGD(TAG, "Queued %s of %d bytes not delivered: %s",
+                 item->binary ? "binary" : "text", (int)item->len,
+                 esp_err_to_name(result));
+    }
+
+    free(item->data);
+    ws_tx_report(result, item->len);
+}
+
+/**
+ * @brief Emit a clock-sync ping when the interval elapsed
+ *
+ * Runs on the TX task, so the (bounded) blocking send is fine here and
+ * the ping cannot get stuck behind a queued video frame.
+ */
+static void ws_clock_maybe_ping(void)
+{
+    static uint32_t s_last_ping_ms = 0;
+
+    uint32_t now = local_ms();
+    if (!ws_client_is_connected() ||
+        (s_clock_synced && now - s_last_ping_ms < WS_CLOCK_SYNC_INTERVAL_MS) ||
+        (!s_clock_synced && now - s_last_ping_ms < 1000))
+    {
+        return;
+    }
+    s_last_ping_ms = now;
+
+    char ping[64];
+    int n = snprintf(ping, sizeof(ping),
+                     "{\"type\":\"time_ping\",\"t0\":%lu}", (unsigned long)now);
+    if (n > 0 && n < (int)sizeof(ping))
+    {
+        esp_websocket_client_send_text(s_client, ping, (size_t)n,
+                                       pdMS_TO_TICKS(WS_TX_SEND_TIMEOUT_MS));
+    }
+}
+
+/**
+ * @brief Arm the next reconnect attempt with exponential backoff
+ *
+ * Each consecutive failure doubles the delay up to WS_RECONNECT_MAX_MS;
+ * a ±25% jitter keeps several vehicles that lost the same AP from
+ * retrying in lockstep.
+ */
+static void ws_schedule_reconnect(void)
+{
+    if (s_reconnect_backoff_ms == 0)
+    {
+        s_reconnect_backoff_ms = WS_RECONNECT_MIN_MS;
+    }
+    else if (s_reconnect_backoff_ms < WS_RECONNECT_MAX_MS)
+    {
+        s_reconnect_backoff_ms *= 2;
+        if (s_reconnect_backoff_ms > WS_RECONNECT_MAX_MS)
+        {
+            s_reconnect_backoff_ms = WS_RECONNECT_MAX_MS;
+        }
+    }
+
+    uint32_t jitter_span = s_reconnect_backoff_ms / 2;
+    uint32_t delay = s_reconnect_backoff_ms - s_reconnect_backoff_ms / 4 +
+                     (jitter_span ? esp_random() % jitter_span : 0);
+
+    s_reconnect_at_ms = local_ms() + delay;
+    s_reconnect_pending = true;
+    s_connect_failures++;
+    ESP_LOGI(TAG, "Reintento de conexión en %lu ms", (unsigned long)delay);
+}
+
+/**
+ * @brief Restart the client when a scheduled reconnect is due
+ *
+ * Runs on the TX task: esp_websocket_client_stop() must never be called
+ * from the event handler, and here a blocking restart only delays video
+ * that has nowhere to go anyway.
+ */
+static void ws_reconnect_maybe(void)
+{
+    if (!s_reconnect_pending || s_client == NULL || s_is_connected)
+    {
+        return;
+    }
+    if ((int32_t)(local_ms() - s_reconnect_at_ms) < 0)
+    {
+        return;
+    }
+    s_reconnect_pending = false;
+
+    ESP_LOGI(TAG, "Reintentando conexión WebSocket...");
+    esp_websocket_client_stop(s_client);
+
+    // After enough consecutive failures the cached address is probably
+    // stale: browse for the advertised service while the client is
+    // stopped (set_uri requires it), and if even the browse fails, fall
+    // back to the compiled-in default rather than retrying a dead URI
+    if (s_connect_failures >= WS_DISCO_FAIL_THRESHOLD)
+    {
+        if (ws_disco_browse())
+        {
+            esp_websocket_client_set_uri(s_client, s_server_uri);
+        }
+        else if (strcmp(s_server_uri, WS_SERVER_URI) != 0)
+        {
+            strncpy(s_server_uri, WS_SERVER_URI, sizeof(s_server_uri) - 1);
+            s_server_uri[sizeof(s_server_uri) - 1] = '\0';
+            ESP_LOGW(TAG, "Volviendo a la URI por defecto: %s", s_server_uri);
+            esp_websocket_client_set_uri(s_client, s_server_uri);
+        }
+    }
+
+    if (esp_websocket_client_start(s_client) != ESP_OK)
+    {
+        ws_schedule_reconnect();
+    }
+}
+
+static void ws_tx_task(void *arg)
+{
+    (void)arg;
+    ws_tx_item_t item;
+
+    for (;;)
+    {
+        ws_clock_maybe_ping();
+        ws_reconnect_maybe();
+
+        // Small messages always jump ahead of queued video
+        if (xQueueReceive(s_txq[WS_TXQ_MSG], &item, pdMS_TO_TICKS(20)) == pdTRUE)
+        {
+            ws_tx_send_item(&item);
+            continue;
+        }
+        if (xQueueReceive(s_txq[WS_TXQ_VIDEO], &item, 0) == pdTRUE)
+        {
+            ws_tx_send_item(&item);
+            continue;
+        }
+        // Nada de control ni de video pendiente: el enlace está ocioso,
+        // recién ahí salen los lotes de telemetría
+        if (xQueueReceive(s_txq[WS_TXQ_TELEM], &item, 0) == pdTRUE)
+        {
+            ws_tx_send_item(&item);
+        }
+    }
+}
+
+static esp_err_t ws_tx_queue_start(void)
+{
+    if (s_txq[WS_TXQ_MSG] != NULL)
+    {
+        return ESP_OK;
+    }
+
+    s_txq[WS_TXQ_MSG] = xQueueCreateStatic(WS_TXQ_MSG_DEPTH, sizeof(ws_tx_item_t),
+                                           s_txq_msg_storage, &s_txq_buf[WS_TXQ_MSG]);
+    s_txq[WS_TXQ_VIDEO] = xQueueCreateStatic(WS_TXQ_VIDEO_DEPTH, sizeof(ws_tx_item_t),
+                                             s_txq_video_storage, &s_txq_buf[WS_TXQ_VIDEO]);
+    s_txq[WS_TXQ_TELEM] = xQueueCreateStatic(WS_TXQ_TELEM_DEPTH, sizeof(ws_tx_item_t),
+                                             s_txq_telem_storage, &s_txq_buf[WS_TXQ_TELEM]);
+
+    // Core 0 next to the WiFi stack; vision owns core 1
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(ws_tx_task, "ws_tx",
+                                                        WS_TX_TASK_STACK_SIZE, NULL,
+                                                        WS_TX_TASK_PRIORITY,
+                                                        s_ws_tx_stack, &s_ws_tx_tcb, 0);
+    return (handle != NULL) ? ESP_OK : ESP_FAIL;
+}
+
+void ws_client_set_tx_done_callback(tx_done_callback_t callback)
+{
+    s_tx_done_callback = callback;
+}
+
+/**
+ * @brief Bounce a latency probe back through the message queue
+ *
+ * Echoes probe_id and the dashboard's t0, and adds our receive time
+ * plus the server→vehicle age measured against the synced server clock
+ * (-1 when the clock handshake has not completed yet).
+ */
+static void handle_latency_probe(const cJSON *root)
+{
+    const cJSON *id_item = cJSON_GetObjectItem(root, "probe_id");
+    const cJSON *t0_item = cJSON_GetObjectItem(root, "t0");
+    const cJSON *relay_item = cJSON_GetObjectItem(root, "relay_ms");
+
+    if (!id_item || !cJSON_IsNumber(id_item))
+    {
+        return;
+    }
+
+    uint32_t recv = local_ms();
+    long long uplink_age_ms = -1;
+    if (s_clock_synced && relay_item && cJSON_IsNumber(relay_item))
+    {
+        uplink_age_ms = (long long)((int64_t)recv + s_clock_offset_ms -
+                                    (int64_t)(uint32_t)relay_item->valuedouble);
+    }
+
+    char report[160];
+    int n = snprintf(report, sizeof(report),
+                     "{\"type\":\"latency_report\",\"probe_id\":%lu,"
+                     "\"t0\":%.0f,\"recv_ms\":%lu,\"uplink_age_ms\":%lld}",
+                     (unsigned long)(uint32_t)id_item->valuedouble,
+                     (t0_item && cJSON_IsNumber(t0_item)) ? t0_item->valuedouble : 0.0,
+                     (unsigned long)recv,
+                     uplink_age_ms);
+    if (n > 0 && n < (int)sizeof(report))
+    {
+        ws_txq_enqueue_copy(WS_TXQ_MSG, report, (size_t)n, false);
+    }
+}
+
+/**
+ * @brief Queue a cmd_ack echoing a command's sequence number
+ *
+ * Rides the message queue ahead of queued video like every other small
+ * message; the server matches it against its pending table to close
+ * the server→vehicle delivery stats.
+ */
+static void ws_send_cmd_ack(uint32_t seq)
+{
+    char ack[64];
+    int n = snprintf(ack, sizeof(ack),
+                     "{\"type\":\"cmd_ack\",\"seq\":%lu}", (unsigned long)seq);
+    if (n > 0 && n < (int)sizeof(ack))
+    {
+        ws_txq_enqueue_copy(WS_TXQ_MSG, ack, (size_t)n, false);
+    }
+}
+
+/**
+ * @brief Dump the trace ring for the unified timeline
+ *
+ * Timestamps go out converted to the server clock with the offset from
+ * the time_ping handshake, so the dashboard can merge them with the
+ * server's own event window without a second sync step. Before the
+ * first sync completes the local values are sent as-is and flagged.
+ */
+static void handle_trace_dump(void)
+{
+    trace_record_t records[32];
+    int count = trace_log_recent(records, 32);
+
+    // Static: only the websocket event task builds dumps, and the TX
+    // queue copies the payload before this returns
+    static char buf[2048];
+    int len = snprintf(buf, sizeof(buf),
+                       "{\"type\":\"trace_events\",\"source\":\"%s\","
+                       "\"synced\":%d,\"events\":[",
+                       s_vehicle_id, s_clock_synced ? 1 : 0);
+    for (int i = 0; i < count && len < (int)sizeof(buf); i++)
+    {
+        int64_t t = (int64_t)records[i].t_ms;
+        if (s_clock_synced)
+        {
+            t += s_clock_offset_ms;
+        }
+        len += snprintf(buf + len, sizeof(buf) - (size_t)len,
+                        "%s[%lld,%u,%ld,%ld]",
+                        (i > 0) ? "," : "",
+                        (long long)t,
+                        records[i].code,
+                        (long)records[i].arg1,
+                        (long)records[i].arg2);
+    }
+    if (len < (int)sizeof(buf))
+    {
+        len += snprintf(buf + len, sizeof(buf) - (size_t)len, "]}");
+    }
+    if (len > 0 && len < (int)sizeof(buf))
+    {
+        ws_txq_enqueue_copy(WS_TXQ_MSG, buf, (size_t)len, false);
+    }
+}
+
+/**
+ * @brief Ship the flight recorder contents over the WebSocket
+ *
+ * Records go out as JSON batches with the same clock conversion as
+ * trace_dump; retained thumbnails follow as 'B','X' binary frames
+ * (slot, synced flag, 8-byte timestamp, JPEG). The recorder stays
+ * frozen until an explicit blackbox_resume message.
+ */
+static void handle_blackbox_dump(void)
+{
+    // Batches of 32 keep each JSON message under the 2 KB dump buffer
+    static bb_record_t recs[256];
+    static char buf[2048];
+
+    int total = blackbox_recent(recs, 256);
+    ESP_LOGI(TAG, "Enviando blackbox: %d registros", total);
+
+    for (int base = 0; base < total; base += 32)
+    {
+        int n = total - base;
+        if (n > 32)
+        {
+            n = 32;
+        }
+
+        int len = snprintf(buf, sizeof(buf),
+                           "{\"type\":\"blackbox_events\",\"source\":\"%s\","
+                           "\"synced\":%d,\"frozen\":%d,\"events\":[",
+                           s_vehicle_id, s_clock_synced ? 1 : 0,
+                           blackbox_is_frozen() ? 1 : 0);
+        for (int i = 0; i < n && len < (int)sizeof(buf); i++)
+        {
+            const bb_record_t *r = &recs[base + i];
+            int64_t t = (int64_t)r->t_ms;
+            if (s_clock_synced)
+            {
+                t += s_clock_offset_ms;
+            }
+            len += snprintf(buf + len, sizeof(buf) - (size_t)len,
+                            "%s[%lld,%u,%d,%ld,%ld]",
+                            (i > 0) ? "," : "",
+                            (long long)t,
+                            r->type,
+                            (int)r->a,
+                            (long)r->b,
+                            (long)r->c);
+        }
+        if (len < (int)sizeof(buf))
+        {
+            len += snprintf(buf + len, sizeof(buf) - (size_t)len, "]}");
+        }
+        if (len > 0 && len < (int)sizeof(buf))
+        {
+            ws_txq_enqueue_copy(WS_TXQ_MSG, buf, (size_t)len, false);
+        }
+    }
+
+    for (int i = 0; i < BB_THUMB_SLOTS; i++)
+    {
+        const uint8_t *jpeg;
+        size_t jpeg_len;
+        uint32_t t_ms;
+        if (!blackbox_thumb_get(i, &jpeg, &jpeg_len, &t_ms))
+        {
+            continue;
+        }
+
+        // Per-thumbnail header so the dashboard can order them; sent on
+        // the message queue, not the disposable video one
+        uint8_t *frame = malloc(12 + jpeg_len);
+        if (frame == NULL)
+        {
+            ws_log_no_mem("blackbox thumb", 12 + jpeg_len);
+            break;
+        }
+        int64_t t = (int64_t)t_ms;
+        if (s_clock_synced)
+        {
+            t += s_clock_offset_ms;
+        }
+        frame[0] = 'B';
+        frame[1] = 'X';
+        frame[2] = (uint8_t)i;
+        frame[3] = s_clock_synced ? 1 : 0;
+        memcpy(&frame[4], &t, sizeof(t));
+        memcpy(&frame[12], jpeg, jpeg_len);
+
+        ws_txq_enqueue_copy(WS_TXQ_MSG, frame, 12 + jpeg_len, true);
+        free(frame);
+    }
+}
+
+// ============================================================================
+// DATASET CAPTURE CONTROL AND DOWNLOAD
+// ============================================================================
+// The vehicle has no HTTP server, so the dataset partition is pulled
+// over this same WebSocket: the tuning script toggles capture with
+// dataset_capture, polls dataset_info for the committed byte count,
+// then walks the partition with dataset_fetch requests. Fetch replies
+// are 'D','S' binary frames (chunk offset, then raw partition bytes)
+// so the payload never passes through JSON.
+
+#define WS_DATASET_FETCH_CHUNK 4096
+
+static void handle_dataset_capture_message(const cJSON *root)
+{
+    const cJSON *enabled_item = cJSON_GetObjectItem(root, "enabled");
+    bool enabled = false;
+
+    if (enabled_item != NULL)
+    {
+        if (cJSON_IsBool(enabled_item))
+        {
+            enabled = cJSON_IsTrue(enabled_item);
+        }
+        else if (cJSON_IsNumber(enabled_item))
+        {
+            enabled = (enabled_item->valuedouble != 0);
+        }
+    }
+
+    if (enabled)
+    {
+        dataset_capture_start();
+    }
+    else
+    {
+        dataset_capture_stop();
+    }
+    ws_send_dataset_info();
+}
+
+static void ws_send_dataset_info(void)
+{
+    uint32_t bytes, records, dropped, capacity;
+    dataset_capture_get_info(&bytes, &records, &dropped, &capacity);
+
+    char info[192];
+    int n = snprintf(info, sizeof(info),
+                     "{\"type\":\"dataset_info\",\"active\":%d,\"bytes\":%lu,"
+                     "\"records\":%lu,\"dropped\":%lu,\"capacity\":%lu}",
+                     dataset_capture_is_active() ? 1 : 0,
+                     (unsigned long)bytes, (unsigned long)records,
+                     (unsigned long)dropped, (unsigned long)capacity);
+    if (n > 0 && n < (int)sizeof(info))
+    {
+        ws_txq_enqueue_copy(WS_TXQ_MSG, info, (size_t)n, false);
+    }
+}
+
+static void handle_dataset_fetch_message(const cJSON *root)
+{
+    const cJSON *offset_item = cJSON_GetObjectItem(root, "offset");
+    if (offset_item == NULL || !cJSON_IsNumber(offset_item))
+    {
+        return;
+    }
+    uint32_t offset = (uint32_t)offset_item->valuedouble;
+
+    // Header: magic, then the echoed offset so out-of-order frames
+    // reassemble; a zero-payload frame marks end of data
+    uint8_t *frame = malloc(8 + WS_DATASET_FETCH_CHUNK);
+    if (frame == NULL)
+    {
+        ws_log_no_mem("dataset fetch", 8 + WS_DATASET_FETCH_CHUNK);
+        return;
+    }
+
+    frame[0] = 'D';
+    frame[1] = 'S';
+    frame[2] = 0;
+    frame[3] = 0;
+    memcpy(&frame[4], &offset, sizeof(offset));
+
+    int got = dataset_capture_read(offset, frame + 8, WS_DATASET_FETCH_CHUNK);
+    if (got >= 0)
+    {
+        ws_txq_enqueue_copy(WS_TXQ_MSG, frame, 8 + (size_t)got, true);
+    }
+    free(frame);
+}
+
+// ============================================================================
+// OTA TRANSFER PLUMBING
+// ============================================================================
+// The updater script drives the ota_update module through this link:
+// ota_begin / ota_end / ota_abort arrive as forwarded JSON, the
+// payload as 'O','T' binary frames relayed by the server. The vehicle
+// acks progress with ota_status messages and the updater keeps only a
+// small window in flight, which is what keeps the transfer background
+// traffic instead of a latency spike.
+
+// One ack per this many wire bytes (and one on every state change)
+#define WS_OTA_ACK_INTERVAL (32 * 1024)
+
+static uint32_t s_ota_next_ack = 0;
+
+static void ws_send_ota_status(void)
+{
+    static const char *state_names[] = {"idle", "receiving", "failed"};
+
+    char status[128];
+    int n = snprintf(status, sizeof(status),
+                     "{\"type\":\"ota_status\",\"source\":\"%s\","
+                     "\"state\":\"%s\",\"received\":%lu}",
+                     s_vehicle_id, state_names[ota_update_state()],
+                     (unsigned long)ota_update_received());
+    if (n > 0 && n < (int)sizeof(status))
+    {
+        ws_txq_enqueue_copy(WS_TXQ_MSG, status, (size_t)n, false);
+    }
+}
+
+static void handle_ota_begin_message(const cJSON *root)
+{
+    const cJSON *size_item = cJSON_GetObjectItem(root, "size");
+    const cJSON *crc_item = cJSON_GetObjectItem(root, "crc32");
+    const cJSON *delta_item = cJSON_GetObjectItem(root, "delta");
+
+    if (size_item == NULL || !cJSON_IsNumber(size_item) ||
+        crc_item == NULL || !cJSON_IsNumber(crc_item))
+    {
+        ESP_LOGW(TAG, "ota_begin sin size/crc32 - ignorado");
+        return;
+    }
+
+    bool delta = (delta_item != NULL) &&
+                 (cJSON_IsTrue(delta_item) ||
+                  (cJSON_IsNumber(delta_item) && delta_item->valuedouble != 0));
+
+    ota_update_begin((uint32_t)size_item->valuedouble,
+                     (uint32_t)crc_item->valuedouble, delta);
+    s_ota_next_ack = WS_OTA_ACK_INTERVAL;
+    ws_send_ota_status();
+}
+
+static void ota_restart_cb(void *arg)
 {
-    if (!json_str)
+    (void)arg;
+    esp_restart();
+}
+
+static void handle_ota_end_message(void)
+{
+    esp_err_t err = ota_update_finish();
+    ws_send_ota_status();
+
+    if (err == ESP_OK)
     {
-        return;
+        // Leave the TX task time to flush the final ack before the
+        // link goes down with the reboot
+        ESP_LOGI(TAG, "Reiniciando a la imagen nueva en 2 s...");
+        static esp_timer_handle_t restart_timer = NULL;
+        const esp_timer_create_args_t args = {
+            .callback = ota_restart_cb,
+            .name = "ota_restart",
+        };
+        if (restart_timer == NULL &&
+            esp_timer_create(&args, &restart_timer) != ESP_OK)
+        {
+            esp_restart();
+        }
+        esp_timer_start_once(restart_timer, 2000 * 1000);
     }
+}
 
-    cJSON *root = cJSON_Parse(json_str);
-    if (!root)
+/**
+ * @brief Feed one relayed 'O','T' wire chunk into the transfer
+ */
+static void handle_ota_chunk(const uint8_t *payload, size_t len)
+{
+    if (len <= 4)
     {
-        ESP_LOGW(TAG, "JSON inválido: %s", json_str);
         return;
     }
 
-    const cJSON *type_item = cJSON_GetObjectItem(root, "type");
-    const char *type = (type_item && cJSON_IsString(type_item)) ? type_item->valuestring : NULL;
-
-    if (!type)
+    if (ota_update_feed(payload + 4, len - 4) != ESP_OK)
     {
-        ESP_LOGD(TAG, "Frame sin tipo - ignorado");
-        cJSON_Delete(root);
+        ws_send_ota_status();
         return;
     }
 
-    if (strcmp(type, "stream_status") == 0)
-    {
-        handle_stream_status_message(root);
-    }
-    else if (strcmp(type, "control") == 0)
-    {
-        handle_control_message(root);
-    }
-    else
+    if (ota_update_received() >= s_ota_next_ack)
     {
-        ESP_LOGD(TAG, "Mensaje %s sin handler", type);
+        s_ota_next_ack += WS_OTA_ACK_INTERVAL;
+        ws_send_ota_status();
     }
-
-    cJSON_Delete(root);
 }
 
 static esp_err_t send_register_message(void)
@@ -197,31 +1415,107 @@ static esp_err_t send_register_message(void)
     cJSON_AddStringToObject(root, "type", "register");
     cJSON_AddStringToObject(root, "role", "vehicle");
     cJSON_AddStringToObject(root, "vehicle_id", s_vehicle_id);
+    // Marks re-registrations so the server log distinguishes a blip
+    // from a cold boot; the stream_status reply closes the round trip
+    cJSON_AddBoolToObject(root, "resumed", s_resume_valid);
 
     char *json_str = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
 
     if (!json_str)
     {
+        ws_log_no_mem("cJSON registro", 0);
+        json_arena_reset();
         return ESP_ERR_NO_MEM;
     }
 
-    int sent = esp_websocket_client_send_text(s_client, json_str, strlen(json_str), portMAX_DELAY);
-    free(json_str);
+    // The arena reclaims json_str on reset, so the queue gets its own
+    // copy; the TX task performs the actual (blocking) send
+    esp_err_t err = ws_txq_enqueue_copy(WS_TXQ_MSG, json_str, strlen(json_str), false);
+    cJSON_free(json_str);
+    json_arena_reset();
 
-    if (sent < 0)
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Error enviando registro de vehículo");
-        return ESP_FAIL;
+        ESP_LOGE(TAG, "Error encolando registro de vehículo");
+        return err;
     }
 
-    ESP_LOGI(TAG, "Registro de vehículo enviado (%s)", s_vehicle_id);
+    ESP_LOGI(TAG, "Registro de vehículo encolado (%s)", s_vehicle_id);
     return ESP_OK;
 }
 
 /**
  * @brief WebSocket event handler
  */
+// ============================================================================
+// SAFETY FAST PATH
+// ============================================================================
+// A stop used to traverse event handler -> scratch copy -> cJSON ->
+// callback -> command mailbox -> control task wakeup -> state machine
+// -> motor write: seven hops for the one command whose latency is a
+// safety property. Safety-class commands are now recognized by a raw
+// byte scan right in the event context and the motors brake before any
+// parsing happens; the normal path still runs afterwards so control
+// state, delivery acks and latency accounting stay consistent (the
+// stop latch in main.c makes the re-application idempotent).
+
+/**
+ * @brief Find a token in a non-NUL-terminated payload
+ */
+static const char *ws_payload_find(const char *data, int len,
+                                   const char *token, int token_len)
+{
+    for (int i = 0; i + token_len <= len; i++)
+    {
+        if (data[i] == token[0] && memcmp(data + i, token, token_len) == 0)
+        {
+            return data + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Brake immediately if the raw frame is a stop addressed to us
+ *
+ * Matches the exact pair the dashboard and server serialize
+ * ("command":"stop"); a false negative just leaves the normal path to
+ * deliver the stop, and no other control verb contains the token. The
+ * vehicle_id filter mirrors handle_control_message: "*" is the fleet
+ * wildcard, and a missing id means broadcast.
+ */
+static void safety_fast_path(const char *data, int len)
+{
+    static const char k_stop[] = "\"command\":\"stop\"";
+    static const char k_vehicle[] = "\"vehicle_id\":\"";
+
+    if (ws_payload_find(data, len, k_stop, (int)sizeof(k_stop) - 1) == NULL)
+    {
+        return;
+    }
+
+    const char *id = ws_payload_find(data, len, k_vehicle,
+                                     (int)sizeof(k_vehicle) - 1);
+    if (id != NULL && s_vehicle_id[0] != '\0')
+    {
+        id += sizeof(k_vehicle) - 1;
+        int remain = len - (int)(id - data);
+        int own_len = (int)strlen(s_vehicle_id);
+        bool wildcard = (remain >= 2 && id[0] == '*' && id[1] == '"');
+        bool ours = (remain >= own_len + 1 &&
+                     memcmp(id, s_vehicle_id, own_len) == 0 &&
+                     id[own_len] == '"');
+        if (!wildcard && !ours)
+        {
+            return; // Stop for another vehicle; ours keeps driving
+        }
+    }
+
+    motor_emergency_stop();
+    ESP_LOGW(TAG, "Stop aplicado por el camino rápido (contexto de evento WS)");
+}
+
 static void websocket_event_handler(void *handler_args, esp_event_base_t base,
                                     int32_t event_id, void *event_data)
 {
@@ -232,46 +1526,122 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base,
     case WEBSOCKET_EVENT_CONNECTED:
         ESP_LOGI(TAG, "WebSocket connected to server");
         s_is_connected = true;
-        s_stream_enabled = false;
+        s_reconnect_pending = false;
+        s_reconnect_backoff_ms = 0;
+        s_connect_failures = 0;
+        ws_disco_cache_store();
+
+        // A freshly flashed OTA image proves itself by reaching this
+        // point; confirm it so the bootloader stops arming rollback
+        ota_update_mark_valid();
+
+        // Resume the stream state that was active before the blip
+        // instead of waiting dark for a fresh stream_status; the
+        // register reply corrects it if viewers left in the meantime
+        if (s_resume_valid)
+        {
+            s_stream_enabled = s_resume_stream_enabled;
+            s_stream_preview = s_resume_stream_preview;
+            if (s_resume_stream_enabled)
+            {
+                ESP_LOGI(TAG, "Stream reanudado tras reconexión");
+            }
+        }
+        else
+        {
+            s_stream_enabled = false;
+        }
+
         if (send_register_message() != ESP_OK)
         {
             ESP_LOGW(TAG, "No se pudo enviar registro del vehículo");
         }
+        if (s_connection_callback)
+        {
+            s_connection_callback(true);
+        }
         break;
 
     case WEBSOCKET_EVENT_DISCONNECTED:
-        ESP_LOGW(TAG, "WebSocket disconnected, will auto-reconnect...");
+        ESP_LOGW(TAG, "WebSocket disconnected, scheduling reconnect...");
+        ESP_LOGI(TAG, "Buffer high-water: TX %lu / RX %lu bytes",
+                 (unsigned long)s_tx_highwater, (unsigned long)s_rx_highwater);
+        // Remember the stream state for the resume path before pausing
+        s_resume_stream_enabled = s_stream_enabled;
+        s_resume_stream_preview = s_stream_preview;
+        s_resume_valid = true;
         s_is_connected = false;
         s_stream_enabled = false;
+        ws_schedule_reconnect();
+        if (s_connection_callback)
+        {
+            s_connection_callback(false);
+        }
         break;
 
     case WEBSOCKET_EVENT_DATA:
+        TRACE_REGION_ENTER(TRACE_ID_WS_EVENT);
         ESP_LOGD(TAG, "Received WebSocket data: opcode=%d, len=%d",
                  data->op_code, data->data_len);
 
+        if ((uint32_t)data->payload_len > s_rx_highwater)
+        {
+            s_rx_highwater = (uint32_t)data->payload_len;
+        }
+
         if (data->op_code == 0x01)
         { // Text frame (JSON control / status)
-            char *json_str = malloc(data->data_len + 1);
-            if (json_str)
+            // Safety-class commands brake here, before any copy or parse
+            safety_fast_path(data->data_ptr, data->data_len);
+            // Control messages arrive several times per second; copying
+            // into a permanent scratch buffer just to NUL-terminate
+            // keeps the whole inbound path off the heap. Anything
+            // larger than the scratch (no known message comes close)
+            // falls back to a one-off malloc instead of being dropped.
+            static char s_rx_scratch[WS_RX_SCRATCH_SIZE];
+            if (data->data_len < (int)sizeof(s_rx_scratch))
             {
-                memcpy(json_str, data->data_ptr, data->data_len);
-                json_str[data->data_len] = '\0';
-
-                handle_text_frame(json_str);
-
-                free(json_str);
+                memcpy(s_rx_scratch, data->data_ptr, data->data_len);
+                s_rx_scratch[data->data_len] = '\0';
+                handle_text_frame(s_rx_scratch);
+            }
+            else
+            {
+                char *json_str = malloc(data->data_len + 1);
+                if (json_str)
+                {
+                    memcpy(json_str, data->data_ptr, data->data_len);
+                    json_str[data->data_len] = '\0';
+                    handle_text_frame(json_str);
+                    free(json_str);
+                }
             }
         }
         else if (data->op_code == 0x02)
-        { // Binary frame (video)
-            ESP_LOGD(TAG, "Received video frame: %d bytes", data->data_len);
-            // Video frames can be processed here if needed for debugging
+        { // Binary frame
+            // OTA wire chunks are the only binary traffic addressed to
+            // the vehicle; chunks are sized to arrive unfragmented
+            if (data->data_len >= 2 && data->payload_len == data->data_len &&
+                data->data_ptr[0] == 'O' && data->data_ptr[1] == 'T')
+            {
+                handle_ota_chunk((const uint8_t *)data->data_ptr,
+                                 (size_t)data->data_len);
+            }
+            else
+            {
+                ESP_LOGD(TAG, "Received binary frame: %d bytes", data->data_len);
+            }
         }
+        TRACE_REGION_EXIT(TRACE_ID_WS_EVENT);
         break;
 
     case WEBSOCKET_EVENT_ERROR:
         ESP_LOGE(TAG, "WebSocket error occurred");
         s_is_connected = false;
+        if (s_connection_callback)
+        {
+            s_connection_callback(false);
+        }
         break;
 
     default:
@@ -293,12 +1663,45 @@ esp_err_t ws_client_init(const char *vehicle_id, control_callback_t callback)
     strncpy(s_vehicle_id, vehicle_id, sizeof(s_vehicle_id) - 1);
     s_vehicle_id[sizeof(s_vehicle_id) - 1] = '\0';
 
-    // Configure WebSocket client
+    // All cJSON trees from here on allocate from per-task arenas
+    json_arena_register_hooks();
+
+    // Cache-first server discovery: a normal boot reuses the last URI
+    // that worked without waiting on an mDNS browse
+    ws_disco_init();
+
+    // Configure WebSocket client. The library's fixed-interval
+    // reconnect is disabled: the TX task schedules retries with
+    // exponential backoff instead
+    // Asymmetric, right-sized buffers: binary payloads are sent in
+    // place from their queue items, so the TX staging buffer only has
+    // to fit text JSON, and the receive side only ever sees small
+    // control messages. The old symmetric 32 KB pair wasted ~60 KB of
+    // internal heap
     esp_websocket_client_config_t ws_cfg = {
-        .uri = WS_SERVER_URI,
-        .reconnect_timeout_ms = WS_RECONNECT_TIMEOUT_MS,
-        .network_timeout_ms = 10000,
-        .buffer_size = WS_MAX_PAYLOAD_SIZE,
+        .uri = s_server_uri,
+        .disable_auto_reconnect = true,
+        // 10 s aquí era otra fuente de limbo: un send colgado debe
+        // fallar antes de que el backoff pueda rearmar la conexión
+        .network_timeout_ms = 3000,
+        .buffer_size = WS_CLIENT_BUF_SIZE,
+        .rx_buffer_size = WS_RX_SCRATCH_SIZE,
+        // Los acks de comando y el keepalive son frames diminutos; sin
+        // esto Nagle los retiene detrás de los fragmentos de video
+        .tcp_nodelay = true,
+        // Detección agresiva de pérdida de enlace: sin esto la pila
+        // TCP tarda 10+ s en enterarse de que el S3 desapareció,
+        // mientras el dead-man ya frenó a los 750 ms. lwip cuenta el
+        // keepalive en segundos, así que lo más fino posible es
+        // idle 1 s + 2 sondas a 1 s: ~3 s hasta el DISCONNECTED que
+        // dispara nuestra reconexión con backoff. El ping WebSocket
+        // cubre el caso de socket vivo con peer colgado.
+        .keep_alive_enable = true,
+        .keep_alive_idle = 1,
+        .keep_alive_interval = 1,
+        .keep_alive_count = 2,
+        .ping_interval_sec = 1,
+        .pingpong_timeout_sec = 3,
     };
 
     s_client = esp_websocket_client_init(&ws_cfg);
@@ -319,6 +1722,13 @@ esp_err_t ws_client_init(const char *vehicle_id, control_callback_t callback)
         return err;
     }
 
+    err = ws_tx_queue_start();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start WebSocket TX task");
+        return err;
+    }
+
     ESP_LOGI(TAG, "WebSocket client initialized successfully");
     return ESP_OK;
 }
@@ -331,7 +1741,7 @@ esp_err_t ws_client_connect(void)
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Connecting to WebSocket server: %s", WS_SERVER_URI);
+    ESP_LOGI(TAG, "Connecting to WebSocket server: %s", s_server_uri);
 
     esp_err_t err = esp_websocket_client_start(s_client);
     if (err != ESP_OK)
@@ -344,6 +1754,54 @@ esp_err_t ws_client_connect(void)
     return ESP_OK;
 }
 
+// ============================================================================
+// PACKED BINARY STATUS FRAME
+// ============================================================================
+// Status used to be a cJSON tree built, serialized and freed 10 times
+// per second - dozens of mallocs/sec for five fixed fields. It now goes
+// out as a versioned fixed-size binary message filled on the stack:
+// zero heap activity per send. The 'V','S' magic keeps it unambiguous
+// next to JPEG data on the same binary channel; the server forwards it
+// untouched and the dashboard decodes it with a DataView.
+// Layout must match ws_status_msg_t in ws_server.c.
+
+#define WS_STATUS_MAGIC_0 'V'
+#define WS_STATUS_MAGIC_1 'S'
+#define WS_STATUS_VERSION 4
+#define WS_STATUS_FLAG_VETO 0x01
+
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];      // 'V','S'
+    uint8_t version;       // WS_STATUS_VERSION
+    uint8_t flags;         // Bit 0: local veto active
+    int16_t motor_left;    // -255..255, little-endian
+    int16_t motor_right;   // -255..255, little-endian
+    uint16_t battery_mv;   // Battery voltage in mV
+    int32_t vision_age_ms; // Age of vision data (-1 if no frame yet)
+    char vehicle_id[16];   // NUL-terminated/padded
+    char status[16];       // "moving", "stopped", ...
+    uint16_t cmd_p50_us;   // v2: receipt-to-PWM actuation latency
+    uint16_t cmd_p95_us;   //     percentiles and worst sample in us,
+    uint16_t cmd_max_us;   //     capped at 65535
+    uint16_t heap_free_kb; // v3: heap health per capability - free and
+    uint16_t heap_largest_kb; // largest single block, KB, internal then
+    uint16_t psram_free_kb;   // SPIRAM. The largest/free ratio is the
+    uint16_t psram_largest_kb; // fragmentation telltale.
+    uint8_t qos_shed;         // v4: load-shedding level (QOS_SHED_*)
+    uint8_t reserved;         //     keeps the struct 16-bit aligned
+} ws_status_msg_t;
+
+// Clamp a non-negative sample to the u16 wire field
+static uint16_t ws_status_u16(int value)
+{
+    if (value < 0)
+    {
+        return 0;
+    }
+    return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
 esp_err_t ws_client_send_status(const vehicle_status_t *status)
 {
     if (s_client == NULL || !s_is_connected)
@@ -352,46 +1810,192 @@ esp_err_t ws_client_send_status(const vehicle_status_t *status)
         return ESP_FAIL;
     }
 
-    // Create JSON object
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "vehicle_id", status->vehicle_id);
+    ws_status_msg_t msg = {
+        .magic = {WS_STATUS_MAGIC_0, WS_STATUS_MAGIC_1},
+        .version = WS_STATUS_VERSION,
+        .flags = status->veto_active ? WS_STATUS_FLAG_VETO : 0,
+        .motor_left = (int16_t)status->motor_left,
+        .motor_right = (int16_t)status->motor_right,
+        .battery_mv = (uint16_t)status->battery_mv,
+        // Age of the vision data behind the veto: the base of all the
+        // end-to-end latency accounting
+        .vision_age_ms = (int32_t)status->vision_age_ms,
+        .cmd_p50_us = ws_status_u16(status->cmd_p50_us),
+        .cmd_p95_us = ws_status_u16(status->cmd_p95_us),
+        .cmd_max_us = ws_status_u16(status->cmd_max_us),
+        .heap_free_kb = ws_status_u16(status->heap_free_kb),
+        .heap_largest_kb = ws_status_u16(status->heap_largest_kb),
+        .psram_free_kb = ws_status_u16(status->psram_free_kb),
+        .psram_largest_kb = ws_status_u16(status->psram_largest_kb),
+        .qos_shed = (uint8_t)status->qos_shed,
+        .reserved = 0,
+    };
+    strncpy(msg.vehicle_id, status->vehicle_id, sizeof(msg.vehicle_id) - 1);
+    strncpy(msg.status, status->status, sizeof(msg.status) - 1);
 
-    cJSON *motors = cJSON_CreateObject();
-    cJSON_AddNumberToObject(motors, "left", status->motor_left);
-    cJSON_AddNumberToObject(motors, "right", status->motor_right);
-    cJSON_AddItemToObject(root, "motors", motors);
+    // Hand off to the TX task: the 100 ms status cadence must never
+    // block on the TCP window of a congested AP
+    return ws_txq_enqueue_copy(WS_TXQ_MSG, &msg, sizeof(msg), true);
+}
 
-    cJSON_AddNumberToObject(root, "battery_mv", status->battery_mv);
-    cJSON_AddStringToObject(root, "status", status->status);
+esp_err_t ws_client_send_veto_event(bool active, float distance_cm,
+                                    int centroid_x, int centroid_y)
+{
+    if (s_client == NULL || !s_is_connected)
+    {
+        return ESP_FAIL;
+    }
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (json_str == NULL)
+    // Fires from vision task context on a veto transition: flat snprintf
+    // JSON and a non-blocking queue handoff, nothing that can stall the
+    // frame being processed
+    char msg[160];
+    int n = snprintf(msg, sizeof(msg),
+                     "{\"type\":\"veto_event\",\"vehicle_id\":\"%s\","
+                     "\"active\":%s,\"distance_cm\":%.1f,"
+                     "\"cx\":%d,\"cy\":%d,\"timestamp\":%lu}",
+                     s_vehicle_id, active ? "true" : "false",
+                     (double)distance_cm, centroid_x, centroid_y,
+                     (unsigned long)(esp_timer_get_time() / 1000));
+    if (n <= 0 || n >= (int)sizeof(msg))
     {
-        cJSON_Delete(root);
-        ESP_LOGE(TAG, "Failed to serialize JSON");
         return ESP_FAIL;
     }
 
-    ESP_LOGD(TAG, "Sending status: %s", json_str);
+    return ws_txq_enqueue_copy(WS_TXQ_MSG, msg, (size_t)n, false);
+}
+
+esp_err_t ws_client_send_task_stats(const task_stats_entry_t *entries, int count)
+{
+    if (entries == NULL || count <= 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_client == NULL || !s_is_connected)
+    {
+        return ESP_FAIL;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    cJSON_AddStringToObject(root, "type", "task_stats");
 
-    // Send as text frame
-    int sent = esp_websocket_client_send_text(s_client, json_str, strlen(json_str), portMAX_DELAY);
+    // Arrays instead of per-task objects: with ~20 tasks the repeated
+    // key names would outweigh the data itself
+    cJSON *tasks = cJSON_AddArrayToObject(root, "tasks");
+    for (int i = 0; i < count && i < TASK_STATS_MAX; i++)
+    {
+        cJSON *entry = cJSON_CreateArray();
+        cJSON_AddItemToArray(entry, cJSON_CreateString(entries[i].name));
+        cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].cpu_permille));
+        cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].stack_hwm));
+        cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].core));
+        cJSON_AddItemToArray(entry, cJSON_CreateNumber(entries[i].priority));
+        cJSON_AddItemToArray(tasks, entry);
+    }
 
-    free(json_str);
+    char *json_str = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
 
-    if (sent < 0)
+    if (!json_str)
+    {
+        ws_log_no_mem("cJSON task_stats", 0);
+        json_arena_reset();
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ws_txq_enqueue_copy(WS_TXQ_MSG, json_str, strlen(json_str), false);
+    cJSON_free(json_str);
+    json_arena_reset();
+    return err;
+}
+
+esp_err_t ws_client_send_telemetry(const uint8_t *batch, size_t length)
+{
+    if (batch == NULL || length == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_client == NULL || !s_is_connected)
     {
-        ESP_LOGE(TAG, "Failed to send WebSocket message");
         return ESP_FAIL;
     }
 
-    return ESP_OK;
+    // Clase ociosa: el lote espera a que no haya ni mensajes ni video
+    // pendientes, y si la cola se llena el lote más viejo se descarta
+    return ws_txq_enqueue_copy(WS_TXQ_TELEM, batch, length, true);
 }
 
 bool ws_client_stream_enabled(void)
 {
-    return s_stream_enabled;
+    // Shed level 3 suspends the stream without touching s_stream_enabled,
+    // so the viewer's request survives the episode and video resumes by
+    // itself when the governor recovers
+    return s_stream_enabled && s_qos_shed < QOS_SHED_STREAM_OFF;
+}
+
+void ws_client_set_capture_config_callback(capture_config_callback_t callback)
+{
+    s_capture_config_callback = callback;
+}
+
+void ws_client_set_hsv_config_callback(hsv_config_callback_t callback)
+{
+    s_hsv_config_callback = callback;
+}
+
+void ws_client_set_connection_callback(connection_callback_t callback)
+{
+    s_connection_callback = callback;
+}
+
+bool ws_client_stream_preview(void)
+{
+    return s_stream_preview;
+}
+
+int ws_client_stream_max_fps(void)
+{
+    int fps = s_stream_max_fps;
+    if (s_qos_shed >= QOS_SHED_FPS &&
+        (fps == 0 || fps > QOS_SHED_MAX_FPS))
+    {
+        fps = QOS_SHED_MAX_FPS;
+    }
+    return fps;
+}
+
+int ws_client_stream_jpeg_quality(void)
+{
+    int quality = s_stream_jpeg_q;
+    if (s_qos_shed >= QOS_SHED_JPEG_Q &&
+        (quality == 0 || quality > QOS_SHED_JPEG_QUALITY))
+    {
+        quality = QOS_SHED_JPEG_QUALITY;
+    }
+    return quality;
+}
+
+void ws_client_set_qos_shed(int level)
+{
+    if (level < QOS_SHED_NONE)
+    {
+        level = QOS_SHED_NONE;
+    }
+    if (level > QOS_SHED_STATUS)
+    {
+        level = QOS_SHED_STATUS;
+    }
+    s_qos_shed = level;
+}
+
+int ws_client_get_qos_shed(void)
+{
+    return s_qos_shed;
 }
 
 esp_err_t ws_client_send_frame(const uint8_t *frame, size_t length)
@@ -419,26 +2023,162 @@ esp_err_t ws_client_send_frame(const uint8_t *frame, size_t length)
         return ESP_ERR_INVALID_SIZE;
     }
 
-    int sent = esp_websocket_client_send_bin(s_client,
-                                             (const char *)frame,
-                                             length,
-                                             pdMS_TO_TICKS(1000));
-    if (sent < 0)
+#if UDP_STREAM_ENABLED
+    // Disposable video goes over datagrams when the channel is up: a
+    // radio loss costs that frame instead of stalling the TCP stream
+    if (udp_stream_ready())
     {
-        ESP_LOGE(TAG, "Error enviando frame binario (%d bytes)", (int)length);
-        return ESP_FAIL;
+        return udp_stream_send_frame(frame, length);
+    }
+#endif
+
+    esp_err_t err = ws_txq_enqueue_copy(WS_TXQ_VIDEO, frame, length, true);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error encolando frame binario (%d bytes)", (int)length);
+        return err;
+    }
+
+    ESP_LOGD(TAG, "Frame binario encolado: %d bytes", (int)length);
+    return ESP_OK;
+}
+
+esp_err_t ws_client_send_frame_chunk(const uint8_t *chunk, size_t length, bool first)
+{
+    if (!chunk || length == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGD(TAG, "Frame binario enviado: %d bytes", sent);
+    if (!ws_client_is_connected() || !ws_client_stream_enabled())
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if UDP_STREAM_ENABLED
+    if (udp_stream_ready())
+    {
+        return udp_stream_send_chunk(chunk, length, first);
+    }
+#endif
+
+    // Partial WS sends cannot be interleaved with messages from the TX
+    // queue without corrupting the stream, so the incremental encoder's
+    // chunks accumulate here and the complete frame is queued as a
+    // single binary message on finish
+    if (first)
+    {
+        if (s_chunk_buf == NULL)
+        {
+            s_chunk_buf = malloc(WS_MAX_PAYLOAD_SIZE);
+            if (s_chunk_buf == NULL)
+            {
+                ws_log_no_mem("buffer de fragmentos", WS_MAX_PAYLOAD_SIZE);
+                return ESP_ERR_NO_MEM;
+            }
+        }
+        s_chunk_len = 0;
+        s_chunk_poisoned = false;
+    }
+
+    if (s_chunk_buf == NULL || s_chunk_poisoned)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_chunk_len + length > WS_MAX_PAYLOAD_SIZE)
+    {
+        ESP_LOGW(TAG, "Frame fragmentado excede %d bytes - descartado",
+                 WS_MAX_PAYLOAD_SIZE);
+        s_chunk_poisoned = true;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(s_chunk_buf + s_chunk_len, chunk, length);
+    s_chunk_len += length;
     return ESP_OK;
 }
 
+esp_err_t ws_client_send_frame_finish(void)
+{
+    if (!ws_client_is_connected())
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if UDP_STREAM_ENABLED
+    if (udp_stream_ready())
+    {
+        return udp_stream_send_finish();
+    }
+#endif
+
+    if (s_chunk_buf == NULL || s_chunk_len == 0 || s_chunk_poisoned)
+    {
+        s_chunk_len = 0;
+        s_chunk_poisoned = false;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ws_txq_enqueue_copy(WS_TXQ_VIDEO, s_chunk_buf,
+                                        s_chunk_len, true);
+    s_chunk_len = 0;
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error encolando frame fragmentado");
+    }
+    return err;
+}
+
 bool ws_client_is_connected(void)
 {
     return s_is_connected && (s_client != NULL) &&
            esp_websocket_client_is_connected(s_client);
 }
 
+void ws_client_get_buffer_highwater(uint32_t *tx_bytes, uint32_t *rx_bytes)
+{
+    if (tx_bytes)
+    {
+        *tx_bytes = s_tx_highwater;
+    }
+    if (rx_bytes)
+    {
+        *rx_bytes = s_rx_highwater;
+    }
+}
+
+uint32_t ws_client_get_deadman_timeout_ms(void)
+{
+    if (s_rtt_count == 0)
+    {
+        return WS_DEADMAN_DEFAULT_MS;
+    }
+
+    uint32_t rtt_high = 0;
+    for (uint8_t i = 0; i < s_rtt_count; i++)
+    {
+        if (s_rtt_window_ms[i] > rtt_high)
+        {
+            rtt_high = s_rtt_window_ms[i];
+        }
+    }
+
+    // One keepalive period must always fit, plus four worst-case round
+    // trips of slack for the "ka" that is in flight when the timer arms
+    uint32_t timeout = WS_KEEPALIVE_INTERVAL_MS + 4 * rtt_high;
+    if (timeout < WS_DEADMAN_FLOOR_MS)
+    {
+        timeout = WS_DEADMAN_FLOOR_MS;
+    }
+    else if (timeout > WS_DEADMAN_CEIL_MS)
+    {
+        timeout = WS_DEADMAN_CEIL_MS;
+    }
+    return timeout;
+}
+
 esp_err_t ws_client_disconnect(void)
 {
     if (s_client == NULL)
@@ -449,6 +2189,8 @@ esp_err_t ws_client_disconnect(void)
     ESP_LOGI(TAG, "Disconnecting WebSocket client...");
     s_is_connected = false;
     s_stream_enabled = false;
+    s_reconnect_pending = false;
+    s_resume_valid = false;
 
     esp_err_t err = esp_websocket_client_stop(s_client);
     if (err == ESP_OK)
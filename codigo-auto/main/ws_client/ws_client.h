@@ -21,12 +21,54 @@ extern "C"
 {
 #endif
 
+// Compiled-in fallback only: the actual URI comes from the NVS cache of
+// the last successful connection, refreshed by browsing the server's
+// _minitesla._tcp mDNS advertisement when connects keep failing
 #define WS_SERVER_URI "ws://192.168.4.1/ws"
 
 // Maximum sizes
 #define WS_MAX_PAYLOAD_SIZE 32768
 #define WS_TX_BUFFER_SIZE 512
-#define WS_RECONNECT_TIMEOUT_MS 5000
+// Largest control/config JSON the server ever sends, with headroom;
+// bigger frames take a one-off malloc instead of the static scratch
+#define WS_RX_SCRATCH_SIZE 1024
+// Per-fragment payload for in-place binary sends: with the 8-byte
+// masked binary frame header, each fragment fills one TCP segment
+// (MSS 1440) instead of being re-segmented by LwIP
+#define WS_TX_FRAGMENT_SIZE 1432
+// Internal client TX staging buffer: only text JSON passes through it
+// now that binary payloads are sent in place, so it no longer needs to
+// hold a whole JPEG
+#define WS_CLIENT_BUF_SIZE 4096
+// Jittered exponential backoff for reconnects: fast after a blip,
+// gentle on the radio during a real outage
+#define WS_RECONNECT_MIN_MS 500
+#define WS_RECONNECT_MAX_MS 16000
+
+// Adaptive dead-man: keepalive period + 4x the worst recent RTT,
+// clamped. WS_KEEPALIVE_INTERVAL_MS mirrors the "ka" timer in the
+// dashboard (index.html) - keep them in sync.
+#define WS_KEEPALIVE_INTERVAL_MS 500
+#define WS_DEADMAN_FLOOR_MS 600
+#define WS_DEADMAN_CEIL_MS 1500
+#define WS_DEADMAN_DEFAULT_MS 750
+
+// QoS load-shedding ladder. The governor in main.c walks one level per
+// monitor window as heap headroom, core-1 CPU share or vision frame age
+// degrade, so what breaks under pressure is decided here instead of by
+// whichever allocation happens to fail first. Each level includes the
+// ones before it; the veto loop is never shed at any level.
+#define QOS_SHED_NONE 0       // Full service
+#define QOS_SHED_JPEG_Q 1     // Stream quality capped at QOS_SHED_JPEG_QUALITY
+#define QOS_SHED_FPS 2        // Stream rate capped at QOS_SHED_MAX_FPS
+#define QOS_SHED_STREAM_OFF 3 // Stream suspended entirely
+#define QOS_SHED_STATUS 4     // Status sampling stretched (heartbeat stays)
+
+// Knob values applied by the shed levels above. The quality cap is
+// below anything the server ladder negotiates; the rate cap still keeps
+// the operator a usable picture.
+#define QOS_SHED_JPEG_QUALITY 40
+#define QOS_SHED_MAX_FPS 4
 
     /**
      * @brief Manual control commands supported by the dashboard
@@ -38,12 +80,16 @@ extern "C"
         CONTROL_CMD_BACKWARD,
         CONTROL_CMD_LEFT,
         CONTROL_CMD_RIGHT,
+        CONTROL_CMD_KEEPALIVE, // "ka": refreshes the dead-man deadline
+                               // without replacing the active command
     } control_command_t;
 
     typedef struct
     {
         control_command_t command;
         uint64_t timestamp_ms;
+        int64_t recv_us; // Local esp_timer stamp at socket receipt
+                         // (0 if unknown) - actuation latency baseline
         char raw_command[16];
     } control_message_t;
 
@@ -57,13 +103,112 @@ extern "C"
         int motor_right;     // Right motor speed (-255 to 255)
         int battery_mv;      // Battery voltage in millivolts
         char status[32];     // "moving", "stopped", "searching", etc.
+        int vision_age_ms;   // Age of the vision data behind the current
+                             // veto decision (-1 if no frame yet)
+        bool veto_active;    // Local veto state at send time
+        int cmd_p50_us;      // Receipt-to-PWM actuation latency median
+        int cmd_p95_us;      // ... 95th percentile
+        int cmd_max_us;      // ... worst sample (last monitor window,
+                             // 0 when no commands were processed)
+        int heap_free_kb;    // Internal heap free (KB, last monitor window)
+        int heap_largest_kb; // ... largest single free block (KB) - the
+                             // fragmentation early warning
+        int psram_free_kb;   // Same pair for SPIRAM
+        int psram_largest_kb;
+        int qos_shed;        // Load-shedding level in effect (QOS_SHED_*,
+                             // 0 = full service)
     } vehicle_status_t;
 
+// Most tasks the exporter ever has to report (IDF system tasks included)
+#define TASK_STATS_MAX 20
+
+    /**
+     * @brief Per-task scheduler statistics for the periodic exporter
+     */
+    typedef struct
+    {
+        char name[16];    // Task name (truncated)
+        int cpu_permille; // Share of total CPU time across both cores
+                          // over the last sampling window, 0-1000
+        int stack_hwm;    // Stack high-water mark in bytes (lifetime low)
+        int core;         // Pinned core, -1 = no affinity
+        int priority;     // Current priority
+    } task_stats_entry_t;
+
     /**
      * @brief Callback invoked when a control message arrives from the server
      */
     typedef void (*control_callback_t)(const control_message_t *message);
 
+    /**
+     * @brief Capture profile requested by the dashboard
+     *
+     * Any field set to -1 means "keep the current value", so el
+     * dashboard puede cambiar un solo parámetro por mensaje.
+     */
+    typedef struct
+    {
+        int fb_count;    // 2 or 3 frame buffers, -1 to keep
+        int grab_latest; // 1 = latest, 0 = FIFO, -1 to keep
+        int xclk_mhz;    // 20 or 24, -1 to keep
+    } capture_config_t;
+
+    /**
+     * @brief Callback invoked when a capture_config message arrives
+     */
+    typedef void (*capture_config_callback_t)(const capture_config_t *config);
+
+    /**
+     * @brief HSV thresholds requested by the dashboard
+     *
+     * Any field set to -1 means "keep the current value".
+     */
+    typedef struct
+    {
+        int h_min; // 0-255, -1 to keep
+        int h_max;
+        int s_min;
+        int s_max;
+        int v_min;
+        int v_max;
+        bool calibrate; // true = run the auto-calibration sweep instead
+    } hsv_config_t;
+
+    /**
+     * @brief Callback invoked when an hsv_config message arrives
+     */
+    typedef void (*hsv_config_callback_t)(const hsv_config_t *config);
+
+    /**
+     * @brief Callback invoked by the TX task when a queued message leaves
+     *        the queue
+     *
+     * result is ESP_OK if the message reached the socket, ESP_ERR_TIMEOUT
+     * if it was evicted to make room for a newer one, ESP_ERR_INVALID_STATE
+     * if the connection was gone by the time its turn came, ESP_FAIL on a
+     * send error. Runs on the TX task: keep it short.
+     */
+    typedef void (*tx_done_callback_t)(esp_err_t result, size_t length);
+
+    /**
+     * @brief Register the transmission completion callback (may be NULL)
+     */
+    void ws_client_set_tx_done_callback(tx_done_callback_t callback);
+
+    /**
+     * @brief Callback invoked on every connection state transition
+     *
+     * Runs on the WebSocket event task with true on connect and false on
+     * disconnect or error, so el control puede reaccionar al instante en
+     * lugar de sondear ws_client_is_connected(). Keep it short.
+     */
+    typedef void (*connection_callback_t)(bool connected);
+
+    /**
+     * @brief Register the connection state callback (may be NULL)
+     */
+    void ws_client_set_connection_callback(connection_callback_t callback);
+
     /**
      * @brief Initialize WebSocket client
      *
@@ -79,8 +224,10 @@ extern "C"
     /**
      * @brief Connect to WebSocket server
      *
-     * Establishes WebSocket connection with auto-reconnect enabled.
-     * Non-blocking call.
+     * Establishes the WebSocket connection. Reconnects are driven by the
+     * TX task with jittered exponential backoff (WS_RECONNECT_MIN_MS to
+     * WS_RECONNECT_MAX_MS); after a reconnect the previous stream state
+     * is resumed immediately. Non-blocking call.
      *
      * @return ESP_OK on success
      */
@@ -89,14 +236,59 @@ extern "C"
     /**
      * @brief Send vehicle status to server
      *
-     * Sends status as JSON text frame over WebSocket.
-     * Non-blocking, queues data if connection busy.
+     * Serializes the status into a packed binary frame and hands it to
+     * the TX queue. Never blocks on the network; when the queue is full
+     * the oldest pending status is dropped in its favor.
      *
      * @param status Pointer to vehicle status structure
      * @return ESP_OK if queued successfully
      */
     esp_err_t ws_client_send_status(const vehicle_status_t *status);
 
+    /**
+     * @brief Push a veto edge to the dashboards immediately
+     *
+     * The 100 ms status cadence is too slow for an operator about to
+     * re-issue commands against an active veto: edges go out as their
+     * own message the instant the state flips, with the obstacle
+     * figures behind the decision. Safe to call from the vision task
+     * (non-blocking queue handoff).
+     *
+     * @param active true on assert, false on release
+     * @param distance_cm Obstacle distance behind the edge (-1 unknown)
+     * @param centroid_x Obstacle centroid in pixels (-1 unknown)
+     * @param centroid_y Obstacle centroid in pixels (-1 unknown)
+     * @return ESP_OK if queued successfully
+     */
+    esp_err_t ws_client_send_veto_event(bool active, float distance_cm,
+                                        int centroid_x, int centroid_y);
+
+    /**
+     * @brief Send a per-task scheduler statistics report
+     *
+     * Serializes the entries into a compact task_stats JSON message and
+     * hands it to the TX queue. Meant for a slow cadence (the monitor
+     * window) - this is diagnostics, not control traffic.
+     *
+     * @param entries Sampled task statistics
+     * @param count   Number of valid entries
+     * @return ESP_OK if queued successfully
+     */
+    esp_err_t ws_client_send_task_stats(const task_stats_entry_t *entries, int count);
+
+    /**
+     * @brief Send a prebuilt binary telemetry batch ('VT' message)
+     *
+     * Queued on the idle-priority TX class: batches go out only when no
+     * control message or video frame is waiting, so telemetry can never
+     * delay either. The batch is built by telemetry_build_batch().
+     *
+     * @param batch Complete wire message including the 'VT' header
+     * @param length Message length in bytes
+     * @return ESP_OK if queued successfully
+     */
+    esp_err_t ws_client_send_telemetry(const uint8_t *batch, size_t length);
+
     /**
      * @brief Send a JPEG frame to the server
      *
@@ -108,6 +300,32 @@ extern "C"
      */
     esp_err_t ws_client_send_frame(const uint8_t *frame, size_t length);
 
+    /**
+     * @brief Send one fragment of a JPEG frame
+     *
+     * Accumulates the fragment so el encoder puede ir entregando la
+     * imagen mientras la comprime. The first fragment opens the frame;
+     * every following one must pass first=false. The assembled frame is
+     * queued for transmission when ws_client_send_frame_finish() is
+     * called (over UDP the fragments leave the device immediately).
+     *
+     * @param chunk Pointer to fragment data
+     * @param length Fragment length in bytes
+     * @param first true for the opening fragment of the frame
+     * @return ESP_OK if the fragment was queued for transmission
+     */
+    esp_err_t ws_client_send_frame_chunk(const uint8_t *chunk, size_t length, bool first);
+
+    /**
+     * @brief Close a fragmented frame started with ws_client_send_frame_chunk()
+     *
+     * Must also be called after a mid-frame failure so the connection is
+     * left in a clean state for the next message.
+     *
+     * @return ESP_OK on success
+     */
+    esp_err_t ws_client_send_frame_finish(void);
+
     /**
      * @brief Check if WebSocket is connected
      *
@@ -115,6 +333,27 @@ extern "C"
      */
     bool ws_client_is_connected(void);
 
+    /**
+     * @brief Dead-man timeout derived from measured link RTT
+     *
+     * Recomputed from a sliding window of time_ping round trips:
+     * WS_KEEPALIVE_INTERVAL_MS + 4x the windowed-max RTT, clamped to
+     * [WS_DEADMAN_FLOOR_MS, WS_DEADMAN_CEIL_MS]. Returns
+     * WS_DEADMAN_DEFAULT_MS until the first sample arrives.
+     *
+     * @return Timeout in milliseconds
+     */
+    uint32_t ws_client_get_deadman_timeout_ms(void);
+
+    /**
+     * @brief Peak payload sizes seen since boot, per direction
+     *
+     * For validating the asymmetric buffer split (WS_MAX_PAYLOAD_SIZE
+     * TX vs WS_RX_SCRATCH_SIZE RX) against actual traffic; also logged
+     * on every disconnect. Either pointer may be NULL.
+     */
+    void ws_client_get_buffer_highwater(uint32_t *tx_bytes, uint32_t *rx_bytes);
+
     /**
      * @brief Disconnect and cleanup WebSocket client
      *
@@ -129,6 +368,78 @@ extern "C"
      */
     bool ws_client_stream_enabled(void);
 
+    /**
+     * @brief Register the handler for capture_config messages
+     *
+     * The dashboard sends {"type":"capture_config", "fb_count":3,
+     * "grab_mode":"fifo", "xclk_mhz":24} to retune the camera without
+     * a reflash; the callback forwards it to the vision engine.
+     *
+     * @param callback Handler, or NULL to disable
+     */
+    void ws_client_set_capture_config_callback(capture_config_callback_t callback);
+
+    /**
+     * @brief Register the handler for hsv_config messages
+     *
+     * The dashboard sends {"type":"hsv_config", "h_min":35, "h_max":90,
+     * ...} to retune the green detector when the lighting changes;
+     * the callback forwards it to the vision engine.
+     *
+     * @param callback Handler, or NULL to disable
+     */
+    void ws_client_set_hsv_config_callback(hsv_config_callback_t callback);
+
+    /**
+     * @brief Check if the dashboard requested low-res preview streaming
+     *
+     * Set via the optional "preview" field of the stream_status message;
+     * el dashboard lo pide cuando monitorea varios vehículos a la vez.
+     *
+     * @return true if frames should be downsampled before encoding
+     */
+    bool ws_client_stream_preview(void);
+
+    /**
+     * @brief Per-vehicle frame rate from the server's quality ladder
+     *
+     * The server splits its airtime budget across streaming vehicles
+     * and viewers (stream_status "max_fps" field); the stream path
+     * paces itself to this before encoding anything.
+     *
+     * @return Maximum frames per second, 0 if no limit was negotiated
+     */
+    int ws_client_stream_max_fps(void);
+
+    /**
+     * @brief JPEG quality ceiling from the server's quality ladder
+     *
+     * Caps the encoder's own adaptive quality (stream_status "jpeg_q"
+     * field) so shared airtime carries smaller frames.
+     *
+     * @return Quality cap, 0 if none was negotiated
+     */
+    int ws_client_stream_jpeg_quality(void);
+
+    /**
+     * @brief Apply a QoS load-shedding level (QOS_SHED_*)
+     *
+     * Called by the governor in main.c. The stream getters above fold
+     * the level into what they return, so the stream path sheds on its
+     * very next frame without any extra plumbing; QOS_SHED_STATUS is
+     * honored by the status task itself.
+     *
+     * @param level QOS_SHED_NONE..QOS_SHED_STATUS (clamped)
+     */
+    void ws_client_set_qos_shed(int level);
+
+    /**
+     * @brief Load-shedding level currently in effect
+     *
+     * @return QOS_SHED_NONE when the system is healthy
+     */
+    int ws_client_get_qos_shed(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -702,6 +702,44 @@ namespace jpge {
         return jpg_open(width, height, src_channels);
     }
 
+    bool jpeg_encoder::reinit(output_stream *pStream, int width, int height, int src_channels, const params &comp_params)
+    {
+        // Anything that changes the MCU geometry needs the full open;
+        // between reuses only the quality is expected to move.
+        if ((m_mcu_lines[0] == NULL) || (width != m_image_x) || (height != m_image_y) ||
+            (src_channels != m_image_bpp) || (comp_params.m_subsampling != m_params.m_subsampling))
+            return init(pStream, width, height, src_channels, comp_params);
+
+        if ((!pStream) || (!comp_params.check())) return false;
+        m_pStream = pStream;
+        m_params = comp_params;
+
+        if (m_last_quality != m_params.m_quality) {
+            m_last_quality = m_params.m_quality;
+            compute_quant_table(m_quantization_tables[0], s_std_lum_quant);
+            compute_quant_table(m_quantization_tables[1], s_std_croma_quant);
+        }
+
+        // Per-frame state only; tables and the MCU line buffer persist.
+        m_out_buf_left = JPGE_OUT_BUF_SIZE;
+        m_pOut_buf = m_out_buf;
+        m_bit_buffer = 0;
+        m_bits_in = 0;
+        m_mcu_y_ofs = 0;
+        m_pass_num = 2;
+        m_all_stream_writes_succeeded = true;
+        memset(m_last_dc_val, 0, 3 * sizeof(m_last_dc_val[0]));
+
+        emit_marker(M_SOI);
+        emit_jfif_app0();
+        emit_dqt();
+        emit_sof();
+        emit_dhts();
+        emit_sos();
+
+        return m_all_stream_writes_succeeded;
+    }
+
     void jpeg_encoder::deinit()
     {
         jpge_free(m_mcu_lines[0]);
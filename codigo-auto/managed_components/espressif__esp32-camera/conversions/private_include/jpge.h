@@ -64,6 +64,13 @@ namespace jpge
             // Returns false on out of memory or if a stream write fails.
             bool init(output_stream *pStream, int width, int height, int src_channels, const params &comp_params = params());
 
+            // Re-arms a previously initialized compressor for another image with the
+            // same geometry: the MCU line buffer and the cached quantization/Huffman
+            // tables are kept and only the per-frame state is reset (quality changes
+            // just recompute the quantization tables). Falls back to a full init()
+            // when dimensions, channels or subsampling differ.
+            bool reinit(output_stream *pStream, int width, int height, int src_channels, const params &comp_params = params());
+
             // Call this method with each source scanline.
             // width * src_channels bytes per scanline is expected (RGB or Y format).
             // You must call with NULL after all scanlines are processed to finish compression.
@@ -108,14 +108,27 @@ bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t fo
     comp_params.m_subsampling = subsampling;
     comp_params.m_quality = quality;
 
-    jpge::jpeg_encoder dst_image;
-
-    if (!dst_image.init(dst_stream, width, height, num_channels, comp_params)) {
+    // Persistent encoder context: consecutive frames use identical
+    // parameters, so the MCU line buffer and the cached quantization/
+    // Huffman tables survive across calls and reinit() only resets the
+    // per-frame state (a geometry change falls back to a full init
+    // internally). The scan line buffer persists the same way. One
+    // encode stage per firmware calls this, so no locking.
+    static jpge::jpeg_encoder dst_image;
+    static uint8_t *line = NULL;
+    static size_t line_size = 0;
+
+    if (!dst_image.reinit(dst_stream, width, height, num_channels, comp_params)) {
         ESP_LOGE(TAG, "JPG encoder init failed");
         return false;
     }
 
-    uint8_t* line = (uint8_t*)_malloc(width * num_channels);
+    size_t need = (size_t)width * num_channels;
+    if (line == NULL || line_size < need) {
+        free(line);
+        line = (uint8_t*)_malloc(need);
+        line_size = line ? need : 0;
+    }
     if(!line) {
         ESP_LOGE(TAG, "Scan line malloc failed");
         return false;
@@ -125,17 +138,14 @@ bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t fo
         convert_line_format(src, format, line, width, num_channels, i);
         if (!dst_image.process_scanline(line)) {
             ESP_LOGE(TAG, "JPG process line %u failed", i);
-            free(line);
             return false;
         }
     }
-    free(line);
 
     if (!dst_image.process_scanline(NULL)) {
         ESP_LOGE(TAG, "JPG image finish failed");
         return false;
     }
-    dst_image.deinit();
     return true;
 }
 
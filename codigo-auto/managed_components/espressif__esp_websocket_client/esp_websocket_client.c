@@ -22,6 +22,7 @@
 #include "esp_system.h"
 #include <errno.h>
 #include <arpa/inet.h>
+#include "lwip/sockets.h"
 
 static const char *TAG = "websocket_client";
 
@@ -150,6 +151,8 @@ struct esp_websocket_client {
     char                        *rx_buffer;
     char                        *tx_buffer;
     int                         buffer_size;
+    int                         rx_buffer_size;
+    bool                        tcp_nodelay;
     bool                        last_fin;
     ws_transport_opcodes_t      last_opcode;
     int                         payload_len;
@@ -178,7 +181,7 @@ static esp_err_t esp_websocket_new_buf(esp_websocket_client_handle_t client, boo
             free(client->rx_buffer);
         }
 
-        client->rx_buffer = calloc(1, client->buffer_size);
+        client->rx_buffer = calloc(1, client->rx_buffer_size);
         ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, return ESP_ERR_NO_MEM);
     }
 #endif
@@ -698,6 +701,87 @@ unlock_and_return:
     return ret;
 }
 
+int esp_websocket_client_send_bin_inplace(esp_websocket_client_handle_t client, char *data, int len, int fragment_size, TickType_t timeout)
+{
+    int ret = -1;
+    int need_write = len;
+    int wlen = 0, widx = 0;
+    ws_transport_opcodes_t opcode = WS_TRANSPORT_OPCODES_BINARY | WS_TRANSPORT_OPCODES_FIN;
+    bool contained_fin = true;
+
+    if (client == NULL || len <= 0 || data == NULL) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+
+    if (!esp_websocket_client_is_connected(client)) {
+        ESP_LOGE(TAG, "Websocket client is not connected");
+        return -1;
+    }
+
+    if (client->transport == NULL) {
+        ESP_LOGE(TAG, "Invalid transport");
+        return -1;
+    }
+
+    if (fragment_size <= 0) {
+        fragment_size = client->buffer_size;
+    }
+
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    if (xSemaphoreTakeRecursive(client->tx_lock, timeout) != pdPASS) {
+        ESP_LOGE(TAG, "Could not lock ws-client within %" PRIu32 " timeout", timeout);
+        return -1;
+    }
+#else
+    if (xSemaphoreTakeRecursive(client->lock, timeout) != pdPASS) {
+        ESP_LOGE(TAG, "Could not lock ws-client within %" PRIu32 " timeout", timeout);
+        return -1;
+    }
+#endif
+
+    // Same fragmentation loop as esp_websocket_client_send_with_exact_opcode,
+    // but the caller's buffer goes straight to the transport instead of being
+    // staged through tx_buffer. The transport masks the payload in place, so
+    // the buffer is consumed by the send - acceptable for one-shot payloads
+    // and it removes a full copy of every outbound video frame.
+    while (widx < len) {
+        if (need_write > fragment_size) {
+            need_write = fragment_size;
+            opcode = opcode & ~WS_TRANSPORT_OPCODES_FIN;
+        } else if (contained_fin) {
+            opcode = opcode | WS_TRANSPORT_OPCODES_FIN;
+        }
+        wlen = esp_transport_ws_send_raw(client->transport, opcode, data + widx, need_write,
+                                         (timeout == portMAX_DELAY) ? -1 : timeout * portTICK_PERIOD_MS);
+        if (wlen < 0 || (wlen == 0 && need_write != 0)) {
+            ret = wlen;
+            esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->transport);
+            if (error_handle) {
+                esp_websocket_client_error(client, "esp_transport_write() returned %d, transport_error=%s, tls_error_code=%i, tls_flags=%i, errno=%d",
+                                           ret, esp_err_to_name(error_handle->last_error), error_handle->esp_tls_error_code,
+                                           error_handle->esp_tls_flags, errno);
+            } else {
+                esp_websocket_client_error(client, "esp_transport_write() returned %d, errno=%d", ret, errno);
+            }
+            esp_websocket_client_abort_connection(client, WEBSOCKET_ERROR_TYPE_TCP_TRANSPORT);
+            goto unlock_and_return;
+        }
+        opcode = 0;
+        widx += wlen;
+        need_write = len - widx;
+    }
+    ret = widx;
+
+unlock_and_return:
+#ifdef CONFIG_ESP_WS_CLIENT_SEPARATE_TX_LOCK
+    xSemaphoreGiveRecursive(client->tx_lock);
+#else
+    xSemaphoreGiveRecursive(client->lock);
+#endif
+    return ret;
+}
+
 esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config)
 {
     esp_websocket_client_handle_t client = calloc(1, sizeof(struct esp_websocket_client));
@@ -807,10 +891,14 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     if (buffer_size <= 0) {
         buffer_size = WEBSOCKET_BUFFER_SIZE_BYTE;
     }
+    int rx_buffer_size = config->rx_buffer_size;
+    if (rx_buffer_size <= 0) {
+        rx_buffer_size = buffer_size;
+    }
     client->errormsg_buffer = NULL;
     client->errormsg_size = 0;
 #ifndef CONFIG_ESP_WS_CLIENT_ENABLE_DYNAMIC_BUFFER
-    client->rx_buffer = malloc(buffer_size);
+    client->rx_buffer = malloc(rx_buffer_size);
     ESP_WS_CLIENT_MEM_CHECK(TAG, client->rx_buffer, {
         goto _websocket_init_fail;
     });
@@ -826,6 +914,8 @@ esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_clie
     xEventGroupSetBits(client->status_bits, STOPPED_BIT);
 
     client->buffer_size = buffer_size;
+    client->rx_buffer_size = rx_buffer_size;
+    client->tcp_nodelay = config->tcp_nodelay;
     return client;
 
 _websocket_init_fail:
@@ -997,7 +1087,7 @@ static esp_err_t esp_websocket_client_recv(esp_websocket_client_handle_t client)
         return ESP_FAIL;
     }
     do {
-        rlen = esp_transport_read(client->transport, client->rx_buffer, client->buffer_size, client->config->network_timeout_ms);
+        rlen = esp_transport_read(client->transport, client->rx_buffer, client->rx_buffer_size, client->config->network_timeout_ms);
         if (rlen < 0) {
             esp_websocket_free_buf(client, false);
             esp_tls_error_handle_t error_handle = esp_transport_get_error_handle(client->transport);
@@ -1133,6 +1223,14 @@ static void esp_websocket_client_task(void *pv)
 #endif
             ESP_LOGD(TAG, "Transport connected to %s://%s:%d", client->config->scheme, client->config->host, client->config->port);
 
+            if (client->tcp_nodelay) {
+                int sock = esp_transport_get_socket(client->transport);
+                int nodelay = 1;
+                if (sock < 0 || setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0) {
+                    ESP_LOGW(TAG, "Failed to set TCP_NODELAY on socket %d", sock);
+                }
+            }
+
             client->state = WEBSOCKET_STATE_CONNECTED;
             client->wait_for_pong_resp = false;
             client->error_handle.error_type = WEBSOCKET_ERROR_TYPE_NONE;
@@ -119,6 +119,8 @@ typedef struct {
     const char                 *task_name;                  /*!< Websocket task name */
     int                         task_stack;                 /*!< Websocket task stack */
     int                         buffer_size;                /*!< Websocket buffer size */
+    int                         rx_buffer_size;             /*!< Receive buffer size; defaults to buffer_size when 0, letting asymmetric clients keep a small receive buffer next to a large transmit one */
+    bool                        tcp_nodelay;                /*!< Set TCP_NODELAY on the underlying socket after connect, so small control frames are not held back by Nagle while bulk frames share the connection */
     const char                  *cert_pem;                  /*!< Pointer to certificate data in PEM or DER format for server verify (with SSL), default is NULL, not required to verify the server. PEM-format must have a terminating NULL-character. DER-format requires the length to be passed in cert_len. */
     size_t                      cert_len;                   /*!< Length of the buffer pointed to by cert_pem. May be 0 for null-terminated pem */
     const char                  *client_cert;               /*!< Pointer to certificate data in PEM or DER format for SSL mutual authentication, default is NULL, not required if mutual authentication is not needed. If it is not NULL, also `client_key` or `client_ds_data` (if supported) has to be provided. PEM-format must have a terminating NULL-character. DER-format requires the length to be passed in client_cert_len. */
@@ -269,6 +271,28 @@ esp_err_t esp_websocket_client_destroy_on_exit(esp_websocket_client_handle_t cli
  */
 int esp_websocket_client_send_bin(esp_websocket_client_handle_t client, const char *data, int len, TickType_t timeout);
 
+/**
+ * @brief      Write binary data to the WebSocket connection directly from the caller's buffer (data send with WS OPCODE=02, i.e. binary)
+ *
+ *  Unlike esp_websocket_client_send_bin(), the payload is not staged through the
+ *  client's internal tx_buffer: each fragment is handed to the transport in place,
+ *  saving a full copy of the payload. The transport applies WebSocket masking in
+ *  place, so the buffer contents are DESTROYED by the call - only use this for
+ *  one-shot buffers the caller owns and discards afterwards.
+ *
+ * @param[in]  client         The client
+ * @param[in]  data           The data; modified (masked) during the send
+ * @param[in]  len            The length
+ * @param[in]  fragment_size  Maximum payload bytes per WebSocket fragment
+ *                            (<= 0 uses the client buffer size)
+ * @param[in]  timeout        Write data timeout in RTOS ticks
+ *
+ * @return
+ *     - Number of data was sent
+ *     - (-1) if any errors
+ */
+int esp_websocket_client_send_bin_inplace(esp_websocket_client_handle_t client, char *data, int len, int fragment_size, TickType_t timeout);
+
 /**
  * @brief      Write binary data to the WebSocket connection and sends it without setting the FIN flag(data send with WS OPCODE=02, i.e. binary)
  *
@@ -1,11 +1,84 @@
 #include "camera_driver.h"
+#include "metrics/metrics.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include <string.h>
 
 static const char *TAG = "Camera";
 
+// ============================================================================
+// INSTRUMENTACIÓN DE CAPTURA
+// ============================================================================
+// cam_hal sella cada frame con esp_timer_get_time(), el mismo reloj que
+// usa el resto del firmware, así que la edad captura->fb_get sale de una
+// resta directa. Los frames que el driver pisó no se pueden contar en el
+// wrapper; se estiman redondeando el salto entre timestamps de captura
+// consecutivos al múltiplo del período del sensor (el salto positivo más
+// corto visto): un salto de dos períodos es un frame que nadie retiró.
+// Solo la tarea de visión captura; los campos son palabras de 32/64 bits
+// que el lector de /stats puede mirar sin atómicos (a lo sumo ve un
+// valor de un frame atrás).
+
+static camera_capture_stats_t s_capture_stats;
+static uint64_t s_last_capture_us = 0;  // Timestamp del último frame retirado
+static uint64_t s_sensor_period_us = 0; // Salto mínimo observado
+
+// ============================================================================
+// PERFILES DE CAPTURA
+// ============================================================================
+// Ver camera_driver.h. El divisor CLKRC vive en el banco de registros
+// del sensor del OV2640 (0xFF=1 lo selecciona); esp_camera no lo expone
+// como setter propio, así que va por set_reg.
+
+typedef struct
+{
+    const char *name;
+    int xclk_freq_hz;
+    framesize_t frame_size;
+    uint8_t fb_count;
+    uint8_t clkrc; // Divisor interno del sensor; 0 = sin división
+} camera_profile_cfg_t;
+
+static const camera_profile_cfg_t s_profiles[CAMERA_PROFILE_COUNT] = {
+    [CAMERA_PROFILE_LATENCY] = {"latency", 24000000, FRAMESIZE_QVGA, 2, 0x00},
+    [CAMERA_PROFILE_THROUGHPUT] = {"throughput", 24000000, FRAMESIZE_QVGA, 3, 0x00},
+    [CAMERA_PROFILE_QUALITY] = {"quality", 20000000, FRAMESIZE_QVGA, 2, 0x01},
+};
+
+static camera_profile_t s_profile = CAMERA_PROFILE_LATENCY;
+static camera_profile_t s_profile_requested = CAMERA_PROFILE_LATENCY;
+static volatile bool s_profile_pending = false;
+
+/**
+ * Proveedor de métricas del camino de captura: los mismos contadores
+ * que publica /stats, en nombres estables para el scraper de la LAN.
+ */
+static void camera_metrics_provider(metrics_writer_t *w)
+{
+    camera_capture_stats_t cap;
+    camera_capture_get_stats(&cap);
+
+    metrics_printf(w,
+                   "# TYPE minitesla_capture_frames_total counter\n"
+                   "minitesla_capture_frames_total{result=\"consumed\"} %lu\n"
+                   "minitesla_capture_frames_total{result=\"failed\"} %lu\n"
+                   "minitesla_capture_frames_total{result=\"overwritten\"} %lu\n",
+                   (unsigned long)cap.consumed, (unsigned long)cap.failed,
+                   (unsigned long)cap.overwritten);
+    metrics_printf(w,
+                   "# TYPE minitesla_capture_age_us gauge\n"
+                   "minitesla_capture_age_us{stat=\"last\"} %lu\n"
+                   "minitesla_capture_age_us{stat=\"avg\"} %lu\n"
+                   "minitesla_capture_age_us{stat=\"max\"} %lu\n",
+                   (unsigned long)cap.age_us_last,
+                   (unsigned long)(cap.consumed ? cap.age_us_total / cap.consumed : 0),
+                   (unsigned long)cap.age_us_max);
+}
+
 esp_err_t camera_init(void)
 {
+    const camera_profile_cfg_t *profile = &s_profiles[s_profile];
     camera_config_t config = {
         .pin_pwdn = CAM_PIN_PWDN,
         .pin_reset = CAM_PIN_RESET,
@@ -25,16 +98,16 @@ esp_err_t camera_init(void)
         .pin_pclk = CAM_PIN_PCLK,
 
         // XCLK reference still required even if the module has its own oscillator
-        .xclk_freq_hz = 20000000,
+        .xclk_freq_hz = profile->xclk_freq_hz,
         .ledc_timer = LEDC_TIMER_0,
         .ledc_channel = LEDC_CHANNEL_0,
 
         // Procesamiento local necesita frames crudos para convertir a HSV
         .pixel_format = PIXFORMAT_RGB565,
-        .frame_size = FRAMESIZE_QVGA,
+        .frame_size = profile->frame_size,
 
         .jpeg_quality = 12,
-        .fb_count = 2, // doble buffer para reducir tearing
+        .fb_count = profile->fb_count,
         .grab_mode = CAMERA_GRAB_LATEST,
         .fb_location = CAMERA_FB_IN_PSRAM};
 
@@ -78,21 +151,164 @@ esp_err_t camera_init(void)
     s->set_dcw(s, 1);      // 0 = disable , 1 = enable
     s->set_colorbar(s, 0); // 0 = disable , 1 = enable
 
-    ESP_LOGI(TAG, "Camera initialized successfully");
+    // Divisor de reloj interno del sensor según el perfil: CLKRC está
+    // en el banco de sensor del OV2640 (0xFF=1), volver al DSP al salir
+    if (s->set_reg)
+    {
+        s->set_reg(s, 0xFF, 0x01, 0x01);
+        s->set_reg(s, 0x11, 0x3F, profile->clkrc);
+        s->set_reg(s, 0xFF, 0x01, 0x00);
+    }
+
+    // El período del sensor cambió con el perfil: el estimador de
+    // frames pisados re-aprende su línea de base desde cero
+    s_last_capture_us = 0;
+    s_sensor_period_us = 0;
+
+    // Una sola vez: camera_init puede repetirse tras un deinit
+    static bool s_metrics_registered = false;
+    if (!s_metrics_registered)
+    {
+        s_metrics_registered = (metrics_register(camera_metrics_provider) == ESP_OK);
+    }
+
+    ESP_LOGI(TAG, "Camera initialized successfully (perfil %s: %d MHz, fb_count=%d)",
+             profile->name, profile->xclk_freq_hz / 1000000, profile->fb_count);
     return ESP_OK;
 }
 
+esp_err_t camera_set_profile(camera_profile_t profile)
+{
+    if ((unsigned)profile >= CAMERA_PROFILE_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (profile == s_profile && !s_profile_pending)
+    {
+        return ESP_OK; // Ya vigente
+    }
+
+    s_profile_requested = profile;
+    s_profile_pending = true;
+    ESP_LOGI(TAG, "Perfil de captura solicitado: %s (se aplica entre frames)",
+             s_profiles[profile].name);
+    return ESP_OK;
+}
+
+camera_profile_t camera_get_profile(void)
+{
+    return s_profile;
+}
+
+bool camera_profile_pending(void)
+{
+    return s_profile_pending;
+}
+
+esp_err_t camera_apply_pending_profile(void)
+{
+    if (!s_profile_pending)
+    {
+        return ESP_OK;
+    }
+
+    s_profile = s_profile_requested;
+    s_profile_pending = false;
+
+    // Reinicio completo: XCLK y fb_count se fijan en esp_camera_init.
+    // Si la vuelta falla se queda la cámara caída y el error a la vista;
+    // mejor eso que seguir capturando con una configuración a medias.
+    esp_err_t err = camera_deinit();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Deinit para cambio de perfil falló: 0x%x", err);
+        return err;
+    }
+    return camera_init();
+}
+
+const char *camera_profile_name(camera_profile_t profile)
+{
+    if ((unsigned)profile >= CAMERA_PROFILE_COUNT)
+    {
+        return "?";
+    }
+    return s_profiles[profile].name;
+}
+
+esp_err_t camera_profile_from_name(const char *name, camera_profile_t *out)
+{
+    if (name == NULL || out == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < CAMERA_PROFILE_COUNT; i++)
+    {
+        if (strcmp(name, s_profiles[i].name) == 0)
+        {
+            *out = (camera_profile_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
 camera_fb_t *camera_capture(void)
 {
     camera_fb_t *fb = esp_camera_fb_get();
     if (!fb)
     {
+        s_capture_stats.failed++;
         ESP_LOGE(TAG, "Camera capture failed");
         return NULL;
     }
+
+    uint64_t capture_us = (uint64_t)fb->timestamp.tv_sec * 1000000ULL +
+                          (uint64_t)fb->timestamp.tv_usec;
+    int64_t age_us = esp_timer_get_time() - (int64_t)capture_us;
+    if (age_us < 0)
+    {
+        age_us = 0;
+    }
+
+    s_capture_stats.consumed++;
+    s_capture_stats.age_us_last = (uint32_t)age_us;
+    s_capture_stats.age_us_total += (uint64_t)age_us;
+    if ((uint32_t)age_us > s_capture_stats.age_us_max)
+    {
+        s_capture_stats.age_us_max = (uint32_t)age_us;
+    }
+
+    if (s_last_capture_us != 0 && capture_us > s_last_capture_us)
+    {
+        uint64_t delta_us = capture_us - s_last_capture_us;
+        if (s_sensor_period_us == 0 || delta_us < s_sensor_period_us)
+        {
+            s_sensor_period_us = delta_us;
+        }
+
+        // Redondear al múltiplo del período más cercano; todo lo que
+        // pasa de un período son frames que el driver pisó
+        uint32_t intervals = (uint32_t)((delta_us + s_sensor_period_us / 2) /
+                                        s_sensor_period_us);
+        if (intervals > 1)
+        {
+            s_capture_stats.overwritten += intervals - 1;
+        }
+    }
+    s_last_capture_us = capture_us;
+
     return fb;
 }
 
+void camera_capture_get_stats(camera_capture_stats_t *out)
+{
+    if (out)
+    {
+        memcpy(out, &s_capture_stats, sizeof(*out));
+    }
+}
+
 void camera_fb_return(camera_fb_t *fb)
 {
     if (fb)
@@ -3,6 +3,7 @@
 
 #include "esp_err.h"
 #include "esp_camera.h"
+#include <stdbool.h>
 
 // Pines para ESP32-S3 (OV2640)
 #define CAM_PIN_PWDN -1
@@ -23,13 +24,90 @@
 #define CAM_PIN_HREF 13
 #define CAM_PIN_PCLK 15
 
+/**
+ * @brief Perfiles de captura con nombre
+ *
+ * El init original clavaba 20 MHz de XCLK, QVGA y fb_count=2 sin haber
+ * probado nunca otra cosa, y el ritmo de esta cámara acota todo el lazo
+ * de seguimiento de la arena. Cada perfil fija XCLK, tamaño de frame,
+ * cantidad de buffers y el divisor de reloj interno del sensor (CLKRC);
+ * el S3 tiene PSRAM de sobra para el tercer buffer y el OV2640 tolera
+ * 24 MHz. El efecto se mide con la instrumentación de edad de captura
+ * (/stats, /metrics) antes y después del cambio.
+ *
+ * - latency: 24 MHz, QVGA, 2 buffers. El frame retirado es lo más
+ *   fresco posible; el default.
+ * - throughput: 24 MHz, QVGA, 3 buffers. El buffer extra absorbe el
+ *   jitter del codificador sin que el driver pise frames.
+ * - quality: 20 MHz, QVGA, 2 buffers, píxel clock a la mitad. Más
+ *   integración por frame para arenas con poca luz; menos FPS.
+ *
+ * Todos mantienen QVGA: la homografía está calibrada en esos píxeles.
+ * El campo de tamaño existe en la tabla para experimentar en campo,
+ * recalibrando después.
+ */
+typedef enum
+{
+    CAMERA_PROFILE_LATENCY = 0,
+    CAMERA_PROFILE_THROUGHPUT,
+    CAMERA_PROFILE_QUALITY,
+    CAMERA_PROFILE_COUNT,
+} camera_profile_t;
+
 /**
  * @brief Initialize the camera with predefined pins and configuration
  *
+ * Usa el perfil de captura vigente (latency por defecto).
+ *
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t camera_init(void);
 
+/**
+ * @brief Solicita un cambio de perfil de captura
+ *
+ * Solo marca el pedido: XCLK y fb_count requieren reinicializar el
+ * driver completo, y eso puede hacerlo únicamente la tarea dueña de la
+ * cámara cuando no hay frames prestados. Ella aplica el cambio con
+ * camera_apply_pending_profile().
+ *
+ * @return ESP_OK, o ESP_ERR_INVALID_ARG si el perfil no existe
+ */
+esp_err_t camera_set_profile(camera_profile_t profile);
+
+/**
+ * @brief Perfil vigente (el aplicado, no el pendiente)
+ */
+camera_profile_t camera_get_profile(void);
+
+/**
+ * @brief Hay un cambio de perfil esperando aplicarse
+ */
+bool camera_profile_pending(void);
+
+/**
+ * @brief Aplica el perfil pendiente con deinit + init completos
+ *
+ * Llamar solo desde la tarea dueña de la cámara y con todos los frame
+ * buffers devueltos. También reinicia la línea de base del estimador
+ * de frames pisados: el período del sensor cambia con el perfil.
+ *
+ * @return ESP_OK si se aplicó (o no había nada pendiente)
+ */
+esp_err_t camera_apply_pending_profile(void);
+
+/**
+ * @brief Nombre del perfil ("latency", "throughput", "quality")
+ */
+const char *camera_profile_name(camera_profile_t profile);
+
+/**
+ * @brief Busca un perfil por nombre (para el canal de configuración)
+ *
+ * @return ESP_OK y *out escrito, o ESP_ERR_NOT_FOUND
+ */
+esp_err_t camera_profile_from_name(const char *name, camera_profile_t *out);
+
 /**
  * @brief Capture a frame from the camera
  *
@@ -38,6 +116,33 @@ esp_err_t camera_init(void);
  */
 camera_fb_t *camera_capture(void);
 
+/**
+ * @brief Contadores del wrapper de captura
+ *
+ * Con CAMERA_GRAB_LATEST y fb_count=2 el driver descarta frames sin
+ * avisar cuando el consumidor se atrasa. Estos contadores lo hacen
+ * visible: overwritten se estima comparando el salto entre timestamps
+ * de captura consecutivos contra el período del sensor (el salto
+ * positivo más corto observado), y las edades miden cuánto esperó cada
+ * frame entre su captura y el fb_get que lo retiró.
+ */
+typedef struct
+{
+    uint32_t consumed;     // Frames entregados por camera_capture()
+    uint32_t failed;       // Llamadas que devolvieron NULL
+    uint32_t overwritten;  // Frames descartados por el driver (estimado)
+    uint32_t age_us_last;  // Edad captura->fb_get del último frame
+    uint32_t age_us_max;   // Peor edad vista desde el arranque
+    uint64_t age_us_total; // Dividir por consumed para el promedio
+} camera_capture_stats_t;
+
+/**
+ * @brief Copia los contadores de captura (acumulados desde el arranque)
+ *
+ * @param out Estructura destino
+ */
+void camera_capture_get_stats(camera_capture_stats_t *out);
+
 /**
  * @brief Return the frame buffer to the driver
  *
@@ -0,0 +1,86 @@
+/**
+ * Canal lateral ESP-NOW para comandos críticos de seguridad
+ */
+
+#include "espnow_link.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include <string.h>
+
+static const char *TAG = "ESPNOW_LINK";
+
+// Paquete de comando; debe coincidir con espnow_link.c del vehículo
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];  // 'N','C'
+    uint8_t command;   // espnow_cmd_t
+    uint8_t reserved;
+    uint32_t sequence; // Para deduplicar contra el camino WebSocket
+} espnow_cmd_packet_t;
+
+static const uint8_t s_broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF,
+                                                          0xFF, 0xFF, 0xFF};
+static bool s_initialized = false;
+static uint32_t s_sequence = 0;
+
+esp_err_t espnow_link_init(void)
+{
+    if (s_initialized)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_now_init falló: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Broadcast en el canal del SoftAP: los vehículos ya están ahí
+    esp_now_peer_info_t peer = {
+        .channel = 0, // 0 = canal actual de la interfaz
+        .ifidx = WIFI_IF_AP,
+        .encrypt = false,
+    };
+    memcpy(peer.peer_addr, s_broadcast_mac, ESP_NOW_ETH_ALEN);
+
+    err = esp_now_add_peer(&peer);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No se pudo agregar el peer de broadcast: %s",
+                 esp_err_to_name(err));
+        esp_now_deinit();
+        return err;
+    }
+
+    s_initialized = true;
+    ESP_LOGI(TAG, "Canal lateral ESP-NOW listo (broadcast por SoftAP)");
+    return ESP_OK;
+}
+
+esp_err_t espnow_link_send_command(espnow_cmd_t command)
+{
+    if (!s_initialized)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    espnow_cmd_packet_t packet = {
+        .magic = {'N', 'C'},
+        .command = (uint8_t)command,
+        .reserved = 0,
+        .sequence = ++s_sequence,
+    };
+
+    // Sin reintento: el WebSocket sigue llevando el mismo comando como
+    // respaldo; acá solo importa llegar rápido
+    esp_err_t err = esp_now_send(s_broadcast_mac, (const uint8_t *)&packet,
+                                 sizeof(packet));
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "esp_now_send falló: %s", esp_err_to_name(err));
+    }
+    return err;
+}
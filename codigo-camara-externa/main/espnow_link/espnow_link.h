@@ -0,0 +1,40 @@
+/**
+ * Canal lateral ESP-NOW para comandos críticos de seguridad
+ *
+ * El stop del dashboard viaja por TCP, httpd y el cliente WebSocket del
+ * vehículo: varios cambios de contexto y la exposición a retransmisiones
+ * en la única radio del S3. Este canal reenvía en paralelo los comandos
+ * chicos y críticos (stop, anulación del veto) como broadcast ESP-NOW,
+ * que entrega en milisegundos de un dígito sin importar el estado del
+ * TCP. El vehículo deduplica por número de secuencia, así recibir el
+ * mismo comando por ambos caminos es inocuo.
+ */
+
+#ifndef ESPNOW_LINK_H
+#define ESPNOW_LINK_H
+
+#include "esp_err.h"
+
+// Comandos que justifican el canal lateral; el resto viaja solo por
+// WebSocket
+typedef enum
+{
+    ESPNOW_CMD_STOP = 0,
+    ESPNOW_CMD_VETO_OVERRIDE = 1,
+} espnow_cmd_t;
+
+/**
+ * @brief Inicializa ESP-NOW sobre la interfaz SoftAP y registra el
+ *        peer de broadcast. Llamar después de softap_init().
+ */
+esp_err_t espnow_link_init(void);
+
+/**
+ * @brief Emite un comando crítico por broadcast a todos los vehículos.
+ *
+ * No bloquea ni reintenta: el mismo comando sigue viajando por el
+ * WebSocket como respaldo.
+ */
+esp_err_t espnow_link_send_command(espnow_cmd_t command);
+
+#endif // ESPNOW_LINK_H
@@ -0,0 +1,237 @@
+#include "event_log.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+
+static const char *TAG = "EventLog";
+
+// Anillo acotado estilo Vyukov: cada celda lleva un número de secuencia
+// que indica si está libre para el productor o lista para el consumidor.
+// Varios productores (tarea de visión, tarea httpd) pueden encolar en
+// paralelo sin locks; el consumidor es único (la tarea de drenado).
+#define EVENT_RING_SIZE 64 // Potencia de 2
+
+typedef struct
+{
+    _Atomic uint32_t seq;
+    uint32_t timestamp_ms;
+    uint16_t code;
+    int32_t arg1;
+    int32_t arg2;
+    int32_t arg3;
+    int32_t aux1;
+    int32_t aux2;
+} event_record_t;
+
+static event_record_t s_ring[EVENT_RING_SIZE];
+static _Atomic uint32_t s_head = 0; // Próxima celda a reservar (productores)
+static uint32_t s_tail = 0;         // Próxima celda a drenar (solo consumidor)
+static _Atomic uint32_t s_dropped = 0;
+
+static TaskHandle_t s_drain_task_handle = NULL;
+
+#define EVENT_DRAIN_PERIOD_MS 100
+
+// Ventana de retención para la línea de tiempo (trace_dump): la tarea
+// de drenado copia acá cada evento que formatea, sobrescribiendo en
+// círculo. Escritor único (el drenado); los lectores toleran registros
+// rasgados porque esto solo alimenta volcados de diagnóstico.
+#define EVENT_RETAIN_SIZE 128
+
+static event_snapshot_t s_retain[EVENT_RETAIN_SIZE];
+static _Atomic uint32_t s_retain_head = 0; // Total de eventos retenidos
+
+bool event_log_push(event_code_t code,
+                    int32_t arg1,
+                    int32_t arg2,
+                    int32_t arg3,
+                    int32_t aux1,
+                    int32_t aux2)
+{
+    uint32_t pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+
+    for (;;)
+    {
+        event_record_t *cell = &s_ring[pos & (EVENT_RING_SIZE - 1)];
+        uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+
+        if (dif == 0)
+        {
+            // Celda libre: intentar reservarla
+            if (atomic_compare_exchange_weak_explicit(&s_head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                cell->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+                cell->code = (uint16_t)code;
+                cell->arg1 = arg1;
+                cell->arg2 = arg2;
+                cell->arg3 = arg3;
+                cell->aux1 = aux1;
+                cell->aux2 = aux2;
+                // Publicar: la celda queda lista para el consumidor
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return true;
+            }
+            // CAS perdido: pos quedó actualizado, reintentar
+        }
+        else if (dif < 0)
+        {
+            // Anillo lleno: descartar sin bloquear jamás
+            atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            // Otro productor avanzó: releer la cabeza
+            pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Formatea un registro ya fuera del camino caliente
+ */
+static void event_format(const event_record_t *rec)
+{
+    switch ((event_code_t)rec->code)
+    {
+    case EVENT_DETECTION:
+        ESP_LOGI(TAG, "[%lu ms] Objeto detectado en (%ld, %ld) con %ld píxeles",
+                 (unsigned long)rec->timestamp_ms,
+                 (long)rec->arg1, (long)rec->arg2, (long)rec->arg3);
+        break;
+
+    case EVENT_DETECTION_WORLD:
+        ESP_LOGI(TAG, "[%lu ms] Objeto en píxel (%ld, %ld) -> mundo (%.2f cm, %.2f cm), %ld píxeles",
+                 (unsigned long)rec->timestamp_ms,
+                 (long)rec->arg1, (long)rec->arg2,
+                 rec->aux1 / 100.0f, rec->aux2 / 100.0f,
+                 (long)rec->arg3);
+        break;
+
+    case EVENT_FRAME_RX:
+        ESP_LOGD(TAG, "[%lu ms] Frame binario recibido de fd=%ld (%ld bytes)",
+                 (unsigned long)rec->timestamp_ms,
+                 (long)rec->arg1, (long)rec->arg2);
+        break;
+
+    case EVENT_FRAME_REASSEMBLED:
+        ESP_LOGD(TAG, "[%lu ms] Frame reensamblado de fd=%ld (%ld bytes)",
+                 (unsigned long)rec->timestamp_ms,
+                 (long)rec->arg1, (long)rec->arg2);
+        break;
+
+    default:
+        ESP_LOGW(TAG, "Evento desconocido: código %u", rec->code);
+        break;
+    }
+}
+
+/**
+ * Tarea de drenado: consume el anillo y formatea con la UART sin que
+ * ningún camino caliente la espere
+ */
+static void event_drain_task(void *pvParameters)
+{
+    uint32_t reported_drops = 0;
+
+    while (1)
+    {
+        for (;;)
+        {
+            event_record_t *cell = &s_ring[s_tail & (EVENT_RING_SIZE - 1)];
+            uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+            if ((int32_t)(seq - (s_tail + 1)) < 0)
+            {
+                break; // Celda aún no publicada: anillo drenado
+            }
+
+            event_record_t copy = *cell;
+            // Liberar la celda para una vuelta futura del productor
+            atomic_store_explicit(&cell->seq, s_tail + EVENT_RING_SIZE,
+                                  memory_order_release);
+            s_tail++;
+
+            event_format(&copy);
+
+            // Retener para la línea de tiempo
+            uint32_t head = atomic_load_explicit(&s_retain_head,
+                                                 memory_order_relaxed);
+            event_snapshot_t *slot = &s_retain[head % EVENT_RETAIN_SIZE];
+            slot->timestamp_ms = copy.timestamp_ms;
+            slot->code = copy.code;
+            slot->arg1 = copy.arg1;
+            slot->arg2 = copy.arg2;
+            slot->arg3 = copy.arg3;
+            atomic_store_explicit(&s_retain_head, head + 1,
+                                  memory_order_release);
+        }
+
+        uint32_t dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+        if (dropped != reported_drops)
+        {
+            ESP_LOGW(TAG, "%lu eventos descartados (anillo lleno)",
+                     (unsigned long)(dropped - reported_drops));
+            reported_drops = dropped;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(EVENT_DRAIN_PERIOD_MS));
+    }
+}
+
+esp_err_t event_log_start(void)
+{
+    if (s_drain_task_handle != NULL)
+    {
+        return ESP_OK;
+    }
+
+    // Inicializar las secuencias: cada celda arranca libre
+    for (uint32_t i = 0; i < EVENT_RING_SIZE; i++)
+    {
+        atomic_store_explicit(&s_ring[i].seq, i, memory_order_relaxed);
+    }
+
+    // Prioridad mínima: formatear solo cuando los cores están libres
+    BaseType_t result = xTaskCreate(event_drain_task,
+                                    "event_log",
+                                    3072,
+                                    NULL,
+                                    1,
+                                    &s_drain_task_handle);
+    if (result != pdPASS)
+    {
+        ESP_LOGE(TAG, "Error creando tarea de drenado de eventos");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+int event_log_recent(event_snapshot_t *out, int max)
+{
+    if (out == NULL || max <= 0)
+    {
+        return 0;
+    }
+
+    uint32_t head = atomic_load_explicit(&s_retain_head, memory_order_acquire);
+    uint32_t available = (head < EVENT_RETAIN_SIZE) ? head : EVENT_RETAIN_SIZE;
+    if (available > (uint32_t)max)
+    {
+        available = (uint32_t)max;
+    }
+
+    // Del más viejo al más nuevo dentro de la ventana pedida
+    uint32_t start = head - available;
+    for (uint32_t i = 0; i < available; i++)
+    {
+        out[i] = s_retain[(start + i) % EVENT_RETAIN_SIZE];
+    }
+    return (int)available;
+}
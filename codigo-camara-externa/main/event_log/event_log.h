@@ -0,0 +1,85 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief Registro de eventos diferido para caminos calientes
+ *
+ * ESP_LOGI con formato de flotantes es un printf atado a la UART; a
+ * 30 FPS cuesta más que el procesamiento que reporta. En su lugar los
+ * caminos por-frame escriben registros binarios de tamaño fijo en un
+ * anillo sin locks, y una tarea de baja prioridad los drena y formatea
+ * fuera del bucle de visión. El logging nunca marca el ritmo del loop.
+ */
+
+/**
+ * @brief Códigos de evento conocidos por el formateador
+ */
+typedef enum {
+    EVENT_DETECTION = 0,       // arg1=centroid_x, arg2=centroid_y, arg3=pixel_count
+    EVENT_DETECTION_WORLD,     // Igual + aux: world X/Y en centésimas de cm
+    EVENT_FRAME_RX,            // arg1=fd, arg2=bytes
+    EVENT_FRAME_REASSEMBLED,   // arg1=fd, arg2=bytes
+} event_code_t;
+
+/**
+ * @brief Inicia el anillo de eventos y su tarea de drenado
+ *
+ * La tarea corre con prioridad mínima: solo formatea cuando los cores
+ * no tienen trabajo más urgente.
+ *
+ * @return ESP_OK si se inició correctamente
+ */
+esp_err_t event_log_start(void);
+
+/**
+ * @brief Encola un evento (lock-free, seguro desde cualquier tarea)
+ *
+ * Nunca bloquea: si el anillo está lleno el evento se descarta y se
+ * cuenta, y la tarea de drenado reporta los descartes.
+ *
+ * @param code Código del evento
+ * @param arg1 Primer argumento (significado según código)
+ * @param arg2 Segundo argumento
+ * @param arg3 Tercer argumento
+ * @param aux1 Auxiliar 1 (solo EVENT_DETECTION_WORLD: X en cm*100)
+ * @param aux2 Auxiliar 2 (solo EVENT_DETECTION_WORLD: Y en cm*100)
+ * @return true si el evento entró al anillo
+ */
+bool event_log_push(event_code_t code,
+                    int32_t arg1,
+                    int32_t arg2,
+                    int32_t arg3,
+                    int32_t aux1,
+                    int32_t aux2);
+
+/**
+ * @brief Copia compacta de un evento para la línea de tiempo
+ */
+typedef struct
+{
+    uint32_t timestamp_ms;
+    uint16_t code;
+    int32_t arg1;
+    int32_t arg2;
+    int32_t arg3;
+} event_snapshot_t;
+
+/**
+ * @brief Copia los últimos eventos drenados, en orden cronológico
+ *
+ * La tarea de drenado retiene una ventana de lo que ya formateó; este
+ * volcado alimenta la línea de tiempo unificada (trace_dump). Lectura
+ * sin locks contra el escritor: un registro rasgado es tolerable en un
+ * volcado de diagnóstico.
+ *
+ * @param out Destino de las copias
+ * @param max Capacidad de out
+ * @return Cantidad de eventos copiados
+ */
+int event_log_recent(event_snapshot_t *out, int max);
+
+#endif // EVENT_LOG_H
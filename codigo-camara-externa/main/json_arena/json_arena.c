@@ -0,0 +1,128 @@
+#include "json_arena.h"
+#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Tamaño del bloque por tarea: la lista de vehículos más grande ronda
+// los 600 bytes de nodos más el buffer de impresión
+#define JSON_ARENA_SIZE 2048
+
+// Tareas que arman JSON en paralelo (httpd, transmisión WS, visión)
+#define JSON_ARENA_MAX_TASKS 6
+
+typedef struct
+{
+    size_t used;
+    uint8_t buf[JSON_ARENA_SIZE];
+} json_arena_t;
+
+// Mapa tarea -> arena. Las entradas se reclaman una sola vez por CAS;
+// después cada tarea solo lee la suya
+typedef struct
+{
+    _Atomic(void *) task;
+    json_arena_t *arena;
+} json_arena_slot_t;
+
+static json_arena_slot_t s_slots[JSON_ARENA_MAX_TASKS];
+
+static json_arena_t *arena_for_current_task(bool create)
+{
+    void *task = (void *)xTaskGetCurrentTaskHandle();
+
+    for (int i = 0; i < JSON_ARENA_MAX_TASKS; i++)
+    {
+        if (atomic_load_explicit(&s_slots[i].task, memory_order_acquire) == task)
+        {
+            return s_slots[i].arena;
+        }
+    }
+
+    if (!create)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < JSON_ARENA_MAX_TASKS; i++)
+    {
+        void *expected = NULL;
+        if (atomic_compare_exchange_strong_explicit(&s_slots[i].task, &expected, task,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed))
+        {
+            json_arena_t *arena = malloc(sizeof(json_arena_t));
+            if (arena != NULL)
+            {
+                arena->used = 0;
+            }
+            s_slots[i].arena = arena;
+            // Publicar arena antes de que otro lector encuentre la tarea
+            atomic_store_explicit(&s_slots[i].task, task, memory_order_release);
+            return arena;
+        }
+    }
+
+    return NULL; // Sin slots: esta tarea usa el heap normal
+}
+
+static void *arena_malloc_hook(size_t size)
+{
+    json_arena_t *arena = arena_for_current_task(true);
+    if (arena != NULL)
+    {
+        size_t aligned = (size + 3) & ~(size_t)3;
+        if (arena->used + aligned <= JSON_ARENA_SIZE)
+        {
+            void *ptr = arena->buf + arena->used;
+            arena->used += aligned;
+            return ptr;
+        }
+    }
+
+    // Arena llena o inexistente: el heap normal absorbe el excedente
+    return malloc(size);
+}
+
+static void arena_free_hook(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    // Los punteros de arena se liberan en bloque con el reset; solo lo
+    // que cayó al heap se devuelve de verdad
+    for (int i = 0; i < JSON_ARENA_MAX_TASKS; i++)
+    {
+        json_arena_t *arena = s_slots[i].arena;
+        if (arena != NULL &&
+            (uint8_t *)ptr >= arena->buf &&
+            (uint8_t *)ptr < arena->buf + JSON_ARENA_SIZE)
+        {
+            return;
+        }
+    }
+
+    free(ptr);
+}
+
+void json_arena_register_hooks(void)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = arena_malloc_hook,
+        .free_fn = arena_free_hook,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+void json_arena_reset(void)
+{
+    json_arena_t *arena = arena_for_current_task(false);
+    if (arena != NULL)
+    {
+        arena->used = 0;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+/**
+ * @brief Arena por tarea para las reservas de cJSON
+ *
+ * Cada árbol cJSON (listas de vehículos, mensajes de estado) se arma
+ * con decenas de mallocs chicos y se libera nodo por nodo, varias veces
+ * por segundo — pura fragmentación en un heap compartido con los frame
+ * buffers. Con los hooks instalados, cada tarea recibe un bloque fijo
+ * del que cJSON toma memoria con un simple avance de puntero, y
+ * json_arena_reset() lo recicla entero en O(1) al terminar el mensaje.
+ * Si un árbol no entra en el bloque, el excedente cae al heap normal
+ * sin que el llamador lo note.
+ */
+
+/**
+ * @brief Instala los hooks de cJSON. Llamar una vez al arrancar,
+ *        antes del primer uso de cJSON
+ */
+void json_arena_register_hooks(void);
+
+/**
+ * @brief Recicla la arena de la tarea actual en O(1)
+ *
+ * Llamar después de liberar el árbol del mensaje (cJSON_Delete /
+ * cJSON_free); ningún puntero de cJSON de esta tarea debe sobrevivir
+ * al reset.
+ */
+void json_arena_reset(void);
+
+#endif // JSON_ARENA_H
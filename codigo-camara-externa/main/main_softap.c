@@ -16,26 +16,89 @@
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 
 // Módulos del sistema
 #include "softap/softap.h"
 #include "camera_driver/camera_driver.h"
 #include "ws_server/ws_server.h"
+#include "udp_video/udp_video.h"
+#include "espnow_link/espnow_link.h"
 #include "vision_task/vision_task.h"
+#include "event_log/event_log.h"
+#include "json_arena/json_arena.h"
+#include "mdns.h"
 
 // Tests opcionales
 #include "test_detection.h"
 #include "test_homography.h"
+#include "test_benchmark.h"
 
 // Configuración de modo de operación
 #define ENABLE_DETECTION_TEST 0
 #define ENABLE_HOMOGRAPHY_TEST 0
+// La suite de regresión (pytest_perf_regression.py) lo enciende vía
+// CONFIG_VISION_BENCHMARK_ON_BOOT sin tocar el código
+#ifdef CONFIG_VISION_BENCHMARK_ON_BOOT
+#define ENABLE_VISION_BENCHMARK 1
+#else
+#define ENABLE_VISION_BENCHMARK 0
+#endif
+// Satura el camino WS con frames sintéticos y reporta fps sostenibles;
+// requiere un dashboard conectado (ver ws_server_run_tx_benchmark)
+#define ENABLE_WS_TX_BENCHMARK 0
 
 // For opencv compatibility
 #undef EPS
 
 static const char *TAG = "Main";
 
+// ============================================================================
+// ARRANQUE CONCURRENTE DE LA CÁMARA
+// ============================================================================
+// El sondeo SCCB del sensor es la parte lenta del arranque y no depende
+// de la red; corre en su propia tarea en Core 1 mientras Core 0 levanta
+// los servicios. Los vehículos empiezan a asociarse al SoftAP durante
+// el sondeo en vez de esperar detrás de él.
+
+#define CAMERA_READY_BIT BIT0
+#define CAMERA_FAILED_BIT BIT1
+
+static EventGroupHandle_t s_boot_events = NULL;
+static StaticEventGroup_t s_boot_events_buf;
+
+static void camera_bringup(void)
+{
+    ESP_LOGI(TAG, "[2/4] Inicializando cámara OV2640 (en paralelo)...");
+    if (camera_init() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error inicializando cámara");
+        xEventGroupSetBits(s_boot_events, CAMERA_FAILED_BIT);
+        return;
+    }
+    ESP_LOGI(TAG, "✓ Cámara inicializada: RGB565 @ VGA (640x480)");
+
+    // La tarea de visión solo depende de la cámara: arranca aquí mismo
+    // sin esperar a que el resto de los servicios terminen
+    ESP_LOGI(TAG, "[4/4] Iniciando tarea de visión en Core 1...");
+    if (vision_task_start() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error iniciando tarea de visión");
+        xEventGroupSetBits(s_boot_events, CAMERA_FAILED_BIT);
+        return;
+    }
+    ESP_LOGI(TAG, "✓ Tarea de visión activa en Core 1");
+
+    xEventGroupSetBits(s_boot_events, CAMERA_READY_BIT);
+}
+
+static void camera_init_task(void *pvParameters)
+{
+    (void)pvParameters;
+    camera_bringup();
+    vTaskDelete(NULL);
+}
+
 void app_main(void)
 {
     esp_err_t ret;
@@ -57,18 +120,27 @@ void app_main(void)
     }
     ESP_LOGI(TAG, "✓ SoftAP iniciado: ESP32-Vision-Bot @ 192.168.4.1");
 
-    // ========== INICIALIZACIÓN DE CÁMARA ==========
-    ESP_LOGI(TAG, "[2/4] Inicializando cámara OV2640...");
-    ret = camera_init();
-    if (ret != ESP_OK)
+    // Canal lateral ESP-NOW para comandos críticos (stop); no es fatal
+    if (espnow_link_init() != ESP_OK)
     {
-        ESP_LOGE(TAG, "Error inicializando cámara");
-        return;
+        ESP_LOGW(TAG, "ESP-NOW no disponible; el stop viaja solo por WebSocket");
+    }
+
+    // ========== INICIALIZACIÓN DE CÁMARA (CONCURRENTE) ==========
+    // Con el AP ya en el aire, el sondeo lento del sensor corre en
+    // Core 1 mientras Core 0 sigue con los servicios de red
+    s_boot_events = xEventGroupCreateStatic(&s_boot_events_buf);
+    if (xTaskCreatePinnedToCore(camera_init_task, "init_camera", 4096, NULL,
+                                5, NULL, 1) != pdPASS)
+    {
+        // Sin la tarea el arranque vuelve al camino serial de siempre
+        ESP_LOGW(TAG, "Sin memoria para el arranque paralelo - cámara en serie");
+        camera_bringup();
     }
-    ESP_LOGI(TAG, "✓ Cámara inicializada: RGB565 @ VGA (640x480)");
 
     // ========== INICIALIZACIÓN DE SERVIDOR WEBSOCKET ==========
     ESP_LOGI(TAG, "[3/4] Iniciando servidor WebSocket...");
+    json_arena_register_hooks(); // Antes del primer árbol cJSON
     ret = ws_server_start();
     if (ret != ESP_OK)
     {
@@ -77,15 +149,47 @@ void app_main(void)
     }
     ESP_LOGI(TAG, "✓ Servidor WebSocket activo en Core 0");
 
-    // ========== INICIALIZACIÓN DE TAREA DE VISIÓN ==========
-    ESP_LOGI(TAG, "[4/4] Iniciando tarea de visión en Core 1...");
-    ret = vision_task_start();
+    // Anuncio mDNS del servidor: los vehículos descubren _minitesla._tcp
+    // en vez de asumir 192.168.4.1, así el servidor puede mudarse a
+    // infraestructura LAN sin reflashear la flota. No es fatal: sin
+    // mDNS los vehículos caen a su caché NVS o a la URI por defecto.
+    if (mdns_init() == ESP_OK)
+    {
+        mdns_hostname_set("minitesla");
+        mdns_instance_name_set("Mini Tesla - Servidor de vision");
+        mdns_service_add(NULL, "_minitesla", "_tcp", 80, NULL, 0);
+        ESP_LOGI(TAG, "✓ mDNS anunciando _minitesla._tcp en minitesla.local");
+    }
+    else
+    {
+        ESP_LOGW(TAG, "mDNS no disponible; descubrimiento solo por caché/URI fija");
+    }
+
+    // Canal alternativo de video por datagramas desde el vehículo
+    ret = udp_video_start();
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Error iniciando tarea de visión");
+        ESP_LOGW(TAG, "Receptor UDP no disponible; el video queda en WebSocket");
+    }
+
+    // Drenado diferido de eventos de los caminos calientes
+    ret = event_log_start();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error iniciando registro de eventos");
+        return;
+    }
+
+    // ========== SINCRONIZACIÓN CON LA PISTA DE CÁMARA ==========
+    // A esta altura los vehículos ya pudieron asociarse y registrarse;
+    // solo falta que termine el sondeo del sensor en Core 1
+    EventBits_t boot_bits = xEventGroupWaitBits(
+        s_boot_events, CAMERA_READY_BIT | CAMERA_FAILED_BIT,
+        pdFALSE, pdFALSE, portMAX_DELAY);
+    if (boot_bits & CAMERA_FAILED_BIT)
+    {
         return;
     }
-    ESP_LOGI(TAG, "✓ Tarea de visión activa en Core 1");
 
     // ========== SISTEMA LISTO ==========
     ESP_LOGI(TAG, "");
@@ -115,6 +219,18 @@ void app_main(void)
     run_homography_tests();
 #endif
 
+#if ENABLE_VISION_BENCHMARK
+    ESP_LOGI(TAG, "Ejecutando benchmarks de visión...");
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    run_vision_benchmarks();
+#endif
+
+#if ENABLE_WS_TX_BENCHMARK
+    ESP_LOGI(TAG, "Ejecutando benchmark de transmisión WS (esperando dashboards)...");
+    vTaskDelay(pdMS_TO_TICKS(15000)); // Tiempo para conectar los clientes
+    ws_server_run_tx_benchmark(20 * 1024, 10000); // ~frame VGA típico
+#endif
+
     // ========== MONITOREO DEL SISTEMA ==========
     ESP_LOGI(TAG, "Iniciando monitoreo del sistema...");
     uint32_t last_report = 0;
@@ -126,10 +242,14 @@ void app_main(void)
         // Reporte cada 10 segundos
         if (now - last_report >= 10000)
         {
+            uint32_t video_drops, other_drops;
+            ws_server_get_tx_drops(&video_drops, &other_drops);
+
             ESP_LOGI(TAG, "═══ Estado del Sistema ═══");
             ESP_LOGI(TAG, "  Clientes WS:    %d", ws_server_get_clients_count());
             ESP_LOGI(TAG, "  Estaciones AP:  %d", softap_get_connected_stations());
             ESP_LOGI(TAG, "  Free Heap:      %lu bytes", esp_get_free_heap_size());
+            ESP_LOGI(TAG, "  Drops TX:       %lu video / %lu otros", video_drops, other_drops);
             ESP_LOGI(TAG, "  Uptime:         %lu ms", now);
 
             last_report = now;
@@ -0,0 +1,118 @@
+#include "mem_arena/mem_arena.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "mem_arena";
+
+#define ARENA_ALIGN 8
+
+typedef struct
+{
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t high_water;
+} arena_region_t;
+
+static arena_region_t s_internal;
+static arena_region_t s_psram;
+static uint32_t s_generation;
+
+static void *region_alloc(arena_region_t *region, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (region->base == NULL || region->used + size > region->size)
+    {
+        return NULL;
+    }
+
+    void *ptr = region->base + region->used;
+    region->used += size;
+    if (region->used > region->high_water)
+    {
+        region->high_water = region->used;
+    }
+    return ptr;
+}
+
+esp_err_t mem_arena_init(size_t internal_size, size_t psram_size)
+{
+    if (s_internal.base != NULL)
+    {
+        return ESP_OK;
+    }
+
+    s_internal.base = heap_caps_malloc(internal_size,
+                                       MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (s_internal.base == NULL)
+    {
+        ESP_LOGE(TAG, "Sin RAM interna para la arena de %u bytes",
+                 (unsigned)internal_size);
+        return ESP_ERR_NO_MEM;
+    }
+    s_internal.size = internal_size;
+
+    if (psram_size > 0)
+    {
+        s_psram.base = heap_caps_malloc(psram_size, MALLOC_CAP_SPIRAM);
+        if (s_psram.base == NULL)
+        {
+            // No es fatal: los pedidos grandes compiten por el bloque interno
+            ESP_LOGW(TAG, "Sin PSRAM para la arena (%u bytes) - solo interna",
+                     (unsigned)psram_size);
+        }
+        else
+        {
+            s_psram.size = psram_size;
+        }
+    }
+
+    ESP_LOGI(TAG, "Arena lista: %u interna + %u PSRAM",
+             (unsigned)s_internal.size, (unsigned)s_psram.size);
+    return ESP_OK;
+}
+
+void *mem_arena_alloc(size_t size)
+{
+    void *ptr = region_alloc(&s_internal, size);
+    if (ptr == NULL)
+    {
+        // Desborde: memoria más lenta, pero la etapa corre igual
+        ptr = region_alloc(&s_psram, size);
+    }
+    return ptr;
+}
+
+void *mem_arena_alloc_psram(size_t size)
+{
+    void *ptr = region_alloc(&s_psram, size);
+    if (ptr == NULL)
+    {
+        ptr = region_alloc(&s_internal, size);
+    }
+    return ptr;
+}
+
+void mem_arena_reset(void)
+{
+    s_internal.used = 0;
+    s_psram.used = 0;
+    s_generation++;
+}
+
+uint32_t mem_arena_generation(void)
+{
+    return s_generation;
+}
+
+void mem_arena_high_water(size_t *internal_hwm, size_t *psram_hwm)
+{
+    if (internal_hwm)
+    {
+        *internal_hwm = s_internal.high_water;
+    }
+    if (psram_hwm)
+    {
+        *psram_hwm = s_psram.high_water;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Arena de scratch por frame para el pipeline de visión
+ *
+ * Las etapas de detección necesitan memoria de trabajo que vive lo que
+ * dura un frame (tablas de etiquetas, corridas, máscaras). Pedirla con
+ * malloc 15 veces por segundo es la receta de la fragmentación que ya
+ * sufrió el heap compartido con los frame buffers; dejarla estática
+ * clava el peor caso en .bss para siempre. La arena reserva un bloque
+ * de RAM interna y uno de PSRAM al arrancar, entrega tajadas con un
+ * avance de puntero y mem_arena_reset() recicla todo en O(1) al
+ * empezar cada frame.
+ *
+ * No es thread-safe a propósito: reservar desde la tarea dueña del
+ * frame, antes de despachar trabajo a los workers (mismo contrato que
+ * los estáticos que reemplaza).
+ */
+
+/**
+ * @brief Reserva las regiones de respaldo. Llamar una vez al arrancar.
+ *
+ * Quedarse sin PSRAM no es fatal: los pedidos grandes compiten por el
+ * bloque interno.
+ *
+ * @param internal_size Bytes de RAM interna para scratch caliente
+ * @param psram_size Bytes de PSRAM para scratch grande/frío (0 = nada)
+ * @return ESP_OK, o ESP_ERR_NO_MEM si falló el bloque interno
+ */
+esp_err_t mem_arena_init(size_t internal_size, size_t psram_size);
+
+/**
+ * @brief Reserva scratch del frame, RAM interna primero
+ *
+ * Desborda a la región PSRAM cuando el bloque interno se llena.
+ *
+ * @return Puntero alineado a 8, o NULL con ambas regiones llenas (el
+ *         llamador degrada la etapa, nunca bloquea por esto)
+ */
+void *mem_arena_alloc(size_t size);
+
+/**
+ * @brief Reserva scratch del frame, PSRAM primero
+ *
+ * Para buffers demasiado grandes o fríos para gastar RAM interna.
+ */
+void *mem_arena_alloc_psram(size_t size);
+
+/**
+ * @brief Recicla ambas regiones en O(1). Una vez por frame, antes de
+ *        la primera reserva. Ningún puntero de la arena lo sobrevive.
+ */
+void mem_arena_reset(void);
+
+/**
+ * @brief Contador de resets, avanza con cada mem_arena_reset()
+ *
+ * Permite que una etapa que corre varias veces por frame reutilice su
+ * primera reserva en vez de tomar otra tajada.
+ */
+uint32_t mem_arena_generation(void);
+
+/**
+ * @brief Marca de agua histórica de cada región en bytes
+ *
+ * La realimentación de tamaño para /stats: una marca cerca del tamaño
+ * de la región avisa que la próxima etapa va a empezar a desbordar.
+ */
+void mem_arena_high_water(size_t *internal_hwm, size_t *psram_hwm);
+
+#endif // MEM_ARENA_H
@@ -0,0 +1,97 @@
+/**
+ * @file metrics.c
+ * @brief Implementación del registro de métricas para /metrics
+ */
+
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "[Metrics]";
+
+// Registro plano: se llena durante los inits (un solo hilo) y después
+// solo se lee desde los workers de httpd, así que no necesita lock
+static metrics_provider_fn s_providers[METRICS_MAX_PROVIDERS];
+static int s_provider_count = 0;
+
+// Una línea de exposición típica ronda los 60-80 bytes; 192 deja lugar
+// para etiquetas largas sin cargar la pila del worker
+#define METRICS_LINE_MAX 192
+
+void metrics_printf(metrics_writer_t *w, const char *fmt, ...)
+{
+    char line[METRICS_LINE_MAX];
+
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (len <= 0)
+    {
+        return;
+    }
+    if (len >= (int)sizeof(line))
+    {
+        // Entera o nada: una línea truncada rompe el parser del scraper
+        ESP_LOGW(TAG, "Línea de métrica truncada (%d bytes) - descartada", len);
+        return;
+    }
+
+    w->sink(w->ctx, line, (size_t)len);
+}
+
+esp_err_t metrics_register(metrics_provider_fn provider)
+{
+    if (provider == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_provider_count >= METRICS_MAX_PROVIDERS)
+    {
+        ESP_LOGW(TAG, "Registro lleno (%d proveedores) - subir METRICS_MAX_PROVIDERS",
+                 METRICS_MAX_PROVIDERS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_providers[s_provider_count++] = provider;
+    return ESP_OK;
+}
+
+void metrics_render(metrics_writer_t *w)
+{
+    // Base del proceso: uptime y salud del heap por capacidad. El mayor
+    // bloque libre junto al total delata fragmentación en la serie de
+    // tiempo mucho antes de que falle un malloc grande.
+    metrics_printf(w,
+                   "# TYPE minitesla_uptime_seconds counter\n"
+                   "minitesla_uptime_seconds %llu\n",
+                   (unsigned long long)(esp_timer_get_time() / 1000000));
+
+    multi_heap_info_t heap_int, heap_psram;
+    heap_caps_get_info(&heap_int, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    heap_caps_get_info(&heap_psram, MALLOC_CAP_SPIRAM);
+    metrics_printf(w,
+                   "# TYPE minitesla_heap_free_bytes gauge\n"
+                   "minitesla_heap_free_bytes{region=\"internal\"} %u\n"
+                   "minitesla_heap_free_bytes{region=\"psram\"} %u\n",
+                   (unsigned)heap_int.total_free_bytes,
+                   (unsigned)heap_psram.total_free_bytes);
+    metrics_printf(w,
+                   "# TYPE minitesla_heap_largest_free_bytes gauge\n"
+                   "minitesla_heap_largest_free_bytes{region=\"internal\"} %u\n"
+                   "minitesla_heap_largest_free_bytes{region=\"psram\"} %u\n",
+                   (unsigned)heap_int.largest_free_block,
+                   (unsigned)heap_psram.largest_free_block);
+
+    for (int i = 0; i < s_provider_count; i++)
+    {
+        s_providers[i](w);
+    }
+}
@@ -0,0 +1,83 @@
+/**
+ * @file metrics.h
+ * @brief Registro de métricas estilo Prometheus para el endpoint /metrics
+ *
+ * Los contadores ad-hoc (/stats, logs periódicos) sirven para mirar un
+ * equipo; para atrapar regresiones lentas en la flota hace falta que el
+ * monitoreo de la LAN los raspe como series de tiempo. Este registro es
+ * pull: cada componente (visión, servidor WS, captura) registra un
+ * proveedor y recién al atender un GET /metrics se leen los contadores
+ * y se emiten en el formato de texto estándar de Prometheus. Nada se
+ * acumula acá - los dueños de los datos siguen siendo los componentes.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Proveedores que caben en el registro; subirlo si un componente nuevo
+// no entra (el registro avisa por log)
+#define METRICS_MAX_PROVIDERS 8
+
+    /**
+     * @brief Destino de la salida: recibe texto ya formateado
+     *
+     * El handler HTTP pasa un sink que envía chunks de httpd; los tests
+     * de host pueden pasar uno que escriba a un buffer.
+     */
+    typedef esp_err_t (*metrics_sink_fn)(void *ctx, const char *data, size_t len);
+
+    typedef struct
+    {
+        metrics_sink_fn sink;
+        void *ctx;
+    } metrics_writer_t;
+
+    /**
+     * @brief Emitir una línea (o varias) con formato printf
+     *
+     * Formatea en un buffer de pila y lo pasa al sink; una línea que no
+     * entra en el buffer se descarta entera para no partir la sintaxis
+     * de exposición.
+     */
+    void metrics_printf(metrics_writer_t *w, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+    /**
+     * @brief Proveedor de métricas de un componente
+     *
+     * Se invoca en cada scrape, en el contexto del worker de httpd:
+     * leer contadores (atómicos o snapshots) y emitir, sin bloquear en
+     * colas ni tomar locks de larga vida.
+     */
+    typedef void (*metrics_provider_fn)(metrics_writer_t *w);
+
+    /**
+     * @brief Registrar un proveedor
+     *
+     * Pensado para las rutinas de init (un solo hilo); no hay des-registro.
+     *
+     * @return ESP_ERR_NO_MEM si el registro está lleno
+     */
+    esp_err_t metrics_register(metrics_provider_fn provider);
+
+    /**
+     * @brief Emitir el snapshot completo: base del proceso + proveedores
+     *
+     * Emite primero uptime y salud del heap (que no tienen otro dueño
+     * natural) y después recorre los proveedores en orden de registro.
+     */
+    void metrics_render(metrics_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,103 @@
+/**
+ * @file perf_probe.c
+ * @brief Implementación de la sonda sobre el componente perfmon de IDF
+ *
+ * El Xtensa LX6/LX7 trae dos contadores de performance por núcleo.
+ * PM0 cuenta instrucciones retiradas y PM1 fallos de caché en cargas
+ * de datos (el camino PSRAM->caché, el sospechoso habitual en los
+ * kernels de visión); los ciclos salen del CCOUNT como en el resto de
+ * los benchmarks. Si el perfmon no inicializa, la sonda degrada a
+ * solo-ciclos y lo marca en counters_valid.
+ */
+
+#include "perf_probe.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "xtensa_perfmon_access.h"
+#include "xtensa/xt_perf_consts.h"
+#include <string.h>
+
+static const char *TAG = "PerfProbe";
+
+// PM0: instrucciones retiradas, todas las clases
+#define PERF_PROBE_PM_INSN 0
+// PM1: cargas de datos que fallaron la caché local
+#define PERF_PROBE_PM_DMISS 1
+
+static bool s_perfmon_ready = false;
+static bool s_perfmon_failed = false;
+
+/**
+ * @brief Configura los dos contadores una sola vez
+ */
+static bool perf_probe_setup(void)
+{
+    if (s_perfmon_ready)
+    {
+        return true;
+    }
+    if (s_perfmon_failed)
+    {
+        return false;
+    }
+
+    esp_err_t err = xtensa_perfmon_init(PERF_PROBE_PM_INSN,
+                                        XTPERF_CNT_INSN,
+                                        XTPERF_MASK_INSN_ALL, 0, -1);
+    if (err == ESP_OK)
+    {
+        err = xtensa_perfmon_init(PERF_PROBE_PM_DMISS,
+                                  XTPERF_CNT_D_LOAD_U1,
+                                  XTPERF_MASK_D_LOAD_LOCAL_MISSES, 0, -1);
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Perfmon no disponible (0x%x) - solo ciclos", err);
+        s_perfmon_failed = true;
+        return false;
+    }
+
+    s_perfmon_ready = true;
+    return true;
+}
+
+void perf_probe_begin(perf_probe_t *probe)
+{
+    if (probe == NULL)
+    {
+        return;
+    }
+
+    memset(probe, 0, sizeof(*probe));
+    probe->counters_valid = perf_probe_setup();
+
+    if (probe->counters_valid)
+    {
+        xtensa_perfmon_reset(PERF_PROBE_PM_INSN);
+        xtensa_perfmon_reset(PERF_PROBE_PM_DMISS);
+        xtensa_perfmon_start();
+    }
+
+    // El CCOUNT va último: que el armado del perfmon no cuente
+    probe->start_cycles = esp_cpu_get_cycle_count();
+}
+
+void perf_probe_end(perf_probe_t *probe)
+{
+    uint32_t end_cycles = esp_cpu_get_cycle_count();
+
+    if (probe == NULL)
+    {
+        return;
+    }
+
+    probe->cycles = end_cycles - probe->start_cycles;
+
+    if (probe->counters_valid)
+    {
+        xtensa_perfmon_stop();
+        probe->instructions = xtensa_perfmon_value(PERF_PROBE_PM_INSN);
+        probe->d_load_misses = xtensa_perfmon_value(PERF_PROBE_PM_DMISS);
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ * @file perf_probe.h
+ * @brief Sonda de contadores de rendimiento Xtensa para los benchmarks
+ *
+ * Los ciclos solos no distinguen un kernel limitado por ALU de uno
+ * estancado esperando PSRAM. La sonda arma los dos contadores del
+ * perfmon Xtensa (instrucciones retiradas y fallos de caché en cargas
+ * de datos) alrededor de una región medida, junto con el contador de
+ * ciclos del CCOUNT. Con ciclos, instrucciones y fallos por frame se
+ * puede calcular IPC y decidir entre LUT, SIMD o buffers de staging
+ * con datos en vez de intuición.
+ */
+
+#ifndef PERF_PROBE_H
+#define PERF_PROBE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Resultado de una región medida
+     */
+    typedef struct
+    {
+        uint32_t cycles;         // Ciclos de CPU (CCOUNT)
+        uint32_t instructions;   // Instrucciones retiradas (perfmon PM0)
+        uint32_t d_load_misses;  // Fallos de caché en cargas (perfmon PM1)
+        bool counters_valid;     // false si el perfmon no está disponible
+        uint32_t start_cycles;   // Interno: CCOUNT al armar la sonda
+    } perf_probe_t;
+
+    /**
+     * @brief Arma los contadores y marca el inicio de la región
+     *
+     * Los contadores del perfmon son por núcleo: la región medida debe
+     * ejecutar en el mismo núcleo que llamó a begin/end (los benchmarks
+     * corren en una sola tarea, así que se cumple solo).
+     */
+    void perf_probe_begin(perf_probe_t *probe);
+
+    /**
+     * @brief Detiene los contadores y llena el resultado
+     */
+    void perf_probe_end(perf_probe_t *probe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERF_PROBE_H
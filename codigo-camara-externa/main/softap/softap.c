@@ -13,6 +13,18 @@
 static const char *TAG = "SoftAP";
 static esp_netif_t *ap_netif = NULL;
 
+#if SOFTAP_PERF_PROFILE
+// Más buffers = más RAM retenida por el driver WiFi; estos valores
+// mantienen un par de frames VGA en vuelo sin ahogar al resto del
+// sistema (el ahorro se nota recién con AMPDU, que necesita cola)
+#define SOFTAP_STATIC_RX_BUF_NUM 16
+#define SOFTAP_DYNAMIC_RX_BUF_NUM 64
+#define SOFTAP_DYNAMIC_TX_BUF_NUM 64
+#endif
+
+// HT40 efectivamente aplicado (el driver puede rechazarlo)
+static bool s_ht40_applied = false;
+
 /**
  * @brief Manejador de eventos WiFi para SoftAP
  */
@@ -77,6 +89,16 @@ esp_err_t softap_init(void)
 
     // Configuración WiFi por defecto
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+#if SOFTAP_PERF_PROFILE
+    // Perfil de rendimiento: los defaults de IDF priorizan huella de
+    // RAM. Con el video de dos cámaras y los comandos compartiendo
+    // este radio conviene pagar los buffers extra y la agregación
+    cfg.static_rx_buf_num = SOFTAP_STATIC_RX_BUF_NUM;
+    cfg.dynamic_rx_buf_num = SOFTAP_DYNAMIC_RX_BUF_NUM;
+    cfg.dynamic_tx_buf_num = SOFTAP_DYNAMIC_TX_BUF_NUM;
+    cfg.ampdu_tx_enable = 1;
+    cfg.ampdu_rx_enable = 1;
+#endif
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     // Registrar manejador de eventos
@@ -95,6 +117,10 @@ esp_err_t softap_init(void)
             .password = SOFTAP_PASSWORD,
             .max_connection = SOFTAP_MAX_CONNECTIONS,
             .authmode = WIFI_AUTH_WPA_WPA2_PSK, // Modo mixto para mejor compatibilidad
+            // Beacons cada 50 ms en lugar de 100: los vehículos que ya
+            // están escaneando ven el AP antes durante el arranque, que
+            // es cuando cada beacon perdido retrasa a toda la flota
+            .beacon_interval = 50,
             .pmf_cfg = {
                 .required = false,
                 .capable = true,
@@ -110,6 +136,25 @@ esp_err_t softap_init(void)
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
+
+#if SOFTAP_PERF_PROFILE
+    // 11n a 40 MHz duplica el techo PHY. Si el driver rechaza HT40
+    // (entorno con demasiada interferencia) seguimos en HT20; no es
+    // motivo para abortar el arranque
+    ESP_ERROR_CHECK(esp_wifi_set_protocol(WIFI_IF_AP,
+                                          WIFI_PROTOCOL_11B |
+                                          WIFI_PROTOCOL_11G |
+                                          WIFI_PROTOCOL_11N));
+    if (esp_wifi_set_bandwidth(WIFI_IF_AP, WIFI_BW_HT40) == ESP_OK)
+    {
+        s_ht40_applied = true;
+    }
+    else
+    {
+        ESP_LOGW(TAG, "HT40 rechazado por el driver, quedamos en HT20");
+    }
+#endif
+
     ESP_ERROR_CHECK(esp_wifi_start());
 
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════╗");
@@ -119,6 +164,7 @@ esp_err_t softap_init(void)
     ESP_LOGI(TAG, "║ Password:      %s", strlen(SOFTAP_PASSWORD) > 0 ? "********" : "OPEN");
     ESP_LOGI(TAG, "║ IP Address:    %s", SOFTAP_IP_ADDR);
     ESP_LOGI(TAG, "║ Channel:       %d", SOFTAP_CHANNEL);
+    ESP_LOGI(TAG, "║ Bandwidth:     %s", s_ht40_applied ? "HT40" : "HT20");
     ESP_LOGI(TAG, "║ Max Clients:   %d", SOFTAP_MAX_CONNECTIONS);
     ESP_LOGI(TAG, "╚════════════════════════════════════════════════╝");
 
@@ -147,6 +193,23 @@ esp_err_t softap_stop(void)
     return ESP_OK;
 }
 
+void softap_get_perf_profile(softap_perf_profile_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+#if SOFTAP_PERF_PROFILE
+    out->ht40 = s_ht40_applied;
+    out->ampdu_tx = true;
+    out->ampdu_rx = true;
+    out->static_rx_buf_num = SOFTAP_STATIC_RX_BUF_NUM;
+    out->dynamic_rx_buf_num = SOFTAP_DYNAMIC_RX_BUF_NUM;
+    out->dynamic_tx_buf_num = SOFTAP_DYNAMIC_TX_BUF_NUM;
+#endif
+}
+
 uint8_t softap_get_connected_stations(void)
 {
     wifi_sta_list_t sta_list;
@@ -2,6 +2,8 @@
 #define SOFTAP_H
 
 #include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
 
 /**
  * @brief Configuración del SoftAP
@@ -18,6 +20,41 @@
 #define SOFTAP_GATEWAY_ADDR "192.168.4.1"
 #define SOFTAP_NETMASK_ADDR "255.255.255.0"
 
+/**
+ * @brief Perfil de rendimiento del radio
+ *
+ * Con 1, la init reemplaza los defaults de IDF (pensados para gastar
+ * poca RAM) por valores orientados a throughput: HT40, agregación
+ * A-MPDU y más buffers de RX/TX. Todo el video y el control comparten
+ * este AP, así que esta configuración es el techo de ancho de banda
+ * del sistema completo.
+ */
+#define SOFTAP_PERF_PROFILE 1
+
+/**
+ * @brief Trade-off de radio efectivamente aplicado
+ *
+ * Lo que quedó configurado de verdad (HT40 puede ser rechazado por el
+ * driver), para consultarlo en runtime y correlacionar mediciones con
+ * la configuración vigente.
+ */
+typedef struct
+{
+    bool ht40;                   // Ancho de banda de 40 MHz aplicado
+    bool ampdu_tx;               // Agregación A-MPDU en transmisión
+    bool ampdu_rx;               // Agregación A-MPDU en recepción
+    uint8_t static_rx_buf_num;   // Buffers estáticos de RX (DMA)
+    uint16_t dynamic_rx_buf_num; // Buffers dinámicos de RX
+    uint16_t dynamic_tx_buf_num; // Buffers dinámicos de TX
+} softap_perf_profile_t;
+
+/**
+ * @brief Devuelve el perfil de rendimiento aplicado por softap_init()
+ *
+ * Con SOFTAP_PERF_PROFILE en 0 devuelve todo en cero (defaults de IDF).
+ */
+void softap_get_perf_profile(softap_perf_profile_t *out);
+
 /**
  * @brief Inicializa el modo SoftAP (Punto de Acceso)
  * 
@@ -0,0 +1,200 @@
+#include "test_benchmark.h"
+#include "perf_probe.h"
+#include "vision/vision.h"
+#include "vision/homography.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "Benchmark";
+
+// Verde puro en RGB565: cae dentro de COLOR_GREEN tras la conversión
+#define BENCH_PIXEL_GREEN 0x07E0
+// Gris medio: fuera de todos los rangos predefinidos
+#define BENCH_PIXEL_GRAY 0x8410
+
+/**
+ * Línea de salida legible por máquina:
+ *   BENCH,<kernel>,<resolución>,<iteraciones>,<ciclos>,<ciclos/unidad>,
+ *         <instrucciones>,<fallos de caché en cargas>
+ *
+ * Las dos columnas finales salen del perfmon Xtensa (perf_probe); son 0
+ * cuando los contadores no están disponibles. ciclos/instrucciones da
+ * el IPC y los fallos de caché separan "estancado en PSRAM" de
+ * "limitado por ALU".
+ */
+static void bench_report(const char *kernel,
+                         const char *resolution,
+                         uint32_t iterations,
+                         const perf_probe_t *probe,
+                         uint32_t units)
+{
+    printf("BENCH,%s,%s,%lu,%lu,%.2f,%lu,%lu\n",
+           kernel, resolution,
+           (unsigned long)iterations,
+           (unsigned long)probe->cycles,
+           units > 0 ? (float)probe->cycles / units : 0.0f,
+           (unsigned long)probe->instructions,
+           (unsigned long)probe->d_load_misses);
+}
+
+/**
+ * Frame sintético: fondo gris con un cuadrado verde del 10%% del ancho
+ * centrado, suficiente para que la detección tenga un blob real que
+ * etiquetar y la caja no degenere
+ */
+static uint16_t *bench_frame_create(int width, int height)
+{
+    uint16_t *frame = heap_caps_malloc((size_t)width * height * sizeof(uint16_t),
+                                       MALLOC_CAP_SPIRAM);
+    if (frame == NULL)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < width * height; i++)
+    {
+        frame[i] = BENCH_PIXEL_GRAY;
+    }
+
+    int square = width / 10;
+    int x0 = (width - square) / 2;
+    int y0 = (height - square) / 2;
+    for (int y = y0; y < y0 + square; y++)
+    {
+        for (int x = x0; x < x0 + square; x++)
+        {
+            frame[y * width + x] = BENCH_PIXEL_GREEN;
+        }
+    }
+
+    return frame;
+}
+
+static void bench_rgb565_to_hsv(const uint16_t *frame, int pixels, const char *resolution)
+{
+    // Acumular en volatile para que el compilador no elimine el kernel
+    volatile uint32_t sink = 0;
+    perf_probe_t probe;
+
+    perf_probe_begin(&probe);
+    for (int i = 0; i < pixels; i++)
+    {
+        uint8_t h, s, v;
+        rgb565_to_hsv_fast(frame[i], &h, &s, &v);
+        sink += h + s + v;
+    }
+    perf_probe_end(&probe);
+    (void)sink;
+
+    bench_report("rgb565_to_hsv_fast", resolution, 1, &probe, (uint32_t)pixels);
+}
+
+static void bench_detection(const uint16_t *frame, int width, int height,
+                            const char *resolution)
+{
+    detection_result_t result;
+
+    // Una corrida de calentamiento deja la LUT de clasificación lista:
+    // medimos el escaneo, no la reconstrucción de la tabla
+    detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &result);
+
+    perf_probe_t probe;
+    perf_probe_begin(&probe);
+    detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &result);
+    perf_probe_end(&probe);
+
+    bench_report("detect_object_by_color", resolution, 1, &probe,
+                 (uint32_t)(width * height));
+
+    if (!result.detected)
+    {
+        ESP_LOGW(TAG, "El frame sintético %s no produjo detección", resolution);
+    }
+}
+
+static void bench_homography(void)
+{
+    homography_matrix_t h_matrix;
+    homography_load_default(&h_matrix, 640, 480, 100.0f, 80.0f);
+
+    enum { POINTS = 1000 };
+    static pixel_point_t pixels[POINTS];
+    static world_point_t worlds[POINTS];
+
+    for (int i = 0; i < POINTS; i++)
+    {
+        pixels[i].u = (i * 37) % 640;
+        pixels[i].v = (i * 53) % 480;
+    }
+
+    perf_probe_t probe;
+
+    // Punto a punto
+    perf_probe_begin(&probe);
+    for (int i = 0; i < POINTS; i++)
+    {
+        homography_transform(&h_matrix, pixels[i], &worlds[i]);
+    }
+    perf_probe_end(&probe);
+    bench_report("homography_transform", "640x480", POINTS, &probe, POINTS);
+
+    // En lote
+    perf_probe_begin(&probe);
+    homography_transform_batch(&h_matrix, pixels, worlds, POINTS);
+    perf_probe_end(&probe);
+    bench_report("homography_transform_batch", "640x480", POINTS, &probe, POINTS);
+
+    // En lote con punto fijo
+    homography_set_fixed_point(true);
+    perf_probe_begin(&probe);
+    homography_transform_batch(&h_matrix, pixels, worlds, POINTS);
+    perf_probe_end(&probe);
+    homography_set_fixed_point(false);
+    bench_report("homography_transform_fixed", "640x480", POINTS, &probe, POINTS);
+}
+
+void run_vision_benchmarks(void)
+{
+    ESP_LOGI(TAG, "╔══════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║    Benchmarks de Kernels de Visión           ║");
+    ESP_LOGI(TAG, "╚══════════════════════════════════════════════╝");
+
+    static const struct
+    {
+        int width;
+        int height;
+        const char *name;
+    } resolutions[] = {
+        {160, 120, "160x120"},
+        {320, 240, "320x240"},
+        {640, 480, "640x480"},
+    };
+
+    for (size_t i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++)
+    {
+        uint16_t *frame = bench_frame_create(resolutions[i].width,
+                                             resolutions[i].height);
+        if (frame == NULL)
+        {
+            ESP_LOGE(TAG, "Sin memoria para frame sintético %s",
+                     resolutions[i].name);
+            continue;
+        }
+
+        bench_rgb565_to_hsv(frame,
+                            resolutions[i].width * resolutions[i].height,
+                            resolutions[i].name);
+        bench_detection(frame,
+                        resolutions[i].width, resolutions[i].height,
+                        resolutions[i].name);
+
+        heap_caps_free(frame);
+    }
+
+    bench_homography();
+
+    ESP_LOGI(TAG, "Benchmarks completados");
+}
@@ -0,0 +1,15 @@
+#ifndef TEST_BENCHMARK_H
+#define TEST_BENCHMARK_H
+
+/**
+ * @brief Suite de benchmarks de los kernels de visión
+ *
+ * Genera frames RGB565 sintéticos en varias resoluciones y mide con
+ * contador de ciclos (esp_cpu_get_cycle_count) los kernels calientes:
+ * rgb565_to_hsv_fast, detect_object_by_color y homography_transform.
+ * La salida es legible por máquina (líneas "BENCH,...") para comparar
+ * corridas antes y después de cada optimización.
+ */
+void run_vision_benchmarks(void);
+
+#endif // TEST_BENCHMARK_H
@@ -0,0 +1,38 @@
+/**
+ * @file trace_points.h
+ * @brief Marcadores de traza SystemView para los caminos calientes
+ *
+ * Medir con logs perturba los mismos lazos que se quieren medir; estos
+ * marcadores compilan a nada salvo que SystemView esté habilitado en
+ * menuconfig (Application Level Tracing -> SEGGER SystemView). Con él
+ * activo, cada región aparece como evento de usuario en una captura
+ * apptrace por JTAG, con línea de tiempo de tareas e ISRs en
+ * microsegundos.
+ *
+ * Uso: encerrar la región entre TRACE_REGION_ENTER/EXIT con uno de los
+ * IDs de abajo. Mantener las regiones gruesas (una por cuerpo de lazo,
+ * no por llamada) para no saturar el ancho de banda del JTAG.
+ */
+
+#ifndef TRACE_POINTS_H
+#define TRACE_POINTS_H
+
+#if CONFIG_APPTRACE_SV_ENABLE
+
+#include "SEGGER_SYSVIEW.h"
+
+#define TRACE_REGION_ENTER(id) SEGGER_SYSVIEW_OnUserStart(id)
+#define TRACE_REGION_EXIT(id) SEGGER_SYSVIEW_OnUserStop(id)
+
+#else
+
+#define TRACE_REGION_ENTER(id) ((void)0)
+#define TRACE_REGION_EXIT(id) ((void)0)
+
+#endif // CONFIG_APPTRACE_SV_ENABLE
+
+// IDs de región (números de evento de usuario en SystemView)
+#define TRACE_ID_DETECTION 1 // vision_task_function: detección sobre un frame
+#define TRACE_ID_WS_SEND 2   // ws_tx_send: envío asíncrono de un frame WS
+
+#endif // TRACE_POINTS_H
@@ -0,0 +1,202 @@
+/**
+ * Receptor UDP de video del vehículo
+ */
+
+#include "udp_video.h"
+#include "ws_server/ws_server.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "UDP_VIDEO";
+
+// Mismo techo que el reensamblado de frames WebSocket fragmentados
+#define UDP_VIDEO_MAX_FRAME 32768
+
+// Datagrama más grande esperable: cabecera + fragmento de 1400 bytes
+#define UDP_VIDEO_MAX_DGRAM 1536
+
+#define UDP_VIDEO_TASK_STACK_SIZE 4096
+#define UDP_VIDEO_TASK_PRIORITY 5
+#define UDP_VIDEO_TASK_CORE_ID 0
+
+#define UDP_VIDEO_FLAG_LAST 0x01
+
+// Cabecera de fragmento; debe coincidir con udp_stream.c del vehículo
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];    // 'U','V'
+    uint8_t source;      // frame_source_t
+    uint8_t flags;       // UDP_VIDEO_FLAG_LAST cierra el frame
+    uint16_t sequence;   // Por frame; un hueco = frame perdido
+    uint16_t frag_index; // 0..N dentro del frame
+} udp_frag_header_t;
+
+static int s_socket = -1;
+
+/**
+ * Estado del frame en reensamblado. Un solo vehículo emite por UDP,
+ * igual que en la ruta WebSocket fragmentada: un buffer alcanza. Si un
+ * fragmento llega fuera de orden o falta, el frame se marca inválido y
+ * se descarta al llegar el LAST; el próximo sequence arranca de cero.
+ */
+static uint8_t *s_frame_buf = NULL;
+static size_t s_frame_len = 0;
+static uint16_t s_frame_sequence = 0;
+static uint16_t s_next_frag = 0;
+static bool s_frame_valid = false;
+
+static void udp_video_handle_datagram(const uint8_t *data, size_t len)
+{
+    if (len < sizeof(udp_frag_header_t))
+    {
+        return;
+    }
+
+    const udp_frag_header_t *header = (const udp_frag_header_t *)data;
+    if (header->magic[0] != 'U' || header->magic[1] != 'V')
+    {
+        return;
+    }
+
+    const uint8_t *payload = data + sizeof(udp_frag_header_t);
+    size_t payload_len = len - sizeof(udp_frag_header_t);
+
+    // Secuencia nueva: descartar lo que hubiera y arrancar de cero
+    if (header->sequence != s_frame_sequence)
+    {
+        s_frame_sequence = header->sequence;
+        s_frame_len = 0;
+        s_next_frag = 0;
+        s_frame_valid = (header->frag_index == 0);
+    }
+
+    if (!s_frame_valid)
+    {
+        return;
+    }
+
+    // Fragmento fuera de orden o duplicado: el frame ya no sirve
+    if (header->frag_index != s_next_frag)
+    {
+        s_frame_valid = false;
+        return;
+    }
+    s_next_frag++;
+
+    if (payload_len > 0)
+    {
+        if (s_frame_len + payload_len > UDP_VIDEO_MAX_FRAME)
+        {
+            ESP_LOGW(TAG, "Frame UDP excede %d bytes - descartado",
+                     UDP_VIDEO_MAX_FRAME);
+            s_frame_valid = false;
+            return;
+        }
+        memcpy(s_frame_buf + s_frame_len, payload, payload_len);
+        s_frame_len += payload_len;
+    }
+
+    if (header->flags & UDP_VIDEO_FLAG_LAST)
+    {
+        if (s_frame_len > 0)
+        {
+            // Mismo destino que un frame llegado por WebSocket; el
+            // protocolo UDP no trae momento de captura
+            ws_server_send_video_frame((frame_source_t)header->source,
+                                       s_frame_buf, s_frame_len, 0);
+        }
+        s_frame_len = 0;
+        s_frame_valid = false; // Hasta el próximo frag_index 0
+    }
+}
+
+static void udp_video_task(void *pvParameters)
+{
+    uint8_t *datagram = malloc(UDP_VIDEO_MAX_DGRAM);
+    if (datagram == NULL)
+    {
+        ESP_LOGE(TAG, "Sin memoria para el buffer de datagramas");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Receptor de video UDP escuchando en puerto %d", UDP_VIDEO_PORT);
+
+    while (1)
+    {
+        int received = recvfrom(s_socket, datagram, UDP_VIDEO_MAX_DGRAM, 0,
+                                NULL, NULL);
+        if (received < 0)
+        {
+            ESP_LOGW(TAG, "recvfrom falló (errno=%d)", errno);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        udp_video_handle_datagram(datagram, (size_t)received);
+    }
+}
+
+esp_err_t udp_video_start(void)
+{
+    if (s_socket >= 0)
+    {
+        return ESP_OK;
+    }
+
+    s_frame_buf = malloc(UDP_VIDEO_MAX_FRAME);
+    if (s_frame_buf == NULL)
+    {
+        ESP_LOGE(TAG, "Sin memoria para el buffer de reensamblado");
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_socket < 0)
+    {
+        ESP_LOGE(TAG, "No se pudo crear el socket UDP (errno=%d)", errno);
+        free(s_frame_buf);
+        s_frame_buf = NULL;
+        return ESP_FAIL;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(UDP_VIDEO_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+
+    if (bind(s_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        ESP_LOGE(TAG, "No se pudo hacer bind al puerto %d (errno=%d)",
+                 UDP_VIDEO_PORT, errno);
+        close(s_socket);
+        s_socket = -1;
+        free(s_frame_buf);
+        s_frame_buf = NULL;
+        return ESP_FAIL;
+    }
+
+    BaseType_t result = xTaskCreatePinnedToCore(udp_video_task,
+                                                "udp_video",
+                                                UDP_VIDEO_TASK_STACK_SIZE,
+                                                NULL,
+                                                UDP_VIDEO_TASK_PRIORITY,
+                                                NULL,
+                                                UDP_VIDEO_TASK_CORE_ID);
+    if (result != pdPASS)
+    {
+        ESP_LOGE(TAG, "Error creando tarea receptora UDP");
+        close(s_socket);
+        s_socket = -1;
+        free(s_frame_buf);
+        s_frame_buf = NULL;
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,26 @@
+/**
+ * Receptor UDP de video del vehículo
+ *
+ * Contraparte del canal udp_stream del ESP32-CAM: recibe los frames
+ * JPEG como ráfagas de datagramas numerados, los reensambla y los
+ * entrega al mismo broadcast que usa la ruta WebSocket. El video por
+ * UDP no sufre head-of-line blocking: un datagrama perdido cuesta ese
+ * frame y nada más. Control y estado siguen por el WebSocket.
+ */
+
+#ifndef UDP_VIDEO_H
+#define UDP_VIDEO_H
+
+#include "esp_err.h"
+
+// Debe coincidir con UDP_STREAM_PORT del ESP32-CAM
+#define UDP_VIDEO_PORT 5005
+
+/**
+ * @brief Abre el socket y lanza la tarea receptora.
+ *
+ * @return ESP_OK si la tarea quedó corriendo
+ */
+esp_err_t udp_video_start(void);
+
+#endif // UDP_VIDEO_H
@@ -3,12 +3,19 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "esp_err.h"
 
 /**
  * @brief Estructura para almacenar la matriz de homografía 3x3
+ *
+ * homography_init() precalcula además los coeficientes en punto fijo
+ * para el camino Q16.16: filas x/y en Q16.16 y la fila de perspectiva
+ * en Q2.30 (sus coeficientes son ~1e-4 y necesitan la resolución
+ * extra para mantener el error por debajo del centímetro).
  */
 typedef struct {
-    float h[9];  // Matriz almacenada en orden row-major
+    float h[9];    // Matriz almacenada en orden row-major
+    int32_t hq[9]; // h[0..5] en Q16.16, h[6..8] en Q2.30
 } homography_matrix_t;
 
 /**
@@ -37,7 +44,11 @@ void homography_init(homography_matrix_t *H, const float h_coeffs[9]);
 
 /**
  * @brief Calcula la matriz de homografía a partir de 4 puntos de correspondencia
- * 
+ *
+ * Solve DLT completo en el chip: sistema 8x8 por eliminación gaussiana
+ * con pivoteo parcial (h22 = 1). Falla si los puntos son degenerados
+ * (tres colineales o repetidos).
+ *
  * @param H Puntero a la matriz de homografía a calcular
  * @param src_points Array de 4 puntos en la imagen (píxeles)
  * @param dst_points Array de 4 puntos en el mundo (cm)
@@ -58,6 +69,25 @@ void homography_transform(const homography_matrix_t *H,
                          pixel_point_t pixel,
                          world_point_t *world);
 
+/**
+ * @brief Transforma un lote de puntos de píxel a mundo
+ *
+ * Los coeficientes de H se cargan una sola vez por lote y la
+ * normalización homogénea usa un recíproco rápido (estimación +
+ * Newton) en lugar de la división por software del S3. Para los
+ * centroides y esquinas de caja de la detección multi-blob, el costo
+ * por punto baja a las multiplicaciones que realmente importan.
+ *
+ * @param H Matriz de homografía
+ * @param pixels Arreglo de puntos en píxeles
+ * @param worlds Arreglo de salida en coordenadas reales (cm)
+ * @param count Cantidad de puntos
+ */
+void homography_transform_batch(const homography_matrix_t *H,
+                                const pixel_point_t *pixels,
+                                world_point_t *worlds,
+                                int count);
+
 /**
  * @brief Carga una matriz de homografía por defecto para calibración rápida
  * 
@@ -71,4 +101,55 @@ void homography_load_default(homography_matrix_t *H,
                              int image_width, int image_height,
                              float real_width, float real_height);
 
+/**
+ * @brief Paso de la grilla precalculada píxel -> mundo
+ */
+#define HOMOGRAPHY_GRID_STEP 4
+
+/**
+ * @brief Genera la grilla precalculada píxel -> mundo en PSRAM
+ *
+ * Precalcula el transform exacto cada HOMOGRAPHY_GRID_STEP píxeles;
+ * las consultas posteriores por homography_transform_batch() para esa
+ * misma matriz se resuelven con dos cargas y una interpolación
+ * bilineal. Llamar una vez después de cada calibración.
+ *
+ * @param H Matriz de homografía a tabular
+ * @param image_width Ancho de imagen cubierto en píxeles
+ * @param image_height Alto de imagen cubierto en píxeles
+ * @return ESP_OK, o ESP_ERR_NO_MEM si no hay PSRAM (el transform
+ *         directo sigue funcionando)
+ */
+esp_err_t homography_grid_build(const homography_matrix_t *H,
+                                int image_width, int image_height);
+
+/**
+ * @brief Persiste la matriz de homografía en NVS
+ *
+ * @param H Matriz a guardar
+ * @return ESP_OK si se guardó y confirmó correctamente
+ */
+esp_err_t homography_save_nvs(const homography_matrix_t *H);
+
+/**
+ * @brief Carga la matriz de homografía calibrada desde NVS
+ *
+ * @param H Matriz de salida
+ * @return ESP_OK si había una calibración guardada válida
+ */
+esp_err_t homography_load_nvs(homography_matrix_t *H);
+
+/**
+ * @brief Selecciona el camino de transform en punto fijo Q16.16
+ *
+ * El S3 no tiene división de flotantes por hardware: x_h/w_h pasa por
+ * rutinas de software. Con el camino fijo la matriz-vector se hace con
+ * MACs enteros y la normalización con una división entera, usando los
+ * coeficientes precalculados por homography_init(). Error sub-
+ * centímetro sobre la arena de 100x80 cm.
+ *
+ * @param enable true para usar punto fijo en transform_batch
+ */
+void homography_set_fixed_point(bool enable);
+
 #endif // HOMOGRAPHY_H
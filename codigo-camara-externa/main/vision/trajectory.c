@@ -0,0 +1,183 @@
+#include "trajectory.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "Trajectory";
+
+typedef struct
+{
+    uint32_t timestamp_ms;
+    world_point_t position;
+} trajectory_sample_t;
+
+typedef struct
+{
+    trajectory_sample_t ring[TRAJECTORY_RING_SIZE];
+    int head;  // Próxima posición a escribir
+    int count; // Muestras válidas (satura en TRAJECTORY_RING_SIZE)
+} trajectory_track_t;
+
+static trajectory_track_t s_tracks[TRAJECTORY_MAX_TRACKS];
+
+void trajectory_reset(int track_id)
+{
+    if (track_id < 0)
+    {
+        memset(s_tracks, 0, sizeof(s_tracks));
+        return;
+    }
+
+    if (track_id < TRAJECTORY_MAX_TRACKS)
+    {
+        memset(&s_tracks[track_id], 0, sizeof(s_tracks[track_id]));
+    }
+}
+
+static const trajectory_sample_t *track_latest(const trajectory_track_t *track)
+{
+    int idx = (track->head + TRAJECTORY_RING_SIZE - 1) % TRAJECTORY_RING_SIZE;
+    return &track->ring[idx];
+}
+
+void trajectory_update(int track_id, world_point_t position, uint32_t timestamp_ms)
+{
+    if (track_id < 0 || track_id >= TRAJECTORY_MAX_TRACKS)
+    {
+        return;
+    }
+
+    trajectory_track_t *track = &s_tracks[track_id];
+
+    // No ajustar a través de un hueco: tras una oclusión larga la
+    // historia vieja miente sobre la velocidad actual
+    if (track->count > 0 &&
+        timestamp_ms - track_latest(track)->timestamp_ms > TRAJECTORY_STALE_MS)
+    {
+        ESP_LOGD(TAG, "Pista %d reiniciada por muestra vieja", track_id);
+        track->head = 0;
+        track->count = 0;
+    }
+
+    track->ring[track->head].timestamp_ms = timestamp_ms;
+    track->ring[track->head].position = position;
+    track->head = (track->head + 1) % TRAJECTORY_RING_SIZE;
+    if (track->count < TRAJECTORY_RING_SIZE)
+    {
+        track->count++;
+    }
+}
+
+/**
+ * Ajuste lineal por cuadrados mínimos de x(t) e y(t)
+ *
+ * El tiempo se referencia a la muestra más vieja de la ventana para
+ * mantener chicos los productos (la ventana dura cientos de ms).
+ */
+static bool track_fit(const trajectory_track_t *track,
+                      uint32_t now_ms,
+                      float *vx, float *vy,
+                      float *x0, float *y0,
+                      uint32_t *t_latest_ms)
+{
+    if (track->count < 3)
+    {
+        return false;
+    }
+
+    const trajectory_sample_t *latest = track_latest(track);
+    if (now_ms - latest->timestamp_ms > TRAJECTORY_STALE_MS)
+    {
+        return false; // La pista entera quedó vieja
+    }
+
+    int oldest = (track->head + TRAJECTORY_RING_SIZE - track->count) % TRAJECTORY_RING_SIZE;
+    uint32_t t_base = track->ring[oldest].timestamp_ms;
+
+    float sum_t = 0.0f, sum_tt = 0.0f;
+    float sum_x = 0.0f, sum_tx = 0.0f;
+    float sum_y = 0.0f, sum_ty = 0.0f;
+
+    for (int i = 0; i < track->count; i++)
+    {
+        const trajectory_sample_t *sample =
+            &track->ring[(oldest + i) % TRAJECTORY_RING_SIZE];
+
+        float t = (float)(sample->timestamp_ms - t_base) / 1000.0f;
+        sum_t += t;
+        sum_tt += t * t;
+        sum_x += sample->position.x;
+        sum_tx += t * sample->position.x;
+        sum_y += sample->position.y;
+        sum_ty += t * sample->position.y;
+    }
+
+    float n = (float)track->count;
+    float denom = n * sum_tt - sum_t * sum_t;
+    if (fabsf(denom) < 1e-6f)
+    {
+        return false; // Todas las muestras en el mismo instante
+    }
+
+    float slope_x = (n * sum_tx - sum_t * sum_x) / denom;
+    float slope_y = (n * sum_ty - sum_t * sum_y) / denom;
+
+    if (vx) *vx = slope_x;
+    if (vy) *vy = slope_y;
+    if (x0) *x0 = (sum_x - slope_x * sum_t) / n; // Intercepto en t_base
+    if (y0) *y0 = (sum_y - slope_y * sum_t) / n;
+    if (t_latest_ms) *t_latest_ms = t_base;
+
+    return true;
+}
+
+bool trajectory_get_velocity(int track_id,
+                             float *vx,
+                             float *vy,
+                             float *speed,
+                             float *heading_rad)
+{
+    if (track_id < 0 || track_id >= TRAJECTORY_MAX_TRACKS)
+    {
+        return false;
+    }
+
+    const trajectory_track_t *track = &s_tracks[track_id];
+    uint32_t now_ms = track->count > 0 ? track_latest(track)->timestamp_ms : 0;
+
+    float fit_vx, fit_vy;
+    if (!track_fit(track, now_ms, &fit_vx, &fit_vy, NULL, NULL, NULL))
+    {
+        return false;
+    }
+
+    if (vx) *vx = fit_vx;
+    if (vy) *vy = fit_vy;
+    if (speed) *speed = sqrtf(fit_vx * fit_vx + fit_vy * fit_vy);
+    if (heading_rad) *heading_rad = atan2f(fit_vy, fit_vx);
+
+    return true;
+}
+
+bool trajectory_predict(int track_id, uint32_t timestamp_ms, world_point_t *predicted)
+{
+    if (track_id < 0 || track_id >= TRAJECTORY_MAX_TRACKS || predicted == NULL)
+    {
+        return false;
+    }
+
+    const trajectory_track_t *track = &s_tracks[track_id];
+
+    float vx, vy, x0, y0;
+    uint32_t t_base;
+    if (!track_fit(track, timestamp_ms, &vx, &vy, &x0, &y0, &t_base))
+    {
+        return false;
+    }
+
+    float t = (float)(int32_t)(timestamp_ms - t_base) / 1000.0f;
+    predicted->x = x0 + vx * t;
+    predicted->y = y0 + vy * t;
+
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "homography.h"
+
+/**
+ * @brief Estimador de trayectoria en coordenadas de mundo
+ *
+ * La detección calcula coordenadas de mundo por frame y las descarta.
+ * Este módulo guarda un anillo corto de muestras (t, posición) por
+ * blob seguido, ajusta velocidad y rumbo por cuadrados mínimos y
+ * expone posición predicha. Con predicción, la cámara puede bajar el
+ * frame rate a la mitad manteniendo la misma calidad efectiva de
+ * control sobre los vehículos seguidos.
+ */
+
+/**
+ * @brief Cantidad de pistas simultáneas (una por color de marcador)
+ */
+#define TRAJECTORY_MAX_TRACKS 4
+
+/**
+ * @brief Muestras retenidas por pista
+ */
+#define TRAJECTORY_RING_SIZE 8
+
+/**
+ * @brief Una pista se descarta si su última muestra supera esta edad
+ */
+#define TRAJECTORY_STALE_MS 1000
+
+/**
+ * @brief Agrega una muestra de posición a una pista
+ *
+ * Si la muestra anterior es demasiado vieja la pista se reinicia en
+ * lugar de ajustar a través del hueco.
+ *
+ * @param track_id Pista (0 a TRAJECTORY_MAX_TRACKS-1)
+ * @param position Posición en coordenadas de mundo (cm)
+ * @param timestamp_ms Marca de tiempo de la muestra
+ */
+void trajectory_update(int track_id, world_point_t position, uint32_t timestamp_ms);
+
+/**
+ * @brief Ajusta velocidad y rumbo sobre las muestras de una pista
+ *
+ * Ajuste lineal por cuadrados mínimos de x(t) e y(t); necesita al
+ * menos 3 muestras vigentes.
+ *
+ * @param track_id Pista
+ * @param vx Velocidad X en cm/s (puede ser NULL)
+ * @param vy Velocidad Y en cm/s (puede ser NULL)
+ * @param speed Módulo de la velocidad en cm/s (puede ser NULL)
+ * @param heading_rad Rumbo en radianes, atan2(vy, vx) (puede ser NULL)
+ * @return true si la pista tiene muestras suficientes y vigentes
+ */
+bool trajectory_get_velocity(int track_id,
+                             float *vx,
+                             float *vy,
+                             float *speed,
+                             float *heading_rad);
+
+/**
+ * @brief Predice la posición de una pista en un instante futuro
+ *
+ * Extrapola el ajuste lineal desde la última muestra.
+ *
+ * @param track_id Pista
+ * @param timestamp_ms Instante a predecir
+ * @param predicted Posición de salida en coordenadas de mundo (cm)
+ * @return true si hay ajuste vigente para predecir
+ */
+bool trajectory_predict(int track_id, uint32_t timestamp_ms, world_point_t *predicted);
+
+/**
+ * @brief Reinicia una pista (o todas con track_id < 0)
+ *
+ * @param track_id Pista a reiniciar, -1 para todas
+ */
+void trajectory_reset(int track_id);
+
+#endif // TRAJECTORY_H
@@ -1,6 +1,15 @@
 #include "vision.h"
+#include "event_log/event_log.h"
+#include "mem_arena/mem_arena.h"
+#include "vision_kernels.h"
+#include "vk_scan_geometry.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
 
 static const char *TAG = "Vision";
 
@@ -23,139 +32,1320 @@ const color_range_t COLOR_YELLOW = {
 
 /**
  * Conversión RGB565 a HSV optimizada con aritmética de enteros
- * Basada en la investigación de optimización para ESP32
+ * La implementación vive en el componente compartido vision_kernels;
+ * este envoltorio conserva la API pública que usan los tests y el
+ * simulador de host.
  */
 void rgb565_to_hsv_fast(uint16_t pixel, uint8_t *h, uint8_t *s, uint8_t *v)
 {
-    // Extracción eficiente de componentes usando máscaras de bits
-    // RGB565: RRRRR GGGGGG BBBBB
-    uint8_t r = (pixel & 0xF800) >> 8; // 5 bits expandidos a 8 bits
-    uint8_t g = (pixel & 0x07E0) >> 3; // 6 bits expandidos a 8 bits
-    uint8_t b = (pixel & 0x001F) << 3; // 5 bits expandidos a 8 bits
+    vk_rgb565_to_hsv(pixel, h, s, v);
+}
+
+/**
+ * Variante solo-matiz: omite por completo la división de saturación,
+ * la operación más cara de la conversión. En arenas bien iluminadas
+ * los límites S casi nunca rechazan un píxel que el matiz acepta, así
+ * que el modo solo-matiz del clasificador usa esta versión.
+ */
+static inline void rgb565_to_hue_value(uint16_t pixel, uint8_t *h, uint8_t *v)
+{
+    vk_rgb565_to_hue_value(pixel, h, v);
+}
+
+/**
+ * Verifica si un píxel HSV está dentro del rango de color especificado
+ */
+static inline bool pixel_in_range(uint8_t h, uint8_t s, uint8_t v, const color_range_t *range)
+{
+    return vk_hsv_in_range(h, s, v,
+                           range->h_min, range->h_max,
+                           range->s_min, range->s_max,
+                           range->v_min, range->v_max);
+}
 
-    // Encontrar mín y máx usando comparaciones en cascada
-    uint8_t min_val = (r < g) ? (r < b ? r : b) : (g < b ? g : b);
-    uint8_t max_val = (r > g) ? (r > b ? r : b) : (g > b ? g : b);
-    uint8_t delta = max_val - min_val;
+// ============================================================================
+// LUT DE CLASIFICACIÓN RGB565
+// ============================================================================
 
-    *v = max_val; // Valor es el máximo
+/**
+ * RGB565 tiene solo 65536 valores posibles, así que la clasificación
+ * completa (conversión HSV + comparación contra cada rango) se puede
+ * precalcular en una tabla: una carga de L1 por píxel en lugar de la
+ * conversión con divisiones que ninguna unidad vectorial puede hacer
+ * por-lane. Cada entrada es una máscara de bits, un bit por color del
+ * conjunto activo (hasta VISION_MAX_COLORS), de modo que el escaneo
+ * multi-color cuesta lo mismo que el de un color. La tabla se
+ * reconstruye solo cuando cambia el conjunto de rangos (~65K
+ * conversiones, unos pocos ms, una única vez por cambio de color).
+ */
+static uint8_t s_classify_lut[1 << 16];
+static color_range_t s_lut_ranges[VISION_MAX_COLORS];
+static int s_lut_num_colors = 0;
+
+// Cada reconstrucción cambia el significado de las máscaras; los
+// parciales cacheados por la detección incremental se invalidan
+// comparando contra esta generación
+static uint32_t s_classify_lut_generation = 0;
+
+// Modo solo-matiz: la LUT ya eliminó la división del camino por-píxel,
+// pero la reconstrucción (65K conversiones) y los barridos de
+// calibración siguen pagándola. Seleccionable en runtime; además se
+// activa solo cuando ningún rango del conjunto tiene límites S
+// vinculantes, así los resultados son bit-idénticos al modo completo.
+static bool s_hue_only_mode = false;
+static bool s_lut_hue_only = false; // Modo con el que se construyó la LUT
 
-    if (delta == 0)
+// ----------------------------------------------------------------------------
+// Compensación de deriva de matiz
+//
+// La iluminación de la arena deriva a lo largo de la sesión y la calidad
+// de detección decae en silencio hasta que alguien recalibra. El
+// refinado de blobs ya recorre las corridas de píxeles clasificados
+// (una fracción mínima del frame); esas corridas anotan además su matiz
+// en un histograma por color, sin pasada extra ni costo en los bucles
+// calientes. Un lazo lento compara cada tanto el modo del histograma con el
+// centro del rango activo y, si el modo se corrió, desplaza el rango un
+// paso hacia él vía un offset por color que se aplica al reconstruir la
+// LUT. Mantener el rango centrado permite mantenerlo angosto, y un rango
+// angosto achica todos los pases de refinado que vienen después. El
+// offset queda acotado para que un objeto espurio no pueda arrastrar el
+// rango lejos de su calibración; un cambio de rangos del operador
+// resetea offsets e histogramas.
+// ----------------------------------------------------------------------------
+#define DRIFT_MIN_SAMPLES 64     // Muestras por color antes de opinar
+#define DRIFT_DEADBAND 2         // Corrimientos menores no tocan nada
+#define DRIFT_MAX_OFFSET 12      // Tope de arrastre desde la calibración
+#define DRIFT_ADJUST_PERIOD_MS 2000
+
+static uint32_t s_drift_hist[VISION_MAX_COLORS][256];
+static int8_t s_drift_offset[VISION_MAX_COLORS];
+static int8_t s_lut_drift[VISION_MAX_COLORS]; // Offsets con los que se armó la LUT
+static uint32_t s_drift_last_adjust_ms = 0;
+static bool s_drift_enabled = false;
+
+void vision_set_hue_drift_compensation(bool enable)
+{
+    s_drift_enabled = enable;
+}
+
+/**
+ * Anota el matiz de un píxel que clasificó en al menos un color
+ *
+ * Los dos cores del escaneo partido incrementan el histograma sin lock:
+ * una suma perdida cada tanto no mueve el modo de una estadística de
+ * miles de muestras.
+ */
+static inline void drift_hist_note(uint16_t px, uint8_t mask)
+{
+    uint8_t h, v;
+    rgb565_to_hue_value(px, &h, &v);
+    while (mask)
     {
-        *h = 0;
-        *s = 0;
-        return;
+        int i = __builtin_ctz(mask);
+        mask &= (uint8_t)(mask - 1);
+        s_drift_hist[i][h]++;
+    }
+}
+
+void vision_set_hue_only_classifier(bool enable)
+{
+    s_hue_only_mode = enable;
+}
+
+/**
+ * Límites S que no rechazan nada: omitir su división es bit-idéntico
+ */
+static inline bool range_s_nonbinding(const color_range_t *range)
+{
+    return range->s_min == 0 && range->s_max == 255;
+}
+
+static void classify_lut_build(const color_range_t *const color_ranges[], int num_colors)
+{
+    int64_t start = esp_timer_get_time();
+
+    // Un conjunto de rangos nuevo (recalibración del operador) arranca
+    // sin deriva acumulada ni historia del conjunto anterior
+    bool base_changed = (num_colors != s_lut_num_colors);
+    for (int i = 0; !base_changed && i < num_colors; i++)
+    {
+        base_changed = memcmp(&s_lut_ranges[i], color_ranges[i],
+                              sizeof(color_range_t)) != 0;
+    }
+    if (base_changed)
+    {
+        memset(s_drift_hist, 0, sizeof(s_drift_hist));
+        memset(s_drift_offset, 0, sizeof(s_drift_offset));
     }
 
-    // Cálculo de Saturación sin flotantes: (delta * 255) / max_val
-    // Optimización: desplazamiento izquierdo en lugar de multiplicación
-    *s = (uint16_t)(delta << 8) / max_val;
+    // Rangos efectivos: los del llamador corridos por el offset de
+    // deriva (el matiz es circular, el wrap de uint8 hace lo correcto)
+    color_range_t eff_ranges[VISION_MAX_COLORS];
+    for (int i = 0; i < num_colors; i++)
+    {
+        eff_ranges[i] = *color_ranges[i];
+        eff_ranges[i].h_min = (uint8_t)(eff_ranges[i].h_min + s_drift_offset[i]);
+        eff_ranges[i].h_max = (uint8_t)(eff_ranges[i].h_max + s_drift_offset[i]);
+    }
 
-    // Cálculo de Matiz (Hue) usando aritmética entera
-    // El factor 43 aproxima (255 / 6) para escalar los sectores de 60 grados
-    if (r == max_val)
+    // La división de saturación se omite solo si nadie la necesita:
+    // forzado por modo, o todos los límites S abiertos de par en par
+    bool need_s = !s_hue_only_mode;
+    if (need_s)
     {
-        // Sector rojo-amarillo
-        if (g >= b)
-            *h = (43 * (g - b)) / delta;
+        need_s = false;
+        for (int i = 0; i < num_colors; i++)
+        {
+            if (!range_s_nonbinding(color_ranges[i]))
+            {
+                need_s = true;
+                break;
+            }
+        }
+    }
+
+    for (uint32_t value = 0; value < (1u << 16); value++)
+    {
+        // sat arranca en 0: el camino solo-matiz no la escribe y el
+        // inliner de -Wall la marcaría como posiblemente sin inicializar
+        uint8_t h, sat = 0, v;
+        if (need_s)
+        {
+            rgb565_to_hsv_fast((uint16_t)value, &h, &sat, &v);
+        }
         else
-            *h = 255 + (43 * (g - b)) / delta; // Wraparound
+        {
+            rgb565_to_hue_value((uint16_t)value, &h, &v);
+        }
+
+        uint8_t mask = 0;
+        for (int i = 0; i < num_colors; i++)
+        {
+            const color_range_t *range = &eff_ranges[i];
+            bool in;
+            if (need_s)
+            {
+                in = pixel_in_range(h, sat, v, range);
+            }
+            else
+            {
+                // Solo matiz y valor; S se da por aceptada
+                in = (v >= range->v_min && v <= range->v_max) &&
+                     ((range->h_min <= range->h_max)
+                          ? (h >= range->h_min && h <= range->h_max)
+                          : (h >= range->h_min || h <= range->h_max));
+            }
+            if (in)
+            {
+                mask |= (uint8_t)(1u << i);
+            }
+        }
+        s_classify_lut[value] = mask;
+    }
+
+    for (int i = 0; i < num_colors; i++)
+    {
+        s_lut_ranges[i] = *color_ranges[i];
+        s_lut_drift[i] = s_drift_offset[i];
     }
-    else if (g == max_val)
+    s_lut_num_colors = num_colors;
+    s_lut_hue_only = !need_s;
+    s_classify_lut_generation++;
+
+    ESP_LOGI(TAG, "LUT de clasificación reconstruida (%d colores, %s, %" PRId64 " ms)",
+             num_colors, need_s ? "HSV completo" : "solo matiz",
+             (esp_timer_get_time() - start) / 1000);
+}
+
+static bool classify_lut_matches(const color_range_t *const color_ranges[], int num_colors)
+{
+    if (num_colors != s_lut_num_colors)
     {
-        // Sector verde-cian
-        *h = 85 + (43 * (b - r)) / delta;
+        return false;
     }
-    else
+
+    // Un cambio del modo efectivo amerita reconstrucción aunque los
+    // rangos no hayan cambiado
+    bool all_nonbinding = true;
+    for (int i = 0; i < num_colors; i++)
+    {
+        if (!range_s_nonbinding(color_ranges[i]))
+        {
+            all_nonbinding = false;
+            break;
+        }
+    }
+    if ((s_hue_only_mode || all_nonbinding) != s_lut_hue_only)
     {
-        // Sector azul-magenta
-        *h = 171 + (43 * (r - g)) / delta;
+        return false;
     }
+
+    for (int i = 0; i < num_colors; i++)
+    {
+        if (memcmp(&s_lut_ranges[i], color_ranges[i], sizeof(color_range_t)) != 0)
+        {
+            return false;
+        }
+        if (s_lut_drift[i] != s_drift_offset[i])
+        {
+            return false; // La deriva corrió el rango desde la última LUT
+        }
+    }
+    return true;
 }
 
 /**
- * Verifica si un píxel HSV está dentro del rango de color especificado
+ * Lazo lento de deriva: compara el modo del histograma de cada color
+ * con el centro de su rango efectivo y corre el offset un paso hacia
+ * él. El cambio de offset invalida la LUT; la reconstrucción (unos ms)
+ * la paga la próxima detección, como cualquier cambio de rangos.
  */
-static inline bool pixel_in_range(uint8_t h, uint8_t s, uint8_t v, const color_range_t *range)
+static void drift_feedback(const color_range_t *const color_ranges[], int num_colors)
 {
-    // Verificar saturación y valor primero (más rápido)
-    if (s < range->s_min || s > range->s_max)
-        return false;
-    if (v < range->v_min || v > range->v_max)
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (now_ms - s_drift_last_adjust_ms < DRIFT_ADJUST_PERIOD_MS)
+    {
+        return;
+    }
+    s_drift_last_adjust_ms = now_ms;
+
+    for (int i = 0; i < num_colors; i++)
+    {
+        uint32_t total = 0;
+        uint32_t mode_count = 0;
+        uint8_t mode = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            total += s_drift_hist[i][b];
+            if (s_drift_hist[i][b] > mode_count)
+            {
+                mode_count = s_drift_hist[i][b];
+                mode = (uint8_t)b;
+            }
+        }
+
+        if (total >= DRIFT_MIN_SAMPLES)
+        {
+            // Centro del rango efectivo; la resta circular de uint8
+            // da el error con signo sin caso especial para el rojo
+            uint8_t h_min = (uint8_t)(color_ranges[i]->h_min + s_drift_offset[i]);
+            uint8_t span = (uint8_t)(color_ranges[i]->h_max - color_ranges[i]->h_min);
+            uint8_t center = (uint8_t)(h_min + span / 2);
+            int8_t err = (int8_t)(uint8_t)(mode - center);
+
+            if (err > DRIFT_DEADBAND && s_drift_offset[i] < DRIFT_MAX_OFFSET)
+            {
+                s_drift_offset[i]++;
+                ESP_LOGI(TAG, "Deriva de matiz color %d: modo %u, offset %d",
+                         i, mode, s_drift_offset[i]);
+            }
+            else if (err < -DRIFT_DEADBAND && s_drift_offset[i] > -DRIFT_MAX_OFFSET)
+            {
+                s_drift_offset[i]--;
+                ESP_LOGI(TAG, "Deriva de matiz color %d: modo %u, offset %d",
+                         i, mode, s_drift_offset[i]);
+            }
+        }
+
+        // Ventana móvil: decaer a la mitad mantiene el peso en lo reciente
+        for (int b = 0; b < 256; b++)
+        {
+            s_drift_hist[i][b] >>= 1;
+        }
+    }
+}
+
+// ============================================================================
+// ESCANEO EN FRANJAS SOBRE AMBOS CORES
+// ============================================================================
+
+/**
+ * Los acumuladores del detector (sum_x/sum_y/count) son asociativos,
+ * así que el frame se puede partir en dos franjas de filas y sumar los
+ * parciales al final. La tarea de visión escanea la franja inferior en
+ * Core 1 mientras un worker fijado a Core 0 (que entre frames está
+ * ocioso esperando al servidor WebSocket) escanea la superior. El
+ * handoff usa notificaciones de tarea: ningún lock, un despertar por
+ * franja.
+ */
+#define SCAN_WORKER_STACK_SIZE (4096)
+#define SCAN_WORKER_PRIORITY (5)
+#define SCAN_WORKER_CORE_ID (0)
+#define SCAN_SPLIT_MIN_ROWS (32) // Franjas más chicas no ameritan el despertar
+
+typedef struct
+{
+    const uint16_t *frame_buffer;
+    int width;
+    int x0, x1;
+    int y0, y1;
+    int num_colors;
+    bool incremental; // Franja alineada a tiles: usar la caché de parciales
+    uint32_t sum_x[VISION_MAX_COLORS];
+    uint32_t sum_y[VISION_MAX_COLORS];
+    uint32_t count[VISION_MAX_COLORS];
+    int bb_x_min[VISION_MAX_COLORS];
+    int bb_y_min[VISION_MAX_COLORS];
+    int bb_x_max[VISION_MAX_COLORS];
+    int bb_y_max[VISION_MAX_COLORS];
+} scan_stripe_job_t;
+
+/**
+ * Deja los acumuladores de una franja listos para sumar
+ */
+static void scan_job_reset(scan_stripe_job_t *job)
+{
+    memset(job, 0, sizeof(*job));
+    for (int i = 0; i < VISION_MAX_COLORS; i++)
+    {
+        job->bb_x_min[i] = INT32_MAX;
+        job->bb_y_min[i] = INT32_MAX;
+        job->bb_x_max[i] = -1;
+        job->bb_y_max[i] = -1;
+    }
+}
+
+static TaskHandle_t s_scan_worker_handle = NULL;
+static TaskHandle_t s_scan_caller_handle = NULL;
+static scan_stripe_job_t s_worker_job;
+
+// ============================================================================
+// PUNTOS DE CESIÓN COOPERATIVA
+// ============================================================================
+// Con frames QVGA el escaneo termina en pocos milisegundos, pero en los
+// experimentos VGA la ráfaga ininterrumpida llega a disparar el watchdog
+// de tareas y a matar de hambre a las tareas de igual prioridad del
+// core. En vez de bajar la prioridad de la tarea de visión (y perder su
+// latencia en todo lo demás), el bucle de filas revisa el reloj cada
+// bloque y cede el procesador cuando agota su rodaja de tiempo. Una
+// ráfaga realmente larga intercala además un tick de sueño para que la
+// tarea idle alcance a alimentar el watchdog.
+
+#define SCAN_SLICE_CHECK_ROWS 8              // Filas entre lecturas del reloj
+#define SCAN_SLICE_BUDGET_US_DEFAULT 3000    // Rodaja antes de ceder
+#define SCAN_WDT_RELIEF_US 50000             // Ráfaga total antes de dormir un tick
+
+static uint32_t s_scan_slice_budget_us = SCAN_SLICE_BUDGET_US_DEFAULT;
+
+void vision_set_scan_slice_budget(uint32_t budget_us)
+{
+    s_scan_slice_budget_us = budget_us;
+}
+
+/**
+ * Escanea una franja de filas acumulando por color vía la LUT
+ *
+ * El ancho llega como parámetro propio para que las variantes
+ * especializadas de abajo lo pasen como constante de compilación: con
+ * la cuenta de iteraciones fija el compilador desenrolla el bucle
+ * interior y convierte el paso de fila en una suma constante.
+ */
+static inline __attribute__((always_inline)) void scan_stripe_rows(scan_stripe_job_t *job, int width)
+{
+    int64_t scan_start = esp_timer_get_time();
+    int64_t slice_start = scan_start;
+    int rows_until_check = SCAN_SLICE_CHECK_ROWS;
+
+    for (int y = job->y0; y < job->y1; y++)
+    {
+        if (s_scan_slice_budget_us != 0 && --rows_until_check == 0)
+        {
+            rows_until_check = SCAN_SLICE_CHECK_ROWS;
+            int64_t now = esp_timer_get_time();
+            if (now - slice_start >= (int64_t)s_scan_slice_budget_us)
+            {
+                if (now - scan_start >= SCAN_WDT_RELIEF_US)
+                {
+                    vTaskDelay(1); // Que el idle alimente el watchdog
+                    scan_start = esp_timer_get_time();
+                }
+                else
+                {
+                    taskYIELD(); // Turno para las tareas de igual prioridad
+                }
+                slice_start = esp_timer_get_time();
+            }
+        }
+
+        const uint16_t *row = &job->frame_buffer[y * width];
+        for (int x = job->x0; x < job->x1; x++)
+        {
+            uint8_t mask = s_classify_lut[row[x]];
+
+            while (mask)
+            {
+                int i = __builtin_ctz(mask);
+                mask &= (uint8_t)(mask - 1);
+
+                job->sum_x[i] += x;
+                job->sum_y[i] += y;
+                job->count[i]++;
+
+                if (x < job->bb_x_min[i]) job->bb_x_min[i] = x;
+                if (x > job->bb_x_max[i]) job->bb_x_max[i] = x;
+                if (y < job->bb_y_min[i]) job->bb_y_min[i] = y;
+                if (y > job->bb_y_max[i]) job->bb_y_max[i] = y;
+            }
+        }
+    }
+}
+
+// Variantes estampadas por geometría (vk_scan_geometry.h): una copia
+// del bucle por cada ancho fijo del proyecto, más la genérica para
+// cualquier otro tamaño
+#define DEFINE_SCAN_STRIPE_VARIANT(W, H)                    \
+    static void scan_stripe_rows_##W(scan_stripe_job_t *job) \
+    {                                                        \
+        scan_stripe_rows(job, W);                            \
+    }
+VK_SCAN_GEOMETRIES(DEFINE_SCAN_STRIPE_VARIANT)
+#undef DEFINE_SCAN_STRIPE_VARIANT
+
+typedef void (*scan_stripe_fn_t)(scan_stripe_job_t *job);
+
+typedef struct
+{
+    int16_t width;
+    scan_stripe_fn_t fn;
+} scan_stripe_variant_t;
+
+#define SCAN_STRIPE_TABLE_ENTRY(W, H) {W, scan_stripe_rows_##W},
+static const scan_stripe_variant_t s_scan_stripe_variants[] = {
+    VK_SCAN_GEOMETRIES(SCAN_STRIPE_TABLE_ENTRY)
+};
+#undef SCAN_STRIPE_TABLE_ENTRY
+
+// ============================================================================
+// CACHÉ INCREMENTAL DE ACUMULADORES POR TILE
+// ============================================================================
+
+/**
+ * En una arena casi estática la mayoría de los tiles del frame no
+ * cambia entre muestras, y un tile cuyo contenido no cambió no puede
+ * cambiar sus cuentas de clasificación. El escaneo de frame completo
+ * mantiene por tile de 16x16 un checksum FNV-1a (la misma familia que
+ * usa el streaming delta del vehículo) y los acumuladores parciales de cada
+ * color: si el checksum coincide con el de la muestra anterior se suman
+ * los parciales cacheados sin clasificar un solo píxel; solo los tiles
+ * sucios pagan la pasada por la LUT. El hash cuesta una carga y una
+ * multiplicación por píxel, bastante menos que la clasificación con sus
+ * acumuladores y ramas, así que el costo por frame baja de O(píxeles) a
+ * O(checksum) + O(píxeles cambiados). Una colisión del hash dejaría
+ * pasar un tile cambiado: el mismo riesgo remoto que el streaming delta
+ * ya acepta.
+ *
+ * Aplica solo al escaneo de frame completo con geometría divisible en
+ * tiles; las ventanas de seguimiento ya tocan una fracción del frame y
+ * no se alinean a tiles. Los parciales se guardan en coordenadas
+ * locales del tile (caben en uint16) y se trasladan al fusionarlos.
+ */
+#define DETECT_TILE_SIZE 16
+
+typedef struct
+{
+    uint16_t count;
+    uint16_t sum_x; // Sumas en coordenadas locales del tile
+    uint16_t sum_y;
+    uint8_t x_min, y_min, x_max, y_max; // Caja local (válida si count > 0)
+} tile_accum_t;
+
+static uint32_t *s_tile_cache_hash = NULL;      // [tiles_y * tiles_x]
+static tile_accum_t *s_tile_cache_accum = NULL; // [tile][VISION_MAX_COLORS]
+static uint8_t *s_tile_cache_fresh = NULL;      // Tile con parciales vigentes
+static int s_tile_cache_tiles_x = 0;
+static int s_tile_cache_tiles_y = 0;
+static uint32_t s_tile_cache_lut_gen = 0; // Generación de LUT cacheada
+static bool s_incremental_enabled = false;
+
+void vision_set_incremental_detection(bool enable)
+{
+    s_incremental_enabled = enable;
+}
+
+/**
+ * Modelo de fondo por píxel para la cámara fija
+ *
+ * El checksum exacto de arriba hace gratis los tiles idénticos, pero el
+ * ruido del sensor y la deriva de iluminación lo invalidan aunque la
+ * escena no haya cambiado. Para esos tiles sucios se guarda un frame de
+ * referencia (copia RGB565, vive en PSRAM vía malloc grande): un píxel
+ * dentro de la tolerancia por canal de su referencia es fondo y se
+ * salta la clasificación; solo los píxeles que se apartan - el primer
+ * plano - pasan por la LUT.
+ *
+ * La referencia de un tile se regraba únicamente cuando su escaneo no
+ * clasificó ningún píxel en ningún color activo, así el modelo absorbe
+ * la deriva lenta del fondo pero nunca puede tragarse un marcador: un
+ * tile con marcador detectado jamás refresca su referencia, y mientras
+ * la referencia de un tile no exista se clasifica completo.
+ */
+#define FONDO_TOL_R 2 // Tolerancias por canal en unidades RGB565
+#define FONDO_TOL_G 4
+#define FONDO_TOL_B 2
+
+static uint16_t *s_fondo_ref = NULL;     // Frame de referencia [height][width]
+static uint8_t *s_fondo_ref_valid = NULL; // Por tile
+static bool s_fondo_enabled = true;
+
+void vision_set_background_model(bool enable)
+{
+    s_fondo_enabled = enable;
+}
+
+/**
+ * ¿El píxel está dentro de la tolerancia de su referencia?
+ */
+static inline bool fondo_pixel_es_fondo(uint16_t px, uint16_t ref)
+{
+    int dr = (int)((px >> 11) & 0x1F) - (int)((ref >> 11) & 0x1F);
+    int dg = (int)((px >> 5) & 0x3F) - (int)((ref >> 5) & 0x3F);
+    int db = (int)(px & 0x1F) - (int)(ref & 0x1F);
+    if (dr < 0) dr = -dr;
+    if (dg < 0) dg = -dg;
+    if (db < 0) db = -db;
+    return dr <= FONDO_TOL_R && dg <= FONDO_TOL_G && db <= FONDO_TOL_B;
+}
+
+/**
+ * FNV-1a por tile sobre palabras de 32 bits (pares de píxeles)
+ *
+ * La multiplicación del FNV encadena cada paso con el anterior; a
+ * palabra por paso la cadena queda a la mitad que el byte a byte del
+ * streaming delta y el checksum sigue decidiendo lo único que importa:
+ * si el contenido del tile cambió. El inicio de cada fila de tile queda
+ * alineado a 4 bytes (frame alineado, ancho múltiplo del tile).
+ */
+static uint32_t detect_tile_hash(const uint16_t *pixels, int frame_width, int tx, int ty)
+{
+    uint32_t h = 2166136261u;
+    const uint16_t *p = pixels + (ty * DETECT_TILE_SIZE * frame_width) +
+                        (tx * DETECT_TILE_SIZE);
+
+    for (int y = 0; y < DETECT_TILE_SIZE; y++)
+    {
+        const uint32_t *w = (const uint32_t *)p;
+        for (int x = 0; x < DETECT_TILE_SIZE / 2; x++)
+        {
+            h = (h ^ w[x]) * 16777619u;
+        }
+        p += frame_width;
+    }
+    return h;
+}
+
+/**
+ * Libera las reservas de la caché y la deja sin geometría
+ */
+static void tile_cache_release(void)
+{
+    free(s_tile_cache_hash);
+    free(s_tile_cache_accum);
+    free(s_tile_cache_fresh);
+    free(s_fondo_ref);
+    free(s_fondo_ref_valid);
+    s_tile_cache_hash = NULL;
+    s_tile_cache_accum = NULL;
+    s_tile_cache_fresh = NULL;
+    s_fondo_ref = NULL;
+    s_fondo_ref_valid = NULL;
+    s_tile_cache_tiles_x = 0;
+    s_tile_cache_tiles_y = 0;
+}
+
+/**
+ * Prepara la caché para la geometría y la LUT actuales
+ *
+ * Devuelve false si la caché no aplica (geometría no divisible en
+ * tiles) o no se pudo reservar; el llamador cae al escaneo denso.
+ */
+static bool tile_cache_prepare(int width, int height)
+{
+    if (width % DETECT_TILE_SIZE != 0 || height % DETECT_TILE_SIZE != 0)
+    {
         return false;
+    }
+
+    int tiles_x = width / DETECT_TILE_SIZE;
+    int tiles_y = height / DETECT_TILE_SIZE;
+    size_t tiles = (size_t)tiles_x * tiles_y;
 
-    // Verificar matiz (puede tener wraparound para rojo)
-    if (range->h_min <= range->h_max)
+    if (tiles_x != s_tile_cache_tiles_x || tiles_y != s_tile_cache_tiles_y)
     {
-        // Rango normal
-        return (h >= range->h_min && h <= range->h_max);
+        tile_cache_release();
+        s_tile_cache_hash = malloc(tiles * sizeof(uint32_t));
+        s_tile_cache_accum = malloc(tiles * VISION_MAX_COLORS * sizeof(tile_accum_t));
+        s_tile_cache_fresh = calloc(tiles, 1);
+        if (!s_tile_cache_hash || !s_tile_cache_accum || !s_tile_cache_fresh)
+        {
+            ESP_LOGW(TAG, "Sin memoria para la caché por tiles - escaneo denso");
+            tile_cache_release();
+            return false;
+        }
+
+        // El frame de referencia del modelo de fondo es grande (2 bytes
+        // por píxel, acaba en PSRAM); sin él la caché sigue funcionando
+        s_fondo_ref = malloc((size_t)width * height * sizeof(uint16_t));
+        s_fondo_ref_valid = calloc(tiles, 1);
+        if (!s_fondo_ref || !s_fondo_ref_valid)
+        {
+            free(s_fondo_ref);
+            free(s_fondo_ref_valid);
+            s_fondo_ref = NULL;
+            s_fondo_ref_valid = NULL;
+            ESP_LOGW(TAG, "Sin memoria para el modelo de fondo - solo checksums");
+        }
+
+        s_tile_cache_tiles_x = tiles_x;
+        s_tile_cache_tiles_y = tiles_y;
+        s_tile_cache_lut_gen = s_classify_lut_generation - 1; // Forzar invalidación
     }
-    else
+
+    if (s_tile_cache_lut_gen != s_classify_lut_generation)
     {
-        // Wraparound (ej: rojo que cruza 0)
-        return (h >= range->h_min || h <= range->h_max);
+        // La clasificación cambió: los parciales cacheados ya no valen.
+        // Las referencias de fondo tampoco: su garantía de "cero
+        // clasificados" se tomó con el conjunto de colores anterior
+        memset(s_tile_cache_fresh, 0, tiles);
+        if (s_fondo_ref_valid)
+        {
+            memset(s_fondo_ref_valid, 0, tiles);
+        }
+        s_tile_cache_lut_gen = s_classify_lut_generation;
     }
+    return true;
 }
 
 /**
- * Detecta objeto por color y calcula centroide
+ * Escanea una franja alineada a filas de tiles vía la caché incremental
+ *
+ * Cada stripe del split entre cores toca un rango disjunto de tiles,
+ * así que la caché compartida no necesita locks. Mismos puntos de
+ * cesión cooperativa que el escaneo denso, evaluados por fila de tiles.
  */
-void detect_object_by_color(const uint16_t *frame_buffer,
-                            int width,
-                            int height,
-                            const color_range_t *color_range,
-                            const homography_matrix_t *h_matrix,
-                            detection_result_t *result)
+static void scan_tiles_stripe(scan_stripe_job_t *job)
 {
-    if (!frame_buffer || !color_range || !result)
+    int64_t scan_start = esp_timer_get_time();
+    int64_t slice_start = scan_start;
+
+    int ty0 = job->y0 / DETECT_TILE_SIZE;
+    int ty1 = job->y1 / DETECT_TILE_SIZE;
+
+    for (int ty = ty0; ty < ty1; ty++)
     {
-        ESP_LOGE(TAG, "Invalid parameters");
+        if (s_scan_slice_budget_us != 0)
+        {
+            int64_t now = esp_timer_get_time();
+            if (now - slice_start >= (int64_t)s_scan_slice_budget_us)
+            {
+                if (now - scan_start >= SCAN_WDT_RELIEF_US)
+                {
+                    vTaskDelay(1); // Que el idle alimente el watchdog
+                    scan_start = esp_timer_get_time();
+                }
+                else
+                {
+                    taskYIELD();
+                }
+                slice_start = esp_timer_get_time();
+            }
+        }
+
+        for (int tx = 0; tx < s_tile_cache_tiles_x; tx++)
+        {
+            size_t t = (size_t)ty * s_tile_cache_tiles_x + tx;
+            tile_accum_t *cached = &s_tile_cache_accum[t * VISION_MAX_COLORS];
+            uint32_t h = detect_tile_hash(job->frame_buffer, job->width, tx, ty);
+
+            if (!s_tile_cache_fresh[t] || s_tile_cache_hash[t] != h)
+            {
+                // Tile sucio: clasificarlo y regrabar sus parciales. Con
+                // referencia de fondo vigente solo se clasifica el primer
+                // plano (píxeles fuera de tolerancia de su referencia)
+                memset(cached, 0, VISION_MAX_COLORS * sizeof(tile_accum_t));
+                size_t tile_off = (size_t)(ty * DETECT_TILE_SIZE) * job->width +
+                                  (size_t)(tx * DETECT_TILE_SIZE);
+                const uint16_t *p = job->frame_buffer + tile_off;
+                const uint16_t *ref = NULL;
+                if (s_fondo_enabled && s_fondo_ref != NULL && s_fondo_ref_valid[t])
+                {
+                    ref = s_fondo_ref + tile_off;
+                }
+
+                uint32_t clasificados = 0;
+                for (int y = 0; y < DETECT_TILE_SIZE; y++)
+                {
+                    for (int x = 0; x < DETECT_TILE_SIZE; x++)
+                    {
+                        uint16_t px = p[x];
+                        if (ref != NULL && fondo_pixel_es_fondo(px, ref[x]))
+                        {
+                            continue; // Fondo: ni LUT ni acumuladores
+                        }
+
+                        uint8_t mask = s_classify_lut[px];
+                        while (mask)
+                        {
+                            int i = __builtin_ctz(mask);
+                            mask &= (uint8_t)(mask - 1);
+
+                            tile_accum_t *acc = &cached[i];
+                            acc->sum_x += x;
+                            acc->sum_y += y;
+                            if (acc->count == 0 || x < acc->x_min) acc->x_min = (uint8_t)x;
+                            if (acc->count == 0 || x > acc->x_max) acc->x_max = (uint8_t)x;
+                            if (acc->count == 0 || y < acc->y_min) acc->y_min = (uint8_t)y;
+                            if (acc->count == 0 || y > acc->y_max) acc->y_max = (uint8_t)y;
+                            acc->count++;
+                            clasificados++;
+                        }
+                    }
+                    p += job->width;
+                    if (ref != NULL)
+                    {
+                        ref += job->width;
+                    }
+                }
+                s_tile_cache_hash[t] = h;
+                s_tile_cache_fresh[t] = 1;
+
+                // Adaptación lenta: solo los tiles sin ningún píxel
+                // clasificado regraban su referencia; un marcador
+                // detectado nunca se absorbe al fondo
+                if (s_fondo_enabled && s_fondo_ref != NULL && clasificados == 0)
+                {
+                    const uint16_t *src = job->frame_buffer + tile_off;
+                    uint16_t *dst = s_fondo_ref + tile_off;
+                    for (int y = 0; y < DETECT_TILE_SIZE; y++)
+                    {
+                        memcpy(dst, src, DETECT_TILE_SIZE * sizeof(uint16_t));
+                        src += job->width;
+                        dst += job->width;
+                    }
+                    s_fondo_ref_valid[t] = 1;
+                }
+            }
+
+            // Fusionar los parciales del tile trasladándolos al frame
+            int base_x = tx * DETECT_TILE_SIZE;
+            int base_y = ty * DETECT_TILE_SIZE;
+            for (int i = 0; i < job->num_colors; i++)
+            {
+                const tile_accum_t *acc = &cached[i];
+                if (acc->count == 0)
+                {
+                    continue;
+                }
+
+                job->sum_x[i] += (uint32_t)acc->sum_x + (uint32_t)base_x * acc->count;
+                job->sum_y[i] += (uint32_t)acc->sum_y + (uint32_t)base_y * acc->count;
+                job->count[i] += acc->count;
+
+                if (base_x + acc->x_min < job->bb_x_min[i]) job->bb_x_min[i] = base_x + acc->x_min;
+                if (base_x + acc->x_max > job->bb_x_max[i]) job->bb_x_max[i] = base_x + acc->x_max;
+                if (base_y + acc->y_min < job->bb_y_min[i]) job->bb_y_min[i] = base_y + acc->y_min;
+                if (base_y + acc->y_max > job->bb_y_max[i]) job->bb_y_max[i] = base_y + acc->y_max;
+            }
+        }
+    }
+}
+
+/**
+ * Despacha la franja a la variante especializada de su geometría
+ */
+static void scan_stripe(scan_stripe_job_t *job)
+{
+    if (job->incremental)
+    {
+        scan_tiles_stripe(job);
         return;
     }
 
-    // Inicializar resultado
-    result->centroid_x = -1;
-    result->centroid_y = -1;
-    result->pixel_count = 0;
-    result->detected = false;
-    result->world_coords.x = 0.0f;
-    result->world_coords.y = 0.0f;
+    for (size_t i = 0; i < sizeof(s_scan_stripe_variants) / sizeof(s_scan_stripe_variants[0]); i++)
+    {
+        if (s_scan_stripe_variants[i].width == job->width)
+        {
+            s_scan_stripe_variants[i].fn(job);
+            return;
+        }
+    }
+    scan_stripe_rows(job, job->width);
+}
+
+static void scan_worker_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Worker de escaneo iniciado en Core %d", xPortGetCoreID());
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        scan_stripe(&s_worker_job);
+        xTaskNotifyGive(s_scan_caller_handle);
+    }
+}
+
+/**
+ * Crea el worker de escaneo la primera vez que hace falta
+ */
+static bool scan_worker_ensure(void)
+{
+    static bool s_creation_failed = false;
+
+    if (s_scan_worker_handle != NULL)
+    {
+        return true;
+    }
+    if (s_creation_failed)
+    {
+        return false; // Avisar una sola vez, no a 30 FPS
+    }
+
+    BaseType_t result = xTaskCreatePinnedToCore(
+        scan_worker_task,
+        "scan_worker",
+        SCAN_WORKER_STACK_SIZE,
+        NULL,
+        SCAN_WORKER_PRIORITY,
+        &s_scan_worker_handle,
+        SCAN_WORKER_CORE_ID);
+
+    if (result != pdPASS)
+    {
+        ESP_LOGW(TAG, "No se pudo crear el worker de escaneo - franja única");
+        s_scan_worker_handle = NULL;
+        s_creation_failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+// ============================================================================
+// ETIQUETADO DE BLOBS Y FILTROS DE FORMA
+// ============================================================================
+
+/**
+ * Un centroide global por color no distingue el marcador de un vehículo
+ * de una remera del mismo color en la tribuna. Tras el escaneo, la caja
+ * de cada color se re-etiqueta por componentes conexas (RLE + union-find
+ * por filas, conectividad 8) y se elige el mejor blob que pase los
+ * filtros de forma. La caja de un marcador es chica, así que esta
+ * segunda pasada toca una fracción del frame.
+ */
+#define BLOB_MAX_RUNS 256    // Corridas totales; si se excede, sin refinar
+#define BLOB_MAX_ROW_RUNS 64 // Corridas por fila
+
+typedef struct
+{
+    int16_t x0, x1; // Corrida [x0, x1] inclusive
+    int16_t label;
+} blob_run_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t sum_x;
+    uint32_t sum_y;
+    int x_min, y_min, x_max, y_max;
+} blob_stats_t;
+
+// Scratch por frame desde la arena: 256 corridas no caben en el stack
+// de la tarea de visión y dejarlas estáticas clavaba ~9KB en .bss. Se
+// reservan una vez por frame (todos los colores comparten la tajada) y
+// el reset por frame de vision_task las recicla. El módulo sigue sin
+// ser reentrante (LUT y job del worker compartidos).
+static int16_t *s_blob_parent;
+static blob_stats_t *s_blob_stats;
+static blob_run_t *s_blob_rows[2];
+static uint32_t s_blob_generation;
+
+static int16_t blob_find(int16_t label)
+{
+    while (s_blob_parent[label] != label)
+    {
+        // Compresión de camino a mitades
+        s_blob_parent[label] = s_blob_parent[s_blob_parent[label]];
+        label = s_blob_parent[label];
+    }
+    return label;
+}
+
+static void blob_union(int16_t a, int16_t b)
+{
+    a = blob_find(a);
+    b = blob_find(b);
+    if (a != b)
+    {
+        // La etiqueta menor sobrevive (determinístico)
+        if (a < b)
+        {
+            s_blob_parent[b] = a;
+        }
+        else
+        {
+            s_blob_parent[a] = b;
+        }
+    }
+}
+
+/**
+ * Re-etiqueta la caja de un color y devuelve el mejor blob que pase
+ * los filtros de forma
+ *
+ * @return true si hay un blob aceptable; false si todos se rechazan o
+ *         la región es demasiado fragmentada para etiquetar
+ */
+static bool blob_refine(const uint16_t *frame_buffer,
+                        int width,
+                        const scan_stripe_job_t *job,
+                        int color,
+                        blob_stats_t *best)
+{
+    const uint8_t bit = (uint8_t)(1u << color);
+    int next_label = 0;
+    int prev_count = 0;
+    int parity = 0;
 
-    uint32_t sum_x = 0;
-    uint32_t sum_y = 0;
-    uint32_t count = 0;
+    if (s_blob_parent == NULL || s_blob_generation != mem_arena_generation())
+    {
+        s_blob_parent = mem_arena_alloc(BLOB_MAX_RUNS * sizeof(*s_blob_parent));
+        s_blob_stats = mem_arena_alloc(BLOB_MAX_RUNS * sizeof(*s_blob_stats));
+        s_blob_rows[0] = mem_arena_alloc(BLOB_MAX_ROW_RUNS * sizeof(*s_blob_rows[0]));
+        s_blob_rows[1] = mem_arena_alloc(BLOB_MAX_ROW_RUNS * sizeof(*s_blob_rows[1]));
+        s_blob_generation = mem_arena_generation();
+        if (s_blob_parent == NULL || s_blob_stats == NULL ||
+            s_blob_rows[0] == NULL || s_blob_rows[1] == NULL)
+        {
+            s_blob_parent = NULL;
+            return false; // Sin arena: el centroide grueso sigue sirviendo
+        }
+    }
 
-    // Procesar cada píxel del frame
-    for (int y = 0; y < height; y++)
+    for (int y = job->bb_y_min[color]; y <= job->bb_y_max[color]; y++)
     {
-        for (int x = 0; x < width; x++)
+        const uint16_t *row = &frame_buffer[y * width];
+        blob_run_t *cur = s_blob_rows[parity];
+        const blob_run_t *prev = s_blob_rows[parity ^ 1];
+        int cur_count = 0;
+
+        // Armar las corridas de esta fila
+        int x = job->bb_x_min[color];
+        while (x <= job->bb_x_max[color])
         {
-            int idx = y * width + x;
-            uint16_t pixel = frame_buffer[idx];
+            if (!(s_classify_lut[row[x]] & bit))
+            {
+                x++;
+                continue;
+            }
+
+            int run_start = x;
+            while (x <= job->bb_x_max[color] && (s_classify_lut[row[x]] & bit))
+            {
+                x++;
+            }
 
-            // Convertir a HSV
-            uint8_t h, s, v;
-            rgb565_to_hsv_fast(pixel, &h, &s, &v);
+            if (cur_count >= BLOB_MAX_ROW_RUNS || next_label >= BLOB_MAX_RUNS)
+            {
+                return false; // Región demasiado fragmentada
+            }
 
-            // Verificar si está en rango
-            if (pixel_in_range(h, s, v, color_range))
+            cur[cur_count].x0 = (int16_t)run_start;
+            cur[cur_count].x1 = (int16_t)(x - 1);
+            cur[cur_count].label = -1;
+
+            // Anotar el matiz de la corrida para el lazo de deriva: son
+            // exactamente los píxeles clasificados, recién visitados y
+            // calientes en caché; los bucles de escaneo no se tocan
+            if (s_drift_enabled)
             {
-                sum_x += x;
-                sum_y += y;
-                count++;
+                for (int rx = run_start; rx < x; rx++)
+                {
+                    drift_hist_note(row[rx], bit);
+                }
             }
+
+            // Conectar con las corridas de la fila anterior
+            // (conectividad 8: alcanza con solapar en +/-1)
+            for (int p = 0; p < prev_count; p++)
+            {
+                if (prev[p].x1 + 1 >= cur[cur_count].x0 &&
+                    prev[p].x0 - 1 <= cur[cur_count].x1)
+                {
+                    if (cur[cur_count].label < 0)
+                    {
+                        cur[cur_count].label = blob_find(prev[p].label);
+                    }
+                    else
+                    {
+                        blob_union(cur[cur_count].label, prev[p].label);
+                    }
+                }
+            }
+
+            if (cur[cur_count].label < 0)
+            {
+                // Corrida sin vecinos arriba: blob nuevo
+                cur[cur_count].label = (int16_t)next_label;
+                s_blob_parent[next_label] = (int16_t)next_label;
+                s_blob_stats[next_label].count = 0;
+                s_blob_stats[next_label].sum_x = 0;
+                s_blob_stats[next_label].sum_y = 0;
+                s_blob_stats[next_label].x_min = INT32_MAX;
+                s_blob_stats[next_label].y_min = INT32_MAX;
+                s_blob_stats[next_label].x_max = -1;
+                s_blob_stats[next_label].y_max = -1;
+                next_label++;
+            }
+
+            // Acumular la corrida sobre su etiqueta (se fusiona por raíz
+            // al final): suma de x0..x1 por progresión aritmética
+            blob_stats_t *st = &s_blob_stats[cur[cur_count].label];
+            uint32_t len = (uint32_t)(cur[cur_count].x1 - cur[cur_count].x0 + 1);
+            st->count += len;
+            st->sum_x += (uint32_t)(cur[cur_count].x0 + cur[cur_count].x1) * len / 2;
+            st->sum_y += (uint32_t)y * len;
+            if (cur[cur_count].x0 < st->x_min) st->x_min = cur[cur_count].x0;
+            if (cur[cur_count].x1 > st->x_max) st->x_max = cur[cur_count].x1;
+            if (y < st->y_min) st->y_min = y;
+            if (y > st->y_max) st->y_max = y;
+
+            cur_count++;
+        }
+
+        prev_count = cur_count;
+        parity ^= 1;
+    }
+
+    // Fusionar los parciales de cada etiqueta en su raíz
+    for (int l = 0; l < next_label; l++)
+    {
+        int16_t root = blob_find((int16_t)l);
+        if (root == l)
+        {
+            continue;
+        }
+
+        blob_stats_t *st = &s_blob_stats[l];
+        blob_stats_t *rt = &s_blob_stats[root];
+        rt->count += st->count;
+        rt->sum_x += st->sum_x;
+        rt->sum_y += st->sum_y;
+        if (st->x_min < rt->x_min) rt->x_min = st->x_min;
+        if (st->y_min < rt->y_min) rt->y_min = st->y_min;
+        if (st->x_max > rt->x_max) rt->x_max = st->x_max;
+        if (st->y_max > rt->y_max) rt->y_max = st->y_max;
+        st->count = 0;
+    }
+
+    // Elegir el blob más grande que pase los filtros de forma
+    bool found = false;
+    for (int l = 0; l < next_label; l++)
+    {
+        const blob_stats_t *st = &s_blob_stats[l];
+
+        if (st->count < VISION_BLOB_MIN_PIXELS)
+        {
+            continue;
+        }
+
+        float bb_w = (float)(st->x_max - st->x_min + 1);
+        float bb_h = (float)(st->y_max - st->y_min + 1);
+        float aspect = bb_w / bb_h;
+        float fill = (float)st->count / (bb_w * bb_h);
+
+        if (aspect < VISION_BLOB_ASPECT_MIN || aspect > VISION_BLOB_ASPECT_MAX ||
+            fill < VISION_BLOB_FILL_MIN)
+        {
+            continue;
+        }
+
+        if (!found || st->count > best->count)
+        {
+            *best = *st;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Detecta varios colores en una sola pasada sobre el frame
+ *
+ * La conversión RGB565->HSV es la parte cara del escaneo; al compartirla
+ * entre todos los rangos, detectar N colores cuesta casi lo mismo que
+ * detectar uno solo (seguir dos marcadores ya no duplica el costo).
+ */
+void detect_objects_multi_color_window(const uint16_t *frame_buffer,
+                                       int width,
+                                       int height,
+                                       const color_range_t *const color_ranges[],
+                                       int num_colors,
+                                       const search_window_t *window,
+                                       const homography_matrix_t *h_matrix,
+                                       detection_result_t *results)
+{
+    if (!frame_buffer || !color_ranges || !results ||
+        num_colors <= 0 || num_colors > VISION_MAX_COLORS)
+    {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return;
+    }
+
+    // Limitar el escaneo a la ventana de búsqueda (recortada al frame);
+    // sin ventana se recorre el frame completo
+    int x0 = 0, y0 = 0, x1 = width, y1 = height;
+    if (window)
+    {
+        x0 = (window->x_min > 0) ? window->x_min : 0;
+        y0 = (window->y_min > 0) ? window->y_min : 0;
+        x1 = (window->x_max < width) ? window->x_max : width;
+        y1 = (window->y_max < height) ? window->y_max : height;
+
+        if (x0 >= x1 || y0 >= y1)
+        {
+            ESP_LOGE(TAG, "Ventana de búsqueda vacía");
+            return;
+        }
+    }
+
+    // Acumuladores de la franja local (en stack, VISION_MAX_COLORS es pequeño)
+    scan_stripe_job_t local_job;
+    scan_job_reset(&local_job);
+
+    // Inicializar resultados
+    for (int i = 0; i < num_colors; i++)
+    {
+        results[i].centroid_x = -1;
+        results[i].centroid_y = -1;
+        results[i].pixel_count = 0;
+        results[i].detected = false;
+        results[i].world_coords.x = 0.0f;
+        results[i].world_coords.y = 0.0f;
+        results[i].bbox_x_min = -1;
+        results[i].bbox_y_min = -1;
+        results[i].bbox_x_max = -1;
+        results[i].bbox_y_max = -1;
+        results[i].aspect_ratio = 0.0f;
+        results[i].fill_ratio = 0.0f;
+    }
+
+    // Reconstruir la LUT solo si cambió el conjunto de rangos (antes de
+    // despachar al worker: la tabla debe estar lista para ambos cores)
+    if (!classify_lut_matches(color_ranges, num_colors))
+    {
+        classify_lut_build(color_ranges, num_colors);
+    }
+
+    local_job.frame_buffer = frame_buffer;
+    local_job.width = width;
+    local_job.x0 = x0;
+    local_job.x1 = x1;
+    local_job.num_colors = num_colors;
+
+    // El escaneo de frame completo reutiliza los parciales por tile de
+    // la muestra anterior; las ventanas de seguimiento van densas
+    local_job.incremental = s_incremental_enabled &&
+                            x0 == 0 && y0 == 0 && x1 == width && y1 == height &&
+                            tile_cache_prepare(width, height);
+
+    // Partir en dos franjas de filas si la ventana amerita el despertar
+    // del worker; las coordenadas acumuladas son absolutas del frame
+    bool split = (y1 - y0 >= SCAN_SPLIT_MIN_ROWS) && scan_worker_ensure();
+
+    if (split)
+    {
+        int y_mid = y0 + (y1 - y0) / 2;
+        if (local_job.incremental)
+        {
+            y_mid &= ~(DETECT_TILE_SIZE - 1); // Franjas en filas de tiles enteras
+        }
+
+        scan_job_reset(&s_worker_job);
+        s_worker_job.frame_buffer = frame_buffer;
+        s_worker_job.width = width;
+        s_worker_job.x0 = x0;
+        s_worker_job.x1 = x1;
+        s_worker_job.y0 = y0;
+        s_worker_job.y1 = y_mid;
+        s_worker_job.num_colors = num_colors;
+        s_worker_job.incremental = local_job.incremental;
+
+        s_scan_caller_handle = xTaskGetCurrentTaskHandle();
+        xTaskNotifyGive(s_scan_worker_handle);
+
+        // Franja inferior en este core, en paralelo con el worker
+        local_job.y0 = y_mid;
+        local_job.y1 = y1;
+        scan_stripe(&local_job);
+
+        // Esperar la franja superior y fusionar los parciales
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (int i = 0; i < num_colors; i++)
+        {
+            local_job.sum_x[i] += s_worker_job.sum_x[i];
+            local_job.sum_y[i] += s_worker_job.sum_y[i];
+            local_job.count[i] += s_worker_job.count[i];
+
+            if (s_worker_job.bb_x_min[i] < local_job.bb_x_min[i])
+                local_job.bb_x_min[i] = s_worker_job.bb_x_min[i];
+            if (s_worker_job.bb_y_min[i] < local_job.bb_y_min[i])
+                local_job.bb_y_min[i] = s_worker_job.bb_y_min[i];
+            if (s_worker_job.bb_x_max[i] > local_job.bb_x_max[i])
+                local_job.bb_x_max[i] = s_worker_job.bb_x_max[i];
+            if (s_worker_job.bb_y_max[i] > local_job.bb_y_max[i])
+                local_job.bb_y_max[i] = s_worker_job.bb_y_max[i];
         }
     }
+    else
+    {
+        local_job.y0 = y0;
+        local_job.y1 = y1;
+        scan_stripe(&local_job);
+    }
 
-    // Calcular centroide si se detectaron píxeles
-    if (count > 0)
+    // Lazo de deriva de matiz: con lo anotado por este escaneo alcanza
+    if (s_drift_enabled)
     {
-        result->centroid_x = sum_x / count;
-        result->centroid_y = sum_y / count;
-        result->pixel_count = count;
+        drift_feedback(color_ranges, num_colors);
+    }
+
+    // Calcular centroide de cada color detectado
+    for (int i = 0; i < num_colors; i++)
+    {
+        detection_result_t *result = &results[i];
+
+        if (local_job.count[i] == 0)
+        {
+            ESP_LOGD(TAG, "No object detected (color %d)", i);
+            continue;
+        }
+
+        // Etiquetar la caja del color y quedarse con el mejor blob;
+        // los filtros de forma rechazan basura antes de la homografía
+        blob_stats_t best = {0};
+        if (!blob_refine(frame_buffer, width, &local_job, i, &best))
+        {
+            ESP_LOGD(TAG, "Blobs del color %d rechazados por forma", i);
+            continue;
+        }
+
+        result->centroid_x = best.sum_x / best.count;
+        result->centroid_y = best.sum_y / best.count;
+        result->pixel_count = best.count;
         result->detected = true;
+        result->bbox_x_min = best.x_min;
+        result->bbox_y_min = best.y_min;
+        result->bbox_x_max = best.x_max;
+        result->bbox_y_max = best.y_max;
+        result->aspect_ratio = (float)(best.x_max - best.x_min + 1) /
+                               (float)(best.y_max - best.y_min + 1);
+        result->fill_ratio = (float)best.count /
+                             ((float)(best.x_max - best.x_min + 1) *
+                              (float)(best.y_max - best.y_min + 1));
 
-        // Transformar coordenadas de píxeles a mundo real si hay matriz
+        // Transformar coordenadas de píxeles a mundo real si hay matriz.
+        // El reporte va al anillo de eventos: formatear flotantes por la
+        // UART acá costaría más que la transformación homográfica misma
         if (h_matrix)
         {
             pixel_point_t pixel_pt = {
@@ -163,19 +1353,56 @@ void detect_object_by_color(const uint16_t *frame_buffer,
                 .v = result->centroid_y};
             homography_transform(h_matrix, pixel_pt, &result->world_coords);
 
-            ESP_LOGI(TAG, "Object detected at pixel (%d, %d) -> world (%.2f cm, %.2f cm), %lu pixels",
-                     result->centroid_x, result->centroid_y,
-                     result->world_coords.x, result->world_coords.y,
-                     result->pixel_count);
+            event_log_push(EVENT_DETECTION_WORLD,
+                           result->centroid_x, result->centroid_y,
+                           (int32_t)result->pixel_count,
+                           (int32_t)(result->world_coords.x * 100.0f),
+                           (int32_t)(result->world_coords.y * 100.0f));
         }
         else
         {
-            ESP_LOGI(TAG, "Object detected at (%d, %d) with %lu pixels",
-                     result->centroid_x, result->centroid_y, result->pixel_count);
+            event_log_push(EVENT_DETECTION,
+                           result->centroid_x, result->centroid_y,
+                           (int32_t)result->pixel_count, 0, 0);
         }
     }
-    else
+}
+
+/**
+ * Detecta varios colores en una pasada sobre el frame completo
+ */
+void detect_objects_multi_color(const uint16_t *frame_buffer,
+                                int width,
+                                int height,
+                                const color_range_t *const color_ranges[],
+                                int num_colors,
+                                const homography_matrix_t *h_matrix,
+                                detection_result_t *results)
+{
+    detect_objects_multi_color_window(frame_buffer, width, height,
+                                      color_ranges, num_colors,
+                                      NULL, h_matrix, results);
+}
+
+/**
+ * Detecta objeto por color y calcula centroide
+ *
+ * Caso particular de detect_objects_multi_color() con un solo rango.
+ */
+void detect_object_by_color(const uint16_t *frame_buffer,
+                            int width,
+                            int height,
+                            const color_range_t *color_range,
+                            const homography_matrix_t *h_matrix,
+                            detection_result_t *result)
+{
+    const color_range_t *const ranges[1] = {color_range};
+
+    if (!color_range || !result)
     {
-        ESP_LOGD(TAG, "No object detected");
+        ESP_LOGE(TAG, "Invalid parameters");
+        return;
     }
+
+    detect_objects_multi_color(frame_buffer, width, height, ranges, 1, h_matrix, result);
 }
@@ -35,8 +35,27 @@ typedef struct {
     world_point_t world_coords; // Coordenadas en el mundo real (cm)
     uint32_t pixel_count; // Cantidad de píxeles detectados
     bool detected;     // True si se detectó el objeto
+    int bbox_x_min;    // Caja del mejor blob (válida solo si detected)
+    int bbox_y_min;
+    int bbox_x_max;    // Límites inclusivos
+    int bbox_y_max;
+    float aspect_ratio; // Ancho/alto de la caja
+    float fill_ratio;   // Píxeles del blob / área de la caja
 } detection_result_t;
 
+/**
+ * @brief Filtros de forma para blobs candidatos
+ *
+ * Un marcador de vehículo es compacto y aproximadamente cuadrado; una
+ * remera del mismo color en la tribuna no. Los blobs que no pasan
+ * estos filtros se rechazan antes de la transformación homográfica,
+ * así no generan tráfico de coordenadas de mundo espurio.
+ */
+#define VISION_BLOB_MIN_PIXELS (30)     // Ruido por debajo de esto
+#define VISION_BLOB_ASPECT_MIN (0.33f)  // Caja más de 3:1 no es marcador
+#define VISION_BLOB_ASPECT_MAX (3.0f)
+#define VISION_BLOB_FILL_MIN (0.30f)    // Blobs huecos o dispersos
+
 /**
  * @brief Convierte un píxel RGB565 a HSV usando aritmética de enteros
  * Optimizado para velocidad en ESP32-S3
@@ -48,6 +67,148 @@ typedef struct {
  */
 void rgb565_to_hsv_fast(uint16_t pixel, uint8_t *h, uint8_t *s, uint8_t *v);
 
+/**
+ * @brief Cantidad máxima de colores por pasada de detección
+ */
+#define VISION_MAX_COLORS 4
+
+/**
+ * @brief Selecciona el modo solo-matiz del clasificador
+ *
+ * En arenas bien iluminadas los límites de saturación casi nunca
+ * rechazan un píxel que el matiz acepta; este modo omite la división
+ * de saturación (la operación más cara de la conversión HSV) al
+ * reconstruir la LUT de clasificación. Con los límites S de todos los
+ * rangos abiertos (0-255) el modo se activa solo y el resultado es
+ * bit-idéntico al completo. El cambio toma efecto en la próxima
+ * reconstrucción de la LUT.
+ *
+ * @param enable true para clasificar solo por matiz (y valor)
+ */
+void vision_set_hue_only_classifier(bool enable);
+
+/**
+ * @brief Configura la rodaja de tiempo del escaneo cooperativo
+ *
+ * El bucle de filas cede el procesador cada vez que agota este
+ * presupuesto, así los escaneos de frames grandes (VGA) se intercalan
+ * con las tareas de igual prioridad sin disparar el watchdog ni bajar
+ * la prioridad de la tarea de visión. Con 0 se escanea sin ceder
+ * (comportamiento anterior).
+ *
+ * @param budget_us Microsegundos de ráfaga antes de ceder
+ */
+void vision_set_scan_slice_budget(uint32_t budget_us);
+
+/**
+ * @brief Habilita la caché incremental de acumuladores por tile
+ *
+ * El escaneo de frame completo guarda por tile de 16x16 un checksum y
+ * los parciales de clasificación de cada color; los tiles que no
+ * cambiaron desde la muestra anterior suman sus parciales cacheados
+ * sin reclasificar un píxel. En escenas casi estáticas el costo por
+ * frame baja al del checksum más los tiles que cambiaron. No afecta a
+ * los escaneos con ventana de seguimiento. Deshabilitada por defecto
+ * para que los benchmarks sigan midiendo el escaneo denso.
+ *
+ * @param enable true para reutilizar parciales entre frames
+ */
+void vision_set_incremental_detection(bool enable);
+
+/**
+ * @brief Habilita el modelo de fondo por píxel de la cámara fija
+ *
+ * Complemento de la caché incremental: para los tiles cuyo checksum no
+ * coincide (ruido del sensor, deriva de iluminación) se compara cada
+ * píxel contra un frame de referencia con tolerancia por canal y solo
+ * el primer plano pasa por la LUT. La referencia de un tile se regraba
+ * únicamente cuando su escaneo no clasificó ningún píxel, así la
+ * deriva lenta se absorbe pero un marcador detectado nunca pasa a
+ * formar parte del fondo. Solo actúa dentro de los escaneos
+ * incrementales de frame completo.
+ *
+ * @param enable true (default) para enmascarar el fondo por referencia
+ */
+void vision_set_background_model(bool enable);
+
+/**
+ * @brief Habilita la compensación de deriva de matiz
+ *
+ * Los píxeles que clasifican durante el escaneo anotan su matiz en un
+ * histograma por color (sin pasada extra); un lazo lento compara el
+ * modo con el centro del rango activo y corre el rango un paso hacia
+ * él cuando la iluminación de la arena deriva, reconstruyendo la LUT.
+ * El offset queda acotado a unos pocos grados de matiz para que un
+ * objeto espurio no arrastre la calibración; cambiar los rangos del
+ * operador resetea la deriva acumulada.
+ *
+ * @param enable true para seguir la deriva de iluminación
+ */
+void vision_set_hue_drift_compensation(bool enable);
+
+/**
+ * @brief Ventana de búsqueda rectangular en coordenadas de píxel
+ *
+ * Límites [x_min, x_max) y [y_min, y_max); se recorta automáticamente
+ * al tamaño del frame.
+ */
+typedef struct {
+    int x_min;
+    int y_min;
+    int x_max;
+    int y_max;
+} search_window_t;
+
+/**
+ * @brief Detecta varios objetos de color dentro de una ventana de búsqueda
+ *
+ * Igual que detect_objects_multi_color(), pero escanea solo la ventana
+ * indicada. Con la ventana sembrada desde la última detección el costo
+ * del escaneo baja en proporción al área, lo que permite sostener los
+ * 30 FPS en el S3. Los centroides resultantes quedan en coordenadas
+ * absolutas del frame.
+ *
+ * @param frame_buffer Buffer de la imagen en formato RGB565
+ * @param width Ancho de la imagen en píxeles
+ * @param height Alto de la imagen en píxeles
+ * @param color_ranges Arreglo de punteros a rangos HSV (máx VISION_MAX_COLORS)
+ * @param num_colors Cantidad de rangos en el arreglo
+ * @param window Ventana de búsqueda (NULL para el frame completo)
+ * @param h_matrix Matriz de homografía para calcular coordenadas del mundo real (puede ser NULL)
+ * @param results Arreglo de num_colors resultados, uno por rango
+ */
+void detect_objects_multi_color_window(const uint16_t *frame_buffer,
+                                       int width,
+                                       int height,
+                                       const color_range_t *const color_ranges[],
+                                       int num_colors,
+                                       const search_window_t *window,
+                                       const homography_matrix_t *h_matrix,
+                                       detection_result_t *results);
+
+/**
+ * @brief Detecta varios objetos de color en un frame RGB565 en una sola pasada
+ *
+ * La conversión HSV de cada píxel se comparte entre todos los rangos,
+ * por lo que seguir varios marcadores (ej: COLOR_RED y COLOR_BLUE)
+ * cuesta casi lo mismo que seguir uno solo.
+ *
+ * @param frame_buffer Buffer de la imagen en formato RGB565
+ * @param width Ancho de la imagen en píxeles
+ * @param height Alto de la imagen en píxeles
+ * @param color_ranges Arreglo de punteros a rangos HSV (máx VISION_MAX_COLORS)
+ * @param num_colors Cantidad de rangos en el arreglo
+ * @param h_matrix Matriz de homografía para calcular coordenadas del mundo real (puede ser NULL)
+ * @param results Arreglo de num_colors resultados, uno por rango
+ */
+void detect_objects_multi_color(const uint16_t *frame_buffer,
+                                int width,
+                                int height,
+                                const color_range_t *const color_ranges[],
+                                int num_colors,
+                                const homography_matrix_t *h_matrix,
+                                detection_result_t *results);
+
 /**
  * @brief Detecta un objeto de color en un frame RGB565
  * 
@@ -2,28 +2,445 @@
 #include "camera_driver/camera_driver.h"
 #include "vision/vision.h"
 #include "vision/homography.h"
+#include "vision/trajectory.h"
 #include "ws_server/ws_server.h"
+#include "mem_arena/mem_arena.h"
+#include "metrics/metrics.h"
+#include "trace_points.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_camera.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
+#include <sys/time.h>
 
 static const char *TAG = "VisionTask";
 
 static TaskHandle_t vision_task_handle = NULL;
+static TaskHandle_t encode_task_handle = NULL;
 static QueueHandle_t frame_queue = NULL;
+
+// Frames prestados al codificador: el cambio de perfil de cámara
+// reinicializa el driver y eso invalida todo fb en circulación, así que
+// solo se aplica cuando este contador vuelve a cero
+static _Atomic int s_frames_in_flight = 0;
 static const color_range_t *current_color = &COLOR_RED;
+static int current_color_id = 0; // Índice estable para los overlays del dashboard
 static bool processing_enabled = true;
 static homography_matrix_t h_matrix;
 
+// FPS objetivo del bucle de visión (ajustable en runtime). Sin clientes
+// conectados el bucle baja solo a VISION_IDLE_FPS: nadie consume los
+// resultados y no tiene sentido quemar el presupuesto completo.
+static int target_fps = VISION_TARGET_FPS_DEFAULT;
+
+// ---------------------------------------------------------------------------
+// Ventana de búsqueda con seguimiento
+//
+// El movimiento de los marcadores entre frames está acotado por la
+// velocidad de los vehículos, así que tras una detección alcanza con
+// escanear un recorte alrededor del último centroide. En cada fallo la
+// ventana se duplica hasta volver al frame completo.
+// ---------------------------------------------------------------------------
+#define TRACK_WINDOW_HALF_PX (40) // Media ventana inicial tras detección
+#define TRACK_WINDOW_MAX_HALF_PX (320)
+
+static bool track_window_valid = false;
+static int track_window_cx = 0;
+static int track_window_cy = 0;
+static int track_window_half = TRACK_WINDOW_HALF_PX;
+
+// ---------------------------------------------------------------------------
+// Pool de JPEGs codificados
+//
+// frame2jpg() hace un malloc fresco por frame; acá la codificación
+// escribe vía frame2jpg_cb() sobre buffers del pool, que crecen hasta
+// el tamaño máximo visto y después se reutilizan. El slot publicado
+// queda fijado mientras algún consumidor lo tenga prestado (refs > 0);
+// si todos los slots están retenidos por clientes lentos, el frame se
+// descarta y el siguiente trae la imagen más nueva.
+// ---------------------------------------------------------------------------
+typedef struct
+{
+    uint8_t *data;
+    size_t cap;
+    size_t len;
+    uint32_t seq;
+    uint32_t ts_ms;
+    int refs;
+} jpeg_slot_t;
+
+static jpeg_slot_t s_jpeg_pool[VISION_JPEG_POOL_SLOTS];
+static int s_jpeg_latest = -1; // Índice del último slot publicado
+static uint32_t s_jpeg_seq = 0;
+static SemaphoreHandle_t s_jpeg_mutex = NULL;
+static int s_http_viewers = 0; // Consumidores MJPEG registrados
+
+// Última detección publicada, para los handlers HTTP de consulta
+// (/detection). Comparte el mutex del pool: misma cadencia, mismo dueño
+static detection_result_t s_last_detection;
+static uint32_t s_last_detection_ts_ms = 0;
+static bool s_last_detection_valid = false;
+
+// Acumulados para /metrics: muestras de detección procesadas y cuántas
+// vieron el objeto (el scraper deriva tasas y razón de acierto). Solo
+// los escribe la tarea de visión; el proveedor los lee sin atómicos y a
+// lo sumo ve un valor de un frame atrás.
+static uint32_t s_det_samples_total = 0;
+static uint32_t s_det_hits_total = 0;
+
+/**
+ * @brief Liberar los buffers del pool tras un período sin espectadores
+ *
+ * El pool crece hasta el JPEG más grande visto y antes quedaba así
+ * para siempre; en corridas sin dashboard eso eran decenas de KB
+ * muertos. Pasados CONFIG_STREAM_IDLE_RELEASE_S segundos sin clientes
+ * se sueltan los slots no prestados; el primer espectador nuevo los
+ * vuelve a hacer crecer desde cero. La detección no toca el pool.
+ */
+static void jpeg_pool_idle_release(uint32_t *last_busy_ms)
+{
+#if CONFIG_STREAM_IDLE_RELEASE_S > 0
+    if (ws_server_has_clients() || s_http_viewers > 0)
+    {
+        *last_busy_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        return;
+    }
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (*last_busy_ms == 0 ||
+        now_ms - *last_busy_ms < (uint32_t)CONFIG_STREAM_IDLE_RELEASE_S * 1000)
+    {
+        return;
+    }
+
+    size_t freed = 0;
+    xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+    for (int i = 0; i < VISION_JPEG_POOL_SLOTS; i++)
+    {
+        if (s_jpeg_pool[i].data != NULL && s_jpeg_pool[i].refs == 0)
+        {
+            freed += s_jpeg_pool[i].cap;
+            free(s_jpeg_pool[i].data);
+            s_jpeg_pool[i].data = NULL;
+            s_jpeg_pool[i].cap = 0;
+            s_jpeg_pool[i].len = 0;
+            if (s_jpeg_latest == i)
+            {
+                s_jpeg_latest = -1;
+            }
+        }
+    }
+    xSemaphoreGive(s_jpeg_mutex);
+
+    if (freed > 0)
+    {
+        ESP_LOGI(TAG, "Pool JPEG liberado tras %d s ocioso (%u bytes al heap)",
+                 CONFIG_STREAM_IDLE_RELEASE_S, (unsigned)freed);
+    }
+    *last_busy_ms = 0; // No repetir el log hasta la próxima actividad
+#else
+    (void)last_busy_ms;
+#endif
+}
+
+/**
+ * @brief Callback de frame2jpg_cb: anexa al buffer del slot
+ *
+ * Crece la capacidad en potencias de dos para no reallocar en cada
+ * bloque que entrega el codificador.
+ */
+static size_t jpeg_slot_writer(void *arg, size_t index, const void *data, size_t len)
+{
+    jpeg_slot_t *slot = (jpeg_slot_t *)arg;
+
+    if (index + len > slot->cap)
+    {
+        size_t new_cap = slot->cap ? slot->cap : 16 * 1024;
+        while (new_cap < index + len)
+        {
+            new_cap *= 2;
+        }
+
+        uint8_t *grown = realloc(slot->data, new_cap);
+        if (!grown)
+        {
+            return 0; // Aborta la conversión
+        }
+        slot->data = grown;
+        slot->cap = new_cap;
+    }
+
+    memcpy(slot->data + index, data, len);
+    slot->len = index + len;
+    return len;
+}
+
+// ---------------------------------------------------------------------------
+// Calidad ponderada por región
+//
+// frame2jpg_cb() usa un único factor de calidad para todo el frame, así
+// que la ponderación se hace antes del codificador: con una detección
+// fresca, los píxeles fuera de su caja (más un margen) se promedian en
+// bloques 2x2. El fondo aplanado casi no gasta bytes de DCT y la caja
+// conserva la calidad completa; misma utilidad percibida con frames
+// bastante más chicos sobre el aire compartido. Sin detección el frame
+// sale intacto: el operador necesita ver por qué no se detecta nada.
+// ---------------------------------------------------------------------------
+#define ROI_JPEG_MARGEN_PX 24    // Margen alrededor de la caja detectada
+#define ROI_JPEG_EDAD_MAX_MS 500 // Detecciones viejas no fijan calidad
+
+static void roi_suavizar_fondo(camera_fb_t *fb)
+{
+    if (fb->format != PIXFORMAT_RGB565)
+    {
+        return;
+    }
+
+    // Snapshot de la última detección con el mismo mutex del pool
+    detection_result_t det;
+    uint32_t det_ts = 0;
+    bool det_valid;
+    xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+    det = s_last_detection;
+    det_ts = s_last_detection_ts_ms;
+    det_valid = s_last_detection_valid;
+    xSemaphoreGive(s_jpeg_mutex);
+
+    uint32_t ahora_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (!det_valid || !det.detected || ahora_ms - det_ts > ROI_JPEG_EDAD_MAX_MS)
+    {
+        return;
+    }
+
+    int bx0 = det.bbox_x_min - ROI_JPEG_MARGEN_PX;
+    int by0 = det.bbox_y_min - ROI_JPEG_MARGEN_PX;
+    int bx1 = det.bbox_x_max + ROI_JPEG_MARGEN_PX;
+    int by1 = det.bbox_y_max + ROI_JPEG_MARGEN_PX;
+
+    uint16_t *pixels = (uint16_t *)fb->buf;
+    int width = (int)fb->width;
+    int height = (int)fb->height;
+
+    for (int y = 0; y + 1 < height; y += 2)
+    {
+        uint16_t *fila0 = &pixels[y * width];
+        uint16_t *fila1 = &pixels[(y + 1) * width];
+        bool filas_caja = (y + 1 >= by0 && y <= by1);
+
+        for (int x = 0; x + 1 < width; x += 2)
+        {
+            if (filas_caja && x + 1 >= bx0 && x <= bx1)
+            {
+                continue; // Dentro de la caja protegida
+            }
+
+            uint32_t r = ((fila0[x] >> 11) & 0x1F) + ((fila0[x + 1] >> 11) & 0x1F) +
+                         ((fila1[x] >> 11) & 0x1F) + ((fila1[x + 1] >> 11) & 0x1F);
+            uint32_t g = ((fila0[x] >> 5) & 0x3F) + ((fila0[x + 1] >> 5) & 0x3F) +
+                         ((fila1[x] >> 5) & 0x3F) + ((fila1[x + 1] >> 5) & 0x3F);
+            uint32_t b = (fila0[x] & 0x1F) + (fila0[x + 1] & 0x1F) +
+                         (fila1[x] & 0x1F) + (fila1[x + 1] & 0x1F);
+            uint16_t prom = (uint16_t)(((r >> 2) << 11) | ((g >> 2) << 5) | (b >> 2));
+
+            fila0[x] = prom;
+            fila0[x + 1] = prom;
+            fila1[x] = prom;
+            fila1[x + 1] = prom;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Codificación JPEG en bandas paralelas
+//
+// La codificación era la etapa más larga del pipeline y corría entera
+// en el Core 0 mientras el Core 1 solo detectaba. El frame se parte en
+// dos bandas alineadas a filas de MCU (16 líneas en RGB565): el Core 0
+// codifica la banda superior directo al slot del pool y una tarea
+// auxiliar en el Core 1 codifica la inferior a un scratch en PSRAM;
+// los marcadores de reinicio JPEG hacen que ambos segmentos se
+// concatenen en un archivo válido (ver frame2jpg_cb_band). La tarea
+// auxiliar corre por debajo de la prioridad de visión, así la
+// detección la desaloja cuando lo necesita. Ante cualquier falla se
+// vuelve a la codificación serial de siempre.
+// ---------------------------------------------------------------------------
+#define JPEG_MCU_FILAS 16 // Altura de fila de MCU con submuestreo H2V2
+
+static TaskHandle_t s_band_task_handle = NULL;
+static SemaphoreHandle_t s_band_done = NULL;
+static jpeg_slot_t s_band_scratch;   // Solo data/cap/len; nunca se publica
+static camera_fb_t *s_band_fb = NULL;
+static uint16_t s_band_y = 0;
+static uint16_t s_band_h = 0;
+static volatile bool s_band_ok = false;
+
+/**
+ * @brief Tarea auxiliar: codifica la banda inferior (Core 1)
+ *
+ * Duerme hasta que la etapa de Core 0 le notifica un frame; el frame
+ * queda prestado solo durante la codificación y la etapa no lo
+ * devuelve al driver hasta recibir el semáforo de fin.
+ */
+static void jpeg_band_task_function(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Tarea de banda JPEG iniciada en Core %d", xPortGetCoreID());
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        s_band_scratch.len = 0;
+        s_band_ok = frame2jpg_cb_band(s_band_fb, 80, s_band_y, s_band_h,
+                                      false, true, jpeg_slot_writer, &s_band_scratch);
+        xSemaphoreGive(s_band_done);
+    }
+}
+
+/**
+ * @brief Codifica un frame en dos bandas, una por core
+ *
+ * La banda superior se lleva la fila de MCU extra cuando la cuenta es
+ * impar: el intervalo de reinicio declarado en los headers es el de la
+ * primera banda y la norma solo permite que el intervalo final sea más
+ * corto. Devuelve false si la codificación en bandas no aplica o
+ * falló; el llamador reintenta con frame2jpg_cb() sobre el slot.
+ */
+static bool encode_frame_banded(camera_fb_t *fb, jpeg_slot_t *slot)
+{
+    if (s_band_task_handle == NULL || fb->format != PIXFORMAT_RGB565 ||
+        fb->height < 2 * JPEG_MCU_FILAS)
+    {
+        return false;
+    }
+
+    int filas_mcu = ((int)fb->height + JPEG_MCU_FILAS - 1) / JPEG_MCU_FILAS;
+    uint16_t band0_h = (uint16_t)(((filas_mcu + 1) / 2) * JPEG_MCU_FILAS);
+    if (band0_h >= fb->height)
+    {
+        return false;
+    }
+
+    // Despachar la banda inferior al Core 1 y codificar la superior acá
+    s_band_fb = fb;
+    s_band_y = band0_h;
+    s_band_h = (uint16_t)(fb->height - band0_h);
+    xTaskNotifyGive(s_band_task_handle);
+
+    bool band0_ok = frame2jpg_cb_band(fb, 80, 0, band0_h, true, false,
+                                      jpeg_slot_writer, slot);
+
+    // Esperar siempre a la tarea auxiliar: el frame no puede volver al
+    // driver mientras ella lo lea (la codificación es CPU pura, acota)
+    xSemaphoreTake(s_band_done, portMAX_DELAY);
+
+    if (!band0_ok || !s_band_ok)
+    {
+        return false;
+    }
+
+    return jpeg_slot_writer(slot, slot->len, s_band_scratch.data,
+                            s_band_scratch.len) == s_band_scratch.len;
+}
+
 /**
- * @brief Convierte camera_fb_t a JPEG
+ * @brief Etapa de codificación y envío (Core 0)
+ *
+ * Consume frame buffers de la cola, los codifica a JPEG y los envía
+ * por WebSocket. Con frame2jpg() fuera de la tarea de visión, la
+ * detección del frame siguiente arranca mientras éste se codifica.
+ * La etapa es dueña del buffer recibido y lo devuelve al driver.
  */
-static bool frame_to_jpeg(camera_fb_t *fb, uint8_t **jpeg_data, size_t *jpeg_len)
+static void encode_task_function(void *pvParameters)
 {
-    // Usar la función de esp32-camera para convertir frame a JPEG
-    return frame2jpg(fb, 80, jpeg_data, jpeg_len);
+    ESP_LOGI(TAG, "Etapa de codificación iniciada en Core %d", xPortGetCoreID());
+
+    uint32_t last_busy_ms = 0;
+
+    while (1)
+    {
+        camera_fb_t *fb = NULL;
+
+        // Espera acotada: el timeout es donde se detecta que el pool
+        // lleva rato ocioso y puede devolver su memoria al heap
+        if (xQueueReceive(frame_queue, &fb, pdMS_TO_TICKS(1000)) != pdTRUE ||
+            fb == NULL)
+        {
+            jpeg_pool_idle_release(&last_busy_ms);
+            continue;
+        }
+        last_busy_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+        // Momento de captura en el reloj de esp_timer (el que viaja en
+        // la cabecera de frame): el driver marca fb->timestamp con
+        // gettimeofday, así que se convierte restando la edad del frame
+        // medida contra ese mismo reloj
+        struct timeval now_tv;
+        gettimeofday(&now_tv, NULL);
+        int64_t frame_age_us =
+            ((int64_t)now_tv.tv_sec - fb->timestamp.tv_sec) * 1000000LL +
+            (now_tv.tv_usec - fb->timestamp.tv_usec);
+        if (frame_age_us < 0)
+        {
+            frame_age_us = 0;
+        }
+        uint32_t capture_ms =
+            (uint32_t)((esp_timer_get_time() - frame_age_us) / 1000);
+
+        // Elegir un slot libre del pool: ni prestado ni el publicado
+        // (el publicado puede estar a punto de ser tomado)
+        jpeg_slot_t *slot = NULL;
+        xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+        for (int i = 0; i < VISION_JPEG_POOL_SLOTS; i++)
+        {
+            if (s_jpeg_pool[i].refs == 0 && i != s_jpeg_latest)
+            {
+                slot = &s_jpeg_pool[i];
+                break;
+            }
+        }
+        xSemaphoreGive(s_jpeg_mutex);
+
+        if (slot == NULL)
+        {
+            esp_camera_fb_return(fb);
+            atomic_fetch_sub(&s_frames_in_flight, 1);
+            continue;
+        }
+
+        // Aplanar el fondo fuera de la detección antes de codificar;
+        // la tarea de visión ya trabaja sobre el otro buffer del driver
+        roi_suavizar_fondo(fb);
+
+        slot->len = 0;
+        bool converted = encode_frame_banded(fb, slot);
+        if (!converted)
+        {
+            slot->len = 0;
+            converted = frame2jpg_cb(fb, 80, jpeg_slot_writer, slot);
+        }
+        esp_camera_fb_return(fb);
+        atomic_fetch_sub(&s_frames_in_flight, 1);
+
+        if (!converted)
+        {
+            continue;
+        }
+
+        // Publicar: esta única codificación sirve al stream MJPEG de
+        // webserver.c y al envío por WebSocket (que copia al encolar)
+        xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+        slot->seq = ++s_jpeg_seq;
+        slot->ts_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        s_jpeg_latest = (int)(slot - s_jpeg_pool);
+        xSemaphoreGive(s_jpeg_mutex);
+
+        ws_server_send_video_frame(FRAME_SOURCE_ESP32S3, slot->data, slot->len,
+                                   capture_ms);
+    }
 }
 
 /**
@@ -33,16 +450,49 @@ static void vision_task_function(void *pvParameters)
 {
     ESP_LOGI(TAG, "Tarea de visión iniciada en Core %d", xPortGetCoreID());
 
-    // Inicializar matriz de homografía
-    homography_load_default(&h_matrix, 640, 480, 100.0f, 80.0f);
+    // Inicializar matriz de homografía: la calibración persistida en
+    // NVS tiene prioridad; sin ella se usa el default cenital
+    if (homography_load_nvs(&h_matrix) != ESP_OK)
+    {
+        homography_load_default(&h_matrix, 640, 480, 100.0f, 80.0f);
+    }
+
+    // Tabular el transform una vez; las consultas de cada detección
+    // pasan a ser dos cargas y una interpolación
+    homography_grid_build(&h_matrix, 640, 480);
+
+    // La arena es casi estática: los escaneos de frame completo (el de
+    // mantenimiento y la búsqueda tras perder el seguimiento) reutilizan
+    // los parciales por tile de la muestra anterior
+    vision_set_incremental_detection(true);
+
+    // Sesiones largas: seguir la deriva de iluminación para no depender
+    // de recalibraciones manuales del rango de color
+    vision_set_hue_drift_compensation(true);
 
     uint32_t frame_count = 0;
     uint32_t last_fps_time = esp_timer_get_time() / 1000;
+    uint32_t last_keepalive_ms = 0;
+    TickType_t last_wake = xTaskGetTickCount();
 
     while (1)
     {
-        // Capturar frame
-        camera_fb_t *fb = esp_camera_fb_get();
+        // Cambio de perfil pendiente: aplicarlo acá, donde esta tarea
+        // no sostiene ningún fb y el codificador ya devolvió los suyos
+        // (el deinit del driver libera todos los frame buffers)
+        if (camera_profile_pending() && atomic_load(&s_frames_in_flight) == 0)
+        {
+            if (camera_apply_pending_profile() != ESP_OK)
+            {
+                ESP_LOGE(TAG, "No se pudo aplicar el perfil de captura");
+                vTaskDelay(pdMS_TO_TICKS(1000));
+                continue;
+            }
+        }
+
+        // Capturar frame vía el wrapper: cuenta frames consumidos,
+        // descartes del driver y la edad captura->fb_get para /stats
+        camera_fb_t *fb = camera_capture();
         if (!fb)
         {
             ESP_LOGE(TAG, "Error capturando frame");
@@ -52,35 +502,132 @@ static void vision_task_function(void *pvParameters)
 
         detection_result_t detection = {0};
 
-        // Procesar detección si está habilitado
-        if (processing_enabled && fb->format == PIXFORMAT_RGB565)
+        // Procesar detección solo si alguien consume el resultado: sin
+        // vehículo registrado la detección baja a un escaneo de
+        // mantenimiento a 1 FPS (conserva la ventana de seguimiento
+        // templada para cuando un vehículo se conecte) en lugar de
+        // quemar el presupuesto de visión calentando la sala
+        bool run_detection = processing_enabled && fb->format == PIXFORMAT_RGB565;
+        if (run_detection && !ws_server_has_vehicles())
         {
+            uint32_t now_ms = esp_timer_get_time() / 1000;
+            if (now_ms - last_keepalive_ms < VISION_KEEPALIVE_PERIOD_MS)
+            {
+                run_detection = false;
+            }
+            else
+            {
+                last_keepalive_ms = now_ms;
+            }
+        }
+
+        if (run_detection)
+        {
+            TRACE_REGION_ENTER(TRACE_ID_DETECTION);
+
+            // El scratch de las etapas de detección vive lo que dura
+            // este frame
+            mem_arena_reset();
+
+            // Sembrar la ventana de búsqueda desde la última detección
+            search_window_t window;
+            const search_window_t *window_ptr = NULL;
+            if (track_window_valid &&
+                track_window_half < (int)fb->width)
+            {
+                window.x_min = track_window_cx - track_window_half;
+                window.x_max = track_window_cx + track_window_half;
+                window.y_min = track_window_cy - track_window_half;
+                window.y_max = track_window_cy + track_window_half;
+                window_ptr = &window;
+            }
+
             // Detectar objeto con transformación homográfica
-            detect_object_by_color(
+            const color_range_t *const ranges[1] = {current_color};
+            detect_objects_multi_color_window(
                 (uint16_t *)fb->buf,
                 fb->width,
                 fb->height,
-                current_color,
+                ranges,
+                1,
+                window_ptr,
                 &h_matrix,
                 &detection);
+
+            if (detection.detected)
+            {
+                // Alimentar el estimador de trayectoria con la muestra
+                // de mundo de este frame
+                trajectory_update(current_color_id,
+                                  detection.world_coords,
+                                  (uint32_t)(esp_timer_get_time() / 1000));
+
+                // Publicar la metadata a los dashboards: decenas de
+                // bytes por frame en lugar de video anotado
+                ws_server_send_detection(FRAME_SOURCE_ESP32S3,
+                                         current_color_id,
+                                         detection.centroid_x,
+                                         detection.centroid_y,
+                                         detection.bbox_x_min,
+                                         detection.bbox_y_min,
+                                         detection.bbox_x_max,
+                                         detection.bbox_y_max,
+                                         detection.world_coords.x,
+                                         detection.world_coords.y);
+
+                // Recentrar y contraer la ventana sobre el objeto
+                track_window_valid = true;
+                track_window_cx = detection.centroid_x;
+                track_window_cy = detection.centroid_y;
+                track_window_half = TRACK_WINDOW_HALF_PX;
+            }
+            else if (track_window_valid)
+            {
+                // Fallo: ampliar la ventana; al superar el frame se
+                // vuelve al escaneo completo
+                track_window_half *= 2;
+                if (track_window_half >= TRACK_WINDOW_MAX_HALF_PX)
+                {
+                    track_window_valid = false;
+                    track_window_half = TRACK_WINDOW_HALF_PX;
+                }
+            }
+
+            // Publicar la muestra (con o sin objeto) para las
+            // consultas HTTP de solo lectura
+            xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+            s_last_detection = detection;
+            s_last_detection_ts_ms = (uint32_t)(esp_timer_get_time() / 1000);
+            s_last_detection_valid = true;
+            xSemaphoreGive(s_jpeg_mutex);
+
+            s_det_samples_total++;
+            if (detection.detected)
+            {
+                s_det_hits_total++;
+            }
+
+            TRACE_REGION_EXIT(TRACE_ID_DETECTION);
         }
 
-        // Convertir frame a JPEG si hay clientes conectados
-        if (ws_server_has_clients())
+        // Entregar el frame a la etapa de codificación si hay clientes.
+        // Envío sin espera: si el codificador sigue ocupado con el frame
+        // anterior, éste se descarta y la detección no se frena
+        bool handed_off = false;
+        if (ws_server_has_clients() || s_http_viewers > 0)
         {
-            uint8_t *jpeg_data = NULL;
-            size_t jpeg_len = 0;
-
-            if (frame_to_jpeg(fb, &jpeg_data, &jpeg_len))
+            handed_off = (xQueueSend(frame_queue, &fb, 0) == pdTRUE);
+            if (handed_off)
             {
-                // Enviar frame por WebSocket (asíncrono)
-                ws_server_send_video_frame(FRAME_SOURCE_ESP32S3, jpeg_data, jpeg_len);
-                free(jpeg_data);
+                atomic_fetch_add(&s_frames_in_flight, 1);
             }
         }
 
-        // Liberar frame buffer
-        esp_camera_fb_return(fb);
+        // Liberar frame buffer si no se transfirió la propiedad
+        if (!handed_off)
+        {
+            esp_camera_fb_return(fb);
+        }
 
         // Calcular FPS
         frame_count++;
@@ -95,13 +642,62 @@ static void vision_task_function(void *pvParameters)
             last_fps_time = now;
         }
 
-        // Pequeña pausa para no saturar
-        vTaskDelay(pdMS_TO_TICKS(33)); // ~30 FPS máximo
+        // Cadencia determinística: vTaskDelayUntil absorbe el tiempo que
+        // costó capturar+detectar, así el período entre muestras es
+        // estable y las velocidades derivadas de coordenadas de mundo
+        // tienen una base de tiempo confiable. El delay fijo de 33 ms
+        // anterior dejaba el FPS real vagando entre ~15 y ~30
+        int fps = (ws_server_get_clients_count() > 0 || s_http_viewers > 0)
+                      ? target_fps
+                      : VISION_IDLE_FPS;
+        TickType_t period = pdMS_TO_TICKS(1000 / fps);
+
+        if (!xTaskDelayUntil(&last_wake, period))
+        {
+            // El frame tardó más que el período: no acumular atraso
+            last_wake = xTaskGetTickCount();
+        }
     }
 
     vTaskDelete(NULL);
 }
 
+/**
+ * Proveedor de métricas del pipeline de visión: muestras y aciertos de
+ * detección, frames codificados y estado de la última detección (edad
+ * y tamaño del blob) para el scraper de la LAN.
+ */
+static void vision_metrics_provider(metrics_writer_t *w)
+{
+    metrics_printf(w,
+                   "# TYPE minitesla_vision_samples_total counter\n"
+                   "minitesla_vision_samples_total %lu\n"
+                   "# TYPE minitesla_vision_hits_total counter\n"
+                   "minitesla_vision_hits_total %lu\n"
+                   "# TYPE minitesla_vision_encoded_total counter\n"
+                   "minitesla_vision_encoded_total %lu\n",
+                   (unsigned long)s_det_samples_total,
+                   (unsigned long)s_det_hits_total,
+                   (unsigned long)s_jpeg_seq);
+
+    detection_result_t det;
+    uint32_t ts_ms = 0;
+    if (vision_task_get_detection(&det, &ts_ms) == ESP_OK)
+    {
+        uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        metrics_printf(w,
+                       "# TYPE minitesla_vision_detected gauge\n"
+                       "minitesla_vision_detected %d\n"
+                       "# TYPE minitesla_vision_detection_age_ms gauge\n"
+                       "minitesla_vision_detection_age_ms %lu\n"
+                       "# TYPE minitesla_vision_pixel_count gauge\n"
+                       "minitesla_vision_pixel_count %lu\n",
+                       det.detected ? 1 : 0,
+                       (unsigned long)(now_ms >= ts_ms ? now_ms - ts_ms : 0),
+                       (unsigned long)det.pixel_count);
+    }
+}
+
 esp_err_t vision_task_start(void)
 {
     if (vision_task_handle != NULL)
@@ -110,16 +706,81 @@ esp_err_t vision_task_start(void)
         return ESP_OK;
     }
 
-    // Crear cola para frames procesados
-    frame_queue = xQueueCreate(VISION_QUEUE_SIZE, sizeof(processed_frame_t));
+    // Una sola vez: el pipeline puede reiniciarse con stop/start
+    static bool s_metrics_registered = false;
+    if (!s_metrics_registered)
+    {
+        s_metrics_registered = (metrics_register(vision_metrics_provider) == ESP_OK);
+    }
+
+    // Arena de scratch por frame para las etapas de detección; sin
+    // ella el refinado de blobs degrada al centroide grueso
+    if (mem_arena_init(12 * 1024, 16 * 1024) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Sin arena de scratch - detección degradada");
+    }
+
+    // Proteger el pool de JPEGs compartido entre codificador y HTTP
+    if (s_jpeg_mutex == NULL)
+    {
+        s_jpeg_mutex = xSemaphoreCreateMutex();
+        if (s_jpeg_mutex == NULL)
+        {
+            ESP_LOGE(TAG, "Error creando mutex del pool JPEG");
+            return ESP_FAIL;
+        }
+    }
+
+    // Crear cola de transferencia de frame buffers hacia el codificador
+    frame_queue = xQueueCreate(VISION_QUEUE_SIZE, sizeof(camera_fb_t *));
     if (frame_queue == NULL)
     {
         ESP_LOGE(TAG, "Error creando cola de frames");
         return ESP_FAIL;
     }
 
-    // Crear tarea en Core 1 (Application CPU)
+    // Crear etapa de codificación en Core 0 (Protocol CPU)
     BaseType_t result = xTaskCreatePinnedToCore(
+        encode_task_function,
+        "encode_task",
+        ENCODE_TASK_STACK_SIZE,
+        NULL,
+        ENCODE_TASK_PRIORITY,
+        &encode_task_handle,
+        ENCODE_TASK_CORE_ID);
+
+    if (result != pdPASS)
+    {
+        ESP_LOGE(TAG, "Error creando etapa de codificación");
+        vQueueDelete(frame_queue);
+        frame_queue = NULL;
+        return ESP_FAIL;
+    }
+
+    // Crear tarea auxiliar de bandas en Core 1; si falla no es fatal,
+    // la etapa de codificación sigue funcionando en serie
+    if (s_band_done == NULL)
+    {
+        s_band_done = xSemaphoreCreateBinary();
+    }
+    if (s_band_done != NULL && s_band_task_handle == NULL)
+    {
+        if (xTaskCreatePinnedToCore(
+                jpeg_band_task_function,
+                "jpeg_band_task",
+                JPEG_BAND_TASK_STACK_SIZE,
+                NULL,
+                JPEG_BAND_TASK_PRIORITY,
+                &s_band_task_handle,
+                JPEG_BAND_TASK_CORE_ID) != pdPASS)
+        {
+            s_band_task_handle = NULL;
+            ESP_LOGW(TAG, "Sin tarea de banda JPEG - codificación serial");
+        }
+    }
+
+    // Crear tarea en Core 1 (Application CPU)
+    result = xTaskCreatePinnedToCore(
         vision_task_function,
         "vision_task",
         VISION_TASK_STACK_SIZE,
@@ -131,15 +792,18 @@ esp_err_t vision_task_start(void)
     if (result != pdPASS)
     {
         ESP_LOGE(TAG, "Error creando tarea de visión");
+        vTaskDelete(encode_task_handle);
+        encode_task_handle = NULL;
         vQueueDelete(frame_queue);
         frame_queue = NULL;
         return ESP_FAIL;
     }
 
     ESP_LOGI(TAG, "╔════════════════════════════════════════════════╗");
-    ESP_LOGI(TAG, "║       Tarea de Visión Iniciada                 ║");
+    ESP_LOGI(TAG, "║       Pipeline de Visión Iniciado              ║");
     ESP_LOGI(TAG, "╠════════════════════════════════════════════════╣");
-    ESP_LOGI(TAG, "║ Core Affinity:  Core 1 (Application CPU)       ║");
+    ESP_LOGI(TAG, "║ Captura+detección: Core 1 (Application CPU)    ║");
+    ESP_LOGI(TAG, "║ Codificación+envío: Core 0 (Protocol CPU)      ║");
     ESP_LOGI(TAG, "║ Prioridad:      %d                              ║", VISION_TASK_PRIORITY);
     ESP_LOGI(TAG, "║ Stack Size:     %d bytes                       ║", VISION_TASK_STACK_SIZE);
     ESP_LOGI(TAG, "╚════════════════════════════════════════════════╝");
@@ -155,12 +819,53 @@ esp_err_t vision_task_stop(void)
         vision_task_handle = NULL;
     }
 
+    if (encode_task_handle)
+    {
+        // Devolver cualquier frame que haya quedado en tránsito
+        camera_fb_t *fb = NULL;
+        while (frame_queue && xQueueReceive(frame_queue, &fb, 0) == pdTRUE)
+        {
+            if (fb)
+            {
+                esp_camera_fb_return(fb);
+            }
+            atomic_fetch_sub(&s_frames_in_flight, 1);
+        }
+
+        vTaskDelete(encode_task_handle);
+        encode_task_handle = NULL;
+    }
+
+    // La tarea de bandas va después del codificador: sin él ya nadie
+    // puede despacharle trabajo
+    if (s_band_task_handle)
+    {
+        vTaskDelete(s_band_task_handle);
+        s_band_task_handle = NULL;
+    }
+    if (s_band_scratch.data)
+    {
+        free(s_band_scratch.data);
+        s_band_scratch.data = NULL;
+        s_band_scratch.cap = 0;
+        s_band_scratch.len = 0;
+    }
+
     if (frame_queue)
     {
         vQueueDelete(frame_queue);
         frame_queue = NULL;
     }
 
+    // Invalidar el frame publicado; los buffers del pool quedan
+    // reservados para el próximo arranque del pipeline
+    if (s_jpeg_mutex)
+    {
+        xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+        s_jpeg_latest = -1;
+        xSemaphoreGive(s_jpeg_mutex);
+    }
+
     ESP_LOGI(TAG, "Tarea de visión detenida");
     return ESP_OK;
 }
@@ -170,23 +875,136 @@ QueueHandle_t vision_task_get_queue(void)
     return frame_queue;
 }
 
+esp_err_t vision_task_jpeg_acquire(uint32_t last_seq, uint32_t wait_ms,
+                                   vision_jpeg_frame_t *out)
+{
+    if (out == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_jpeg_mutex == NULL || encode_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(wait_ms);
+
+    while (1)
+    {
+        xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+        if (s_jpeg_latest >= 0 && s_jpeg_pool[s_jpeg_latest].seq != last_seq)
+        {
+            jpeg_slot_t *slot = &s_jpeg_pool[s_jpeg_latest];
+            slot->refs++;
+            out->data = slot->data;
+            out->len = slot->len;
+            out->seq = slot->seq;
+            out->ts_ms = slot->ts_ms;
+            xSemaphoreGive(s_jpeg_mutex);
+            return ESP_OK;
+        }
+        xSemaphoreGive(s_jpeg_mutex);
+
+        if ((int32_t)(deadline - xTaskGetTickCount()) <= 0)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        // El codificador publica a ritmo de cámara; sondear cada pocos
+        // ms cuesta menos que mantener una lista de esperas por cliente
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+
+void vision_task_jpeg_release(const vision_jpeg_frame_t *frame)
+{
+    if (frame == NULL || frame->data == NULL || s_jpeg_mutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+    for (int i = 0; i < VISION_JPEG_POOL_SLOTS; i++)
+    {
+        if (s_jpeg_pool[i].data == frame->data && s_jpeg_pool[i].refs > 0)
+        {
+            s_jpeg_pool[i].refs--;
+            break;
+        }
+    }
+    xSemaphoreGive(s_jpeg_mutex);
+}
+
+void vision_task_viewer_ref(void)
+{
+    if (s_jpeg_mutex != NULL)
+    {
+        xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+        s_http_viewers++;
+        xSemaphoreGive(s_jpeg_mutex);
+    }
+}
+
+esp_err_t vision_task_get_detection(detection_result_t *out, uint32_t *ts_ms)
+{
+    if (out == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_jpeg_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t res = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+    if (s_last_detection_valid)
+    {
+        *out = s_last_detection;
+        if (ts_ms != NULL)
+        {
+            *ts_ms = s_last_detection_ts_ms;
+        }
+        res = ESP_OK;
+    }
+    xSemaphoreGive(s_jpeg_mutex);
+    return res;
+}
+
+void vision_task_viewer_unref(void)
+{
+    if (s_jpeg_mutex != NULL)
+    {
+        xSemaphoreTake(s_jpeg_mutex, portMAX_DELAY);
+        if (s_http_viewers > 0)
+        {
+            s_http_viewers--;
+        }
+        xSemaphoreGive(s_jpeg_mutex);
+    }
+}
+
 esp_err_t vision_task_set_target_color(const char *color_name)
 {
     if (strcmp(color_name, "RED") == 0)
     {
         current_color = &COLOR_RED;
+        current_color_id = 0;
     }
     else if (strcmp(color_name, "GREEN") == 0)
     {
         current_color = &COLOR_GREEN;
+        current_color_id = 1;
     }
     else if (strcmp(color_name, "BLUE") == 0)
     {
         current_color = &COLOR_BLUE;
+        current_color_id = 2;
     }
     else if (strcmp(color_name, "YELLOW") == 0)
     {
         current_color = &COLOR_YELLOW;
+        current_color_id = 3;
     }
     else
     {
@@ -194,6 +1012,12 @@ esp_err_t vision_task_set_target_color(const char *color_name)
         return ESP_FAIL;
     }
 
+    // Descartar la ventana de seguimiento y la trayectoria del color
+    // anterior
+    track_window_valid = false;
+    track_window_half = TRACK_WINDOW_HALF_PX;
+    trajectory_reset(-1);
+
     ESP_LOGI(TAG, "Color objetivo cambiado a: %s", color_name);
     return ESP_OK;
 }
@@ -203,3 +1027,35 @@ void vision_task_enable_processing(bool enable)
     processing_enabled = enable;
     ESP_LOGI(TAG, "Procesamiento de visión %s", enable ? "HABILITADO" : "DESHABILITADO");
 }
+
+esp_err_t vision_task_calibrate_homography(const pixel_point_t src_points[4],
+                                           const world_point_t dst_points[4])
+{
+    homography_matrix_t candidate;
+
+    if (!homography_calculate(&candidate, src_points, dst_points))
+    {
+        ESP_LOGE(TAG, "Calibración rechazada: puntos degenerados");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Publicar la nueva matriz, retabular la grilla y persistir para
+    // el próximo arranque
+    h_matrix = candidate;
+    homography_grid_build(&h_matrix, 640, 480);
+    return homography_save_nvs(&h_matrix);
+}
+
+esp_err_t vision_task_set_target_fps(int fps)
+{
+    if (fps < VISION_FPS_MIN || fps > VISION_FPS_MAX)
+    {
+        ESP_LOGE(TAG, "FPS objetivo fuera de rango: %d (válido %d-%d)",
+                 fps, VISION_FPS_MIN, VISION_FPS_MAX);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    target_fps = fps;
+    ESP_LOGI(TAG, "FPS objetivo: %d", fps);
+    return ESP_OK;
+}
@@ -5,6 +5,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "vision/homography.h"
+#include "vision/vision.h"
 
 /**
  * @brief Configuración de la tarea de visión
@@ -14,39 +16,92 @@
 #define VISION_TASK_CORE_ID (1)  // Core 1 (Application CPU)
 
 /**
- * @brief Cola para frames procesados
+ * @brief Cadencia del bucle de visión
+ */
+#define VISION_TARGET_FPS_DEFAULT (30)
+#define VISION_FPS_MIN (1)
+#define VISION_FPS_MAX (60)
+#define VISION_IDLE_FPS (5) // Sin clientes WebSocket conectados
+
+/**
+ * @brief Período del escaneo de mantenimiento sin vehículos registrados
+ */
+#define VISION_KEEPALIVE_PERIOD_MS (1000)
+
+/**
+ * @brief Configuración de la etapa de codificación (consumidor)
+ */
+#define ENCODE_TASK_STACK_SIZE (8192)
+#define ENCODE_TASK_PRIORITY (4)
+#define ENCODE_TASK_CORE_ID (0)  // Core 0 (Protocol CPU)
+
+/**
+ * @brief Tarea auxiliar de codificación en bandas (Core 1)
+ *
+ * Codifica la banda inferior del frame en paralelo con la banda
+ * superior que codifica la etapa de Core 0; los segmentos se unen con
+ * un marcador de reinicio JPEG. Corre por debajo de la prioridad de
+ * visión, así solo consume los huecos libres del Core 1.
+ */
+#define JPEG_BAND_TASK_STACK_SIZE (8192)
+#define JPEG_BAND_TASK_PRIORITY (3)
+#define JPEG_BAND_TASK_CORE_ID (1) // Core 1 (Application CPU)
+
+/**
+ * @brief Cola de transferencia de frames capturados
+ *
+ * Lleva punteros camera_fb_t* del productor (captura + detección en
+ * Core 1) al consumidor (codificación JPEG + envío en Core 0). El
+ * consumidor pasa a ser dueño del buffer y lo devuelve al driver.
  */
 #define VISION_QUEUE_SIZE (2)
 
 /**
- * @brief Estructura de frame procesado para streaming
+ * @brief Pool de frames JPEG codificados
+ *
+ * La etapa de codificación publica cada JPEG en un pool de buffers
+ * reutilizables; el stream MJPEG por HTTP (webserver.c) y el envío por
+ * WebSocket se sirven del mismo resultado, así cada frame se codifica
+ * exactamente una vez sin importar cuántos consumidores haya.
  */
-typedef struct {
-    uint8_t *jpeg_data;
-    size_t jpeg_len;
-    uint32_t timestamp_ms;
-} processed_frame_t;
+#define VISION_JPEG_POOL_SLOTS (3)
 
 /**
- * @brief Inicia la tarea de visión en Core 1
- * 
- * Esta tarea ejecuta el bucle de captura de cámara, procesamiento
- * de detección y generación de frames JPEG para streaming.
- * 
+ * @brief Frame JPEG prestado del pool del codificador
+ *
+ * data apunta al buffer interno del pool (no liberar con free);
+ * mientras el frame esté prestado su slot no se reutiliza. Devolverlo
+ * siempre con vision_task_jpeg_release().
+ */
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    uint32_t seq;   // Correlativo de frames codificados
+    uint32_t ts_ms; // Fin de la codificación (esp_timer, ms)
+} vision_jpeg_frame_t;
+
+/**
+ * @brief Inicia el pipeline de visión en ambos cores
+ *
+ * Captura y detección corren en Core 1; la codificación JPEG y el
+ * envío por WebSocket corren en Core 0, alimentados por la cola de
+ * frames. Así frame2jpg() nunca bloquea la detección siguiente.
+ *
  * @return ESP_OK si se inició correctamente
  */
 esp_err_t vision_task_start(void);
 
 /**
- * @brief Detiene la tarea de visión
- * 
+ * @brief Detiene el pipeline de visión (ambas tareas)
+ *
  * @return ESP_OK si se detuvo correctamente
  */
 esp_err_t vision_task_stop(void);
 
 /**
- * @brief Obtiene la cola de frames procesados
- * 
+ * @brief Obtiene la cola de frames en tránsito hacia el codificador
+ *
  * @return Handle de la cola
  */
 QueueHandle_t vision_task_get_queue(void);
@@ -66,4 +121,69 @@ esp_err_t vision_task_set_target_color(const char *color_name);
  */
 void vision_task_enable_processing(bool enable);
 
+/**
+ * @brief Configura el FPS objetivo del bucle de visión
+ *
+ * El bucle usa vTaskDelayUntil con este período, así el tiempo entre
+ * muestras es estable independientemente de lo que tarde cada frame.
+ * Sin clientes conectados el bucle baja automáticamente a
+ * VISION_IDLE_FPS.
+ *
+ * @param fps FPS deseado (VISION_FPS_MIN a VISION_FPS_MAX)
+ * @return ESP_OK si el valor es válido
+ */
+esp_err_t vision_task_set_target_fps(int fps);
+
+/**
+ * @brief Recalibra la homografía en campo con 4 correspondencias
+ *
+ * Resuelve el DLT en el chip, publica la matriz para las próximas
+ * detecciones y la persiste en NVS para el arranque siguiente.
+ *
+ * @param src_points 4 puntos en la imagen (píxeles)
+ * @param dst_points 4 puntos correspondientes en el mundo (cm)
+ * @return ESP_OK si la calibración se aplicó y persistió
+ */
+esp_err_t vision_task_calibrate_homography(const pixel_point_t src_points[4],
+                                           const world_point_t dst_points[4]);
+
+/**
+ * @brief Toma prestado el último frame JPEG más nuevo que last_seq
+ *
+ * Espera hasta wait_ms un frame con seq distinto del indicado (usar 0
+ * en la primera llamada).
+ *
+ * @return ESP_OK con *out válido, ESP_ERR_TIMEOUT si no llegó un frame
+ *         nuevo, ESP_ERR_INVALID_STATE si el pipeline no está corriendo
+ */
+esp_err_t vision_task_jpeg_acquire(uint32_t last_seq, uint32_t wait_ms,
+                                   vision_jpeg_frame_t *out);
+
+/**
+ * @brief Devuelve al pool un frame tomado con vision_task_jpeg_acquire()
+ */
+void vision_task_jpeg_release(const vision_jpeg_frame_t *frame);
+
+/**
+ * @brief Registra/da de baja un consumidor HTTP del stream MJPEG
+ *
+ * Con al menos un consumidor registrado el pipeline entrega frames a
+ * la etapa de codificación aunque no haya clientes WebSocket.
+ */
+void vision_task_viewer_ref(void);
+void vision_task_viewer_unref(void);
+
+/**
+ * @brief Última detección publicada por el pipeline
+ *
+ * Copia el resultado más reciente (haya o no objeto detectado) y el
+ * timestamp de la muestra. Consultar este estado es O(1); no dispara
+ * ningún pase extra de captura ni de detección.
+ *
+ * @param out Resultado de la última detección
+ * @param ts_ms Timestamp de la muestra (esp_timer, ms; puede ser NULL)
+ * @return ESP_OK, ESP_ERR_NOT_FOUND si aún no corrió ninguna detección
+ */
+esp_err_t vision_task_get_detection(detection_result_t *out, uint32_t *ts_ms);
+
 #endif // VISION_TASK_H
@@ -1,46 +1,30 @@
 #include "webserver.h"
-#include "../camera_driver/camera_driver.h"
 #include "../vision/vision.h"
+#include "../vision_task/vision_task.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
-#include "esp_camera.h"
+#include "esp_timer.h"
 #include <string.h>
+#include <stdlib.h>
 
 static const char *TAG = "Webserver";
 static httpd_handle_t server = NULL;
 
-// Variable global para configurar qué color detectar
-static const color_range_t *current_color_range = &COLOR_GREEN; // Por defecto verde
-
-// Función auxiliar para convertir RGB565 a JPEG
-static bool rgb565_to_jpeg(camera_fb_t *fb, uint8_t **jpg_buf, size_t *jpg_len, int quality)
+/**
+ * Parámetro de query max_age=<ms>: edad máxima aceptada para una
+ * respuesta cacheada. Sin el parámetro se sirve el último snapshot
+ * disponible sin importar su edad.
+ */
+static uint32_t query_max_age_ms(httpd_req_t *req)
 {
-    if (!fb || fb->format != PIXFORMAT_RGB565)
+    const char *arg = strstr(req->uri, "max_age=");
+    if (!arg)
     {
-        return false;
+        return UINT32_MAX;
     }
 
-    // Allocate temporary buffer for JPEG
-    size_t jpg_buf_len = fb->width * fb->height / 5; // Estimación
-    uint8_t *jpg = (uint8_t *)malloc(jpg_buf_len);
-    if (!jpg)
-    {
-        ESP_LOGE(TAG, "Failed to allocate JPEG buffer");
-        return false;
-    }
-
-    // Convert RGB565 to JPEG using frame2jpg (función del componente esp32-camera)
-    bool converted = frame2jpg(fb, quality, &jpg, jpg_len);
-
-    if (!converted)
-    {
-        free(jpg);
-        ESP_LOGE(TAG, "RGB565 to JPEG conversion failed");
-        return false;
-    }
-
-    *jpg_buf = jpg;
-    return true;
+    int value = atoi(arg + strlen("max_age="));
+    return (value < 0) ? 0 : (uint32_t)value;
 }
 
 // HTML page with embedded JavaScript for video streaming
@@ -122,17 +106,27 @@ static esp_err_t index_handler(httpd_req_t *req)
 }
 
 /**
- * Handler for MJPEG stream (supports RGB565 con detección de objetos)
+ * Handler for MJPEG stream
+ *
+ * Servido desde el pool de JPEGs del pipeline de visión: la etapa de
+ * codificación convierte cada frame una sola vez y este handler solo
+ * pide prestado el último resultado. Antes cada cliente del stream
+ * capturaba, detectaba y codificaba por su cuenta, duplicando todo el
+ * trabajo del pipeline por espectador.
  */
+#define STREAM_ACQUIRE_WAIT_MS 1000
+#define STREAM_MAX_IDLE_TIMEOUTS 5 // Sin frames durante 5 s: liberar el worker
+#define STREAM_BASE_FRAME_US (1000000 / 30) // Ritmo máximo hacia el cliente
+
 static esp_err_t stream_handler(httpd_req_t *req)
 {
-    camera_fb_t *fb = NULL;
     esp_err_t res = ESP_OK;
-    size_t jpg_buf_len = 0;
-    uint8_t *jpg_buf = NULL;
     char part_buf[128];
-    bool needs_free = false;
-    detection_result_t detection;
+    uint32_t last_seq = 0;
+    int idle_timeouts = 0;
+    int64_t send_avg_us = 0; // EWMA del tiempo de envío completado
+    uint32_t frames_sent = 0;
+    uint32_t frames_skipped = 0;
 
     ESP_LOGI(TAG, "Stream requested");
 
@@ -143,201 +137,195 @@ static esp_err_t stream_handler(httpd_req_t *req)
         return res;
     }
 
+    // Con un espectador registrado el pipeline entrega frames al
+    // codificador aunque no haya clientes WebSocket
+    vision_task_viewer_ref();
+
     while (true)
     {
-        fb = camera_capture();
-        if (!fb)
+        vision_jpeg_frame_t frame;
+        esp_err_t acquire = vision_task_jpeg_acquire(last_seq,
+                                                     STREAM_ACQUIRE_WAIT_MS,
+                                                     &frame);
+        if (acquire == ESP_ERR_TIMEOUT)
         {
-            ESP_LOGE(TAG, "Camera capture failed");
-            res = ESP_FAIL;
-            break;
-        }
-
-        // Realizar detección si el formato es RGB565
-        if (fb->format == PIXFORMAT_RGB565)
-        {
-            detect_object_by_color((uint16_t *)fb->buf, fb->width, fb->height,
-                                   current_color_range, NULL, &detection);
-
-            if (detection.detected)
-            {
-                ESP_LOGI(TAG, "Object detected! Centroid: (%d, %d), Pixels: %lu",
-                         detection.centroid_x, detection.centroid_y, detection.pixel_count);
-            }
-        }
-
-        // Handle different pixel formats
-        if (fb->format == PIXFORMAT_JPEG)
-        {
-            jpg_buf = fb->buf;
-            jpg_buf_len = fb->len;
-            needs_free = false;
-        }
-        else if (fb->format == PIXFORMAT_RGB565)
-        {
-            // Convert RGB565 to JPEG
-            if (!rgb565_to_jpeg(fb, &jpg_buf, &jpg_buf_len, 80))
+            if (++idle_timeouts >= STREAM_MAX_IDLE_TIMEOUTS)
             {
-                ESP_LOGE(TAG, "Failed to convert RGB565 to JPEG");
-                camera_fb_return(fb);
+                ESP_LOGW(TAG, "No frames from vision pipeline, closing stream");
                 res = ESP_FAIL;
                 break;
             }
-            needs_free = true;
+            continue;
         }
-        else
+        if (acquire != ESP_OK)
         {
-            ESP_LOGE(TAG, "Unsupported pixel format: %d", fb->format);
-            camera_fb_return(fb);
+            ESP_LOGE(TAG, "Vision pipeline not running, cannot stream");
             res = ESP_FAIL;
             break;
         }
 
-        // Send boundary
-        if (res == ESP_OK)
+        idle_timeouts = 0;
+        if (last_seq != 0 && frame.seq > last_seq + 1)
         {
-            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+            frames_skipped += frame.seq - last_seq - 1;
         }
+        last_seq = frame.seq;
+
+        int64_t send_start_us = esp_timer_get_time();
+
+        // Send boundary
+        res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
 
         // Send content type and length
         if (res == ESP_OK)
         {
-            size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, jpg_buf_len);
+            size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, frame.len);
             res = httpd_resp_send_chunk(req, part_buf, hlen);
         }
 
         // Send image data
         if (res == ESP_OK)
         {
-            res = httpd_resp_send_chunk(req, (const char *)jpg_buf, jpg_buf_len);
+            res = httpd_resp_send_chunk(req, (const char *)frame.data, frame.len);
         }
 
-        // Cleanup
-        if (needs_free && jpg_buf)
-        {
-            free(jpg_buf);
-            jpg_buf = NULL;
-        }
-        camera_fb_return(fb);
-        fb = NULL;
+        vision_task_jpeg_release(&frame);
 
         if (res != ESP_OK)
         {
             ESP_LOGW(TAG, "Stream interrupted");
             break;
         }
-    }
 
-    if (fb)
-    {
-        camera_fb_return(fb);
-    }
-    if (needs_free && jpg_buf)
-    {
-        free(jpg_buf);
+        frames_sent++;
+
+        // Adaptación a la velocidad del cliente: el tiempo hasta que el
+        // envío completa mide su ritmo real de drenado (cuando el socket
+        // buffer se llena, el send bloquea y este promedio crece).
+        // Espaciar los frames a ese ritmo antes del próximo acquire hace
+        // que los intermedios se salteen solos — acquire entrega siempre
+        // el más nuevo, la misma semántica que CAMERA_GRAB_LATEST fija
+        // en el extremo de captura — en lugar de encadenar envíos
+        // bloqueantes que retienen el worker de httpd.
+        int64_t send_us = esp_timer_get_time() - send_start_us;
+        send_avg_us += (send_us - send_avg_us) / 4;
+
+        int64_t pace_us = (send_avg_us > STREAM_BASE_FRAME_US)
+                              ? send_avg_us
+                              : STREAM_BASE_FRAME_US;
+        int64_t remaining_us = pace_us - send_us;
+        if (remaining_us > 1000)
+        {
+            vTaskDelay(pdMS_TO_TICKS(remaining_us / 1000));
+        }
     }
 
-    ESP_LOGI(TAG, "Stream ended");
+    vision_task_viewer_unref();
+
+    ESP_LOGI(TAG, "Stream ended: %lu frames sent, %lu skipped, avg send %lld ms",
+             frames_sent, frames_skipped, send_avg_us / 1000);
     return res;
 }
 
 /**
- * Handler for capture single frame (supports RGB565)
+ * Handler for capture single frame
+ *
+ * Servido del snapshot JPEG más reciente del codificador: una captura
+ * HTTP es una lectura O(1) de estado ya producido, no una pasada
+ * completa de captura + codificación. Con ?max_age=<ms> se espera a
+ * que el pipeline publique un frame más nuevo que esa edad.
  */
+#define CAPTURE_FRESH_WAIT_MS 1000
+
 static esp_err_t capture_handler(httpd_req_t *req)
 {
-    camera_fb_t *fb = NULL;
-    esp_err_t res = ESP_OK;
-    uint8_t *jpg_buf = NULL;
-    size_t jpg_buf_len = 0;
-    bool needs_free = false;
+    uint32_t max_age_ms = query_max_age_ms(req);
+    vision_jpeg_frame_t frame;
 
-    fb = camera_capture();
-    if (!fb)
-    {
-        ESP_LOGE(TAG, "Camera capture failed");
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
-    }
+    // Registrarse como consumidor mientras dura la captura, para que
+    // el pipeline alimente al codificador aunque no haya espectadores
+    vision_task_viewer_ref();
 
-    // Handle different pixel formats
-    if (fb->format == PIXFORMAT_JPEG)
+    esp_err_t res = vision_task_jpeg_acquire(0, CAPTURE_FRESH_WAIT_MS, &frame);
+    if (res == ESP_OK)
     {
-        jpg_buf = fb->buf;
-        jpg_buf_len = fb->len;
-        needs_free = false;
-    }
-    else if (fb->format == PIXFORMAT_RGB565)
-    {
-        // Convert RGB565 to JPEG
-        if (!rgb565_to_jpeg(fb, &jpg_buf, &jpg_buf_len, 90))
+        uint32_t age_ms = (uint32_t)(esp_timer_get_time() / 1000) - frame.ts_ms;
+        if (age_ms > max_age_ms)
         {
-            ESP_LOGE(TAG, "Failed to convert RGB565 to JPEG");
-            camera_fb_return(fb);
-            httpd_resp_send_500(req);
-            return ESP_FAIL;
+            // Snapshot más viejo de lo aceptado: esperar el próximo
+            uint32_t stale_seq = frame.seq;
+            vision_task_jpeg_release(&frame);
+            res = vision_task_jpeg_acquire(stale_seq, CAPTURE_FRESH_WAIT_MS, &frame);
         }
-        needs_free = true;
     }
-    else
+
+    vision_task_viewer_unref();
+
+    if (res != ESP_OK)
     {
-        ESP_LOGE(TAG, "Unsupported pixel format for capture");
-        camera_fb_return(fb);
+        ESP_LOGE(TAG, "No frame available for capture");
         httpd_resp_send_500(req);
         return ESP_FAIL;
     }
 
     httpd_resp_set_type(req, "image/jpeg");
     httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
-    res = httpd_resp_send(req, (const char *)jpg_buf, jpg_buf_len);
-
-    // Cleanup
-    if (needs_free && jpg_buf)
-    {
-        free(jpg_buf);
-    }
-    camera_fb_return(fb);
+    res = httpd_resp_send(req, (const char *)frame.data, frame.len);
 
+    vision_task_jpeg_release(&frame);
     return res;
 }
 
 /**
  * Handler para obtener datos de detección en formato JSON
+ *
+ * Responde con la última detección publicada por el pipeline; un
+ * dashboard sondeando a 2 Hz lee estado cacheado en lugar de disparar
+ * pases síncronos de detección. Con ?max_age=<ms> se espera una
+ * muestra más fresca que esa edad (hasta un límite corto).
  */
+#define DETECTION_FRESH_WAIT_MS 1000
+
 static esp_err_t detection_handler(httpd_req_t *req)
 {
-    camera_fb_t *fb = NULL;
+    uint32_t max_age_ms = query_max_age_ms(req);
     detection_result_t detection;
+    uint32_t ts_ms = 0;
     char json_response[200];
 
-    fb = camera_capture();
-    if (!fb)
-    {
-        ESP_LOGE(TAG, "Camera capture failed");
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
-    }
+    esp_err_t res = vision_task_get_detection(&detection, &ts_ms);
 
-    // Realizar detección solo en RGB565
-    if (fb->format == PIXFORMAT_RGB565)
+    // La detección corre a su propio ritmo; si piden una muestra más
+    // fresca solo queda esperar a que el pipeline publique la próxima
+    if (max_age_ms != UINT32_MAX)
     {
-        detect_object_by_color((uint16_t *)fb->buf, fb->width, fb->height,
-                               current_color_range, NULL, &detection);
+        TickType_t deadline = xTaskGetTickCount() +
+                              pdMS_TO_TICKS(DETECTION_FRESH_WAIT_MS);
+        while ((res != ESP_OK ||
+                (uint32_t)(esp_timer_get_time() / 1000) - ts_ms > max_age_ms) &&
+               (int32_t)(deadline - xTaskGetTickCount()) > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(20));
+            res = vision_task_get_detection(&detection, &ts_ms);
+        }
     }
-    else
+
+    if (res != ESP_OK)
     {
-        detection.detected = false;
+        ESP_LOGE(TAG, "No detection sample available");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
     }
 
-    camera_fb_return(fb);
-
-    // Crear respuesta JSON
+    // Crear respuesta JSON (age_ms delata snapshots viejos al cliente)
+    uint32_t age_ms = (uint32_t)(esp_timer_get_time() / 1000) - ts_ms;
     snprintf(json_response, sizeof(json_response),
-             "{\"detected\":%s,\"x\":%d,\"y\":%d,\"pixels\":%lu}",
+             "{\"detected\":%s,\"x\":%d,\"y\":%d,\"pixels\":%lu,\"age_ms\":%lu}",
              detection.detected ? "true" : "false",
              detection.centroid_x,
              detection.centroid_y,
-             detection.pixel_count);
+             detection.pixel_count,
+             (unsigned long)age_ms);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
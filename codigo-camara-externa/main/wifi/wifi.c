@@ -13,6 +13,15 @@
 
 static const char *TAG = "WiFi";
 
+#if WIFI_LATENCY_PROFILE
+// Ver wifi.h. Buffers de RX al nivel del SoftAP (el video de vuelta a
+// los dashboards sigue pasando por este radio); TX queda en defaults:
+// una cola corta de transmisión es parte del perfil de latencia
+#define WIFI_STA_STATIC_RX_BUF_NUM 16
+#define WIFI_STA_DYNAMIC_RX_BUF_NUM 64
+#define WIFI_STA_LISTEN_INTERVAL 1
+#endif
+
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
 
@@ -76,6 +85,14 @@ esp_err_t wifi_init_sta(void)
     esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+#if WIFI_LATENCY_PROFILE
+    // Perfil de latencia: sin agregación en TX (retiene los paquetes
+    // chicos de control esperando armar un burst) y más buffers de RX
+    cfg.static_rx_buf_num = WIFI_STA_STATIC_RX_BUF_NUM;
+    cfg.dynamic_rx_buf_num = WIFI_STA_DYNAMIC_RX_BUF_NUM;
+    cfg.ampdu_tx_enable = 0;
+    cfg.ampdu_rx_enable = 1;
+#endif
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     esp_event_handler_instance_t instance_any_id;
@@ -101,10 +118,23 @@ esp_err_t wifi_init_sta(void)
                 .required = false},
         },
     };
+#if WIFI_LATENCY_PROFILE
+    // Solo relevante si el power-save se re-habilita en campo: despertar
+    // en cada beacon en vez de acumular varios intervalos de DTIM
+    wifi_config.sta.listen_interval = WIFI_STA_LISTEN_INTERVAL;
+#endif
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
+#if WIFI_LATENCY_PROFILE
+    // El modem sleep por defecto encola cada paquete hasta el próximo
+    // beacon: decenas de ms por salto, inaceptable para teleoperación.
+    // El S3 en este modo está siempre alimentado; se paga en consumo
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
+    ESP_LOGI(TAG, "Perfil de latencia activo: PS off, AMPDU TX off");
+#endif
+
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
     /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
@@ -134,6 +164,23 @@ esp_err_t wifi_init_sta(void)
     }
 }
 
+void wifi_get_latency_profile(wifi_latency_profile_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+#if WIFI_LATENCY_PROFILE
+    out->ps_none = true;
+    out->ampdu_tx = false;
+    out->ampdu_rx = true;
+    out->static_rx_buf_num = WIFI_STA_STATIC_RX_BUF_NUM;
+    out->dynamic_rx_buf_num = WIFI_STA_DYNAMIC_RX_BUF_NUM;
+    out->listen_interval = WIFI_STA_LISTEN_INTERVAL;
+#endif
+}
+
 esp_err_t wifi_get_ip_address(char *ip_str, size_t len)
 {
     if (ip_str == NULL || len < 16)
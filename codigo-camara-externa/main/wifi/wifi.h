@@ -2,6 +2,8 @@
 #define WIFI_H
 
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 // WiFi Configuration - Modifica estos valores con tus credenciales
 #define WIFI_SSID "Personal-140-2.4GHz"
@@ -10,6 +12,51 @@
 // WiFi connection timeout in milliseconds
 #define WIFI_MAXIMUM_RETRY 5
 
+/**
+ * @brief Perfil de latencia del enlace a la LAN del predio
+ *
+ * Espejo de SOFTAP_PERF_PROFILE pero con otro objetivo: el SoftAP
+ * optimiza techo de ancho de banda; acá, cuando el S3 se asocia a la
+ * LAN del predio, lo que duele es la latencia por paquete. El ahorro
+ * de energía por defecto (modem sleep) agrega decenas de milisegundos
+ * de intervalo de beacon a cada paquete, pensado para IoT a batería y
+ * no para teleoperación.
+ *
+ * Con 1, la init desactiva el power-save (WIFI_PS_NONE con
+ * listen_interval en 1 por si alguien lo re-habilita en campo),
+ * desactiva la agregación A-MPDU en TX (retiene paquetes chicos
+ * esperando juntar un burst; los frames de video ya van en fragmentos
+ * de tamaño MTU) y sube los buffers de RX. El pineo de la tarea WiFi
+ * al Core 0 viene de sdkconfig.defaults, junto a httpd y el TX de WS.
+ *
+ * El efecto se mide con la sonda RTT del dashboard (time_ping en
+ * ws_server.c) antes y después de togglear el perfil.
+ */
+#define WIFI_LATENCY_PROFILE 1
+
+/**
+ * @brief Trade-off de radio efectivamente aplicado en modo estación
+ *
+ * Para consultarlo en runtime y correlacionar mediciones de RTT con
+ * la configuración vigente, igual que softap_get_perf_profile().
+ */
+typedef struct
+{
+    bool ps_none;                // Power-save desactivado
+    bool ampdu_tx;               // Agregación A-MPDU en transmisión
+    bool ampdu_rx;               // Agregación A-MPDU en recepción
+    uint8_t static_rx_buf_num;   // Buffers estáticos de RX (DMA)
+    uint16_t dynamic_rx_buf_num; // Buffers dinámicos de RX
+    uint16_t listen_interval;    // Beacons entre despertares si hay PS
+} wifi_latency_profile_t;
+
+/**
+ * @brief Devuelve el perfil de latencia aplicado por wifi_init_sta()
+ *
+ * Con WIFI_LATENCY_PROFILE en 0 devuelve todo en cero (defaults de IDF).
+ */
+void wifi_get_latency_profile(wifi_latency_profile_t *out);
+
 /**
  * @brief Initialize WiFi in station mode and connect to configured AP
  *
@@ -1,17 +1,87 @@
 #include "ws_server.h"
+#include "camera_driver/camera_driver.h"
+#include "event_log/event_log.h"
+#include "json_arena/json_arena.h"
+#include "metrics/metrics.h"
+#include "espnow_link/espnow_link.h"
+#include "mem_arena/mem_arena.h"
+#include "trace_points.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "cJSON.h"
+#include "lwip/sockets.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdatomic.h>
 
 static const char *TAG = "WebSocket";
 static httpd_handle_t server = NULL;
 
 // Gestión de clientes WebSocket (dashboard y vehículos)
-#define MAX_WS_CLIENTS 4
+#define MAX_WS_CLIENTS 12
+
+// ============================================================================
+// AJUSTES DE RED DEL SERVIDOR
+// ============================================================================
+// Superficie de tuning explícita: todo lo que afecta el throughput del
+// camino de transmisión está acá y se puede consultar en runtime con
+// ws_server_get_tuning(), para correlacionar mediciones con la
+// configuración vigente en vez de adivinar qué había compilado.
+
+// Prioridad y pila de la tarea de httpd (la que atiende recepción y
+// handshakes; el envío real lo hace ws_tx_task)
+#define WS_SERVER_TASK_PRIORITY 5
+#define WS_SERVER_STACK_SIZE 6144
+
+// SO_SNDBUF por conexión: con el buffer por defecto de LWIP un frame
+// VGA no entra entero y el send bloquea a mitad de camino
+#define WS_SERVER_SNDBUF_BYTES (16 * 1024)
+
+// TCP_NODELAY en sockets de vehículos: los comandos de control son
+// chicos y Nagle les agrega hasta 40 ms de latencia esperando un ACK.
+// Los dashboards reciben frames grandes y se benefician del coalescing,
+// así que quedan con Nagle activo
+#define WS_SERVER_NODELAY_VEHICLES 1
+
+// Tamaño del mapa fd -> slot; los fd de LWIP siempre caen muy por
+// debajo de este límite
+#define WS_FD_MAP_SIZE 64
+
+// Tabla hash abierta de vehicle_id -> slot. Potencia de 2 y con huecos
+// de sobra respecto de MAX_WS_CLIENTS para que las sondas sean cortas
+#define WS_VEHICLE_HASH_SIZE 16
+
+// Registro persistente de vehículos: recuerda cada id visto desde el
+// arranque aunque su socket se haya cerrado. El despacho caliente sigue
+// en la tabla hash; el registro solo se consulta en el camino de
+// rechazo, para distinguir "conocido pero fuera de línea" de "nunca
+// visto" y que un id mal tipeado no termine manejando otro vehículo
+#define WS_VEHICLE_REGISTRY_SIZE 8
+
+// Id comodín de los comandos de flota: "*" se reparte a todos los
+// vehículos conectados en una sola pasada por la tabla de clientes
+#define WS_VEHICLE_ID_ALL "*"
+
+// Escalera de calidad para los streams de vehículos: presupuesto total
+// de frames/s que el SoftAP sostiene sin inflar colas TCP, repartido
+// entre vehículos y espectadores en ws_send_stream_status_to_vehicle()
+#define WS_STREAM_FPS_BUDGET 20
+#define WS_STREAM_FPS_MIN 2
+#define WS_STREAM_FPS_MAX 12
+#define WS_STREAM_JPEG_Q_SOLO 60   // Un solo vehículo transmitiendo
+#define WS_STREAM_JPEG_Q_SHARED 50 // Aire compartido: frames más chicos
+
+// Reportes de recepción de los dashboards (estilo receiver report de
+// RTCP): cada uno informa periódicamente su ritmo real de decode y la
+// última secuencia vista, y el servidor adapta el intervalo entre
+// frames por consumidor en vez de empujar a ciegas al ritmo de
+// producción (ver el bloque de ritmo por consumidor)
+#define WS_RR_FRESH_MS 5000  // Reportes más viejos que esto no cuentan
+#define WS_RR_FPS_HEADROOM 2 // Margen sobre el ritmo reportado
 
 typedef enum
 {
@@ -20,39 +90,148 @@ typedef enum
     WS_ROLE_VEHICLE,
 } ws_role_t;
 
+// Máscara de fuentes suscriptas por dashboard: bit (1 << frame_source_t).
+// Un dashboard recién registrado recibe todo (compatible con el viejo
+// comportamiento); con subscribe/unsubscribe puede quedarse solo con lo
+// que muestra y el resto ni siquiera sale por el aire
+#define WS_SUB_BIT(source) ((uint8_t)(1u << (source)))
+#define WS_SUB_ALL (WS_SUB_BIT(FRAME_SOURCE_ESP32S3) | WS_SUB_BIT(FRAME_SOURCE_ESP32CAM))
+
 typedef struct
 {
     int fd;
     ws_role_t role;
+    uint8_t sub_mask;  // Fuentes de video suscriptas (solo dashboards)
+    bool fast_relay;   // Pidió el reenvío fragmento a fragmento (solo
+                       // se activa suscripto únicamente al vehículo)
+    bool veto_last;    // Último flag de veto visto (solo vehículos)
     char vehicle_id[32];
+    uint8_t rr_fps[2];      // Último fps de decode reportado, por fuente
+    uint32_t rr_seq[2];     // Última secuencia que el dashboard vio
+    uint32_t rr_ms[2];      // Cuándo llegó ese reporte
+    uint32_t rr_sent_ms[2]; // Último frame encolado (ritmo por consumidor)
 } ws_client_t;
 
 static ws_client_t ws_clients[MAX_WS_CLIENTS] = {
-    {.fd = -1, .role = WS_ROLE_UNKNOWN, .vehicle_id = ""},
-    {.fd = -1, .role = WS_ROLE_UNKNOWN, .vehicle_id = ""},
-    {.fd = -1, .role = WS_ROLE_UNKNOWN, .vehicle_id = ""},
-    {.fd = -1, .role = WS_ROLE_UNKNOWN, .vehicle_id = ""},
+    [0 ... MAX_WS_CLIENTS - 1] = {.fd = -1, .role = WS_ROLE_UNKNOWN, .sub_mask = 0, .fast_relay = false, .veto_last = false, .vehicle_id = ""},
 };
 static uint8_t ws_clients_count = 0;
 static uint8_t ws_dashboard_count = 0;
 
+// Último (techo, congestión) empujado al vehículo por los reportes de
+// recepción; evita regenerar stream_status con cada reporte que no
+// cambia nada
+static uint8_t s_rr_last_cap = 0;
+static bool s_rr_last_congested = false;
+
+// Las búsquedas por fd y por vehicle_id están en el camino de recepción
+// de cada frame relevado; con 12 slots el barrido lineal ya no es gratis
+static int8_t s_fd_to_slot[WS_FD_MAP_SIZE] = {
+    [0 ... WS_FD_MAP_SIZE - 1] = -1,
+};
+static int8_t s_vehicle_hash[WS_VEHICLE_HASH_SIZE] = {
+    [0 ... WS_VEHICLE_HASH_SIZE - 1] = -1,
+};
+
+typedef struct
+{
+    char id[32];           // "" = entrada libre
+    uint32_t last_seen_ms; // Último registro o desconexión
+    bool online;
+} ws_vehicle_reg_t;
+
+static ws_vehicle_reg_t s_vehicle_registry[WS_VEHICLE_REGISTRY_SIZE];
+
+// Espectadores MJPEG por fuente: cuentan como demanda de video igual
+// que un dashboard suscripto, aunque no ocupen slot de WebSocket
+static _Atomic uint8_t s_mjpeg_viewers[2];
+
+// Clases de prioridad de envío: un comando de control nunca debe
+// esperar detrás de un megabyte de JPEG encolado
+typedef enum
+{
+    WS_TX_PRIO_CONTROL = 0, // Comandos reenviados a vehículos
+    WS_TX_PRIO_STATUS,      // Listas de vehículos, estado, detecciones
+    WS_TX_PRIO_VIDEO,       // Frames de video
+    WS_TX_PRIO_COUNT,
+} ws_tx_prio_t;
+
 static void ws_remove_client(int fd);
 static void ws_update_stream_status_for_vehicles(void);
+static void ws_send_signal_lost_frame(void);
+static void ws_send_veto_frame(void);
+static void ws_tx_stats_reset(int slot);
+static void ws_delivery_stats_add(cJSON *root);
+static void ws_rr_note_report(ws_client_t *client, frame_source_t source,
+                              uint32_t fps, uint32_t seq);
+static uint8_t ws_rr_render_cap(frame_source_t source, bool *congested);
 static esp_err_t ws_queue_frame(int fd,
                                 httpd_ws_type_t type,
                                 const uint8_t *data,
                                 size_t len);
+static esp_err_t ws_queue_frame_prio(int fd,
+                                     httpd_ws_type_t type,
+                                     const uint8_t *data,
+                                     size_t len,
+                                     ws_tx_prio_t prio);
+
+/**
+ * Slot de un cliente por fd en O(1); -1 si no está registrado
+ */
+static int ws_client_slot(int fd)
+{
+    if (fd < 0 || fd >= WS_FD_MAP_SIZE)
+    {
+        return -1;
+    }
+    return s_fd_to_slot[fd];
+}
 
 static ws_client_t *ws_find_client(int fd)
 {
+    int slot = ws_client_slot(fd);
+    return slot >= 0 ? &ws_clients[slot] : NULL;
+}
+
+static uint32_t ws_hash_vehicle_id(const char *id)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    while (*id)
+    {
+        hash ^= (uint8_t)*id++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Reconstruye la tabla hash de vehículos. Se llama solo cuando cambia
+ * la membresía (registro o desconexión), que es un evento raro; las
+ * búsquedas por frame quedan en O(1)
+ */
+static void ws_vehicle_hash_rebuild(void)
+{
+    memset(s_vehicle_hash, -1, sizeof(s_vehicle_hash));
+
     for (int i = 0; i < MAX_WS_CLIENTS; i++)
     {
-        if (ws_clients[i].fd == fd)
+        if (ws_clients[i].fd == -1 || ws_clients[i].role != WS_ROLE_VEHICLE ||
+            ws_clients[i].vehicle_id[0] == '\0')
         {
-            return &ws_clients[i];
+            continue;
+        }
+
+        uint32_t pos = ws_hash_vehicle_id(ws_clients[i].vehicle_id);
+        for (int probe = 0; probe < WS_VEHICLE_HASH_SIZE; probe++, pos++)
+        {
+            int8_t *cell = &s_vehicle_hash[pos & (WS_VEHICLE_HASH_SIZE - 1)];
+            if (*cell < 0)
+            {
+                *cell = (int8_t)i;
+                break;
+            }
         }
     }
-    return NULL;
 }
 
 static ws_client_t *ws_find_vehicle_by_id(const char *vehicle_id)
@@ -62,21 +241,98 @@ static ws_client_t *ws_find_vehicle_by_id(const char *vehicle_id)
         return NULL;
     }
 
-    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    uint32_t pos = ws_hash_vehicle_id(vehicle_id);
+    for (int probe = 0; probe < WS_VEHICLE_HASH_SIZE; probe++, pos++)
     {
-        if (ws_clients[i].fd == -1 || ws_clients[i].role != WS_ROLE_VEHICLE)
+        int8_t slot = s_vehicle_hash[pos & (WS_VEHICLE_HASH_SIZE - 1)];
+        if (slot < 0)
         {
-            continue;
+            return NULL; // Hueco: el id no está
         }
 
-        if (strncmp(ws_clients[i].vehicle_id, vehicle_id, sizeof(ws_clients[i].vehicle_id)) == 0)
+        ws_client_t *client = &ws_clients[slot];
+        if (client->fd != -1 && client->role == WS_ROLE_VEHICLE &&
+            strncmp(client->vehicle_id, vehicle_id, sizeof(client->vehicle_id)) == 0)
         {
-            return &ws_clients[i];
+            return client;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Busca un id en el registro persistente. Barrido lineal: solo corre en
+ * registros (evento raro) y en el camino de rechazo de comandos, nunca
+ * por frame
+ */
+static ws_vehicle_reg_t *ws_registry_find(const char *vehicle_id)
+{
+    if (!vehicle_id || vehicle_id[0] == '\0')
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < WS_VEHICLE_REGISTRY_SIZE; i++)
+    {
+        if (s_vehicle_registry[i].id[0] != '\0' &&
+            strncmp(s_vehicle_registry[i].id, vehicle_id,
+                    sizeof(s_vehicle_registry[i].id)) == 0)
+        {
+            return &s_vehicle_registry[i];
         }
     }
     return NULL;
 }
 
+/**
+ * Anota un cambio de presencia en el registro. Si la tabla está llena y
+ * el id es nuevo, recicla la entrada fuera de línea más vieja: los ids
+ * que van y vuelven (reconexiones) conservan su historia
+ */
+static void ws_registry_note(const char *vehicle_id, bool online)
+{
+    if (!vehicle_id || vehicle_id[0] == '\0')
+    {
+        return;
+    }
+
+    ws_vehicle_reg_t *entry = ws_registry_find(vehicle_id);
+    if (!entry)
+    {
+        ws_vehicle_reg_t *oldest = NULL;
+        for (int i = 0; i < WS_VEHICLE_REGISTRY_SIZE; i++)
+        {
+            ws_vehicle_reg_t *cand = &s_vehicle_registry[i];
+            if (cand->id[0] == '\0')
+            {
+                entry = cand;
+                break;
+            }
+            if (!cand->online &&
+                (!oldest || cand->last_seen_ms < oldest->last_seen_ms))
+            {
+                oldest = cand;
+            }
+        }
+        if (!entry)
+        {
+            entry = oldest;
+        }
+        if (!entry)
+        {
+            // Todas las entradas corresponden a vehículos conectados;
+            // con más vehículos que entradas solo se pierde historial
+            ESP_LOGW(TAG, "Registro de vehículos lleno; %s sin historial",
+                     vehicle_id);
+            return;
+        }
+        strlcpy(entry->id, vehicle_id, sizeof(entry->id));
+    }
+
+    entry->online = online;
+    entry->last_seen_ms = (uint32_t)(esp_timer_get_time() / 1000);
+}
+
 static ws_client_t *ws_first_vehicle(void)
 {
     for (int i = 0; i < MAX_WS_CLIENTS; i++)
@@ -89,6 +345,37 @@ static ws_client_t *ws_first_vehicle(void)
     return NULL;
 }
 
+static int ws_vehicle_count(void)
+{
+    int count = 0;
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_VEHICLE)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Dashboards suscriptos a una fuente de video. Recorre los 12 slots;
+ * se llama solo al cambiar suscripciones o membresía, no por frame
+ */
+static uint8_t ws_source_subscriber_count(frame_source_t source)
+{
+    uint8_t count = 0;
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD &&
+            (ws_clients[i].sub_mask & WS_SUB_BIT(source)))
+        {
+            count++;
+        }
+    }
+    return count + atomic_load_explicit(&s_mjpeg_viewers[source], memory_order_relaxed);
+}
+
 static void ws_set_client_role(ws_client_t *client,
                                ws_role_t role,
                                const char *vehicle_id)
@@ -106,36 +393,103 @@ static void ws_set_client_role(ws_client_t *client,
     }
 
     client->role = role;
+    client->sub_mask = (role == WS_ROLE_DASHBOARD) ? WS_SUB_ALL : 0;
 
     if (role == WS_ROLE_DASHBOARD)
     {
         ws_dashboard_count++;
     }
 
+    if (role == WS_ROLE_VEHICLE && previous_role != WS_ROLE_VEHICLE)
+    {
+#if WS_SERVER_NODELAY_VEHICLES
+        // Los comandos al vehículo son de decenas de bytes; sin esto
+        // Nagle los retiene esperando el ACK del frame anterior
+        int nodelay = 1;
+        if (setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY,
+                       &nodelay, sizeof(nodelay)) != 0)
+        {
+            ESP_LOGW(TAG, "No se pudo aplicar TCP_NODELAY en fd=%d", client->fd);
+        }
+#endif
+    }
+
     if (role == WS_ROLE_VEHICLE && vehicle_id)
     {
         strncpy(client->vehicle_id, vehicle_id, sizeof(client->vehicle_id) - 1);
         client->vehicle_id[sizeof(client->vehicle_id) - 1] = '\0';
+        ws_vehicle_hash_rebuild();
+        ws_registry_note(client->vehicle_id, true);
     }
     else if (role != WS_ROLE_VEHICLE)
     {
         client->vehicle_id[0] = '\0';
+        if (previous_role == WS_ROLE_VEHICLE)
+        {
+            ws_vehicle_hash_rebuild();
+        }
     }
 
-    if ((previous_role != role) &&
-        (previous_role == WS_ROLE_DASHBOARD || role == WS_ROLE_DASHBOARD))
+    // Cualquier cambio de rol altera el reparto del presupuesto de
+    // stream (dashboards como espectadores, vehículos como divisores)
+    if (previous_role != role)
     {
         ws_update_stream_status_for_vehicles();
     }
 }
 
-static esp_err_t ws_send_vehicle_list_to_client(const ws_client_t *dashboard)
+// Coalescencia de difusiones de lista de vehículos: la tormenta de
+// reconexiones de un vehículo inestable generaba una difusión completa
+// por evento. Los cambios solo marcan dirty y suben la versión; la
+// difusión real sale como mucho cada WS_VEHICLE_LIST_MIN_INTERVAL_MS
+// (la tarea de transmisión ejecuta los flush diferidos). El dashboard
+// descarta listas con versión vieja.
+#define WS_VEHICLE_LIST_MIN_INTERVAL_MS 500
+
+// Refresco periódico de la lista (y de sus estadísticas de entrega)
+// mientras haya dashboards: sin cambios de membresía los contadores
+// igual avanzan y el operador los quiere ver moverse
+#define WS_DELIVERY_REFRESH_MS 2000
+
+static _Atomic uint32_t s_vehicle_list_version = 0;
+static _Atomic bool s_vehicle_list_dirty = false;
+static int64_t s_vehicle_list_last_us = 0;
+
+// Cachés de mensajes prerenderizados: estos documentos son idénticos
+// para todos los destinatarios, pero se armaban con cJSON desde cero
+// por cada uno, dentro del contexto de eventos de httpd - el hilo más
+// crítico en latencia del S3. Ahora se renderizan una sola vez cuando
+// cambia el estado que los alimenta (tabla de clientes, suscripciones,
+// reportes de receptores) y los envíos solo referencian el buffer. El
+// arena de cJSON obliga a copiar: el string impreso muere en el
+// json_arena_reset(). Un largo de 0 marca la caché como inválida.
+static char s_vehicle_list_cache[2048];
+static size_t s_vehicle_list_cache_len = 0;
+static char s_stream_status_cache[256];
+static size_t s_stream_status_cache_len = 0;
+
+/**
+ * Copia el documento impreso a su caché; deja la caché inválida (y lo
+ * dice una vez por tamaño) si el documento creció más que el buffer.
+ */
+static esp_err_t ws_json_cache_store(char *cache, size_t cache_size,
+                                     size_t *cache_len, const char *json)
 {
-    if (!dashboard || dashboard->fd < 0)
+    size_t len = strlen(json);
+    if (len >= cache_size)
     {
-        return ESP_ERR_INVALID_ARG;
+        ESP_LOGE(TAG, "Documento JSON de %u bytes no entra en caché de %u",
+                 (unsigned)len, (unsigned)cache_size);
+        *cache_len = 0;
+        return ESP_ERR_NO_MEM;
     }
+    memcpy(cache, json, len + 1);
+    *cache_len = len;
+    return ESP_OK;
+}
 
+static esp_err_t ws_vehicle_list_render(void)
+{
     cJSON *root = cJSON_CreateObject();
     if (!root)
     {
@@ -143,10 +497,14 @@ static esp_err_t ws_send_vehicle_list_to_client(const ws_client_t *dashboard)
     }
 
     cJSON_AddStringToObject(root, "type", "vehicle_list");
+    cJSON_AddNumberToObject(root, "version",
+                            atomic_load_explicit(&s_vehicle_list_version,
+                                                 memory_order_relaxed));
     cJSON *list = cJSON_AddArrayToObject(root, "vehicles");
     if (!list)
     {
         cJSON_Delete(root);
+        json_arena_reset();
         return ESP_ERR_NO_MEM;
     }
 
@@ -163,24 +521,76 @@ static esp_err_t ws_send_vehicle_list_to_client(const ws_client_t *dashboard)
         }
     }
 
+    // Estadísticas de entrega por cliente: viajan con la lista porque
+    // salen coalescidas con el mismo ritmo y a los mismos destinatarios
+    ws_delivery_stats_add(root);
+
     char *json = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
 
     if (!json)
     {
+        json_arena_reset();
         return ESP_ERR_NO_MEM;
     }
 
-    esp_err_t ret = ws_queue_frame(dashboard->fd,
-                                   HTTPD_WS_TYPE_TEXT,
-                                   (const uint8_t *)json,
-                                   strlen(json));
-    free(json);
+    esp_err_t ret = ws_json_cache_store(s_vehicle_list_cache,
+                                        sizeof(s_vehicle_list_cache),
+                                        &s_vehicle_list_cache_len, json);
+    cJSON_free(json);
+    json_arena_reset();
     return ret;
 }
 
-static void ws_broadcast_vehicle_list(void)
+static esp_err_t ws_send_vehicle_list_to_client(const ws_client_t *dashboard)
+{
+    if (!dashboard || dashboard->fd < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Un dashboard que se registra entre flushes recibe la caché tal
+    // cual está: como mucho le faltan los contadores del intervalo en
+    // curso, y el refresco periódico lo alcanza enseguida
+    if (s_vehicle_list_cache_len == 0 && ws_vehicle_list_render() != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ws_queue_frame(dashboard->fd,
+                          HTTPD_WS_TYPE_TEXT,
+                          (const uint8_t *)s_vehicle_list_cache,
+                          s_vehicle_list_cache_len);
+}
+
+/**
+ * Difunde la lista pendiente si pasó el intervalo mínimo. La llama
+ * también la tarea de transmisión en su ciclo de 100ms, así los
+ * cambios coalescidos durante el intervalo salen en una sola difusión
+ */
+static void ws_vehicle_list_flush_if_due(void)
 {
+    if (!atomic_load_explicit(&s_vehicle_list_dirty, memory_order_acquire))
+    {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now - s_vehicle_list_last_us <
+        (int64_t)WS_VEHICLE_LIST_MIN_INTERVAL_MS * 1000)
+    {
+        return; // Todavía dentro del intervalo: queda pendiente
+    }
+
+    s_vehicle_list_last_us = now;
+    atomic_store_explicit(&s_vehicle_list_dirty, false, memory_order_release);
+
+    // Un render para toda la difusión: los N envíos comparten el buffer
+    if (ws_vehicle_list_render() != ESP_OK)
+    {
+        return;
+    }
+
     for (int i = 0; i < MAX_WS_CLIENTS; i++)
     {
         if (ws_clients[i].fd == -1 || ws_clients[i].role != WS_ROLE_DASHBOARD)
@@ -195,22 +605,77 @@ static void ws_broadcast_vehicle_list(void)
     }
 }
 
-static esp_err_t ws_send_stream_status_to_vehicle(const ws_client_t *vehicle)
+static void ws_broadcast_vehicle_list(void)
 {
-    if (!vehicle || vehicle->fd < 0)
-    {
-        return ESP_ERR_INVALID_ARG;
-    }
+    // Marcar el cambio y subir la versión; el flush decide cuándo sale
+    atomic_fetch_add_explicit(&s_vehicle_list_version, 1, memory_order_relaxed);
+    atomic_store_explicit(&s_vehicle_list_dirty, true, memory_order_release);
+    ws_vehicle_list_flush_if_due();
+}
 
+static esp_err_t ws_stream_status_render(void)
+{
     cJSON *root = cJSON_CreateObject();
     if (!root)
     {
         return ESP_ERR_NO_MEM;
     }
 
+    // Lo que importa al vehículo no es cuántos dashboards hay sino
+    // cuántos miran SU feed: si nadie se suscribió al esp32cam, que no
+    // transmita y el SoftAP queda libre para lo que sí se mira
+    uint8_t viewers = ws_source_subscriber_count(FRAME_SOURCE_ESP32CAM);
+
+    // Escalera de calidad por vehículo: el aire es uno solo, así que
+    // el presupuesto de frames/s se reparte en partes iguales entre los
+    // vehículos que transmiten, y cada frame que entra sale replicado a
+    // cada espectador, así que los espectadores también dividen. Con el
+    // segundo vehículo ambos bajan solos a la mitad del ritmo en vez de
+    // pelear el aire e inflar las colas TCP de todos; del tercero en
+    // adelante se baja además la resolución a preview.
+    int vehicles = ws_vehicle_count();
+    if (vehicles < 1)
+    {
+        vehicles = 1;
+    }
+    int fanout = (viewers > 1) ? viewers : 1;
+    int max_fps = WS_STREAM_FPS_BUDGET / (vehicles * fanout);
+    if (max_fps < WS_STREAM_FPS_MIN)
+    {
+        max_fps = WS_STREAM_FPS_MIN;
+    }
+    else if (max_fps > WS_STREAM_FPS_MAX)
+    {
+        max_fps = WS_STREAM_FPS_MAX;
+    }
+
+    // Lazo cerrado con los espectadores: si el más lento que reporta
+    // decodifica menos de lo que la escalera permite, empujar más solo
+    // infla colas TCP sin pintar un frame extra. Se baja el techo a su
+    // ritmo (con margen) y, si además acumula atraso de secuencias, la
+    // calidad, para que cada frame cueste menos aire.
+    bool congested = false;
+    uint8_t render_cap = ws_rr_render_cap(FRAME_SOURCE_ESP32CAM, &congested);
+    int jpeg_q = (vehicles > 1) ? WS_STREAM_JPEG_Q_SHARED : WS_STREAM_JPEG_Q_SOLO;
+    if (render_cap > 0 && (int)render_cap + WS_RR_FPS_HEADROOM < max_fps)
+    {
+        max_fps = (int)render_cap + WS_RR_FPS_HEADROOM;
+        if (max_fps < WS_STREAM_FPS_MIN)
+        {
+            max_fps = WS_STREAM_FPS_MIN;
+        }
+    }
+    if (congested)
+    {
+        jpeg_q = WS_STREAM_JPEG_Q_SHARED;
+    }
+
     cJSON_AddStringToObject(root, "type", "stream_status");
-    cJSON_AddBoolToObject(root, "enable", ws_dashboard_count > 0);
-    cJSON_AddNumberToObject(root, "viewer_count", ws_dashboard_count);
+    cJSON_AddBoolToObject(root, "enable", viewers > 0);
+    cJSON_AddNumberToObject(root, "viewer_count", viewers);
+    cJSON_AddNumberToObject(root, "max_fps", max_fps);
+    cJSON_AddNumberToObject(root, "jpeg_q", jpeg_q);
+    cJSON_AddBoolToObject(root, "preview", vehicles >= 3);
 
     char *json_string = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
@@ -218,20 +683,47 @@ static esp_err_t ws_send_stream_status_to_vehicle(const ws_client_t *vehicle)
     if (!json_string)
     {
         ESP_LOGE(TAG, "Error creando JSON para estado de stream");
+        json_arena_reset();
         return ESP_FAIL;
     }
 
-    esp_err_t ret = ws_queue_frame(vehicle->fd,
-                                   HTTPD_WS_TYPE_TEXT,
-                                   (const uint8_t *)json_string,
-                                   strlen(json_string));
-    free(json_string);
+    esp_err_t ret = ws_json_cache_store(s_stream_status_cache,
+                                        sizeof(s_stream_status_cache),
+                                        &s_stream_status_cache_len, json_string);
+    cJSON_free(json_string);
+    json_arena_reset();
 
     return ret;
 }
 
+static esp_err_t ws_send_stream_status_to_vehicle(const ws_client_t *vehicle)
+{
+    if (!vehicle || vehicle->fd < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_stream_status_cache_len == 0 && ws_stream_status_render() != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    return ws_queue_frame(vehicle->fd,
+                          HTTPD_WS_TYPE_TEXT,
+                          (const uint8_t *)s_stream_status_cache,
+                          s_stream_status_cache_len);
+}
+
 static void ws_update_stream_status_for_vehicles(void)
 {
+    // Renderizar una vez con el reparto recién calculado; los envíos
+    // del lazo (y los registros de vehículos que lleguen después, hasta
+    // el próximo cambio) referencian este mismo buffer
+    if (ws_stream_status_render() != ESP_OK)
+    {
+        return;
+    }
+
     for (int i = 0; i < MAX_WS_CLIENTS; i++)
     {
         if (ws_clients[i].fd == -1 || ws_clients[i].role != WS_ROLE_VEHICLE)
@@ -253,13 +745,28 @@ static bool ws_client_exists(int fd)
 
 static void ws_add_client(int fd)
 {
+    if (fd < 0 || fd >= WS_FD_MAP_SIZE)
+    {
+        ESP_LOGW(TAG, "fd=%d fuera del rango del mapa de clientes", fd);
+        return;
+    }
+
     for (int i = 0; i < MAX_WS_CLIENTS; i++)
     {
         if (ws_clients[i].fd == -1)
         {
             ws_clients[i].fd = fd;
             ws_clients[i].role = WS_ROLE_UNKNOWN;
+            ws_clients[i].sub_mask = 0;
+            ws_clients[i].fast_relay = false;
+            ws_clients[i].veto_last = false;
             ws_clients[i].vehicle_id[0] = '\0';
+            memset(ws_clients[i].rr_fps, 0, sizeof(ws_clients[i].rr_fps));
+            memset(ws_clients[i].rr_seq, 0, sizeof(ws_clients[i].rr_seq));
+            memset(ws_clients[i].rr_ms, 0, sizeof(ws_clients[i].rr_ms));
+            memset(ws_clients[i].rr_sent_ms, 0, sizeof(ws_clients[i].rr_sent_ms));
+            s_fd_to_slot[fd] = (int8_t)i;
+            ws_tx_stats_reset(i); // El slot puede venir de otro cliente
             ws_clients_count++;
             ESP_LOGI(TAG, "Cliente WebSocket agregado, fd=%d, total=%d", fd, ws_clients_count);
             return;
@@ -268,160 +775,1588 @@ static void ws_add_client(int fd)
     ESP_LOGW(TAG, "No hay espacio para más clientes WebSocket");
 }
 
-static esp_err_t ws_forward_control_message(const cJSON *root,
-                                            ws_client_t *source_client)
+/**
+ * Extrae "clave":"valor" de un JSON plano sin reservar memoria
+ *
+ * Los tres mensajes entrantes conocidos (register, control,
+ * stream_status) son objetos de un solo nivel con strings sin escapes,
+ * así que un barrido en el payload recibido alcanza; cJSON queda para
+ * los mensajes que construimos nosotros. Devuelve false ante cualquier
+ * cosa que no encaje en esa forma (el llamador decide qué hacer).
+ */
+static bool ws_json_get_string(const char *json, const char *key,
+                               char *out, size_t out_size)
 {
-    if (!root)
+    char pattern[40];
+    int pattern_len = snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    if (pattern_len < 0 || (size_t)pattern_len >= sizeof(pattern))
     {
-        return ESP_ERR_INVALID_ARG;
+        return false;
     }
 
-    const cJSON *vehicle_id_item = cJSON_GetObjectItem(root, "vehicle_id");
-    const char *vehicle_id = (vehicle_id_item && cJSON_IsString(vehicle_id_item)) ? vehicle_id_item->valuestring : NULL;
-
-    ws_client_t *target = ws_find_vehicle_by_id(vehicle_id);
-    if (!target)
+    const char *p = strstr(json, pattern);
+    if (p == NULL)
     {
-        target = ws_first_vehicle();
+        return false;
     }
+    p += pattern_len;
 
-    if (!target)
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p != ':')
     {
-        ESP_LOGW(TAG, "No hay vehículos conectados para reenviar comando");
-        return ESP_FAIL;
+        return false;
     }
-
-    if (source_client && target->fd == source_client->fd)
+    p++;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p != '"')
     {
-        ESP_LOGW(TAG, "Ignorando comando porque el origen es el mismo vehículo");
-        return ESP_FAIL;
+        return false;
     }
+    p++;
 
-    char *json_string = cJSON_PrintUnformatted(root);
-    if (!json_string)
+    size_t i = 0;
+    while (*p != '\0' && *p != '"')
     {
-        return ESP_ERR_NO_MEM;
+        if (*p == '\\' || i + 1 >= out_size)
+        {
+            return false; // Escapes o valor demasiado largo: no es nuestro
+        }
+        out[i++] = *p++;
     }
-
-    esp_err_t ret = ws_queue_frame(target->fd,
-                                   HTTPD_WS_TYPE_TEXT,
-                                   (const uint8_t *)json_string,
-                                   strlen(json_string));
-
-    if (ret != ESP_OK)
+    if (*p != '"')
     {
-        ESP_LOGE(TAG, "Error reenviando comando a fd=%d: %s",
-                 target->fd,
-                 esp_err_to_name(ret));
-        ws_remove_client(target->fd);
+        return false;
     }
 
-    free(json_string);
-    return ret;
+    out[i] = '\0';
+    return true;
 }
 
-static void ws_handle_text_message(int fd, const char *payload)
+/**
+ * Variante numérica del extractor: solo enteros sin signo planos, que
+ * es todo lo que usan nuestros mensajes
+ */
+static bool ws_json_get_uint(const char *json, const char *key, uint32_t *out)
 {
-    if (!payload)
+    char pattern[40];
+    int pattern_len = snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    if (pattern_len < 0 || (size_t)pattern_len >= sizeof(pattern))
     {
-        return;
+        return false;
     }
 
-    ws_client_t *client = ws_find_client(fd);
-    if (!client)
+    const char *p = strstr(json, pattern);
+    if (p == NULL)
     {
-        ws_add_client(fd);
-        client = ws_find_client(fd);
+        return false;
     }
+    p += pattern_len;
 
-    cJSON *root = cJSON_Parse(payload);
-    if (!root)
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p != ':')
     {
-        ESP_LOGW(TAG, "JSON inválido recibido de fd=%d", fd);
-        return;
+        return false;
     }
-
-    const cJSON *type_item = cJSON_GetObjectItem(root, "type");
-    const char *type = (type_item && cJSON_IsString(type_item)) ? type_item->valuestring : NULL;
-
-    if (!type)
+    p++;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p < '0' || *p > '9')
     {
-        ESP_LOGD(TAG, "Mensaje sin tipo desde fd=%d", fd);
-        cJSON_Delete(root);
-        return;
+        return false;
     }
 
-    if (strcmp(type, "register") == 0)
-    {
-        const cJSON *role_item = cJSON_GetObjectItem(root, "role");
-        const char *role = (role_item && cJSON_IsString(role_item)) ? role_item->valuestring : NULL;
-        const cJSON *vehicle_item = cJSON_GetObjectItem(root, "vehicle_id");
-        const char *vehicle_id = (vehicle_item && cJSON_IsString(vehicle_item)) ? vehicle_item->valuestring : NULL;
-
-        if (role && strcmp(role, "vehicle") == 0)
-        {
-            ws_set_client_role(client, WS_ROLE_VEHICLE, vehicle_id ? vehicle_id : "");
-            ESP_LOGI(TAG, "Vehículo registrado: fd=%d, id=%s",
-                     fd,
-                     vehicle_id ? vehicle_id : "(sin id)");
-            ws_broadcast_vehicle_list();
-            ws_send_stream_status_to_vehicle(client);
-        }
-        else
-        {
-            ws_set_client_role(client, WS_ROLE_DASHBOARD, NULL);
-            ESP_LOGI(TAG, "Dashboard registrado: fd=%d", fd);
-            ws_send_vehicle_list_to_client(client);
-        }
-    }
-    else if (strcmp(type, "control") == 0)
-    {
-        if (client && client->role == WS_ROLE_VEHICLE)
-        {
-            ESP_LOGW(TAG, "Vehículo envió comando de control - ignorado");
-        }
-        else
-        {
-            ws_set_client_role(client, WS_ROLE_DASHBOARD, NULL);
-            ws_forward_control_message(root, client);
-        }
-    }
-    else
+    uint32_t value = 0;
+    while (*p >= '0' && *p <= '9')
     {
-        ESP_LOGD(TAG, "Mensaje ignorado (%s) desde fd=%d", type, fd);
+        value = value * 10 + (uint32_t)(*p - '0');
+        p++;
     }
-
-    cJSON_Delete(root);
+    *out = value;
+    return true;
 }
 
+// Tamaño máximo de un comando reenviado con la marca de relevo agregada
+#define WS_CTRL_STAMPED_MAX 192
+
+// ============================================================================
+// SONDA DE LATENCIA EXTREMO A EXTREMO
+// ============================================================================
+// El dashboard emite un comando sintético latency_probe que recorre el
+// mismo camino que un comando real (incluida la marca de relevo); el
+// vehículo lo rebota como latency_report y acá cerramos el tramo
+// servidor→vehículo→servidor. Las muestras quedan en un anillo chico y
+// /stats publica percentiles; el RTT completo lo cierra el dashboard
+// con su propio reloj cuando el reporte le vuelve.
+
+#define WS_PROBE_PENDING 8
+#define WS_PROBE_HISTORY 64
+
 typedef struct
 {
-    httpd_handle_t server;
-    int fd;
-    httpd_ws_frame_t frame;
-    uint8_t payload[];
-} ws_async_packet_t;
+    uint32_t id;      // probe_id del dashboard (0 = slot libre)
+    uint32_t sent_ms; // Momento del relevo hacia el vehículo
+} ws_probe_pending_t;
 
-static void ws_async_send_handler(void *arg)
+// Solo los toca el worker de httpd (recepción y /stats): sin atómicos
+static ws_probe_pending_t s_probe_pending[WS_PROBE_PENDING];
+static uint16_t s_probe_rtt_ms[WS_PROBE_HISTORY];
+static uint8_t s_probe_count = 0;
+static uint8_t s_probe_next = 0;
+
+static void ws_probe_note_sent(uint32_t id)
+{
+    static uint8_t next = 0;
+    // Tabla corta con desalojo del más viejo: una sonda perdida solo
+    // deja de aportar muestra
+    s_probe_pending[next].id = id;
+    s_probe_pending[next].sent_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    next = (uint8_t)((next + 1) % WS_PROBE_PENDING);
+}
+
+static void ws_probe_note_report(uint32_t id)
+{
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    for (int i = 0; i < WS_PROBE_PENDING; i++)
+    {
+        if (s_probe_pending[i].id == id && id != 0)
+        {
+            uint32_t rtt = now - s_probe_pending[i].sent_ms;
+            s_probe_pending[i].id = 0;
+            s_probe_rtt_ms[s_probe_next] = (rtt > UINT16_MAX) ? UINT16_MAX
+                                                              : (uint16_t)rtt;
+            s_probe_next = (uint8_t)((s_probe_next + 1) % WS_PROBE_HISTORY);
+            if (s_probe_count < WS_PROBE_HISTORY)
+            {
+                s_probe_count++;
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * Percentiles sobre una ventana chica de latencias. Con 64 muestras
+ * como máximo, una copia más inserción directa alcanza de sobra.
+ */
+static void ws_latency_percentiles(const uint16_t *samples, uint8_t n,
+                                   uint16_t *p50, uint16_t *p90, uint16_t *p99)
+{
+    uint16_t sorted[WS_PROBE_HISTORY];
+
+    *p50 = *p90 = *p99 = 0;
+    if (n == 0)
+    {
+        return;
+    }
+
+    memcpy(sorted, samples, n * sizeof(uint16_t));
+    for (int i = 1; i < n; i++)
+    {
+        uint16_t v = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > v)
+        {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = v;
+    }
+
+    *p50 = sorted[(n - 1) * 50 / 100];
+    *p90 = sorted[(n - 1) * 90 / 100];
+    *p99 = sorted[(n - 1) * 99 / 100];
+}
+
+// ============================================================================
+// CONTABILIDAD DE ENTREGA DE COMANDOS
+// ============================================================================
+// El dashboard numera cada comando (seq) y el vehículo acusa recibo con
+// cmd_ack. Acá se cierran los dos tramos por separado: los huecos de
+// secuencia al recibir miden la pérdida dashboard→servidor, y las
+// entradas pendientes desalojadas sin ack miden la pérdida
+// servidor→vehículo. Con la pérdida medida por tramo se decide si
+// conviene invertir primero en el canal ESP-NOW o en afinar TCP.
+
+#define WS_CMDACK_PENDING 16
+#define WS_CMDACK_HISTORY WS_PROBE_HISTORY
+
+typedef struct
+{
+    uint32_t seq;     // 0 = slot libre
+    uint32_t sent_ms; // Momento del relevo hacia el vehículo
+} ws_cmdack_pending_t;
+
+// Solo los toca el worker de httpd (recepción y /stats): sin atómicos
+static ws_cmdack_pending_t s_cmdack_pending[WS_CMDACK_PENDING];
+static uint32_t s_cmd_rx_count = 0;   // Comandos con seq recibidos
+static uint32_t s_cmd_rx_lost = 0;    // Huecos de secuencia (tramo dashboard→servidor)
+static uint32_t s_cmd_last_seq = 0;   // Última secuencia vista del dashboard
+static uint32_t s_cmd_fwd_count = 0;  // Reenviados al vehículo con seq
+static uint32_t s_cmd_ack_count = 0;  // cmd_ack cerrados
+static uint32_t s_cmd_ack_lost = 0;   // Pendientes desalojados sin ack
+static uint16_t s_cmdack_rtt_ms[WS_CMDACK_HISTORY];
+static uint8_t s_cmdack_count = 0;
+static uint8_t s_cmdack_next = 0;
+
+static void ws_cmd_note_rx(uint32_t seq)
+{
+    s_cmd_rx_count++;
+    if (seq > s_cmd_last_seq + 1 && s_cmd_last_seq != 0)
+    {
+        s_cmd_rx_lost += seq - s_cmd_last_seq - 1;
+    }
+    // Una secuencia que retrocede es un dashboard nuevo, no pérdida
+    s_cmd_last_seq = seq;
+}
+
+static void ws_cmd_note_fwd(uint32_t seq)
+{
+    static uint8_t next = 0;
+    // Tabla corta con desalojo del más viejo, igual que las sondas;
+    // desalojar una entrada viva cuenta como comando sin acusar
+    if (s_cmdack_pending[next].seq != 0)
+    {
+        s_cmd_ack_lost++;
+    }
+    s_cmdack_pending[next].seq = seq;
+    s_cmdack_pending[next].sent_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    next = (uint8_t)((next + 1) % WS_CMDACK_PENDING);
+    s_cmd_fwd_count++;
+}
+
+static void ws_cmd_note_ack(uint32_t seq)
+{
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    for (int i = 0; i < WS_CMDACK_PENDING; i++)
+    {
+        if (s_cmdack_pending[i].seq == seq && seq != 0)
+        {
+            uint32_t rtt = now - s_cmdack_pending[i].sent_ms;
+            s_cmdack_pending[i].seq = 0;
+            s_cmdack_rtt_ms[s_cmdack_next] = (rtt > UINT16_MAX) ? UINT16_MAX
+                                                                : (uint16_t)rtt;
+            s_cmdack_next = (uint8_t)((s_cmdack_next + 1) % WS_CMDACK_HISTORY);
+            if (s_cmdack_count < WS_CMDACK_HISTORY)
+            {
+                s_cmdack_count++;
+            }
+            s_cmd_ack_count++;
+            return;
+        }
+    }
+}
+
+/**
+ * Avisa al dashboard de origen que su comando no fue entregado. El
+ * rechazo silencioso era peor que el rechazo a secas: el operador debe
+ * enterarse de que el vehículo que cree estar manejando no existe
+ */
+static void ws_notify_cmd_rejected(ws_client_t *source_client,
+                                   const char *vehicle_id,
+                                   const char *reason)
+{
+    if (!source_client || source_client->role != WS_ROLE_DASHBOARD)
+    {
+        return;
+    }
+
+    char notice[128];
+    int n = snprintf(notice, sizeof(notice),
+                     "{\"type\":\"cmd_rejected\",\"vehicle_id\":\"%s\",\"reason\":\"%s\"}",
+                     vehicle_id ? vehicle_id : "", reason);
+    if (n > 0 && n < (int)sizeof(notice))
+    {
+        ws_queue_frame_prio(source_client->fd, HTTPD_WS_TYPE_TEXT,
+                            (const uint8_t *)notice, (size_t)n,
+                            WS_TX_PRIO_STATUS);
+    }
+}
+
+/**
+ * Reenvía un comando de control pasando los bytes originales tal cual:
+ * sin parsear con cJSON ni re-serializar, cero reservas de memoria en
+ * el camino hasta el anillo de transmisión.
+ *
+ * Destinos:
+ *  - id concreto: despacho O(1) por la tabla hash; un id que no resuelve
+ *    se rechaza con aviso en vez de caer al primer vehículo conectado
+ *    (con dos vehículos ese fallback manejaba el equivocado)
+ *  - "*": multicast de flota, una sola pasada por la tabla de clientes
+ *  - sin id: compatible con dashboards viejos solo mientras haya un
+ *    único vehículo conectado; con más de uno el destino es ambiguo
+ */
+static esp_err_t ws_forward_control_message(const char *payload,
+                                            const char *vehicle_id,
+                                            ws_client_t *source_client)
+{
+    bool multicast = (vehicle_id && strcmp(vehicle_id, WS_VEHICLE_ID_ALL) == 0);
+    ws_client_t *target = NULL;
+
+    if (!multicast)
+    {
+        if (vehicle_id && vehicle_id[0] != '\0')
+        {
+            target = ws_find_vehicle_by_id(vehicle_id);
+            if (!target)
+            {
+                ws_vehicle_reg_t *known = ws_registry_find(vehicle_id);
+                ESP_LOGW(TAG, "Comando para '%s' rechazado: %s", vehicle_id,
+                         known ? "vehículo conocido pero desconectado"
+                               : "id nunca registrado");
+                ws_notify_cmd_rejected(source_client, vehicle_id,
+                                       known ? "offline" : "unknown");
+                return ESP_ERR_NOT_FOUND;
+            }
+        }
+        else if (ws_vehicle_count() == 1)
+        {
+            target = ws_first_vehicle();
+        }
+        else if (ws_vehicle_count() > 1)
+        {
+            ESP_LOGW(TAG, "Comando sin vehicle_id con %d vehículos conectados: "
+                          "destino ambiguo, rechazado",
+                     ws_vehicle_count());
+            ws_notify_cmd_rejected(source_client, NULL, "ambiguous");
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        if (!target)
+        {
+            ESP_LOGW(TAG, "No hay vehículos conectados para reenviar comando");
+            ws_notify_cmd_rejected(source_client, vehicle_id, "no_vehicles");
+            return ESP_FAIL;
+        }
+
+        if (source_client && target->fd == source_client->fd)
+        {
+            ESP_LOGW(TAG, "Ignorando comando porque el origen es el mismo vehículo");
+            return ESP_FAIL;
+        }
+    }
+
+    // Marca de relevo para el filtro de comandos viejos: el vehículo
+    // sincroniza su reloj contra el nuestro (time_ping) y con relay_ms
+    // puede medir cuánto esperó el comando en el camino TCP. Si el
+    // payload no tiene la forma esperada se reenvía sin tocar.
+    char stamped[WS_CTRL_STAMPED_MAX];
+    const char *out = payload;
+    size_t out_len = strlen(payload);
+    if (out_len > 2 && payload[out_len - 1] == '}')
+    {
+        int n = snprintf(stamped, sizeof(stamped), "%.*s,\"relay_ms\":%lu}",
+                         (int)(out_len - 1), payload,
+                         (unsigned long)(esp_timer_get_time() / 1000));
+        if (n > 0 && n < (int)sizeof(stamped))
+        {
+            out = stamped;
+            out_len = (size_t)n;
+        }
+    }
+
+    if (multicast)
+    {
+        // Se sella una sola vez y se reparte: el stop de flota sale en
+        // una pasada en vez de un clic por vehículo en el dashboard
+        int delivered = 0;
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd == -1 || ws_clients[i].role != WS_ROLE_VEHICLE)
+            {
+                continue;
+            }
+            if (source_client && ws_clients[i].fd == source_client->fd)
+            {
+                continue;
+            }
+            if (ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)out, out_len,
+                                    WS_TX_PRIO_CONTROL) == ESP_OK)
+            {
+                delivered++;
+            }
+            else
+            {
+                ESP_LOGE(TAG, "Error en multicast a fd=%d", ws_clients[i].fd);
+                ws_remove_client(ws_clients[i].fd);
+            }
+        }
+
+        if (delivered == 0)
+        {
+            ESP_LOGW(TAG, "Multicast sin vehículos conectados");
+            ws_notify_cmd_rejected(source_client, WS_VEHICLE_ID_ALL, "no_vehicles");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ws_queue_frame_prio(target->fd,
+                                        HTTPD_WS_TYPE_TEXT,
+                                        (const uint8_t *)out,
+                                        out_len,
+                                        WS_TX_PRIO_CONTROL);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error reenviando comando a fd=%d: %s",
+                 target->fd,
+                 esp_err_to_name(ret));
+        ws_remove_client(target->fd);
+    }
+
+    return ret;
+}
+
+static void ws_handle_text_message(int fd, const char *payload)
+{
+    if (!payload)
+    {
+        return;
+    }
+
+    ws_client_t *client = ws_find_client(fd);
+    if (!client)
+    {
+        ws_add_client(fd);
+        client = ws_find_client(fd);
+    }
+
+    char type[24];
+    if (!ws_json_get_string(payload, "type", type, sizeof(type)))
+    {
+        ESP_LOGW(TAG, "Mensaje sin tipo reconocible desde fd=%d", fd);
+        return;
+    }
+
+    if (strcmp(type, "register") == 0)
+    {
+        char role[16];
+        char vehicle_id[32];
+        bool has_role = ws_json_get_string(payload, "role", role, sizeof(role));
+        bool has_vehicle = ws_json_get_string(payload, "vehicle_id",
+                                              vehicle_id, sizeof(vehicle_id));
+
+        if (has_role && strcmp(role, "vehicle") == 0)
+        {
+            ws_set_client_role(client, WS_ROLE_VEHICLE, has_vehicle ? vehicle_id : "");
+            ESP_LOGI(TAG, "Vehículo registrado: fd=%d, id=%s",
+                     fd,
+                     has_vehicle ? vehicle_id : "(sin id)");
+            ws_broadcast_vehicle_list();
+            ws_send_stream_status_to_vehicle(client);
+        }
+        else
+        {
+            ws_set_client_role(client, WS_ROLE_DASHBOARD, NULL);
+            ESP_LOGI(TAG, "Dashboard registrado: fd=%d", fd);
+            ws_send_vehicle_list_to_client(client);
+        }
+    }
+    else if (strcmp(type, "subscribe") == 0 || strcmp(type, "unsubscribe") == 0)
+    {
+        char source[16];
+        if (!client || client->role != WS_ROLE_DASHBOARD)
+        {
+            ESP_LOGW(TAG, "Suscripción desde fd=%d sin rol de dashboard - ignorada", fd);
+            return;
+        }
+        if (!ws_json_get_string(payload, "source", source, sizeof(source)))
+        {
+            ESP_LOGW(TAG, "Suscripción sin fuente desde fd=%d", fd);
+            return;
+        }
+
+        frame_source_t src;
+        if (strcmp(source, "esp32s3") == 0)
+        {
+            src = FRAME_SOURCE_ESP32S3;
+        }
+        else if (strcmp(source, "esp32cam") == 0)
+        {
+            src = FRAME_SOURCE_ESP32CAM;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Fuente desconocida en suscripción: %s", source);
+            return;
+        }
+
+        // Relevo directo opcional: reenviar los fragmentos del vehículo
+        // según llegan, sin esperar el reensamblado (ver el bloque de
+        // reenvío rápido más abajo). Solo toma efecto suscripto
+        // únicamente al feed del vehículo.
+        uint32_t fast = 0;
+        if (ws_json_get_uint(payload, "fast_relay", &fast))
+        {
+            client->fast_relay = (fast != 0);
+        }
+
+        uint8_t new_mask = (type[0] == 's')
+                               ? (uint8_t)(client->sub_mask | WS_SUB_BIT(src))
+                               : (uint8_t)(client->sub_mask & ~WS_SUB_BIT(src));
+        if (new_mask != client->sub_mask)
+        {
+            client->sub_mask = new_mask;
+            ESP_LOGI(TAG, "fd=%d %s a %s (máscara=0x%02x)",
+                     fd, type, source, new_mask);
+            // La demanda del feed del vehículo pudo cambiar
+            ws_update_stream_status_for_vehicles();
+        }
+    }
+    else if (strcmp(type, "receiver_report") == 0)
+    {
+        char source[16];
+        if (!client || client->role != WS_ROLE_DASHBOARD ||
+            !ws_json_get_string(payload, "source", source, sizeof(source)))
+        {
+            return;
+        }
+
+        frame_source_t src;
+        if (strcmp(source, "esp32s3") == 0)
+        {
+            src = FRAME_SOURCE_ESP32S3;
+        }
+        else if (strcmp(source, "esp32cam") == 0)
+        {
+            src = FRAME_SOURCE_ESP32CAM;
+        }
+        else
+        {
+            return;
+        }
+
+        uint32_t fps = 0;
+        uint32_t seq = 0;
+        ws_json_get_uint(payload, "fps", &fps);
+        ws_json_get_uint(payload, "seq", &seq);
+        ws_rr_note_report(client, src, fps, seq);
+
+        // El techo del vehículo lo fija el espectador más lento: si
+        // este reporte lo movió, avisar ya en vez de esperar al próximo
+        // cambio de suscripciones
+        if (src == FRAME_SOURCE_ESP32CAM)
+        {
+            bool congested = false;
+            uint8_t cap = ws_rr_render_cap(FRAME_SOURCE_ESP32CAM, &congested);
+            if (cap != s_rr_last_cap || congested != s_rr_last_congested)
+            {
+                s_rr_last_cap = cap;
+                s_rr_last_congested = congested;
+                ws_update_stream_status_for_vehicles();
+            }
+        }
+    }
+    else if (strcmp(type, "control") == 0)
+    {
+        if (client && client->role == WS_ROLE_VEHICLE)
+        {
+            ESP_LOGW(TAG, "Vehículo envió comando de control - ignorado");
+        }
+        else
+        {
+            char vehicle_id[32];
+            char command[16];
+            bool has_vehicle = ws_json_get_string(payload, "vehicle_id",
+                                                  vehicle_id, sizeof(vehicle_id));
+            ws_set_client_role(client, WS_ROLE_DASHBOARD, NULL);
+
+            // Contabilidad del tramo dashboard→servidor por huecos de
+            // secuencia; los comandos sin seq (dashboards viejos) solo
+            // quedan fuera de la estadística
+            uint32_t seq = 0;
+            bool has_seq = ws_json_get_uint(payload, "seq", &seq) && seq != 0;
+            if (has_seq)
+            {
+                ws_cmd_note_rx(seq);
+            }
+
+            // El stop también sale por el canal lateral ESP-NOW: llega
+            // en milisegundos aunque el TCP esté retransmitiendo. El
+            // vehículo deduplica por secuencia, el doble envío es inocuo.
+            if (ws_json_get_string(payload, "command", command, sizeof(command)))
+            {
+                if (strcmp(command, "stop") == 0)
+                {
+                    espnow_link_send_command(ESPNOW_CMD_STOP);
+                }
+                else if (strcmp(command, "latency_probe") == 0)
+                {
+                    // Sonda de latencia: anotar la salida para cerrar el
+                    // tramo servidor→vehículo→servidor con el rebote
+                    uint32_t probe_id = 0;
+                    if (ws_json_get_uint(payload, "probe_id", &probe_id))
+                    {
+                        ws_probe_note_sent(probe_id);
+                    }
+                }
+            }
+
+            if (ws_forward_control_message(payload, has_vehicle ? vehicle_id : NULL,
+                                           client) == ESP_OK &&
+                has_seq)
+            {
+                ws_cmd_note_fwd(seq);
+            }
+        }
+    }
+    else if (strcmp(type, "cmd_ack") == 0)
+    {
+        // Acuse del vehículo: cierra el tramo servidor→vehículo de la
+        // contabilidad de entrega; no se reenvía a nadie
+        uint32_t seq = 0;
+        if (ws_json_get_uint(payload, "seq", &seq))
+        {
+            ws_cmd_note_ack(seq);
+        }
+    }
+    else if (strcmp(type, "latency_report") == 0)
+    {
+        // Rebote de una sonda: registrar la muestra propia y reenviar el
+        // reporte a los dashboards para que cierren su RTT completo
+        uint32_t probe_id = 0;
+        if (ws_json_get_uint(payload, "probe_id", &probe_id))
+        {
+            ws_probe_note_report(probe_id);
+        }
+
+        size_t report_len = strlen(payload);
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+            {
+                ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)payload, report_len,
+                                    WS_TX_PRIO_STATUS);
+            }
+        }
+    }
+    else if (strcmp(type, "veto_event") == 0)
+    {
+        // Flanco de veto del vehículo: a los dashboards por el anillo
+        // de control, delante de todo el video encolado, para que el
+        // overlay aparezca al instante y el operador deje de insistir
+        size_t event_len = strlen(payload);
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+            {
+                ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)payload, event_len,
+                                    WS_TX_PRIO_CONTROL);
+            }
+        }
+    }
+    else if (strcmp(type, "task_stats") == 0)
+    {
+        // Estadísticas del planificador del vehículo (cadencia lenta):
+        // reenviar tal cual a los dashboards, igual que latency_report
+        size_t stats_len = strlen(payload);
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+            {
+                ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)payload, stats_len,
+                                    WS_TX_PRIO_STATUS);
+            }
+        }
+    }
+    else if (strcmp(type, "time_ping") == 0)
+    {
+        // Sincronización de reloj del vehículo: responder ya mismo por
+        // el anillo de control con nuestro tiempo y el t0 original, para
+        // que el remitente estime offset y RTT
+        uint32_t t0 = 0;
+        ws_json_get_uint(payload, "t0", &t0);
+
+        char pong[96];
+        int n = snprintf(pong, sizeof(pong),
+                         "{\"type\":\"time_pong\",\"t0\":%lu,\"server_ms\":%lu}",
+                         (unsigned long)t0,
+                         (unsigned long)(esp_timer_get_time() / 1000));
+        if (n > 0 && n < (int)sizeof(pong))
+        {
+            ws_queue_frame_prio(fd, HTTPD_WS_TYPE_TEXT, (const uint8_t *)pong,
+                                (size_t)n, WS_TX_PRIO_CONTROL);
+        }
+    }
+    else if (strcmp(type, "trace_dump") == 0)
+    {
+        // Línea de tiempo unificada: reenviar el pedido a los vehículos
+        // (responden con trace_events en reloj del servidor) y volcar
+        // nuestra propia ventana de eventos al dashboard que preguntó.
+        // Este reloj es la referencia: los vehículos ya sincronizan
+        // contra él vía time_ping/time_pong.
+        if (!client || client->role != WS_ROLE_DASHBOARD)
+        {
+            ESP_LOGW(TAG, "trace_dump desde fd=%d sin rol de dashboard - ignorado", fd);
+            return;
+        }
+
+        size_t dump_len = strlen(payload);
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_VEHICLE)
+            {
+                ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)payload, dump_len,
+                                    WS_TX_PRIO_STATUS);
+            }
+        }
+
+        event_snapshot_t events[48];
+        int count = event_log_recent(events, 48);
+
+        char *buf = malloc(3072);
+        if (!buf)
+        {
+            return;
+        }
+        int len = snprintf(buf, 3072,
+                           "{\"type\":\"trace_events\",\"source\":\"esp32s3\",\"events\":[");
+        for (int i = 0; i < count && len < 3072; i++)
+        {
+            len += snprintf(buf + len, 3072 - (size_t)len,
+                            "%s[%lu,%u,%ld,%ld,%ld]",
+                            (i > 0) ? "," : "",
+                            (unsigned long)events[i].timestamp_ms,
+                            events[i].code,
+                            (long)events[i].arg1,
+                            (long)events[i].arg2,
+                            (long)events[i].arg3);
+        }
+        if (len < 3072)
+        {
+            len += snprintf(buf + len, 3072 - (size_t)len, "]}");
+        }
+        if (len > 0 && len < 3072)
+        {
+            ws_queue_frame_prio(fd, HTTPD_WS_TYPE_TEXT, (const uint8_t *)buf,
+                                (size_t)len, WS_TX_PRIO_STATUS);
+        }
+        free(buf);
+    }
+    else if (strcmp(type, "trace_events") == 0)
+    {
+        // Volcado de eventos de un vehículo (ya en reloj del servidor):
+        // reenviar tal cual a los dashboards, igual que latency_report
+        size_t events_len = strlen(payload);
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+            {
+                ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)payload, events_len,
+                                    WS_TX_PRIO_STATUS);
+            }
+        }
+    }
+    else if (strcmp(type, "ota_status") == 0)
+    {
+        // Progreso OTA del vehículo: a los dashboards, que es donde
+        // corre el actualizador que marca el ritmo de la transferencia
+        size_t status_len = strlen(payload);
+        for (int i = 0; i < MAX_WS_CLIENTS; i++)
+        {
+            if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+            {
+                ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                    (const uint8_t *)payload, status_len,
+                                    WS_TX_PRIO_STATUS);
+            }
+        }
+    }
+    else if (strcmp(type, "camera_profile") == 0)
+    {
+        // Canal de configuración de la cámara local: el perfil queda
+        // pendiente y la tarea de visión lo aplica entre frames
+        char name[16];
+        camera_profile_t profile;
+        if (ws_json_get_string(payload, "profile", name, sizeof(name)) &&
+            camera_profile_from_name(name, &profile) == ESP_OK)
+        {
+            camera_set_profile(profile);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Perfil de captura desconocido desde fd=%d", fd);
+        }
+    }
+    else if (strncmp(type, "ota_", 4) == 0)
+    {
+        // ota_begin / ota_end / ota_abort del actualizador: al vehículo
+        // por el mismo camino que los comandos de control
+        if (client && client->role == WS_ROLE_DASHBOARD)
+        {
+            ws_forward_control_message(payload, NULL, client);
+        }
+    }
+    else
+    {
+        ESP_LOGD(TAG, "Mensaje ignorado (%s) desde fd=%d", type, fd);
+    }
+}
+
+// ============================================================================
+// BUFFER COMPARTIDO CON CONTEO DE REFERENCIAS
+// ============================================================================
+// El broadcast de video copiaba el JPEG entero (20-30 KB) una vez por
+// dashboard conectado. Con este esquema el JPEG se copia una sola vez a
+// un buffer compartido y cada envío asíncrono por cliente lleva solo un
+// puntero con una referencia; el último en soltar libera.
+
+typedef struct
+{
+    _Atomic int refcount;
+    size_t len;
+    uint8_t data[];
+} ws_shared_buf_t;
+
+// ============================================================================
+// FORMATO BINARIO DE FRAME DE VIDEO
+// ============================================================================
+// Antes cada frame viajaba como un frame de texto {"type":"frame",...}
+// seguido del binario, y el dashboard tenía que aparear ambos; si dos
+// fuentes intercalaban, el frame quedaba mal atribuido. Ahora el binario
+// es autodescriptivo: cabecera fija 'V','F' + fuente + secuencia +
+// timestamp, seguida del payload (JPEG o paquete de tiles). Una sola
+// operación de encolado por cliente.
+
+#define WS_FRAME_MAGIC_0 0x56 // 'V'
+#define WS_FRAME_MAGIC_1 0x46 // 'F'
+
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];      // 'V','F'
+    uint8_t source;        // frame_source_t
+    uint8_t reserved;
+    uint32_t sequence;     // Creciente por broadcast, little-endian
+    uint32_t timestamp_ms; // Momento del envío, reloj del servidor
+    uint32_t capture_ms;   // Momento de captura en el mismo reloj; el
+                           // dashboard calcula con ambos la latencia
+                           // vidrio-a-vidrio y el tramo previo al aire.
+                           // Igual a timestamp_ms si no se conoce.
+} ws_frame_header_t;
+
+// ============================================================================
+// FORMATO BINARIO DE ESTADO DE VEHÍCULO
+// ============================================================================
+// La telemetría del vehículo llega 10 veces por segundo; como JSON eso
+// costaba un árbol cJSON por envío en el vehículo y un parseo acá. Ahora
+// viaja como mensaje binario versionado de tamaño fijo con magia 'V','S'
+// (un JPEG nunca empieza así, comparte el canal binario sin ambigüedad)
+// y el servidor lo reenvía tal cual a los dashboards sin tocarlo.
+
+#define WS_STATUS_MAGIC_0 0x56 // 'V'
+#define WS_STATUS_MAGIC_1 0x53 // 'S'
+#define WS_STATUS_VERSION 4
+#define WS_STATUS_FLAG_VETO 0x01
+
+typedef struct __attribute__((packed))
+{
+    uint8_t magic[2];      // 'V','S'
+    uint8_t version;       // WS_STATUS_VERSION
+    uint8_t flags;         // Bit 0: veto local activo
+    int16_t motor_left;    // -255..255, little-endian
+    int16_t motor_right;   // -255..255, little-endian
+    uint16_t battery_mv;   // Tensión de batería en mV
+    int32_t vision_age_ms; // Edad del dato de visión (-1 sin frame aún)
+    char vehicle_id[16];   // Terminado/relleno con NUL
+    char status[16];       // "moving", "stopped", ...
+    uint16_t cmd_p50_us;   // v2: latencia de actuación recepción->PWM
+    uint16_t cmd_p95_us;   //     en el vehículo (percentiles y máximo
+    uint16_t cmd_max_us;   //     en us, saturado a 65535)
+    uint16_t heap_free_kb; // v3: salud del heap del vehículo - libre y
+    uint16_t heap_largest_kb; // mayor bloque contiguo en KB, interno
+    uint16_t psram_free_kb;   // primero y luego SPIRAM (la razón
+    uint16_t psram_largest_kb; // mayor/libre delata fragmentación)
+    uint8_t qos_shed;         // v4: nivel de descarte QoS del vehículo
+    uint8_t reserved;         //     (0 = servicio completo)
+} ws_status_msg_t;
+
+/**
+ * Reenvía un mensaje de estado binario a los dashboards. Devuelve true
+ * si el payload era un estado (aunque la versión no coincida); false
+ * significa que es video y sigue por el camino de broadcast.
+ */
+static bool ws_handle_status_frame(int fd, const uint8_t *payload, size_t len)
+{
+    if (len != sizeof(ws_status_msg_t) ||
+        payload[0] != WS_STATUS_MAGIC_0 || payload[1] != WS_STATUS_MAGIC_1)
+    {
+        return false;
+    }
+
+    if (payload[2] != WS_STATUS_VERSION)
+    {
+        ESP_LOGW(TAG, "Estado con versión desconocida (%u) desde fd=%d - descartado",
+                 payload[2], fd);
+        return true;
+    }
+
+    ws_client_t *client = ws_find_client(fd);
+    if (client == NULL || client->role != WS_ROLE_VEHICLE)
+    {
+        // Carrera de reconexión: el estado puede llegar antes del register
+        ESP_LOGD(TAG, "Estado desde fd=%d sin rol de vehículo - descartado", fd);
+        return true;
+    }
+
+    // Flanco de veto: frame enlatado al instante, sin esperar a que el
+    // próximo frame de video (posiblemente lento bajo veto) lo cuente
+    bool veto = (payload[3] & WS_STATUS_FLAG_VETO) != 0;
+    if (veto && !client->veto_last)
+    {
+        ws_send_veto_frame();
+    }
+    client->veto_last = veto;
+
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+        {
+            ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_BINARY,
+                                payload, len, WS_TX_PRIO_STATUS);
+        }
+    }
+    return true;
+}
+
+static ws_shared_buf_t *ws_shared_buf_alloc(size_t len)
+{
+    ws_shared_buf_t *buf = malloc(sizeof(ws_shared_buf_t) + len);
+    if (buf == NULL)
+    {
+        return NULL;
+    }
+
+    atomic_init(&buf->refcount, 1);
+    buf->len = len;
+    return buf;
+}
+
+static void ws_shared_buf_ref(ws_shared_buf_t *buf)
+{
+    atomic_fetch_add_explicit(&buf->refcount, 1, memory_order_relaxed);
+}
+
+static void ws_shared_buf_unref(ws_shared_buf_t *buf)
+{
+    // release/acquire: el que libera debe ver todos los usos previos
+    if (atomic_fetch_sub_explicit(&buf->refcount, 1, memory_order_release) == 1)
+    {
+        atomic_thread_fence(memory_order_acquire);
+        free(buf);
+    }
+}
+
+// ============================================================================
+// TAREA DE TRANSMISIÓN CON ANILLOS POR CLIENTE Y PRIORIDADES
+// ============================================================================
+// Antes cada mensaje saliente pasaba por httpd_queue_work hacia el único
+// worker del httpd, así que un comando de control podía quedar detrás de
+// docenas de paquetes de video. Ahora cada cliente tiene un anillo sin
+// locks por clase de prioridad (mismo esquema Vyukov que event_log) y una
+// tarea dedicada drena control, después estado, y recién entonces un
+// frame de video por cliente antes de volver a mirar el control.
+
+#define WS_TX_RING_SIZE 8 // Potencia de 2
+
+#define WS_TX_TASK_STACK_SIZE 4096
+#define WS_TX_TASK_PRIORITY 5
+#define WS_TX_TASK_CORE_ID 0
+
+typedef struct
+{
+    int fd;
+    httpd_ws_type_t type;
+    ws_shared_buf_t *shared;
+    uint32_t offset; // Ventana dentro del buffer compartido: un mensaje
+    uint32_t len;    // entero usa (0, shared->len); un fragmento del
+                     // relevo directo, su tajada
+    uint32_t enq_us; // Momento de encolado (reloj truncado a 32 bits):
+                     // la resta contra el momento de envío mide cuánto
+                     // esperó el mensaje en el anillo
+    bool final;      // Bit FIN del frame WebSocket a emitir
+} ws_tx_msg_t;
+
+/**
+ * Un mensaje "entero" ocupa un solo frame WebSocket; todo lo demás es
+ * un fragmento de un mensaje en curso (relevo directo del vehículo)
+ */
+static inline bool ws_tx_msg_is_whole(const ws_tx_msg_t *msg)
+{
+    return msg->final && msg->type != HTTPD_WS_TYPE_CONTINUE;
+}
+
+typedef struct
+{
+    _Atomic uint32_t seq;
+    ws_tx_msg_t msg;
+} ws_tx_cell_t;
+
+typedef struct
+{
+    ws_tx_cell_t cells[WS_TX_RING_SIZE];
+    _Atomic uint32_t head;
+    uint32_t tail; // Solo lo toca la tarea de transmisión
+} ws_tx_ring_t;
+
+// Techo de bytes salientes pendientes por cliente: con un dashboard en
+// WiFi débil el video se descarta acá y no en el heap compartido
+#define WS_TX_MAX_PENDING_BYTES (96 * 1024)
+
+static ws_tx_ring_t s_tx_rings[MAX_WS_CLIENTS][WS_TX_PRIO_COUNT];
+static _Atomic uint32_t s_tx_pending_bytes[MAX_WS_CLIENTS];
+static _Atomic uint32_t s_tx_dropped[WS_TX_PRIO_COUNT];
+
+// Frames enteros descartados por fuente cuando el token bucket de aire
+// quedó sin bytes (ver ws_air_bucket_take)
+static _Atomic uint32_t s_air_exhausted[2];
+
+// Frames del vehículo que salieron fragmento a fragmento por el relevo
+// directo hacia al menos un dashboard (ver el bloque de relevo directo)
+static _Atomic uint32_t s_fast_frames;
+static TaskHandle_t s_tx_task_handle = NULL;
+
+// Contadores por cliente para el endpoint /stats: sin visibilidad no
+// hay forma de saber si los descartes son de un cliente lento o de todos
+typedef struct
+{
+    _Atomic uint32_t delivered;     // Frames aceptados por el stack TCP
+    _Atomic uint32_t dropped;       // Descartes (contrapresión + anillo + drop-oldest)
+    _Atomic uint32_t send_us_last;  // Duración del último send_frame_async
+    _Atomic uint64_t send_us_total; // Acumulado para promediar
+    _Atomic uint64_t resid_us_total; // Espera acumulada en el anillo:
+                                     // residencia alta = el cuello está
+                                     // en este cliente, no en el origen
+    _Atomic uint32_t last_send_ms;   // Último envío exitoso (0 = nunca)
+} ws_tx_client_stats_t;
+
+static ws_tx_client_stats_t s_tx_stats[MAX_WS_CLIENTS];
+
+// Última secuencia emitida por fuente (la escribe broadcast_video_frame)
+static uint32_t s_frame_sequence[2] = {0, 0};
+
+static void ws_tx_stats_reset(int slot)
+{
+    atomic_store_explicit(&s_tx_stats[slot].delivered, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_tx_stats[slot].dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_tx_stats[slot].send_us_last, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_tx_stats[slot].send_us_total, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_tx_stats[slot].resid_us_total, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_tx_stats[slot].last_send_ms, 0, memory_order_relaxed);
+}
+
+// ============================================================================
+// RITMO POR CONSUMIDOR A PARTIR DE LOS REPORTES DE RECEPCIÓN
+// ============================================================================
+// El dashboard siempre calculó su FPS real de decode en el navegador,
+// pero ese número nunca volvía: el servidor empujaba al ritmo de
+// producción y la diferencia se acumulaba en las colas TCP del cliente
+// lento. Con los reportes de recepción el broadcast espacia los frames
+// de cada consumidor a lo que ese consumidor demostró sostener, y el
+// techo de stream_status hacia el vehículo baja al del espectador más
+// lento. Un dashboard viejo que no reporta queda como hasta ahora. Los
+// campos rr_* los escribe el worker de httpd (recepción) y los lee el
+// broadcast; son palabras de 32 bits y un valor de un reporte atrás no
+// rompe nada.
+
+static void ws_rr_note_report(ws_client_t *client, frame_source_t source,
+                              uint32_t fps, uint32_t seq)
+{
+    // 0 decodificados (pestaña oculta, navegador ahogado) no es "sin
+    // reporte": se lo baja a 1 fps hasta que vuelva a pintar
+    if (fps == 0)
+    {
+        fps = 1;
+    }
+
+    client->rr_fps[source] = (fps > 255) ? 255 : (uint8_t)fps;
+    client->rr_seq[source] = seq;
+    client->rr_ms[source] = (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/**
+ * Intervalo mínimo entre frames de source para este cliente según su
+ * último reporte; 0 = sin ritmo propio (no reportó o el reporte venció)
+ */
+static uint32_t ws_rr_min_interval_ms(const ws_client_t *client,
+                                      frame_source_t source,
+                                      uint32_t now_ms)
+{
+    uint8_t fps = client->rr_fps[source];
+    if (fps == 0 || now_ms - client->rr_ms[source] > WS_RR_FRESH_MS)
+    {
+        return 0;
+    }
+
+    // Más de un segundo de secuencias sin ver: el tramo hacia este
+    // cliente está congestionado; bajar a la mitad de lo reportado
+    // hasta que el próximo reporte acerque la secuencia
+    uint32_t effective = fps;
+    if (s_frame_sequence[source] - client->rr_seq[source] > fps)
+    {
+        effective = (fps > 1) ? fps / 2u : 1;
+    }
+
+    return 1000u / (effective + WS_RR_FPS_HEADROOM);
+}
+
+/**
+ * FPS del espectador más lento suscripto a source con reporte vigente
+ * (0 = nadie reportó); congested marca si alguno acumula más de un
+ * segundo de secuencias sin ver
+ */
+static uint8_t ws_rr_render_cap(frame_source_t source, bool *congested)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint8_t cap = 0;
+
+    if (congested)
+    {
+        *congested = false;
+    }
+
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        const ws_client_t *c = &ws_clients[i];
+        if (c->fd == -1 || c->role != WS_ROLE_DASHBOARD ||
+            !(c->sub_mask & WS_SUB_BIT(source)))
+        {
+            continue;
+        }
+        if (c->rr_fps[source] == 0 || now_ms - c->rr_ms[source] > WS_RR_FRESH_MS)
+        {
+            continue;
+        }
+
+        if (cap == 0 || c->rr_fps[source] < cap)
+        {
+            cap = c->rr_fps[source];
+        }
+        if (congested &&
+            s_frame_sequence[source] - c->rr_seq[source] > c->rr_fps[source])
+        {
+            *congested = true;
+        }
+    }
+
+    return cap;
+}
+
+/**
+ * Agrega el bloque "delivery" a un mensaje vehicle_list: una entrada
+ * por cliente conectado con los contadores del camino de envío. Con
+ * esto el operador ubica el salto congestionado desde el dashboard:
+ * residencia alta en un solo cliente es SU WiFi; descartes en todos,
+ * el aire del SoftAP; edad alta con residencia baja, el origen
+ */
+static void ws_delivery_stats_add(cJSON *root)
+{
+    cJSON *delivery = cJSON_AddArrayToObject(root, "delivery");
+    if (!delivery)
+    {
+        return;
+    }
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd == -1 || ws_clients[i].role == WS_ROLE_UNKNOWN)
+        {
+            continue;
+        }
+
+        cJSON *entry = cJSON_CreateObject();
+        if (!entry)
+        {
+            return;
+        }
+
+        bool is_vehicle = (ws_clients[i].role == WS_ROLE_VEHICLE);
+        uint32_t delivered = atomic_load_explicit(&s_tx_stats[i].delivered,
+                                                  memory_order_relaxed);
+        uint64_t resid_us = atomic_load_explicit(&s_tx_stats[i].resid_us_total,
+                                                 memory_order_relaxed);
+        uint32_t last_ms = atomic_load_explicit(&s_tx_stats[i].last_send_ms,
+                                                memory_order_relaxed);
+
+        cJSON_AddStringToObject(entry, "role", is_vehicle ? "vehicle" : "dashboard");
+        if (is_vehicle && ws_clients[i].vehicle_id[0] != '\0')
+        {
+            cJSON_AddStringToObject(entry, "id", ws_clients[i].vehicle_id);
+        }
+        else
+        {
+            char anon[16];
+            snprintf(anon, sizeof(anon), "fd%d", ws_clients[i].fd);
+            cJSON_AddStringToObject(entry, "id", anon);
+        }
+        cJSON_AddNumberToObject(entry, "sent", delivered);
+        cJSON_AddNumberToObject(entry, "dropped",
+                                atomic_load_explicit(&s_tx_stats[i].dropped,
+                                                     memory_order_relaxed));
+        // Promedio de espera en el anillo de transmisión, en ms
+        cJSON_AddNumberToObject(entry, "resid_ms",
+                                delivered ? (double)(resid_us / delivered) / 1000.0
+                                          : 0);
+        // Edad del último envío exitoso; -1 = nunca se le envió nada
+        cJSON_AddNumberToObject(entry, "age_ms",
+                                last_ms ? (double)(now_ms - last_ms) : -1);
+        cJSON_AddItemToArray(delivery, entry);
+    }
+}
+
+/**
+ * Encola un mensaje en el anillo de un cliente. Toma su propia
+ * referencia sobre el buffer; el llamador conserva la suya. Con el
+ * anillo lleno descarta sin bloquear: el camino de video jamás debe
+ * frenar al productor.
+ */
+static esp_err_t ws_tx_push_ex(int fd, httpd_ws_type_t type,
+                               ws_shared_buf_t *shared, uint32_t offset,
+                               uint32_t len, bool final, ws_tx_prio_t prio)
+{
+    if (!server || s_tx_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int slot = ws_client_slot(fd);
+    if (slot < 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Contrapresión por cliente: video solo si el cliente viene al día.
+    // Control y estado siempre entran; son chicos y no negociables.
+    if (prio == WS_TX_PRIO_VIDEO &&
+        atomic_load_explicit(&s_tx_pending_bytes[slot], memory_order_relaxed) >
+            WS_TX_MAX_PENDING_BYTES)
+    {
+        atomic_fetch_add_explicit(&s_tx_dropped[prio], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&s_tx_stats[slot].dropped, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ws_tx_ring_t *ring = &s_tx_rings[slot][prio];
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    for (;;)
+    {
+        ws_tx_cell_t *cell = &ring->cells[pos & (WS_TX_RING_SIZE - 1)];
+        uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+
+        if (dif == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                cell->msg.fd = fd;
+                cell->msg.type = type;
+                cell->msg.shared = shared;
+                cell->msg.offset = offset;
+                cell->msg.len = len;
+                cell->msg.enq_us = (uint32_t)esp_timer_get_time();
+                cell->msg.final = final;
+                ws_shared_buf_ref(shared);
+                atomic_fetch_add_explicit(&s_tx_pending_bytes[slot],
+                                          len, memory_order_relaxed);
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                xTaskNotifyGive(s_tx_task_handle);
+                return ESP_OK;
+            }
+        }
+        else if (dif < 0)
+        {
+            atomic_fetch_add_explicit(&s_tx_dropped[prio], 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s_tx_stats[slot].dropped, 1, memory_order_relaxed);
+            return ESP_ERR_NO_MEM;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+}
+
+static esp_err_t ws_tx_push(int fd, httpd_ws_type_t type,
+                            ws_shared_buf_t *shared, ws_tx_prio_t prio)
+{
+    return ws_tx_push_ex(fd, type, shared, 0, (uint32_t)shared->len, true, prio);
+}
+
+/**
+ * Saca el próximo mensaje del anillo de un cliente; false si está vacío
+ */
+static bool ws_tx_pop(int slot, ws_tx_prio_t prio, ws_tx_msg_t *out)
+{
+    ws_tx_ring_t *ring = &s_tx_rings[slot][prio];
+    ws_tx_cell_t *cell = &ring->cells[ring->tail & (WS_TX_RING_SIZE - 1)];
+    uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+    if ((int32_t)(seq - (ring->tail + 1)) < 0)
+    {
+        return false;
+    }
+
+    *out = cell->msg;
+    atomic_store_explicit(&cell->seq, ring->tail + WS_TX_RING_SIZE,
+                          memory_order_release);
+    ring->tail++;
+    atomic_fetch_sub_explicit(&s_tx_pending_bytes[slot],
+                              out->len, memory_order_relaxed);
+    return true;
+}
+
+static void ws_tx_send(const ws_tx_msg_t *msg)
+{
+    // Si el cliente ya se desconectó, el fd del mensaje quedó viejo y
+    // el envío falla: descartar sin tocar la tabla de clientes
+    int slot = ws_client_slot(msg->fd);
+    if (server != NULL && slot >= 0)
+    {
+        httpd_ws_frame_t frame = {
+            .type = msg->type,
+            .payload = msg->shared->data + msg->offset,
+            .len = msg->len,
+            .fragmented = !ws_tx_msg_is_whole(msg),
+            .final = msg->final,
+        };
+
+        int64_t start_us = esp_timer_get_time();
+        TRACE_REGION_ENTER(TRACE_ID_WS_SEND);
+        esp_err_t err = httpd_ws_send_frame_async(server, msg->fd, &frame);
+        TRACE_REGION_EXIT(TRACE_ID_WS_SEND);
+        uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Error enviando frame a fd=%d: %s",
+                     msg->fd, esp_err_to_name(err));
+            ws_remove_client(msg->fd);
+        }
+        else
+        {
+            atomic_fetch_add_explicit(&s_tx_stats[slot].delivered, 1,
+                                      memory_order_relaxed);
+            atomic_store_explicit(&s_tx_stats[slot].send_us_last, elapsed_us,
+                                  memory_order_relaxed);
+            atomic_fetch_add_explicit(&s_tx_stats[slot].send_us_total, elapsed_us,
+                                      memory_order_relaxed);
+            atomic_fetch_add_explicit(&s_tx_stats[slot].resid_us_total,
+                                      (uint32_t)start_us - msg->enq_us,
+                                      memory_order_relaxed);
+            atomic_store_explicit(&s_tx_stats[slot].last_send_ms,
+                                  (uint32_t)(start_us / 1000),
+                                  memory_order_relaxed);
+        }
+    }
+
+    ws_shared_buf_unref(msg->shared);
+}
+
+// Mensaje fragmentado en curso por cliente (relevo directo): mientras
+// esté abierto no se puede intercalar ningún otro frame de datos en esa
+// conexión (lo prohíbe el protocolo WebSocket), así que control y
+// estado hacia ese fd esperan al bit FIN. Solo lo toca esta tarea.
+static bool s_tx_frag_open[MAX_WS_CLIENTS];
+
+static void ws_tx_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Tarea de transmisión WebSocket iniciada");
+    uint32_t reported_drops = 0;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        bool pending = true;
+        while (pending)
+        {
+            ws_tx_msg_t msg;
+
+            // Control y estado: vaciar por completo antes de tocar video
+            for (ws_tx_prio_t prio = WS_TX_PRIO_CONTROL; prio <= WS_TX_PRIO_STATUS; prio++)
+            {
+                for (int slot = 0; slot < MAX_WS_CLIENTS; slot++)
+                {
+                    if (s_tx_frag_open[slot])
+                    {
+                        // Mensaje a medias en esa conexión: diferir
+                        // hasta el FIN (o soltar el estado si el
+                        // cliente ya se fue y quedó colgado)
+                        if (ws_clients[slot].fd != -1)
+                        {
+                            continue;
+                        }
+                        s_tx_frag_open[slot] = false;
+                    }
+                    while (ws_tx_pop(slot, prio, &msg))
+                    {
+                        ws_tx_send(&msg);
+                    }
+                }
+            }
+
+            // Video: frames enteros y fragmentos del relevo directo
+            // comparten el anillo; los fragmentos salen en orden
+            // estricto, los enteros se colapsan al más nuevo
+            pending = false;
+            for (int slot = 0; slot < MAX_WS_CLIENTS; slot++)
+            {
+                if (!ws_tx_pop(slot, WS_TX_PRIO_VIDEO, &msg))
+                {
+                    continue;
+                }
+                pending = true;
+
+                if (s_tx_frag_open[slot] || !ws_tx_msg_is_whole(&msg))
+                {
+                    if (s_tx_frag_open[slot] && ws_tx_msg_is_whole(&msg))
+                    {
+                        // Un frame entero coló entre dos fragmentos
+                        // (carrera de suscripción): no se puede
+                        // intercalar, se pierde ese frame
+                        ws_shared_buf_unref(msg.shared);
+                        atomic_fetch_add_explicit(&s_tx_dropped[WS_TX_PRIO_VIDEO],
+                                                  1, memory_order_relaxed);
+                        atomic_fetch_add_explicit(&s_tx_stats[slot].dropped, 1,
+                                                  memory_order_relaxed);
+                        continue;
+                    }
+                    // Fragmento del relevo directo: orden estricto y
+                    // sin colapsar, el FIN reabre la conexión
+                    s_tx_frag_open[slot] = !msg.final;
+                    ws_tx_send(&msg);
+                    continue;
+                }
+
+                // Frames enteros: si hay más de uno encolado, el
+                // cliente viene atrasado; descartar los viejos y
+                // enviar solo el más nuevo. Un frame por cliente por
+                // pasada, así un comando recién llegado sale antes que
+                // el siguiente JPEG.
+                ws_tx_msg_t newer;
+                while (ws_tx_pop(slot, WS_TX_PRIO_VIDEO, &newer))
+                {
+                    if (!ws_tx_msg_is_whole(&newer))
+                    {
+                        // Arrancó un mensaje fragmentado detrás: el
+                        // entero sale primero (orden de llegada) y el
+                        // fragmento inmediatamente después
+                        ws_tx_send(&msg);
+                        s_tx_frag_open[slot] = !newer.final;
+                        msg = newer;
+                        break;
+                    }
+                    ws_shared_buf_unref(msg.shared);
+                    atomic_fetch_add_explicit(&s_tx_dropped[WS_TX_PRIO_VIDEO],
+                                              1, memory_order_relaxed);
+                    atomic_fetch_add_explicit(&s_tx_stats[slot].dropped, 1,
+                                              memory_order_relaxed);
+                    msg = newer;
+                }
+                ws_tx_send(&msg);
+            }
+        }
+
+        // Difusiones de lista de vehículos diferidas por coalescencia.
+        // Además del dirty por membresía, un refresco periódico mantiene
+        // frescas las estadísticas de entrega que viajan en la lista
+        int64_t now_us = esp_timer_get_time();
+        if (ws_dashboard_count > 0 &&
+            now_us - s_vehicle_list_last_us >=
+                (int64_t)WS_DELIVERY_REFRESH_MS * 1000)
+        {
+            // Misma ruta que un cambio de membresía: sin subir la
+            // versión el dashboard descartaría la lista como repetida
+            ws_broadcast_vehicle_list();
+        }
+        ws_vehicle_list_flush_if_due();
+
+        uint32_t dropped = atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_VIDEO],
+                                                memory_order_relaxed);
+        if (dropped != reported_drops)
+        {
+            ESP_LOGD(TAG, "%lu frames de video descartados (anillo lleno)",
+                     (unsigned long)(dropped - reported_drops));
+            reported_drops = dropped;
+        }
+    }
+}
+
+static esp_err_t ws_tx_task_start(void)
 {
-    ws_async_packet_t *packet = (ws_async_packet_t *)arg;
+    if (s_tx_task_handle != NULL)
+    {
+        return ESP_OK;
+    }
 
-    if (packet->frame.len > 0)
+    for (int slot = 0; slot < MAX_WS_CLIENTS; slot++)
     {
-        packet->frame.payload = packet->payload;
+        for (int prio = 0; prio < WS_TX_PRIO_COUNT; prio++)
+        {
+            ws_tx_ring_t *ring = &s_tx_rings[slot][prio];
+            for (uint32_t i = 0; i < WS_TX_RING_SIZE; i++)
+            {
+                atomic_store_explicit(&ring->cells[i].seq, i, memory_order_relaxed);
+            }
+            atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+            ring->tail = 0;
+        }
     }
-    else
+
+    BaseType_t result = xTaskCreatePinnedToCore(ws_tx_task,
+                                                "ws_tx",
+                                                WS_TX_TASK_STACK_SIZE,
+                                                NULL,
+                                                WS_TX_TASK_PRIORITY,
+                                                &s_tx_task_handle,
+                                                WS_TX_TASK_CORE_ID);
+    if (result != pdPASS)
     {
-        packet->frame.payload = NULL;
+        ESP_LOGE(TAG, "Error creando tarea de transmisión");
+        s_tx_task_handle = NULL;
+        return ESP_FAIL;
     }
 
-    esp_err_t err = httpd_ws_send_frame_async(packet->server, packet->fd, &packet->frame);
-    if (err != ESP_OK)
+    return ESP_OK;
+}
+
+/**
+ * Copia el payload a un buffer compartido y lo encola con su prioridad
+ */
+static esp_err_t ws_queue_frame_prio(int fd,
+                                     httpd_ws_type_t type,
+                                     const uint8_t *data,
+                                     size_t len,
+                                     ws_tx_prio_t prio)
+{
+    ws_shared_buf_t *shared = ws_shared_buf_alloc(len);
+    if (shared == NULL)
+    {
+        ESP_LOGE(TAG, "Sin memoria para enviar frame (%zu bytes)", len);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (len > 0 && data)
     {
-        ESP_LOGW(TAG, "Error enviando frame a fd=%d: %s", packet->fd, esp_err_to_name(err));
+        memcpy(shared->data, data, len);
     }
 
-    free(packet);
+    esp_err_t err = ws_tx_push(fd, type, shared, prio);
+    ws_shared_buf_unref(shared);
+    return err;
 }
 
 static esp_err_t ws_queue_frame(int fd,
@@ -429,327 +2364,865 @@ static esp_err_t ws_queue_frame(int fd,
                                 const uint8_t *data,
                                 size_t len)
 {
-    if (!server)
+    return ws_queue_frame_prio(fd, type, data, len, WS_TX_PRIO_STATUS);
+}
+
+/**
+ * Encola un envío que referencia un buffer compartido en lugar de
+ * copiarlo. Toma su propia referencia; el llamador conserva la suya.
+ */
+static esp_err_t ws_queue_frame_shared(int fd,
+                                       httpd_ws_type_t type,
+                                       ws_shared_buf_t *shared)
+{
+    return ws_tx_push(fd, type, shared, WS_TX_PRIO_VIDEO);
+}
+
+static const char *frame_source_to_string(frame_source_t source)
+{
+    switch (source)
     {
-        return ESP_ERR_INVALID_STATE;
+    case FRAME_SOURCE_ESP32CAM:
+        return "esp32cam";
+    case FRAME_SOURCE_ESP32S3:
+    default:
+        return "esp32s3";
+    }
+}
+
+static esp_err_t broadcast_video_frame(frame_source_t source,
+                                       const uint8_t *jpeg_data,
+                                       size_t jpeg_len,
+                                       int exclude_fd,
+                                       uint32_t capture_ms);
+static esp_err_t broadcast_shared_frame(frame_source_t source,
+                                        ws_shared_buf_t *shared,
+                                        int exclude_fd,
+                                        uint32_t capture_ms);
+
+// ============================================================================
+// FRAMES ENLATADOS
+// ============================================================================
+// Cuando un vehículo se cae, el canvas del dashboard quedaba congelado
+// en el último frame sin ningún indicio y el operador perdía segundos
+// cliqueando un vehículo muerto. Estos JPEG diminutos van embebidos en
+// el binario (EMBED_FILES) y salen por el camino normal de broadcast en
+// el instante del evento: la respuesta visual cuesta bytes, no una
+// pasada del encoder, y el dashboard los dibuja como un frame más.
+
+extern const uint8_t signal_lost_jpg_start[] asm("_binary_signal_lost_jpg_start");
+extern const uint8_t signal_lost_jpg_end[] asm("_binary_signal_lost_jpg_end");
+extern const uint8_t veto_active_jpg_start[] asm("_binary_veto_active_jpg_start");
+extern const uint8_t veto_active_jpg_end[] asm("_binary_veto_active_jpg_end");
+
+static void ws_send_canned_frame(const uint8_t *start, const uint8_t *end)
+{
+    // Con la secuencia del feed del vehículo: para el dashboard es el
+    // frame más nuevo de esa fuente y reemplaza al congelado
+    broadcast_video_frame(FRAME_SOURCE_ESP32CAM, start,
+                          (size_t)(end - start), -1, 0);
+}
+
+static void ws_send_signal_lost_frame(void)
+{
+    ws_send_canned_frame(signal_lost_jpg_start, signal_lost_jpg_end);
+}
+
+static void ws_send_veto_frame(void)
+{
+    ws_send_canned_frame(veto_active_jpg_start, veto_active_jpg_end);
+}
+
+/**
+ * Reserva un buffer compartido con lugar para la cabecera de frame más
+ * payload_len bytes de payload. El llamador escribe el payload en
+ * data + sizeof(ws_frame_header_t); la cabecera la completa
+ * broadcast_shared_frame.
+ */
+static ws_shared_buf_t *ws_frame_buf_alloc(size_t payload_len)
+{
+    return ws_shared_buf_alloc(sizeof(ws_frame_header_t) + payload_len);
+}
+
+static void ws_remove_client(int fd)
+{
+    int slot = ws_client_slot(fd);
+    if (slot < 0)
+    {
+        return;
+    }
+
+    ws_client_t *client = &ws_clients[slot];
+    bool was_vehicle = (client->role == WS_ROLE_VEHICLE && client->vehicle_id[0] != '\0');
+    bool was_dashboard = (client->role == WS_ROLE_DASHBOARD);
+
+    // Capturar el id antes de limpiar el slot: el aviso de pérdida sale
+    // después de la limpieza para que el broadcast no cuente a este fd
+    char lost_vehicle_id[32];
+    lost_vehicle_id[0] = '\0';
+    if (was_vehicle)
+    {
+        strlcpy(lost_vehicle_id, client->vehicle_id, sizeof(lost_vehicle_id));
+    }
+
+    if (was_dashboard && ws_dashboard_count > 0)
+    {
+        ws_dashboard_count--;
+        ws_update_stream_status_for_vehicles();
+    }
+
+    client->fd = -1;
+    client->role = WS_ROLE_UNKNOWN;
+    client->sub_mask = 0;
+    client->fast_relay = false;
+    client->vehicle_id[0] = '\0';
+    s_fd_to_slot[fd] = -1;
+    if (ws_clients_count > 0)
+    {
+        ws_clients_count--;
+    }
+
+    ESP_LOGI(TAG, "Cliente WebSocket removido, fd=%d, total=%d", fd, ws_clients_count);
+
+    if (was_vehicle)
+    {
+        ws_vehicle_hash_rebuild();
+        ws_registry_note(lost_vehicle_id, false);
+        ws_broadcast_vehicle_list();
+        // Un vehículo menos transmitiendo: los demás recuperan ritmo
+        ws_update_stream_status_for_vehicles();
+
+        // Respuesta visual instantánea: frame enlatado sobre el feed
+        // congelado más el aviso explícito para la interfaz
+        ws_send_signal_lost_frame();
+
+        char lost[96];
+        int n = snprintf(lost, sizeof(lost),
+                         "{\"type\":\"vehicle_lost\",\"vehicle_id\":\"%s\"}",
+                         lost_vehicle_id);
+        if (n > 0 && n < (int)sizeof(lost))
+        {
+            for (int i = 0; i < MAX_WS_CLIENTS; i++)
+            {
+                if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD)
+                {
+                    ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_TEXT,
+                                        (const uint8_t *)lost, (size_t)n,
+                                        WS_TX_PRIO_STATUS);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Manejador de página web principal
+ *
+ * El dashboard vive en index.html (editable) y se embebe gzipeado en el
+ * binario vía EMBED_FILES; tras editar el HTML hay que regenerar el .gz:
+ *
+ *     gzip -9 -n -c index.html > index.html.gz
+ *
+ * Servirlo comprimido (12KB -> 4KB) y con Cache-Control le ahorra al
+ * SoftAP el grueso de la recarga en cada reconexión del operador.
+ */
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+
+static esp_err_t index_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "Cache-Control", "max-age=300");
+    return httpd_resp_send(req,
+                           (const char *)index_html_gz_start,
+                           index_html_gz_end - index_html_gz_start);
+}
+
+/**
+ * GET /stats: radiografía del camino de transmisión en JSON. Por
+ * cliente: entregados, descartados, bytes encolados y latencia del
+ * envío asíncrono; por fuente: la última secuencia emitida (un hueco
+ * entre este número y lo que vio el dashboard es un frame perdido de
+ * ese feed). Se arma por chunks con snprintf para no cargar la pila
+ * del worker de httpd.
+ */
+static esp_err_t stats_handler(httpd_req_t *req)
+{
+    char chunk[256];
+    int len;
+
+    httpd_resp_set_type(req, "application/json");
+
+    len = snprintf(chunk, sizeof(chunk),
+                   "{\"uptime_ms\":%lu,\"clients\":%u,"
+                   "\"seq\":{\"esp32s3\":%lu,\"esp32cam\":%lu},"
+                   "\"tx_dropped\":{\"control\":%lu,\"status\":%lu,\"video\":%lu},",
+                   (unsigned long)(esp_timer_get_time() / 1000),
+                   ws_clients_count,
+                   (unsigned long)s_frame_sequence[FRAME_SOURCE_ESP32S3],
+                   (unsigned long)s_frame_sequence[FRAME_SOURCE_ESP32CAM],
+                   (unsigned long)atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_CONTROL],
+                                                       memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_STATUS],
+                                                       memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_VIDEO],
+                                                       memory_order_relaxed));
+    if (len > 0)
+    {
+        httpd_resp_send_chunk(req, chunk, len);
+    }
+
+    // Camino de captura: con GRAB_LATEST el driver pisa frames sin
+    // avisar cuando visión se atrasa; el wrapper los estima por huecos
+    // de timestamp y mide la edad captura->fb_get
+    camera_capture_stats_t cap;
+    camera_capture_get_stats(&cap);
+    len = snprintf(chunk, sizeof(chunk),
+                   "\"capture\":{\"consumed\":%lu,\"failed\":%lu,"
+                   "\"overwritten\":%lu,\"age_us_avg\":%lu,"
+                   "\"age_us_max\":%lu,\"age_us_last\":%lu},",
+                   (unsigned long)cap.consumed, (unsigned long)cap.failed,
+                   (unsigned long)cap.overwritten,
+                   (unsigned long)(cap.consumed ? cap.age_us_total / cap.consumed
+                                                : 0),
+                   (unsigned long)cap.age_us_max,
+                   (unsigned long)cap.age_us_last);
+    if (len > 0 && len < (int)sizeof(chunk))
+    {
+        httpd_resp_send_chunk(req, chunk, len);
+    }
+
+    // Agotamientos del token bucket de aire, frames del relevo directo
+    // y marcas de agua de la arena de scratch de visión
+    size_t arena_int_hwm = 0;
+    size_t arena_psram_hwm = 0;
+    mem_arena_high_water(&arena_int_hwm, &arena_psram_hwm);
+
+    len = snprintf(chunk, sizeof(chunk),
+                   "\"air_exhausted\":{\"esp32s3\":%lu,\"esp32cam\":%lu},"
+                   "\"fast_relay_frames\":%lu,"
+                   "\"arena_hwm\":{\"internal\":%u,\"psram\":%u},"
+                   "\"per_client\":[",
+                   (unsigned long)atomic_load_explicit(
+                       &s_air_exhausted[FRAME_SOURCE_ESP32S3], memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(
+                       &s_air_exhausted[FRAME_SOURCE_ESP32CAM], memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(&s_fast_frames,
+                                                       memory_order_relaxed),
+                   (unsigned)arena_int_hwm, (unsigned)arena_psram_hwm);
+    if (len > 0)
+    {
+        httpd_resp_send_chunk(req, chunk, len);
+    }
+
+    bool first = true;
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd == -1)
+        {
+            continue;
+        }
+
+        uint32_t delivered = atomic_load_explicit(&s_tx_stats[i].delivered,
+                                                  memory_order_relaxed);
+        uint64_t total_us = atomic_load_explicit(&s_tx_stats[i].send_us_total,
+                                                 memory_order_relaxed);
+        uint64_t resid_us = atomic_load_explicit(&s_tx_stats[i].resid_us_total,
+                                                 memory_order_relaxed);
+        const char *role = (ws_clients[i].role == WS_ROLE_VEHICLE)     ? "vehicle"
+                           : (ws_clients[i].role == WS_ROLE_DASHBOARD) ? "dashboard"
+                                                                       : "unknown";
+
+        len = snprintf(chunk, sizeof(chunk),
+                       "%s{\"fd\":%d,\"role\":\"%s\",\"vehicle_id\":\"%s\","
+                       "\"queued_bytes\":%lu,\"delivered\":%lu,\"dropped\":%lu,"
+                       "\"send_us_avg\":%lu,\"send_us_last\":%lu,"
+                       "\"resid_us_avg\":%lu,\"rr_fps\":[%u,%u]}",
+                       first ? "" : ",",
+                       ws_clients[i].fd, role, ws_clients[i].vehicle_id,
+                       (unsigned long)atomic_load_explicit(&s_tx_pending_bytes[i],
+                                                           memory_order_relaxed),
+                       (unsigned long)delivered,
+                       (unsigned long)atomic_load_explicit(&s_tx_stats[i].dropped,
+                                                           memory_order_relaxed),
+                       (unsigned long)(delivered ? total_us / delivered : 0),
+                       (unsigned long)atomic_load_explicit(&s_tx_stats[i].send_us_last,
+                                                           memory_order_relaxed),
+                       (unsigned long)(delivered ? resid_us / delivered : 0),
+                       (unsigned)ws_clients[i].rr_fps[FRAME_SOURCE_ESP32S3],
+                       (unsigned)ws_clients[i].rr_fps[FRAME_SOURCE_ESP32CAM]);
+        if (len > 0 && len < (int)sizeof(chunk))
+        {
+            httpd_resp_send_chunk(req, chunk, len);
+            first = false;
+        }
+    }
+
+    uint16_t p50, p90, p99;
+    ws_latency_percentiles(s_probe_rtt_ms, s_probe_count, &p50, &p90, &p99);
+    len = snprintf(chunk, sizeof(chunk),
+                   "],\"probe\":{\"count\":%u,\"p50_ms\":%u,\"p90_ms\":%u,"
+                   "\"p99_ms\":%u},",
+                   s_probe_count, p50, p90, p99);
+    if (len > 0 && len < (int)sizeof(chunk))
+    {
+        httpd_resp_send_chunk(req, chunk, len);
+    }
+
+    // Entrega de comandos por tramo: rx_lost son huecos de secuencia
+    // del dashboard, ack_lost son reenvíos al vehículo sin acusar, y
+    // los percentiles cubren el ida y vuelta servidor→vehículo→servidor
+    uint16_t a50, a90, a99;
+    ws_latency_percentiles(s_cmdack_rtt_ms, s_cmdack_count, &a50, &a90, &a99);
+    len = snprintf(chunk, sizeof(chunk),
+                   "\"cmd\":{\"rx\":%lu,\"rx_lost\":%lu,\"fwd\":%lu,"
+                   "\"acked\":%lu,\"ack_lost\":%lu,\"ack_p50_ms\":%u,"
+                   "\"ack_p90_ms\":%u,\"ack_p99_ms\":%u}}",
+                   (unsigned long)s_cmd_rx_count, (unsigned long)s_cmd_rx_lost,
+                   (unsigned long)s_cmd_fwd_count, (unsigned long)s_cmd_ack_count,
+                   (unsigned long)s_cmd_ack_lost, a50, a90, a99);
+    if (len > 0 && len < (int)sizeof(chunk))
+    {
+        httpd_resp_send_chunk(req, chunk, len);
     }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/**
+ * Proveedor de métricas del servidor WS y el relevo: los mismos
+ * contadores que /stats pero en nombres estables de Prometheus, para
+ * que el monitoreo de la LAN los guarde como series de tiempo. Los
+ * números por cliente quedan en /stats (los fd rotan y como etiqueta
+ * harían explotar la cardinalidad).
+ */
+static void ws_metrics_provider(metrics_writer_t *w)
+{
+    metrics_printf(w,
+                   "# TYPE minitesla_ws_clients gauge\n"
+                   "minitesla_ws_clients %u\n",
+                   ws_clients_count);
+
+    metrics_printf(w,
+                   "# TYPE minitesla_ws_tx_dropped_total counter\n"
+                   "minitesla_ws_tx_dropped_total{prio=\"control\"} %lu\n"
+                   "minitesla_ws_tx_dropped_total{prio=\"status\"} %lu\n"
+                   "minitesla_ws_tx_dropped_total{prio=\"video\"} %lu\n",
+                   (unsigned long)atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_CONTROL],
+                                                       memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_STATUS],
+                                                       memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_VIDEO],
+                                                       memory_order_relaxed));
+
+    metrics_printf(w,
+                   "# TYPE minitesla_frames_total counter\n"
+                   "minitesla_frames_total{source=\"esp32s3\"} %lu\n"
+                   "minitesla_frames_total{source=\"esp32cam\"} %lu\n",
+                   (unsigned long)s_frame_sequence[FRAME_SOURCE_ESP32S3],
+                   (unsigned long)s_frame_sequence[FRAME_SOURCE_ESP32CAM]);
+
+    metrics_printf(w,
+                   "# TYPE minitesla_air_exhausted_total counter\n"
+                   "minitesla_air_exhausted_total{source=\"esp32s3\"} %lu\n"
+                   "minitesla_air_exhausted_total{source=\"esp32cam\"} %lu\n",
+                   (unsigned long)atomic_load_explicit(
+                       &s_air_exhausted[FRAME_SOURCE_ESP32S3], memory_order_relaxed),
+                   (unsigned long)atomic_load_explicit(
+                       &s_air_exhausted[FRAME_SOURCE_ESP32CAM], memory_order_relaxed));
+
+    metrics_printf(w,
+                   "# TYPE minitesla_relay_frames_total counter\n"
+                   "minitesla_relay_frames_total %lu\n",
+                   (unsigned long)atomic_load_explicit(&s_fast_frames,
+                                                       memory_order_relaxed));
+
+    // Comandos por tramo: perdidos en recepción (huecos de secuencia
+    // del dashboard) y reenvíos al vehículo sin acusar
+    metrics_printf(w,
+                   "# TYPE minitesla_cmd_rx_total counter\n"
+                   "minitesla_cmd_rx_total %lu\n"
+                   "# TYPE minitesla_cmd_rx_lost_total counter\n"
+                   "minitesla_cmd_rx_lost_total %lu\n"
+                   "# TYPE minitesla_cmd_ack_lost_total counter\n"
+                   "minitesla_cmd_ack_lost_total %lu\n",
+                   (unsigned long)s_cmd_rx_count, (unsigned long)s_cmd_rx_lost,
+                   (unsigned long)s_cmd_ack_lost);
+
+    // Percentiles de la ventana vigente como gauges (la ventana rota,
+    // así que no son acumulativos)
+    uint16_t p50, p90, p99;
+    ws_latency_percentiles(s_cmdack_rtt_ms, s_cmdack_count, &p50, &p90, &p99);
+    metrics_printf(w,
+                   "# TYPE minitesla_cmd_ack_rtt_ms gauge\n"
+                   "minitesla_cmd_ack_rtt_ms{quantile=\"0.5\"} %u\n"
+                   "minitesla_cmd_ack_rtt_ms{quantile=\"0.9\"} %u\n"
+                   "minitesla_cmd_ack_rtt_ms{quantile=\"0.99\"} %u\n",
+                   p50, p90, p99);
+}
+
+/**
+ * GET /metrics: formato de exposición de texto de Prometheus, armado
+ * por el registro (metrics.c) a partir de los proveedores que cada
+ * componente registró en su init. Sale por chunks con el mismo patrón
+ * que /stats.
+ */
+static esp_err_t metrics_sink_httpd(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    metrics_writer_t writer = {.sink = metrics_sink_httpd, .ctx = req};
+    metrics_render(&writer);
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// ============================================================================
+// STREAMING MJPEG POR HTTP (FALLBACK PARA KIOSCOS)
+// ============================================================================
+// Algunas estaciones solo necesitan píxeles, sin el dashboard ni su JS.
+// broadcast_video_frame deja el último frame de cada fuente en un slot
+// atómico; cada conexión a /mjpeg lo toma (exchange, con su referencia),
+// lo envía como parte multipart y lo devuelve con un CAS para que otros
+// lectores lo encuentren. El ritmo es por conexión (?fps=N) y los
+// paquetes de tiles delta se saltean: MJPEG solo entiende JPEG.
+// Cada espectador ocupa un worker de httpd mientras dura la conexión.
+
+#define WS_MJPEG_DEFAULT_FPS 10
+#define WS_MJPEG_BOUNDARY "frame"
+
+static ws_shared_buf_t *_Atomic s_last_frame[2];
+
+static esp_err_t mjpeg_handler(httpd_req_t *req)
+{
+    frame_source_t source = strstr(req->uri, "source=esp32cam")
+                                ? FRAME_SOURCE_ESP32CAM
+                                : FRAME_SOURCE_ESP32S3;
+
+    int fps = WS_MJPEG_DEFAULT_FPS;
+    const char *fps_arg = strstr(req->uri, "fps=");
+    if (fps_arg)
+    {
+        fps = atoi(fps_arg + 4);
+        if (fps < 1)
+        {
+            fps = 1;
+        }
+        else if (fps > 30)
+        {
+            fps = 30;
+        }
+    }
+
+    esp_err_t err = httpd_resp_set_type(
+        req, "multipart/x-mixed-replace;boundary=" WS_MJPEG_BOUNDARY);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    atomic_fetch_add_explicit(&s_mjpeg_viewers[source], 1, memory_order_relaxed);
+    if (source == FRAME_SOURCE_ESP32CAM)
+    {
+        // El vehículo tiene que enterarse de que apareció demanda
+        ws_update_stream_status_for_vehicles();
+    }
+
+    ESP_LOGI(TAG, "Espectador MJPEG conectado (%s, %d fps)",
+             frame_source_to_string(source), fps);
+
+    uint32_t last_sequence = 0;
+    const TickType_t frame_delay = pdMS_TO_TICKS(1000 / fps);
+
+    while (err == ESP_OK)
+    {
+        // Tomar el frame publicado junto con su referencia; el slot
+        // queda en NULL hasta que lo devolvamos o el broadcast publique
+        // uno nuevo
+        ws_shared_buf_t *frame = atomic_exchange_explicit(&s_last_frame[source],
+                                                          NULL,
+                                                          memory_order_acquire);
+        if (frame != NULL)
+        {
+            const ws_frame_header_t *header = (const ws_frame_header_t *)frame->data;
+            const uint8_t *payload = frame->data + sizeof(ws_frame_header_t);
+            size_t payload_len = frame->len - sizeof(ws_frame_header_t);
+
+            // Solo frames nuevos y solo JPEG (un paquete de tiles delta
+            // empieza con 'D'; un JPEG con 0xFF)
+            if (header->sequence != last_sequence &&
+                payload_len > 0 && payload[0] == 0xFF)
+            {
+                last_sequence = header->sequence;
+
+                char part[96];
+                int part_len = snprintf(part, sizeof(part),
+                                        "--" WS_MJPEG_BOUNDARY "\r\n"
+                                        "Content-Type: image/jpeg\r\n"
+                                        "Content-Length: %u\r\n\r\n",
+                                        (unsigned)payload_len);
+
+                err = httpd_resp_send_chunk(req, part, part_len);
+                if (err == ESP_OK)
+                {
+                    err = httpd_resp_send_chunk(req, (const char *)payload,
+                                                (ssize_t)payload_len);
+                }
+                if (err == ESP_OK)
+                {
+                    err = httpd_resp_send_chunk(req, "\r\n", 2);
+                }
+            }
+
+            // Devolver el frame para los demás lectores; si el broadcast
+            // ya publicó otro, soltar esta referencia
+            ws_shared_buf_t *expected = NULL;
+            if (!atomic_compare_exchange_strong_explicit(&s_last_frame[source],
+                                                         &expected, frame,
+                                                         memory_order_release,
+                                                         memory_order_relaxed))
+            {
+                ws_shared_buf_unref(frame);
+            }
+        }
+
+        if (err == ESP_OK)
+        {
+            vTaskDelay(frame_delay);
+        }
+    }
+
+    atomic_fetch_sub_explicit(&s_mjpeg_viewers[source], 1, memory_order_relaxed);
+    if (source == FRAME_SOURCE_ESP32CAM)
+    {
+        ws_update_stream_status_for_vehicles();
+    }
+
+    ESP_LOGI(TAG, "Espectador MJPEG desconectado (%s)",
+             frame_source_to_string(source));
+    return err;
+}
+
+// ============================================================================
+// REENSAMBLADO DE FRAMES BINARIOS FRAGMENTADOS
+// ============================================================================
+
+/**
+ * El ESP32-CAM envía cada JPEG en fragmentos de ~4KB (mensaje binario
+ * con frames de continuación) para no necesitar un buffer completo del
+ * lado del encoder. Los fragmentos se reciben DIRECTO sobre un buffer
+ * compartido de broadcast (ws_frame_buf_alloc): httpd_ws_recv_frame
+ * escribe cada fragmento en su posición final y al llegar el bit FIN el
+ * mismo bloque se entrega a broadcast_shared_frame sin volver a copiar.
+ * Solo hay un vehículo emitiendo binario, así que un único mensaje en
+ * curso alcanza; si otro fd inicia uno, el anterior se descarta.
+ */
+#define WS_FRAG_MAX_SIZE 32768
+
+static int s_frag_fd = -1; // -1: sin mensaje fragmentado en curso
+static size_t s_frag_len = 0;
+static ws_shared_buf_t *s_frag_shared = NULL;
+
+// ============================================================================
+// RELEVO DIRECTO: FRAGMENTOS REENVIADOS SEGÚN LLEGAN
+// ============================================================================
+// Un dashboard suscripto SOLO al feed del vehículo puede pedir
+// "fast_relay" en su subscribe: cada fragmento recibido se le encola en
+// el momento, sin esperar el frame completo. Eso recorta la latencia de
+// almacenar-y-reenviar de un frame entero a la de un solo fragmento
+// (~4KB). La restricción la pone el protocolo WebSocket: mientras el
+// mensaje fragmentado está en vuelo no puede intercalarse ningún otro
+// frame de datos en esa conexión; la tarea de transmisión lo garantiza
+// (s_tx_frag_open) y por eso el modo solo se activa sin el feed del S3
+// suscripto, que empuja frames enteros desde otra tarea. Todo este
+// estado vive en la tarea del httpd, igual que el reensamblado.
+
+typedef enum
+{
+    FRAG_FAST_OPEN = 0,   // A la espera de más fragmentos del mensaje
+    FRAG_FAST_NEED_CLOSE, // Un push falló: cerrar el mensaje trunco
+    FRAG_FAST_DONE,       // Mensaje cerrado (completo o truncado)
+} frag_fast_state_t;
+
+typedef struct
+{
+    int fd;
+    bool opened; // El primer fragmento ya salió hacia este cliente
+    uint8_t state;
+} frag_fast_recipient_t;
+
+static frag_fast_recipient_t s_frag_fast[MAX_WS_CLIENTS];
+static int s_frag_fast_count = 0;
+static bool s_frag_fast_sent = false;   // Salió al menos un fragmento
+static bool s_frag_fast_excluding = false; // Difusión del frame recién
+                                           // relevado: saltear a quien
+                                           // ya lo recibió por el atajo
+static bool ws_frag_fd_is_fast(int fd)
+{
+    for (int i = 0; i < s_frag_fast_count; i++)
+    {
+        if (s_frag_fast[i].fd == fd)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Intenta cerrar el mensaje fragmentado de un destinatario con una
+ * continuación vacía con FIN. Tras un fallo deja un JPEG truncado (el
+ * dashboard lo descarta al fallar el decode) pero la conexión queda
+ * alineada para el próximo mensaje.
+ */
+static void ws_frag_fast_try_close(frag_fast_recipient_t *rcpt)
+{
+    if (!rcpt->opened || s_frag_shared == NULL)
+    {
+        rcpt->state = FRAG_FAST_DONE;
+        return;
+    }
+    if (ws_tx_push_ex(rcpt->fd, HTTPD_WS_TYPE_CONTINUE, s_frag_shared,
+                      0, 0, true, WS_TX_PRIO_VIDEO) == ESP_OK)
+    {
+        rcpt->state = FRAG_FAST_DONE;
+    }
+}
+
+/**
+ * Reenvía la tajada recién recibida a cada destinatario del relevo
+ * directo. offset/len la delimitan dentro del buffer compartido (el
+ * primer fragmento arranca en 0 e incluye la cabecera VF).
+ */
+static void ws_frag_fast_forward(uint32_t offset, uint32_t len,
+                                 bool first, bool final)
+{
+    for (int i = 0; i < s_frag_fast_count; i++)
+    {
+        frag_fast_recipient_t *rcpt = &s_frag_fast[i];
+        if (rcpt->state == FRAG_FAST_NEED_CLOSE)
+        {
+            ws_frag_fast_try_close(rcpt);
+            continue;
+        }
+        if (rcpt->state != FRAG_FAST_OPEN)
+        {
+            continue;
+        }
+
+        httpd_ws_type_t type = first ? HTTPD_WS_TYPE_BINARY
+                                     : HTTPD_WS_TYPE_CONTINUE;
+        if (ws_tx_push_ex(rcpt->fd, type, s_frag_shared, offset, len,
+                          final, WS_TX_PRIO_VIDEO) == ESP_OK)
+        {
+            rcpt->opened = true;
+            s_frag_fast_sent = true;
+            if (final)
+            {
+                rcpt->state = FRAG_FAST_DONE;
+            }
+        }
+        else if (!rcpt->opened)
+        {
+            // El primer fragmento no entró: este cliente se pierde el
+            // frame entero, no hay mensaje que cerrar
+            rcpt->state = FRAG_FAST_DONE;
+        }
+        else
+        {
+            rcpt->state = FRAG_FAST_NEED_CLOSE;
+        }
+    }
+}
+
+static void ws_frag_reset(void)
+{
+    // Mensaje abortado a medias: cerrar lo que quedó abierto en los
+    // destinatarios del relevo y quemar la secuencia ya estampada,
+    // así el próximo frame no repite numeración en esos dashboards
+    if (s_frag_fast_count > 0 && s_frag_shared != NULL)
+    {
+        for (int i = 0; i < s_frag_fast_count; i++)
+        {
+            if (s_frag_fast[i].state != FRAG_FAST_DONE)
+            {
+                ws_frag_fast_try_close(&s_frag_fast[i]);
+            }
+        }
+        if (s_frag_fast_sent)
+        {
+            s_frame_sequence[FRAME_SOURCE_ESP32CAM]++;
+        }
+    }
+    s_frag_fast_count = 0;
+    s_frag_fast_sent = false;
+
+    s_frag_fd = -1;
+    s_frag_len = 0;
+    if (s_frag_shared != NULL)
+    {
+        ws_shared_buf_unref(s_frag_shared);
+        s_frag_shared = NULL;
+    }
+}
+
+/**
+ * Inicia un mensaje fragmentado y devuelve dónde recibir los primeros
+ * len bytes; NULL si no se puede (el llamador drena y descarta)
+ */
+static uint8_t *ws_frag_begin(int fd, size_t len)
+{
+    if (s_frag_fd != -1 && s_frag_fd != fd)
+    {
+        ESP_LOGW(TAG, "Mensaje fragmentado de fd=%d descartado por uno nuevo de fd=%d",
+                 s_frag_fd, fd);
+    }
+    ws_frag_reset();
+
+    if (len > WS_FRAG_MAX_SIZE)
+    {
+        ESP_LOGW(TAG, "Fragmento inicial demasiado grande (%d bytes)", (int)len);
+        return NULL;
+    }
+
+    // Capacidad completa por frame: el bloque viaja tal cual al
+    // broadcast, así que no se puede reutilizar entre frames
+    s_frag_shared = ws_frame_buf_alloc(WS_FRAG_MAX_SIZE);
+    if (s_frag_shared == NULL)
+    {
+        ESP_LOGE(TAG, "Sin memoria para buffer de reensamblado");
+        return NULL;
+    }
+
+    s_frag_fd = fd;
+    s_frag_len = 0;
+
+    // Relevo directo: dejar la cabecera VF lista ya mismo (el primer
+    // fragmento viaja con ella) y fijar los destinatarios del mensaje.
+    // La secuencia es la que broadcast_shared_frame va a asignar al
+    // llegar el FIN, así ambos caminos numeran igual este frame.
+    ws_frame_header_t header = {
+        .magic = {WS_FRAME_MAGIC_0, WS_FRAME_MAGIC_1},
+        .source = (uint8_t)FRAME_SOURCE_ESP32CAM,
+        .reserved = 0,
+        .sequence = s_frame_sequence[FRAME_SOURCE_ESP32CAM] + 1,
+        .timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000),
+    };
+    // El vehículo no manda su momento de captura: la recepción del
+    // primer fragmento es la mejor cota disponible
+    header.capture_ms = header.timestamp_ms;
+    memcpy(s_frag_shared->data, &header, sizeof(header));
 
-    size_t alloc_size = sizeof(ws_async_packet_t) + len;
-    ws_async_packet_t *packet = (ws_async_packet_t *)malloc(alloc_size);
-    if (!packet)
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
     {
-        ESP_LOGE(TAG, "Sin memoria para enviar frame (%zu bytes)", len);
-        return ESP_ERR_NO_MEM;
+        if (ws_clients[i].fd != -1 && ws_clients[i].fd != fd &&
+            ws_clients[i].role == WS_ROLE_DASHBOARD &&
+            ws_clients[i].fast_relay &&
+            ws_clients[i].sub_mask == WS_SUB_BIT(FRAME_SOURCE_ESP32CAM))
+        {
+            s_frag_fast[s_frag_fast_count].fd = ws_clients[i].fd;
+            s_frag_fast[s_frag_fast_count].opened = false;
+            s_frag_fast[s_frag_fast_count].state = FRAG_FAST_OPEN;
+            s_frag_fast_count++;
+        }
     }
 
-    packet->server = server;
-    packet->fd = fd;
-    memset(&packet->frame, 0, sizeof(packet->frame));
-    packet->frame.type = type;
-    packet->frame.len = len;
+    return s_frag_shared->data + sizeof(ws_frame_header_t);
+}
 
-    if (len > 0 && data)
+/**
+ * Devuelve dónde recibir los próximos len bytes de la continuación;
+ * NULL si no hay mensaje en curso de ese fd o no entra
+ */
+static uint8_t *ws_frag_reserve(int fd, size_t len)
+{
+    if (fd != s_frag_fd || s_frag_shared == NULL)
     {
-        memcpy(packet->payload, data, len);
+        return NULL; // Continuación sin mensaje en curso - ignorar
     }
 
-    esp_err_t err = httpd_queue_work(server, ws_async_send_handler, packet);
-    if (err != ESP_OK)
+    if (s_frag_len + len > WS_FRAG_MAX_SIZE)
     {
-        ESP_LOGE(TAG, "No se pudo encolar frame para fd=%d: %s", fd, esp_err_to_name(err));
-        free(packet);
+        ESP_LOGW(TAG, "Frame fragmentado excede %d bytes - descartado", WS_FRAG_MAX_SIZE);
+        ws_frag_reset();
+        return NULL;
     }
-    return err;
+
+    return s_frag_shared->data + sizeof(ws_frame_header_t) + s_frag_len;
 }
 
-static const char *frame_source_to_string(frame_source_t source)
+static void ws_frag_commit(size_t len, bool first, bool final)
 {
-    switch (source)
+    // La tajada recién recibida sale ya mismo hacia los destinatarios
+    // del relevo directo, antes de que llegue el resto del frame
+    if (s_frag_fast_count > 0)
     {
-    case FRAME_SOURCE_ESP32CAM:
-        return "esp32cam";
-    case FRAME_SOURCE_ESP32S3:
-    default:
-        return "esp32s3";
+        uint32_t offset = first ? 0
+                                : (uint32_t)(sizeof(ws_frame_header_t) + s_frag_len);
+        uint32_t slice = first ? (uint32_t)(sizeof(ws_frame_header_t) + len)
+                               : (uint32_t)len;
+        ws_frag_fast_forward(offset, slice, first, final);
     }
+    s_frag_len += len;
 }
 
-static esp_err_t broadcast_video_frame(frame_source_t source,
-                                       const uint8_t *jpeg_data,
-                                       size_t jpeg_len,
-                                       int exclude_fd);
-
-static void ws_remove_client(int fd)
+static void ws_frag_finish(int fd)
 {
-    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    if (fd != s_frag_fd || s_frag_shared == NULL)
     {
-        if (ws_clients[i].fd != fd)
-        {
-            continue;
-        }
-
-        bool was_vehicle = (ws_clients[i].role == WS_ROLE_VEHICLE && ws_clients[i].vehicle_id[0] != '\0');
-        bool was_dashboard = (ws_clients[i].role == WS_ROLE_DASHBOARD);
+        return;
+    }
 
-        if (was_dashboard && ws_dashboard_count > 0)
+    if (s_frag_len > 0)
+    {
+        // Cerrar el relevo directo: a quien le falta el FIN (llegó sin
+        // payload) le va una continuación vacía; si ni el cierre entra,
+        // el modo rápido se le apaga para los próximos frames
+        for (int i = 0; i < s_frag_fast_count; i++)
         {
-            ws_dashboard_count--;
-            ws_update_stream_status_for_vehicles();
+            frag_fast_recipient_t *rcpt = &s_frag_fast[i];
+            if (rcpt->state != FRAG_FAST_DONE)
+            {
+                ws_frag_fast_try_close(rcpt);
+            }
+            if (rcpt->state != FRAG_FAST_DONE)
+            {
+                int slot = ws_client_slot(rcpt->fd);
+                if (slot >= 0)
+                {
+                    ws_clients[slot].fast_relay = false;
+                    ESP_LOGW(TAG, "Relevo directo a fd=%d degradado: no se pudo cerrar el mensaje",
+                             rcpt->fd);
+                }
+            }
         }
-
-        ws_clients[i].fd = -1;
-        ws_clients[i].role = WS_ROLE_UNKNOWN;
-        ws_clients[i].vehicle_id[0] = '\0';
-        if (ws_clients_count > 0)
+        if (s_frag_fast_sent)
         {
-            ws_clients_count--;
+            atomic_fetch_add_explicit(&s_fast_frames, 1, memory_order_relaxed);
         }
 
-        ESP_LOGI(TAG, "Cliente WebSocket removido, fd=%d, total=%d", fd, ws_clients_count);
-
-        if (was_vehicle)
-        {
-            ws_broadcast_vehicle_list();
-        }
-        return;
+        event_log_push(EVENT_FRAME_REASSEMBLED, fd, (int32_t)s_frag_len, 0, 0, 0);
+
+        // La referencia pasa al broadcast; ajustar el largo real antes.
+        // Los destinatarios del relevo ya tienen este frame: la difusión
+        // los saltea (aunque el aire sí se les cobró).
+        ws_shared_buf_t *shared = s_frag_shared;
+        shared->len = sizeof(ws_frame_header_t) + s_frag_len;
+        s_frag_shared = NULL;
+        s_frag_fast_excluding = true;
+        broadcast_shared_frame(FRAME_SOURCE_ESP32CAM, shared, fd, 0);
+        s_frag_fast_excluding = false;
+        // La secuencia ya avanzó en el broadcast: que el reset no la
+        // vuelva a quemar
+        s_frag_fast_sent = false;
     }
-}
-
-/**
- * @brief Manejador de página web principal
- */
-static const char *index_html =
-    "<!DOCTYPE html>\n"
-    "<html>\n"
-    "<head>\n"
-    "<title>ESP32 Vision Control</title>\n"
-    "<meta name='viewport' content='width=device-width, initial-scale=1'>\n"
-    "<style>\n"
-    "body { font-family: 'Space Grotesk', 'Segoe UI', sans-serif; margin: 0; padding: 24px; background: radial-gradient(circle at top,#0f1f3d,#050910 70%); color: #f7fafc; }\n"
-    ".container { max-width: 1280px; margin: 0 auto; }\n"
-    ".header { text-align: center; margin-bottom: 24px; }\n"
-    ".status { padding: 12px; border-radius: 999px; text-align: center; margin-bottom: 24px; font-weight: 600; letter-spacing: 0.04em; text-transform: uppercase; }\n"
-    ".status.connected { background: rgba(88,225,193,0.12); color: #58e1c1; border: 1px solid rgba(88,225,193,0.4); }\n"
-    ".status.disconnected { background: rgba(242,95,92,0.12); color: #f25f5c; border: 1px solid rgba(242,95,92,0.4); }\n"
-    ".video-grid { display: flex; flex-wrap: wrap; gap: 20px; }\n"
-    ".card { background: rgba(16,25,45,0.92); border-radius: 16px; padding: 18px; flex: 1 1 360px; box-shadow: 0 25px 60px rgba(2,6,23,0.6); border: 1px solid rgba(255,255,255,0.04); backdrop-filter: blur(6px); }\n"
-    ".card h3 { margin: 0 0 10px; letter-spacing: 0.05em; }\n"
-    "canvas { width: 100%; height: auto; background: #000; border-radius: 10px; border: 1px solid rgba(255,255,255,0.05); }\n"
-    ".fps { margin-top: 8px; font-size: 0.85rem; color: #58e1c1; letter-spacing: 0.05em; }\n"
-    ".control-panel { margin-top: 24px; background: rgba(16,25,45,0.92); border-radius: 16px; padding: 18px; box-shadow: 0 25px 60px rgba(2,6,23,0.5); border: 1px solid rgba(255,255,255,0.04); }\n"
-    ".control-panel h3 { margin-top: 0; letter-spacing: 0.08em; text-transform: uppercase; font-size: 0.95rem; color: #9fabc7; }\n"
-    ".control-grid { display: grid; grid-template-columns: repeat(3, minmax(0, 120px)); gap: 12px; justify-content: center; margin-top: 10px; }\n"
-    ".control-btn { background: #0c1426; border: 1px solid rgba(88,225,193,0.3); color: #f7fafc; font-size: 1rem; font-weight: 600; padding: 14px 10px; border-radius: 12px; text-transform: uppercase; letter-spacing: 0.08em; cursor: pointer; transition: transform 0.15s ease, border-color 0.15s ease, background 0.15s ease; }\n"
-    ".control-btn:disabled { opacity: 0.3; cursor: not-allowed; }\n"
-    ".control-btn.active, .control-btn:focus-visible { border-color: #58e1c1; background: rgba(88,225,193,0.18); outline: none; transform: translateY(-2px); }\n"
-    ".control-btn.secondary { border-color: rgba(247,250,252,0.2); color: #9fabc7; }\n"
-    ".control-helper { margin-top: 12px; font-size: 0.85rem; color: #9fabc7; text-align: center; letter-spacing: 0.05em; }\n"
-    "label { display: block; font-size: 0.85rem; color: #9fabc7; letter-spacing: 0.05em; margin-bottom: 6px; }\n"
-    "select { width: 100%; padding: 10px 12px; border-radius: 10px; border: 1px solid rgba(255,255,255,0.08); background: rgba(8,14,26,0.8); color: #f7fafc; font-size: 0.95rem; }\n"
-    "@media (max-width: 768px) { .video-grid { flex-direction: column; } .control-grid { grid-template-columns: repeat(3, minmax(0, 1fr)); } }\n"
-    "</style>\n"
-    "</head>\n"
-    "<body>\n"
-    "<div class='container'>\n"
-    "  <div class='header'><h1>ESP32 Vision Dashboard</h1><p>SoftAP: ESP32-Vision-Bot (192.168.4.1)</p></div>\n"
-    "  <div id='status' class='status disconnected'>WebSocket desconectado</div>\n"
-    "  <div class='video-grid'>\n"
-    "    <div class='card'>\n"
-    "      <h3>ESP32-S3 (Nodo maestro)</h3>\n"
-    "      <canvas id='canvasS3'></canvas>\n"
-    "      <div class='fps'>FPS: <span id='fpsS3'>0</span></div>\n"
-    "    </div>\n"
-    "    <div class='card'>\n"
-    "      <h3>ESP32-CAM (Vehiculo)</h3>\n"
-    "      <canvas id='canvasCar'></canvas>\n"
-    "      <div class='fps'>FPS: <span id='fpsCar'>0</span></div>\n"
-    "    </div>\n"
-    "  </div>\n"
-    "  <div class='control-panel'>\n"
-    "    <h3>Control Manual del Vehículo</h3>\n"
-    "    <label for='vehicleSelect'>Vehiculo conectado</label>\n"
-    "    <select id='vehicleSelect'></select>\n"
-    "    <div class='control-grid'>\n"
-    "      <div></div>\n"
-    "      <button class='control-btn' data-control='forward'>Adelante</button>\n"
-    "      <div></div>\n"
-    "      <button class='control-btn' data-control='left'>Izquierda</button>\n"
-    "      <button class='control-btn secondary' data-control='stop'>Stop</button>\n"
-    "      <button class='control-btn' data-control='right'>Derecha</button>\n"
-    "      <div></div>\n"
-    "      <button class='control-btn' data-control='backward'>Atras</button>\n"
-    "      <div></div>\n"
-    "    </div>\n"
-    "    <div class='control-helper'>Manten presionado para avanzar; suelta para frenar. Tambien puedes usar WASD o las flechas.</div>\n"
-    "  </div>\n"
-    "</div>\n"
-    "<script>\n"
-    "const canvases = { esp32s3: document.getElementById('canvasS3'), esp32cam: document.getElementById('canvasCar') };\n"
-    "const contexts = { esp32s3: canvases.esp32s3.getContext('2d'), esp32cam: canvases.esp32cam.getContext('2d') };\n"
-    "const statusEl = document.getElementById('status');\n"
-    "const fpsLabels = { esp32s3: document.getElementById('fpsS3'), esp32cam: document.getElementById('fpsCar') };\n"
-    "const fpsCounters = { esp32s3: {count: 0, last: Date.now()}, esp32cam: {count: 0, last: Date.now()} };\n"
-    "const controlButtons = document.querySelectorAll('.control-btn');\n"
-    "const vehicleSelect = document.getElementById('vehicleSelect');\n"
-    "const commandIntervals = new Map();\n"
-    "const keyboardMap = { ArrowUp: 'forward', KeyW: 'forward', ArrowDown: 'backward', KeyS: 'backward', ArrowLeft: 'left', KeyA: 'left', ArrowRight: 'right', KeyD: 'right', Space: 'stop' };\n"
-    "const pressedKeys = new Set();\n"
-    "let ws;\n"
-    "let pendingFrameSource = 'esp32s3';\n"
-    "let selectedVehicleId = null;\n"
-    "\n"
-    "function setControlsEnabled(enabled) {\n"
-    "  controlButtons.forEach(btn => {\n"
-    "    btn.disabled = !enabled;\n"
-    "    if (!enabled) { btn.classList.remove('active'); }\n"
-    "  });\n"
-    "  vehicleSelect.disabled = !enabled;\n"
-    "  if (!enabled) {\n"
-    "    commandIntervals.forEach(interval => clearInterval(interval));\n"
-    "    commandIntervals.clear();\n"
-    "  }\n"
-    "}\n"
-    "\n"
-    "function updateVehicleOptions(list = []) {\n"
-    "  vehicleSelect.innerHTML = '';\n"
-    "  list.forEach(id => {\n"
-    "    const option = document.createElement('option');\n"
-    "    option.value = id;\n"
-    "    option.textContent = id;\n"
-    "    vehicleSelect.appendChild(option);\n"
-    "  });\n"
-    "  selectedVehicleId = list.length ? list[0] : null;\n"
-    "  setControlsEnabled(!!selectedVehicleId && ws && ws.readyState === WebSocket.OPEN);\n"
-    "}\n"
-    "\n"
-    "vehicleSelect.addEventListener('change', () => {\n"
-    "  selectedVehicleId = vehicleSelect.value || null;\n"
-    "});\n"
-    "\n"
-    "function sendControl(command) {\n"
-    "  if (!ws || ws.readyState !== WebSocket.OPEN || !selectedVehicleId) { return; }\n"
-    "  const payload = { type: 'control', command, vehicle_id: selectedVehicleId, timestamp: Date.now() };\n"
-    "  ws.send(JSON.stringify(payload));\n"
-    "}\n"
-    "\n"
-    "function attachControlHandlers() {\n"
-    "  controlButtons.forEach(btn => {\n"
-    "    const command = btn.dataset.control;\n"
-    "    const start = (event) => {\n"
-    "      event.preventDefault();\n"
-    "      if (btn.disabled) { return; }\n"
-    "      btn.classList.add('active');\n"
-    "      sendControl(command);\n"
-    "      const interval = setInterval(() => sendControl(command), 350);\n"
-    "      commandIntervals.set(btn, interval);\n"
-    "    };\n"
-    "    const stop = () => {\n"
-    "      btn.classList.remove('active');\n"
-    "      const interval = commandIntervals.get(btn);\n"
-    "      if (interval) { clearInterval(interval); commandIntervals.delete(btn); }\n"
-    "      if (command !== 'stop') { sendControl('stop'); }\n"
-    "    };\n"
-    "    btn.addEventListener('pointerdown', start);\n"
-    "    btn.addEventListener('pointerup', stop);\n"
-    "    btn.addEventListener('pointerleave', stop);\n"
-    "    btn.addEventListener('pointercancel', stop);\n"
-    "  });\n"
-    "}\n"
-    "\n"
-    "attachControlHandlers();\n"
-    "setControlsEnabled(false);\n"
-    "\n"
-    "function updateFps(source) {\n"
-    "  const stats = fpsCounters[source];\n"
-    "  stats.count++;\n"
-    "  const now = Date.now();\n"
-    "  if (now - stats.last >= 1000) {\n"
-    "    fpsLabels[source].textContent = stats.count;\n"
-    "    stats.count = 0;\n"
-    "    stats.last = now;\n"
-    "  }\n"
-    "}\n"
-    "\n"
-    "function drawFrame(source, buffer) {\n"
-    "  const blob = new Blob([buffer], {type: 'image/jpeg'});\n"
-    "  const url = URL.createObjectURL(blob);\n"
-    "  const img = new Image();\n"
-    "  img.onload = () => {\n"
-    "    const canvas = canvases[source];\n"
-    "    const ctx = contexts[source];\n"
-    "    canvas.width = img.width;\n"
-    "    canvas.height = img.height;\n"
-    "    ctx.drawImage(img, 0, 0);\n"
-    "    URL.revokeObjectURL(url);\n"
-    "    updateFps(source);\n"
-    "  };\n"
-    "  img.src = url;\n"
-    "}\n"
-    "\n"
-    "function connect() {\n"
-    "  ws = new WebSocket('ws://' + window.location.hostname + '/ws');\n"
-    "  ws.binaryType = 'arraybuffer';\n"
-    "  ws.onopen = () => {\n"
-    "    statusEl.textContent = 'WebSocket conectado';\n"
-    "    statusEl.className = 'status connected';\n"
-    "    ws.send(JSON.stringify({ type: 'register', role: 'dashboard' }));\n"
-    "  };\n"
-    "  ws.onclose = () => {\n"
-    "    statusEl.textContent = 'WebSocket desconectado';\n"
-    "    statusEl.className = 'status disconnected';\n"
-    "    updateVehicleOptions([]);\n"
-    "    setTimeout(connect, 2000);\n"
-    "  };\n"
-    "  ws.onerror = (e) => console.error('WebSocket error', e);\n"
-    "  ws.onmessage = (e) => {\n"
-    "    if (typeof e.data === 'string') {\n"
-    "      const data = JSON.parse(e.data);\n"
-    "      if (data.type === 'frame') {\n"
-    "        pendingFrameSource = data.source || 'esp32s3';\n"
-    "        return;\n"
-    "      }\n"
-    "      if (data.type === 'vehicle_list') {\n"
-    "        updateVehicleOptions(data.vehicles || []);\n"
-    "        return;\n"
-    "      }\n"
-    "      return;\n"
-    "    }\n"
-    "    drawFrame(pendingFrameSource, e.data);\n"
-    "  };\n"
-    "}\n"
-    "\n"
-    "connect();\n"
-    "\n"
-    "document.addEventListener('keydown', (event) => {\n"
-    "  const command = keyboardMap[event.code];\n"
-    "  if (!command || pressedKeys.has(event.code)) { return; }\n"
-    "  pressedKeys.add(event.code);\n"
-    "  const button = [...controlButtons].find(btn => btn.dataset.control === command);\n"
-    "  if (button && !button.disabled) { button.classList.add('active'); }\n"
-    "  sendControl(command);\n"
-    "});\n"
-    "\n"
-    "document.addEventListener('keyup', (event) => {\n"
-    "  if (!pressedKeys.has(event.code)) { return; }\n"
-    "  pressedKeys.delete(event.code);\n"
-    "  const active = [...controlButtons].filter(btn => btn.classList.contains('active') && btn.dataset.control !== 'stop');\n"
-    "  active.forEach(btn => btn.classList.remove('active'));\n"
-    "  sendControl('stop');\n"
-    "});\n"
-    "\n"
-    "window.addEventListener('blur', () => {\n"
-    "  pressedKeys.clear();\n"
-    "  sendControl('stop');\n"
-    "  controlButtons.forEach(btn => btn.classList.remove('active'));\n"
-    "});\n"
-    "</script>\n"
-    "</body>\n"
-    "</html>\n";
 
-static esp_err_t index_handler(httpd_req_t *req)
-{
-    httpd_resp_set_type(req, "text/html");
-    return httpd_resp_send(req, index_html, HTTPD_RESP_USE_STRLEN);
+    ws_frag_reset();
 }
 
 /**
@@ -762,6 +3235,14 @@ static esp_err_t ws_handler(httpd_req_t *req)
         int fd = httpd_req_to_sockfd(req);
         ESP_LOGI(TAG, "Handshake iniciado, fd=%d", fd);
 
+        // Buffer de envío acorde al tamaño de un frame; si falla seguimos
+        // con el default de LWIP (solo degrada el throughput)
+        int sndbuf = WS_SERVER_SNDBUF_BYTES;
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) != 0)
+        {
+            ESP_LOGW(TAG, "No se pudo aplicar SO_SNDBUF en fd=%d", fd);
+        }
+
         if (!ws_client_exists(fd))
         {
             ws_add_client(fd);
@@ -780,20 +3261,56 @@ static esp_err_t ws_handler(httpd_req_t *req)
 
     int fd = httpd_req_to_sockfd(req);
 
+    // Los frames binarios (JPEG del vehículo) se reciben directo sobre
+    // un buffer compartido de broadcast, en su posición final: una sola
+    // copia desde el socket hasta cada cliente. El resto (texto, close)
+    // usa un malloc transitorio como siempre.
+    uint8_t *heap_payload = NULL;        // Solo para el camino con malloc
+    ws_shared_buf_t *single_shared = NULL; // Frame binario de un mensaje
+
     if (ws_pkt.len > 0)
     {
-        ws_pkt.payload = malloc(ws_pkt.len + 1);
+        if (ws_pkt.type == HTTPD_WS_TYPE_BINARY && ws_pkt.final)
+        {
+            single_shared = ws_frame_buf_alloc(ws_pkt.len);
+            if (single_shared != NULL)
+            {
+                ws_pkt.payload = single_shared->data + sizeof(ws_frame_header_t);
+            }
+        }
+        else if (ws_pkt.type == HTTPD_WS_TYPE_BINARY)
+        {
+            // Primer fragmento de un frame troceado por el encoder
+            ws_pkt.payload = ws_frag_begin(fd, ws_pkt.len);
+        }
+        else if (ws_pkt.type == HTTPD_WS_TYPE_CONTINUE)
+        {
+            ws_pkt.payload = ws_frag_reserve(fd, ws_pkt.len);
+        }
+
         if (ws_pkt.payload == NULL)
         {
-            ESP_LOGE(TAG, "No hay memoria para payload WebSocket");
-            return ESP_ERR_NO_MEM;
+            // Sin destino directo (texto, close, o sin memoria): igual
+            // hay que drenar el frame del socket
+            heap_payload = malloc(ws_pkt.len + 1);
+            if (heap_payload == NULL)
+            {
+                ESP_LOGE(TAG, "No hay memoria para payload WebSocket");
+                return ESP_ERR_NO_MEM;
+            }
+            ws_pkt.payload = heap_payload;
         }
 
         ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
         if (ret != ESP_OK)
         {
             ESP_LOGE(TAG, "httpd_ws_recv_frame payload failed: %s", esp_err_to_name(ret));
-            free(ws_pkt.payload);
+            free(heap_payload);
+            if (single_shared != NULL)
+            {
+                ws_shared_buf_unref(single_shared);
+            }
+            ws_frag_reset(); // El mensaje en curso quedó a medias
             return ret;
         }
 
@@ -805,11 +3322,12 @@ static esp_err_t ws_handler(httpd_req_t *req)
 
     if (ws_pkt.type == HTTPD_WS_TYPE_CLOSE)
     {
-        ws_remove_client(fd);
-        if (ws_pkt.payload)
+        if (fd == s_frag_fd)
         {
-            free(ws_pkt.payload);
+            ws_frag_reset(); // No dejar un mensaje a medio reensamblar
         }
+        ws_remove_client(fd);
+        free(heap_payload);
         return ESP_OK;
     }
 
@@ -819,30 +3337,100 @@ static esp_err_t ws_handler(httpd_req_t *req)
         ws_add_client(fd);
     }
 
-    if (ws_pkt.type == HTTPD_WS_TYPE_BINARY && ws_pkt.len > 0 && ws_pkt.payload)
+    if (ws_pkt.type == HTTPD_WS_TYPE_BINARY && ws_pkt.len > 0)
+    {
+        if (single_shared != NULL)
+        {
+            const uint8_t *payload = single_shared->data + sizeof(ws_frame_header_t);
+            if (ws_pkt.len > 2 && payload[0] == 'O' && payload[1] == 'T')
+            {
+                // Chunk OTA del actualizador: relevo directo al
+                // vehículo, con la prioridad más baja para que nunca
+                // desplace comandos ni telemetría
+                ws_client_t *vehicle = ws_first_vehicle();
+                if (vehicle != NULL)
+                {
+                    ws_queue_frame_prio(vehicle->fd, HTTPD_WS_TYPE_BINARY,
+                                        payload, ws_pkt.len, WS_TX_PRIO_VIDEO);
+                }
+                ws_shared_buf_unref(single_shared);
+            }
+            else if (ws_pkt.len > 2 && payload[0] == 'V' && payload[1] == 'T')
+            {
+                // Lote de telemetría binaria del vehículo ('V','T'):
+                // relevo tal cual a los dashboards con la prioridad más
+                // baja - es histórico, nunca desplaza comandos ni video
+                for (int i = 0; i < MAX_WS_CLIENTS; i++)
+                {
+                    if (ws_clients[i].fd != -1 &&
+                        ws_clients[i].role == WS_ROLE_DASHBOARD)
+                    {
+                        ws_queue_frame_prio(ws_clients[i].fd, HTTPD_WS_TYPE_BINARY,
+                                            payload, ws_pkt.len, WS_TX_PRIO_VIDEO);
+                    }
+                }
+                ws_shared_buf_unref(single_shared);
+            }
+            else if (ws_handle_status_frame(fd, payload, ws_pkt.len))
+            {
+                // Era telemetría, no video: ya fue reencolada
+                ws_shared_buf_unref(single_shared);
+            }
+            else
+            {
+                // Frame completo en un solo mensaje: el bloque recibido
+                // va tal cual al broadcast (cede la referencia)
+                event_log_push(EVENT_FRAME_RX, fd, (int32_t)ws_pkt.len, 0, 0, 0);
+                broadcast_shared_frame(FRAME_SOURCE_ESP32CAM, single_shared, fd, 0);
+            }
+            single_shared = NULL;
+        }
+        else if (heap_payload == NULL && !ws_pkt.final)
+        {
+            ws_frag_commit(ws_pkt.len, true, false);
+        }
+        // heap_payload != NULL: no hubo memoria para el frame - drenado
+        // y descartado
+    }
+    else if (ws_pkt.type == HTTPD_WS_TYPE_CONTINUE)
     {
-        ESP_LOGD(TAG, "Frame binario recibido de fd=%d (%d bytes)", fd, ws_pkt.len);
-        broadcast_video_frame(FRAME_SOURCE_ESP32CAM, ws_pkt.payload, ws_pkt.len, fd);
+        if (heap_payload == NULL && ws_pkt.len > 0)
+        {
+            ws_frag_commit(ws_pkt.len, false, ws_pkt.final);
+        }
+        if (ws_pkt.final)
+        {
+            // FIN (puede llegar sin payload): entregar el frame
+            ws_frag_finish(fd);
+        }
     }
     else if (ws_pkt.type == HTTPD_WS_TYPE_TEXT && ws_pkt.payload)
     {
         ws_handle_text_message(fd, (char *)ws_pkt.payload);
     }
 
-    if (ws_pkt.payload)
-    {
-        free(ws_pkt.payload);
-    }
-
+    free(heap_payload);
     return ESP_OK;
 }
 
 esp_err_t ws_server_start(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_open_sockets = 7; // Permitir múltiples conexiones
+    // Un socket por cliente WS más margen para las peticiones HTTP de la
+    // página; requiere CONFIG_LWIP_MAX_SOCKETS >= 16 en sdkconfig
+    config.max_open_sockets = MAX_WS_CLIENTS + 2;
     config.lru_purge_enable = true;
     config.core_id = 0; // Ejecutar en Core 0 (Protocol CPU)
+    config.task_priority = WS_SERVER_TASK_PRIORITY;
+    config.stack_size = WS_SERVER_STACK_SIZE;
+    // Keepalive agresivo en los sockets WS: un vehículo que se apagó
+    // sin FIN quedaba ocupando su slot 10+ s hasta que TCP se rendía;
+    // con idle 1 s + 2 sondas el slot y sus colas de TX se liberan en
+    // ~3 s, el mismo orden que la reconexión del vehículo
+    config.keep_alive_enable = true;
+    config.keep_alive_idle = 1;
+    config.keep_alive_interval = 1;
+    config.keep_alive_count = 2;
 
     ESP_LOGI(TAG, "Iniciando servidor HTTP en puerto %d", config.server_port);
 
@@ -852,6 +3440,13 @@ esp_err_t ws_server_start(void)
         return ESP_FAIL;
     }
 
+    if (ws_tx_task_start() != ESP_OK)
+    {
+        httpd_stop(server);
+        server = NULL;
+        return ESP_FAIL;
+    }
+
     // Registrar manejador de página principal
     httpd_uri_t index_uri = {
         .uri = "/",
@@ -860,6 +3455,37 @@ esp_err_t ws_server_start(void)
         .user_ctx = NULL};
     httpd_register_uri_handler(server, &index_uri);
 
+    // Estadísticas del camino de transmisión (diagnóstico)
+    httpd_uri_t stats_uri = {
+        .uri = "/stats",
+        .method = HTTP_GET,
+        .handler = stats_handler,
+        .user_ctx = NULL};
+    httpd_register_uri_handler(server, &stats_uri);
+
+    // Punto de raspado para el monitoreo de la LAN (series de tiempo)
+    httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_handler,
+        .user_ctx = NULL};
+    httpd_register_uri_handler(server, &metrics_uri);
+
+    // Una sola vez: el registro sobrevive a un ciclo stop/start del httpd
+    static bool s_metrics_registered = false;
+    if (!s_metrics_registered)
+    {
+        s_metrics_registered = (metrics_register(ws_metrics_provider) == ESP_OK);
+    }
+
+    // Stream MJPEG plano para kioscos (/mjpeg?source=...&fps=N)
+    httpd_uri_t mjpeg_uri = {
+        .uri = "/mjpeg",
+        .method = HTTP_GET,
+        .handler = mjpeg_handler,
+        .user_ctx = NULL};
+    httpd_register_uri_handler(server, &mjpeg_uri);
+
     // Registrar manejador de WebSocket
     httpd_uri_t ws_uri = {
         .uri = "/ws",
@@ -892,28 +3518,161 @@ esp_err_t ws_server_stop(void)
         {
             ws_clients[i].fd = -1;
             ws_clients[i].role = WS_ROLE_UNKNOWN;
+            ws_clients[i].sub_mask = 0;
             ws_clients[i].vehicle_id[0] = '\0';
         }
+        memset(s_fd_to_slot, -1, sizeof(s_fd_to_slot));
+        memset(s_vehicle_hash, -1, sizeof(s_vehicle_hash));
+        for (int i = 0; i < 2; i++)
+        {
+            ws_shared_buf_t *frame = atomic_exchange_explicit(&s_last_frame[i], NULL,
+                                                              memory_order_acquire);
+            if (frame != NULL)
+            {
+                ws_shared_buf_unref(frame);
+            }
+        }
         ESP_LOGI(TAG, "Servidor WebSocket detenido");
     }
     return ESP_OK;
 }
 
-static esp_err_t broadcast_video_frame(frame_source_t source,
-                                       const uint8_t *jpeg_data,
-                                       size_t jpeg_len,
-                                       int exclude_fd)
+/**
+ * Difunde un frame ya alojado en un buffer compartido (creado con
+ * ws_frame_buf_alloc, con el payload escrito tras la cabecera). Toma
+ * posesión de la referencia del llamador: el camino de recepción puede
+ * entregar el mismo bloque en el que leyó el JPEG, sin volver a copiar.
+ */
+// ============================================================================
+// TOKEN BUCKET DE AIRE PARA EL VIDEO SALIENTE
+// ============================================================================
+// El video de la cámara propia (etapa de codificación) y el reenviado
+// de los vehículos (ws_handler) compiten sin control por la misma
+// radio. Cada fuente tiene un balde de bytes que se rellena a tasa
+// fija; cada frame descuenta sus bytes multiplicados por la cantidad
+// de destinatarios (cada uno repite los mismos bytes por el aire) y un
+// balde vacío descarta el frame completo antes de encolarlo. Así el
+// video queda acotado y justo entre fuentes, y el camino de control y
+// estado — que ya tiene prioridad estricta en los anillos de TX —
+// nunca espera detrás de una ráfaga de video. Cada fuente publica
+// desde una sola tarea (codificador o httpd), así que el balde no
+// necesita candado; los agotamientos se cuentan en atómicos para
+// /stats.
+
+#define WS_AIR_RATE_BYTES_PER_S (150 * 1024) // Relleno por fuente
+#define WS_AIR_BURST_BYTES (64 * 1024)       // Tope del balde
+
+typedef struct
+{
+    int64_t tokens; // Bytes disponibles
+    int64_t last_refill_us;
+} ws_air_bucket_t;
+
+static ws_air_bucket_t s_air_bucket[2];
+
+static bool ws_air_bucket_take(frame_source_t source, size_t bytes)
+{
+    ws_air_bucket_t *bucket = &s_air_bucket[source];
+    int64_t now_us = esp_timer_get_time();
+
+    if (bucket->last_refill_us == 0)
+    {
+        bucket->tokens = WS_AIR_BURST_BYTES;
+    }
+    else
+    {
+        bucket->tokens += (now_us - bucket->last_refill_us) *
+                          WS_AIR_RATE_BYTES_PER_S / 1000000;
+        if (bucket->tokens > WS_AIR_BURST_BYTES)
+        {
+            bucket->tokens = WS_AIR_BURST_BYTES;
+        }
+    }
+    bucket->last_refill_us = now_us;
+
+    if (bucket->tokens < (int64_t)bytes)
+    {
+        atomic_fetch_add_explicit(&s_air_exhausted[source], 1,
+                                  memory_order_relaxed);
+        return false;
+    }
+
+    bucket->tokens -= (int64_t)bytes;
+    return true;
+}
+
+static esp_err_t broadcast_shared_frame(frame_source_t source,
+                                        ws_shared_buf_t *shared,
+                                        int exclude_fd,
+                                        uint32_t capture_ms)
 {
-    if (!server || !jpeg_data || jpeg_len == 0 || ws_dashboard_count == 0)
+    if (shared == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!server || shared->len <= sizeof(ws_frame_header_t))
+    {
+        ws_shared_buf_unref(shared);
+        return ESP_OK;
+    }
+
+    if (ws_dashboard_count == 0 &&
+        atomic_load_explicit(&s_mjpeg_viewers[source], memory_order_relaxed) == 0)
     {
+        ws_shared_buf_unref(shared);
         return ESP_OK;
     }
 
-    const char *source_str = frame_source_to_string(source);
-    char meta[64];
-    int meta_len = snprintf(meta, sizeof(meta),
-                            "{\"type\":\"frame\",\"source\":\"%s\"}",
-                            source_str);
+    // Cobrar el aire antes de encolar nada: los bytes del frame salen
+    // una vez por cada destinatario real. Quien reportó su ritmo de
+    // decode recibe frames espaciados a ese ritmo: saltearle este frame
+    // no le quita nada (no lo iba a pintar) y su parte del aire queda
+    // para los demás.
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool wants[MAX_WS_CLIENTS] = {false};
+    int recipients = atomic_load_explicit(&s_mjpeg_viewers[source],
+                                          memory_order_relaxed);
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_DASHBOARD &&
+            (exclude_fd < 0 || ws_clients[i].fd != exclude_fd) &&
+            (ws_clients[i].sub_mask & WS_SUB_BIT(source)))
+        {
+            uint32_t min_ms = ws_rr_min_interval_ms(&ws_clients[i], source, now_ms);
+            wants[i] = (min_ms == 0) ||
+                       (now_ms - ws_clients[i].rr_sent_ms[source] >= min_ms);
+            if (wants[i])
+            {
+                recipients++;
+            }
+        }
+    }
+
+    if (recipients > 0 &&
+        !ws_air_bucket_take(source, shared->len * (size_t)recipients))
+    {
+        ws_shared_buf_unref(shared);
+        return ESP_OK; // Balde vacío: el frame se descarta completo
+    }
+
+    ws_frame_header_t header = {
+        .magic = {WS_FRAME_MAGIC_0, WS_FRAME_MAGIC_1},
+        .source = (uint8_t)source,
+        .reserved = 0,
+        // Secuencia por fuente: un hueco en la numeración de un feed es
+        // un frame perdido de ESE feed, no ruido del otro
+        .sequence = ++s_frame_sequence[source],
+        .timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .capture_ms = capture_ms,
+    };
+    // Captura desconocida (frames enlatados, fuentes sin timestamp):
+    // el envío es la mejor cota y deja el tramo previo al aire en cero
+    if (header.capture_ms == 0)
+    {
+        header.capture_ms = header.timestamp_ms;
+    }
+    memcpy(shared->data, &header, sizeof(header));
 
     for (int i = 0; i < MAX_WS_CLIENTS; i++)
     {
@@ -927,34 +3686,140 @@ static esp_err_t broadcast_video_frame(frame_source_t source,
             continue;
         }
 
-        esp_err_t ret = ws_queue_frame(ws_clients[i].fd,
-                                       HTTPD_WS_TYPE_TEXT,
-                                       (const uint8_t *)meta,
-                                       meta_len);
-        if (ret != ESP_OK)
+        // Solo a quien pidió esta fuente: sin suscripción no hay bytes
+        if (!(ws_clients[i].sub_mask & WS_SUB_BIT(source)))
         {
-            ws_remove_client(ws_clients[i].fd);
             continue;
         }
 
-        ret = ws_queue_frame(ws_clients[i].fd,
-                             HTTPD_WS_TYPE_BINARY,
-                             jpeg_data,
-                             jpeg_len);
-        if (ret != ESP_OK)
+        // Espaciado a su ritmo de decode reportado: el frame no sale
+        if (!wants[i])
         {
-            ws_remove_client(ws_clients[i].fd);
+            continue;
+        }
+
+        // Este frame ya le llegó fragmento a fragmento por el relevo
+        // directo: repetirlo duplicaría aire y secuencia
+        if (s_frag_fast_excluding && ws_frag_fd_is_fast(ws_clients[i].fd))
+        {
+            continue;
         }
+
+        // Anillo lleno = el cliente no da abasto: se pierde este frame,
+        // no la conexión. La tarea de transmisión maneja los fd muertos.
+        ws_queue_frame_shared(ws_clients[i].fd, HTTPD_WS_TYPE_BINARY, shared);
+        ws_clients[i].rr_sent_ms[source] = now_ms;
+    }
+
+    // Publicar el frame para los espectadores MJPEG: la referencia del
+    // broadcast pasa al slot y se suelta la que hubiera quedado ahí
+    ws_shared_buf_t *previous = atomic_exchange_explicit(&s_last_frame[source],
+                                                         shared,
+                                                         memory_order_release);
+    if (previous != NULL)
+    {
+        ws_shared_buf_unref(previous);
     }
 
     return ESP_OK;
 }
 
+/**
+ * Variante con copia para los productores que tienen el JPEG en su
+ * propio buffer (cámara local, receptor UDP)
+ */
+static esp_err_t broadcast_video_frame(frame_source_t source,
+                                       const uint8_t *jpeg_data,
+                                       size_t jpeg_len,
+                                       int exclude_fd,
+                                       uint32_t capture_ms)
+{
+    if (!server || !jpeg_data || jpeg_len == 0)
+    {
+        return ESP_OK;
+    }
+
+    if (ws_dashboard_count == 0 &&
+        atomic_load_explicit(&s_mjpeg_viewers[source], memory_order_relaxed) == 0)
+    {
+        return ESP_OK;
+    }
+
+    ws_shared_buf_t *shared = ws_frame_buf_alloc(jpeg_len);
+    if (shared == NULL)
+    {
+        ESP_LOGE(TAG, "Sin memoria para frame de video (%zu bytes)", jpeg_len);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(shared->data + sizeof(ws_frame_header_t), jpeg_data, jpeg_len);
+    return broadcast_shared_frame(source, shared, exclude_fd, capture_ms);
+}
+
 esp_err_t ws_server_send_video_frame(frame_source_t source,
                                      const uint8_t *jpeg_data,
-                                     size_t jpeg_len)
+                                     size_t jpeg_len,
+                                     uint32_t capture_ms)
+{
+    return broadcast_video_frame(source, jpeg_data, jpeg_len, -1, capture_ms);
+}
+
+esp_err_t ws_server_send_detection(frame_source_t source,
+                                   int color_id,
+                                   int centroid_x,
+                                   int centroid_y,
+                                   int bbox_x_min,
+                                   int bbox_y_min,
+                                   int bbox_x_max,
+                                   int bbox_y_max,
+                                   float world_x,
+                                   float world_y)
 {
-    return broadcast_video_frame(source, jpeg_data, jpeg_len, -1);
+    if (!server || ws_dashboard_count == 0)
+    {
+        return ESP_OK;
+    }
+
+    // JSON compacto armado con snprintf (como la metadata de frames):
+    // decenas de bytes por detección, sin pasar por cJSON
+    char msg[192];
+    int len = snprintf(msg, sizeof(msg),
+                       "{\"type\":\"detection\",\"source\":\"%s\",\"color\":%d,"
+                       "\"cx\":%d,\"cy\":%d,\"bbox\":[%d,%d,%d,%d],"
+                       "\"wx\":%.2f,\"wy\":%.2f}",
+                       frame_source_to_string(source), color_id,
+                       centroid_x, centroid_y,
+                       bbox_x_min, bbox_y_min, bbox_x_max, bbox_y_max,
+                       world_x, world_y);
+
+    if (len < 0 || len >= (int)sizeof(msg))
+    {
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd == -1 || ws_clients[i].role != WS_ROLE_DASHBOARD)
+        {
+            continue;
+        }
+
+        // Las detecciones se dibujan sobre el feed: siguen su suscripción
+        if (!(ws_clients[i].sub_mask & WS_SUB_BIT(source)))
+        {
+            continue;
+        }
+
+        if (ws_queue_frame(ws_clients[i].fd,
+                           HTTPD_WS_TYPE_TEXT,
+                           (const uint8_t *)msg,
+                           (size_t)len) != ESP_OK)
+        {
+            ws_remove_client(ws_clients[i].fd);
+        }
+    }
+
+    return ESP_OK;
 }
 
 uint8_t ws_server_get_clients_count(void)
@@ -962,7 +3827,130 @@ uint8_t ws_server_get_clients_count(void)
     return ws_clients_count;
 }
 
+void ws_server_get_tx_drops(uint32_t *video_dropped, uint32_t *other_dropped)
+{
+    if (video_dropped)
+    {
+        *video_dropped = atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_VIDEO],
+                                              memory_order_relaxed);
+    }
+    if (other_dropped)
+    {
+        *other_dropped = atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_CONTROL],
+                                              memory_order_relaxed) +
+                         atomic_load_explicit(&s_tx_dropped[WS_TX_PRIO_STATUS],
+                                              memory_order_relaxed);
+    }
+}
+
+void ws_server_get_tuning(ws_server_tuning_t *out)
+{
+    if (!out)
+    {
+        return;
+    }
+    out->task_priority = WS_SERVER_TASK_PRIORITY;
+    out->stack_size = WS_SERVER_STACK_SIZE;
+    out->max_open_sockets = MAX_WS_CLIENTS + 2;
+    out->send_buf_bytes = WS_SERVER_SNDBUF_BYTES;
+    out->nodelay_vehicles = WS_SERVER_NODELAY_VEHICLES != 0;
+}
+
+// Suma entregados y descartados de todos los slots; el benchmark mide
+// por diferencia contra esta foto inicial
+static void ws_tx_totals(uint32_t *delivered, uint32_t *dropped)
+{
+    uint32_t d = 0;
+    uint32_t p = 0;
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        d += atomic_load_explicit(&s_tx_stats[i].delivered, memory_order_relaxed);
+        p += atomic_load_explicit(&s_tx_stats[i].dropped, memory_order_relaxed);
+    }
+    *delivered = d;
+    *dropped = p;
+}
+
+esp_err_t ws_server_run_tx_benchmark(size_t frame_len, uint32_t duration_ms)
+{
+    if (!server || frame_len == 0 || duration_ms == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t dashboards = ws_source_subscriber_count(FRAME_SOURCE_ESP32S3);
+    if (dashboards == 0)
+    {
+        ESP_LOGW(TAG, "Benchmark TX: sin dashboards suscriptos, nada que medir");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t *payload = malloc(frame_len);
+    if (!payload)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    // Relleno incompresible con marcador SOI para que el dashboard lo
+    // trate como frame normal (el decode fallido solo pierde ese frame)
+    memset(payload, 0xA5, frame_len);
+    payload[0] = 0xFF;
+    payload[1] = 0xD8;
+
+    uint32_t delivered_before, dropped_before;
+    ws_tx_totals(&delivered_before, &dropped_before);
+
+    ESP_LOGI(TAG, "Benchmark TX: %u bytes/frame, %lu ms, %u dashboards",
+             (unsigned)frame_len, (unsigned long)duration_ms, dashboards);
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t end_us = start_us + (int64_t)duration_ms * 1000;
+    uint32_t offered = 0;
+
+    while (esp_timer_get_time() < end_us)
+    {
+        broadcast_video_frame(FRAME_SOURCE_ESP32S3, payload, frame_len, -1, 0);
+        offered++;
+        // Ceder un tick: el anillo absorbe ráfagas, pero sin esto la
+        // tarea de transmisión nunca corre y solo mediríamos descartes
+        vTaskDelay(1);
+    }
+
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    free(payload);
+
+    uint32_t delivered_after, dropped_after;
+    ws_tx_totals(&delivered_after, &dropped_after);
+
+    uint32_t delivered = delivered_after - delivered_before;
+    uint32_t dropped = dropped_after - dropped_before;
+    uint32_t elapsed_ms = (uint32_t)(elapsed_us / 1000);
+
+    // CSV para recolectar con el monitor serie, igual que BENCH de visión
+    ESP_LOGI(TAG, "BENCH,ws_tx,frame_bytes=%u,dashboards=%u,offered_fps=%lu,delivered_fps=%lu,dropped=%lu,kbps=%lu",
+             (unsigned)frame_len,
+             dashboards,
+             (unsigned long)(offered * 1000UL / elapsed_ms),
+             (unsigned long)(delivered * 1000UL / elapsed_ms / dashboards),
+             (unsigned long)dropped,
+             (unsigned long)((uint64_t)delivered * frame_len * 8 / elapsed_ms));
+
+    return ESP_OK;
+}
+
 bool ws_server_has_clients(void)
 {
-    return ws_dashboard_count > 0;
+    // El stream local (S3) también se apaga si nadie se suscribió a él
+    return ws_source_subscriber_count(FRAME_SOURCE_ESP32S3) > 0;
+}
+
+bool ws_server_has_vehicles(void)
+{
+    for (int i = 0; i < MAX_WS_CLIENTS; i++)
+    {
+        if (ws_clients[i].fd != -1 && ws_clients[i].role == WS_ROLE_VEHICLE)
+        {
+            return true;
+        }
+    }
+    return false;
 }
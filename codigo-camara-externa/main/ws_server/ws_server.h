@@ -36,24 +36,109 @@ esp_err_t ws_server_stop(void);
  * 
  * @param jpeg_data Buffer con datos JPEG
  * @param jpeg_len Tamaño del buffer
+ * @param capture_ms Momento de captura del frame en ms del reloj local
+ *                   (esp_timer); 0 si no se conoce y la cabecera usa el
+ *                   momento del envío. El dashboard lo resta de su
+ *                   reloj sincronizado para la latencia vidrio-a-vidrio
  * @return ESP_OK si se envió correctamente
  */
 esp_err_t ws_server_send_video_frame(frame_source_t source,
                                      const uint8_t *jpeg_data,
-                                     size_t jpeg_len);
+                                     size_t jpeg_len,
+                                     uint32_t capture_ms);
+
+/**
+ * @brief Difunde la metadata de una detección a los dashboards
+ *
+ * Mensaje JSON compacto (decenas de bytes) con centroide, caja y
+ * coordenadas de mundo; el dashboard dibuja el overlay del lado del
+ * cliente, sin re-codificar video anotado en el S3.
+ *
+ * @param source Cámara que originó la detección
+ * @param color_id Índice del color detectado
+ * @param centroid_x Centroide X en píxeles
+ * @param centroid_y Centroide Y en píxeles
+ * @param bbox_x_min Caja del blob (límites inclusivos)
+ * @param bbox_y_min Caja del blob
+ * @param bbox_x_max Caja del blob
+ * @param bbox_y_max Caja del blob
+ * @param world_x Coordenada X en el mundo real (cm)
+ * @param world_y Coordenada Y en el mundo real (cm)
+ * @return ESP_OK (los dashboards caídos se desconectan en el camino)
+ */
+esp_err_t ws_server_send_detection(frame_source_t source,
+                                   int color_id,
+                                   int centroid_x,
+                                   int centroid_y,
+                                   int bbox_x_min,
+                                   int bbox_y_min,
+                                   int bbox_x_max,
+                                   int bbox_y_max,
+                                   float world_x,
+                                   float world_y);
 
 /**
  * @brief Obtiene el número de clientes WebSocket conectados
- * 
+ *
  * @return Número de clientes conectados
  */
 uint8_t ws_server_get_clients_count(void);
 
+/**
+ * @brief Contadores de mensajes salientes descartados por contrapresión
+ *
+ * El video se descarta primero (es descartable); control y estado solo
+ * se pierden con el anillo lleno, lo que indica un problema real.
+ *
+ * @param video_dropped Frames de video descartados (puede ser NULL)
+ * @param other_dropped Mensajes de control/estado descartados (puede ser NULL)
+ */
+void ws_server_get_tx_drops(uint32_t *video_dropped, uint32_t *other_dropped);
+
+/**
+ * @brief Parámetros de red aplicados por el servidor
+ *
+ * Copia de lo que realmente quedó configurado (no de lo pedido), para
+ * poder consultarlo en runtime y correlacionar mediciones con la
+ * configuración vigente.
+ */
+typedef struct
+{
+    uint8_t task_priority;     // Prioridad de la tarea de httpd
+    uint32_t stack_size;       // Pila de la tarea de httpd (bytes)
+    uint8_t max_open_sockets;  // Sockets simultáneos del servidor
+    int send_buf_bytes;        // SO_SNDBUF aplicado a cada conexión WS
+    bool nodelay_vehicles;     // TCP_NODELAY en conexiones de vehículos
+} ws_server_tuning_t;
+
+/**
+ * @brief Devuelve la configuración de red vigente del servidor
+ */
+void ws_server_get_tuning(ws_server_tuning_t *out);
+
+/**
+ * @brief Benchmark de transmisión con frames sintéticos
+ *
+ * Satura el camino de broadcast con frames del tamaño indicado durante
+ * duration_ms y reporta frames/seg entregados y descartados junto con
+ * la cantidad de dashboards conectados (líneas BENCH por el log).
+ * Requiere al menos un dashboard suscripto; pensado para medir qué
+ * sostiene realmente el stack, no para producción.
+ */
+esp_err_t ws_server_run_tx_benchmark(size_t frame_len, uint32_t duration_ms);
+
 /**
  * @brief Verifica si hay al menos un cliente conectado
- * 
+ *
  * @return true si hay clientes conectados
  */
 bool ws_server_has_clients(void);
 
+/**
+ * @brief Verifica si hay algún vehículo registrado
+ *
+ * @return true si hay al menos un cliente con rol de vehículo
+ */
+bool ws_server_has_vehicles(void);
+
 #endif // WS_SERVER_H
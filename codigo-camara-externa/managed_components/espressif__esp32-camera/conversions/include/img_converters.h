@@ -54,6 +54,30 @@ bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, p
  */
 bool frame2jpg_cb(camera_fb_t * fb, uint8_t quality, jpg_out_cb cb, void * arg);
 
+/**
+ * @brief Convert one horizontal band of a camera frame buffer to JPEG
+ *
+ * Bands of the same frame encoded with this function concatenate into a
+ * single valid JPEG: the first band carries the file headers (with the full
+ * frame height) and ends in a restart marker, the last band carries the EOI.
+ * band_y and band_h must be MCU-row aligned (multiples of 16 lines for color
+ * frames, 8 for grayscale) and the first band must span at least as many MCU
+ * rows as any later band.
+ *
+ * @param fb          Source camera frame buffer
+ * @param quality     JPEG quality of the resulting image
+ * @param band_y      First scanline of the band
+ * @param band_h      Height in scanlines of the band
+ * @param first_band  This band opens the file (emit headers)
+ * @param last_band   This band closes the file (emit EOI)
+ * @param cp          Callback to be called to write the bytes of the output JPEG
+ * @param arg         Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool frame2jpg_cb_band(camera_fb_t * fb, uint8_t quality, uint16_t band_y, uint16_t band_h,
+                       bool first_band, bool last_band, jpg_out_cb cb, void * arg);
+
 /**
  * @brief Convert image buffer to JPEG buffer
  *
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <malloc.h>
 #include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
 
 #define JPGE_MAX(a,b) (((a)>(b))?(a):(b))
 #define JPGE_MIN(a,b) (((a)<(b))?(a):(b))
@@ -39,7 +40,7 @@ namespace jpge {
     static inline void jpge_free(void *p) { free(p); }
 
     // Various JPEG enums and tables.
-    enum { M_SOF0 = 0xC0, M_DHT = 0xC4, M_SOI = 0xD8, M_EOI = 0xD9, M_SOS = 0xDA, M_DQT = 0xDB, M_APP0 = 0xE0 };
+    enum { M_SOF0 = 0xC0, M_DHT = 0xC4, M_RST0 = 0xD0, M_SOI = 0xD8, M_EOI = 0xD9, M_SOS = 0xDA, M_DQT = 0xDB, M_DRI = 0xDD, M_APP0 = 0xE0 };
     enum { DC_LUM_CODES = 12, AC_LUM_CODES = 256, DC_CHROMA_CODES = 12, AC_CHROMA_CODES = 256, MAX_HUFF_SYMBOLS = 257, MAX_HUFF_CODESIZE = 32 };
 
     static const uint8 s_zag[64] = { 0,1,8,16,9,2,3,10,17,24,32,25,18,11,4,5,12,19,26,33,40,48,41,34,27,20,13,6,7,14,21,28,35,42,49,56,57,50,43,36,29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,47,55,62,63 };
@@ -73,6 +74,11 @@ namespace jpge {
     static int32 m_last_quality = 0;
     static int32 m_quantization_tables[2][64];
 
+    // The quantization and Huffman tables are shared by every encoder
+    // instance; band-parallel encoding initializes encoders from both
+    // cores, so the lazy table setup needs a lock.
+    static portMUX_TYPE m_tables_lock = portMUX_INITIALIZER_UNLOCKED;
+
     static bool m_huff_initialized = false;
     static uint m_huff_codes[4][256];
     static uint8 m_huff_code_sizes[4][256];
@@ -261,7 +267,9 @@ namespace jpge {
         emit_marker(M_SOF0);                           /* baseline */
         emit_word(3 * m_num_components + 2 + 5 + 1);
         emit_byte(8);                                  /* precision */
-        emit_word(m_image_y);
+        /* In banded mode this encoder only sees its band, but the SOF must
+           declare the full image the concatenated bands reassemble into */
+        emit_word(m_params.m_band_total_height > 0 ? m_params.m_band_total_height : m_image_y);
         emit_word(m_image_x);
         emit_byte(m_num_components);
         for (int i = 0; i < m_num_components; i++)
@@ -302,6 +310,16 @@ namespace jpge {
         }
     }
 
+    // Emit restart interval (banded mode: one interval spans the whole first
+    // band, so its terminating RST0 is the only restart marker in the scan;
+    // later bands are shorter or equal and end the final interval at EOI)
+    void jpeg_encoder::emit_dri()
+    {
+        emit_marker(M_DRI);
+        emit_word(4);
+        emit_word(m_mcus_per_row * (m_image_y_mcu / m_mcu_y));
+    }
+
     // emit start of scan
     void jpeg_encoder::emit_sos()
     {
@@ -618,6 +636,7 @@ namespace jpge {
         for (int i = 1; i < m_mcu_y; i++)
             m_mcu_lines[i] = m_mcu_lines[i-1] + m_image_bpl_mcu;
 
+        portENTER_CRITICAL(&m_tables_lock);
         if(m_last_quality != m_params.m_quality){
             m_last_quality = m_params.m_quality;
             compute_quant_table(m_quantization_tables[0], s_std_lum_quant);
@@ -637,6 +656,7 @@ namespace jpge {
             compute_huffman_table(&m_huff_codes[0+1][0], &m_huff_code_sizes[0+1][0], m_huff_bits[0+1], m_huff_val[0+1]);
             compute_huffman_table(&m_huff_codes[2+1][0], &m_huff_code_sizes[2+1][0], m_huff_bits[2+1], m_huff_val[2+1]);
         }
+        portEXIT_CRITICAL(&m_tables_lock);
 
         m_out_buf_left = JPGE_OUT_BUF_SIZE;
         m_pOut_buf = m_out_buf;
@@ -647,12 +667,17 @@ namespace jpge {
         memset(m_last_dc_val, 0, 3 * sizeof(m_last_dc_val[0]));
 
         // Emit all markers at beginning of image file.
-        emit_marker(M_SOI);
-        emit_jfif_app0();
-        emit_dqt();
-        emit_sof();
-        emit_dhts();
-        emit_sos();
+        if (m_params.m_emit_headers) {
+            emit_marker(M_SOI);
+            emit_jfif_app0();
+            emit_dqt();
+            emit_sof();
+            emit_dhts();
+            if (m_params.m_band_total_height > 0) {
+                emit_dri();
+            }
+            emit_sos();
+        }
 
         return m_all_stream_writes_succeeded;
     }
@@ -669,7 +694,11 @@ namespace jpge {
         }
 
         put_bits(0x7F, 7);
-        emit_marker(M_EOI);
+        if (m_params.m_emit_eoi) {
+            emit_marker(M_EOI);
+        } else {
+            emit_marker(M_RST0); // Band boundary: the next band's data follows
+        }
         flush_output_buffer();
         m_all_stream_writes_succeeded = m_all_stream_writes_succeeded && m_pStream->put_buf(NULL, 0);
         m_pass_num++; // purposely bump up m_pass_num, for debugging
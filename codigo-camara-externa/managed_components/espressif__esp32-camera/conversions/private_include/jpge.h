@@ -18,7 +18,7 @@ namespace jpge
 
     // JPEG compression parameters structure.
     struct params {
-            inline params() : m_quality(85), m_subsampling(H2V2) { }
+            inline params() : m_quality(85), m_subsampling(H2V2), m_band_total_height(0), m_emit_headers(true), m_emit_eoi(true) { }
 
             inline bool check() const {
                 if ((m_quality < 1) || (m_quality > 100)) {
@@ -39,6 +39,20 @@ namespace jpge
             // 2 = H2V1 subsampling (YCbCr 2x1x1, 4 blocks per MCU)
             // 3 = H2V2 subsampling (YCbCr 4x1x1, 6 blocks per MCU-- very common)
             subsampling_t m_subsampling;
+
+            // Banded encoding: an image split at an MCU-row boundary can be
+            // compressed as independent entropy segments joined by restart
+            // markers, so several encoders may work on bands of the same image
+            // concurrently and their outputs simply concatenate. The first band
+            // encoder emits the file headers (declaring m_band_total_height in
+            // the SOF plus a DRI marker sized to the band) and terminates its
+            // scan data with RST0 instead of EOI; the last band emits no
+            // headers and terminates with EOI. The first band must contain at
+            // least as many MCUs as any later band. Defaults give the classic
+            // single-pass whole-image behaviour.
+            int m_band_total_height;  // Full image height for the SOF; 0 = not banded
+            bool m_emit_headers;      // Emit SOI..SOS (first band only)
+            bool m_emit_eoi;          // Terminate with EOI (last band) or RST0
     };
     
     // Output stream abstract class - used by the jpeg_encoder class to write to the output stream.
@@ -117,6 +131,7 @@ namespace jpge
             void emit_sof();
             void emit_dht(uint8 *bits, uint8 *val, int index, bool ac_flag);
             void emit_dhts();
+            void emit_dri();
             void emit_sos();
 
             void compute_quant_table(int32 *dst, const int16 *src);
@@ -139,6 +139,65 @@ bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t fo
     return true;
 }
 
+// Encodes one horizontal band of the image as an independent entropy
+// segment (see jpge::params banded-encoding notes). band_y/band_h must be
+// MCU-row aligned for the chosen subsampling (16 lines for H2V2, 8 for
+// grayscale); first/last select which band carries the headers and the EOI.
+static bool convert_image_band(uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+                               uint16_t band_y, uint16_t band_h, bool first, bool last, jpge::output_stream *dst_stream)
+{
+    int num_channels = 3;
+    jpge::subsampling_t subsampling = jpge::H2V2;
+
+    if(format == PIXFORMAT_GRAYSCALE) {
+        num_channels = 1;
+        subsampling = jpge::Y_ONLY;
+    }
+
+    if(!quality) {
+        quality = 1;
+    } else if(quality > 100) {
+        quality = 100;
+    }
+
+    jpge::params comp_params = jpge::params();
+    comp_params.m_subsampling = subsampling;
+    comp_params.m_quality = quality;
+    comp_params.m_band_total_height = height;
+    comp_params.m_emit_headers = first;
+    comp_params.m_emit_eoi = last;
+
+    jpge::jpeg_encoder dst_image;
+
+    if (!dst_image.init(dst_stream, width, band_h, num_channels, comp_params)) {
+        ESP_LOGE(TAG, "JPG band encoder init failed");
+        return false;
+    }
+
+    uint8_t* line = (uint8_t*)_malloc(width * num_channels);
+    if(!line) {
+        ESP_LOGE(TAG, "Scan line malloc failed");
+        return false;
+    }
+
+    for (int i = band_y; i < band_y + band_h; i++) {
+        convert_line_format(src, format, line, width, num_channels, i);
+        if (!dst_image.process_scanline(line)) {
+            ESP_LOGE(TAG, "JPG process line %u failed", i);
+            free(line);
+            return false;
+        }
+    }
+    free(line);
+
+    if (!dst_image.process_scanline(NULL)) {
+        ESP_LOGE(TAG, "JPG band finish failed");
+        return false;
+    }
+    dst_image.deinit();
+    return true;
+}
+
 class callback_stream : public jpge::output_stream {
 protected:
     jpg_out_cb ocb;
@@ -170,6 +229,14 @@ bool frame2jpg_cb(camera_fb_t * fb, uint8_t quality, jpg_out_cb cb, void * arg)
     return fmt2jpg_cb(fb->buf, fb->len, fb->width, fb->height, fb->format, quality, cb, arg);
 }
 
+bool frame2jpg_cb_band(camera_fb_t * fb, uint8_t quality, uint16_t band_y, uint16_t band_h,
+                       bool first_band, bool last_band, jpg_out_cb cb, void * arg)
+{
+    callback_stream dst_stream(cb, arg);
+    return convert_image_band(fb->buf, fb->width, fb->height, fb->format, quality,
+                              band_y, band_h, first_band, last_band, &dst_stream);
+}
+
 
 
 class memory_stream : public jpge::output_stream {
@@ -0,0 +1,115 @@
+# Suite de regresión de rendimiento sobre pytest-embedded.
+#
+# Flashea el firmware construido con CONFIG_VISION_BENCHMARK_ON_BOOT=y
+# (ver main/Kconfig.projbuild), recolecta las líneas BENCH que los
+# benchmarks de visión imprimen al arrancar y compara ciclos/unidad
+# contra perf_baselines.json. Una regresión mayor al 5% en cualquier
+# kernel caliente falla la corrida: así los cambios "no relacionados"
+# dejan de comerse las mejoras de rendimiento en silencio.
+#
+# Para registrar nuevas baselines tras una mejora intencional:
+#   PERF_UPDATE_BASELINES=1 pytest pytest_perf_regression.py
+import json
+import logging
+import os
+import re
+
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+from pytest_embedded_idf.utils import idf_parametrize
+
+BASELINE_FILE = os.path.join(os.path.dirname(__file__), 'perf_baselines.json')
+
+# Margen antes de declarar regresión; el ruido de corrida a corrida en
+# los kernels sintéticos medidos por ciclos está muy por debajo
+REGRESSION_TOLERANCE = 0.05
+
+# BENCH,<kernel>,<resolución>,<iter>,<ciclos>,<ciclos/unidad>[,<insn>,<dmiss>]
+# Las columnas del perfmon son opcionales: 0,0 cuando no hay contadores
+BENCH_LINE = re.compile(
+    rb'BENCH,(?P<kernel>\w+),(?P<resolution>[\dx]+),(?P<iterations>\d+),'
+    rb'(?P<cycles>\d+),(?P<cycles_per_unit>[\d.]+)'
+    rb'(?:,(?P<instructions>\d+),(?P<d_load_misses>\d+))?'
+)
+
+# BENCH,ws_tx,... del benchmark de transmisión (formato clave=valor)
+WS_TX_LINE = re.compile(rb'BENCH,ws_tx,.*delivered_fps=(?P<delivered_fps>\d+)')
+
+# 2 kernels x 3 resoluciones + 3 variantes de homografía
+EXPECTED_BENCH_LINES = 9
+
+
+def _load_baselines() -> dict:
+    with open(BASELINE_FILE, encoding='utf-8') as f:
+        return json.load(f)
+
+
+def _store_baselines(baselines: dict) -> None:
+    with open(BASELINE_FILE, 'w', encoding='utf-8') as f:
+        json.dump(baselines, f, indent=2, ensure_ascii=False)
+        f.write('\n')
+
+
+def _collect_results(dut: IdfDut) -> dict:
+    results = {}
+    for _ in range(EXPECTED_BENCH_LINES):
+        match = dut.expect(BENCH_LINE, timeout=180)
+        kernel = match.group('kernel').decode()
+        resolution = match.group('resolution').decode()
+        key = f'{kernel}@{resolution}'
+        results[key] = float(match.group('cycles_per_unit'))
+        if match.group('instructions') is not None:
+            insn = int(match.group('instructions'))
+            dmiss = int(match.group('d_load_misses'))
+            cycles = int(match.group('cycles'))
+            ipc = cycles and insn / cycles or 0.0
+            logging.info('%s: %.2f ciclos/unidad, IPC %.2f, %d fallos de carga',
+                         key, results[key], ipc, dmiss)
+        else:
+            logging.info('%s: %.2f ciclos/unidad (sin perfmon)', key, results[key])
+    return results
+
+
+@pytest.mark.generic
+@idf_parametrize('target', ['esp32'], indirect=['target'])
+def test_vision_kernel_regressions(dut: IdfDut) -> None:
+    baselines = _load_baselines()
+    results = _collect_results(dut)
+
+    if os.environ.get('PERF_UPDATE_BASELINES') == '1':
+        baselines['cycles_per_unit'] = {k: round(v, 1) for k, v in sorted(results.items())}
+        _store_baselines(baselines)
+        logging.info('Baselines actualizadas en %s', BASELINE_FILE)
+        return
+
+    failures = []
+    for key, baseline in baselines['cycles_per_unit'].items():
+        if key not in results:
+            failures.append(f'{key}: sin línea BENCH (¿kernel renombrado?)')
+            continue
+        limit = baseline * (1.0 + REGRESSION_TOLERANCE)
+        if results[key] > limit:
+            failures.append(
+                f'{key}: {results[key]:.2f} ciclos/unidad contra baseline '
+                f'{baseline:.2f} (+{(results[key] / baseline - 1) * 100:.1f}%)'
+            )
+
+    assert not failures, 'Regresiones de rendimiento:\n' + '\n'.join(failures)
+
+
+@pytest.mark.generic
+@idf_parametrize('target', ['esp32'], indirect=['target'])
+def test_ws_tx_throughput(dut: IdfDut) -> None:
+    # El benchmark de ws_queue_frame necesita un dashboard conectado al
+    # SoftAP además de ENABLE_WS_TX_BENCHMARK; en una corrida normal la
+    # línea no aparece y el test se omite en lugar de fallar
+    if os.environ.get('PERF_WS_TX') != '1':
+        pytest.skip('benchmark ws_tx no habilitado (PERF_WS_TX=1 con dashboard conectado)')
+
+    baselines = _load_baselines()
+    match = dut.expect(WS_TX_LINE, timeout=300)
+    delivered_fps = int(match.group('delivered_fps'))
+    minimum = baselines['ws_tx']['min_delivered_fps']
+    assert delivered_fps >= minimum, (
+        f'ws_queue_frame entregó {delivered_fps} fps, piso {minimum} fps'
+    )
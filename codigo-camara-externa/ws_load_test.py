@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+# Generador de carga WebSocket contra un S3 real.
+#
+# Los límites de escala de ws_server.c (agotamiento de la tabla de
+# clientes, saturación de las colas de TX, colapso de heap) se venían
+# descubriendo en el campo. Este script simula N vehículos empujando
+# frames binarios a una tasa configurable más M dashboards suscriptos,
+# y reporta FPS entregados por dashboard, latencia de comandos de
+# control bajo carga (dashboard→servidor→vehículo, medida de punta a
+# punta porque ambos extremos viven en este proceso) y el umbral de
+# falla cuando se usa --ramp.
+#
+# Habla el protocolo real del servidor:
+#   - register con role vehicle/dashboard (ws_handle_text_message)
+#   - subscribe a esp32cam (los frames de vehículo salen por esa fuente)
+#   - video binario: JPEG crudo desde el vehículo; el servidor lo
+#     reenvía con cabecera 'V','F' + fuente + secuencia (ws_frame_header_t)
+#   - control con seq y cmd_ack de vuelta, para que la contabilidad
+#     de entrega del servidor (/stats, /metrics) también trabaje
+#
+# Uso típico (laptop asociada al SoftAP):
+#   python3 ws_load_test.py --vehicles 2 --dashboards 3 --fps 15
+#   python3 ws_load_test.py --ramp --duration 20   # escala hasta fallar
+#
+# Dependencias: pip install websockets
+import argparse
+import asyncio
+import json
+import statistics
+import struct
+import sys
+import time
+
+try:
+    import websockets
+except ImportError:
+    sys.exit('Falta la dependencia websockets: pip install websockets')
+
+FRAME_MAGIC = b'VF'
+STATUS_MAGIC = b'VS'
+
+# Cabecera que el servidor antepone a cada frame reenviado:
+# magia(2) + fuente(1) + reservado(1) + secuencia(u32 LE) +
+# envio(u32 LE) + captura(u32 LE)
+FRAME_HEADER = struct.Struct('<2sBBIII')
+
+
+def now_ms() -> float:
+    return time.monotonic() * 1000.0
+
+
+class Metrics:
+    """Acumuladores compartidos de toda la corrida."""
+
+    def __init__(self) -> None:
+        self.frames_sent = 0
+        self.frames_delivered = 0
+        self.seq_gaps = 0
+        self.cmd_latencies_ms: list[float] = []
+        self.cmds_sent = 0
+        self.cmds_lost = 0
+        self.connect_failures = 0
+        self.disconnects = 0
+
+    def report(self, elapsed_s: float, dashboards: int) -> str:
+        lines = []
+        per_dash = self.frames_delivered / max(dashboards, 1)
+        lines.append(f'Frames enviados:    {self.frames_sent} '
+                     f'({self.frames_sent / elapsed_s:.1f}/s agregado)')
+        lines.append(f'Frames entregados:  {self.frames_delivered} '
+                     f'({per_dash / elapsed_s:.1f} FPS por dashboard)')
+        lines.append(f'Huecos de secuencia: {self.seq_gaps}')
+        sent = self.cmds_sent
+        done = len(self.cmd_latencies_ms)
+        lines.append(f'Comandos:           {sent} enviados, {done} entregados, '
+                     f'{self.cmds_lost} perdidos')
+        if self.cmd_latencies_ms:
+            lat = sorted(self.cmd_latencies_ms)
+            p50 = lat[len(lat) // 2]
+            p95 = lat[int(len(lat) * 0.95)]
+            lines.append(f'Latencia de control: p50={p50:.1f}ms '
+                         f'p95={p95:.1f}ms max={lat[-1]:.1f}ms')
+        lines.append(f'Fallas de conexión: {self.connect_failures}, '
+                     f'desconexiones: {self.disconnects}')
+        return '\n'.join(lines)
+
+
+def fake_jpeg(size: int) -> bytes:
+    # SOI + relleno incompresible-parecido; el servidor no decodifica,
+    # solo necesita que no empiece como un estado 'VS'
+    body = bytes((i * 131 + 17) & 0xFF for i in range(size - 4))
+    return b'\xff\xd8' + body + b'\xff\xd9'
+
+
+async def vehicle_task(args, metrics: Metrics, index: int,
+                       pending_cmds: dict, stop: asyncio.Event) -> None:
+    """Un vehículo: register, frames a --fps, cmd_ack a cada control."""
+    uri = f'ws://{args.host}:{args.port}/ws'
+    vehicle_id = f'loadgen-{index}'
+    payload = fake_jpeg(args.frame_bytes)
+    try:
+        async with websockets.connect(uri, max_size=2 ** 22) as ws:
+            await ws.send(json.dumps({'type': 'register', 'role': 'vehicle',
+                                      'vehicle_id': vehicle_id}))
+
+            async def pump_frames() -> None:
+                period = 1.0 / args.fps
+                while not stop.is_set():
+                    await ws.send(payload)
+                    metrics.frames_sent += 1
+                    await asyncio.sleep(period)
+
+            async def handle_rx() -> None:
+                async for msg in ws:
+                    if isinstance(msg, bytes):
+                        continue
+                    try:
+                        data = json.loads(msg)
+                    except ValueError:
+                        continue
+                    if data.get('type') != 'control':
+                        continue
+                    seq = data.get('seq')
+                    if seq in pending_cmds:
+                        metrics.cmd_latencies_ms.append(
+                            now_ms() - pending_cmds.pop(seq))
+                    if seq is not None:
+                        await ws.send(json.dumps(
+                            {'type': 'cmd_ack', 'seq': seq}))
+
+            pump = asyncio.create_task(pump_frames())
+            rx = asyncio.create_task(handle_rx())
+            await stop.wait()
+            pump.cancel()
+            rx.cancel()
+    except (OSError, websockets.WebSocketException):
+        if not stop.is_set():
+            metrics.connect_failures += 1
+            stop.set()  # Umbral de falla alcanzado: cortar la corrida
+
+
+async def dashboard_task(args, metrics: Metrics, index: int,
+                         pending_cmds: dict, seq_base: int,
+                         stop: asyncio.Event) -> None:
+    """Un dashboard: subscribe, cuenta frames 'VF' y emite controles."""
+    uri = f'ws://{args.host}:{args.port}/ws'
+    try:
+        async with websockets.connect(uri, max_size=2 ** 22) as ws:
+            await ws.send(json.dumps({'type': 'register', 'role': 'dashboard'}))
+            await ws.send(json.dumps({'type': 'subscribe', 'source': 'esp32cam'}))
+
+            last_seq = None
+
+            async def handle_rx() -> None:
+                nonlocal last_seq
+                async for msg in ws:
+                    if not isinstance(msg, bytes) or len(msg) < FRAME_HEADER.size:
+                        continue
+                    if msg[:2] == FRAME_MAGIC:
+                        magic, _src, _res, seq, _ts, _cap = FRAME_HEADER.unpack(
+                            msg[:FRAME_HEADER.size])
+                        metrics.frames_delivered += 1
+                        if last_seq is not None and seq > last_seq + 1:
+                            metrics.seq_gaps += seq - last_seq - 1
+                        last_seq = seq
+
+            async def pump_cmds() -> None:
+                # Cada dashboard usa un rango de seq propio para que los
+                # acuses no se crucen entre generadores
+                seq = seq_base
+                while not stop.is_set():
+                    seq += 1
+                    pending_cmds[seq] = now_ms()
+                    metrics.cmds_sent += 1
+                    await ws.send(json.dumps({
+                        'type': 'control', 'command': 'forward',
+                        'vehicle_id': '*', 'seq': seq}))
+                    await asyncio.sleep(1.0 / args.cmd_rate)
+
+            rx = asyncio.create_task(handle_rx())
+            cmds = asyncio.create_task(pump_cmds()) if args.cmd_rate > 0 else None
+            await stop.wait()
+            rx.cancel()
+            if cmds:
+                cmds.cancel()
+    except (OSError, websockets.WebSocketException):
+        if not stop.is_set():
+            metrics.connect_failures += 1
+            stop.set()
+
+
+async def run_step(args, vehicles: int, dashboards: int) -> Metrics:
+    metrics = Metrics()
+    pending_cmds: dict = {}
+    stop = asyncio.Event()
+
+    tasks = []
+    for i in range(vehicles):
+        tasks.append(asyncio.create_task(
+            vehicle_task(args, metrics, i, pending_cmds, stop)))
+    # Dejar que los vehículos registren antes de colgar espectadores
+    await asyncio.sleep(0.5)
+    for i in range(dashboards):
+        tasks.append(asyncio.create_task(
+            dashboard_task(args, metrics, i, pending_cmds,
+                           (i + 1) * 1_000_000, stop)))
+
+    start = time.monotonic()
+    try:
+        await asyncio.wait_for(stop.wait(), timeout=args.duration)
+    except asyncio.TimeoutError:
+        pass
+    stop.set()
+    await asyncio.gather(*tasks, return_exceptions=True)
+
+    metrics.cmds_lost = len(pending_cmds)
+    elapsed = time.monotonic() - start
+    print(f'\n== {vehicles} vehículos, {dashboards} dashboards, '
+          f'{args.fps} FPS x {args.frame_bytes}B, {elapsed:.1f}s ==')
+    print(metrics.report(elapsed, dashboards))
+    return metrics
+
+
+def step_healthy(args, metrics: Metrics, dashboards: int) -> bool:
+    """Criterio de falla del modo rampa."""
+    if metrics.connect_failures:
+        return False
+    # Entrega por debajo de la mitad de lo ofrecido = saturación
+    offered = args.fps * args.duration
+    delivered = metrics.frames_delivered / max(dashboards, 1)
+    if delivered < offered * 0.5:
+        return False
+    if metrics.cmd_latencies_ms and \
+            statistics.median(metrics.cmd_latencies_ms) > args.cmd_latency_limit_ms:
+        return False
+    return True
+
+
+async def main_async(args) -> int:
+    if not args.ramp:
+        await run_step(args, args.vehicles, args.dashboards)
+        return 0
+
+    # Rampa: más dashboards por paso hasta el primer paso insalubre;
+    # los dashboards son lo que agota tabla de clientes y colas de TX
+    last_good = None
+    for dashboards in range(1, args.max_dashboards + 1):
+        metrics = await run_step(args, args.vehicles, dashboards)
+        if not step_healthy(args, metrics, dashboards):
+            print(f'\nUmbral de falla: {dashboards} dashboards '
+                  f'(último paso sano: {last_good})')
+            return 1
+        last_good = dashboards
+        await asyncio.sleep(2)  # Que el servidor libere slots/keepalive
+    print(f'\nSin falla hasta {args.max_dashboards} dashboards')
+    return 0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(
+        description='Generador de carga WebSocket para ws_server.c')
+    parser.add_argument('--host', default='192.168.4.1')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--vehicles', type=int, default=1)
+    parser.add_argument('--dashboards', type=int, default=2)
+    parser.add_argument('--fps', type=float, default=10.0,
+                        help='Frames por segundo por vehículo')
+    parser.add_argument('--frame-bytes', type=int, default=12 * 1024,
+                        help='Tamaño del JPEG sintético (QVGA ronda 12KB)')
+    parser.add_argument('--cmd-rate', type=float, default=5.0,
+                        help='Comandos de control por segundo por dashboard')
+    parser.add_argument('--duration', type=float, default=15.0,
+                        help='Segundos por paso')
+    parser.add_argument('--ramp', action='store_true',
+                        help='Escalar dashboards hasta el umbral de falla')
+    parser.add_argument('--max-dashboards', type=int, default=8)
+    parser.add_argument('--cmd-latency-limit-ms', type=float, default=500.0,
+                        help='Mediana de latencia de control tolerada en rampa')
+    args = parser.parse_args()
+    return asyncio.run(main_async(args))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
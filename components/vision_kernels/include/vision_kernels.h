@@ -0,0 +1,36 @@
+#ifndef VISION_KERNELS_H
+#define VISION_KERNELS_H
+
+/**
+ * @file vision_kernels.h
+ * @brief Kernels de visión compartidos entre ambos firmwares
+ *
+ * La conversión RGB565→HSV y la comparación contra rangos estaban
+ * copiadas en codigo-auto y codigo-camara-externa, y las copias ya
+ * habían empezado a divergir (el escalado de saturación se corrigió en
+ * una sola). Este componente las unifica: se optimiza y se mide una
+ * vez, y los dos firmwares heredan el resultado.
+ *
+ * El encabezado selecciona un backend por target en tiempo de
+ * compilación. Hoy todos los targets usan el backend genérico de
+ * aritmética entera; si algún kernel justifica una versión con las
+ * extensiones del S3, su encabezado se suma al #if de abajo sin tocar
+ * a los llamadores.
+ *
+ * Las capas de LUT y de escaneo siguen en cada firmware: sus formatos
+ * de acumulación difieren (máscara multi-color en la cámara, 1 bit por
+ * valor en el auto) y compartirlas forzaría al peor de los dos.
+ */
+
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#endif
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+// Sin backend propio todavía: el S3 también usa el genérico
+#include "vk_backend_generic.h"
+#else
+#include "vk_backend_generic.h"
+#endif
+
+#endif // VISION_KERNELS_H
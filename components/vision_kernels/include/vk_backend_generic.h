@@ -0,0 +1,148 @@
+#ifndef VK_BACKEND_GENERIC_H
+#define VK_BACKEND_GENERIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @file vk_backend_generic.h
+ * @brief Backend genérico: aritmética entera portable
+ *
+ * No incluir directamente; incluir vision_kernels.h, que elige el
+ * backend según el target.
+ */
+
+/**
+ * @brief Convierte un píxel RGB565 a HSV con aritmética de enteros
+ *
+ * Saturación escalada como (delta * 255) / max. Nota: no usar
+ * (delta << 8): con min=0 da 256, que truncado en uint8_t deja s=0
+ * justo para los píxeles más saturados.
+ *
+ * @param pixel Píxel en formato RGB565 (16 bits)
+ * @param h Puntero para almacenar Matiz (0-255)
+ * @param s Puntero para almacenar Saturación (0-255)
+ * @param v Puntero para almacenar Valor (0-255)
+ */
+static inline void vk_rgb565_to_hsv(uint16_t pixel, uint8_t *h, uint8_t *s, uint8_t *v)
+{
+    // Extracción de componentes con máscaras: RRRRR GGGGGG BBBBB
+    uint8_t r = (pixel & 0xF800) >> 8; // 5 bits expandidos a 8 bits
+    uint8_t g = (pixel & 0x07E0) >> 3; // 6 bits expandidos a 8 bits
+    uint8_t b = (pixel & 0x001F) << 3; // 5 bits expandidos a 8 bits
+
+    uint8_t min_val = (r < g) ? (r < b ? r : b) : (g < b ? g : b);
+    uint8_t max_val = (r > g) ? (r > b ? r : b) : (g > b ? g : b);
+    uint8_t delta = max_val - min_val;
+
+    *v = max_val; // Valor es el máximo
+
+    if (delta == 0)
+    {
+        *h = 0;
+        *s = 0;
+        return;
+    }
+
+    *s = (uint16_t)(delta * 255) / max_val;
+
+    // El factor 43 aproxima (255 / 6) para escalar los sectores de 60 grados
+    if (r == max_val)
+    {
+        // Sector rojo-amarillo (con wraparound en 0)
+        if (g >= b)
+            *h = (43 * (g - b)) / delta;
+        else
+            *h = 255 + (43 * (g - b)) / delta;
+    }
+    else if (g == max_val)
+    {
+        // Sector verde-cian
+        *h = 85 + (43 * (b - r)) / delta;
+    }
+    else
+    {
+        // Sector azul-magenta
+        *h = 171 + (43 * (r - g)) / delta;
+    }
+}
+
+/**
+ * @brief Variante solo matiz y valor: omite la división de saturación
+ *
+ * La división de S es la operación más cara de la conversión; el modo
+ * solo-matiz del clasificador la salta por completo. V sale gratis (es
+ * el máximo) y se sigue verificando.
+ *
+ * @param pixel Píxel en formato RGB565 (16 bits)
+ * @param h Puntero para almacenar Matiz (0-255)
+ * @param v Puntero para almacenar Valor (0-255)
+ */
+static inline void vk_rgb565_to_hue_value(uint16_t pixel, uint8_t *h, uint8_t *v)
+{
+    uint8_t r = (pixel & 0xF800) >> 8;
+    uint8_t g = (pixel & 0x07E0) >> 3;
+    uint8_t b = (pixel & 0x001F) << 3;
+
+    uint8_t min_val = (r < g) ? (r < b ? r : b) : (g < b ? g : b);
+    uint8_t max_val = (r > g) ? (r > b ? r : b) : (g > b ? g : b);
+    uint8_t delta = max_val - min_val;
+
+    *v = max_val;
+
+    if (delta == 0)
+    {
+        *h = 0;
+        return;
+    }
+
+    if (r == max_val)
+    {
+        *h = (g >= b) ? (43 * (g - b)) / delta : 255 + (43 * (g - b)) / delta;
+    }
+    else if (g == max_val)
+    {
+        *h = 85 + (43 * (b - r)) / delta;
+    }
+    else
+    {
+        *h = 171 + (43 * (r - g)) / delta;
+    }
+}
+
+/**
+ * @brief Verifica si un píxel HSV cae dentro de un rango
+ *
+ * h_min > h_max codifica un rango con wraparound (ej: rojo que cruza 0).
+ *
+ * @param h Matiz del píxel (0-255)
+ * @param s Saturación del píxel (0-255)
+ * @param v Valor del píxel (0-255)
+ * @param h_min Límite inferior de matiz
+ * @param h_max Límite superior de matiz
+ * @param s_min Límite inferior de saturación
+ * @param s_max Límite superior de saturación
+ * @param v_min Límite inferior de valor
+ * @param v_max Límite superior de valor
+ * @return true si el píxel está dentro del rango
+ */
+static inline bool vk_hsv_in_range(uint8_t h, uint8_t s, uint8_t v,
+                                   uint8_t h_min, uint8_t h_max,
+                                   uint8_t s_min, uint8_t s_max,
+                                   uint8_t v_min, uint8_t v_max)
+{
+    // Saturación y valor primero (sin wraparound, rechazan más barato)
+    if (s < s_min || s > s_max)
+        return false;
+    if (v < v_min || v > v_max)
+        return false;
+
+    if (h_min <= h_max)
+    {
+        return (h >= h_min && h <= h_max);
+    }
+
+    return (h >= h_min || h <= h_max);
+}
+
+#endif // VK_BACKEND_GENERIC_H
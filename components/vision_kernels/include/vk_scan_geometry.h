@@ -0,0 +1,27 @@
+#ifndef VK_SCAN_GEOMETRY_H
+#define VK_SCAN_GEOMETRY_H
+
+/**
+ * @file vk_scan_geometry.h
+ * @brief Geometrías de frame fijas del proyecto
+ *
+ * Los sensores solo se configuran en tres tamaños, así que los kernels
+ * de escaneo no necesitan tratar el ancho como un valor arbitrario de
+ * runtime. Cada firmware estampa con esta lista X-macro variantes
+ * especializadas de su bucle caliente: con el ancho como constante de
+ * compilación el compilador desenrolla el bucle interior con cuenta de
+ * iteraciones fija y reduce la fuerza del paso de fila, en el espíritu
+ * de la especialización de plantillas. El llamador despacha por ancho
+ * con una tabla y cae en la versión genérica para cualquier otra
+ * geometría.
+ *
+ * Uso:
+ *   #define MI_VARIANTE(W, H) ...definición con W constante...
+ *   VK_SCAN_GEOMETRIES(MI_VARIANTE)
+ */
+#define VK_SCAN_GEOMETRIES(X) \
+    X(160, 120) /* QQVGA */   \
+    X(320, 240) /* QVGA */    \
+    X(640, 480) /* VGA */
+
+#endif // VK_SCAN_GEOMETRY_H
@@ -0,0 +1,333 @@
+/**
+ * Simulador de host para los kernels de visión
+ *
+ * Compila vision.c, homography.c y trajectory.c nativos con stubs de
+ * logging y FreeRTOS, alimenta un volcado de frame grabado (RGB565 crudo)
+ * o un frame sintético, y reporta tiempos por kernel. Iterar algoritmos
+ * acá es órdenes de magnitud más rápido que el ciclo flashear-bootear-
+ * serial del devkit; los números absolutos no son los del ESP32-S3, pero
+ * los relativos entre dos versiones del mismo kernel sí ordenan igual.
+ */
+
+#include "vision/vision.h"
+#include "vision/homography.h"
+#include "vision/trajectory.h"
+#include "event_log/event_log.h"
+#include "mem_arena/mem_arena.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_DEFAULT_WIDTH 640
+#define SIM_DEFAULT_HEIGHT 480
+#define SIM_DEFAULT_ITERATIONS 100
+
+static uint32_t s_events_pushed = 0;
+
+// El anillo de eventos real necesita tareas; en el host alcanza con
+// contar lo que el kernel hubiera reportado
+bool event_log_push(event_code_t code,
+                    int32_t arg1,
+                    int32_t arg2,
+                    int32_t arg3,
+                    int32_t aux1,
+                    int32_t aux2)
+{
+    (void)code;
+    (void)arg1;
+    (void)arg2;
+    (void)arg3;
+    (void)aux1;
+    (void)aux2;
+    s_events_pushed++;
+    return true;
+}
+
+/**
+ * Mismo frame sintético que test_benchmark.c: fondo gris con un cuadrado
+ * verde del 10%% del ancho centrado
+ */
+static uint16_t *synthetic_frame_create(int width, int height)
+{
+    uint16_t *frame = malloc((size_t)width * height * sizeof(uint16_t));
+    if (frame == NULL)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < width * height; i++)
+    {
+        frame[i] = 0x8410; // Gris medio
+    }
+
+    int square = width / 10;
+    int x0 = (width - square) / 2;
+    int y0 = (height - square) / 2;
+    for (int y = y0; y < y0 + square; y++)
+    {
+        for (int x = x0; x < x0 + square; x++)
+        {
+            frame[y * width + x] = 0x07E0; // Verde puro
+        }
+    }
+
+    return frame;
+}
+
+static uint16_t *frame_load(const char *path, int width, int height)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "No se pudo abrir %s\n", path);
+        return NULL;
+    }
+
+    size_t expected = (size_t)width * height * sizeof(uint16_t);
+    uint16_t *frame = malloc(expected);
+    if (frame == NULL)
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    size_t got = fread(frame, 1, expected, f);
+    fclose(f);
+
+    if (got != expected)
+    {
+        fprintf(stderr, "%s: se esperaban %zu bytes, se leyeron %zu\n",
+                path, expected, got);
+        free(frame);
+        return NULL;
+    }
+
+    return frame;
+}
+
+static void bench_report(const char *kernel, int width, int height,
+                         int iterations, int64_t total_us)
+{
+    printf("BENCH,%s,%dx%d,%d,%lld,%.3f\n",
+           kernel, width, height, iterations,
+           (long long)total_us, (double)total_us / iterations / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *frame_path = NULL;
+    int width = SIM_DEFAULT_WIDTH;
+    int height = SIM_DEFAULT_HEIGHT;
+    int iterations = SIM_DEFAULT_ITERATIONS;
+
+    if (argc >= 4)
+    {
+        frame_path = argv[1];
+        width = atoi(argv[2]);
+        height = atoi(argv[3]);
+    }
+    if (argc >= 5)
+    {
+        iterations = atoi(argv[4]);
+    }
+    if (width <= 0 || height <= 0 || iterations <= 0)
+    {
+        fprintf(stderr,
+                "Uso: %s [frame.rgb565 ancho alto] [iteraciones]\n"
+                "Sin argumentos usa un frame sintético de %dx%d\n",
+                argv[0], SIM_DEFAULT_WIDTH, SIM_DEFAULT_HEIGHT);
+        return 1;
+    }
+
+    uint16_t *frame = frame_path != NULL
+                          ? frame_load(frame_path, width, height)
+                          : synthetic_frame_create(width, height);
+    if (frame == NULL)
+    {
+        return 1;
+    }
+
+    printf("Simulador de visión: frame %s de %dx%d, %d iteraciones\n",
+           frame_path != NULL ? frame_path : "sintético", width, height,
+           iterations);
+
+    // Misma arena de scratch que arma vision_task.c en el firmware; sin
+    // ella blob_refine() rechaza todo candidato y el simulador no mide
+    // el camino real. El reset por iteración también espeja al firmware
+    // (una generación de arena por frame).
+    if (mem_arena_init(12 * 1024, 16 * 1024) != ESP_OK)
+    {
+        fprintf(stderr, "Sin arena de scratch - detección degradada\n");
+    }
+
+    // ========== DETECCIÓN ==========
+    detection_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    // Calentamiento: construye la LUT de clasificación fuera de la medición
+    mem_arena_reset();
+    detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &result);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        mem_arena_reset();
+        detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &result);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    bench_report("detect_object_by_color", width, height, iterations, elapsed);
+
+    if (result.detected)
+    {
+        printf("  Detección: centroide (%d, %d), %lu píxeles, "
+               "bbox [%d,%d]-[%d,%d]\n",
+               result.centroid_x, result.centroid_y,
+               (unsigned long)result.pixel_count,
+               result.bbox_x_min, result.bbox_y_min,
+               result.bbox_x_max, result.bbox_y_max);
+    }
+    else
+    {
+        printf("  Sin detección en este frame\n");
+        if (frame_path == NULL)
+        {
+            // El frame sintético siempre trae el cuadrado verde: sin
+            // detección, las verificaciones incremental-vs-denso y de
+            // modelo de fondo de abajo comparan cero contra cero y no
+            // validan nada (ya pasó: la arena sin inicializar dejó el
+            // simulador "verde" midiendo un camino que no clasificaba)
+            fprintf(stderr, "ERROR: el cuadrado sintético no se detectó\n");
+            free(frame);
+            return 1;
+        }
+    }
+
+    // Multi-color en una pasada
+    const color_range_t *colors[] = {&COLOR_RED, &COLOR_GREEN,
+                                     &COLOR_BLUE, &COLOR_YELLOW};
+    detection_result_t results[4];
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        mem_arena_reset();
+        detect_objects_multi_color(frame, width, height, colors, 4, NULL, results);
+    }
+    elapsed = esp_timer_get_time() - start;
+    bench_report("detect_objects_multi_color_4", width, height, iterations,
+                 elapsed);
+
+    // Detección incremental: pasadas repetidas sobre el mismo frame, el
+    // caso de arena estática que la caché por tiles acelera. La primera
+    // pasada calienta los checksums fuera de la medición.
+    vision_set_incremental_detection(true);
+    detection_result_t inc_result;
+    memset(&inc_result, 0, sizeof(inc_result));
+    mem_arena_reset();
+    detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &inc_result);
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        mem_arena_reset();
+        detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &inc_result);
+    }
+    elapsed = esp_timer_get_time() - start;
+    vision_set_incremental_detection(false);
+    bench_report("detect_object_incremental", width, height, iterations, elapsed);
+
+    if (inc_result.detected != result.detected ||
+        inc_result.centroid_x != result.centroid_x ||
+        inc_result.centroid_y != result.centroid_y ||
+        inc_result.pixel_count != result.pixel_count)
+    {
+        printf("  AVISO: la pasada incremental difiere de la densa\n");
+    }
+
+    // Modelo de fondo: perturbar un bloque gris fuera de tolerancia y
+    // verificar que el camino de primer plano da lo mismo que el denso
+    if (width >= 64 && height >= 64)
+    {
+        for (int y = 16; y < 32; y++)
+        {
+            for (int x = 16; x < 48; x++)
+            {
+                frame[y * width + x] ^= 0x1084; // Salta la tolerancia por canal
+            }
+        }
+
+        detection_result_t fg_result;
+        memset(&fg_result, 0, sizeof(fg_result));
+        vision_set_incremental_detection(true);
+        mem_arena_reset();
+        detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &fg_result);
+        vision_set_incremental_detection(false);
+
+        detection_result_t dense_result;
+        memset(&dense_result, 0, sizeof(dense_result));
+        mem_arena_reset();
+        detect_object_by_color(frame, width, height, &COLOR_GREEN, NULL, &dense_result);
+
+        if (fg_result.detected != dense_result.detected ||
+            fg_result.pixel_count != dense_result.pixel_count)
+        {
+            printf("  AVISO: el modelo de fondo difiere del escaneo denso "
+                   "(%lu vs %lu píxeles)\n",
+                   (unsigned long)fg_result.pixel_count,
+                   (unsigned long)dense_result.pixel_count);
+        }
+    }
+
+    // ========== HOMOGRAFÍA ==========
+    homography_matrix_t h_matrix;
+    homography_load_default(&h_matrix, width, height, 100.0f, 80.0f);
+
+    enum { POINTS = 1000 };
+    static pixel_point_t pixels[POINTS];
+    static world_point_t worlds[POINTS];
+    for (int i = 0; i < POINTS; i++)
+    {
+        pixels[i].u = (i * 37) % width;
+        pixels[i].v = (i * 53) % height;
+    }
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        homography_transform_batch(&h_matrix, pixels, worlds, POINTS);
+    }
+    elapsed = esp_timer_get_time() - start;
+    bench_report("homography_batch_1000pt", width, height, iterations, elapsed);
+
+    homography_set_fixed_point(true);
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        homography_transform_batch(&h_matrix, pixels, worlds, POINTS);
+    }
+    elapsed = esp_timer_get_time() - start;
+    homography_set_fixed_point(false);
+    bench_report("homography_batch_fixed_1000pt", width, height, iterations,
+                 elapsed);
+
+    // ========== TRAYECTORIA ==========
+    trajectory_reset(-1);
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++)
+    {
+        world_point_t p = {.x = 10.0f + i * 0.5f, .y = 20.0f + i * 0.25f};
+        trajectory_update(0, p, (uint32_t)(i * 33));
+
+        float vx, vy;
+        trajectory_get_velocity(0, &vx, &vy, NULL, NULL);
+    }
+    elapsed = esp_timer_get_time() - start;
+    bench_report("trajectory_update_fit", width, height, iterations, elapsed);
+
+    printf("Eventos que el kernel hubiera encolado: %lu\n",
+           (unsigned long)s_events_pushed);
+
+    free(frame);
+    return 0;
+}
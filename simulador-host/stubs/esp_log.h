@@ -0,0 +1,19 @@
+#ifndef SIM_ESP_LOG_H
+#define SIM_ESP_LOG_H
+
+// Stub de host: los niveles de log van directo a stdout/stderr
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) printf("I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+// Los niveles compilados fuera igual consumen sus argumentos: un TAG
+// usado solo en ESP_LOGD no dispara -Wunused-variable, y el if (0)
+// mantiene el chequeo de formato sin generar código
+#define ESP_LOGD(tag, fmt, ...) \
+    do { (void)(tag); if (0) { printf(fmt "\n", ##__VA_ARGS__); } } while (0)
+#define ESP_LOGV(tag, fmt, ...) \
+    do { (void)(tag); if (0) { printf(fmt "\n", ##__VA_ARGS__); } } while (0)
+
+#endif // SIM_ESP_LOG_H
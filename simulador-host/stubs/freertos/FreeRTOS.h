@@ -0,0 +1,30 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+// Stub de host: tipos y constantes mínimos. La creación de tareas falla
+// a propósito para que el escaneo a dos núcleos caiga en su camino de un
+// solo hilo (ver scan_worker_ensure en vision.c)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+
+static inline BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+#endif // SIM_FREERTOS_H
@@ -0,0 +1,73 @@
+#ifndef SIM_FREERTOS_TASK_H
+#define SIM_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_func,
+                                                 const char *name,
+                                                 uint32_t stack_depth,
+                                                 void *parameters,
+                                                 UBaseType_t priority,
+                                                 TaskHandle_t *created_task,
+                                                 BaseType_t core_id)
+{
+    (void)task_func;
+    (void)name;
+    (void)stack_depth;
+    (void)parameters;
+    (void)priority;
+    (void)created_task;
+    (void)core_id;
+    return pdFAIL; // Sin tareas en el host: forzar el camino de un hilo
+}
+
+static inline BaseType_t xTaskCreate(TaskFunction_t task_func,
+                                     const char *name,
+                                     uint32_t stack_depth,
+                                     void *parameters,
+                                     UBaseType_t priority,
+                                     TaskHandle_t *created_task)
+{
+    return xTaskCreatePinnedToCore(task_func, name, stack_depth, parameters,
+                                   priority, created_task, 0);
+}
+
+static inline void vTaskDelete(TaskHandle_t task)
+{
+    (void)task;
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+}
+
+// En el host no hay scheduler al que cederle el turno
+#define taskYIELD() ((void)0)
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return 0;
+}
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    (void)clear_on_exit;
+    (void)ticks;
+    return 0;
+}
+
+static inline void xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+}
+
+#endif // SIM_FREERTOS_TASK_H
@@ -0,0 +1,61 @@
+#ifndef SIM_NVS_H
+#define SIM_NVS_H
+
+// Stub de host: no hay NVS; cargar siempre falla y guardar es un no-op,
+// así el arranque del simulador toma el mismo camino que un devkit recién
+// flasheado (homografía por defecto)
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+static inline esp_err_t nvs_open(const char *namespace_name,
+                                 nvs_open_mode_t open_mode,
+                                 nvs_handle_t *out_handle)
+{
+    (void)namespace_name;
+    (void)open_mode;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key,
+                                     const void *value, size_t length)
+{
+    (void)handle;
+    (void)key;
+    (void)value;
+    (void)length;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key,
+                                     void *out_value, size_t *length)
+{
+    (void)handle;
+    (void)key;
+    (void)out_value;
+    (void)length;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static inline esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+static inline void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+#endif // SIM_NVS_H